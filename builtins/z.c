@@ -36,7 +36,13 @@ CHAR strZHelpText[] =
         "\n"
         "Changes the current directory based on a heuristic match.\n"
         "\n"
-        "Z [-license] <directory>\n";
+        "Z [-license] [-l] [-u] <directory>\n"
+        "\n"
+        "   -l             List remembered directories and their scores\n"
+        "   -u             Unload the module\n"
+        "\n"
+        "If YORIZFILE is set, remembered directories are loaded from and saved to\n"
+        "the file it names, so they are retained across sessions.\n";
 
 /**
  Display usage text to the user.
@@ -53,20 +59,114 @@ ZHelp()
 }
 
 /**
- The number of recent directories to remember in memory.
+ The maximum number of directories to remember.  When this is exceeded, the
+ database is aged until enough rarely used entries have been discarded.
+ */
+#define Z_MAX_DIRECTORIES (65536)
+
+/**
+ The amount of rank added to a directory each time it is visited.
+ */
+#define Z_RANK_SCALE (100)
+
+/**
+ The rank below which a directory is discarded when the database is aged.
+ */
+#define Z_MIN_RANK (Z_RANK_SCALE / 2)
+
+/**
+ The total rank of all directories that triggers aging.  Aging multiplies
+ every rank by 9/10, so directories that are visited often retain a
+ measurable rank while directories that are rarely visited fall below
+ Z_MIN_RANK and are discarded.
+ */
+#define Z_MAX_TOTAL_RANK (Z_MAX_DIRECTORIES * Z_RANK_SCALE * 4)
+
+/**
+ The number of changes to the database before it is written back to disk.
+ The database is also written when the module is unloaded.
+ */
+#define Z_SAVE_INTERVAL (16)
+
+/**
+ The largest database file that will be loaded.
+ */
+#define Z_MAX_DATABASE_SIZE (64 * 1024 * 1024)
+
+/**
+ The number of buckets in the directory and component hash tables.
+ */
+#define Z_HASH_BUCKETS (16384)
+
+/**
+ The signature at the start of a database file, 'YZDB'.
+ */
+#define Z_DATABASE_SIGNATURE (0x42445a59)
+
+/**
+ The version of the database file format.
  */
-#define Z_MAX_RECENT_DIRS (64)
+#define Z_DATABASE_VERSION (1)
 
 /**
- A linked list element corresponding to a remembered directory.
+ The header of a database file.  This is followed by DirectoryCount
+ Z_DATABASE_ENTRY structures, which are followed by the names of each
+ directory, without NULL terminators, in the same order as the entries.
  */
-typedef struct _Z_RECENT_DIRECTORY {
+typedef struct _Z_DATABASE_HEADER {
 
     /**
-     List element across the set of remembered directories.  Corresponds
-     to ZRecentDirectories.RecentDirList .
+     Z_DATABASE_SIGNATURE.
      */
-    YORI_LIST_ENTRY ListEntry;
+    DWORD Signature;
+
+    /**
+     Z_DATABASE_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The number of directories in the file.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     The total number of characters in all directory names.
+     */
+    DWORD CharCount;
+} Z_DATABASE_HEADER, *PZ_DATABASE_HEADER;
+
+/**
+ A single directory within a database file.
+ */
+typedef struct _Z_DATABASE_ENTRY {
+
+    /**
+     The rank of the directory.
+     */
+    DWORD Rank;
+
+    /**
+     The time the directory was last visited, in minutes since 1601.
+     */
+    DWORD LastAccessTime;
+
+    /**
+     The number of characters in the directory name.
+     */
+    DWORD NameLength;
+} Z_DATABASE_ENTRY, *PZ_DATABASE_ENTRY;
+
+/**
+ A remembered directory.
+ */
+typedef struct _Z_DIRECTORY {
+
+    /**
+     The entry within the hash table of directories, keyed by the fully
+     qualified name of the directory.
+     */
+    YORI_HASH_ENTRY HashEntry;
 
     /**
      The fully qualified name of the remembered directory.
@@ -74,93 +174,851 @@ typedef struct _Z_RECENT_DIRECTORY {
     YORI_STRING DirectoryName;
 
     /**
-     The number of times the directory has been encountered.
+     A value that increases each time the directory is visited and decays as
+     the database is aged.
+     */
+    DWORD Rank;
+
+    /**
+     The time the directory was last visited, in minutes since 1601.
+     */
+    DWORD LastAccessTime;
+
+    /**
+     The index of this directory within ZDatabase.Directories .
+     */
+    DWORD Index;
+
+    /**
+     The query that last considered this directory, so that a directory
+     found via more than one component is only scored once.
+     */
+    DWORD QueryGeneration;
+} Z_DIRECTORY, *PZ_DIRECTORY;
+
+/**
+ A single path component, such as "src", along with every directory that
+ contains that component.
+ */
+typedef struct _Z_COMPONENT {
+
+    /**
+     The entry within the hash table of components, keyed by the component.
+     The upcased component is available from the interned key.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     An array of directories containing this component.
+     */
+    PZ_DIRECTORY *Directories;
+
+    /**
+     The number of directories in the array.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     The number of directories the array has space for.
+     */
+    DWORD DirectoriesAllocated;
+} Z_COMPONENT, *PZ_COMPONENT;
+
+/**
+ The set of remembered directories and the index used to search them.
+ */
+typedef struct _Z_DATABASE {
+
+    /**
+     TRUE once the database has been loaded from disk, or an attempt to
+     load it has been made.
+     */
+    BOOL Loaded;
+
+    /**
+     TRUE if every directory has been added to the component index.  If
+     the index could not be fully built, searches examine every directory.
+     */
+    BOOL ComponentIndexValid;
+
+    /**
+     The fully qualified path to the database file.  This is empty if the
+     user has not requested that directories be saved.
+     */
+    YORI_STRING FileName;
+
+    /**
+     A hash table of directories, keyed by fully qualified name.
+     */
+    PYORI_HASH_TABLE DirectoryTable;
+
+    /**
+     An array of all directories.
+     */
+    PZ_DIRECTORY *Directories;
+
+    /**
+     The number of directories in the array.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     The number of directories the array has space for.
+     */
+    DWORD DirectoriesAllocated;
+
+    /**
+     A hash table of path components, keyed by the component.
+     */
+    PYORI_HASH_TABLE ComponentTable;
+
+    /**
+     An array of all path components, used to search for components that
+     contain the user specification.
+     */
+    PZ_COMPONENT *Components;
+
+    /**
+     The number of components in the array.
+     */
+    DWORD ComponentCount;
+
+    /**
+     The number of components the array has space for.
+     */
+    DWORD ComponentsAllocated;
+
+    /**
+     The sum of the rank of all directories, used to determine when to age
+     the database.
+     */
+    DWORD TotalRank;
+
+    /**
+     A number which is incremented for each query.
+     */
+    DWORD QueryGeneration;
+
+    /**
+     The number of changes since the database was last written to disk.
+     */
+    DWORD ChangesSinceSave;
+
+} Z_DATABASE, *PZ_DATABASE;
+
+/**
+ A directory name that matches the user's search criteria.  This structure
+ is seperate from the above as it is arranged in a set of matches with a
+ score attached to each, and the score is determined based on the user
+ criteria.
+ */
+typedef struct _Z_SCOREBOARD_ENTRY {
+
+    /**
+     The entry within the scoreboard hash table, keyed by directory name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The links of this entry within the list of all scoreboard entries.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the directory.  This string is not referenced, and points
+     into a remembered directory or the fully resolved user specification.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     The score for this entry.
      */
-    DWORD HitCount;
-} Z_RECENT_DIRECTORY, *PZ_RECENT_DIRECTORY;
+    DWORD Score;
+} Z_SCOREBOARD_ENTRY, *PZ_SCOREBOARD_ENTRY;
 
 /**
- The head of the list of recent directories.
+ The set of directories that match the user's search criteria.
  */
-typedef struct _Z_RECENT_DIRECTORIES {
+typedef struct _Z_SCOREBOARD {
+
     /**
-     The head of the list of recent directories.
+     A hash table of entries, keyed by directory name, so that a directory
+     that matches more than once is only present once.
      */
-    YORI_LIST_ENTRY RecentDirList;
+    PYORI_HASH_TABLE HashTable;
+
+    /**
+     A list of all entries.
+     */
+    YORI_LIST_ENTRY EntryList;
+} Z_SCOREBOARD, *PZ_SCOREBOARD;
+
+/**
+ The set of remembered directories known to the module.
+ */
+Z_DATABASE ZDatabase;
+
+/**
+ Set to TRUE once the command has been invoked once to keep the module loaded.
+ */
+BOOL ZCallbacksRegistered;
+
+/**
+ Return the current time in minutes since 1601.
+
+ @return The current time in minutes since 1601.
+ */
+DWORD
+ZCurrentTime()
+{
+    FILETIME SystemTime;
+    LARGE_INTEGER Time;
+
+    GetSystemTimeAsFileTime(&SystemTime);
+    Time.LowPart = SystemTime.dwLowDateTime;
+    Time.HighPart = SystemTime.dwHighDateTime;
+
+    return (DWORD)(Time.QuadPart / (10 * 1000 * 1000 * 60));
+}
+
+/**
+ Return the rank of a directory weighted by how recently it was visited.
+
+ @param Directory Pointer to the directory.
+
+ @param Now The current time in minutes since 1601.
+
+ @return The weighted rank of the directory.
+ */
+DWORD
+ZFrecency(
+    __in PZ_DIRECTORY Directory,
+    __in DWORD Now
+    )
+{
+    DWORD Age;
+
+    Age = 0;
+    if (Now > Directory->LastAccessTime) {
+        Age = Now - Directory->LastAccessTime;
+    }
+
+    if (Age < 60) {
+        return Directory->Rank * 4;
+    } else if (Age < 60 * 24) {
+        return Directory->Rank * 2;
+    } else if (Age < 60 * 24 * 7) {
+        return Directory->Rank;
+    }
+    return Directory->Rank / 4;
+}
+
+/**
+ Ensure an array of pointers has space for one more element, doubling its
+ allocation if it is full.
+
+ @param Array On input, points to the current array.  On output, updated to
+        point to a new array if one was allocated.
+
+ @param ElementCount The number of elements currently in the array.
+
+ @param ElementsAllocated On input, points to the number of elements the
+        array has space for.  On output, updated if a new array was
+        allocated.
+
+ @return TRUE if the array has space for another element, FALSE if it does
+         not and a larger array could not be allocated.
+ */
+__success(return)
+BOOL
+ZEnsurePointerArraySpace(
+    __inout PVOID **Array,
+    __in DWORD ElementCount,
+    __inout PDWORD ElementsAllocated
+    )
+{
+    PVOID *NewArray;
+    DWORD NewAllocated;
+
+    if (ElementCount < *ElementsAllocated) {
+        return TRUE;
+    }
+
+    NewAllocated = *ElementsAllocated * 2;
+    if (NewAllocated < 4) {
+        NewAllocated = 4;
+    }
+
+    NewArray = YoriLibMalloc(NewAllocated * sizeof(PVOID));
+    if (NewArray == NULL) {
+        return FALSE;
+    }
+
+    if (ElementCount > 0) {
+        memcpy(NewArray, *Array, ElementCount * sizeof(PVOID));
+    }
+
+    if (*Array != NULL) {
+        YoriLibFree(*Array);
+    }
+
+    *Array = NewArray;
+    *ElementsAllocated = NewAllocated;
+    return TRUE;
+}
+
+/**
+ Add each component of a directory's name to the component index.
+
+ @param Directory Pointer to the directory to index.
+
+ @return TRUE if every component was indexed, FALSE if not.
+ */
+__success(return)
+BOOL
+ZIndexDirectory(
+    __in PZ_DIRECTORY Directory
+    )
+{
+    YORI_STRING ComponentName;
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_COMPONENT Component;
+    DWORD Start;
+    DWORD Index;
+
+    Start = 0;
+    for (Index = 0; Index <= Directory->DirectoryName.LengthInChars; Index++) {
+        if (Index < Directory->DirectoryName.LengthInChars &&
+            !YoriLibIsSep(Directory->DirectoryName.StartOfString[Index])) {
+
+            continue;
+        }
+
+        if (Index > Start) {
+            YoriLibInitEmptyString(&ComponentName);
+            ComponentName.StartOfString = &Directory->DirectoryName.StartOfString[Start];
+            ComponentName.LengthInChars = Index - Start;
+
+            HashEntry = YoriLibHashLookupByKey(ZDatabase.ComponentTable, &ComponentName);
+            if (HashEntry != NULL) {
+                Component = HashEntry->Context;
+            } else {
+                if (!ZEnsurePointerArraySpace((PVOID **)&ZDatabase.Components, ZDatabase.ComponentCount, &ZDatabase.ComponentsAllocated)) {
+                    return FALSE;
+                }
+
+                Component = YoriLibMalloc(sizeof(Z_COMPONENT));
+                if (Component == NULL) {
+                    return FALSE;
+                }
+
+                ZeroMemory(Component, sizeof(Z_COMPONENT));
+                if (!YoriLibHashInsertByKey(ZDatabase.ComponentTable, &ComponentName, Component, &Component->HashEntry)) {
+                    YoriLibFree(Component);
+                    return FALSE;
+                }
+
+                ZDatabase.Components[ZDatabase.ComponentCount] = Component;
+                ZDatabase.ComponentCount++;
+            }
+
+            //
+            //  A name can contain the same component more than once, but
+            //  since directories are indexed one at a time, any earlier
+            //  occurrence is at the end of the array.
+            //
+
+            if (Component->DirectoryCount == 0 ||
+                Component->Directories[Component->DirectoryCount - 1] != Directory) {
+
+                if (!ZEnsurePointerArraySpace((PVOID **)&Component->Directories, Component->DirectoryCount, &Component->DirectoriesAllocated)) {
+                    return FALSE;
+                }
+                Component->Directories[Component->DirectoryCount] = Directory;
+                Component->DirectoryCount++;
+            }
+        }
+
+        Start = Index + 1;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the component index.
+ */
+VOID
+ZFreeComponentIndex()
+{
+    PZ_COMPONENT Component;
+    DWORD Index;
+
+    for (Index = 0; Index < ZDatabase.ComponentCount; Index++) {
+        Component = ZDatabase.Components[Index];
+        YoriLibHashRemoveByEntry(&Component->HashEntry);
+        if (Component->Directories != NULL) {
+            YoriLibFree(Component->Directories);
+        }
+        YoriLibFree(Component);
+    }
+
+    if (ZDatabase.Components != NULL) {
+        YoriLibFree(ZDatabase.Components);
+        ZDatabase.Components = NULL;
+    }
+    ZDatabase.ComponentCount = 0;
+    ZDatabase.ComponentsAllocated = 0;
+}
+
+/**
+ Discard the component index and build a new one from the current set of
+ directories.  This is performed after directories are removed, since the
+ index refers to each directory by pointer.
+ */
+VOID
+ZRebuildComponentIndex()
+{
+    DWORD Index;
+
+    ZFreeComponentIndex();
+    ZDatabase.ComponentIndexValid = TRUE;
+
+    for (Index = 0; Index < ZDatabase.DirectoryCount; Index++) {
+        if (!ZIndexDirectory(ZDatabase.Directories[Index])) {
+            ZDatabase.ComponentIndexValid = FALSE;
+            break;
+        }
+    }
+}
+
+/**
+ Add a new directory to the database.  The caller is expected to have
+ checked that the directory is not already present.
+
+ @param DirectoryName Pointer to the fully qualified name of the directory.
+
+ @param Rank The initial rank of the directory.
+
+ @param LastAccessTime The time the directory was last visited, in minutes
+        since 1601.
+
+ @return Pointer to the new directory, or NULL on allocation failure.
+ */
+PZ_DIRECTORY
+ZInsertDirectory(
+    __in PYORI_STRING DirectoryName,
+    __in DWORD Rank,
+    __in DWORD LastAccessTime
+    )
+{
+    PZ_DIRECTORY Directory;
+
+    if (!ZEnsurePointerArraySpace((PVOID **)&ZDatabase.Directories, ZDatabase.DirectoryCount, &ZDatabase.DirectoriesAllocated)) {
+        return NULL;
+    }
+
+    Directory = YoriLibReferencedMalloc(sizeof(Z_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    YoriLibReference(Directory);
+    Directory->DirectoryName.MemoryToFree = Directory;
+    Directory->DirectoryName.StartOfString = (LPWSTR)(Directory + 1);
+    Directory->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
+    Directory->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+
+    memcpy(Directory->DirectoryName.StartOfString, DirectoryName->StartOfString, DirectoryName->LengthInChars * sizeof(TCHAR));
+    Directory->DirectoryName.StartOfString[DirectoryName->LengthInChars] = '\0';
+
+    Directory->Rank = Rank;
+    Directory->LastAccessTime = LastAccessTime;
+    Directory->QueryGeneration = 0;
+
+    if (!YoriLibHashInsertByKey(ZDatabase.DirectoryTable, &Directory->DirectoryName, Directory, &Directory->HashEntry)) {
+        YoriLibFreeStringContents(&Directory->DirectoryName);
+        YoriLibDereference(Directory);
+        return NULL;
+    }
+
+    Directory->Index = ZDatabase.DirectoryCount;
+    ZDatabase.Directories[ZDatabase.DirectoryCount] = Directory;
+    ZDatabase.DirectoryCount++;
+    ZDatabase.TotalRank += Rank;
+
+    if (ZDatabase.ComponentIndexValid && !ZIndexDirectory(Directory)) {
+        ZDatabase.ComponentIndexValid = FALSE;
+    }
+
+    return Directory;
+}
+
+/**
+ Remove a directory from the database.  Note the component index still
+ refers to the directory, so the caller must rebuild it before the next
+ search.
+
+ @param Directory Pointer to the directory to remove.
+ */
+VOID
+ZRemoveDirectory(
+    __in PZ_DIRECTORY Directory
+    )
+{
+    PZ_DIRECTORY LastDirectory;
+
+    YoriLibHashRemoveByEntry(&Directory->HashEntry);
+    ZDatabase.TotalRank -= Directory->Rank;
+
+    LastDirectory = ZDatabase.Directories[ZDatabase.DirectoryCount - 1];
+    ZDatabase.Directories[Directory->Index] = LastDirectory;
+    LastDirectory->Index = Directory->Index;
+    ZDatabase.DirectoryCount--;
+
+    YoriLibFreeStringContents(&Directory->DirectoryName);
+    YoriLibDereference(Directory);
+}
+
+/**
+ If the database has grown too large, decay the rank of every directory and
+ discard directories whose rank falls too low, repeating until the database
+ is within its limits.
+ */
+VOID
+ZAgeDatabase()
+{
+    PZ_DIRECTORY Directory;
+    DWORD Index;
+    DWORD Decay;
+    BOOL Removed;
+
+    Removed = FALSE;
+    while (ZDatabase.TotalRank > Z_MAX_TOTAL_RANK ||
+           ZDatabase.DirectoryCount > Z_MAX_DIRECTORIES) {
+
+        //
+        //  Walk backwards so that the entry moved into the slot of a
+        //  removed entry has already been aged.
+        //
+
+        for (Index = ZDatabase.DirectoryCount; Index > 0; Index--) {
+            Directory = ZDatabase.Directories[Index - 1];
+            Decay = Directory->Rank / 10;
+            Directory->Rank -= Decay;
+            ZDatabase.TotalRank -= Decay;
+            if (Directory->Rank < Z_MIN_RANK) {
+                ZRemoveDirectory(Directory);
+                Removed = TRUE;
+            }
+        }
+    }
+
+    if (Removed) {
+        ZRebuildComponentIndex();
+    }
+}
+
+/**
+ Write the database to disk, if the user has requested this behavior by
+ setting YORIZFILE.  The database is written to a temporary file which then
+ replaces the existing file, so an interrupted write does not lose the
+ previous contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+ZSaveDatabase()
+{
+    PZ_DATABASE_HEADER Header;
+    PZ_DATABASE_ENTRY Entries;
+    PZ_DIRECTORY Directory;
+    LPTSTR Names;
+    PUCHAR Buffer;
+    DWORD CharCount;
+    DWORD BufferSize;
+    DWORD BytesWritten;
+    DWORD Index;
+    YORI_STRING TempFileName;
+    HANDLE FileHandle;
+    BOOL Result;
+
+    if (ZDatabase.FileName.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    ZDatabase.ChangesSinceSave = 0;
+
+    CharCount = 0;
+    for (Index = 0; Index < ZDatabase.DirectoryCount; Index++) {
+        CharCount += ZDatabase.Directories[Index]->DirectoryName.LengthInChars;
+    }
+
+    BufferSize = sizeof(Z_DATABASE_HEADER) +
+                 ZDatabase.DirectoryCount * sizeof(Z_DATABASE_ENTRY) +
+                 CharCount * sizeof(TCHAR);
+
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    Header = (PZ_DATABASE_HEADER)Buffer;
+    Entries = (PZ_DATABASE_ENTRY)(Header + 1);
+    Names = (LPTSTR)(Entries + ZDatabase.DirectoryCount);
+
+    Header->Signature = Z_DATABASE_SIGNATURE;
+    Header->Version = Z_DATABASE_VERSION;
+    Header->DirectoryCount = ZDatabase.DirectoryCount;
+    Header->CharCount = CharCount;
+
+    for (Index = 0; Index < ZDatabase.DirectoryCount; Index++) {
+        Directory = ZDatabase.Directories[Index];
+        Entries[Index].Rank = Directory->Rank;
+        Entries[Index].LastAccessTime = Directory->LastAccessTime;
+        Entries[Index].NameLength = Directory->DirectoryName.LengthInChars;
+        memcpy(Names, Directory->DirectoryName.StartOfString, Directory->DirectoryName.LengthInChars * sizeof(TCHAR));
+        Names += Directory->DirectoryName.LengthInChars;
+    }
+
+    YoriLibInitEmptyString(&TempFileName);
+    YoriLibYPrintf(&TempFileName, _T("%y.tmp"), &ZDatabase.FileName);
+    if (TempFileName.StartOfString == NULL) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(TempFileName.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempFileName);
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = WriteFile(FileHandle, Buffer, BufferSize, &BytesWritten, NULL);
+    if (Result && BytesWritten != BufferSize) {
+        Result = FALSE;
+    }
+    CloseHandle(FileHandle);
+    YoriLibFree(Buffer);
+
+    if (Result) {
+        Result = MoveFileEx(TempFileName.StartOfString, ZDatabase.FileName.StartOfString, MOVEFILE_REPLACE_EXISTING);
+    }
+
+    if (!Result) {
+        DeleteFile(TempFileName.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    return Result;
+}
+
+/**
+ Parse the contents of a database file and add each directory it describes
+ to the database.
+
+ @param Buffer Pointer to the contents of the file.
+
+ @param BufferSize The number of bytes in the file.
+
+ @return TRUE if the file was valid, FALSE if it was not.
+ */
+__success(return)
+BOOL
+ZParseDatabase(
+    __in PUCHAR Buffer,
+    __in DWORD BufferSize
+    )
+{
+    PZ_DATABASE_HEADER Header;
+    PZ_DATABASE_ENTRY Entries;
+    YORI_STRING DirectoryName;
+    DWORD CharsRemaining;
+    DWORD Index;
+
+    if (BufferSize < sizeof(Z_DATABASE_HEADER)) {
+        return FALSE;
+    }
+
+    Header = (PZ_DATABASE_HEADER)Buffer;
+    if (Header->Signature != Z_DATABASE_SIGNATURE ||
+        Header->Version != Z_DATABASE_VERSION ||
+        Header->DirectoryCount > Z_MAX_DIRECTORIES ||
+        Header->CharCount > Z_MAX_DATABASE_SIZE / sizeof(TCHAR)) {
+
+        return FALSE;
+    }
+
+    if (BufferSize != sizeof(Z_DATABASE_HEADER) +
+                      Header->DirectoryCount * sizeof(Z_DATABASE_ENTRY) +
+                      Header->CharCount * sizeof(TCHAR)) {
+        return FALSE;
+    }
+
+    Entries = (PZ_DATABASE_ENTRY)(Header + 1);
+
+    YoriLibInitEmptyString(&DirectoryName);
+    DirectoryName.StartOfString = (LPTSTR)(Entries + Header->DirectoryCount);
+    CharsRemaining = Header->CharCount;
+
+    for (Index = 0; Index < Header->DirectoryCount; Index++) {
+        if (Entries[Index].NameLength > CharsRemaining) {
+            return FALSE;
+        }
+
+        DirectoryName.LengthInChars = Entries[Index].NameLength;
+        if (DirectoryName.LengthInChars > 0 &&
+            Entries[Index].Rank >= Z_MIN_RANK &&
+            YoriLibHashLookupByKey(ZDatabase.DirectoryTable, &DirectoryName) == NULL) {
+
+            if (ZInsertDirectory(&DirectoryName, Entries[Index].Rank, Entries[Index].LastAccessTime) == NULL) {
+                return FALSE;
+            }
+        }
+
+        DirectoryName.StartOfString += Entries[Index].NameLength;
+        CharsRemaining -= Entries[Index].NameLength;
+    }
+
+    return TRUE;
+}
+
+/**
+ Prepare the database for use.  If the user has requested that directories
+ be saved by setting YORIZFILE, load the directories from that file, which
+ is read in its entirety with a single read.
+
+ @return TRUE to indicate the database is usable, FALSE if it could not be
+         initialized.
+ */
+__success(return)
+BOOL
+ZLoadDatabase()
+{
+    YORI_STRING UserFileName;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD FileSize;
+    DWORD FileSizeHigh;
+    DWORD BytesRead;
+
+    if (ZDatabase.Loaded) {
+        return TRUE;
+    }
+
+    ZDatabase.DirectoryTable = YoriLibAllocateHashTable(Z_HASH_BUCKETS);
+    if (ZDatabase.DirectoryTable == NULL) {
+        return FALSE;
+    }
+
+    ZDatabase.ComponentTable = YoriLibAllocateHashTable(Z_HASH_BUCKETS);
+    if (ZDatabase.ComponentTable == NULL) {
+        YoriLibFreeEmptyHashTable(ZDatabase.DirectoryTable);
+        ZDatabase.DirectoryTable = NULL;
+        return FALSE;
+    }
+
+    ZDatabase.Loaded = TRUE;
+    ZDatabase.ComponentIndexValid = TRUE;
+    YoriLibInitEmptyString(&ZDatabase.FileName);
+
+    //
+    //  Check if there's a file to load saved directories from.
+    //
+
+    if (!YoriLibAllocateAndGetEnvironmentVariable(_T("YORIZFILE"), &UserFileName)) {
+        return TRUE;
+    }
+
+    if (UserFileName.LengthInChars == 0) {
+        YoriLibFreeStringContents(&UserFileName);
+        return TRUE;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(&UserFileName, TRUE, &ZDatabase.FileName)) {
+        YoriLibFreeStringContents(&UserFileName);
+        return TRUE;
+    }
 
-    /**
-     The number of items currently in the list of recent directories, so we
-     can efficiently know when it's time to trim the list.
-     */
-    DWORD RecentDirCount;
+    YoriLibFreeStringContents(&UserFileName);
 
-    /**
-     A monotonically increasing number corresponding to attempts to add items
-     into the recent list.  Periodically this will trigger logic to trim the
-     HitCount on all existing entries to prevent them counting to infinity.
-     */
-    DWORD MonotonicAddAttempt;
+    FileHandle = CreateFile(ZDatabase.FileName.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
 
-} Z_RECENT_DIRECTORIES, *PZ_RECENT_DIRECTORIES;
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
 
-/**
- A directory name that matches the user's search criteria.  This structure
- is seperate from the above as it is arranged in an array form of matches
- with a score attached to each, and the score is determined based on the
- user criteria.
- */
-typedef struct _Z_SCOREBOARD_ENTRY {
+    FileSize = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSize == INVALID_FILE_SIZE ||
+        FileSizeHigh != 0 ||
+        FileSize > Z_MAX_DATABASE_SIZE) {
 
-    /**
-     The name of the directory.  Note that while the array is being
-     constructed this string is not referenced, but still contains a
-     populated MemoryToFree value so that it can be referenced and returned
-     to the caller if it's the best match.
-     */
-    YORI_STRING DirectoryName;
+        CloseHandle(FileHandle);
+        return TRUE;
+    }
 
-    /**
-     The score for this entry.
-     */
-    DWORD Score;
-} Z_SCOREBOARD_ENTRY, *PZ_SCOREBOARD_ENTRY;
+    Buffer = YoriLibMalloc(FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return TRUE;
+    }
 
-/**
- The set of recent directories known to the module.
- */
-Z_RECENT_DIRECTORIES ZRecentDirectories;
+    if (ReadFile(FileHandle, Buffer, FileSize, &BytesRead, NULL) &&
+        BytesRead == FileSize) {
 
-/**
- Set to TRUE once the command has been invoked once to keep the module loaded.
- */
-BOOL ZCallbacksRegistered;
+        if (!ZParseDatabase(Buffer, FileSize)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("z: %y is not a valid directory database\n"), &ZDatabase.FileName);
+        }
+    }
+
+    CloseHandle(FileHandle);
+    YoriLibFree(Buffer);
+
+    ZAgeDatabase();
+
+    return TRUE;
+}
 
 /**
- Display the current known list of recent directories in order of most
- recently used to least recently used with their corresponding hit count.
+ Display the known set of directories with their rank and their current
+ score, which also reflects how recently they were visited.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 ZListStack()
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
+    PZ_DIRECTORY Directory;
+    DWORD Index;
+    DWORD Now;
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y HitCount %i\n"), &FoundRecentDir->DirectoryName, FoundRecentDir->HitCount);
+    Now = ZCurrentTime();
+    for (Index = 0; Index < ZDatabase.DirectoryCount; Index++) {
+        Directory = ZDatabase.Directories[Index];
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y Rank %i Score %i\n"), &Directory->DirectoryName, Directory->Rank, ZFrecency(Directory, Now));
     }
     return TRUE;
 }
 
 /**
- Check the recent directories for a match to DirectoryName.  If a match is
- found, promote it to be the most recent entry and update its HitCount.
- If no match is found, add a new match, potentially evicting the least
- recently used match.
+ Record a visit to a directory.  If the directory is already known, its rank
+ is increased; otherwise it is added.  The database is aged if it has grown
+ too large, and is periodically written to disk.
 
  @param DirectoryName Pointer to the fully qualified directory name to add.
 
@@ -171,109 +1029,70 @@ ZAddDirectoryToRecent(
     __in PYORI_STRING DirectoryName
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
-
-    if (ZRecentDirectories.RecentDirList.Next == NULL) {
-        YoriLibInitializeListHead(&ZRecentDirectories.RecentDirList);
-    }
-
-    //
-    //  If this attempt to add is a multiple of 1/4th of the size of the
-    //  list, decrease each HitCount by 1/4th of its current value.
-    //  This math isn't completely perfect, but it will tend to keep
-    //  HitCounts relatively low while still maintaining a measurable
-    //  difference between entries hit a lot and entries rarely hit.
-    //
-
-    ZRecentDirectories.MonotonicAddAttempt++;
-    if ((ZRecentDirectories.MonotonicAddAttempt % (Z_MAX_RECENT_DIRS >> 2)) == 0) {
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        while (ListEntry != NULL) {
-            FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-            ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-            FoundRecentDir->HitCount -= (FoundRecentDir->HitCount >> 2);
-            ASSERT(FoundRecentDir->HitCount > 0);
-        }
-    }
-
-    //
-    //  Check if the new directory already exists in the recent directory
-    //  list, update its position to be head of the list, increase its
-    //  HitCount, and return.
-    //
-
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        if (YoriLibCompareStringInsensitive(DirectoryName, &FoundRecentDir->DirectoryName) == 0) {
-            YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-            YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-            FoundRecentDir->HitCount++;
-            return TRUE;
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_DIRECTORY Directory;
+    DWORD Now;
+
+    Now = ZCurrentTime();
+
+    HashEntry = YoriLibHashLookupByKey(ZDatabase.DirectoryTable, DirectoryName);
+    if (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        Directory->Rank += Z_RANK_SCALE;
+        Directory->LastAccessTime = Now;
+        ZDatabase.TotalRank += Z_RANK_SCALE;
+    } else {
+        Directory = ZInsertDirectory(DirectoryName, Z_RANK_SCALE, Now);
+        if (Directory == NULL) {
+            return FALSE;
         }
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-    }
-
-    //
-    //  Since it's not in the list, evict the oldest entry if the list has
-    //  reached its maximum size.
-    //
-
-    if (ZRecentDirectories.RecentDirCount >= Z_MAX_RECENT_DIRS) {
-        ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
-        ZRecentDirectories.RecentDirCount--;
     }
 
-    //
-    //  Attempt to insert a new entry corresponding to this directory.
-    //
+    ZAgeDatabase();
 
-    FoundRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
-    if (FoundRecentDir == NULL) {
-        return FALSE;
+    ZDatabase.ChangesSinceSave++;
+    if (ZDatabase.ChangesSinceSave >= Z_SAVE_INTERVAL) {
+        ZSaveDatabase();
     }
 
-    YoriLibReference(FoundRecentDir);
-    FoundRecentDir->DirectoryName.MemoryToFree = FoundRecentDir;
-    FoundRecentDir->DirectoryName.StartOfString = (LPWSTR)(FoundRecentDir + 1);
-    FoundRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
-    FoundRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
-
-    memcpy(FoundRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
-
-    FoundRecentDir->HitCount = 1;
-
-    YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-    ZRecentDirectories.RecentDirCount++;
-
-    ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
-
     return TRUE;
 }
 
 /**
- Called when the module is unloaded to clean up state.
+ Called when the module is unloaded to save and clean up state.
  */
 VOID
 YORI_BUILTIN_FN
 ZNotifyUnload()
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
+    PZ_DIRECTORY Directory;
+    DWORD Index;
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
+    if (!ZDatabase.Loaded) {
+        return;
+    }
+
+    if (ZDatabase.ChangesSinceSave > 0) {
+        ZSaveDatabase();
+    }
+
+    ZFreeComponentIndex();
+
+    for (Index = 0; Index < ZDatabase.DirectoryCount; Index++) {
+        Directory = ZDatabase.Directories[Index];
+        YoriLibHashRemoveByEntry(&Directory->HashEntry);
+        YoriLibFreeStringContents(&Directory->DirectoryName);
+        YoriLibDereference(Directory);
     }
+
+    if (ZDatabase.Directories != NULL) {
+        YoriLibFree(ZDatabase.Directories);
+    }
+
+    YoriLibFreeEmptyHashTable(ZDatabase.ComponentTable);
+    YoriLibFreeEmptyHashTable(ZDatabase.DirectoryTable);
+    YoriLibFreeStringContents(&ZDatabase.FileName);
+    ZeroMemory(&ZDatabase, sizeof(ZDatabase));
 }
 
 /**
@@ -348,226 +1167,328 @@ ZResolveSpecificationToFullPath(
 }
 
 /**
- Take any fully resolved path based on the user specification, and any
- recent directories that match the user specification, heuristically assign
- each directory with a score, and return the entry with the highest score.
- If nothing matches the user specification, returns FALSE.
+ The score given to the fully resolved user specification.  This is the
+ score of a directory visited ten times in the last hour whose final
+ component matches the user specification, so it is normally selected,
+ but a directory used much more heavily can still be preferred.
+ */
+#define Z_RESOLVED_PATH_SCORE (Z_RANK_SCALE * 10 * 4 * 4)
+
+/**
+ Add a directory to the scoreboard.  If the directory is already present,
+ the score is optionally added to the existing entry.
+
+ @param Scoreboard Pointer to the scoreboard.
+
+ @param DirectoryName Pointer to the directory name.  This string is not
+        copied or referenced, so it must remain valid for the lifetime of
+        the scoreboard.
+
+ @param Score The score for this match.
+
+ @param Accumulate If TRUE and the directory is already present, add the
+        score to the existing entry.  If FALSE, an existing entry is left
+        unchanged.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+ZAddToScoreboard(
+    __in PZ_SCOREBOARD Scoreboard,
+    __in PYORI_STRING DirectoryName,
+    __in DWORD Score,
+    __in BOOL Accumulate
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_SCOREBOARD_ENTRY Entry;
+
+    HashEntry = YoriLibHashLookupByKey(Scoreboard->HashTable, DirectoryName);
+    if (HashEntry != NULL) {
+        if (Accumulate) {
+            Entry = HashEntry->Context;
+            Entry->Score += Score;
+        }
+        return TRUE;
+    }
+
+    Entry = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY));
+    if (Entry == NULL) {
+        return FALSE;
+    }
+
+    memcpy(&Entry->DirectoryName, DirectoryName, sizeof(YORI_STRING));
+    Entry->Score = Score;
+
+    if (!YoriLibHashInsertByKey(Scoreboard->HashTable, DirectoryName, Entry, &Entry->HashEntry)) {
+        YoriLibFree(Entry);
+        return FALSE;
+    }
+
+    YoriLibAppendList(&Scoreboard->EntryList, &Entry->ListEntry);
+    return TRUE;
+}
+
+/**
+ Free all entries in the scoreboard and the scoreboard's hash table.
+
+ @param Scoreboard Pointer to the scoreboard.
+ */
+VOID
+ZFreeScoreboard(
+    __in PZ_SCOREBOARD Scoreboard
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_SCOREBOARD_ENTRY Entry;
+
+    ListEntry = YoriLibGetNextListEntry(&Scoreboard->EntryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, Z_SCOREBOARD_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Scoreboard->EntryList, ListEntry);
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+    }
+
+    YoriLibFreeEmptyHashTable(Scoreboard->HashTable);
+}
+
+/**
+ Determine whether a remembered directory matches the user specification,
+ and if so, add it to the scoreboard with a score reflecting both how well
+ it matches and how frequently and recently it has been visited.
+
+ @param Scoreboard Pointer to the scoreboard.
 
  @param UserSpecification Pointer to the user specification to match against.
 
- @param FullMatchToUserSpec Pointer to a string that is a fully qualified
-        path resovled by the UserSpecification.  This may be an empty string
-        if the user specification could not be resolved or resolved to an
-        object that does not exist.
+ @param Directory Pointer to the remembered directory.
 
- @param BestMatch On successful completion, updated to point to a referenced
-        string containing the best match for this directory change operation.
+ @param Now The current time in minutes since 1601.
 
- @return TRUE if a match was found, FALSE if it was not.
+ @return TRUE to indicate success, FALSE on allocation failure.
  */
 __success(return)
 BOOL
-ZBuildScoreboardAndSelectBest(
+ZScoreDirectory(
+    __in PZ_SCOREBOARD Scoreboard,
     __in PYORI_STRING UserSpecification,
-    __in PYORI_STRING FullMatchToUserSpec,
-    __out PYORI_STRING BestMatch
+    __in PZ_DIRECTORY Directory,
+    __in DWORD Now
     )
 {
-    PZ_SCOREBOARD_ENTRY Entries;
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
     YORI_STRING FinalComponent;
     YORI_STRING TrailingPortion;
     YORI_STRING StringToAdd;
-    DWORD EntriesPopulated;
-    DWORD Index;
+    DWORD Frecency;
     DWORD ScoreForThisEntry;
-    DWORD BestScore;
-    DWORD BestIndex;
     DWORD OffsetOfMatch;
     BOOL SeperatorBefore;
     BOOL SeperatorAfter;
-    BOOL AddThisEntry;
-    BOOL FoundAsParentOnly;
 
-    //
-    //  Allocate enough entries for everything we know about, including all
-    //  history and the currently resolved full path
-    //
+    Frecency = ZFrecency(Directory, Now);
+    ScoreForThisEntry = 0;
 
-    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * (Z_MAX_RECENT_DIRS + 1));
-    if (Entries == NULL) {
-        return FALSE;
-    }
+    YoriLibInitEmptyString(&FinalComponent);
+    YoriLibInitEmptyString(&TrailingPortion);
+    FinalComponent.StartOfString = YoriLibFindRightMostCharacter(&Directory->DirectoryName, '\\');
 
-    EntriesPopulated = 0;
+    if (Directory->DirectoryName.LengthInChars >= UserSpecification->LengthInChars) {
+        TrailingPortion.StartOfString = &Directory->DirectoryName.StartOfString[Directory->DirectoryName.LengthInChars - UserSpecification->LengthInChars];
+        TrailingPortion.LengthInChars = UserSpecification->LengthInChars;
+    }
+    OffsetOfMatch = 0;
 
     //
-    //  If we have a fully resolved match, add it unconditionally.  Don't
-    //  check if it matches the user specification - we already know it
-    //  does, and string compare might be misleading because the user
-    //  specification may not contain any matching string (eg. "..").
+    //  If it's a complete match of the final component, big bonus points.
+    //  If it's a match up to the end of the string, moderate bonus points.
+    //  If it's somewhere in the final component, small bonus points.
     //
 
-    if (FullMatchToUserSpec->LengthInChars > 0) {
-        memcpy(&Entries[EntriesPopulated].DirectoryName, FullMatchToUserSpec, sizeof(YORI_STRING));
-        Entries[EntriesPopulated].Score = Z_MAX_RECENT_DIRS * 16;
-        EntriesPopulated++;
+    if (FinalComponent.StartOfString != NULL) {
+        FinalComponent.StartOfString++;
+        FinalComponent.LengthInChars = Directory->DirectoryName.LengthInChars - (DWORD)(FinalComponent.StartOfString - Directory->DirectoryName.StartOfString);
+
+        if (YoriLibCompareStringInsensitive(&FinalComponent, UserSpecification) == 0) {
+            ScoreForThisEntry = Frecency * 4;
+        } else if (TrailingPortion.LengthInChars > 0 &&
+                   YoriLibCompareStringInsensitive(&TrailingPortion, UserSpecification) == 0) {
+            ScoreForThisEntry = Frecency * 3;
+        } else if (YoriLibFindFirstMatchingSubstringInsensitive(&FinalComponent, 1, UserSpecification, NULL) != NULL) {
+            ScoreForThisEntry = Frecency * 2;
+        }
     }
 
-    Index = Z_MAX_RECENT_DIRS;
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        AddThisEntry = FALSE;
-        FoundAsParentOnly = FALSE;
+    //
+    //  If the currently found directory has already been added by the
+    //  fully resolved user specification, don't add it twice, but since
+    //  this is a high quality match add the scores together.
+    //
 
-        //
-        //  Calculate a rough score for this entry.
-        //
+    if (ScoreForThisEntry > 0) {
+        return ZAddToScoreboard(Scoreboard, &Directory->DirectoryName, ScoreForThisEntry, TRUE);
+    }
 
-        ScoreForThisEntry = Index * (Z_MAX_RECENT_DIRS / 8);
-        ScoreForThisEntry += FoundRecentDir->HitCount * (Z_MAX_RECENT_DIRS / 8);
+    //
+    //  If it's in the string but not the final component, add it, but
+    //  no bonus points.  If the user specification refers to a parent
+    //  component, add up to that component only.  Don't accumulate scores
+    //  for parent matches, because many entries may have the same
+    //  ancestors but that doesn't imply they have the quality of all
+    //  children combined.
+    //
 
-        //
-        //  Determine if it's a match and we should add it.
-        //
+    if (UserSpecification->LengthInChars > 0 &&
+        YoriLibFindFirstMatchingSubstringInsensitive(&Directory->DirectoryName, 1, UserSpecification, &OffsetOfMatch) != NULL) {
 
-        YoriLibInitEmptyString(&FinalComponent);
-        YoriLibInitEmptyString(&TrailingPortion);
-        FinalComponent.StartOfString = YoriLibFindRightMostCharacter(&FoundRecentDir->DirectoryName, '\\');
+        SeperatorBefore = FALSE;
+        SeperatorAfter = FALSE;
 
-        if (FoundRecentDir->DirectoryName.LengthInChars >= UserSpecification->LengthInChars) {
-            TrailingPortion.StartOfString = &FoundRecentDir->DirectoryName.StartOfString[FoundRecentDir->DirectoryName.LengthInChars - UserSpecification->LengthInChars];
-            TrailingPortion.LengthInChars = UserSpecification->LengthInChars;
+        if (OffsetOfMatch == 0 ||
+            YoriLibIsSep(UserSpecification->StartOfString[0]) ||
+            YoriLibIsSep(Directory->DirectoryName.StartOfString[OffsetOfMatch - 1])) {
+            SeperatorBefore = TRUE;
         }
-        OffsetOfMatch = 0;
-
-        //
-        //  If it's a complete match of the final component, big bonus points.
-        //  If it's a match up to the end of the string, moderate bonus points.
-        //  If it's somewhere in the final component, small bonus points.
-        //
 
-        if (FinalComponent.StartOfString != NULL) {
-            FinalComponent.StartOfString++;
-            FinalComponent.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars - (DWORD)(FinalComponent.StartOfString - FoundRecentDir->DirectoryName.StartOfString);
-
-            if (YoriLibCompareStringInsensitive(&FinalComponent, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 4;
-                AddThisEntry = TRUE;
-            } else if (TrailingPortion.LengthInChars > 0 &&
-                       YoriLibCompareStringInsensitive(&TrailingPortion, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 2;
-                AddThisEntry = TRUE;
-            } else if (YoriLibFindFirstMatchingSubstringInsensitive(&FinalComponent, 1, UserSpecification, NULL) != NULL) {
-
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS;
-                AddThisEntry = TRUE;
-            }
+        if (OffsetOfMatch + UserSpecification->LengthInChars == Directory->DirectoryName.LengthInChars ||
+            YoriLibIsSep(UserSpecification->StartOfString[UserSpecification->LengthInChars - 1]) ||
+            YoriLibIsSep(Directory->DirectoryName.StartOfString[OffsetOfMatch + UserSpecification->LengthInChars])) {
+            SeperatorAfter = TRUE;
         }
 
         YoriLibInitEmptyString(&StringToAdd);
-        if (AddThisEntry) {
-            StringToAdd.StartOfString = FoundRecentDir->DirectoryName.StartOfString;
-            StringToAdd.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars;
+        StringToAdd.StartOfString = Directory->DirectoryName.StartOfString;
+        if (SeperatorBefore && SeperatorAfter) {
+            StringToAdd.LengthInChars = OffsetOfMatch + UserSpecification->LengthInChars;
+        } else {
+            StringToAdd.LengthInChars = Directory->DirectoryName.LengthInChars;
         }
 
-        //
-        //  If it's in the string but not the final component, add it, but
-        //  no bonus points.  If the user specification refers to a parent
-        //  component, add up to that component only.
-        //
+        return ZAddToScoreboard(Scoreboard, &StringToAdd, Frecency, FALSE);
+    }
 
-        if (!AddThisEntry &&
-            UserSpecification->LengthInChars > 0 &&
-            YoriLibFindFirstMatchingSubstringInsensitive(&FoundRecentDir->DirectoryName, 1, UserSpecification, &OffsetOfMatch) != NULL) {
+    return TRUE;
+}
 
-            SeperatorBefore = FALSE;
-            SeperatorAfter = FALSE;
+/**
+ Take any fully resolved path based on the user specification, and any
+ remembered directories that match the user specification, heuristically
+ assign each directory with a score, and return the entry with the highest
+ score.  If nothing matches the user specification, returns FALSE.
 
-            if (OffsetOfMatch == 0 ||
-                YoriLibIsSep(UserSpecification->StartOfString[0]) ||
-                YoriLibIsSep(FoundRecentDir->DirectoryName.StartOfString[OffsetOfMatch - 1])) {
-                SeperatorBefore = TRUE;
-            }
+ If the user specification does not contain a path seperator, any match
+ must be within a single path component, so the candidates are found by
+ searching the distinct components and following each matching component
+ to the directories that contain it.  This avoids examining every
+ remembered directory.
 
-            if (OffsetOfMatch + UserSpecification->LengthInChars == FoundRecentDir->DirectoryName.LengthInChars ||
-                YoriLibIsSep(UserSpecification->StartOfString[UserSpecification->LengthInChars - 1]) ||
-                YoriLibIsSep(FoundRecentDir->DirectoryName.StartOfString[OffsetOfMatch + UserSpecification->LengthInChars])) {
-                SeperatorAfter = TRUE;
-            }
+ @param UserSpecification Pointer to the user specification to match against.
 
-            StringToAdd.StartOfString = FoundRecentDir->DirectoryName.StartOfString;
-            if (SeperatorBefore && SeperatorAfter) {
-                StringToAdd.LengthInChars = OffsetOfMatch + UserSpecification->LengthInChars;
-            } else {
-                StringToAdd.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars;
-            }
-            AddThisEntry = TRUE;
-            FoundAsParentOnly = TRUE;
-        }
+ @param FullMatchToUserSpec Pointer to a string that is a fully qualified
+        path resovled by the UserSpecification.  This may be an empty string
+        if the user specification could not be resolved or resolved to an
+        object that does not exist.
 
-        //
-        //  If the currently found directory has already been added by the
-        //  fully resolved user specification or an earlier parent match,
-        //  don't add it twice.  If it's a high quality match, such as
-        //  against a user specification or final component, add the scores
-        //  together.  Don't do this if the match was against a parent
-        //  component, because many entries may have the same ancestors but
-        //  that doesn't imply they have the quality of all children
-        //  combined.
-        //
+ @param BestMatch On successful completion, updated to point to a referenced
+        string containing the best match for this directory change operation.
 
-        if (AddThisEntry) {
-            for (BestIndex = 0; BestIndex < EntriesPopulated; BestIndex++) {
-                if (YoriLibCompareStringInsensitive(&Entries[BestIndex].DirectoryName, &StringToAdd) == 0) {
+ @return TRUE if a match was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+ZBuildScoreboardAndSelectBest(
+    __in PYORI_STRING UserSpecification,
+    __in PYORI_STRING FullMatchToUserSpec,
+    __out PYORI_STRING BestMatch
+    )
+{
+    Z_SCOREBOARD Scoreboard;
+    PZ_SCOREBOARD_ENTRY Entry;
+    PZ_SCOREBOARD_ENTRY BestEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_COMPONENT Component;
+    PZ_DIRECTORY Directory;
+    DWORD Index;
+    DWORD DirIndex;
+    DWORD Now;
+    BOOL UseComponentIndex;
+    BOOL Result;
 
-                    if (!FoundAsParentOnly) {
-                        Entries[BestIndex].Score += ScoreForThisEntry;
-                    }
-                    AddThisEntry = FALSE;
-                    break;
-                }
+    Scoreboard.HashTable = YoriLibAllocateHashTable(1000);
+    if (Scoreboard.HashTable == NULL) {
+        return FALSE;
+    }
+    YoriLibInitializeListHead(&Scoreboard.EntryList);
+
+    Result = TRUE;
+
+    //
+    //  If we have a fully resolved match, add it unconditionally.  Don't
+    //  check if it matches the user specification - we already know it
+    //  does, and string compare might be misleading because the user
+    //  specification may not contain any matching string (eg. "..").
+    //
+
+    if (FullMatchToUserSpec->LengthInChars > 0) {
+        Result = ZAddToScoreboard(&Scoreboard, FullMatchToUserSpec, Z_RESOLVED_PATH_SCORE, TRUE);
+    }
+
+    UseComponentIndex = FALSE;
+    if (ZDatabase.ComponentIndexValid && UserSpecification->LengthInChars > 0) {
+        UseComponentIndex = TRUE;
+        for (Index = 0; Index < UserSpecification->LengthInChars; Index++) {
+            if (YoriLibIsSep(UserSpecification->StartOfString[Index])) {
+                UseComponentIndex = FALSE;
+                break;
             }
         }
+    }
 
-        //
-        //  If we should add it, go add it with the calculated score.
-        //
+    Now = ZCurrentTime();
+    ZDatabase.QueryGeneration++;
+
+    if (UseComponentIndex) {
+        for (Index = 0; Result && Index < ZDatabase.ComponentCount; Index++) {
+            Component = ZDatabase.Components[Index];
+            if (YoriLibFindFirstMatchingSubstringInsensitive(&Component->HashEntry.Key->String, 1, UserSpecification, NULL) == NULL) {
+                continue;
+            }
 
-        if (AddThisEntry) {
-            memcpy(&Entries[EntriesPopulated].DirectoryName, &StringToAdd, sizeof(YORI_STRING));
-            Entries[EntriesPopulated].Score = ScoreForThisEntry;
-            EntriesPopulated++;
+            for (DirIndex = 0; Result && DirIndex < Component->DirectoryCount; DirIndex++) {
+                Directory = Component->Directories[DirIndex];
+                if (Directory->QueryGeneration == ZDatabase.QueryGeneration) {
+                    continue;
+                }
+                Directory->QueryGeneration = ZDatabase.QueryGeneration;
+                Result = ZScoreDirectory(&Scoreboard, UserSpecification, Directory, Now);
+            }
         }
-        if (Index > 0) {
-            Index--;
+    } else {
+        for (Index = 0; Result && Index < ZDatabase.DirectoryCount; Index++) {
+            Result = ZScoreDirectory(&Scoreboard, UserSpecification, ZDatabase.Directories[Index], Now);
         }
     }
 
     //
-    //  If we have no matches, then we can't find anything that the user
-    //  would be happy with, so do nothing.
+    //  Find the highest score.  If we have no matches, then we can't find
+    //  anything that the user would be happy with, so do nothing.
     //
 
-    if (EntriesPopulated == 0) {
-        YoriLibFree(Entries);
-        return FALSE;
+    BestEntry = NULL;
+    ListEntry = YoriLibGetNextListEntry(&Scoreboard.EntryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, Z_SCOREBOARD_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Scoreboard.EntryList, ListEntry);
+        if (BestEntry == NULL || Entry->Score > BestEntry->Score) {
+            BestEntry = Entry;
+        }
     }
 
-    //
-    //  Find the highest score.
-    //
-
-    BestScore = 0;
-    BestIndex = 0;
-    for (Index = 0; Index < EntriesPopulated; Index++) {
-        if (BestScore == 0 || Entries[Index].Score > BestScore) {
-            BestScore = Entries[Index].Score;
-            BestIndex = Index;
-        }
+    if (!Result || BestEntry == NULL) {
+        ZFreeScoreboard(&Scoreboard);
+        return FALSE;
     }
 
     //
@@ -576,14 +1497,15 @@ ZBuildScoreboardAndSelectBest(
     //  NULL terminated at the correct point.
     //
 
-    if (!YoriLibAllocateString(BestMatch, Entries[BestIndex].DirectoryName.LengthInChars + 1)) {
+    if (!YoriLibAllocateString(BestMatch, BestEntry->DirectoryName.LengthInChars + 1)) {
+        ZFreeScoreboard(&Scoreboard);
         return FALSE;
     }
-    memcpy(BestMatch->StartOfString, Entries[BestIndex].DirectoryName.StartOfString, Entries[BestIndex].DirectoryName.LengthInChars * sizeof(TCHAR));
-    BestMatch->LengthInChars = Entries[BestIndex].DirectoryName.LengthInChars;
+    memcpy(BestMatch->StartOfString, BestEntry->DirectoryName.StartOfString, BestEntry->DirectoryName.LengthInChars * sizeof(TCHAR));
+    BestMatch->LengthInChars = BestEntry->DirectoryName.LengthInChars;
     BestMatch->StartOfString[BestMatch->LengthInChars] = '\0';
 
-    YoriLibFree(Entries);
+    ZFreeScoreboard(&Scoreboard);
     return TRUE;
 }
 
@@ -650,11 +1572,6 @@ YoriCmd_Z(
         }
     }
 
-    if (ListStack) {
-        ZListStack();
-        return EXIT_SUCCESS;
-    }
-
     if (Unload) {
         if (ZCallbacksRegistered) {
             YORI_STRING ZCmd;
@@ -665,6 +1582,31 @@ YoriCmd_Z(
         return EXIT_SUCCESS;
     }
 
+    //
+    //  Once the database is loaded, keep the module loaded so it is retained
+    //  and so the unload routine can save and free it.
+    //
+
+    if (!ZLoadDatabase()) {
+        return EXIT_FAILURE;
+    }
+
+    if (!ZCallbacksRegistered) {
+        YORI_STRING ZCmd;
+        YoriLibConstantString(&ZCmd, _T("Z"));
+        if (!YoriCallBuiltinRegister(&ZCmd, YoriCmd_Z)) {
+            ZNotifyUnload();
+            return EXIT_FAILURE;
+        }
+        YoriCallSetUnloadRoutine(ZNotifyUnload);
+        ZCallbacksRegistered = TRUE;
+    }
+
+    if (ListStack) {
+        ZListStack();
+        return EXIT_SUCCESS;
+    }
+
     if (StartArg == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("z: missing argument\n"));
         return EXIT_FAILURE;
@@ -751,16 +1693,6 @@ YoriCmd_Z(
     YoriLibFreeStringContents(&OldCurrentDirectory);
     YoriLibFreeStringContents(&BestMatch);
 
-    if (!ZCallbacksRegistered) {
-        YORI_STRING ZCmd;
-        YoriLibConstantString(&ZCmd, _T("Z"));
-        if (!YoriCallBuiltinRegister(&ZCmd, YoriCmd_Z)) {
-            return EXIT_FAILURE;
-        }
-        YoriCallSetUnloadRoutine(ZNotifyUnload);
-        ZCallbacksRegistered = TRUE;
-    }
-
     return EXIT_SUCCESS;
 }
 
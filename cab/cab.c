@@ -103,6 +103,18 @@ typedef struct _CAB_CREATE_CONTEXT {
      ExcludeList.
      */
     YORI_LIST_ENTRY IncludeList;
+
+    /**
+     The criteria in ExcludeList compiled into a single set, or NULL if
+     there are no criteria to exclude.
+     */
+    PYORILIB_GLOB_SET ExcludeSet;
+
+    /**
+     The criteria in IncludeList compiled into a single set, or NULL if
+     there are no criteria to include.
+     */
+    PYORILIB_GLOB_SET IncludeSet;
 } CAB_CREATE_CONTEXT, *PCAB_CREATE_CONTEXT;
 
 /**
@@ -185,6 +197,98 @@ CabCreateFreeMatchLists(
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, NULL);
     }
+
+    if (CreateContext->ExcludeSet != NULL) {
+        YoriLibGlobSetFree(CreateContext->ExcludeSet);
+        CreateContext->ExcludeSet = NULL;
+    }
+
+    if (CreateContext->IncludeSet != NULL) {
+        YoriLibGlobSetFree(CreateContext->IncludeSet);
+        CreateContext->IncludeSet = NULL;
+    }
+}
+
+/**
+ Compile a list of exclude or include criteria into a single set that can
+ be tested against each file with one query.
+
+ @param List Pointer to the list of criteria.
+
+ @param GlobSet On successful completion, updated to point to the compiled
+        set, or NULL if the list contains no criteria.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CabCreateCompileMatchList(
+    __in PYORI_LIST_ENTRY List,
+    __out PYORILIB_GLOB_SET *GlobSet
+    )
+{
+    PCAB_MATCH_ITEM MatchItem;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_STRING Patterns;
+    DWORD PatternCount;
+    BOOL Result;
+
+    *GlobSet = NULL;
+
+    PatternCount = 0;
+    ListEntry = YoriLibGetNextListEntry(List, NULL);
+    while (ListEntry != NULL) {
+        PatternCount++;
+        ListEntry = YoriLibGetNextListEntry(List, ListEntry);
+    }
+
+    if (PatternCount == 0) {
+        return TRUE;
+    }
+
+    Patterns = YoriLibMalloc(PatternCount * sizeof(YORI_STRING));
+    if (Patterns == NULL) {
+        return FALSE;
+    }
+
+    PatternCount = 0;
+    ListEntry = YoriLibGetNextListEntry(List, NULL);
+    while (ListEntry != NULL) {
+        MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
+        memcpy(&Patterns[PatternCount], &MatchItem->MatchCriteria, sizeof(YORI_STRING));
+        PatternCount++;
+        ListEntry = YoriLibGetNextListEntry(List, ListEntry);
+    }
+
+    Result = YoriLibGlobSetCompile(Patterns, PatternCount, GlobSet);
+    YoriLibFree(Patterns);
+    return Result;
+}
+
+/**
+ Compile the exclude and include criteria so each file can be tested
+ against all of them at once.
+
+ @param CreateContext Pointer to the create context containing the
+        criteria lists.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CabCreateCompileMatchLists(
+    __in PCAB_CREATE_CONTEXT CreateContext
+    )
+{
+    if (!CabCreateCompileMatchList(&CreateContext->ExcludeList, &CreateContext->ExcludeSet)) {
+        return FALSE;
+    }
+
+    if (!CabCreateCompileMatchList(&CreateContext->IncludeList, &CreateContext->IncludeSet)) {
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 /**
@@ -205,27 +309,19 @@ CabCreateShouldExclude(
     __in PYORI_STRING RelativePath
     )
 {
-    PCAB_MATCH_ITEM MatchItem;
-    PYORI_LIST_ENTRY ListEntry;
+    if (CreateContext->ExcludeSet == NULL ||
+        !YoriLibGlobSetMatch(CreateContext->ExcludeSet, RelativePath, NULL)) {
 
-    ListEntry = YoriLibGetNextListEntry(&CreateContext->ExcludeList, NULL);
-    while (ListEntry != NULL) {
-        MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
-
-            ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, NULL);
-            while (ListEntry != NULL) {
-                MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
-                    return FALSE;
-                }
-                ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, ListEntry);
-            }
-            return TRUE;
-        }
-        ListEntry = YoriLibGetNextListEntry(&CreateContext->ExcludeList, ListEntry);
+        return FALSE;
     }
-    return FALSE;
+
+    if (CreateContext->IncludeSet != NULL &&
+        YoriLibGlobSetMatch(CreateContext->IncludeSet, RelativePath, NULL)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 /**
@@ -645,6 +741,11 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN;
         }
 
+        if (!CabCreateCompileMatchLists(&CreateContext)) {
+            CabCreateFreeMatchLists(&CreateContext);
+            return EXIT_FAILURE;
+        }
+
         for (i = StartArg; i < ArgC; i++) {
             YoriLibForEachFile(&ArgV[i],
                                MatchFlags,
@@ -682,6 +783,12 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN;
         }
 
+        if (!CabCreateCompileMatchLists(&CreateContext)) {
+            YoriLibCloseCab(CreateContext.CabHandle);
+            CabCreateFreeMatchLists(&CreateContext);
+            return EXIT_FAILURE;
+        }
+
         for (i = StartArg + 1; i < ArgC; i++) {
             YoriLibForEachFile(&ArgV[i],
                                MatchFlags,
@@ -59,7 +59,8 @@ CoHelp()
 typedef struct _CO_FOUND_FILE {
 
     /**
-     The found file link within the list of found files.
+     The found file link within the list of files which have been found by
+     the enumeration thread but not yet added to the list control.
      */
     YORI_LIST_ENTRY ListEntry;
 
@@ -90,6 +91,17 @@ typedef struct _CO_FOUND_FILE {
      */
     BOOLEAN IsDirectory;
 
+    /**
+     TRUE if the object was selected in the list control when the list was
+     last rearranged, so that its selection can be restored.
+     */
+    BOOLEAN Selected;
+
+    /**
+     TRUE if the object no longer exists and should be removed from the list.
+     */
+    BOOLEAN Removed;
+
 } CO_FOUND_FILE, *PCO_FOUND_FILE;
 
 /**
@@ -109,15 +121,27 @@ typedef enum _CO_SORT_TYPE {
 typedef struct _CO_CONTEXT {
 
     /**
-     A linked list of the files that have been found.
+     A linked list of the files that have been found by the enumeration
+     thread and not yet added to the list control.  This is protected by
+     PendingFilesMutex.
+     */
+    YORI_LIST_ENTRY PendingFiles;
+
+    /**
+     The number of files in PendingFiles.
      */
-    YORI_LIST_ENTRY FilesFound;
+    DWORD PendingFilesCount;
 
     /**
-     The number of files that have been found.
+     The number of files that have been added to the list control.
      */
     DWORD FilesFoundCount;
 
+    /**
+     The number of elements allocated in FileArray.
+     */
+    DWORD FileArraySize;
+
     /**
      The sort order currently being applied.  Note this is not reset in
      CoFreeContext, because it needs to be preserved across repopulation.
@@ -130,86 +154,165 @@ typedef struct _CO_CONTEXT {
     PYORI_WIN_CTRL_HANDLE List;
 
     /**
-     The same list as above, arranged into a flat array form to match the
+     The files that have been added to the list control, sorted to match the
      addressing of the list control.
      */
     PCO_FOUND_FILE* FileArray;
 
+    /**
+     The full path to the directory being displayed.
+     */
+    YORI_STRING Directory;
+
+    /**
+     A handle to the thread enumerating the directory.  NULL if no
+     enumeration is in progress.
+     */
+    HANDLE EnumerateThread;
+
+    /**
+     A mutex protecting PendingFiles.
+     */
+    HANDLE PendingFilesMutex;
+
+    /**
+     An event signalled by the enumeration thread when files are added to
+     PendingFiles.
+     */
+    HANDLE FilesFoundEvent;
+
+    /**
+     An event signalled to indicate that the enumeration thread should stop.
+     */
+    HANDLE ShutdownEvent;
+
     /**
      Pointer to the window manager.
      */
     PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr;
 } CO_CONTEXT, *PCO_CONTEXT;
 
+/**
+ Free a single found file.
 
+ @param FoundFile Pointer to the found file to free.
+ */
+VOID
+CoFreeFoundFile(
+    __in PCO_FOUND_FILE FoundFile
+    )
+{
+    YoriLibFreeStringContents(&FoundFile->DisplayName);
+    YoriLibFreeStringContents(&FoundFile->FullFilePath);
+    YoriLibDereference(FoundFile);
+}
 
 /**
- Free all found files in the list.
+ Free a list of found files.
 
- @param CoContext Pointer to the context of found files to free.
+ @param ListHead Pointer to the list of found files to free.
  */
 VOID
-CoFreeContext(
-    __in PCO_CONTEXT CoContext
+CoFreeFileList(
+    __in PYORI_LIST_ENTRY ListHead
     )
 {
     PYORI_LIST_ENTRY ListEntry;
     PCO_FOUND_FILE FoundFile;
 
     ListEntry = NULL;
-    ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
+    ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
     while (ListEntry != NULL) {
         FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
 
         YoriLibRemoveListItem(&FoundFile->ListEntry);
-        YoriLibFreeStringContents(&FoundFile->DisplayName);
-        YoriLibFreeStringContents(&FoundFile->FullFilePath);
-        YoriLibDereference(FoundFile);
+        CoFreeFoundFile(FoundFile);
     }
+}
+
+/**
+ Free all found files in the list.  The enumeration thread must have been
+ stopped before calling this function.
+
+ @param CoContext Pointer to the context of found files to free.
+ */
+VOID
+CoFreeContext(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    DWORD Index;
+
+    ASSERT(CoContext->EnumerateThread == NULL);
+
+    CoFreeFileList(&CoContext->PendingFiles);
+    CoContext->PendingFilesCount = 0;
 
     if (CoContext->FileArray != NULL) {
+        for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+            CoFreeFoundFile(CoContext->FileArray[Index]);
+        }
         YoriLibFree(CoContext->FileArray);
         CoContext->FileArray = NULL;
     }
 
+    YoriLibFreeStringContents(&CoContext->Directory);
     CoContext->FilesFoundCount = 0;
-    CoContext->WinMgr = NULL;
+    CoContext->FileArraySize = 0;
 }
 
 /**
- A callback that is invoked when a file is found that should be added to the
- list.
+ Close the handles used to communicate with the enumeration thread.  The
+ enumeration thread must have been stopped before calling this function.
 
- @param FilePath Pointer to the file path that was found.
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoCloseHandles(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    ASSERT(CoContext->EnumerateThread == NULL);
 
- @param FileInfo Information about the file.
+    if (CoContext->PendingFilesMutex != NULL) {
+        CloseHandle(CoContext->PendingFilesMutex);
+        CoContext->PendingFilesMutex = NULL;
+    }
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+    if (CoContext->FilesFoundEvent != NULL) {
+        CloseHandle(CoContext->FilesFoundEvent);
+        CoContext->FilesFoundEvent = NULL;
+    }
 
- @param Context Pointer to the co context specifying the list to populate
-        with found files.
+    if (CoContext->ShutdownEvent != NULL) {
+        CloseHandle(CoContext->ShutdownEvent);
+        CoContext->ShutdownEvent = NULL;
+    }
+}
 
- @return TRUE to continute enumerating, FALSE to abort.
+/**
+ Allocate a found file structure describing a file.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param FileInfo Information about the file.
+
+ @return Pointer to the found file, or NULL on allocation failure.
  */
-BOOL
-CoFileFoundCallback(
+PCO_FOUND_FILE
+CoAllocateFoundFile(
     __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+    __in PWIN32_FIND_DATA FileInfo
     )
 {
-    PCO_CONTEXT CoContext = (PCO_CONTEXT)Context;
     PCO_FOUND_FILE FoundFile;
     DWORD DisplayNameLength;
 
-    UNREFERENCED_PARAMETER(Depth);
-
     DisplayNameLength = _tcslen(FileInfo->cFileName);
     FoundFile = YoriLibReferencedMalloc(sizeof(CO_FOUND_FILE) + (DisplayNameLength + 1 + FilePath->LengthInChars + 1) * sizeof(TCHAR));
     if (FoundFile == NULL) {
-        return FALSE;
+        return NULL;
     }
 
     YoriLibInitEmptyString(&FoundFile->DisplayName);
@@ -244,122 +347,525 @@ CoFileFoundCallback(
         FoundFile->IsDirectory = FALSE;
     }
 
-    YoriLibAppendList(&CoContext->FilesFound, &FoundFile->ListEntry);
-    CoContext->FilesFoundCount++;
+    FoundFile->Selected = FALSE;
+    FoundFile->Removed = FALSE;
+
+    return FoundFile;
+}
+
+/**
+ A callback that is invoked on the enumeration thread when a file is found
+ that should be added to the list.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the co context specifying the list to populate
+        with found files.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+CoFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PCO_CONTEXT CoContext = (PCO_CONTEXT)Context;
+    PCO_FOUND_FILE FoundFile;
+    BOOLEAN WasEmpty;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    if (WaitForSingleObject(CoContext->ShutdownEvent, 0) == WAIT_OBJECT_0) {
+        return FALSE;
+    }
+
+    FoundFile = CoAllocateFoundFile(FilePath, FileInfo);
+    if (FoundFile == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Only wake the UI when the pending list becomes nonempty.  While the
+    //  UI is busy adding one batch, the next one accumulates, so the batch
+    //  size adapts to how quickly the UI can keep up.
+    //
+
+    WaitForSingleObject(CoContext->PendingFilesMutex, INFINITE);
+    WasEmpty = (BOOLEAN)(CoContext->PendingFilesCount == 0);
+    YoriLibAppendList(&CoContext->PendingFiles, &FoundFile->ListEntry);
+    CoContext->PendingFilesCount++;
+    ReleaseMutex(CoContext->PendingFilesMutex);
+
+    if (WasEmpty) {
+        SetEvent(CoContext->FilesFoundEvent);
+    }
+
     return TRUE;
 }
 
 /**
- Populate in memory structures and the UI list with found files.
+ A background thread which enumerates the directory being displayed and
+ queues found files for the UI to add to the list.
 
- @param CoContext Pointer to the context to populate with found files.
+ @param Context Pointer to the co context.
+
+ @return Exit code for the thread, which is always zero.
+ */
+DWORD WINAPI
+CoEnumerateThread(
+    __in LPVOID Context
+    )
+{
+    PCO_CONTEXT CoContext = (PCO_CONTEXT)Context;
+    YORI_STRING FileSpec;
+
+    YoriLibInitEmptyString(&FileSpec);
+    if (CoContext->Directory.LengthInChars > 0 &&
+        CoContext->Directory.StartOfString[CoContext->Directory.LengthInChars - 1] == '\\') {
+
+        YoriLibYPrintf(&FileSpec, _T("%y*"), &CoContext->Directory);
+    } else {
+        YoriLibYPrintf(&FileSpec, _T("%y\\*"), &CoContext->Directory);
+    }
+
+    if (FileSpec.LengthInChars > 0) {
+        YoriLibForEachFile(&FileSpec, YORILIB_FILEENUM_BASIC_EXPANSION | YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES, 0, CoFileFoundCallback, NULL, CoContext);
+    }
+
+    YoriLibFreeStringContents(&FileSpec);
+    return 0;
+}
+
+/**
+ Stop any enumeration that is in progress and wait for the enumeration
+ thread to terminate.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoStopEnumeration(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    if (CoContext->EnumerateThread != NULL) {
+        SetEvent(CoContext->ShutdownEvent);
+        WaitForSingleObject(CoContext->EnumerateThread, INFINITE);
+        CloseHandle(CoContext->EnumerateThread);
+        CoContext->EnumerateThread = NULL;
+        ResetEvent(CoContext->ShutdownEvent);
+    }
+}
+
+/**
+ Compare two found files according to the current sort order.
+
+ @param CoContext Pointer to the co context specifying the sort order.
+
+ @param Left Pointer to the first file to compare.
+
+ @param Right Pointer to the second file to compare.
+
+ @return Less than zero if Left should be displayed before Right, greater
+         than zero if Right should be displayed before Left, or zero if
+         they are equal.
+ */
+int
+CoCompareFiles(
+    __in PCO_CONTEXT CoContext,
+    __in PCO_FOUND_FILE Left,
+    __in PCO_FOUND_FILE Right
+    )
+{
+    if (CoContext->SortType == CoSortBySize) {
+        if (Left->FileSize.QuadPart < Right->FileSize.QuadPart) {
+            return -1;
+        } else if (Left->FileSize.QuadPart > Right->FileSize.QuadPart) {
+            return 1;
+        }
+    } else if (CoContext->SortType == CoSortByDate) {
+        if (Left->WriteTime.QuadPart < Right->WriteTime.QuadPart) {
+            return -1;
+        } else if (Left->WriteTime.QuadPart > Right->WriteTime.QuadPart) {
+            return 1;
+        }
+    }
+
+    return YoriLibCompareStringInsensitive(&Left->DisplayName, &Right->DisplayName);
+}
+
+/**
+ Sort an array of found files according to the current sort order.  This is
+ a merge sort, so that large directories can be sorted quickly.
+
+ @param CoContext Pointer to the co context specifying the sort order.
+
+ @param Files Pointer to the array of files to sort.
+
+ @param Count The number of elements in the array.
+
+ @param Temp Pointer to an array of at least Count elements which can be used
+        as scratch space during the sort.
+ */
+VOID
+CoSortFiles(
+    __in PCO_CONTEXT CoContext,
+    __inout PCO_FOUND_FILE *Files,
+    __in DWORD Count,
+    __in PCO_FOUND_FILE *Temp
+    )
+{
+    PCO_FOUND_FILE *Source;
+    PCO_FOUND_FILE *Target;
+    PCO_FOUND_FILE *Swap;
+    DWORD Width;
+    DWORD Start;
+    DWORD Middle;
+    DWORD End;
+    DWORD LeftIndex;
+    DWORD RightIndex;
+    DWORD Index;
+
+    Source = Files;
+    Target = Temp;
+
+    for (Width = 1; Width < Count; Width = Width * 2) {
+        for (Start = 0; Start < Count; Start = Start + 2 * Width) {
+            Middle = Start + Width;
+            if (Middle > Count) {
+                Middle = Count;
+            }
+            End = Middle + Width;
+            if (End > Count) {
+                End = Count;
+            }
+
+            LeftIndex = Start;
+            RightIndex = Middle;
+            for (Index = Start; Index < End; Index++) {
+                if (LeftIndex < Middle &&
+                    (RightIndex >= End || CoCompareFiles(CoContext, Source[LeftIndex], Source[RightIndex]) <= 0)) {
+
+                    Target[Index] = Source[LeftIndex];
+                    LeftIndex++;
+                } else {
+                    Target[Index] = Source[RightIndex];
+                    RightIndex++;
+                }
+            }
+        }
+
+        Swap = Source;
+        Source = Target;
+        Target = Swap;
+    }
+
+    if (Source != Files) {
+        memcpy(Files, Source, Count * sizeof(PCO_FOUND_FILE));
+    }
+}
+
+/**
+ Record which files are selected in the list control and which file is
+ active, and clear the selection from the list control.  This is done before
+ the file array is rearranged so that selection can be restored to the same
+ files afterwards.
+
+ @param CoContext Pointer to the co context.
+
+ @return Pointer to the file which is currently active, or NULL if no file is
+         active.
+ */
+PCO_FOUND_FILE
+CoSaveSelection(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    DWORD Index;
+    PCO_FOUND_FILE FoundFile;
+
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        FoundFile = CoContext->FileArray[Index];
+        FoundFile->Selected = FALSE;
+        if (YoriWinListIsOptionSelected(CoContext->List, Index)) {
+            FoundFile->Selected = TRUE;
+            YoriWinListSetOptionSelected(CoContext->List, Index, FALSE);
+        }
+    }
+
+    if (YoriWinListGetActiveOption(CoContext->List, &Index) &&
+        Index < CoContext->FilesFoundCount) {
+
+        return CoContext->FileArray[Index];
+    }
+
+    return NULL;
+}
+
+/**
+ Update the list control to reflect the current file array, restoring the
+ selection saved by @ref CoSaveSelection .
+
+ @param CoContext Pointer to the co context.
+
+ @param ActiveFile Optionally points to the file which should be active.
+ */
+VOID
+CoRestoreSelection(
+    __in PCO_CONTEXT CoContext,
+    __in_opt PCO_FOUND_FILE ActiveFile
+    )
+{
+    DWORD Index;
+    PCO_FOUND_FILE FoundFile;
+
+    YoriWinListSetVirtualItemCount(CoContext->List, CoContext->FilesFoundCount);
+
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        FoundFile = CoContext->FileArray[Index];
+        if (FoundFile->Selected) {
+            YoriWinListSetOptionSelected(CoContext->List, Index, TRUE);
+        }
+        if (FoundFile == ActiveFile) {
+            YoriWinListSetActiveOption(CoContext->List, Index);
+        }
+    }
+}
+
+/**
+ Add a list of newly found files into the sorted file array and the list
+ control.  The new files are sorted and merged into the array, so the cost of
+ each addition is linear in the number of files already found, and the list
+ control moves the selection of existing files to their new positions.  On
+ success, the files are removed from the list and owned by the array; on
+ failure, they are freed.
+
+ @param CoContext Pointer to the co context.
+
+ @param NewFiles Pointer to the list of new files.
+
+ @param NewCount The number of files in the list.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-CoPopulateList(
-    __in PCO_CONTEXT CoContext
+CoInsertFiles(
+    __in PCO_CONTEXT CoContext,
+    __in PYORI_LIST_ENTRY NewFiles,
+    __in DWORD NewCount
     )
 {
-    YORI_STRING FileSpec;
-    PYORI_STRING DisplayArray;
-    DWORD Index;
-    DWORD SubIndex;
-    DWORD BestIndex;
+    PCO_FOUND_FILE *NewArray;
+    PCO_FOUND_FILE *Temp;
+    PCO_FOUND_FILE *Batch;
+    PDWORD InsertIndexes;
     PYORI_LIST_ENTRY ListEntry;
     PCO_FOUND_FILE FoundFile;
-    PCO_FOUND_FILE CompareFile;
-    PCO_FOUND_FILE BestFile;
-
-    YoriLibConstantString(&FileSpec, _T("*"));
-    YoriLibForEachFile(&FileSpec, YORILIB_FILEENUM_BASIC_EXPANSION | YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES, 0, CoFileFoundCallback, NULL, CoContext);
+    DWORD NewSize;
+    DWORD Index;
+    DWORD OldIndex;
+    DWORD NewIndex;
+    DWORD DestIndex;
 
-    if (CoContext->FilesFoundCount == 0) {
+    if (NewCount == 0) {
         return TRUE;
     }
 
-    DisplayArray = YoriLibMalloc(sizeof(YORI_STRING) * CoContext->FilesFoundCount);
-    if (DisplayArray == NULL) {
+    //
+    //  Grow the array geometrically so that a stream of small additions does
+    //  not reallocate for each one.
+    //
+
+    if (CoContext->FilesFoundCount + NewCount > CoContext->FileArraySize) {
+        NewSize = CoContext->FileArraySize * 2;
+        if (NewSize < CoContext->FilesFoundCount + NewCount) {
+            NewSize = CoContext->FilesFoundCount + NewCount;
+        }
+        if (NewSize < 256) {
+            NewSize = 256;
+        }
+
+        NewArray = YoriLibMalloc(NewSize * sizeof(PCO_FOUND_FILE));
+        if (NewArray == NULL) {
+            CoFreeFileList(NewFiles);
+            return FALSE;
+        }
+
+        if (CoContext->FileArray != NULL) {
+            memcpy(NewArray, CoContext->FileArray, CoContext->FilesFoundCount * sizeof(PCO_FOUND_FILE));
+            YoriLibFree(CoContext->FileArray);
+        }
+
+        CoContext->FileArray = NewArray;
+        CoContext->FileArraySize = NewSize;
+    }
+
+    Temp = YoriLibMalloc(NewCount * sizeof(PCO_FOUND_FILE));
+    if (Temp == NULL) {
+        CoFreeFileList(NewFiles);
         return FALSE;
     }
 
-    CoContext->FileArray = YoriLibMalloc(sizeof(PCO_FOUND_FILE) * CoContext->FilesFoundCount);
-    if (CoContext->FileArray == NULL) {
-        YoriLibDereference(DisplayArray);
+    InsertIndexes = YoriLibMalloc(NewCount * sizeof(DWORD));
+    if (InsertIndexes == NULL) {
+        YoriLibFree(Temp);
+        CoFreeFileList(NewFiles);
         return FALSE;
     }
 
     //
-    //  Arrange the files into a flat array
+    //  Place the new files after the existing ones and sort them.
     //
 
-    ListEntry = NULL;
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
+    Batch = &CoContext->FileArray[CoContext->FilesFoundCount];
+    for (Index = 0; Index < NewCount; Index++) {
+        ListEntry = YoriLibGetNextListEntry(NewFiles, NULL);
+        ASSERT(ListEntry != NULL);
         FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
-        CoContext->FileArray[Index] = FoundFile;
+        YoriLibRemoveListItem(&FoundFile->ListEntry);
+        Batch[Index] = FoundFile;
     }
 
+    CoSortFiles(CoContext, Batch, NewCount, Temp);
+
     //
-    //  Sort the array based on the selected sort criteria
+    //  Merge the two sorted runs, starting from the end so that existing
+    //  files are moved at most once.  Record where each new file lands so
+    //  the list control can be told where items were inserted.
     //
 
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        FoundFile = CoContext->FileArray[Index];
-        BestFile = FoundFile;
-        BestIndex = Index;
-        for (SubIndex = Index + 1; SubIndex < CoContext->FilesFoundCount; SubIndex++) {
-            CompareFile = CoContext->FileArray[SubIndex];
-            if (CoContext->SortType == CoSortByName) {
-                if (YoriLibCompareStringInsensitive(&CompareFile->DisplayName, &BestFile->DisplayName) < 0) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            } else if (CoContext->SortType == CoSortBySize) {
-                if (CompareFile->FileSize.QuadPart < BestFile->FileSize.QuadPart) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            } else if (CoContext->SortType == CoSortByDate) {
-                if (CompareFile->WriteTime.QuadPart < BestFile->WriteTime.QuadPart) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            }
+    memcpy(Temp, Batch, NewCount * sizeof(PCO_FOUND_FILE));
+    OldIndex = CoContext->FilesFoundCount;
+    NewIndex = NewCount;
+    DestIndex = CoContext->FilesFoundCount + NewCount;
+    while (NewIndex > 0) {
+        DestIndex--;
+        if (OldIndex > 0 &&
+            CoCompareFiles(CoContext, CoContext->FileArray[OldIndex - 1], Temp[NewIndex - 1]) > 0) {
+
+            OldIndex--;
+            CoContext->FileArray[DestIndex] = CoContext->FileArray[OldIndex];
+        } else {
+            NewIndex--;
+            CoContext->FileArray[DestIndex] = Temp[NewIndex];
+            InsertIndexes[NewIndex] = DestIndex;
         }
+    }
+
+    YoriLibFree(Temp);
+    CoContext->FilesFoundCount = CoContext->FilesFoundCount + NewCount;
+    YoriWinListInsertVirtualItems(CoContext->List, InsertIndexes, NewCount);
+    YoriLibFree(InsertIndexes);
+    return TRUE;
+}
+
+/**
+ Remove any files marked as removed from the file array.
 
-        if (BestIndex != Index) {
-            CoContext->FileArray[BestIndex] = CoContext->FileArray[Index];
-            CoContext->FileArray[Index] = BestFile;
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoCompactFiles(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    DWORD Index;
+    DWORD DestIndex;
+    PCO_FOUND_FILE FoundFile;
+
+    DestIndex = 0;
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        FoundFile = CoContext->FileArray[Index];
+        if (FoundFile->Removed) {
+            CoFreeFoundFile(FoundFile);
+        } else {
+            CoContext->FileArray[DestIndex] = FoundFile;
+            DestIndex++;
         }
     }
 
-    //
-    //  Generate the display array string based on the result of the sort
-    //
+    CoContext->FilesFoundCount = DestIndex;
+}
 
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        memcpy(&DisplayArray[Index], &CoContext->FileArray[Index]->DisplayName, sizeof(YORI_STRING));
+/**
+ A callback invoked by the list control to obtain the string to display for
+ an item.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param Index The index of the item to display.
+
+ @param Context Pointer to the co context specifying the files found.
+
+ @param String On successful completion, populated with the string to
+        display.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CoGetListItem(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD Index,
+    __in PVOID Context,
+    __out PYORI_STRING String
+    )
+{
+    PCO_CONTEXT CoContext = (PCO_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(CtrlHandle);
+
+    if (CoContext->FileArray == NULL || Index >= CoContext->FilesFoundCount) {
+        return FALSE;
     }
 
-    //
-    //  Populate the list with the result
-    //
+    YoriLibCloneString(String, &CoContext->FileArray[Index]->DisplayName);
+    return TRUE;
+}
+
+/**
+ Start populating the UI list with found files.  Files are found on a
+ background thread and added to the list as they arrive, so the list is
+ usable before enumeration completes.
+
+ @param CoContext Pointer to the context to populate with found files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CoPopulateList(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    YORI_STRING CurrentDirectory;
+    DWORD ThreadId;
 
-    if (!YoriWinListAddItems(CoContext->List, DisplayArray, CoContext->FilesFoundCount)) {
-        YoriLibDereference(DisplayArray);
+    ASSERT(CoContext->EnumerateThread == NULL);
+
+    YoriLibConstantString(&CurrentDirectory, _T("."));
+    YoriLibFreeStringContents(&CoContext->Directory);
+    if (!YoriLibUserStringToSingleFilePath(&CurrentDirectory, TRUE, &CoContext->Directory)) {
+        return FALSE;
+    }
+
+    CoContext->EnumerateThread = CreateThread(NULL, 0, CoEnumerateThread, CoContext, 0, &ThreadId);
+    if (CoContext->EnumerateThread == NULL) {
         return FALSE;
     }
 
-    YoriLibFree(DisplayArray);
     return TRUE;
 }
 
 /**
- Clear the contents of the list and start over.  This isn't a great user
- experience because of how it affects the view region.  We'll want something
- better.
+ Clear the contents of the list and start over.  This is used when the
+ directory being displayed changes.
 
  @param CoContext Pointer to context about files to display and the list to
         display them in.
@@ -372,11 +878,175 @@ CoRepopulateList(
     __in PCO_CONTEXT CoContext
     )
 {
-    CoFreeContext(CoContext);
+    CoStopEnumeration(CoContext);
     YoriWinListClearAllItems(CoContext->List);
+    CoFreeContext(CoContext);
     return CoPopulateList(CoContext);
 }
 
+/**
+ Add any files found by the enumeration thread into the list control.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoMergePendingFiles(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    YORI_LIST_ENTRY NewFiles;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD NewCount;
+
+    //
+    //  Take everything that is pending so the enumeration thread can keep
+    //  going while the files are sorted into place.
+    //
+
+    YoriLibInitializeListHead(&NewFiles);
+    WaitForSingleObject(CoContext->PendingFilesMutex, INFINITE);
+    NewCount = CoContext->PendingFilesCount;
+    ListEntry = YoriLibGetNextListEntry(&CoContext->PendingFiles, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&NewFiles, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&CoContext->PendingFiles, NULL);
+    }
+    CoContext->PendingFilesCount = 0;
+    ReleaseMutex(CoContext->PendingFilesMutex);
+
+    if (NewCount == 0) {
+        return;
+    }
+
+    CoInsertFiles(CoContext, &NewFiles, NewCount);
+}
+
+/**
+ Reapply the current sort order to the files already in the list.
+
+ @param CoContext Pointer to the co context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CoResortList(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    PCO_FOUND_FILE *Temp;
+    PCO_FOUND_FILE ActiveFile;
+
+    if (CoContext->FilesFoundCount == 0) {
+        return TRUE;
+    }
+
+    Temp = YoriLibMalloc(CoContext->FilesFoundCount * sizeof(PCO_FOUND_FILE));
+    if (Temp == NULL) {
+        return FALSE;
+    }
+
+    ActiveFile = CoSaveSelection(CoContext);
+    CoSortFiles(CoContext, CoContext->FileArray, CoContext->FilesFoundCount, Temp);
+    CoRestoreSelection(CoContext, ActiveFile);
+    YoriLibFree(Temp);
+    return TRUE;
+}
+
+/**
+ Remove any files which have been marked as removed from the list control,
+ preserving the selection of the remaining files.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoRemoveMarkedFiles(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    PCO_FOUND_FILE ActiveFile;
+    PDWORD RemoveIndexes;
+    DWORD RemoveCount;
+    DWORD Index;
+
+    RemoveCount = 0;
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        if (CoContext->FileArray[Index]->Removed) {
+            RemoveCount++;
+        }
+    }
+
+    if (RemoveCount == 0) {
+        return;
+    }
+
+    //
+    //  Tell the list control which items are going away so it can move the
+    //  selection of the remaining items.  If that isn't possible, fall back
+    //  to saving and restoring the selection of every file.
+    //
+
+    RemoveIndexes = YoriLibMalloc(RemoveCount * sizeof(DWORD));
+    if (RemoveIndexes != NULL) {
+        RemoveCount = 0;
+        for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+            if (CoContext->FileArray[Index]->Removed) {
+                RemoveIndexes[RemoveCount] = Index;
+                RemoveCount++;
+            }
+        }
+
+        CoCompactFiles(CoContext);
+        YoriWinListRemoveVirtualItems(CoContext->List, RemoveIndexes, RemoveCount);
+        YoriLibFree(RemoveIndexes);
+        return;
+    }
+
+    ActiveFile = CoSaveSelection(CoContext);
+    if (ActiveFile != NULL && ActiveFile->Removed) {
+        ActiveFile = NULL;
+    }
+    CoCompactFiles(CoContext);
+    CoRestoreSelection(CoContext, ActiveFile);
+}
+
+/**
+ Returns TRUE if the specified directory is the directory being displayed.
+
+ @param CoContext Pointer to the co context.
+
+ @param Directory Pointer to the full path to a directory.
+
+ @return TRUE if the directory is the one being displayed, FALSE if it is
+         not.
+ */
+BOOLEAN
+CoIsDisplayedDirectory(
+    __in PCO_CONTEXT CoContext,
+    __in PYORI_STRING Directory
+    )
+{
+    YORI_STRING Trimmed;
+
+    YoriLibInitEmptyString(&Trimmed);
+    Trimmed.StartOfString = Directory->StartOfString;
+    Trimmed.LengthInChars = Directory->LengthInChars;
+    if (Trimmed.LengthInChars > 0 &&
+        Trimmed.StartOfString[Trimmed.LengthInChars - 1] == '\\' &&
+        (CoContext->Directory.LengthInChars == 0 ||
+         CoContext->Directory.StartOfString[CoContext->Directory.LengthInChars - 1] != '\\')) {
+
+        Trimmed.LengthInChars--;
+    }
+
+    if (YoriLibCompareStringInsensitive(&Trimmed, &CoContext->Directory) == 0) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 /**
  Verify that a file is selected.  If no file is selected, display a dialog
  letting the user know.
@@ -548,6 +1218,21 @@ CoExitButtonClicked(
  */
 CO_CONTEXT CoContext;
 
+/**
+ Invoked on the UI thread when the enumeration thread has found files.  The
+ files found so far are merged into the list control.
+
+ @param WindowHandle Pointer to the window.
+ */
+VOID
+CoFilesFoundSignalled(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    UNREFERENCED_PARAMETER(WindowHandle);
+    CoMergePendingFiles(&CoContext);
+}
+
 /**
  A callback invoked when the change directory button is clicked.
 
@@ -657,11 +1342,12 @@ CoDeleteButtonClicked(
                 YoriLibFreeStringContents(&Label);
                 break;
             }
+            CoContext.FileArray[Index]->Removed = TRUE;
             ListChanged = TRUE;
         }
     }
     if (ListChanged) {
-        CoRepopulateList(&CoContext);
+        CoRemoveMarkedFiles(&CoContext);
     }
 }
 
@@ -684,6 +1370,7 @@ CoMoveButtonClicked(
     YORI_STRING FullDest;
     DWORD Index;
     BOOLEAN ListChanged = FALSE;
+    BOOLEAN TargetIsDisplayed;
     YORI_STRING Buttons[1];
     YORI_STRING Title;
     YORI_STRING Label;
@@ -703,6 +1390,8 @@ CoMoveButtonClicked(
         return;
     }
 
+    TargetIsDisplayed = CoIsDisplayedDirectory(&CoContext, &FullDir);
+
     ListChanged = FALSE;
     for (Index = 0; Index < CoContext.FilesFoundCount; Index++) {
         if (YoriWinListIsOptionSelected(CoContext.List, Index)) {
@@ -728,7 +1417,16 @@ CoMoveButtonClicked(
                 }
                 break;
             }
-            ListChanged = TRUE;
+
+            //
+            //  A file moved out of the displayed directory is no longer
+            //  displayed.  A file moved within it is unchanged.
+            //
+
+            if (!TargetIsDisplayed) {
+                CoContext.FileArray[Index]->Removed = TRUE;
+                ListChanged = TRUE;
+            }
         }
     }
 
@@ -736,7 +1434,7 @@ CoMoveButtonClicked(
     YoriLibFreeStringContents(&FullDir);
 
     if (ListChanged) {
-        CoRepopulateList(&CoContext);
+        CoRemoveMarkedFiles(&CoContext);
     }
 }
 
@@ -753,7 +1451,6 @@ CoCopyButtonClicked(
     YORI_STRING FullDir;
     YORI_STRING FullDest;
     DWORD Index;
-    BOOLEAN ListChanged = FALSE;
     YORI_STRING Buttons[1];
     YORI_STRING Title;
     YORI_STRING Label;
@@ -773,7 +1470,6 @@ CoCopyButtonClicked(
         return;
     }
 
-    ListChanged = FALSE;
     for (Index = 0; Index < CoContext.FilesFoundCount; Index++) {
         if (YoriWinListIsOptionSelected(CoContext.List, Index)) {
             FullDest.LengthInChars = YoriLibSPrintfS(FullDest.StartOfString, FullDest.LengthAllocated, _T("%y\\%y"), &FullDir, &CoContext.FileArray[Index]->DisplayName);
@@ -798,17 +1494,16 @@ CoCopyButtonClicked(
                 break;
             }
 
-            // TODO: Check if dest is current directory.  If so, refresh list
-            // ListChanged = TRUE;
+            //
+            //  Copies keep the name of the source file, so copying into the
+            //  displayed directory could only overwrite a file with itself.
+            //  The displayed entries are therefore unchanged.
+            //
         }
     }
 
     YoriLibFreeStringContents(&FullDest);
     YoriLibFreeStringContents(&FullDir);
-
-    if (ListChanged) {
-        CoRepopulateList(&CoContext);
-    }
 }
 
 /**
@@ -827,7 +1522,7 @@ CoSortSelected(
     if (YoriWinComboGetActiveOption(ClickedCtrl, &ActiveIndex)) {
         if (ActiveIndex < CoSortBeyondMaximum && ActiveIndex != (DWORD)CoContext.SortType) {
             CoContext.SortType = ActiveIndex;
-            CoRepopulateList(&CoContext);
+            CoResortList(&CoContext);
         }
     }
 }
@@ -876,7 +1571,7 @@ CoCreateSynchronousMenu(
     ListRect.Right = (SHORT)(WindowSize.X - 3 - CO_BUTTON_WIDTH - 1 - 1);
     ListRect.Bottom = (SHORT)(WindowSize.Y - 1);
 
-    List = YoriWinCreateList(Parent, &ListRect, YORI_WIN_LIST_STYLE_VSCROLLBAR | YORI_WIN_LIST_STYLE_MULTISELECT);
+    List = YoriWinCreateVirtualList(Parent, &ListRect, YORI_WIN_LIST_STYLE_VSCROLLBAR | YORI_WIN_LIST_STYLE_MULTISELECT, CoGetListItem, &CoContext);
     if (List == NULL) {
         YoriWinDestroyWindow(Parent);
         YoriWinCloseWindowManager(WinMgr);
@@ -962,14 +1657,34 @@ CoCreateSynchronousMenu(
     YoriWinComboAddItems(Ctrl, SortStrings, CoSortBeyondMaximum);
     YoriWinComboSetActiveOption(Ctrl, CoContext.SortType);
 
-    YoriLibInitializeListHead(&CoContext.FilesFound);
+    YoriLibInitializeListHead(&CoContext.PendingFiles);
+    CoContext.PendingFilesCount = 0;
     CoContext.FilesFoundCount = 0;
+    CoContext.FileArraySize = 0;
     CoContext.FileArray = NULL;
+    YoriLibInitEmptyString(&CoContext.Directory);
+    CoContext.EnumerateThread = NULL;
     CoContext.List = List;
     CoContext.WinMgr = WinMgr;
 
+    CoContext.PendingFilesMutex = CreateMutex(NULL, FALSE, NULL);
+    CoContext.FilesFoundEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    CoContext.ShutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (CoContext.PendingFilesMutex == NULL ||
+        CoContext.FilesFoundEvent == NULL ||
+        CoContext.ShutdownEvent == NULL) {
+
+        CoCloseHandles(&CoContext);
+        YoriWinDestroyWindow(Parent);
+        YoriWinCloseWindowManager(WinMgr);
+        return FALSE;
+    }
+
+    YoriWinSetWaitHandle(Parent, CoContext.FilesFoundEvent, CoFilesFoundSignalled);
+
     if (!CoPopulateList(&CoContext)) {
         CoFreeContext(&CoContext);
+        CoCloseHandles(&CoContext);
         YoriWinDestroyWindow(Parent);
         YoriWinCloseWindowManager(WinMgr);
         return FALSE;
@@ -978,7 +1693,9 @@ CoCreateSynchronousMenu(
     Result = FALSE;
     YoriWinProcessInputForWindow(Parent, &Result);
 
+    CoStopEnumeration(&CoContext);
     CoFreeContext(&CoContext);
+    CoCloseHandles(&CoContext);
 
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
@@ -37,8 +37,8 @@ const
 CHAR strForHelpText[] =
         "Enumerates through a list of strings or files.\n"
         "\n"
-        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-p n] [-r] <var> in (<list>)\n"
-        "    do <cmd>\n"
+        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-p n] [-r] [-t] [-u n]\n"
+        "    <var> in (<list>) do <cmd>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Use cmd as a subshell rather than Yori\n"
@@ -47,6 +47,8 @@ CHAR strForHelpText[] =
         "   -l             Use (start,step,end) notation for the list\n"
         "   -p <n>         Execute with <n> concurrent processes\n"
         "   -r             Look for matches in subdirectories under the current directory\n"
+        "   -t             Display the time taken by each process once all complete\n"
+        "   -u <n>         Defer new processes while CPU or memory use is above <n>%\n"
         "\n"
         " The -i option will match files only if they meet criteria.  This is a\n"
         " semicolon delimited list of entries matching the following form:\n"
@@ -74,6 +76,100 @@ ForHelp()
     return TRUE;
 }
 
+/**
+ The largest number of processes that can be run concurrently.  The slot
+ number of each process is encoded in the low 16 bits of its completion
+ key.
+ */
+#define FOR_MAX_CONCURRENT_COUNT (0xFFFF)
+
+/**
+ The number of milliseconds to wait for a process to complete before checking
+ again whether the system is idle enough to launch another.
+ */
+#define FOR_LOAD_POLL_INTERVAL (250)
+
+/**
+ The time taken by a single child process, used to display a summary once
+ all processes have completed.
+ */
+typedef struct _FOR_ITEM_TIMING {
+
+    /**
+     The list of timing records, in the order processes were launched.  This
+     is paired with FOR_EXEC_CONTEXT::TimingList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The match that the process was launched for.
+     */
+    YORI_STRING Match;
+
+    /**
+     The amount of time from process creation to process exit, in
+     milliseconds.
+     */
+    LONGLONG ElapsedTimeInMs;
+
+    /**
+     The amount of kernel and user time used by the process, in milliseconds.
+     */
+    LONGLONG CpuTimeInMs;
+
+    /**
+     The exit code of the process.
+     */
+    DWORD ExitCode;
+
+    /**
+     TRUE once the process has completed and the above fields are valid.
+     */
+    BOOL Complete;
+} FOR_ITEM_TIMING, *PFOR_ITEM_TIMING;
+
+/**
+ A slot which can contain a single running child process.
+ */
+typedef struct _FOR_CHILD {
+
+    /**
+     Handle to the process, or NULL if the slot is not in use.
+     */
+    HANDLE ProcessHandle;
+
+    /**
+     The process ID of the process.
+     */
+    DWORD ProcessId;
+
+    /**
+     Incremented each time a process is launched in this slot.  This is
+     encoded in the completion key so that messages about processes which
+     previously used this slot can be ignored.
+     */
+    DWORD Generation;
+
+    /**
+     A job object containing the process, whose notifications are posted to
+     the completion port.  If NULL, the process is waited on via
+     FOR_EXEC_CONTEXT::HandleArray .
+     */
+    HANDLE Job;
+
+    /**
+     If the process is not in a job, the index of its handle within
+     FOR_EXEC_CONTEXT::HandleArray .
+     */
+    DWORD WaitIndex;
+
+    /**
+     Optionally points to a record to populate with the time taken by the
+     process.
+     */
+    PFOR_ITEM_TIMING Timing;
+} FOR_CHILD, *PFOR_CHILD;
+
 /**
  State about the currently running processes as well as information required
  to launch any new processes from this program.
@@ -85,6 +181,12 @@ typedef struct _FOR_EXEC_CONTEXT {
      */
     BOOL InvokeCmd;
 
+    /**
+     If TRUE, record the time taken by each child process and display a
+     summary once all have completed.
+     */
+    BOOL DisplayTimes;
+
     /**
      The string that might be found in ArgV which should be changed to contain
      the value of any match.
@@ -115,11 +217,88 @@ typedef struct _FOR_EXEC_CONTEXT {
     DWORD CurrentConcurrentCount;
 
     /**
-     An array of handles with CurrentConcurrentCount number of valid
-     elements.  These correspond to processes that are currently running.
+     If nonzero, new processes are not launched while system CPU or memory
+     utilization is above this percentage, unless no processes are running.
+     */
+    DWORD LoadLimit;
+
+    /**
+     The number of elements in the Children and FreeSlots arrays.
+     */
+    DWORD SlotCount;
+
+    /**
+     An array of SlotCount slots for running processes.
+     */
+    PFOR_CHILD Children;
+
+    /**
+     A stack of the indexes of slots in Children which are not in use.
+     */
+    PDWORD FreeSlots;
+
+    /**
+     The number of elements in FreeSlots.
+     */
+    DWORD FreeSlotCount;
+
+    /**
+     A completion port which receives notifications when processes exit.
+     If NULL, processes are waited on via HandleArray, which limits the
+     number of concurrent processes to MAXIMUM_WAIT_OBJECTS.
+     */
+    HANDLE CompletionPort;
+
+    /**
+     An array of handles with HandleCount number of valid elements.  These
+     correspond to running processes which are not in a job.
      */
     PHANDLE HandleArray;
 
+    /**
+     For each element in HandleArray, the slot in Children that the process
+     occupies.
+     */
+    PDWORD HandleSlots;
+
+    /**
+     The number of valid elements in HandleArray and HandleSlots.
+     */
+    DWORD HandleCount;
+
+    /**
+     The number of processors in the system, used to determine when enough
+     time has passed to sample CPU utilization again.
+     */
+    DWORD NumberOfProcessors;
+
+    /**
+     TRUE if PreviousIdleTime and PreviousTotalTime contain a sample.
+     */
+    BOOL HaveSystemTimes;
+
+    /**
+     TRUE if CPU utilization exceeded LoadLimit when it was last sampled.
+     */
+    BOOL CpuBusy;
+
+    /**
+     The system idle time when CPU utilization was last sampled.
+     */
+    LONGLONG PreviousIdleTime;
+
+    /**
+     The system kernel and user time when CPU utilization was last sampled.
+     Note that kernel time includes idle time.
+     */
+    LONGLONG PreviousTotalTime;
+
+    /**
+     A list of timing records for each process launched, if DisplayTimes is
+     TRUE.
+     */
+    YORI_LIST_ENTRY TimingList;
+
     /**
      A list of criteria to filter matches against.
      */
@@ -127,45 +306,585 @@ typedef struct _FOR_EXEC_CONTEXT {
 
 } FOR_EXEC_CONTEXT, *PFOR_EXEC_CONTEXT;
 
+/**
+ Allocate the state required to track concurrently running processes.  If
+ the system supports it, processes are tracked via job objects associated
+ with a completion port, which has no limit on the number of processes and
+ finds the process that completed without searching.  Otherwise the number
+ of concurrent processes is limited to what can be waited on at once.
+
+ @param ExecContext Pointer to the for exec context to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+ForInitializeScheduler(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    DWORD Index;
+    DWORD HandleCount;
+
+    GetSystemInfo(&SystemInfo);
+    ExecContext->NumberOfProcessors = SystemInfo.dwNumberOfProcessors;
+    YoriLibInitializeListHead(&ExecContext->TimingList);
+
+    if (ExecContext->TargetConcurrentCount > 1 &&
+        DllKernel32.pCreateIoCompletionPort != NULL &&
+        DllKernel32.pGetQueuedCompletionStatus != NULL &&
+        DllKernel32.pCreateJobObjectW != NULL &&
+        DllKernel32.pAssignProcessToJobObject != NULL &&
+        DllKernel32.pSetInformationJobObject != NULL) {
+
+        ExecContext->CompletionPort = DllKernel32.pCreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    }
+
+    if (ExecContext->CompletionPort == NULL &&
+        ExecContext->TargetConcurrentCount > MAXIMUM_WAIT_OBJECTS) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: limiting to %i concurrent processes\n"), MAXIMUM_WAIT_OBJECTS);
+        ExecContext->TargetConcurrentCount = MAXIMUM_WAIT_OBJECTS;
+    }
+
+    ExecContext->SlotCount = ExecContext->TargetConcurrentCount;
+    ExecContext->Children = YoriLibMalloc(ExecContext->SlotCount * sizeof(FOR_CHILD));
+    ExecContext->FreeSlots = YoriLibMalloc(ExecContext->SlotCount * sizeof(DWORD));
+
+    HandleCount = ExecContext->SlotCount;
+    if (HandleCount > MAXIMUM_WAIT_OBJECTS) {
+        HandleCount = MAXIMUM_WAIT_OBJECTS;
+    }
+    ExecContext->HandleArray = YoriLibMalloc(HandleCount * sizeof(HANDLE));
+    ExecContext->HandleSlots = YoriLibMalloc(HandleCount * sizeof(DWORD));
+
+    if (ExecContext->Children == NULL ||
+        ExecContext->FreeSlots == NULL ||
+        ExecContext->HandleArray == NULL ||
+        ExecContext->HandleSlots == NULL) {
+
+        return FALSE;
+    }
+
+    ZeroMemory(ExecContext->Children, ExecContext->SlotCount * sizeof(FOR_CHILD));
+
+    //
+    //  Push slots so that the lowest numbered slot is used first.
+    //
+
+    for (Index = 0; Index < ExecContext->SlotCount; Index++) {
+        ExecContext->FreeSlots[Index] = ExecContext->SlotCount - Index - 1;
+    }
+    ExecContext->FreeSlotCount = ExecContext->SlotCount;
+
+    return TRUE;
+}
+
+/**
+ Free the state used to track concurrently running processes, as well as any
+ timing records.  All processes are expected to have completed.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForCleanupScheduler(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_ITEM_TIMING Timing;
+
+    ASSERT(ExecContext->CurrentConcurrentCount == 0);
+
+    if (ExecContext->TimingList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->TimingList, NULL);
+        while (ListEntry != NULL) {
+            Timing = CONTAINING_RECORD(ListEntry, FOR_ITEM_TIMING, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&ExecContext->TimingList, ListEntry);
+            YoriLibRemoveListItem(&Timing->ListEntry);
+            YoriLibFree(Timing);
+        }
+    }
+
+    if (ExecContext->CompletionPort != NULL) {
+        CloseHandle(ExecContext->CompletionPort);
+        ExecContext->CompletionPort = NULL;
+    }
+    if (ExecContext->Children != NULL) {
+        YoriLibFree(ExecContext->Children);
+        ExecContext->Children = NULL;
+    }
+    if (ExecContext->FreeSlots != NULL) {
+        YoriLibFree(ExecContext->FreeSlots);
+        ExecContext->FreeSlots = NULL;
+    }
+    if (ExecContext->HandleArray != NULL) {
+        YoriLibFree(ExecContext->HandleArray);
+        ExecContext->HandleArray = NULL;
+    }
+    if (ExecContext->HandleSlots != NULL) {
+        YoriLibFree(ExecContext->HandleSlots);
+        ExecContext->HandleSlots = NULL;
+    }
+}
+
+/**
+ Convert a FILETIME into a 64 bit integer.
+
+ @param FileTime Pointer to the FILETIME to convert.
+
+ @return The FILETIME as a 64 bit integer.
+ */
+LONGLONG
+ForFileTimeToInteger(
+    __in PFILETIME FileTime
+    )
+{
+    LARGE_INTEGER Value;
+    Value.LowPart = FileTime->dwLowDateTime;
+    Value.HighPart = FileTime->dwHighDateTime;
+    return Value.QuadPart;
+}
+
+/**
+ Record that a child process has completed, capturing its times if
+ requested and making its slot available for a new process.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @param Slot The slot containing the process that completed.
+ */
+VOID
+ForCompleteChild(
+    __inout PFOR_EXEC_CONTEXT ExecContext,
+    __in DWORD Slot
+    )
+{
+    PFOR_CHILD Child;
+    PFOR_ITEM_TIMING Timing;
+    FILETIME CreationTime;
+    FILETIME ExitTime;
+    FILETIME KernelTime;
+    FILETIME UserTime;
+    DWORD LastIndex;
+
+    Child = &ExecContext->Children[Slot];
+    Timing = Child->Timing;
+    if (Timing != NULL) {
+        if (GetProcessTimes(Child->ProcessHandle, &CreationTime, &ExitTime, &KernelTime, &UserTime)) {
+            Timing->ElapsedTimeInMs = (ForFileTimeToInteger(&ExitTime) - ForFileTimeToInteger(&CreationTime)) / (10 * 1000);
+            Timing->CpuTimeInMs = (ForFileTimeToInteger(&KernelTime) + ForFileTimeToInteger(&UserTime)) / (10 * 1000);
+        }
+        GetExitCodeProcess(Child->ProcessHandle, &Timing->ExitCode);
+        Timing->Complete = TRUE;
+        Child->Timing = NULL;
+    }
+
+    if (Child->Job != NULL) {
+        CloseHandle(Child->Job);
+        Child->Job = NULL;
+    } else {
+
+        //
+        //  Move the last handle into the position being vacated.
+        //
+
+        ASSERT(ExecContext->HandleCount > 0);
+        LastIndex = ExecContext->HandleCount - 1;
+        ExecContext->HandleArray[Child->WaitIndex] = ExecContext->HandleArray[LastIndex];
+        ExecContext->HandleSlots[Child->WaitIndex] = ExecContext->HandleSlots[LastIndex];
+        ExecContext->Children[ExecContext->HandleSlots[Child->WaitIndex]].WaitIndex = Child->WaitIndex;
+        ExecContext->HandleCount--;
+    }
+
+    CloseHandle(Child->ProcessHandle);
+    Child->ProcessHandle = NULL;
+    Child->ProcessId = 0;
+
+    ExecContext->FreeSlots[ExecContext->FreeSlotCount] = Slot;
+    ExecContext->FreeSlotCount++;
+    ExecContext->CurrentConcurrentCount--;
+}
+
 /**
  Wait for any single process to complete.
 
  @param ExecContext Pointer to the for exec context containing information
         about currently running processes.
+
+ @param Timeout The maximum number of milliseconds to wait.
+
+ @return TRUE if a process completed, FALSE if the timeout elapsed.
  */
-VOID
+BOOL
 ForWaitForProcessToComplete(
-    __in PFOR_EXEC_CONTEXT ExecContext
+    __inout PFOR_EXEC_CONTEXT ExecContext,
+    __in DWORD Timeout
     )
 {
     DWORD Result;
-    DWORD Index;
-    DWORD Count;
+    DWORD Slot;
+    DWORD Message;
+    ULONG_PTR Key;
+    LPOVERLAPPED Overlapped;
+    PFOR_CHILD Child;
+    DWORD PortTimeout;
+    DWORD StartTime;
+
+    ASSERT(ExecContext->CurrentConcurrentCount > 0);
+
+    if (ExecContext->HandleCount == ExecContext->CurrentConcurrentCount) {
+        Result = WaitForMultipleObjects(ExecContext->HandleCount, ExecContext->HandleArray, FALSE, Timeout);
+        if (Result < WAIT_OBJECT_0 || Result >= (WAIT_OBJECT_0 + ExecContext->HandleCount)) {
+            return FALSE;
+        }
 
-    Result = WaitForMultipleObjects(ExecContext->CurrentConcurrentCount, ExecContext->HandleArray, FALSE, INFINITE);
+        ForCompleteChild(ExecContext, ExecContext->HandleSlots[Result - WAIT_OBJECT_0]);
+        return TRUE;
+    }
 
-    ASSERT(Result >= WAIT_OBJECT_0 && Result < (WAIT_OBJECT_0 + ExecContext->CurrentConcurrentCount));
+    //
+    //  Each job posts messages for every process within it, including
+    //  any processes launched by the child.  Only the exit of the child
+    //  itself frees its slot.  The completion key identifies the slot and
+    //  the launch within that slot, so messages from jobs that have already
+    //  completed are ignored.
+    //
+    //  If some processes could not be placed in a job, they are checked
+    //  each time the completion port wait times out, so the port is waited
+    //  on for no more than FOR_LOAD_POLL_INTERVAL at a time.
+    //
+
+    PortTimeout = Timeout;
+    if (ExecContext->HandleCount > 0 && PortTimeout > FOR_LOAD_POLL_INTERVAL) {
+        PortTimeout = FOR_LOAD_POLL_INTERVAL;
+    }
+    StartTime = GetTickCount();
+
+    while (TRUE) {
+        if (ExecContext->HandleCount > 0) {
+            Result = WaitForMultipleObjects(ExecContext->HandleCount, ExecContext->HandleArray, FALSE, 0);
+            if (Result >= WAIT_OBJECT_0 && Result < (WAIT_OBJECT_0 + ExecContext->HandleCount)) {
+                ForCompleteChild(ExecContext, ExecContext->HandleSlots[Result - WAIT_OBJECT_0]);
+                return TRUE;
+            }
+        }
 
-    Index = Result - WAIT_OBJECT_0;
+        if (!DllKernel32.pGetQueuedCompletionStatus(ExecContext->CompletionPort, &Message, &Key, &Overlapped, PortTimeout)) {
+            if (Overlapped != NULL ||
+                PortTimeout == Timeout ||
+                (Timeout != INFINITE && GetTickCount() - StartTime >= Timeout)) {
 
-    CloseHandle(ExecContext->HandleArray[Index]);
+                return FALSE;
+            }
+            continue;
+        }
 
-    for (Count = Index; Count < ExecContext->CurrentConcurrentCount - 1; Count++) {
+        if (Message != JOB_OBJECT_MSG_EXIT_PROCESS &&
+            Message != JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS) {
+
+            continue;
+        }
+
+        Slot = (DWORD)(Key & 0xFFFF);
+        if (Slot >= ExecContext->SlotCount) {
+            continue;
+        }
+
+        Child = &ExecContext->Children[Slot];
+        if (Child->ProcessHandle == NULL ||
+            Child->Job == NULL ||
+            (Child->Generation & 0xFFFF) != (DWORD)((Key >> 16) & 0xFFFF) ||
+            Child->ProcessId != (DWORD)(ULONG_PTR)Overlapped) {
+
+            continue;
+        }
 
-#if defined(_MSC_VER) && (_MSC_VER >= 1700)
         //
-        //  The "correct" annotation here would describe that HandleArray is
-        //  of TargetConcurrentCount elements, CurrentConcurrentCount of which
-        //  are readable, and CurrentConcurrentCount needs to be less than or
-        //  equal to TargetConcurrentCount.  This is something that I don't
-        //  see a way to express as of this writing.
+        //  The message may be posted slightly before the process is
+        //  signalled, so wait for it to finish exiting.
         //
-#pragma warning(suppress: 6001)
+
+        WaitForSingleObject(Child->ProcessHandle, INFINITE);
+        ForCompleteChild(ExecContext, Slot);
+        return TRUE;
+    }
+}
+
+/**
+ Determine whether system CPU or memory utilization is above the limit
+ specified by the user.  CPU utilization is measured over an interval of
+ at least FOR_LOAD_POLL_INTERVAL, so between samples the previous result is
+ returned.
+
+ @param ExecContext Pointer to the for exec context specifying the limit.
+
+ @return TRUE if the system is too busy to launch another process, FALSE if
+         it is not.
+ */
+BOOL
+ForIsSystemBusy(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    DWORD MemoryLoad;
+    FILETIME IdleTime;
+    FILETIME KernelTime;
+    FILETIME UserTime;
+    LONGLONG Idle;
+    LONGLONG Total;
+    LONGLONG IdleDelta;
+    LONGLONG TotalDelta;
+
+    if (DllKernel32.pGlobalMemoryStatusEx) {
+        YORI_MEMORYSTATUSEX MemStatusEx;
+        MemStatusEx.dwLength = sizeof(MemStatusEx);
+        if (!DllKernel32.pGlobalMemoryStatusEx(&MemStatusEx)) {
+            MemStatusEx.dwMemoryLoad = 0;
+        }
+        MemoryLoad = MemStatusEx.dwMemoryLoad;
+    } else {
+        MEMORYSTATUS MemStatus;
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159)
 #endif
-        ExecContext->HandleArray[Count] = ExecContext->HandleArray[Count + 1];
+        GlobalMemoryStatus(&MemStatus);
+        MemoryLoad = MemStatus.dwMemoryLoad;
     }
 
-    ExecContext->CurrentConcurrentCount--;
+    if (MemoryLoad > ExecContext->LoadLimit) {
+        return TRUE;
+    }
+
+    if (DllKernel32.pGetSystemTimes == NULL ||
+        !DllKernel32.pGetSystemTimes(&IdleTime, &KernelTime, &UserTime)) {
+
+        return FALSE;
+    }
+
+    Idle = ForFileTimeToInteger(&IdleTime);
+    Total = ForFileTimeToInteger(&KernelTime) + ForFileTimeToInteger(&UserTime);
+
+    if (!ExecContext->HaveSystemTimes) {
+        ExecContext->PreviousIdleTime = Idle;
+        ExecContext->PreviousTotalTime = Total;
+        ExecContext->HaveSystemTimes = TRUE;
+        return FALSE;
+    }
+
+    IdleDelta = Idle - ExecContext->PreviousIdleTime;
+    TotalDelta = Total - ExecContext->PreviousTotalTime;
+
+    if (TotalDelta >= (LONGLONG)ExecContext->NumberOfProcessors * FOR_LOAD_POLL_INTERVAL * 10 * 1000) {
+        ExecContext->CpuBusy = FALSE;
+        if ((TotalDelta - IdleDelta) * 100 > TotalDelta * ExecContext->LoadLimit) {
+            ExecContext->CpuBusy = TRUE;
+        }
+        ExecContext->PreviousIdleTime = Idle;
+        ExecContext->PreviousTotalTime = Total;
+    }
+
+    return ExecContext->CpuBusy;
+}
+
+/**
+ Wait until another process can be launched.  This waits for a slot to
+ become available and, if a load limit was specified, for system load to
+ fall below the limit.  If no processes are running, a new process can
+ always be launched so that progress is made.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForWaitForAvailableSlot(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    while (ExecContext->CurrentConcurrentCount >= ExecContext->TargetConcurrentCount) {
+        ForWaitForProcessToComplete(ExecContext, INFINITE);
+    }
+
+    if (ExecContext->LoadLimit > 0) {
+        while (ExecContext->CurrentConcurrentCount > 0 &&
+               ForIsSystemBusy(ExecContext)) {
+
+            ForWaitForProcessToComplete(ExecContext, FOR_LOAD_POLL_INTERVAL);
+        }
+    }
+}
+
+/**
+ Launch a child process and track it in a free slot.  The caller is expected
+ to have called @ref ForWaitForAvailableSlot .  If processes are tracked via
+ a completion port, the process is created suspended and placed in a job
+ before it can run, so that its exit and the exit of any process it creates
+ are reported to the port.  If the process cannot be placed in a job, it is
+ waited on via its handle instead.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @param CmdLine Pointer to the command line of the process to launch.
+
+ @param Match Pointer to the match that the process is launched for.
+
+ @return TRUE if the process was launched, FALSE if it was not.
+ */
+__success(return)
+BOOL
+ForLaunchProcess(
+    __inout PFOR_EXEC_CONTEXT ExecContext,
+    __in PYORI_STRING CmdLine,
+    __in PYORI_STRING Match
+    )
+{
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    PFOR_ITEM_TIMING Timing;
+    PFOR_CHILD Child;
+    DWORD Slot;
+    DWORD Result;
+    HANDLE Job;
+    ULONG_PTR Key;
+    DWORD CreationFlags;
+
+    ASSERT(ExecContext->FreeSlotCount > 0);
+    ExecContext->FreeSlotCount--;
+    Slot = ExecContext->FreeSlots[ExecContext->FreeSlotCount];
+    Child = &ExecContext->Children[Slot];
+    Child->Generation++;
+
+    //
+    //  If processes are tracked via a completion port, create a job for the
+    //  process which posts to the port with a key identifying this slot.
+    //
+
+    Job = NULL;
+    CreationFlags = 0;
+    if (ExecContext->CompletionPort != NULL) {
+        Job = YoriLibCreateJobObject();
+        if (Job != NULL) {
+            Key = (ULONG_PTR)Slot | ((ULONG_PTR)(Child->Generation & 0xFFFF) << 16);
+            if (!YoriLibAssociateJobObjectWithCompletionPort(Job, ExecContext->CompletionPort, (PVOID)Key)) {
+                CloseHandle(Job);
+                Job = NULL;
+            }
+        }
+        CreationFlags = CREATE_SUSPENDED;
+    }
+
+    Timing = NULL;
+    if (ExecContext->DisplayTimes) {
+        Timing = YoriLibMalloc(sizeof(FOR_ITEM_TIMING) + (Match->LengthInChars + 1) * sizeof(TCHAR));
+        if (Timing != NULL) {
+            ZeroMemory(Timing, sizeof(FOR_ITEM_TIMING));
+            YoriLibInitEmptyString(&Timing->Match);
+            Timing->Match.StartOfString = (LPTSTR)(Timing + 1);
+            Timing->Match.LengthAllocated = Match->LengthInChars + 1;
+            Timing->Match.LengthInChars = Match->LengthInChars;
+            memcpy(Timing->Match.StartOfString, Match->StartOfString, Match->LengthInChars * sizeof(TCHAR));
+            Timing->Match.StartOfString[Match->LengthInChars] = '\0';
+        }
+    }
+
+    memset(&StartupInfo, 0, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    if (!CreateProcess(NULL, CmdLine->StartOfString, NULL, NULL, TRUE, CreationFlags, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        if (Job != NULL) {
+            CloseHandle(Job);
+        }
+        if (Timing != NULL) {
+            YoriLibFree(Timing);
+        }
+        ExecContext->FreeSlots[ExecContext->FreeSlotCount] = Slot;
+        ExecContext->FreeSlotCount++;
+        return FALSE;
+    }
+
+    //
+    //  Assigning a process to a job can fail, for example if this program
+    //  is in a job that does not allow nesting.  In that case, wait on the
+    //  process handle.  Only MAXIMUM_WAIT_OBJECTS handles can be waited on,
+    //  so if that many are outstanding, wait for one of them to complete.
+    //
+
+    if (Job != NULL) {
+        if (!YoriLibAssignProcessToJobObject(Job, ProcessInfo.hProcess)) {
+            CloseHandle(Job);
+            Job = NULL;
+        }
+    }
+
+    if (Job == NULL) {
+        while (ExecContext->HandleCount >= MAXIMUM_WAIT_OBJECTS) {
+            Result = WaitForMultipleObjects(ExecContext->HandleCount, ExecContext->HandleArray, FALSE, INFINITE);
+            if (Result < WAIT_OBJECT_0 || Result >= (WAIT_OBJECT_0 + ExecContext->HandleCount)) {
+                break;
+            }
+            ForCompleteChild(ExecContext, ExecContext->HandleSlots[Result - WAIT_OBJECT_0]);
+        }
+    }
+
+    Child->ProcessHandle = ProcessInfo.hProcess;
+    Child->ProcessId = ProcessInfo.dwProcessId;
+    Child->Job = Job;
+    Child->Timing = Timing;
+
+    if (Job == NULL) {
+        ASSERT(ExecContext->HandleCount < MAXIMUM_WAIT_OBJECTS);
+        Child->WaitIndex = ExecContext->HandleCount;
+        ExecContext->HandleArray[ExecContext->HandleCount] = ProcessInfo.hProcess;
+        ExecContext->HandleSlots[ExecContext->HandleCount] = Slot;
+        ExecContext->HandleCount++;
+    }
+
+    if (Timing != NULL) {
+        YoriLibAppendList(&ExecContext->TimingList, &Timing->ListEntry);
+    }
+
+    ExecContext->CurrentConcurrentCount++;
+
+    if (CreationFlags & CREATE_SUSPENDED) {
+        ResumeThread(ProcessInfo.hThread);
+    }
+    CloseHandle(ProcessInfo.hThread);
+
+    return TRUE;
+}
+
+/**
+ Display the time taken by each process that was launched, in the order
+ they were launched.
+
+ @param ExecContext Pointer to the for exec context containing the timing
+        records.
+ */
+VOID
+ForDisplayTimes(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_ITEM_TIMING Timing;
+
+    ListEntry = YoriLibGetNextListEntry(&ExecContext->TimingList, NULL);
+    while (ListEntry != NULL) {
+        Timing = CONTAINING_RECORD(ListEntry, FOR_ITEM_TIMING, ListEntry);
+        if (Timing->Complete) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%y: elapsed %lli ms, cpu %lli ms, exit code %i\n"),
+                          &Timing->Match,
+                          Timing->ElapsedTimeInMs,
+                          Timing->CpuTimeInMs,
+                          Timing->ExitCode);
+        }
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->TimingList, ListEntry);
+    }
 }
 
 /**
@@ -192,8 +911,6 @@ ForExecuteCommand(
     YORI_STRING NewArgWritePoint;
     PYORI_STRING NewArgArray;
     YORI_STRING CmdLine;
-    PROCESS_INFORMATION ProcessInfo;
-    STARTUPINFO StartupInfo;
 
     YoriLibInitEmptyString(&CmdLine);
 
@@ -314,25 +1031,8 @@ ForExecuteCommand(
     }
 #endif
 
-    memset(&StartupInfo, 0, sizeof(StartupInfo));
-    StartupInfo.cb = sizeof(StartupInfo);
-
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, 0, NULL, NULL, &StartupInfo, &ProcessInfo)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        goto Cleanup;
-    }
-
-    CloseHandle(ProcessInfo.hThread);
-
-    ExecContext->HandleArray[ExecContext->CurrentConcurrentCount] = ProcessInfo.hProcess;
-    ExecContext->CurrentConcurrentCount++;
-
-    if (ExecContext->CurrentConcurrentCount == ExecContext->TargetConcurrentCount) {
-        ForWaitForProcessToComplete(ExecContext);
-    }
+    ForWaitForAvailableSlot(ExecContext);
+    ForLaunchProcess(ExecContext, &CmdLine, Match);
 
 Cleanup:
 
@@ -486,14 +1186,32 @@ ENTRYPOINT(
                     YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlNumberProcesses, &CharsConsumed);
                     ExecContext.TargetConcurrentCount = (DWORD)LlNumberProcesses;
                     ArgumentUnderstood = TRUE;
-                    if (ExecContext.TargetConcurrentCount < 1) {
+                    if (LlNumberProcesses < 1) {
                         ExecContext.TargetConcurrentCount = 1;
+                    } else if (LlNumberProcesses > FOR_MAX_CONCURRENT_COUNT) {
+                        ExecContext.TargetConcurrentCount = FOR_MAX_CONCURRENT_COUNT;
                     }
                     i++;
                 }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
                 Recurse = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("t")) == 0) {
+                ExecContext.DisplayTimes = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("u")) == 0) {
+                if (i + 1 < ArgC) {
+                    LONGLONG LlLoadLimit = 0;
+                    DWORD CharsConsumed = 0;
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlLoadLimit, &CharsConsumed);
+                    if (LlLoadLimit < 1 || LlLoadLimit > 100) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: load limit must be between 1 and 100\n"));
+                        goto cleanup_and_exit;
+                    }
+                    ExecContext.LoadLimit = (DWORD)LlLoadLimit;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -575,8 +1293,7 @@ ENTRYPOINT(
 
     ExecContext.ArgC = ArgC - CmdArg;
     ExecContext.ArgV = &ArgV[CmdArg];
-    ExecContext.HandleArray = YoriLibMalloc(ExecContext.TargetConcurrentCount * sizeof(HANDLE));
-    if (ExecContext.HandleArray == NULL) {
+    if (!ForInitializeScheduler(&ExecContext)) {
         goto cleanup_and_exit;
     }
 
@@ -772,16 +1489,25 @@ ENTRYPOINT(
     }
 
     while (ExecContext.CurrentConcurrentCount > 0) {
-        ForWaitForProcessToComplete(&ExecContext);
+        ForWaitForProcessToComplete(&ExecContext, INFINITE);
     }
 
+    if (ExecContext.DisplayTimes) {
+        ForDisplayTimes(&ExecContext);
+    }
+
+    ForCleanupScheduler(&ExecContext);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
-    YoriLibFree(ExecContext.HandleArray);
 
     return EXIT_SUCCESS;
 
 cleanup_and_exit:
 
+    while (ExecContext.CurrentConcurrentCount > 0) {
+        ForWaitForProcessToComplete(&ExecContext, INFINITE);
+    }
+
+    ForCleanupScheduler(&ExecContext);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
 
     return EXIT_FAILURE;
@@ -159,7 +159,7 @@ ENTRYPOINT(
     ExistingUrlName = ArgV[StartArg].StartOfString;
 
     YoriLibSPrintf(szAgent, _T("YGet %i.%02i\r\n"), GET_VER_MAJOR, GET_VER_MINOR);
-    Error = YoriLibUpdateBinaryFromUrl(ExistingUrlName, NewFileName.StartOfString, szAgent, NewerOnly?&ExistingFileTime:NULL);
+    Error = YoriLibUpdateBinaryFromUrl(ExistingUrlName, NewFileName.StartOfString, szAgent, NewerOnly?&ExistingFileTime:NULL, NULL);
     YoriLibFreeStringContents(&NewFileName);
     if (Error != YoriLibUpdErrorSuccess) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("get: failed to download: %s\n"), YoriLibUpdateErrorString(Error));
@@ -37,12 +37,13 @@ CHAR strHiliteHelpText[] =
         "matching specified criteria.\n"
         "\n"
         "HILITE [-license] [-b] [-c <string> <color>] [-h <string> <color>]\n"
-        "       [-i] [-s] [-t <string> <color>] [<file>...]\n"
+        "       [-i] [-r <regex> <color>] [-s] [-t <string> <color>] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Highlight lines containing <string> with <color>\n"
         "   -h             Highlight lines starting with <string> with <color>\n"
         "   -i             Match insensitively\n"
+        "   -r             Highlight lines matching regex <regex> with <color>\n"
         "   -s             Process files from all subdirectories\n"
         "   -t             Highlight lines ending with <string> with <color>\n";
 
@@ -66,7 +67,8 @@ HiliteHelp()
 typedef enum _HILITE_MATCH_TYPE {
     HiliteMatchTypeBeginsWith = 1,
     HiliteMatchTypeEndsWith = 2,
-    HiliteMatchTypeContains = 3
+    HiliteMatchTypeContains = 3,
+    HiliteMatchTypeRegex = 4
 } HILITE_MATCH_TYPE;
 
 /**
@@ -128,6 +130,19 @@ typedef struct _HILITE_CONTEXT {
      */
     YORI_LIST_ENTRY Matches;
 
+    /**
+     All of the matches compiled into a single set of regular expressions,
+     so that each line is only scanned once.  This is NULL if no matches
+     were specified.
+     */
+    PYORILIB_REGEX Regex;
+
+    /**
+     An array of colors to apply, indexed by the pattern in Regex that
+     matched.
+     */
+    PYORILIB_COLOR_ATTRIBUTES Colors;
+
 } HILITE_CONTEXT, *PHILITE_CONTEXT;
 
 /**
@@ -150,9 +165,8 @@ HiliteProcessStream(
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
-    PHILITE_MATCH_CRITERIA MatchCriteria;
     YORILIB_COLOR_ATTRIBUTES ColorToUse;
-    PYORI_LIST_ENTRY ListEntry;
+    DWORD MatchIndex;
 
     YoriLibInitEmptyString(&LineString);
 
@@ -168,69 +182,15 @@ HiliteProcessStream(
         ColorToUse.Win32Attr = HiliteContext->DefaultColor.Win32Attr;
 
         //
-        //  Enumerate through the matches and see if there is anything to
-        //  apply.
+        //  Check every match in one pass over the line.  The first match
+        //  specified which matches determines the color.
         //
 
-        ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, NULL);
-        while (ListEntry != NULL) {
-            MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
-            if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
-                if (HiliteContext->Insensitive) {
-                    if (YoriLibCompareStringInsensitiveCount(&LineString,
-                                                             &MatchCriteria->MatchString,
-                                                             MatchCriteria->MatchString.LengthInChars) == 0) {
-                        ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                        ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                        break;
-                    }
-                } else {
-                    if (YoriLibCompareStringCount(&LineString,
-                                                  &MatchCriteria->MatchString,
-                                                  MatchCriteria->MatchString.LengthInChars) == 0) {
-                        ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                        ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                        break;
-                    }
-                }
-            } else if (MatchCriteria->MatchType == HiliteMatchTypeEndsWith) {
-                YORI_STRING TailOfLine;
-    
-                if (LineString.LengthInChars >= MatchCriteria->MatchString.LengthInChars) {
-                    YoriLibInitEmptyString(&TailOfLine);
-                    TailOfLine.LengthInChars = MatchCriteria->MatchString.LengthInChars;
-                    TailOfLine.StartOfString = &LineString.StartOfString[LineString.LengthInChars - MatchCriteria->MatchString.LengthInChars];
-    
-                    if (HiliteContext->Insensitive) {
-                        if (YoriLibCompareStringInsensitive(&TailOfLine, &MatchCriteria->MatchString) == 0) {
-                            ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                            ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                            break;
-                        }
-                    } else {
-                        if (YoriLibCompareString(&TailOfLine, &MatchCriteria->MatchString) == 0) {
-                            ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                            ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                            break;
-                        }
-                    }
-                }
-            } else if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
-                if (HiliteContext->Insensitive) {
-                    if (YoriLibFindFirstMatchingSubstringInsensitive(&LineString, 1, &MatchCriteria->MatchString, NULL)) {
-                        ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                        ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                        break;
-                    }
-                } else {
-                    if (YoriLibFindFirstMatchingSubstring(&LineString, 1, &MatchCriteria->MatchString, NULL)) {
-                        ColorToUse.Ctrl = MatchCriteria->Color.Ctrl;
-                        ColorToUse.Win32Attr = MatchCriteria->Color.Win32Attr;
-                        break;
-                    }
-                }
-            }
-            ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, ListEntry);
+        if (HiliteContext->Regex != NULL &&
+            YoriLibRegexMatch(HiliteContext->Regex, &LineString, &MatchIndex)) {
+
+            ColorToUse.Ctrl = HiliteContext->Colors[MatchIndex].Ctrl;
+            ColorToUse.Win32Attr = HiliteContext->Colors[MatchIndex].Win32Attr;
         }
 
         //
@@ -366,6 +326,91 @@ HiliteFileEnumerateErrorCallback(
     return Result;
 }
 
+/**
+ Compile all of the user specified criteria into a single set of regular
+ expressions, so that each line can be compared against every criteria in
+ one pass regardless of how many criteria there are.
+
+ @param HiliteContext The context containing the user specified criteria.
+        On success, the compiled set and colors are stored here.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HiliteCompileMatches(
+    __in PHILITE_CONTEXT HiliteContext
+    )
+{
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_REGEX_PATTERN Patterns;
+    DWORD PatternCount;
+    DWORD Index;
+    DWORD ErrorPattern;
+    DWORD ErrorOffset;
+
+    PatternCount = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, NULL);
+    while (ListEntry != NULL) {
+        PatternCount++;
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, ListEntry);
+    }
+
+    if (PatternCount == 0) {
+        return TRUE;
+    }
+
+    Patterns = YoriLibMalloc(PatternCount * sizeof(YORILIB_REGEX_PATTERN));
+    if (Patterns == NULL) {
+        return FALSE;
+    }
+
+    HiliteContext->Colors = YoriLibMalloc(PatternCount * sizeof(YORILIB_COLOR_ATTRIBUTES));
+    if (HiliteContext->Colors == NULL) {
+        YoriLibFree(Patterns);
+        return FALSE;
+    }
+
+    Index = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        YoriLibInitEmptyString(&Patterns[Index].Pattern);
+        Patterns[Index].Pattern.StartOfString = MatchCriteria->MatchString.StartOfString;
+        Patterns[Index].Pattern.LengthInChars = MatchCriteria->MatchString.LengthInChars;
+        if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
+            Patterns[Index].Flags = YORILIB_REGEX_PATTERN_LITERAL | YORILIB_REGEX_PATTERN_ANCHOR_START;
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeEndsWith) {
+            Patterns[Index].Flags = YORILIB_REGEX_PATTERN_LITERAL | YORILIB_REGEX_PATTERN_ANCHOR_END;
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
+            Patterns[Index].Flags = YORILIB_REGEX_PATTERN_LITERAL;
+        } else {
+            Patterns[Index].Flags = 0;
+        }
+        HiliteContext->Colors[Index].Ctrl = MatchCriteria->Color.Ctrl;
+        HiliteContext->Colors[Index].Win32Attr = MatchCriteria->Color.Win32Attr;
+        Index++;
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, ListEntry);
+    }
+
+    if (!YoriLibRegexCompile(Patterns,
+                             PatternCount,
+                             HiliteContext->Insensitive?YORILIB_REGEX_INSENSITIVE:0,
+                             &HiliteContext->Regex,
+                             &ErrorPattern,
+                             &ErrorOffset)) {
+
+        if (ErrorPattern != YORILIB_REGEX_NO_PATTERN) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hilite: invalid regular expression at offset %i: %y\n"), ErrorOffset, &Patterns[ErrorPattern].Pattern);
+        }
+        YoriLibFree(Patterns);
+        return FALSE;
+    }
+
+    YoriLibFree(Patterns);
+    return TRUE;
+}
+
 /**
  Deallocate any user specified hilite criteria.
 
@@ -387,6 +432,16 @@ HiliteCleanupContext(
         YoriLibFree(MatchCriteria);
         ListEntry = YoriLibGetNextListEntry(&HiliteContext->Matches, NULL);
     }
+
+    if (HiliteContext->Regex != NULL) {
+        YoriLibRegexFree(HiliteContext->Regex);
+        HiliteContext->Regex = NULL;
+    }
+
+    if (HiliteContext->Colors != NULL) {
+        YoriLibFree(HiliteContext->Colors);
+        HiliteContext->Colors = NULL;
+    }
 }
 
 
@@ -495,6 +550,23 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("i")) == 0) {
                 HiliteContext.Insensitive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                if (i + 2 < ArgC) {
+                    NewCriteria = YoriLibMalloc(sizeof(HILITE_MATCH_CRITERIA));
+                    if (NewCriteria == NULL) {
+                        HiliteCleanupContext(&HiliteContext);
+                        return EXIT_FAILURE;
+                    }
+                    NewCriteria->MatchType = HiliteMatchTypeRegex;
+                    YoriLibInitEmptyString(&NewCriteria->MatchString);
+                    NewCriteria->MatchString.StartOfString = ArgV[i + 1].StartOfString;
+                    NewCriteria->MatchString.LengthInChars = ArgV[i + 1].LengthInChars;
+                    YoriLibAttributeFromLiteralString(ArgV[i + 2].StartOfString, &NewCriteria->Color);
+                    YoriLibResolveWindowColorComponents(NewCriteria->Color, HiliteContext.DefaultColor, FALSE, &NewCriteria->Color);
+                    YoriLibAppendList(&HiliteContext.Matches, &NewCriteria->ListEntry);
+                    ArgumentUnderstood = TRUE;
+                    i += 2;
+                }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
                 HiliteContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -531,6 +603,11 @@ ENTRYPOINT(
         }
     }
 
+    if (!HiliteCompileMatches(&HiliteContext)) {
+        HiliteCleanupContext(&HiliteContext);
+        return EXIT_FAILURE;
+    }
+
     //
     //  Attempt to enable backup privilege so an administrator can access more
     //  objects successfully.
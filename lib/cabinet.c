@@ -27,6 +27,28 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ A set of file names within a CAB, compared exactly but case insensitively.
+ */
+typedef struct _YORI_LIB_CAB_FILE_SET {
+
+    /**
+     A hash table of file names, or NULL if the set is empty.
+     */
+    PYORI_HASH_TABLE Table;
+
+    /**
+     An array of entries, one per file name, which are inserted into Table.
+     */
+    PYORI_HASH_ENTRY Entries;
+
+    /**
+     The number of entries in the Entries array which are inserted into
+     Table.
+     */
+    DWORD Count;
+} YORI_LIB_CAB_FILE_SET, *PYORI_LIB_CAB_FILE_SET;
+
 /**
  Context information to pass around as files are being expanded.
  */
@@ -44,24 +66,14 @@ typedef struct _YORI_LIB_CAB_EXPAND_CONTEXT {
     BOOL DefaultInclude;
 
     /**
-     The number of files in the FilesToInclude array.
-     */
-    DWORD NumberFilesToInclude;
-
-    /**
-     An array of strings corresponding to files that should be expanded.
-     */
-    PYORI_STRING FilesToInclude;
-
-    /**
-     The number of files in the FilesToExclude array.
+     The set of files that should be expanded.
      */
-    DWORD NumberFilesToExclude;
+    YORI_LIB_CAB_FILE_SET FilesToInclude;
 
     /**
-     An array of strings corresponding to files that should not be expanded.
+     The set of files that should not be expanded.
      */
-    PYORI_STRING FilesToExclude;
+    YORI_LIB_CAB_FILE_SET FilesToExclude;
 
     /**
      A user specified callback to provide notification for a given file.
@@ -84,8 +96,110 @@ typedef struct _YORI_LIB_CAB_EXPAND_CONTEXT {
      */
     PYORI_STRING ErrorString;
 
+    /**
+     When folders are being extracted by more than one thread, a mutex
+     which serializes creation of target files and directories, invocation
+     of the user callbacks, and updates to ErrorString.  NULL when
+     extracting on a single thread.
+     */
+    HANDLE Mutex;
+
 } YORI_LIB_CAB_EXPAND_CONTEXT, *PYORI_LIB_CAB_EXPAND_CONTEXT;
 
+/**
+ The maximum number of threads to use when extracting a single Cabinet.
+ */
+#define YORI_LIB_CAB_MAX_EXTRACT_THREADS (8)
+
+/**
+ Context for a single thread extracting files from a Cabinet.  Each thread
+ processes the entire Cabinet with its own FDI context, but only extracts
+ the files from folders assigned to it, so folders can be decompressed in
+ parallel.
+ */
+typedef struct _YORI_LIB_CAB_EXPAND_WORKER {
+
+    /**
+     Pointer to the context shared by all threads extracting this Cabinet.
+     */
+    PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+
+    /**
+     The index of this thread.  Folders whose index modulo WorkerCount
+     equals this value are extracted by this thread.
+     */
+    DWORD WorkerIndex;
+
+    /**
+     The total number of threads extracting this Cabinet.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The FDI context used by this thread.
+     */
+    LPVOID hFdi;
+
+    /**
+     Memory allocated to retrieve errors that occur during extraction.
+     */
+    CAB_CB_ERROR CabErrors;
+
+    /**
+     NULL terminated ANSI name of the Cabinet, without any path.
+     */
+    LPSTR AnsiCabFileName;
+
+    /**
+     NULL terminated ANSI name of the directory containing the Cabinet.
+     */
+    LPSTR AnsiCabParentDirectory;
+
+    /**
+     Handle to the thread performing extraction, or NULL if extraction is
+     performed on the calling thread.
+     */
+    HANDLE ThreadHandle;
+
+    /**
+     Set to TRUE once this thread has successfully processed the Cabinet.
+     */
+    BOOL Result;
+
+} YORI_LIB_CAB_EXPAND_WORKER, *PYORI_LIB_CAB_EXPAND_WORKER;
+
+/**
+ Acquire exclusive access to state shared between threads extracting a
+ Cabinet.
+
+ @param ExpandContext Pointer to the expand context.
+ */
+VOID
+YoriLibCabAcquireExpandLock(
+    __in PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext
+    )
+{
+    if (ExpandContext->Mutex != NULL) {
+        WaitForSingleObject(ExpandContext->Mutex, INFINITE);
+    }
+}
+
+/**
+ Release exclusive access to state shared between threads extracting a
+ Cabinet.
+
+ @param ExpandContext Pointer to the expand context.
+ */
+VOID
+YoriLibCabReleaseExpandLock(
+    __in PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext
+    )
+{
+    if (ExpandContext->Mutex != NULL) {
+        ReleaseMutex(ExpandContext->Mutex);
+    }
+}
+
 /**
  A callback invoked during FDICopy to allocate memory.
 
@@ -330,9 +444,86 @@ YoriLibCabBuildFileNames(
     return TRUE;
 }
 
+/**
+ Free a set of file names.
+
+ @param FileSet Pointer to the set to free.
+ */
+VOID
+YoriLibCabFreeFileSet(
+    __inout PYORI_LIB_CAB_FILE_SET FileSet
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < FileSet->Count; Index++) {
+        YoriLibHashRemoveByEntry(&FileSet->Entries[Index]);
+    }
+    FileSet->Count = 0;
+
+    if (FileSet->Table != NULL) {
+        YoriLibFreeEmptyHashTable(FileSet->Table);
+        FileSet->Table = NULL;
+    }
+
+    if (FileSet->Entries != NULL) {
+        YoriLibFree(FileSet->Entries);
+        FileSet->Entries = NULL;
+    }
+}
+
+/**
+ Build a set of file names so that each file in a CAB can be checked with a
+ single lookup regardless of how many names were specified.  Names are
+ matched exactly, without wildcards, and case insensitively.
+
+ @param FileNames Pointer to an array of file names.
+
+ @param NumberFileNames The number of elements in the FileNames array.
+
+ @param FileSet On successful completion, populated with the set of file
+        names.  The caller should free this with
+        @ref YoriLibCabFreeFileSet .
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibCabBuildFileSet(
+    __in_ecount(NumberFileNames) PYORI_STRING FileNames,
+    __in DWORD NumberFileNames,
+    __out PYORI_LIB_CAB_FILE_SET FileSet
+    )
+{
+    DWORD Index;
+
+    ZeroMemory(FileSet, sizeof(YORI_LIB_CAB_FILE_SET));
+    if (NumberFileNames == 0) {
+        return TRUE;
+    }
+
+    FileSet->Table = YoriLibAllocateHashTable(NumberFileNames * 2 + 1);
+    FileSet->Entries = YoriLibMalloc(NumberFileNames * sizeof(YORI_HASH_ENTRY));
+    if (FileSet->Table == NULL || FileSet->Entries == NULL) {
+        YoriLibCabFreeFileSet(FileSet);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < NumberFileNames; Index++) {
+        if (!YoriLibHashInsertByKey(FileSet->Table, &FileNames[Index], NULL, &FileSet->Entries[Index])) {
+            YoriLibCabFreeFileSet(FileSet);
+            return FALSE;
+        }
+        FileSet->Count++;
+    }
+
+    return TRUE;
+}
+
 /**
  Return TRUE to indicate a specified file should be expanded, or FALSE if
- it should not be.
+ it should not be.  Files are compared against the include and exclude
+ lists by exact name, case insensitively.
 
  @param FileName Pointer to a string containing the relative file name within
         the CAB (ie., no destination path.)
@@ -350,23 +541,16 @@ YoriLibCabShouldIncludeFile(
     )
 {
     BOOL IncludeFile = ExpandContext->DefaultInclude;
-    DWORD Count;
 
-    if (IncludeFile) {
-        for (Count = 0; Count < ExpandContext->NumberFilesToExclude; Count++) {
-            if (YoriLibCompareStringInsensitive(FileName, &ExpandContext->FilesToExclude[Count]) == 0) {
-                IncludeFile = FALSE;
-                break;
-            }
+    if (IncludeFile && ExpandContext->FilesToExclude.Table != NULL) {
+        if (YoriLibHashLookupByKey(ExpandContext->FilesToExclude.Table, FileName) != NULL) {
+            IncludeFile = FALSE;
         }
     }
 
-    if (!IncludeFile) {
-        for (Count = 0; Count < ExpandContext->NumberFilesToInclude; Count++) {
-            if (YoriLibCompareStringInsensitive(FileName, &ExpandContext->FilesToInclude[Count]) == 0) {
-                IncludeFile = TRUE;
-                break;
-            }
+    if (!IncludeFile && ExpandContext->FilesToInclude.Table != NULL) {
+        if (YoriLibHashLookupByKey(ExpandContext->FilesToInclude.Table, FileName) != NULL) {
+            IncludeFile = TRUE;
         }
     }
 
@@ -905,17 +1089,37 @@ YoriLibCabNotify(
     LARGE_INTEGER liTemp;
     TIME_ZONE_INFORMATION Tzi;
     PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    PYORI_LIB_CAB_EXPAND_WORKER Worker;
     YORI_STRING FullPath;
     YORI_STRING FileName;
     DWORD_PTR Handle;
+    DWORD FolderIndex;
 
     switch(NotifyType) {
         case YoriLibCabNotifyCopyFile:
-            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
+            Worker = (PYORI_LIB_CAB_EXPAND_WORKER)Notification->Context;
+            ExpandContext = Worker->ExpandContext;
+
+            //
+            //  Skip files in folders that another thread is extracting.
+            //  Folders spanning Cabinets are always handled by the first
+            //  thread.
+            //
+
+            FolderIndex = Notification->CabinetFolderCount;
+            if (FolderIndex >= CAB_FDI_FOLDER_CONTINUED_FROM_PREV) {
+                FolderIndex = 0;
+            }
+            if ((FolderIndex % Worker->WorkerCount) != Worker->WorkerIndex) {
+                return 0;
+            }
+
+            YoriLibCabAcquireExpandLock(ExpandContext);
             if (!YoriLibCabBuildFileNames(ExpandContext->TargetDirectory, Notification->String1, &FullPath, &FileName)) {
                 if (ExpandContext->ErrorString != NULL) {
                     YoriLibYPrintf(ExpandContext->ErrorString, _T("Could not build file name for directory %y CAB name %hs"), ExpandContext->TargetDirectory, Notification->String1);
                 }
+                YoriLibCabReleaseExpandLock(ExpandContext);
                 return (DWORD_PTR)INVALID_HANDLE_VALUE;
             }
             if (YoriLibCabShouldIncludeFile(&FileName, ExpandContext)) {
@@ -929,8 +1133,26 @@ YoriLibCabNotify(
             } else {
                 Handle = 0;
             }
+            YoriLibCabReleaseExpandLock(ExpandContext);
             YoriLibFreeStringContents(&FullPath);
             YoriLibFreeStringContents(&FileName);
+
+            //
+            //  Extend the file to its final size before any data is written
+            //  so the file system can allocate it in one operation rather
+            //  than as each block is decompressed.  This is only an
+            //  optimization, so failure is ignored.
+            //
+
+            if (Handle != 0 &&
+                Handle != (DWORD_PTR)INVALID_HANDLE_VALUE &&
+                Notification->Size > 0) {
+
+                if (SetFilePointer((HANDLE)Handle, Notification->Size, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER) {
+                    SetEndOfFile((HANDLE)Handle);
+                    SetFilePointer((HANDLE)Handle, 0, NULL, FILE_BEGIN);
+                }
+            }
             return Handle;
         case YoriLibCabNotifyCloseFile:
             GetTimeZoneInformation(&Tzi);
@@ -958,12 +1180,15 @@ YoriLibCabNotify(
             SetFileTime((HANDLE)Notification->FileHandle, &TimeToSet, &TimeToSet, &TimeToSet);
             YoriLibCabFdiFileClose(Notification->FileHandle);
 
-            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
+            Worker = (PYORI_LIB_CAB_EXPAND_WORKER)Notification->Context;
+            ExpandContext = Worker->ExpandContext;
             if (YoriLibCabBuildFileNames(ExpandContext->TargetDirectory, Notification->String1, &FullPath, &FileName)) {
                 SetFileAttributes(FullPath.StartOfString, Notification->HalfAttributes);
 
                 if (ExpandContext->CompleteExtractCallback != NULL) {
+                    YoriLibCabAcquireExpandLock(ExpandContext);
                     ExpandContext->CompleteExtractCallback(&FullPath, &FileName, ExpandContext->UserContext);
+                    YoriLibCabReleaseExpandLock(ExpandContext);
                 }
                 YoriLibFreeStringContents(&FullPath);
                 YoriLibFreeStringContents(&FileName);
@@ -978,7 +1203,117 @@ YoriLibCabNotify(
 }
 
 /**
- Extract a cabinet file into a specified directory.
+ Process a Cabinet on behalf of a single extraction thread, extracting the
+ files in folders assigned to that thread.
+
+ @param Worker Pointer to the context for this thread.
+ */
+VOID
+YoriLibCabExpandFolders(
+    __in PYORI_LIB_CAB_EXPAND_WORKER Worker
+    )
+{
+    PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    DWORD Err;
+
+    ExpandContext = Worker->ExpandContext;
+    if (!DllCabinet.pFdiCopy(Worker->hFdi,
+                             Worker->AnsiCabFileName,
+                             Worker->AnsiCabParentDirectory,
+                             0,
+                             YoriLibCabNotify,
+                             NULL,
+                             Worker)) {
+
+        Err = GetLastError();
+        YoriLibCabAcquireExpandLock(ExpandContext);
+        if (ExpandContext->ErrorString != NULL && ExpandContext->ErrorString->LengthInChars == 0) {
+            YoriLibYPrintf(ExpandContext->ErrorString, _T("Error %i in pFdiCopy"), Err);
+        }
+        YoriLibCabReleaseExpandLock(ExpandContext);
+        return;
+    }
+
+    Worker->Result = TRUE;
+}
+
+/**
+ A thread entrypoint for a thread extracting folders from a Cabinet.
+
+ @param Context Pointer to the context for this thread.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibCabExpandWorkerThread(
+    __in LPVOID Context
+    )
+{
+    YoriLibCabExpandFolders((PYORI_LIB_CAB_EXPAND_WORKER)Context);
+    return 0;
+}
+
+/**
+ Determine the number of threads to use to extract a Cabinet.  This is one
+ thread per folder, limited by the number of processors.
+
+ @param hFdi An FDI context which can be used to inspect the Cabinet.
+
+ @param FullCabFileName Pointer to the fully qualified path to the Cabinet.
+
+ @return The number of threads to use.
+ */
+DWORD
+YoriLibCabGetExpandWorkerCount(
+    __in LPVOID hFdi,
+    __in PYORI_STRING FullCabFileName
+    )
+{
+    HANDLE hCab;
+    CAB_FDI_CABINET_INFO CabInfo;
+    SYSTEM_INFO SystemInfo;
+    DWORD WorkerCount;
+
+    if (DllCabinet.pFdiIsCabinet == NULL) {
+        return 1;
+    }
+
+    hCab = CreateFile(FullCabFileName->StartOfString,
+                      GENERIC_READ,
+                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                      NULL);
+
+    if (hCab == INVALID_HANDLE_VALUE) {
+        return 1;
+    }
+
+    WorkerCount = 1;
+    if (DllCabinet.pFdiIsCabinet(hFdi, (DWORD_PTR)hCab, &CabInfo)) {
+        WorkerCount = CabInfo.FolderCount;
+    }
+    CloseHandle(hCab);
+
+    GetSystemInfo(&SystemInfo);
+    if (WorkerCount > SystemInfo.dwNumberOfProcessors) {
+        WorkerCount = SystemInfo.dwNumberOfProcessors;
+    }
+    if (WorkerCount > YORI_LIB_CAB_MAX_EXTRACT_THREADS) {
+        WorkerCount = YORI_LIB_CAB_MAX_EXTRACT_THREADS;
+    }
+    if (WorkerCount == 0) {
+        WorkerCount = 1;
+    }
+
+    return WorkerCount;
+}
+
+/**
+ Extract a cabinet file into a specified directory.  If the Cabinet contains
+ more than one folder, folders are decompressed concurrently on multiple
+ threads.  The callbacks are never invoked concurrently.
 
  @param CabFileName Pointer to the file name of the Cabinet to extract.
 
@@ -987,6 +1322,8 @@ YoriLibCabNotify(
 
  @param IncludeAllByDefault If TRUE, files not listed in the below arrays
         are expanded.  If FALSE, only files explicitly listed are expanded.
+        Files are compared against both arrays by exact name, case
+        insensitively; wildcards are not supported.
 
  @param NumberFilesToInclude The number of files in the FilesToInclude array.
 
@@ -1044,6 +1381,10 @@ YoriLibExtractCab(
     BOOL DefaultUsed = FALSE;
     BOOL Result = FALSE;
     YORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    YORI_LIB_CAB_EXPAND_WORKER Workers[YORI_LIB_CAB_MAX_EXTRACT_THREADS];
+    DWORD WorkerCount;
+    DWORD Index;
+    DWORD ThreadId;
 
     YoriLibLoadCabinetFunctions();
     if (DllCabinet.pFdiCreate == NULL ||
@@ -1059,12 +1400,10 @@ YoriLibExtractCab(
     YoriLibInitEmptyString(&FullTargetDirectory);
     AnsiCabParentDirectory = NULL;
     hFdi = NULL;
+    WorkerCount = 0;
+    ZeroMemory(Workers, sizeof(Workers));
     ZeroMemory(&ExpandContext, sizeof(ExpandContext));
     ExpandContext.DefaultInclude = IncludeAllByDefault;
-    ExpandContext.NumberFilesToInclude = NumberFilesToInclude;
-    ExpandContext.NumberFilesToExclude = NumberFilesToExclude;
-    ExpandContext.FilesToInclude = FilesToInclude;
-    ExpandContext.FilesToExclude = FilesToExclude;
     ExpandContext.CommenceExtractCallback = CommenceExtractCallback;
     ExpandContext.CompleteExtractCallback = CompleteExtractCallback;
     ExpandContext.UserContext = UserContext;
@@ -1074,14 +1413,14 @@ YoriLibExtractCab(
         if (ErrorString != NULL) {
             YoriLibYPrintf(ErrorString, _T("Cannot convert %y to full path"), CabFileName);
         }
-        return FALSE;
+        goto Exit;
     }
 
     if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
         if (ErrorString != NULL) {
             YoriLibYPrintf(ErrorString, _T("Cannot convert %y to full path"), TargetDirectory);
         }
-        return FALSE;
+        goto Exit;
     }
 
     //
@@ -1147,6 +1486,26 @@ YoriLibExtractCab(
 
     AnsiCabFileName[CabFileNameOnly.LengthInChars] = '\0';
 
+    //
+    //  Hash the file lists so each file in the CAB is checked with a
+    //  single lookup regardless of how many files were specified.
+    //
+
+    if (!YoriLibCabBuildFileSet(FilesToExclude, NumberFilesToExclude, &ExpandContext.FilesToExclude)) {
+        if (ErrorString != NULL) {
+            YoriLibYPrintf(ErrorString, _T("Allocation failure"));
+        }
+        goto Exit;
+    }
+
+    if (!YoriLibCabBuildFileSet(FilesToInclude, NumberFilesToInclude, &ExpandContext.FilesToInclude)) {
+
+        if (ErrorString != NULL) {
+            YoriLibYPrintf(ErrorString, _T("Allocation failure"));
+        }
+        goto Exit;
+    }
+
     hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc, YoriLibCabFree, YoriLibCabFdiFileOpen, YoriLibCabFdiFileRead, YoriLibCabFdiFileWrite, YoriLibCabFdiFileClose, YoriLibCabFdiFileSeek, -1, &CabErrors);
 
     if (hFdi == NULL) {
@@ -1158,26 +1517,78 @@ YoriLibExtractCab(
 
     ExpandContext.TargetDirectory = &FullTargetDirectory;
 
-    if (!DllCabinet.pFdiCopy(hFdi,
-                             AnsiCabFileName,
-                             AnsiCabParentDirectory,
-                             0,
-                             YoriLibCabNotify,
-                             NULL,
-                             &ExpandContext)) {
-        if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
-            YoriLibYPrintf(ErrorString, _T("Error %i in pFdiCopy"), GetLastError());
+    //
+    //  Each thread needs its own FDI context.  If additional contexts
+    //  cannot be created, use as many threads as there are contexts.
+    //
+
+    Workers[0].hFdi = hFdi;
+    WorkerCount = 1;
+    Index = YoriLibCabGetExpandWorkerCount(hFdi, &FullCabFileName);
+    if (Index > 1) {
+        ExpandContext.Mutex = CreateMutex(NULL, FALSE, NULL);
+        if (ExpandContext.Mutex != NULL) {
+            while (WorkerCount < Index) {
+                Workers[WorkerCount].hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc, YoriLibCabFree, YoriLibCabFdiFileOpen, YoriLibCabFdiFileRead, YoriLibCabFdiFileWrite, YoriLibCabFdiFileClose, YoriLibCabFdiFileSeek, -1, &Workers[WorkerCount].CabErrors);
+                if (Workers[WorkerCount].hFdi == NULL) {
+                    break;
+                }
+                WorkerCount++;
+            }
+        }
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Workers[Index].ExpandContext = &ExpandContext;
+        Workers[Index].WorkerIndex = Index;
+        Workers[Index].WorkerCount = WorkerCount;
+        Workers[Index].AnsiCabFileName = AnsiCabFileName;
+        Workers[Index].AnsiCabParentDirectory = AnsiCabParentDirectory;
+    }
+
+    //
+    //  Start a thread for each worker other than the first, which runs on
+    //  this thread.  If a thread cannot be created, its folders are
+    //  extracted on this thread once the first worker completes.
+    //
+
+    for (Index = 1; Index < WorkerCount; Index++) {
+        Workers[Index].ThreadHandle = CreateThread(NULL, 0, YoriLibCabExpandWorkerThread, &Workers[Index], 0, &ThreadId);
+    }
+
+    YoriLibCabExpandFolders(&Workers[0]);
+
+    Result = Workers[0].Result;
+    for (Index = 1; Index < WorkerCount; Index++) {
+        if (Workers[Index].ThreadHandle != NULL) {
+            WaitForSingleObject(Workers[Index].ThreadHandle, INFINITE);
+            CloseHandle(Workers[Index].ThreadHandle);
+        } else {
+            YoriLibCabExpandFolders(&Workers[Index]);
+        }
+        if (!Workers[Index].Result) {
+            Result = FALSE;
         }
-        goto Exit;
     }
 
-    Result = TRUE;
 Exit:
 
-    if (DllCabinet.pFdiDestroy != NULL && hFdi != NULL) {
-        DllCabinet.pFdiDestroy(hFdi);
+    if (DllCabinet.pFdiDestroy != NULL) {
+        if (hFdi != NULL) {
+            DllCabinet.pFdiDestroy(hFdi);
+        }
+        for (Index = 1; Index < WorkerCount; Index++) {
+            DllCabinet.pFdiDestroy(Workers[Index].hFdi);
+        }
+    }
+
+    if (ExpandContext.Mutex != NULL) {
+        CloseHandle(ExpandContext.Mutex);
     }
 
+    YoriLibCabFreeFileSet(&ExpandContext.FilesToExclude);
+    YoriLibCabFreeFileSet(&ExpandContext.FilesToInclude);
+
     YoriLibFreeStringContents(&FullCabFileName);
     YoriLibFreeStringContents(&FullTargetDirectory);
     if (AnsiCabParentDirectory != NULL) {
@@ -1186,6 +1597,14 @@ Exit:
     return Result;
 }
 
+/**
+ The amount of uncompressed data to place in each folder of a newly created
+ CAB.  Each folder is compressed independently, so starting a new folder
+ periodically allows the CAB to be extracted on multiple threads at a small
+ cost in compression ratio.
+ */
+#define YORI_LIB_CAB_FOLDER_THRESHOLD (1024 * 1024)
+
 /**
  A structure owned by this module for each CAB file being created.  This is
  the nonopaque form of a handle returned from @ref YoriLibCreateCab .
@@ -1250,11 +1669,12 @@ YoriLibCreateCab(
     //
     //  We don't want to split data across multiple CABs.  This feature
     //  was for floppy disks.  Today, set the maximum size to as large
-    //  as is possible.
+    //  as is possible.  Data is split across folders so that it can be
+    //  decompressed concurrently.
     //
 
     CabHandle->CompressContext.SizeAvailable = 0x7FFFF000;
-    CabHandle->CompressContext.ThresholdForNextFolder = 0x7FFFF000;
+    CabHandle->CompressContext.ThresholdForNextFolder = YORI_LIB_CAB_FOLDER_THRESHOLD;
 
     if (WideCharToMultiByte(CP_ACP, 0, CabFileName->StartOfString, CabFileName->LengthInChars, CabHandle->CompressContext.CabPath, sizeof(CabHandle->CompressContext.CabPath), NULL, &DefaultUsed) != (INT)(CabFileName->LengthInChars)) {
         YoriLibDereference(CabHandle);
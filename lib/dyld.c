@@ -127,6 +127,7 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pAddConsoleAliasW, "AddConsoleAliasW"},
     {(FARPROC *)&DllKernel32.pAssignProcessToJobObject, "AssignProcessToJobObject"},
     {(FARPROC *)&DllKernel32.pCreateHardLinkW, "CreateHardLinkW"},
+    {(FARPROC *)&DllKernel32.pCreateIoCompletionPort, "CreateIoCompletionPort"},
     {(FARPROC *)&DllKernel32.pCreateJobObjectW, "CreateJobObjectW"},
     {(FARPROC *)&DllKernel32.pCreateSymbolicLinkW, "CreateSymbolicLinkW"},
     {(FARPROC *)&DllKernel32.pFindFirstStreamW, "FindFirstStreamW"},
@@ -152,6 +153,8 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pGetPrivateProfileSectionNamesW, "GetPrivateProfileSectionNamesW"},
     {(FARPROC *)&DllKernel32.pGetProcessIoCounters, "GetProcessIoCounters"},
     {(FARPROC *)&DllKernel32.pGetProductInfo, "GetProductInfo"},
+    {(FARPROC *)&DllKernel32.pGetQueuedCompletionStatus, "GetQueuedCompletionStatus"},
+    {(FARPROC *)&DllKernel32.pGetSystemTimes, "GetSystemTimes"},
     {(FARPROC *)&DllKernel32.pGetTickCount64, "GetTickCount64"},
     {(FARPROC *)&DllKernel32.pGetVersionExW, "GetVersionExW"},
     {(FARPROC *)&DllKernel32.pGetVolumePathNamesForVolumeNameW, "GetVolumePathNamesForVolumeNameW"},
@@ -160,6 +163,8 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pIsWow64Process, "IsWow64Process"},
     {(FARPROC *)&DllKernel32.pQueryFullProcessImageNameW, "QueryFullProcessImageNameW"},
     {(FARPROC *)&DllKernel32.pQueryInformationJobObject, "QueryInformationJobObject"},
+    {(FARPROC *)&DllKernel32.pQueryProcessCycleTime, "QueryProcessCycleTime"},
+    {(FARPROC *)&DllKernel32.pReadDirectoryChangesW, "ReadDirectoryChangesW"},
     {(FARPROC *)&DllKernel32.pRegisterApplicationRestart, "RegisterApplicationRestart"},
     {(FARPROC *)&DllKernel32.pRtlCaptureStackBackTrace, "RtlCaptureStackBackTrace"},
     {(FARPROC *)&DllKernel32.pSetConsoleScreenBufferInfoEx, "SetConsoleScreenBufferInfoEx"},
@@ -315,6 +320,7 @@ YoriLibLoadCabinetFunctions()
     DllCabinet.pFdiCreate = (PCAB_FDI_CREATE)GetProcAddress(DllCabinet.hDll, "FDICreate");
     DllCabinet.pFdiCopy = (PCAB_FDI_COPY)GetProcAddress(DllCabinet.hDll, "FDICopy");
     DllCabinet.pFdiDestroy = (PCAB_FDI_DESTROY)GetProcAddress(DllCabinet.hDll, "FDIDestroy");
+    DllCabinet.pFdiIsCabinet = (PCAB_FDI_IS_CABINET)GetProcAddress(DllCabinet.hDll, "FDIIsCabinet");
     return TRUE;
 }
 
@@ -45,6 +45,8 @@ CHAR strFileFiltHelpText[] =
         "   <=  File attribute less than or equal to criteria\n"
         "   &   File attribute includes criteria or wildcard string\n"
         "   !&  File attribute does not include criteria or wildcard string\n"
+        "   ~   File name matches regular expression\n"
+        "   !~  File name does not match regular expression\n"
         "\n"
         " Valid attributes are:\n";
 
@@ -286,6 +288,50 @@ YoriLibFileFiltParseFilterOperator(
     __out PYORI_STRING ErrorSubstring
     )
 {
+    YORILIB_REGEX_PATTERN Pattern;
+    DWORD ErrorOffset;
+
+    YoriLibInitEmptyString(ErrorSubstring);
+
+    //
+    //  Regular expressions are compiled once here and evaluated against
+    //  the file name, which is supported wherever wildcard strings are.
+    //
+
+    if (YoriLibCompareStringWithLiteral(Operator, _T("~")) == 0 ||
+        YoriLibCompareStringWithLiteral(Operator, _T("!~")) == 0) {
+
+        if (MatchedOption->BitwiseCompareFn != YoriLibBitwiseFileName) {
+            ErrorSubstring->StartOfString = Operator->StartOfString;
+            ErrorSubstring->LengthInChars = Operator->LengthInChars;
+            return FALSE;
+        }
+
+        YoriLibInitEmptyString(&Pattern.Pattern);
+        Pattern.Pattern.StartOfString = Value->StartOfString;
+        Pattern.Pattern.LengthInChars = Value->LengthInChars;
+        Pattern.Flags = 0;
+
+        if (!YoriLibRegexCompile(&Pattern, 1, YORILIB_REGEX_INSENSITIVE, &Criteria->Regex, NULL, &ErrorOffset)) {
+            if (ErrorOffset > Value->LengthInChars) {
+                ErrorOffset = 0;
+            }
+            ErrorSubstring->StartOfString = Value->StartOfString + ErrorOffset;
+            ErrorSubstring->LengthInChars = Value->LengthInChars - ErrorOffset;
+            return FALSE;
+        }
+
+        Criteria->CollectFn = MatchedOption->CollectFn;
+        if (Operator->StartOfString[0] == '~') {
+            Criteria->TruthStates[YORI_LIB_EQUAL] = TRUE;
+            Criteria->TruthStates[YORI_LIB_NOT_EQUAL] = FALSE;
+        } else {
+            Criteria->TruthStates[YORI_LIB_EQUAL] = FALSE;
+            Criteria->TruthStates[YORI_LIB_NOT_EQUAL] = TRUE;
+        }
+        return TRUE;
+    }
+
     //
     //  Based on the operator, fill in the truth table.  We'll
     //  use the generic compare function and based on this
@@ -293,7 +339,6 @@ YoriLibFileFiltParseFilterOperator(
     //  or not.
     //
 
-    YoriLibInitEmptyString(ErrorSubstring);
     if (YoriLibCompareStringWithLiteral(Operator, _T(">")) == 0) {
         Criteria->CompareFn = MatchedOption->CompareFn;
         Criteria->TruthStates[YORI_LIB_LESS_THAN] = FALSE;
@@ -408,7 +453,7 @@ YoriLibFileFiltParseFilterOptAndOperator(
 
     YoriLibTrimSpaces(&SwitchName);
 
-    SwitchName.LengthInChars = YoriLibCountStringNotContainingChars(&SwitchName, _T("&<>=!"));
+    SwitchName.LengthInChars = YoriLibCountStringNotContainingChars(&SwitchName, _T("&<>=!~"));
     FoundOpt = NULL;
 
     for (Count = 0; Count < sizeof(YoriLibFileFiltFilterOptions)/sizeof(YoriLibFileFiltFilterOptions[0]); Count++) {
@@ -431,7 +476,19 @@ YoriLibFileFiltParseFilterOptAndOperator(
     Operator->StartOfString = SwitchName.StartOfString + SwitchName.LengthInChars;
     Operator->LengthInChars = FilterElement->LengthInChars - SwitchName.LengthInChars - (DWORD)(SwitchName.StartOfString - FilterElement->StartOfString);
 
-    Operator->LengthInChars = YoriLibCountStringContainingChars(Operator, _T("&<>=!"));
+    Operator->LengthInChars = YoriLibCountStringContainingChars(Operator, _T("&<>=!~"));
+
+    //
+    //  A regular expression can begin with characters that look like an
+    //  operator, so the operator ends immediately after a '~'.
+    //
+
+    for (Count = 0; Count < Operator->LengthInChars; Count++) {
+        if (Operator->StartOfString[Count] == '~') {
+            Operator->LengthInChars = Count + 1;
+            break;
+        }
+    }
     return TRUE;
 }
 
@@ -624,7 +681,10 @@ YoriLibFileFiltParseFilterStringInternal(
                     ASSERT(Phase == 1);
                     ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Criteria, ElementCount * AllocationSize);
                     if (!Fn(ThisElement, &Element, ErrorSubstring)) {
-                        YoriLibFree(Criteria);
+                        Filter->Criteria = Criteria;
+                        Filter->ElementSize = AllocationSize;
+                        Filter->NumberCriteria = ElementCount + 1;
+                        YoriLibFileFiltFreeFilter(Filter);
                         return FALSE;
                     }
 
@@ -738,6 +798,38 @@ YoriLibFileFiltParseColorString(
     return YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), ErrorSubstring);
 }
 
+/**
+ Evaluate a single criteria against a file whose information has already
+ been collected.
+
+ @param Criteria Pointer to the criteria to evaluate.
+
+ @param CompareEntry Pointer to the information collected from the file.
+
+ @return TRUE to indicate the file satisfies the criteria, FALSE if it does
+         not.
+ */
+BOOL
+YoriLibFileFiltEvaluateCriteria(
+    __in PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria,
+    __in PYORI_FILE_INFO CompareEntry
+    )
+{
+    YORI_STRING FileName;
+
+    if (Criteria->Regex != NULL) {
+        YoriLibInitEmptyString(&FileName);
+        FileName.StartOfString = CompareEntry->FileName;
+        FileName.LengthInChars = CompareEntry->FileNameLengthInChars;
+        if (YoriLibRegexMatch(Criteria->Regex, &FileName, NULL)) {
+            return Criteria->TruthStates[YORI_LIB_EQUAL];
+        }
+        return Criteria->TruthStates[YORI_LIB_NOT_EQUAL];
+    }
+
+    return Criteria->TruthStates[Criteria->CompareFn(CompareEntry, &Criteria->CompareEntry)];
+}
+
 /**
  Evaluate whether a found file meets the criteria specified by the user
  supplied filter string.
@@ -782,7 +874,7 @@ YoriLibFileFiltCheckFilterMatch(
             return FALSE;
         }
 
-        if (!Criteria->TruthStates[Criteria->CompareFn(&CompareEntry, &Criteria->CompareEntry)]) {
+        if (!YoriLibFileFiltEvaluateCriteria(Criteria, &CompareEntry)) {
             return FALSE;
         }
     }
@@ -851,7 +943,7 @@ YoriLibFileFiltCheckColorMatch(
             return FALSE;
         }
 
-        if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(&CompareEntry, &ThisApply->Match.CompareEntry)]) {
+        if (YoriLibFileFiltEvaluateCriteria(&ThisApply->Match, &CompareEntry)) {
             YoriLibCombineColors(ThisAttribute, ThisApply->Color, &ThisAttribute);
             if ((ThisAttribute.Ctrl & YORILIB_ATTRCTRL_CONTINUE) == 0) {
 
@@ -901,7 +993,16 @@ YoriLibFileFiltFreeFilter(
     __in PYORI_LIB_FILE_FILTER Filter
     )
 {
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria;
+    DWORD Index;
+
     if (Filter->Criteria != NULL) {
+        for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+            Criteria = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+            if (Criteria->Regex != NULL) {
+                YoriLibRegexFree(Criteria->Regex);
+            }
+        }
         YoriLibFree(Filter->Criteria);
     }
     Filter->Criteria = NULL;
@@ -0,0 +1,309 @@
+/**
+ * @file lib/filepool.c
+ *
+ * Yori process files on a set of worker threads while completing them in
+ * the order they were queued
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ Prepare a file pool for use.  No threads are created until
+ @ref YoriLibFilePoolStartWorkers is called.
+
+ @param Pool Pointer to the pool to initialize.
+
+ @param InitializeFn Optional callback invoked before each worker thread is
+        created.
+
+ @param ProcessFn Callback invoked to process each file.
+
+ @param CompleteFn Callback invoked on the queueing thread once each file has
+        been processed, in the order files were queued.
+
+ @param Context Context passed to each callback.
+ */
+VOID
+YoriLibFilePoolInitialize(
+    __out PYORI_LIB_FILE_POOL Pool,
+    __in_opt PYORI_LIB_FILE_POOL_INITIALIZE_FN InitializeFn,
+    __in PYORI_LIB_FILE_POOL_PROCESS_FN ProcessFn,
+    __in PYORI_LIB_FILE_POOL_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    )
+{
+    ZeroMemory(Pool, sizeof(YORI_LIB_FILE_POOL));
+    Pool->InitializeFn = InitializeFn;
+    Pool->ProcessFn = ProcessFn;
+    Pool->CompleteFn = CompleteFn;
+    Pool->Context = Context;
+    YoriLibInitializeListHead(&Pool->FileList);
+    YoriLibInitializeListHead(&Pool->PendingList);
+}
+
+/**
+ A worker thread which processes files from the pending list until no
+ further files will be added.
+
+ @param Context Pointer to the worker state.
+
+ @return Exit code for the thread, which is always zero.
+ */
+DWORD WINAPI
+YoriLibFilePoolWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_FILE_POOL_WORKER Worker = (PYORI_LIB_FILE_POOL_WORKER)Context;
+    PYORI_LIB_FILE_POOL Pool = Worker->Pool;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_FILE_POOL_ITEM Item;
+
+    while (TRUE) {
+        WaitForSingleObject(Pool->WorkAvailable, INFINITE);
+
+        WaitForSingleObject(Pool->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&Pool->PendingList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+        }
+        ReleaseMutex(Pool->Mutex);
+
+        if (ListEntry == NULL) {
+            break;
+        }
+
+        Item = CONTAINING_RECORD(ListEntry, YORI_LIB_FILE_POOL_ITEM, PendingListEntry);
+        Pool->ProcessFn(Pool->Context, Worker->Index, Item);
+        SetEvent(Item->CompleteEvent);
+    }
+
+    return 0;
+}
+
+/**
+ Create worker threads to process files concurrently.  The number of threads
+ is bounded by the number of processors.  If this fails, files are processed
+ on the queueing thread.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriLibFilePoolStartWorkers(
+    __inout PYORI_LIB_FILE_POOL Pool
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    PYORI_LIB_FILE_POOL_WORKER Worker;
+    DWORD ThreadCount;
+    DWORD ThreadId;
+
+    GetSystemInfo(&SystemInfo);
+    ThreadCount = SystemInfo.dwNumberOfProcessors;
+    if (ThreadCount > YORI_LIB_FILE_POOL_MAX_THREADS) {
+        ThreadCount = YORI_LIB_FILE_POOL_MAX_THREADS;
+    }
+
+    Pool->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Pool->Mutex == NULL) {
+        return;
+    }
+
+    Pool->WorkAvailable = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    if (Pool->WorkAvailable == NULL) {
+        return;
+    }
+
+    while (Pool->ThreadCount < ThreadCount) {
+        Worker = &Pool->Workers[Pool->ThreadCount];
+        if (Pool->InitializeFn != NULL &&
+            !Pool->InitializeFn(Pool->Context, Pool->ThreadCount)) {
+
+            break;
+        }
+        Worker->Pool = Pool;
+        Worker->Index = Pool->ThreadCount;
+        Worker->Thread = CreateThread(NULL, 0, YoriLibFilePoolWorkerThread, Worker, 0, &ThreadId);
+        if (Worker->Thread == NULL) {
+            break;
+        }
+        Pool->ThreadCount++;
+    }
+}
+
+/**
+ Prepare a file to be queued to a pool.  If this succeeds and the file is
+ not subsequently queued, the caller should call
+ @ref YoriLibFilePoolCleanupItem .
+
+ @param Item Pointer to the file to prepare.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibFilePoolInitializeItem(
+    __out PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    ZeroMemory(Item, sizeof(YORI_LIB_FILE_POOL_ITEM));
+    Item->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Item->CompleteEvent == NULL) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Free the state allocated when preparing a file that was never queued to
+ a pool.  Files that are queued are cleaned up by the pool before their
+ complete callback is invoked.
+
+ @param Item Pointer to the file to clean up.
+ */
+VOID
+YoriLibFilePoolCleanupItem(
+    __inout PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    if (Item->CompleteEvent != NULL) {
+        CloseHandle(Item->CompleteEvent);
+        Item->CompleteEvent = NULL;
+    }
+}
+
+/**
+ Invoke the complete callback for files which have been processed, in the
+ order they were queued.
+
+ @param Pool Pointer to the pool.
+
+ @param WaitCount Specifies the number of files which should remain
+        outstanding.  This routine waits for files to complete until no more
+        than this number are outstanding, and completes any files that have
+        been processed without waiting.
+ */
+VOID
+YoriLibFilePoolCompleteItems(
+    __inout PYORI_LIB_FILE_POOL Pool,
+    __in DWORD WaitCount
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_FILE_POOL_ITEM Item;
+
+    while (TRUE) {
+        ListEntry = YoriLibGetNextListEntry(&Pool->FileList, NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+
+        Item = CONTAINING_RECORD(ListEntry, YORI_LIB_FILE_POOL_ITEM, ListEntry);
+        if (Pool->FilesOutstanding > WaitCount) {
+            WaitForSingleObject(Item->CompleteEvent, INFINITE);
+        } else if (WaitForSingleObject(Item->CompleteEvent, 0) != WAIT_OBJECT_0) {
+            break;
+        }
+
+        YoriLibRemoveListItem(ListEntry);
+        Pool->FilesOutstanding--;
+
+        YoriLibFilePoolCleanupItem(Item);
+        Pool->CompleteFn(Pool->Context, Item);
+    }
+}
+
+/**
+ Queue a prepared file to be processed.  If worker threads are available the
+ file is processed on a worker thread, otherwise it is processed
+ immediately.  Files which have finished processing are completed in the
+ order they were queued, and if too many files are outstanding this routine
+ waits for the oldest to finish.
+
+ @param Pool Pointer to the pool.
+
+ @param Item Pointer to the file to queue, which was prepared with
+        @ref YoriLibFilePoolInitializeItem .  Ownership of the file passes
+        to the pool until its complete callback is invoked.
+ */
+VOID
+YoriLibFilePoolQueueItem(
+    __inout PYORI_LIB_FILE_POOL Pool,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    YoriLibAppendList(&Pool->FileList, &Item->ListEntry);
+    Pool->FilesOutstanding++;
+
+    if (Pool->ThreadCount > 0) {
+        WaitForSingleObject(Pool->Mutex, INFINITE);
+        YoriLibAppendList(&Pool->PendingList, &Item->PendingListEntry);
+        ReleaseMutex(Pool->Mutex);
+        ReleaseSemaphore(Pool->WorkAvailable, 1, NULL);
+    } else {
+        Pool->ProcessFn(Pool->Context, YORI_LIB_FILE_POOL_CALLING_THREAD, Item);
+        SetEvent(Item->CompleteEvent);
+    }
+
+    YoriLibFilePoolCompleteItems(Pool, Pool->ThreadCount * YORI_LIB_FILE_POOL_FILES_PER_THREAD);
+}
+
+/**
+ Wait for all queued files to be processed and completed, and terminate any
+ worker threads.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriLibFilePoolStopWorkers(
+    __inout PYORI_LIB_FILE_POOL Pool
+    )
+{
+    DWORD Index;
+
+    if (Pool->ThreadCount > 0) {
+        ReleaseSemaphore(Pool->WorkAvailable, Pool->ThreadCount, NULL);
+    }
+
+    YoriLibFilePoolCompleteItems(Pool, 0);
+
+    for (Index = 0; Index < Pool->ThreadCount; Index++) {
+        WaitForSingleObject(Pool->Workers[Index].Thread, INFINITE);
+        CloseHandle(Pool->Workers[Index].Thread);
+        Pool->Workers[Index].Thread = NULL;
+    }
+    Pool->ThreadCount = 0;
+
+    if (Pool->WorkAvailable != NULL) {
+        CloseHandle(Pool->WorkAvailable);
+        Pool->WorkAvailable = NULL;
+    }
+
+    if (Pool->Mutex != NULL) {
+        CloseHandle(Pool->Mutex);
+        Pool->Mutex = NULL;
+    }
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,682 @@
+/**
+ * @file lib/globset.c
+ *
+ * Yori compiled sets of wildcard patterns
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ A value used to indicate no node or no pattern.
+ */
+#define YORILIB_GLOB_NONE ((DWORD)-1)
+
+/**
+ A single node within a trie of literal prefixes or suffixes.  Node zero is
+ the root and corresponds to an empty string.
+ */
+typedef struct _YORILIB_GLOB_TRIE_NODE {
+
+    /**
+     The upper case character which leads from the parent to this node.
+     */
+    TCHAR Char;
+
+    /**
+     The index of the first child of this node, or YORILIB_GLOB_NONE if the
+     node has no children.
+     */
+    DWORD FirstChild;
+
+    /**
+     The index of the next child of this node's parent, or YORILIB_GLOB_NONE
+     if this is the final child.
+     */
+    DWORD NextSibling;
+
+    /**
+     The lowest pattern index which matches when the string reaches this
+     node, or YORILIB_GLOB_NONE if reaching this node is not a match.
+     */
+    DWORD Match;
+} YORILIB_GLOB_TRIE_NODE, *PYORILIB_GLOB_TRIE_NODE;
+
+/**
+ A trie of literal strings, used for patterns which are a literal followed
+ by a wildcard or a wildcard followed by a literal.
+ */
+typedef struct _YORILIB_GLOB_TRIE {
+
+    /**
+     An array of nodes in the trie.  This is allocated large enough for
+     every pattern to require a new node for every character.
+     */
+    PYORILIB_GLOB_TRIE_NODE Nodes;
+
+    /**
+     The number of nodes in use.
+     */
+    DWORD NodeCount;
+} YORILIB_GLOB_TRIE, *PYORILIB_GLOB_TRIE;
+
+/**
+ A compiled set of wildcard patterns.
+ */
+struct _YORILIB_GLOB_SET {
+
+    /**
+     A hash table of patterns which contain no wildcards.  The context of
+     each entry is the index of the pattern.
+     */
+    PYORI_HASH_TABLE Literals;
+
+    /**
+     An array of hash entries, one for each literal pattern inserted into
+     the Literals table.
+     */
+    PYORI_HASH_ENTRY LiteralEntries;
+
+    /**
+     The number of entries in LiteralEntries which are inserted into the
+     Literals table.
+     */
+    DWORD LiteralCount;
+
+    /**
+     A trie of patterns which consist of a literal followed by '*'.  A
+     pattern consisting entirely of '*' is recorded on the root node.
+     */
+    YORILIB_GLOB_TRIE Prefixes;
+
+    /**
+     A trie of patterns which consist of '*' followed by a literal.  The
+     literal is inserted in reverse order.
+     */
+    YORILIB_GLOB_TRIE Suffixes;
+
+    /**
+     Every other pattern, compiled into a single set of regular expressions
+     so the string is processed once regardless of the number of patterns.
+     This is NULL if no patterns require it.
+     */
+    PYORILIB_REGEX Wildcards;
+
+    /**
+     An array which translates the index of a pattern within Wildcards to
+     the index of the pattern within the glob set.
+     */
+    PDWORD WildcardIndex;
+};
+
+/**
+ Describes the form of a single wildcard pattern, which determines the
+ structure it is compiled into.
+ */
+typedef enum _YORILIB_GLOB_KIND {
+    YoriLibGlobLiteral = 0,
+    YoriLibGlobPrefix = 1,
+    YoriLibGlobSuffix = 2,
+    YoriLibGlobWildcard = 3
+} YORILIB_GLOB_KIND;
+
+/**
+ Determine the form of a wildcard pattern.
+
+ @param Pattern Pointer to the pattern.
+
+ @param Literal On successful completion, updated to point to the literal
+        portion of the pattern for a literal, prefix or suffix pattern.
+
+ @return The form of the pattern.
+ */
+YORILIB_GLOB_KIND
+YoriLibGlobClassify(
+    __in PYORI_STRING Pattern,
+    __out PYORI_STRING Literal
+    )
+{
+    DWORD Index;
+    DWORD LeadingStars;
+    DWORD TrailingStars;
+
+    YoriLibInitEmptyString(Literal);
+
+    if (Pattern->LengthInChars == 0) {
+        return YoriLibGlobLiteral;
+    }
+
+    for (Index = 0; Index < Pattern->LengthInChars; Index++) {
+        if (Pattern->StartOfString[Index] == '?') {
+            return YoriLibGlobWildcard;
+        }
+    }
+
+    for (LeadingStars = 0; LeadingStars < Pattern->LengthInChars; LeadingStars++) {
+        if (Pattern->StartOfString[LeadingStars] != '*') {
+            break;
+        }
+    }
+
+    //
+    //  A pattern consisting entirely of '*' matches everything, which is
+    //  an empty prefix.
+    //
+
+    if (LeadingStars == Pattern->LengthInChars) {
+        return YoriLibGlobPrefix;
+    }
+
+    for (TrailingStars = 0; TrailingStars < Pattern->LengthInChars; TrailingStars++) {
+        if (Pattern->StartOfString[Pattern->LengthInChars - TrailingStars - 1] != '*') {
+            break;
+        }
+    }
+
+    if (LeadingStars > 0 && TrailingStars > 0) {
+        return YoriLibGlobWildcard;
+    }
+
+    Literal->StartOfString = &Pattern->StartOfString[LeadingStars];
+    Literal->LengthInChars = Pattern->LengthInChars - LeadingStars - TrailingStars;
+
+    for (Index = 0; Index < Literal->LengthInChars; Index++) {
+        if (Literal->StartOfString[Index] == '*') {
+            YoriLibInitEmptyString(Literal);
+            return YoriLibGlobWildcard;
+        }
+    }
+
+    if (LeadingStars > 0) {
+        return YoriLibGlobSuffix;
+    }
+    if (TrailingStars > 0) {
+        return YoriLibGlobPrefix;
+    }
+    return YoriLibGlobLiteral;
+}
+
+/**
+ Insert a literal into a trie.
+
+ @param Trie Pointer to the trie, which must have sufficient nodes
+        allocated to add a node for every character in the literal.
+
+ @param Literal Pointer to the literal to insert.
+
+ @param Reverse If TRUE, the literal is inserted from its final character
+        to its first, which allows a trie to match suffixes.
+
+ @param PatternIndex The index of the pattern to report if a string reaches
+        the end of the literal.
+ */
+VOID
+YoriLibGlobTrieInsert(
+    __in PYORILIB_GLOB_TRIE Trie,
+    __in PYORI_STRING Literal,
+    __in BOOL Reverse,
+    __in DWORD PatternIndex
+    )
+{
+    DWORD Index;
+    DWORD Node;
+    DWORD Child;
+    TCHAR Char;
+
+    Node = 0;
+    for (Index = 0; Index < Literal->LengthInChars; Index++) {
+        if (Reverse) {
+            Char = Literal->StartOfString[Literal->LengthInChars - Index - 1];
+        } else {
+            Char = Literal->StartOfString[Index];
+        }
+        Char = YoriLibUpcaseChar(Char);
+
+        Child = Trie->Nodes[Node].FirstChild;
+        while (Child != YORILIB_GLOB_NONE) {
+            if (Trie->Nodes[Child].Char == Char) {
+                break;
+            }
+            Child = Trie->Nodes[Child].NextSibling;
+        }
+
+        if (Child == YORILIB_GLOB_NONE) {
+            Child = Trie->NodeCount;
+            Trie->NodeCount++;
+            Trie->Nodes[Child].Char = Char;
+            Trie->Nodes[Child].FirstChild = YORILIB_GLOB_NONE;
+            Trie->Nodes[Child].NextSibling = Trie->Nodes[Node].FirstChild;
+            Trie->Nodes[Child].Match = YORILIB_GLOB_NONE;
+            Trie->Nodes[Node].FirstChild = Child;
+        }
+
+        Node = Child;
+    }
+
+    //
+    //  Patterns are inserted in order, so the first to reach a node is the
+    //  lowest index.
+    //
+
+    if (Trie->Nodes[Node].Match == YORILIB_GLOB_NONE) {
+        Trie->Nodes[Node].Match = PatternIndex;
+    }
+}
+
+/**
+ Walk a string through a trie and return the lowest pattern index recorded
+ on any node along the path.
+
+ @param Trie Pointer to the trie.
+
+ @param String Pointer to the string to walk.
+
+ @param Reverse If TRUE, walk the string from its final character to its
+        first.
+
+ @param Match The lowest matching pattern index found so far.  Nodes are
+        only examined while they could find a lower index.
+
+ @return The lowest matching pattern index, which is Match if the trie
+         contains nothing lower.
+ */
+DWORD
+YoriLibGlobTrieMatch(
+    __in PYORILIB_GLOB_TRIE Trie,
+    __in PYORI_STRING String,
+    __in BOOL Reverse,
+    __in DWORD Match
+    )
+{
+    DWORD Index;
+    DWORD Node;
+    TCHAR Char;
+
+    if (Trie->NodeCount == 0) {
+        return Match;
+    }
+
+    Node = 0;
+    Index = 0;
+    while (TRUE) {
+        if (Trie->Nodes[Node].Match < Match) {
+            Match = Trie->Nodes[Node].Match;
+        }
+
+        if (Index >= String->LengthInChars || Match == 0) {
+            break;
+        }
+
+        if (Reverse) {
+            Char = String->StartOfString[String->LengthInChars - Index - 1];
+        } else {
+            Char = String->StartOfString[Index];
+        }
+        Char = YoriLibUpcaseChar(Char);
+        Index++;
+
+        Node = Trie->Nodes[Node].FirstChild;
+        while (Node != YORILIB_GLOB_NONE) {
+            if (Trie->Nodes[Node].Char == Char) {
+                break;
+            }
+            Node = Trie->Nodes[Node].NextSibling;
+        }
+
+        if (Node == YORILIB_GLOB_NONE) {
+            break;
+        }
+    }
+
+    return Match;
+}
+
+/**
+ Translate a wildcard pattern into an equivalent regular expression.  '*'
+ matches any number of characters and '?' matches any single character,
+ except that wildcards at the end of the pattern may also match nothing,
+ consistent with @ref YoriLibDoesFileMatchExpression .
+
+ @param Pattern Pointer to the wildcard pattern.
+
+ @param Expression Pointer to a string to populate with the regular
+        expression.  This must have been allocated with at least twice the
+        number of characters in Pattern.
+ */
+VOID
+YoriLibGlobToRegex(
+    __in PYORI_STRING Pattern,
+    __inout PYORI_STRING Expression
+    )
+{
+    DWORD Index;
+    DWORD TrailingWildcards;
+    TCHAR Char;
+
+    for (TrailingWildcards = 0; TrailingWildcards < Pattern->LengthInChars; TrailingWildcards++) {
+        Char = Pattern->StartOfString[Pattern->LengthInChars - TrailingWildcards - 1];
+        if (Char != '*' && Char != '?') {
+            break;
+        }
+    }
+
+    Expression->LengthInChars = 0;
+    for (Index = 0; Index < Pattern->LengthInChars; Index++) {
+        Char = Pattern->StartOfString[Index];
+        if (Char == '*') {
+            if (Index > 0 && Pattern->StartOfString[Index - 1] == '*') {
+                continue;
+            }
+            Expression->StartOfString[Expression->LengthInChars++] = '.';
+            Expression->StartOfString[Expression->LengthInChars++] = '*';
+        } else if (Char == '?') {
+            Expression->StartOfString[Expression->LengthInChars++] = '.';
+            if (Index >= Pattern->LengthInChars - TrailingWildcards) {
+                Expression->StartOfString[Expression->LengthInChars++] = '?';
+            }
+        } else {
+            if ((Char < 'a' || Char > 'z') &&
+                (Char < 'A' || Char > 'Z') &&
+                (Char < '0' || Char > '9')) {
+
+                Expression->StartOfString[Expression->LengthInChars++] = '\\';
+            }
+            Expression->StartOfString[Expression->LengthInChars++] = Char;
+        }
+    }
+}
+
+/**
+ Free a compiled set of wildcard patterns.
+
+ @param GlobSet The compiled set to free.
+ */
+VOID
+YoriLibGlobSetFree(
+    __in PYORILIB_GLOB_SET GlobSet
+    )
+{
+    DWORD Index;
+
+    if (GlobSet->Literals != NULL) {
+        for (Index = 0; Index < GlobSet->LiteralCount; Index++) {
+            YoriLibHashRemoveByEntry(&GlobSet->LiteralEntries[Index]);
+        }
+        YoriLibFreeEmptyHashTable(GlobSet->Literals);
+    }
+
+    if (GlobSet->LiteralEntries != NULL) {
+        YoriLibFree(GlobSet->LiteralEntries);
+    }
+
+    if (GlobSet->Prefixes.Nodes != NULL) {
+        YoriLibFree(GlobSet->Prefixes.Nodes);
+    }
+
+    if (GlobSet->Suffixes.Nodes != NULL) {
+        YoriLibFree(GlobSet->Suffixes.Nodes);
+    }
+
+    if (GlobSet->Wildcards != NULL) {
+        YoriLibRegexFree(GlobSet->Wildcards);
+    }
+
+    if (GlobSet->WildcardIndex != NULL) {
+        YoriLibFree(GlobSet->WildcardIndex);
+    }
+
+    YoriLibFree(GlobSet);
+}
+
+/**
+ Compile a set of wildcard patterns so that a string can be tested against
+ all of them at once.  Patterns without wildcards are placed in a hash
+ table, patterns of the form "literal*" or "*literal" are placed in tries,
+ and all other patterns are combined into a single automaton.  Comparisons
+ are not case sensitive.
+
+ @param Patterns Pointer to an array of patterns.  The patterns are not
+        referenced after this call returns.
+
+ @param PatternCount The number of elements in the Patterns array.  This
+        can be zero, in which case the set matches nothing.
+
+ @param GlobSet On successful completion, updated to point to the compiled
+        set.  The caller should free this with @ref YoriLibGlobSetFree .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibGlobSetCompile(
+    __in PYORI_STRING Patterns,
+    __in DWORD PatternCount,
+    __out PYORILIB_GLOB_SET *GlobSet
+    )
+{
+    PYORILIB_GLOB_SET NewSet;
+    PYORILIB_REGEX_PATTERN Expressions;
+    LPTSTR ExpressionBuffer;
+    YORI_STRING Literal;
+    YORILIB_GLOB_KIND Kind;
+    DWORD Index;
+    DWORD TotalChars;
+    DWORD ExpressionCount;
+    DWORD PrefixCount;
+    DWORD SuffixCount;
+
+    NewSet = YoriLibMalloc(sizeof(YORILIB_GLOB_SET));
+    if (NewSet == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewSet, sizeof(YORILIB_GLOB_SET));
+    Expressions = NULL;
+    ExpressionBuffer = NULL;
+
+    //
+    //  Count how many patterns of each form exist so each structure can
+    //  be allocated once.
+    //
+
+    TotalChars = 0;
+    PrefixCount = 0;
+    SuffixCount = 0;
+    ExpressionCount = 0;
+    for (Index = 0; Index < PatternCount; Index++) {
+        Kind = YoriLibGlobClassify(&Patterns[Index], &Literal);
+        if (Kind == YoriLibGlobLiteral) {
+            NewSet->LiteralCount++;
+        } else if (Kind == YoriLibGlobPrefix) {
+            PrefixCount += Literal.LengthInChars + 1;
+        } else if (Kind == YoriLibGlobSuffix) {
+            SuffixCount += Literal.LengthInChars + 1;
+        } else {
+            ExpressionCount++;
+            TotalChars += Patterns[Index].LengthInChars * 2;
+        }
+    }
+
+    if (NewSet->LiteralCount > 0) {
+        NewSet->Literals = YoriLibAllocateHashTable(NewSet->LiteralCount * 2 + 1);
+        NewSet->LiteralEntries = YoriLibMalloc(NewSet->LiteralCount * sizeof(YORI_HASH_ENTRY));
+        NewSet->LiteralCount = 0;
+        if (NewSet->Literals == NULL || NewSet->LiteralEntries == NULL) {
+            goto Fail;
+        }
+    }
+
+    if (PrefixCount > 0) {
+        NewSet->Prefixes.Nodes = YoriLibMalloc((PrefixCount + 1) * sizeof(YORILIB_GLOB_TRIE_NODE));
+        if (NewSet->Prefixes.Nodes == NULL) {
+            goto Fail;
+        }
+        NewSet->Prefixes.Nodes[0].FirstChild = YORILIB_GLOB_NONE;
+        NewSet->Prefixes.Nodes[0].NextSibling = YORILIB_GLOB_NONE;
+        NewSet->Prefixes.Nodes[0].Match = YORILIB_GLOB_NONE;
+        NewSet->Prefixes.NodeCount = 1;
+    }
+
+    if (SuffixCount > 0) {
+        NewSet->Suffixes.Nodes = YoriLibMalloc((SuffixCount + 1) * sizeof(YORILIB_GLOB_TRIE_NODE));
+        if (NewSet->Suffixes.Nodes == NULL) {
+            goto Fail;
+        }
+        NewSet->Suffixes.Nodes[0].FirstChild = YORILIB_GLOB_NONE;
+        NewSet->Suffixes.Nodes[0].NextSibling = YORILIB_GLOB_NONE;
+        NewSet->Suffixes.Nodes[0].Match = YORILIB_GLOB_NONE;
+        NewSet->Suffixes.NodeCount = 1;
+    }
+
+    if (ExpressionCount > 0) {
+        Expressions = YoriLibMalloc(ExpressionCount * sizeof(YORILIB_REGEX_PATTERN));
+        NewSet->WildcardIndex = YoriLibMalloc(ExpressionCount * sizeof(DWORD));
+        ExpressionBuffer = YoriLibMalloc(TotalChars * sizeof(TCHAR));
+        if (Expressions == NULL ||
+            NewSet->WildcardIndex == NULL ||
+            ExpressionBuffer == NULL) {
+
+            goto Fail;
+        }
+    }
+
+    //
+    //  Populate each structure in pattern order.
+    //
+
+    ExpressionCount = 0;
+    TotalChars = 0;
+    for (Index = 0; Index < PatternCount; Index++) {
+        Kind = YoriLibGlobClassify(&Patterns[Index], &Literal);
+        if (Kind == YoriLibGlobLiteral) {
+            if (YoriLibHashLookupByKey(NewSet->Literals, &Literal) == NULL) {
+                if (!YoriLibHashInsertByKey(NewSet->Literals, &Literal, (PVOID)(DWORD_PTR)Index, &NewSet->LiteralEntries[NewSet->LiteralCount])) {
+                    goto Fail;
+                }
+                NewSet->LiteralCount++;
+            }
+        } else if (Kind == YoriLibGlobPrefix) {
+            YoriLibGlobTrieInsert(&NewSet->Prefixes, &Literal, FALSE, Index);
+        } else if (Kind == YoriLibGlobSuffix) {
+            YoriLibGlobTrieInsert(&NewSet->Suffixes, &Literal, TRUE, Index);
+        } else {
+            YoriLibInitEmptyString(&Expressions[ExpressionCount].Pattern);
+            Expressions[ExpressionCount].Pattern.StartOfString = &ExpressionBuffer[TotalChars];
+            Expressions[ExpressionCount].Pattern.LengthAllocated = Patterns[Index].LengthInChars * 2;
+            Expressions[ExpressionCount].Flags = YORILIB_REGEX_PATTERN_ANCHOR_START | YORILIB_REGEX_PATTERN_ANCHOR_END;
+            YoriLibGlobToRegex(&Patterns[Index], &Expressions[ExpressionCount].Pattern);
+            NewSet->WildcardIndex[ExpressionCount] = Index;
+            TotalChars += Patterns[Index].LengthInChars * 2;
+            ExpressionCount++;
+        }
+    }
+
+    if (ExpressionCount > 0) {
+        if (!YoriLibRegexCompile(Expressions, ExpressionCount, YORILIB_REGEX_INSENSITIVE, &NewSet->Wildcards, NULL, NULL)) {
+            NewSet->Wildcards = NULL;
+            goto Fail;
+        }
+        YoriLibFree(Expressions);
+        YoriLibFree(ExpressionBuffer);
+    }
+
+    *GlobSet = NewSet;
+    return TRUE;
+
+Fail:
+
+    if (Expressions != NULL) {
+        YoriLibFree(Expressions);
+    }
+    if (ExpressionBuffer != NULL) {
+        YoriLibFree(ExpressionBuffer);
+    }
+    YoriLibGlobSetFree(NewSet);
+    return FALSE;
+}
+
+/**
+ Test a string against a compiled set of wildcard patterns.  The entire
+ string must match a pattern.
+
+ Patterns which require the automaton share a lazily constructed DFA, so
+ the compiled set must not be used by more than one thread at a time.
+
+ @param GlobSet The compiled set of patterns.
+
+ @param String The string to test.
+
+ @param PatternIndex On successful completion, optionally updated with the
+        index of the first pattern in the set which matches the string.
+
+ @return TRUE if any pattern matches the string, FALSE if none do.
+ */
+__success(return)
+BOOL
+YoriLibGlobSetMatch(
+    __in PYORILIB_GLOB_SET GlobSet,
+    __in PYORI_STRING String,
+    __out_opt PDWORD PatternIndex
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    DWORD Match;
+    DWORD WildcardMatch;
+
+    Match = YORILIB_GLOB_NONE;
+
+    if (GlobSet->LiteralCount > 0) {
+        HashEntry = YoriLibHashLookupByKey(GlobSet->Literals, String);
+        if (HashEntry != NULL) {
+            Match = (DWORD)(DWORD_PTR)HashEntry->Context;
+        }
+    }
+
+    Match = YoriLibGlobTrieMatch(&GlobSet->Prefixes, String, FALSE, Match);
+    Match = YoriLibGlobTrieMatch(&GlobSet->Suffixes, String, TRUE, Match);
+
+    //
+    //  The automaton is the most expensive test, so skip it if it cannot
+    //  find a lower index than the one already found.
+    //
+
+    if (GlobSet->Wildcards != NULL &&
+        GlobSet->WildcardIndex[0] < Match &&
+        YoriLibRegexMatch(GlobSet->Wildcards, String, &WildcardMatch)) {
+
+        if (GlobSet->WildcardIndex[WildcardMatch] < Match) {
+            Match = GlobSet->WildcardIndex[WildcardMatch];
+        }
+    }
+
+    if (Match == YORILIB_GLOB_NONE) {
+        return FALSE;
+    }
+
+    if (PatternIndex != NULL) {
+        *PatternIndex = Match;
+    }
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
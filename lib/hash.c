@@ -83,42 +83,9 @@ YoriLibFreeEmptyHashTable(
 }
 
 /**
- Hash a yori string into a 16 bit hash value.
-
- @param String The string to generate a hash for.
-
- @return A 16 bit hash value for the string.
- */
-WORD
-YoriLibHashString(
-    __in PYORI_STRING String
-    )
-{
-    DWORD Hash;
-    DWORD Index;
-
-    //
-    //  Simple string xor hash
-    //
-
-    Hash = 0;
-    for (Index = 0; Index < String->LengthInChars; Index++) {
-        Hash = (Hash << 3) ^ YoriLibUpcaseChar(String->StartOfString[Index]) ^ (Hash >> 29);
-    }
-
-    //
-    //  Move some high bits into the low bits since the low bits
-    //  will likely be used as a bucket index.  Note we're moving
-    //  bits 16 here and 3 above (ie., not divisible and won't
-    //  cancel out.)
-    //
-
-    Hash = Hash ^ (Hash >> 16);
-    return (WORD)Hash;
-}
-
-/**
- Insert an object with a string based key into the hash table.
+ Insert an object with a string based key into the hash table.  The key is
+ interned, so its hash is calculated once and shared by every table using
+ the same key, and lookups only compare strings whose hashes match.
 
  @param HashTable The hash table to insert the object into.
 
@@ -129,8 +96,12 @@ YoriLibHashString(
 
  @param HashEntry On successful completion, populated with structures
         describing the entry within the hash table.
+
+ @return TRUE to indicate the entry was inserted, FALSE if it could not be
+         inserted due to allocation failure.
  */
-VOID
+__success(return)
+BOOL
 YoriLibHashInsertByKey(
     __in PYORI_HASH_TABLE HashTable,
     __in PYORI_STRING KeyString,
@@ -138,11 +109,17 @@ YoriLibHashInsertByKey(
     __out PYORI_HASH_ENTRY HashEntry
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    DWORD BucketIndex;
+
+    HashEntry->Key = YoriLibInternString(KeyString);
+    if (HashEntry->Key == NULL) {
+        return FALSE;
+    }
 
-    YoriLibCloneString(&HashEntry->Key, KeyString);
+    BucketIndex = HashEntry->Key->Hash % HashTable->NumberBuckets;
     HashEntry->Context = Context;
     YoriLibInsertList(&HashTable->Buckets[BucketIndex].ListHead, &HashEntry->ListEntry);
+    return TRUE;
 }
 
 /**
@@ -161,15 +138,27 @@ YoriLibHashLookupByKey(
     __in PYORI_STRING KeyString
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    DWORD BucketIndex;
+    DWORD Hash;
     PYORI_LIST_ENTRY ListEntry;
     PYORI_HASH_ENTRY HashEntry;
 
+    //
+    //  Hash the key without interning it.  Each entry in the table holds a
+    //  reference on its interned key, so the keys can be compared without
+    //  acquiring the process wide intern table lock.
+    //
+
+    Hash = YoriLibInternHashString(KeyString);
+    BucketIndex = Hash % HashTable->NumberBuckets;
     HashEntry = NULL;
     ListEntry = YoriLibGetNextListEntry(&HashTable->Buckets[BucketIndex].ListHead, NULL);
     while (ListEntry != NULL) {
         HashEntry = CONTAINING_RECORD(ListEntry, YORI_HASH_ENTRY, ListEntry);
-        if (YoriLibCompareStringInsensitive(KeyString, &HashEntry->Key) == 0) {
+        if (HashEntry->Key->Hash == Hash &&
+            HashEntry->Key->String.LengthInChars == KeyString->LengthInChars &&
+            YoriLibCompareStringInsensitive(&HashEntry->Key->String, KeyString) == 0) {
+
             break;
         }
         HashEntry = NULL;
@@ -191,7 +180,8 @@ YoriLibHashRemoveByEntry(
     )
 {
     YoriLibRemoveListItem(&HashEntry->ListEntry);
-    YoriLibFreeStringContents(&HashEntry->Key);
+    YoriLibDereferenceInternedString(HashEntry->Key);
+    HashEntry->Key = NULL;
 }
 
 /**
@@ -0,0 +1,161 @@
+/**
+ * @file lib/instream.c
+ *
+ * Yori read from streams whose contents are already in memory in this process
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The in process stream which is currently attached to a handle, or NULL if
+ all reads should be performed by the operating system.  The shell sets this
+ while a builtin command is executing whose input is the buffered output of
+ a previous builtin command, so that the data can be copied from the buffer
+ that already contains it rather than travelling through a pipe.
+ */
+PYORI_LIB_INPROC_STREAM YoriLibActiveInProcStream;
+
+/**
+ Attach an in process stream to its handle, so that reads from that handle
+ via @ref YoriLibReadStream are satisfied from memory.
+
+ @param Stream Pointer to the stream to attach, or NULL to indicate that no
+        stream should be attached.  The stream must remain valid until it
+        is detached by a later call to this function.
+
+ @return Pointer to the previously attached stream, which the caller should
+         restore when the new stream is no longer in use.
+ */
+PYORI_LIB_INPROC_STREAM
+YoriLibSetInProcStream(
+    __in_opt PYORI_LIB_INPROC_STREAM Stream
+    )
+{
+    PYORI_LIB_INPROC_STREAM PreviousStream;
+
+    PreviousStream = YoriLibActiveInProcStream;
+    YoriLibActiveInProcStream = Stream;
+    return PreviousStream;
+}
+
+/**
+ Return the in process stream attached to a handle.
+
+ @param FileHandle The handle to check.
+
+ @return Pointer to the in process stream, or NULL if reads from this handle
+         should be performed by the operating system.
+ */
+PYORI_LIB_INPROC_STREAM
+YoriLibGetInProcStream(
+    __in HANDLE FileHandle
+    )
+{
+    if (YoriLibActiveInProcStream != NULL &&
+        YoriLibActiveInProcStream->Handle == FileHandle) {
+
+        return YoriLibActiveInProcStream;
+    }
+    return NULL;
+}
+
+/**
+ Read from a stream.  This behaves like ReadFile, except that if the handle
+ has an in process stream attached, data is copied from the memory of this
+ process rather than requested from the operating system.  When the end of
+ an in process stream is reached, this function fails with
+ ERROR_BROKEN_PIPE, as would occur when reading from a pipe.
+
+ @param FileHandle The handle to read from.
+
+ @param Buffer Pointer to a buffer to receive data.
+
+ @param BytesToRead The size of Buffer, in bytes.
+
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes placed in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibReadStream(
+    __in HANDLE FileHandle,
+    __out_bcount(BytesToRead) PVOID Buffer,
+    __in DWORD BytesToRead,
+    __out PDWORD BytesRead
+    )
+{
+    PYORI_LIB_INPROC_STREAM Stream;
+    DWORD BytesRemaining;
+
+    Stream = YoriLibGetInProcStream(FileHandle);
+    if (Stream == NULL) {
+        return ReadFile(FileHandle, Buffer, BytesToRead, BytesRead, NULL);
+    }
+
+    //
+    //  On the first read, ask the producer to stop writing into the pipe.
+    //  Anything it has already written is read from the pipe first, and
+    //  when the pipe has been drained, the remainder is copied from memory.
+    //
+
+    if (!Stream->Claimed) {
+        Stream->Claimed = TRUE;
+        Stream->ClaimFn(Stream->Context);
+    }
+
+    if (Stream->Buffer == NULL) {
+        if (ReadFile(FileHandle, Buffer, BytesToRead, BytesRead, NULL) &&
+            *BytesRead > 0) {
+
+            return TRUE;
+        }
+
+        if (!Stream->GetBufferFn(Stream->Context, &Stream->Buffer, &Stream->BytesConsumed, &Stream->BytesTotal)) {
+            *BytesRead = 0;
+            SetLastError(ERROR_BROKEN_PIPE);
+            return FALSE;
+        }
+    }
+
+    ASSERT(Stream->BytesConsumed <= Stream->BytesTotal);
+    BytesRemaining = Stream->BytesTotal - Stream->BytesConsumed;
+    if (BytesRemaining == 0) {
+        *BytesRead = 0;
+        SetLastError(ERROR_BROKEN_PIPE);
+        return FALSE;
+    }
+
+    if (BytesToRead > BytesRemaining) {
+        BytesToRead = BytesRemaining;
+    }
+
+    memcpy(Buffer, Stream->Buffer + Stream->BytesConsumed, BytesToRead);
+    Stream->BytesConsumed += BytesToRead;
+    *BytesRead = BytesToRead;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,352 @@
+/**
+ * @file lib/intern.c
+ *
+ * Yori case insensitive string interning routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of buckets to allocate when the intern table is first used.
+ */
+#define YORILIB_INTERN_INITIAL_BUCKETS (64)
+
+/**
+ The process wide table of interned strings.  Each distinct string, compared
+ case insensitively, has exactly one entry in this table, so two interned
+ strings are equal if and only if they are the same pointer.
+ */
+typedef struct _YORILIB_INTERN_TABLE {
+
+    /**
+     An array of list heads, one per bucket.  Each entry is linked into the
+     bucket indicated by its hash.
+     */
+    PYORI_LIST_ENTRY Buckets;
+
+    /**
+     The number of elements in the Buckets array.  This is always a power
+     of two.
+     */
+    DWORD NumberBuckets;
+
+    /**
+     The number of strings currently interned.
+     */
+    DWORD NumberEntries;
+
+    /**
+     Indicates whether Lock has been initialized.  This is zero if it has
+     not, one while a thread is initializing it, and two once it is ready
+     for use.
+     */
+    volatile LONG LockState;
+
+    /**
+     A lock serializing access to the table.  Interned strings are shared
+     by every table in the process, which may be used by different threads,
+     so the intern table must be synchronized even when each hash table
+     built on it is only used by one thread.
+     */
+    CRITICAL_SECTION Lock;
+} YORILIB_INTERN_TABLE;
+
+/**
+ The intern table for this process.
+ */
+YORILIB_INTERN_TABLE YoriLibInternTable;
+
+/**
+ Acquire the lock protecting the intern table, initializing it on first
+ use.  The lock is never deleted, since interned strings may be released
+ at any point up to process exit.
+ */
+VOID
+YoriLibInternAcquireLock()
+{
+    if (YoriLibInternTable.LockState != 2) {
+        if (InterlockedCompareExchange(&YoriLibInternTable.LockState, 1, 0) == 0) {
+            InitializeCriticalSection(&YoriLibInternTable.Lock);
+            InterlockedExchange(&YoriLibInternTable.LockState, 2);
+        } else {
+            while (YoriLibInternTable.LockState != 2) {
+                Sleep(0);
+            }
+        }
+    }
+
+    EnterCriticalSection(&YoriLibInternTable.Lock);
+}
+
+/**
+ Release the lock protecting the intern table.
+ */
+VOID
+YoriLibInternReleaseLock()
+{
+    LeaveCriticalSection(&YoriLibInternTable.Lock);
+}
+
+/**
+ Hash a yori string case insensitively into a 32 bit hash value.
+
+ @param String The string to generate a hash for.
+
+ @return A 32 bit hash value for the string.
+ */
+DWORD
+YoriLibInternHashString(
+    __in PYORI_STRING String
+    )
+{
+    DWORD Hash;
+    DWORD Index;
+
+    //
+    //  Simple string xor hash
+    //
+
+    Hash = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Hash = (Hash << 3) ^ YoriLibUpcaseChar(String->StartOfString[Index]) ^ (Hash >> 29);
+    }
+
+    //
+    //  Move some high bits into the low bits since the low bits
+    //  will likely be used as a bucket index.  Note we're moving
+    //  bits 16 here and 3 above (ie., not divisible and won't
+    //  cancel out.)
+    //
+
+    Hash = Hash ^ (Hash >> 16);
+    return Hash;
+}
+
+/**
+ Reallocate the bucket array of the intern table to have the specified number
+ of buckets, moving every interned string into its new bucket.  Since each
+ entry records its hash, no strings are hashed again.
+
+ @param NumberBuckets The new number of buckets, which must be a power of two.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibInternResizeTable(
+    __in DWORD NumberBuckets
+    )
+{
+    PYORI_LIST_ENTRY NewBuckets;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_INTERNED_STRING Entry;
+    DWORD Index;
+
+    NewBuckets = YoriLibMalloc(NumberBuckets * sizeof(YORI_LIST_ENTRY));
+    if (NewBuckets == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < NumberBuckets; Index++) {
+        YoriLibInitializeListHead(&NewBuckets[Index]);
+    }
+
+    for (Index = 0; Index < YoriLibInternTable.NumberBuckets; Index++) {
+        ListEntry = YoriLibGetNextListEntry(&YoriLibInternTable.Buckets[Index], NULL);
+        while (ListEntry != NULL) {
+            Entry = CONTAINING_RECORD(ListEntry, YORI_INTERNED_STRING, ListEntry);
+            YoriLibRemoveListItem(ListEntry);
+            YoriLibInsertList(&NewBuckets[Entry->Hash & (NumberBuckets - 1)], ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&YoriLibInternTable.Buckets[Index], NULL);
+        }
+    }
+
+    if (YoriLibInternTable.Buckets != NULL) {
+        YoriLibFree(YoriLibInternTable.Buckets);
+    }
+    YoriLibInternTable.Buckets = NewBuckets;
+    YoriLibInternTable.NumberBuckets = NumberBuckets;
+    return TRUE;
+}
+
+/**
+ Search the intern table for an entry matching a string.  The caller must
+ hold the intern table lock.
+
+ @param String Pointer to the string to find.
+
+ @param Hash The hash of the string, as returned from
+        @ref YoriLibInternHashString .
+
+ @return Pointer to the matching entry, or NULL if the string has not been
+         interned.
+ */
+PYORI_INTERNED_STRING
+YoriLibInternLookup(
+    __in PYORI_STRING String,
+    __in DWORD Hash
+    )
+{
+    PYORI_LIST_ENTRY Bucket;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_INTERNED_STRING Entry;
+
+    if (YoriLibInternTable.Buckets == NULL) {
+        return NULL;
+    }
+
+    Bucket = &YoriLibInternTable.Buckets[Hash & (YoriLibInternTable.NumberBuckets - 1)];
+    ListEntry = YoriLibGetNextListEntry(Bucket, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_INTERNED_STRING, ListEntry);
+        if (Entry->Hash == Hash &&
+            Entry->String.LengthInChars == String->LengthInChars &&
+            YoriLibCompareStringInsensitive(&Entry->String, String) == 0) {
+
+            return Entry;
+        }
+        ListEntry = YoriLibGetNextListEntry(Bucket, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Return a canonical handle for a string, compared case insensitively.  All
+ strings that differ only in case return the same handle, so equality can be
+ tested by comparing pointers.  The string is upcased and hashed once, when
+ it is first interned.
+
+ @param String Pointer to the string to intern.
+
+ @return Pointer to a referenced interned string, or NULL on allocation
+         failure.  The caller should call
+         @ref YoriLibDereferenceInternedString when it is no longer needed.
+ */
+PYORI_INTERNED_STRING
+YoriLibInternString(
+    __in PYORI_STRING String
+    )
+{
+    PYORI_INTERNED_STRING Entry;
+    DWORD Hash;
+    DWORD Index;
+
+    Hash = YoriLibInternHashString(String);
+    YoriLibInternAcquireLock();
+    Entry = YoriLibInternLookup(String, Hash);
+    if (Entry != NULL) {
+        Entry->ReferenceCount++;
+        YoriLibInternReleaseLock();
+        return Entry;
+    }
+
+    if (YoriLibInternTable.Buckets == NULL) {
+        if (!YoriLibInternResizeTable(YORILIB_INTERN_INITIAL_BUCKETS)) {
+            YoriLibInternReleaseLock();
+            return NULL;
+        }
+    } else if (YoriLibInternTable.NumberEntries >= YoriLibInternTable.NumberBuckets * 2) {
+
+        //
+        //  If growing fails, the table still works, it's just slower.
+        //
+
+        YoriLibInternResizeTable(YoriLibInternTable.NumberBuckets * 4);
+    }
+
+    Entry = YoriLibMalloc(sizeof(YORI_INTERNED_STRING) + (String->LengthInChars + 1) * sizeof(TCHAR));
+    if (Entry == NULL) {
+        YoriLibInternReleaseLock();
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Entry->String);
+    Entry->String.StartOfString = (LPTSTR)(Entry + 1);
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Entry->String.StartOfString[Index] = YoriLibUpcaseChar(String->StartOfString[Index]);
+    }
+    Entry->String.StartOfString[Index] = '\0';
+    Entry->String.LengthInChars = String->LengthInChars;
+    Entry->String.LengthAllocated = String->LengthInChars + 1;
+    Entry->Hash = Hash;
+    Entry->ReferenceCount = 1;
+
+    YoriLibInsertList(&YoriLibInternTable.Buckets[Hash & (YoriLibInternTable.NumberBuckets - 1)], &Entry->ListEntry);
+    YoriLibInternTable.NumberEntries++;
+    YoriLibInternReleaseLock();
+
+    return Entry;
+}
+
+/**
+ Add a reference to a previously interned string.
+
+ @param Interned Pointer to the interned string.
+ */
+VOID
+YoriLibReferenceInternedString(
+    __in PYORI_INTERNED_STRING Interned
+    )
+{
+    YoriLibInternAcquireLock();
+    ASSERT(Interned->ReferenceCount > 0);
+    Interned->ReferenceCount++;
+    YoriLibInternReleaseLock();
+}
+
+/**
+ Release a reference to an interned string.  When the last reference is
+ released the string is removed from the intern table, and when the table
+ becomes empty its buckets are freed.
+
+ @param Interned Pointer to the interned string.
+ */
+VOID
+YoriLibDereferenceInternedString(
+    __in PYORI_INTERNED_STRING Interned
+    )
+{
+    YoriLibInternAcquireLock();
+    ASSERT(Interned->ReferenceCount > 0);
+    Interned->ReferenceCount--;
+    if (Interned->ReferenceCount > 0) {
+        YoriLibInternReleaseLock();
+        return;
+    }
+
+    YoriLibRemoveListItem(&Interned->ListEntry);
+    YoriLibFree(Interned);
+
+    ASSERT(YoriLibInternTable.NumberEntries > 0);
+    YoriLibInternTable.NumberEntries--;
+    if (YoriLibInternTable.NumberEntries == 0) {
+        YoriLibFree(YoriLibInternTable.Buckets);
+        YoriLibInternTable.Buckets = NULL;
+        YoriLibInternTable.NumberBuckets = 0;
+    }
+    YoriLibInternReleaseLock();
+}
+
+// vim:sw=4:ts=4:et:
@@ -148,23 +148,23 @@ YoriLibBytesInBom(
     DWORD Encoding = YoriLibGetMultibyteInputEncoding();
     if (BytesInString >= 3 && Encoding == CP_UTF8) {
 
-        if (StringToCheck[0] == 0xEF &&
-            StringToCheck[1] == 0xBB &&
-            StringToCheck[2] == 0xBF) {
+        if ((UCHAR)StringToCheck[0] == 0xEF &&
+            (UCHAR)StringToCheck[1] == 0xBB &&
+            (UCHAR)StringToCheck[2] == 0xBF) {
 
             return 3;
         }
     }
 
     if (BytesInString >= 2 && Encoding == CP_UTF16) {
-        if (StringToCheck[0] == 0xFF &&
-            StringToCheck[1] == 0xFE) {
+        if ((UCHAR)StringToCheck[0] == 0xFF &&
+            (UCHAR)StringToCheck[1] == 0xFE) {
 
             return 2;
         }
 
-        if (StringToCheck[0] == 0xFE &&
-            StringToCheck[1] == 0xFF) {
+        if ((UCHAR)StringToCheck[0] == 0xFE &&
+            (UCHAR)StringToCheck[1] == 0xFF) {
 
             return 2;
         }
@@ -235,9 +235,22 @@ YoriLibReadLineToStringEx(
     DWORD DelayTime;
     DWORD CharsRemaining;
     DWORD CumulativeDelay;
+    PYORI_LIB_INPROC_STREAM InProcStream;
 
     *TimeoutReached = FALSE;
-    FileType = GetFileType(FileHandle);
+
+    //
+    //  If the data is already in memory, it behaves like a pipe that is
+    //  never empty until it ends, so there's no need to ask the system
+    //  what it is or wait for it.
+    //
+
+    InProcStream = YoriLibGetInProcStream(FileHandle);
+    if (InProcStream != NULL) {
+        FileType = FILE_TYPE_PIPE;
+    } else {
+        FileType = GetFileType(FileHandle);
+    }
 
     //
     //  If we don't have a line read context yet, allocate one.
@@ -446,7 +459,10 @@ YoriLibReadLineToStringEx(
         CumulativeDelay = 0;
         DelayTime = 1;
         TerminateProcessing = FALSE;
-        while(TRUE) {
+        if (InProcStream != NULL && YoriLibIsOperationCancelled()) {
+            TerminateProcessing = TRUE;
+        }
+        while(InProcStream == NULL) {
             DWORD BytesAvailable;
 
             if (YoriLibCancelGetEvent() != NULL) {
@@ -508,7 +524,7 @@ YoriLibReadLineToStringEx(
 
         BytesRead = 0;
         if (!TerminateProcessing) {
-            if (!ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer, &BytesRead, NULL)) {
+            if (!YoriLibReadStream(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer, &BytesRead)) {
 #if DBG
                 DWORD LastError = GetLastError();
 
@@ -622,4 +638,332 @@ YoriLibLineReadClose(
     }
 }
 
+/**
+ The size of the buffer used when counting the contents of a stream.
+ */
+#define YORILIB_COUNT_BUFFER_SIZE (256 * 1024)
+
+/**
+ A pointer sized value with every byte set to 0x01.  Multiplying a byte
+ value by this replicates it into every byte of a pointer sized value.
+ */
+#define YORILIB_COUNT_ONES ((ULONG_PTR)-1 / 0xFF)
+
+/**
+ A pointer sized value with the high bit of every byte set.
+ */
+#define YORILIB_COUNT_HIGHS (YORILIB_COUNT_ONES * 0x80)
+
+/**
+ Returns nonzero if any byte within a pointer sized value is less than N,
+ where N is no greater than 128.
+ */
+#define YORILIB_COUNT_HAS_LESS(x, n) \
+    (((x) - YORILIB_COUNT_ONES * (n)) & ~(x) & YORILIB_COUNT_HIGHS)
+
+/**
+ Returns nonzero if any byte within a pointer sized value equals N.
+ */
+#define YORILIB_COUNT_HAS_BYTE(x, n) \
+    YORILIB_COUNT_HAS_LESS((x) ^ (YORILIB_COUNT_ONES * (n)), 1)
+
+/**
+ Returns TRUE if a character is considered to separate words.
+
+ @param Char The character to check.
+
+ @return TRUE if the character separates words, FALSE if it is part of a
+         word.
+ */
+BOOL
+YoriLibCountIsWordSeperator(
+    __in WCHAR Char
+    )
+{
+    if (Char == ' ' || (Char >= '\t' && Char <= '\r')) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Count the lines, and optionally words and characters, in a stream without
+ converting the stream to strings.  Lines are terminated by CR, LF or CRLF
+ as in @ref YoriLibReadLineToStringEx , and any trailing data without a
+ line terminator is counted as a line.  The stream is interpreted according
+ to the current input encoding.  For UTF-8 input, characters are counted as
+ code points; for UTF-16, as UTF-16 code units other than trailing
+ surrogates; for other encodings, each byte is counted as a character.  A
+ byte order mark is included in the byte count but not the character or
+ word count.
+
+ Since most buffers contain relatively few line terminators, narrow input is
+ scanned one pointer sized word at a time, and a word is only examined byte
+ by byte if it contains a character of interest.
+
+ @param FileHandle Handle to the stream to count.
+
+ @param CountWordsAndChars If TRUE, words and characters are counted in
+        addition to lines and bytes.  If FALSE, the Words and Chars fields
+        of Counts are zero.
+
+ @param Counts On successful completion, populated with the counts of the
+        stream contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the error from the failing read is available from GetLastError.
+ */
+__success(return)
+BOOL
+YoriLibCountStreamContents(
+    __in HANDLE FileHandle,
+    __in BOOL CountWordsAndChars,
+    __out PYORILIB_STREAM_COUNTS Counts
+    )
+{
+    PUCHAR Buffer;
+    PULONG_PTR Words;
+    PWCHAR WideBuffer;
+    DWORD BytesRead;
+    DWORD BytesInBuffer;
+    DWORD Carry;
+    DWORD Index;
+    DWORD WordIndex;
+    DWORD WordCount;
+    DWORD CharCount;
+    DWORD BomBytes;
+    ULONG_PTR Word;
+    ULONG_PTR Continuations;
+    BOOLEAN ReadWChars;
+    BOOLEAN FirstBuffer;
+    BOOLEAN PreviousWasCr;
+    BOOLEAN InWord;
+    BOOLEAN PartialLine;
+    UCHAR Char;
+    WCHAR WideChar;
+    DWORD Encoding;
+    DWORD Error;
+
+    ZeroMemory(Counts, sizeof(YORILIB_STREAM_COUNTS));
+
+    Buffer = YoriLibMalloc(YORILIB_COUNT_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    Encoding = YoriLibGetMultibyteInputEncoding();
+    ReadWChars = FALSE;
+    if (Encoding == CP_UTF16) {
+        ReadWChars = TRUE;
+    }
+
+    FirstBuffer = TRUE;
+    PreviousWasCr = FALSE;
+    InWord = FALSE;
+    PartialLine = FALSE;
+    Carry = 0;
+
+    while (TRUE) {
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        //
+        //  A broken pipe indicates the writer has finished, which is the
+        //  end of the stream.  Any other failure is returned to the caller.
+        //
+
+        if (!YoriLibReadStream(FileHandle, &Buffer[Carry], YORILIB_COUNT_BUFFER_SIZE - Carry, &BytesRead)) {
+            Error = GetLastError();
+            if (Error == ERROR_BROKEN_PIPE || Error == ERROR_HANDLE_EOF) {
+                break;
+            }
+            YoriLibFree(Buffer);
+            SetLastError(Error);
+            return FALSE;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        Counts->Bytes += BytesRead;
+        BytesInBuffer = BytesRead + Carry;
+        Carry = 0;
+        Index = 0;
+
+        //
+        //  Skip any byte order mark at the start of the stream.  Since the
+        //  stream is not broken into lines, the mark is part of the first
+        //  line.
+        //
+
+        if (FirstBuffer) {
+            FirstBuffer = FALSE;
+            BomBytes = YoriLibBytesInBom((PCHAR)Buffer, BytesInBuffer);
+            if (BomBytes > 0) {
+                PartialLine = TRUE;
+                Index = BomBytes;
+            }
+        }
+
+        if (ReadWChars) {
+
+            //
+            //  Process whole characters, and carry an odd trailing byte into
+            //  the next read.
+            //
+
+            WideBuffer = (PWCHAR)Buffer;
+            CharCount = BytesInBuffer / sizeof(WCHAR);
+            for (Index = Index / sizeof(WCHAR); Index < CharCount; Index++) {
+                WideChar = WideBuffer[Index];
+                if (WideChar == '\n') {
+                    if (!PreviousWasCr) {
+                        Counts->Lines++;
+                    }
+                    PreviousWasCr = FALSE;
+                    PartialLine = FALSE;
+                } else if (WideChar == '\r') {
+                    Counts->Lines++;
+                    PreviousWasCr = TRUE;
+                    PartialLine = FALSE;
+                } else {
+                    PreviousWasCr = FALSE;
+                    PartialLine = TRUE;
+                }
+
+                if (CountWordsAndChars) {
+                    if (WideChar < 0xDC00 || WideChar > 0xDFFF) {
+                        Counts->Chars++;
+                    }
+                    if (YoriLibCountIsWordSeperator(WideChar)) {
+                        InWord = FALSE;
+                    } else if (!InWord) {
+                        InWord = TRUE;
+                        Counts->Words++;
+                    }
+                }
+            }
+
+            if (BytesInBuffer % sizeof(WCHAR) != 0) {
+                Buffer[0] = Buffer[BytesInBuffer - 1];
+                Carry = 1;
+            }
+            continue;
+        }
+
+        //
+        //  Narrow input.  Process bytes individually until the start of a
+        //  word, then whole words, then any trailing bytes.  The buffer
+        //  allocation is aligned to at least the size of a word.
+        //
+
+        WordIndex = (Index + sizeof(ULONG_PTR) - 1) / sizeof(ULONG_PTR);
+        WordCount = BytesInBuffer / sizeof(ULONG_PTR);
+        if (WordIndex >= WordCount) {
+            WordIndex = WordCount;
+        }
+        Words = (PULONG_PTR)Buffer;
+
+        while (TRUE) {
+
+            //
+            //  Process individual bytes up to the next whole word, or to
+            //  the end of the buffer.
+            //
+
+            if (WordIndex < WordCount) {
+                CharCount = WordIndex * sizeof(ULONG_PTR);
+            } else {
+                CharCount = BytesInBuffer;
+            }
+
+            for (; Index < CharCount; Index++) {
+                Char = Buffer[Index];
+                if (Char == '\n') {
+                    if (!PreviousWasCr) {
+                        Counts->Lines++;
+                    }
+                    PreviousWasCr = FALSE;
+                    PartialLine = FALSE;
+                } else if (Char == '\r') {
+                    Counts->Lines++;
+                    PreviousWasCr = TRUE;
+                    PartialLine = FALSE;
+                } else {
+                    PreviousWasCr = FALSE;
+                    PartialLine = TRUE;
+                }
+
+                if (CountWordsAndChars) {
+                    if (Encoding != CP_UTF8 || (Char & 0xC0) != 0x80) {
+                        Counts->Chars++;
+                    }
+                    if (YoriLibCountIsWordSeperator(Char)) {
+                        InWord = FALSE;
+                    } else if (!InWord) {
+                        InWord = TRUE;
+                        Counts->Words++;
+                    }
+                }
+            }
+
+            if (WordIndex >= WordCount) {
+                break;
+            }
+
+            //
+            //  Skip whole words that contain nothing of interest.  If
+            //  counting words, a word of interest is one containing any
+            //  whitespace or control character; otherwise it is one
+            //  containing a CR or LF.
+            //
+
+            for (; WordIndex < WordCount; WordIndex++) {
+                Word = Words[WordIndex];
+                if (CountWordsAndChars) {
+                    if (YORILIB_COUNT_HAS_LESS(Word, ' ' + 1)) {
+                        break;
+                    }
+                    if (!InWord) {
+                        InWord = TRUE;
+                        Counts->Words++;
+                    }
+                    if (Encoding == CP_UTF8) {
+                        Continuations = Word & ~(Word << 1) & YORILIB_COUNT_HIGHS;
+                        Continuations = ((Continuations >> 7) * YORILIB_COUNT_ONES) >> ((sizeof(ULONG_PTR) - 1) * 8);
+                        Counts->Chars += sizeof(ULONG_PTR) - Continuations;
+                    } else {
+                        Counts->Chars += sizeof(ULONG_PTR);
+                    }
+                } else if (YORILIB_COUNT_HAS_BYTE(Word, '\n') ||
+                           YORILIB_COUNT_HAS_BYTE(Word, '\r')) {
+                    break;
+                }
+                PreviousWasCr = FALSE;
+                PartialLine = TRUE;
+            }
+
+            //
+            //  Process the word that contained something of interest one
+            //  byte at a time, by including it in the next byte range.
+            //
+
+            Index = WordIndex * sizeof(ULONG_PTR);
+            if (WordIndex < WordCount) {
+                WordIndex++;
+            }
+        }
+    }
+
+    if (PartialLine) {
+        Counts->Lines++;
+    }
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
@@ -353,6 +353,34 @@ YoriLibDisplayMemoryUsage()
 #endif
 }
 
+/**
+ Return the number of allocations performed by this process so far.  This
+ value only ever increases, so callers can measure the number of allocations
+ performed by an operation by comparing the value before and after it.
+ Allocations are only counted by the special heap used in debug builds, so
+ that release builds do not pay for a counter on every allocation.
+
+ @param AllocationCount On successful completion, populated with the number
+        of allocations performed by this process.
+
+ @return TRUE to indicate the allocation count is available, FALSE if this
+         build does not count allocations.
+ */
+__success(return)
+BOOL
+YoriLibGetAllocationCount(
+    __out PDWORD AllocationCount
+    )
+{
+#if YORI_SPECIAL_HEAP
+    *AllocationCount = YoriLibSpecialHeap.NumberAllocated;
+    return TRUE;
+#else
+    UNREFERENCED_PARAMETER(AllocationCount);
+    return FALSE;
+#endif
+}
+
 
 /**
  A structure that preceeds a reference counted malloc allocation.
@@ -442,7 +470,7 @@ YoriLibReference(
     PYORILIB_REFERENCED_MALLOC_HEADER Header;
 
     Header = (PYORILIB_REFERENCED_MALLOC_HEADER)Allocation - 1;
-    Header->ReferenceCount++;
+    InterlockedIncrement((LONG *)&Header->ReferenceCount);
 }
 
 /**
@@ -459,11 +487,167 @@ YoriLibDereference(
     PYORILIB_REFERENCED_MALLOC_HEADER Header;
 
     Header = (PYORILIB_REFERENCED_MALLOC_HEADER)Allocation - 1;
-    Header->ReferenceCount--;
-    if (Header->ReferenceCount == 0) {
+    if (InterlockedDecrement((LONG *)&Header->ReferenceCount) == 0) {
         YoriLibFree(Header);
     }
 }
 
+/**
+ Initialize an arena allocator.  An arena hands out many small allocations
+ from a small number of larger reference counted regions, so that a set of
+ objects with a common lifetime can be created with one or two heap
+ operations.  Each allocation from the arena references the region it was
+ carved from, so a region is returned to the heap when the arena and all
+ objects allocated from it have dereferenced it.
+
+ @param Arena Pointer to the arena to initialize.  This is typically on the
+        stack.
+
+ @param RegionSize The number of bytes to allocate in each region.
+ */
+VOID
+YoriLibArenaInitialize(
+    __out PYORILIB_ARENA Arena,
+    __in DWORD RegionSize
+    )
+{
+    Arena->CurrentRegion = NULL;
+    Arena->RegionSize = RegionSize;
+    Arena->BytesUsed = 0;
+}
+
+/**
+ Release the arena's reference on its current region.  Any allocations
+ previously returned from the arena remain valid until they are
+ dereferenced.
+
+ @param Arena Pointer to the arena to clean up.
+ */
+VOID
+YoriLibArenaCleanup(
+    __inout PYORILIB_ARENA Arena
+    )
+{
+    if (Arena->CurrentRegion != NULL) {
+        YoriLibDereference(Arena->CurrentRegion);
+        Arena->CurrentRegion = NULL;
+    }
+    Arena->BytesUsed = 0;
+}
+
+#if !YORI_SPECIAL_HEAP
+/**
+ Allocate memory from an arena.  The memory is part of a reference counted
+ region, which is referenced on behalf of the caller and returned in Region.
+ The caller should call @ref YoriLibDereference on Region when the memory
+ is no longer needed; the memory itself is never freed individually.  This
+ makes Region suitable for use as the MemoryToFree member of a
+ @ref YORI_STRING .
+
+ @param Arena Pointer to the arena to allocate from.
+
+ @param Bytes The number of bytes to allocate.
+
+ @param Region On successful completion, updated to point to the referenced
+        region containing the allocation.
+
+ @return Pointer to the allocated memory, or NULL on failure.
+ */
+PVOID
+YoriLibArenaReferencedMalloc(
+    __inout PYORILIB_ARENA Arena,
+    __in DWORD Bytes,
+    __out PVOID *Region
+    )
+#else
+/**
+ Allocate memory from an arena.  The memory is part of a reference counted
+ region, which is referenced on behalf of the caller and returned in Region.
+ The caller should call @ref YoriLibDereference on Region when the memory
+ is no longer needed; the memory itself is never freed individually.  This
+ makes Region suitable for use as the MemoryToFree member of a
+ @ref YORI_STRING .  Regions are allocated from the special heap, and are
+ attributed to the allocation that caused the region to be created.
+
+ @param Arena Pointer to the arena to allocate from.
+
+ @param Bytes The number of bytes to allocate.
+
+ @param Region On successful completion, updated to point to the referenced
+        region containing the allocation.
+
+ @param Function Pointer to a constant string indicating the function that is
+        allocating the memory.
+
+ @param File Pointer to a constant string indicating the source file that is
+        allocating the memory.
+
+ @param Line Specifies the line number within the source file that is
+        allocating the memory.
+
+ @return Pointer to the allocated memory, or NULL on failure.
+ */
+PVOID
+YoriLibArenaReferencedMallocSpecialHeap(
+    __inout PYORILIB_ARENA Arena,
+    __in DWORD Bytes,
+    __out PVOID *Region,
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    )
+#endif
+{
+    PVOID NewRegion;
+    PVOID Alloc;
+
+    //
+    //  Keep every allocation aligned for any type that may be placed in it.
+    //
+
+    Bytes = (Bytes + sizeof(LONGLONG) - 1) & ~(sizeof(LONGLONG) - 1);
+
+    //
+    //  If the request is large compared to a region, give it a region of
+    //  its own and leave the current region in place for later small
+    //  requests.
+    //
+
+    if (Bytes > Arena->RegionSize / 2) {
+#if !YORI_SPECIAL_HEAP
+        NewRegion = YoriLibReferencedMalloc(Bytes);
+#else
+        NewRegion = YoriLibReferencedMallocSpecialHeap(Bytes, Function, File, Line);
+#endif
+        *Region = NewRegion;
+        return NewRegion;
+    }
+
+    if (Arena->CurrentRegion == NULL ||
+        Arena->BytesUsed + Bytes > Arena->RegionSize) {
+
+#if !YORI_SPECIAL_HEAP
+        NewRegion = YoriLibReferencedMalloc(Arena->RegionSize);
+#else
+        NewRegion = YoriLibReferencedMallocSpecialHeap(Arena->RegionSize, Function, File, Line);
+#endif
+        if (NewRegion == NULL) {
+            return NULL;
+        }
+
+        if (Arena->CurrentRegion != NULL) {
+            YoriLibDereference(Arena->CurrentRegion);
+        }
+        Arena->CurrentRegion = NewRegion;
+        Arena->BytesUsed = 0;
+    }
+
+    Alloc = YoriLibAddToPointer(Arena->CurrentRegion, Arena->BytesUsed);
+    Arena->BytesUsed += Bytes;
+    YoriLibReference(Arena->CurrentRegion);
+    *Region = Arena->CurrentRegion;
+    return Alloc;
+}
+
 
 // vim:sw=4:ts=4:et:
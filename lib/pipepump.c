@@ -0,0 +1,384 @@
+/**
+ * @file lib/pipepump.c
+ *
+ * Yori copy data from one stream to one or more streams using a ring of
+ * buffers so that reads and writes overlap
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of buffers in the ring.  The reader can be this many buffers
+ ahead of the slowest writer.
+ */
+#define YORILIB_PIPE_PUMP_BUFFER_COUNT (4)
+
+/**
+ The size of each buffer in the ring, in bytes.
+ */
+#define YORILIB_PIPE_PUMP_BUFFER_SIZE (64 * 1024)
+
+/**
+ A single buffer within the ring.
+ */
+typedef struct _YORILIB_PIPE_PUMP_BUFFER {
+
+    /**
+     Pointer to the data for this buffer.
+     */
+    PUCHAR Data;
+
+    /**
+     The number of bytes of valid data in this buffer.  A value of zero
+     indicates the end of the stream.
+     */
+    DWORD BytesValid;
+
+    /**
+     The number of writers which have not yet finished with this buffer.
+     When this reaches zero, the buffer is returned to the reader.
+     */
+    LONG WritersRemaining;
+} YORILIB_PIPE_PUMP_BUFFER, *PYORILIB_PIPE_PUMP_BUFFER;
+
+struct _YORILIB_PIPE_PUMP;
+
+/**
+ State for a single writer thread.
+ */
+typedef struct _YORILIB_PIPE_PUMP_WRITER {
+
+    /**
+     Pointer back to the pump that this writer is part of.
+     */
+    struct _YORILIB_PIPE_PUMP *Pump;
+
+    /**
+     The handle to write data to.
+     */
+    HANDLE hTarget;
+
+    /**
+     A semaphore which is released once for each buffer the reader has
+     filled and this writer should consume.
+     */
+    HANDLE DataAvailable;
+
+    /**
+     A handle to the thread performing writes.
+     */
+    HANDLE hThread;
+
+    /**
+     The number of buffers this writer has consumed.  The next buffer to
+     write is found from this value modulo the number of buffers.
+     */
+    DWORD BuffersConsumed;
+
+    /**
+     The first error encountered when writing, or ERROR_SUCCESS.  Once an
+     error is encountered this writer stops writing but continues to
+     consume buffers so the reader is not blocked.
+     */
+    DWORD Error;
+} YORILIB_PIPE_PUMP_WRITER, *PYORILIB_PIPE_PUMP_WRITER;
+
+/**
+ State for an entire pump operation.
+ */
+typedef struct _YORILIB_PIPE_PUMP {
+
+    /**
+     A semaphore indicating the number of buffers which are not in use by
+     any writer and can be filled by the reader.
+     */
+    HANDLE FreeBuffers;
+
+    /**
+     The number of writers.
+     */
+    DWORD WriterCount;
+
+    /**
+     An array of writers.
+     */
+    PYORILIB_PIPE_PUMP_WRITER Writers;
+
+    /**
+     The ring of buffers.
+     */
+    YORILIB_PIPE_PUMP_BUFFER Buffers[YORILIB_PIPE_PUMP_BUFFER_COUNT];
+} YORILIB_PIPE_PUMP, *PYORILIB_PIPE_PUMP;
+
+/**
+ A thread which writes each buffer filled by the reader to a single target.
+
+ @param Context Pointer to the writer state.
+
+ @return Zero on success, or a Win32 error code on failure.
+ */
+DWORD WINAPI
+YoriLibPipePumpWriter(
+    __in LPVOID Context
+    )
+{
+    PYORILIB_PIPE_PUMP_WRITER Writer = (PYORILIB_PIPE_PUMP_WRITER)Context;
+    PYORILIB_PIPE_PUMP Pump = Writer->Pump;
+    PYORILIB_PIPE_PUMP_BUFFER Buffer;
+    DWORD BytesWritten;
+    DWORD CurrentOffset;
+    DWORD BytesValid;
+
+    while (TRUE) {
+        WaitForSingleObject(Writer->DataAvailable, INFINITE);
+
+        Buffer = &Pump->Buffers[Writer->BuffersConsumed % YORILIB_PIPE_PUMP_BUFFER_COUNT];
+        Writer->BuffersConsumed++;
+        BytesValid = Buffer->BytesValid;
+
+        CurrentOffset = 0;
+        while (Writer->Error == ERROR_SUCCESS && CurrentOffset < BytesValid) {
+            if (!WriteFile(Writer->hTarget, Buffer->Data + CurrentOffset, BytesValid - CurrentOffset, &BytesWritten, NULL)) {
+                Writer->Error = GetLastError();
+                break;
+            }
+            if (BytesWritten == 0) {
+                Writer->Error = ERROR_WRITE_FAULT;
+                break;
+            }
+            CurrentOffset += BytesWritten;
+        }
+
+        //
+        //  BytesValid was captured above since once the buffer is released
+        //  the reader is free to overwrite it.
+        //
+
+        if (InterlockedDecrement(&Buffer->WritersRemaining) == 0) {
+            ReleaseSemaphore(Pump->FreeBuffers, 1, NULL);
+        }
+
+        if (BytesValid == 0) {
+            break;
+        }
+    }
+
+    return Writer->Error;
+}
+
+/**
+ Copy the entire contents of a source stream to one or more target streams.
+ The calling thread reads from the source into a ring of buffers while a
+ thread per target writes each buffer, so reads proceed while writes are
+ outstanding and each target is written concurrently with the others.  No
+ encoding or line ending translation is performed.
+
+ @param hSource The handle to read data from.
+
+ @param TargetCount The number of handles in the Targets array.
+
+ @param Targets An array of handles to write data to.
+
+ @param BytesCopied Optionally points to a value to receive the number of
+        bytes read from the source.
+
+ @return TRUE to indicate the source was read until end of stream and all
+         data was written to all targets, FALSE on failure.
+ */
+__success(return)
+BOOL
+YoriLibPipePump(
+    __in HANDLE hSource,
+    __in DWORD TargetCount,
+    __in_ecount(TargetCount) PHANDLE Targets,
+    __out_opt PDWORDLONG BytesCopied
+    )
+{
+    PYORILIB_PIPE_PUMP Pump;
+    PYORILIB_PIPE_PUMP_BUFFER Buffer;
+    PYORILIB_PIPE_PUMP_WRITER Writer;
+    PHANDLE ThreadHandles;
+    DWORDLONG TotalBytes;
+    DWORD BuffersProduced;
+    DWORD BytesRead;
+    DWORD ThreadId;
+    DWORD Index;
+    DWORD Err;
+    BOOL Result;
+
+    if (TargetCount == 0) {
+        return FALSE;
+    }
+
+    Pump = YoriLibMalloc(sizeof(YORILIB_PIPE_PUMP) +
+                         TargetCount * (sizeof(YORILIB_PIPE_PUMP_WRITER) + sizeof(HANDLE)) +
+                         YORILIB_PIPE_PUMP_BUFFER_COUNT * YORILIB_PIPE_PUMP_BUFFER_SIZE);
+    if (Pump == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Pump, sizeof(YORILIB_PIPE_PUMP) + TargetCount * (sizeof(YORILIB_PIPE_PUMP_WRITER) + sizeof(HANDLE)));
+    Pump->WriterCount = TargetCount;
+    Pump->Writers = (PYORILIB_PIPE_PUMP_WRITER)(Pump + 1);
+    ThreadHandles = (PHANDLE)(Pump->Writers + TargetCount);
+    for (Index = 0; Index < YORILIB_PIPE_PUMP_BUFFER_COUNT; Index++) {
+        Pump->Buffers[Index].Data = (PUCHAR)(ThreadHandles + TargetCount) + Index * YORILIB_PIPE_PUMP_BUFFER_SIZE;
+    }
+
+    Result = FALSE;
+    Err = ERROR_SUCCESS;
+    TotalBytes = 0;
+    BuffersProduced = 0;
+
+    Pump->FreeBuffers = CreateSemaphore(NULL, YORILIB_PIPE_PUMP_BUFFER_COUNT, YORILIB_PIPE_PUMP_BUFFER_COUNT, NULL);
+    if (Pump->FreeBuffers == NULL) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    for (Index = 0; Index < TargetCount; Index++) {
+        Writer = &Pump->Writers[Index];
+        Writer->Pump = Pump;
+        Writer->hTarget = Targets[Index];
+        Writer->DataAvailable = CreateSemaphore(NULL, 0, YORILIB_PIPE_PUMP_BUFFER_COUNT, NULL);
+        if (Writer->DataAvailable == NULL) {
+            Err = GetLastError();
+            goto Exit;
+        }
+        Writer->hThread = CreateThread(NULL, 0, YoriLibPipePumpWriter, Writer, 0, &ThreadId);
+        if (Writer->hThread == NULL) {
+            Err = GetLastError();
+            goto Exit;
+        }
+    }
+
+    //
+    //  Read into each free buffer and hand it to every writer.  A read of
+    //  zero bytes, or a failed read, is handed to writers as a zero length
+    //  buffer which indicates the end of the stream.
+    //
+
+    while (TRUE) {
+        WaitForSingleObject(Pump->FreeBuffers, INFINITE);
+
+        Buffer = &Pump->Buffers[BuffersProduced % YORILIB_PIPE_PUMP_BUFFER_COUNT];
+        BuffersProduced++;
+
+        BytesRead = 0;
+        if (!YoriLibIsOperationCancelled() &&
+            !ReadFile(hSource, Buffer->Data, YORILIB_PIPE_PUMP_BUFFER_SIZE, &BytesRead, NULL)) {
+
+            Err = GetLastError();
+            if (Err == ERROR_BROKEN_PIPE || Err == ERROR_HANDLE_EOF) {
+                Err = ERROR_SUCCESS;
+            }
+            BytesRead = 0;
+        }
+
+        Buffer->BytesValid = BytesRead;
+        Buffer->WritersRemaining = (LONG)TargetCount;
+        TotalBytes += BytesRead;
+
+        for (Index = 0; Index < TargetCount; Index++) {
+            ReleaseSemaphore(Pump->Writers[Index].DataAvailable, 1, NULL);
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+    }
+
+Exit:
+
+    //
+    //  If setup failed part way, any writer that was started is waiting
+    //  for data.  Give it an end of stream buffer so it terminates.  If
+    //  setup succeeded, the end of stream has already been delivered.
+    //
+
+    if (BuffersProduced == 0) {
+        for (Index = 0; Index < TargetCount; Index++) {
+            if (Pump->Writers[Index].hThread != NULL) {
+                Pump->Buffers[0].WritersRemaining++;
+                ReleaseSemaphore(Pump->Writers[Index].DataAvailable, 1, NULL);
+            }
+        }
+    }
+
+    ThreadId = 0;
+    for (Index = 0; Index < TargetCount; Index++) {
+        if (Pump->Writers[Index].hThread != NULL) {
+            ThreadHandles[ThreadId] = Pump->Writers[Index].hThread;
+            ThreadId++;
+        }
+    }
+
+    //
+    //  WaitForMultipleObjects is limited in the number of handles it can
+    //  wait for, so wait in groups.
+    //
+
+    for (Index = 0; Index < ThreadId; Index += MAXIMUM_WAIT_OBJECTS) {
+        DWORD CountThisPass = ThreadId - Index;
+        if (CountThisPass > MAXIMUM_WAIT_OBJECTS) {
+            CountThisPass = MAXIMUM_WAIT_OBJECTS;
+        }
+        WaitForMultipleObjects(CountThisPass, &ThreadHandles[Index], TRUE, INFINITE);
+    }
+
+    for (Index = 0; Index < TargetCount; Index++) {
+        Writer = &Pump->Writers[Index];
+        if (Writer->hThread != NULL) {
+            CloseHandle(Writer->hThread);
+        }
+        if (Writer->DataAvailable != NULL) {
+            CloseHandle(Writer->DataAvailable);
+        }
+        if (Err == ERROR_SUCCESS && Writer->Error != ERROR_SUCCESS) {
+            Err = Writer->Error;
+        }
+    }
+
+    if (Pump->FreeBuffers != NULL) {
+        CloseHandle(Pump->FreeBuffers);
+    }
+
+    if (Err == ERROR_SUCCESS && BuffersProduced > 0) {
+        Result = TRUE;
+    }
+
+    YoriLibFree(Pump);
+
+    if (BytesCopied != NULL) {
+        *BytesCopied = TotalBytes;
+    }
+
+    if (!Result) {
+        SetLastError(Err);
+    }
+
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
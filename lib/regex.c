@@ -0,0 +1,2735 @@
+/**
+ * @file lib/regex.c
+ *
+ * Yori regular expression compilation and matching routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ A value used to indicate no state, no class, or no pattern.
+ */
+#define YORILIB_REGEX_NONE ((DWORD)-1)
+
+/**
+ The maximum number of NFA states a set of patterns can compile into.  This
+ exists to bound the damage from nested repeat counts.
+ */
+#define YORILIB_REGEX_MAX_STATES (0x40000)
+
+/**
+ The maximum value that can be specified in a {m,n} repeat count.
+ */
+#define YORILIB_REGEX_MAX_REPEAT (255)
+
+/**
+ The maximum nesting of groups within a pattern.
+ */
+#define YORILIB_REGEX_MAX_DEPTH (128)
+
+/**
+ The number of hash buckets used to find previously constructed DFA states.
+ This must be a power of two.
+ */
+#define YORILIB_REGEX_DFA_BUCKETS (1024)
+
+/**
+ The number of bytes of DFA states that can be cached before the cache is
+ discarded and rebuilt.
+ */
+#define YORILIB_REGEX_DFA_CACHE_SIZE (2 * 1024 * 1024)
+
+/**
+ The minimum number of code units that should be processed for each DFA
+ state constructed.  If the cache fills faster than this, rebuilding it is
+ slower than simulating the NFA, so the NFA is used instead.
+ */
+#define YORILIB_REGEX_MIN_CHARS_PER_STATE (10)
+
+/**
+ The size of each region allocated to hold DFA states.
+ */
+#define YORILIB_REGEX_DFA_REGION_SIZE (64 * 1024)
+
+/**
+ The number of DWORDs needed to hold one bit for every UTF-16 code unit.
+ */
+#define YORILIB_REGEX_BITMAP_DWORDS (0x10000 / 32)
+
+/**
+ Set a bit for a code unit in a bitmap.
+ */
+#define YORILIB_REGEX_BITMAP_SET(Bitmap, Char) \
+    ((Bitmap)[(Char) >> 5] |= ((DWORD)1 << ((Char) & 31)))
+
+/**
+ Test whether a bit for a code unit is set in a bitmap.
+ */
+#define YORILIB_REGEX_BITMAP_TEST(Bitmap, Char) \
+    (((Bitmap)[(Char) >> 5] & ((DWORD)1 << ((Char) & 31))) != 0)
+
+/**
+ An NFA state which transitions to Out without consuming input.
+ */
+#define YORILIB_REGEX_NFA_EPSILON    0
+
+/**
+ An NFA state which transitions to both Out and Out1 without consuming
+ input.
+ */
+#define YORILIB_REGEX_NFA_SPLIT      1
+
+/**
+ An NFA state which consumes one code unit in the class indicated by Value
+ and transitions to Out.
+ */
+#define YORILIB_REGEX_NFA_CLASS      2
+
+/**
+ An NFA state which transitions to Out only at the start of the string.
+ */
+#define YORILIB_REGEX_NFA_LINE_START 3
+
+/**
+ An NFA state which transitions to Out only at the end of the string.
+ */
+#define YORILIB_REGEX_NFA_LINE_END   4
+
+/**
+ An NFA state indicating the pattern whose index is in Value has matched.
+ */
+#define YORILIB_REGEX_NFA_MATCH      5
+
+/**
+ When computing the closure of a state, follow line start assertions.
+ */
+#define YORILIB_REGEX_CLOSURE_LINE_START 0x1
+
+/**
+ When computing the closure of a state, follow line end assertions.
+ */
+#define YORILIB_REGEX_CLOSURE_LINE_END   0x2
+
+/**
+ A single state in the NFA compiled from a set of patterns.
+ */
+typedef struct _YORILIB_REGEX_NFA_STATE {
+
+    /**
+     The type of the state, one of the YORILIB_REGEX_NFA_ values.
+     */
+    DWORD Type;
+
+    /**
+     The state to move to after this state is satisfied.
+     */
+    DWORD Out;
+
+    /**
+     The second state to move to, for split states only.
+     */
+    DWORD Out1;
+
+    /**
+     For class states, the index of the class to match.  For match states,
+     the index of the pattern that has matched.
+     */
+    DWORD Value;
+
+    /**
+     TRUE if this state is reachable from the start state without consuming
+     input.  Since a match can begin anywhere, these states are active at
+     every point in the input, so they are not recorded in DFA states.
+     */
+    BOOL InStartClosure;
+} YORILIB_REGEX_NFA_STATE, *PYORILIB_REGEX_NFA_STATE;
+
+/**
+ An inclusive range of UTF-16 code units.
+ */
+typedef struct _YORILIB_REGEX_RANGE {
+
+    /**
+     The first code unit in the range.
+     */
+    WCHAR Low;
+
+    /**
+     The last code unit in the range.
+     */
+    WCHAR High;
+} YORILIB_REGEX_RANGE, *PYORILIB_REGEX_RANGE;
+
+/**
+ A pointer to a range that cannot change.
+ */
+typedef YORILIB_REGEX_RANGE CONST *PCYORILIB_REGEX_RANGE;
+
+/**
+ A set of code units that a class state can consume, described as a sorted
+ list of non overlapping ranges.
+ */
+typedef struct _YORILIB_REGEX_CLASS {
+
+    /**
+     The index of the first range for this class in the ranges array.
+     */
+    DWORD FirstRange;
+
+    /**
+     The number of ranges describing this class.
+     */
+    DWORD RangeCount;
+} YORILIB_REGEX_CLASS, *PYORILIB_REGEX_CLASS;
+
+/**
+ A set of NFA states, implemented as a sparse set so that it can be cleared,
+ added to, and tested for membership in constant time.
+ */
+typedef struct _YORILIB_REGEX_STATE_SET {
+
+    /**
+     An array of the states in the set, in the order they were added.
+     */
+    PDWORD Dense;
+
+    /**
+     An array indexed by state, indicating the location of the state in the
+     Dense array if the state is present.
+     */
+    PDWORD Sparse;
+
+    /**
+     The number of states in the set.
+     */
+    DWORD Count;
+} YORILIB_REGEX_STATE_SET, *PYORILIB_REGEX_STATE_SET;
+
+/**
+ A DFA state, corresponding to a set of NFA states that can be active at a
+ point in the input.  These are constructed as the input is processed and
+ cached so that each transition is only computed once.
+ */
+typedef struct _YORILIB_REGEX_DFA_STATE {
+
+    /**
+     The next DFA state in the same hash bucket.
+     */
+    struct _YORILIB_REGEX_DFA_STATE *HashNext;
+
+    /**
+     The next DFA state in the list of all cached states.
+     */
+    struct _YORILIB_REGEX_DFA_STATE *AllNext;
+
+    /**
+     The referenced arena region containing this state.
+     */
+    PVOID Region;
+
+    /**
+     The hash of the NFA states that make up this DFA state.
+     */
+    DWORD Hash;
+
+    /**
+     The lowest index of any pattern which has matched on entry to this
+     state, or YORILIB_REGEX_NONE if no pattern has matched.
+     */
+    DWORD Match;
+
+    /**
+     The lowest index of any pattern which matches if the input ends in this
+     state, or YORILIB_REGEX_NONE if no pattern would match.
+     */
+    DWORD EndMatch;
+
+    /**
+     The number of NFA states in the NfaStates array.
+     */
+    DWORD NfaCount;
+
+    /**
+     An array of the NFA states that make up this DFA state.  Only states
+     that consume input, match, or test for the end of input are recorded.
+     */
+    PDWORD NfaStates;
+
+    /**
+     An array of transitions indexed by symbol.  Entries are NULL until the
+     transition has been computed.
+     */
+    struct _YORILIB_REGEX_DFA_STATE **Next;
+} YORILIB_REGEX_DFA_STATE, *PYORILIB_REGEX_DFA_STATE;
+
+/**
+ A compiled set of regular expressions.
+ */
+struct _YORILIB_REGEX {
+
+    /**
+     Flags specified when the set was compiled, including
+     YORILIB_REGEX_INSENSITIVE.
+     */
+    DWORD Flags;
+
+    /**
+     The number of patterns in the set.
+     */
+    DWORD PatternCount;
+
+    /**
+     The state to begin matching from.
+     */
+    DWORD StartState;
+
+    /**
+     An array of the states in the closure of the start state which consume
+     input, match, or test for the end of input.
+     */
+    PDWORD StartStates;
+
+    /**
+     The number of elements in the StartStates array.
+     */
+    DWORD StartStateCount;
+
+    /**
+     The lowest index of any pattern which matches within the closure of the
+     start state, meaning it matches an empty string.
+     */
+    DWORD StartMatch;
+
+    /**
+     The lowest index of any pattern which matches within the closure of the
+     start state at the end of input.
+     */
+    DWORD StartEndMatch;
+
+    /**
+     An array of NFA states.
+     */
+    PYORILIB_REGEX_NFA_STATE States;
+
+    /**
+     The number of elements in the States array that are in use.
+     */
+    DWORD StateCount;
+
+    /**
+     The number of elements allocated in the States array.
+     */
+    DWORD StatesAllocated;
+
+    /**
+     An array of classes that class states can refer to.
+     */
+    PYORILIB_REGEX_CLASS Classes;
+
+    /**
+     The number of elements in the Classes array that are in use.
+     */
+    DWORD ClassCount;
+
+    /**
+     The number of elements allocated in the Classes array.
+     */
+    DWORD ClassesAllocated;
+
+    /**
+     An array of ranges that classes refer to.
+     */
+    PYORILIB_REGEX_RANGE Ranges;
+
+    /**
+     The number of elements in the Ranges array that are in use.
+     */
+    DWORD RangeCount;
+
+    /**
+     The number of elements allocated in the Ranges array.
+     */
+    DWORD RangesAllocated;
+
+    /**
+     The first code unit of each symbol.  Code units are grouped into
+     symbols such that every code unit within a symbol is treated the same
+     way by every class, so the DFA only needs a transition per symbol
+     rather than per code unit.
+     */
+    PWCHAR SymbolStart;
+
+    /**
+     The number of symbols.
+     */
+    DWORD SymbolCount;
+
+    /**
+     The symbol for each of the first 256 code units, so that common text
+     can be translated without a search.
+     */
+    WORD LowSymbol[256];
+
+    /**
+     Two state sets used to compute transitions.
+     */
+    YORILIB_REGEX_STATE_SET Sets[2];
+
+    /**
+     A state set used when evaluating the end of input.
+     */
+    YORILIB_REGEX_STATE_SET EndSet;
+
+    /**
+     A stack used when computing the closure of a state.
+     */
+    PDWORD Stack;
+
+    /**
+     The arena that DFA states are allocated from.
+     */
+    YORILIB_ARENA Arena;
+
+    /**
+     Hash buckets used to find existing DFA states.
+     */
+    PYORILIB_REGEX_DFA_STATE Buckets[YORILIB_REGEX_DFA_BUCKETS];
+
+    /**
+     A list of every DFA state currently cached.
+     */
+    PYORILIB_REGEX_DFA_STATE AllStates;
+
+    /**
+     The DFA state at the beginning of the input, or NULL if it has not been
+     constructed.
+     */
+    PYORILIB_REGEX_DFA_STATE InitialState;
+
+    /**
+     The number of bytes consumed by cached DFA states.
+     */
+    DWORD DfaBytes;
+
+    /**
+     The number of DFA states currently cached.
+     */
+    DWORD DfaStateCount;
+
+    /**
+     The number of code units processed since the cache was last discarded.
+     */
+    DWORD CharsSinceFlush;
+};
+
+/**
+ Context used while parsing a single pattern.
+ */
+typedef struct _YORILIB_REGEX_PARSER {
+
+    /**
+     The set of expressions being compiled.
+     */
+    PYORILIB_REGEX Regex;
+
+    /**
+     The pattern being parsed.
+     */
+    PYORI_STRING Pattern;
+
+    /**
+     The current offset within the pattern.
+     */
+    DWORD Offset;
+
+    /**
+     The current nesting of groups.
+     */
+    DWORD Depth;
+
+    /**
+     Scratch space with one bit per code unit, used to build classes.
+     */
+    PDWORD Bitmap;
+} YORILIB_REGEX_PARSER, *PYORILIB_REGEX_PARSER;
+
+/**
+ A piece of an NFA under construction.  Every fragment ends in an epsilon
+ state whose Out has not yet been filled in.
+ */
+typedef struct _YORILIB_REGEX_FRAGMENT {
+
+    /**
+     The state to enter the fragment.
+     */
+    DWORD Start;
+
+    /**
+     The epsilon state to leave the fragment.
+     */
+    DWORD End;
+} YORILIB_REGEX_FRAGMENT, *PYORILIB_REGEX_FRAGMENT;
+
+/**
+ The ranges matched by \d .
+ */
+CONST YORILIB_REGEX_RANGE YoriLibRegexDigitRanges[] = {
+    {'0', '9'}
+};
+
+/**
+ The ranges matched by \w .
+ */
+CONST YORILIB_REGEX_RANGE YoriLibRegexWordRanges[] = {
+    {'0', '9'},
+    {'A', 'Z'},
+    {'_', '_'},
+    {'a', 'z'}
+};
+
+/**
+ The ranges matched by \s .
+ */
+CONST YORILIB_REGEX_RANGE YoriLibRegexSpaceRanges[] = {
+    {'\t', '\r'},
+    {' ', ' '}
+};
+
+/**
+ Grow an array used while compiling.
+
+ @param Array On input, points to the current array, which may be NULL.  On
+        successful completion, updated to point to the new array.
+
+ @param Allocated On input, the number of elements in the current array.  On
+        successful completion, updated to the number of elements in the new
+        array.
+
+ @param ElementSize The size of each element, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexGrowArray(
+    __inout PVOID *Array,
+    __inout PDWORD Allocated,
+    __in DWORD ElementSize
+    )
+{
+    PVOID NewArray;
+    DWORD NewAllocated;
+
+    NewAllocated = *Allocated * 2;
+    if (NewAllocated < 64) {
+        NewAllocated = 64;
+    }
+
+    NewArray = YoriLibMalloc(NewAllocated * ElementSize);
+    if (NewArray == NULL) {
+        return FALSE;
+    }
+
+    if (*Array != NULL) {
+        memcpy(NewArray, *Array, *Allocated * ElementSize);
+        YoriLibFree(*Array);
+    }
+
+    *Array = NewArray;
+    *Allocated = NewAllocated;
+    return TRUE;
+}
+
+/**
+ Add a state to the NFA.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Type The type of the state, one of the YORILIB_REGEX_NFA_ values.
+
+ @param Out The state to move to after this state.
+
+ @param Value The class or pattern index for the state.
+
+ @return The index of the new state, or YORILIB_REGEX_NONE on failure.
+ */
+DWORD
+YoriLibRegexAddState(
+    __in PYORILIB_REGEX Regex,
+    __in DWORD Type,
+    __in DWORD Out,
+    __in DWORD Value
+    )
+{
+    PYORILIB_REGEX_NFA_STATE State;
+
+    if (Regex->StateCount >= YORILIB_REGEX_MAX_STATES) {
+        return YORILIB_REGEX_NONE;
+    }
+
+    if (Regex->StateCount == Regex->StatesAllocated &&
+        !YoriLibRegexGrowArray((PVOID *)&Regex->States, &Regex->StatesAllocated, sizeof(YORILIB_REGEX_NFA_STATE))) {
+
+        return YORILIB_REGEX_NONE;
+    }
+
+    State = &Regex->States[Regex->StateCount];
+    State->Type = Type;
+    State->Out = Out;
+    State->Out1 = YORILIB_REGEX_NONE;
+    State->Value = Value;
+    State->InStartClosure = FALSE;
+    return Regex->StateCount++;
+}
+
+/**
+ Add a class described by a single range to the set of expressions.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Low The first code unit in the class.
+
+ @param High The last code unit in the class.
+
+ @return The index of the new class, or YORILIB_REGEX_NONE on failure.
+ */
+DWORD
+YoriLibRegexAddRangeClass(
+    __in PYORILIB_REGEX Regex,
+    __in WCHAR Low,
+    __in WCHAR High
+    )
+{
+    if (Regex->RangeCount == Regex->RangesAllocated &&
+        !YoriLibRegexGrowArray((PVOID *)&Regex->Ranges, &Regex->RangesAllocated, sizeof(YORILIB_REGEX_RANGE))) {
+
+        return YORILIB_REGEX_NONE;
+    }
+
+    if (Regex->ClassCount == Regex->ClassesAllocated &&
+        !YoriLibRegexGrowArray((PVOID *)&Regex->Classes, &Regex->ClassesAllocated, sizeof(YORILIB_REGEX_CLASS))) {
+
+        return YORILIB_REGEX_NONE;
+    }
+
+    Regex->Ranges[Regex->RangeCount].Low = Low;
+    Regex->Ranges[Regex->RangeCount].High = High;
+    Regex->Classes[Regex->ClassCount].FirstRange = Regex->RangeCount;
+    Regex->Classes[Regex->ClassCount].RangeCount = 1;
+    Regex->RangeCount++;
+    return Regex->ClassCount++;
+}
+
+/**
+ Add a class described by a bitmap to the set of expressions.  If the set
+ is being compiled case insensitively, the class is extended to include the
+ upcased form of each code unit, since input is upcased before matching.
+
+ @param Parser The parser context, whose Bitmap describes the class.  The
+        bitmap is modified by this function.
+
+ @param Negate If TRUE, the class should match every code unit not in the
+        bitmap, except for high surrogates, which the caller is expected to
+        match as part of a surrogate pair.
+
+ @return The index of the new class, or YORILIB_REGEX_NONE on failure.
+ */
+DWORD
+YoriLibRegexAddBitmapClass(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __in BOOL Negate
+    )
+{
+    PYORILIB_REGEX Regex;
+    PDWORD Bitmap;
+    DWORD Index;
+    DWORD Char;
+    DWORD Low;
+    DWORD FirstRange;
+
+    Regex = Parser->Regex;
+    Bitmap = Parser->Bitmap;
+
+    if (Regex->Flags & YORILIB_REGEX_INSENSITIVE) {
+        for (Index = 0; Index < YORILIB_REGEX_BITMAP_DWORDS; Index++) {
+            if (Bitmap[Index] == 0) {
+                continue;
+            }
+            for (Char = Index * 32; Char < (Index + 1) * 32; Char++) {
+                if (YORILIB_REGEX_BITMAP_TEST(Bitmap, Char)) {
+                    YORILIB_REGEX_BITMAP_SET(Bitmap, YoriLibUpcaseChar((TCHAR)Char));
+                }
+            }
+        }
+    }
+
+    if (Negate) {
+        for (Index = 0; Index < YORILIB_REGEX_BITMAP_DWORDS; Index++) {
+            Bitmap[Index] = ~(Bitmap[Index]);
+        }
+        for (Char = 0xD800; Char <= 0xDBFF; Char += 32) {
+            Bitmap[Char >> 5] = 0;
+        }
+    }
+
+    if (Regex->ClassCount == Regex->ClassesAllocated &&
+        !YoriLibRegexGrowArray((PVOID *)&Regex->Classes, &Regex->ClassesAllocated, sizeof(YORILIB_REGEX_CLASS))) {
+
+        return YORILIB_REGEX_NONE;
+    }
+
+    //
+    //  Convert each run of set bits into a range.
+    //
+
+    FirstRange = Regex->RangeCount;
+    Char = 0;
+    while (Char < 0x10000) {
+        if (Bitmap[Char >> 5] == 0) {
+            Char = (Char + 32) & ~(31);
+            continue;
+        }
+        if (!YORILIB_REGEX_BITMAP_TEST(Bitmap, Char)) {
+            Char++;
+            continue;
+        }
+
+        Low = Char;
+        while (Char < 0x10000 && YORILIB_REGEX_BITMAP_TEST(Bitmap, Char)) {
+            Char++;
+        }
+
+        if (Regex->RangeCount == Regex->RangesAllocated &&
+            !YoriLibRegexGrowArray((PVOID *)&Regex->Ranges, &Regex->RangesAllocated, sizeof(YORILIB_REGEX_RANGE))) {
+
+            return YORILIB_REGEX_NONE;
+        }
+
+        Regex->Ranges[Regex->RangeCount].Low = (WCHAR)Low;
+        Regex->Ranges[Regex->RangeCount].High = (WCHAR)(Char - 1);
+        Regex->RangeCount++;
+    }
+
+    Regex->Classes[Regex->ClassCount].FirstRange = FirstRange;
+    Regex->Classes[Regex->ClassCount].RangeCount = Regex->RangeCount - FirstRange;
+    return Regex->ClassCount++;
+}
+
+/**
+ Set the bits in a bitmap corresponding to a list of ranges.
+
+ @param Bitmap The bitmap to update.
+
+ @param Ranges Pointer to a sorted array of ranges.
+
+ @param RangeCount The number of elements in the Ranges array.
+
+ @param Negate If TRUE, set the bits for every code unit not in the ranges.
+ */
+VOID
+YoriLibRegexAddRangesToBitmap(
+    __inout PDWORD Bitmap,
+    __in PCYORILIB_REGEX_RANGE Ranges,
+    __in DWORD RangeCount,
+    __in BOOL Negate
+    )
+{
+    DWORD Index;
+    DWORD Char;
+    DWORD Next;
+
+    Next = 0;
+    for (Index = 0; Index < RangeCount; Index++) {
+        if (Negate) {
+            for (Char = Next; Char < Ranges[Index].Low; Char++) {
+                YORILIB_REGEX_BITMAP_SET(Bitmap, Char);
+            }
+        } else {
+            for (Char = Ranges[Index].Low; Char <= Ranges[Index].High; Char++) {
+                YORILIB_REGEX_BITMAP_SET(Bitmap, Char);
+            }
+        }
+        Next = Ranges[Index].High + 1;
+    }
+
+    if (Negate) {
+        for (Char = Next; Char < 0x10000; Char++) {
+            YORILIB_REGEX_BITMAP_SET(Bitmap, Char);
+        }
+    }
+}
+
+/**
+ Create a fragment which matches nothing, used for empty patterns and
+ empty alternatives.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Fragment On successful completion, populated with the new fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexEmptyFragment(
+    __in PYORILIB_REGEX Regex,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    Fragment->Start = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_EPSILON, YORILIB_REGEX_NONE, 0);
+    Fragment->End = Fragment->Start;
+    return (Fragment->Start != YORILIB_REGEX_NONE);
+}
+
+/**
+ Create a fragment containing a single state which is followed by the end
+ of the fragment.  This is used for class states and assertions.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Type The type of the state, one of the YORILIB_REGEX_NFA_ values.
+
+ @param Value The class index for the state.
+
+ @param Fragment On successful completion, populated with the new fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexStateFragment(
+    __in PYORILIB_REGEX Regex,
+    __in DWORD Type,
+    __in DWORD Value,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    if (Value == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    Fragment->End = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_EPSILON, YORILIB_REGEX_NONE, 0);
+    if (Fragment->End == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    Fragment->Start = YoriLibRegexAddState(Regex, Type, Fragment->End, Value);
+    return (Fragment->Start != YORILIB_REGEX_NONE);
+}
+
+/**
+ Create a fragment matching a single literal code unit.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Char The code unit to match.
+
+ @param Fragment On successful completion, populated with the new fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexCharFragment(
+    __in PYORILIB_REGEX Regex,
+    __in WCHAR Char,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    if (Regex->Flags & YORILIB_REGEX_INSENSITIVE) {
+        Char = YoriLibUpcaseChar(Char);
+    }
+
+    return YoriLibRegexStateFragment(Regex,
+                                     YORILIB_REGEX_NFA_CLASS,
+                                     YoriLibRegexAddRangeClass(Regex, Char, Char),
+                                     Fragment);
+}
+
+/**
+ Join two fragments so that the second follows the first.
+
+ @param Regex The set of expressions being compiled.
+
+ @param First On input, the first fragment.  On output, updated to describe
+        the combined fragment.
+
+ @param Second The fragment to follow the first.
+ */
+VOID
+YoriLibRegexConcatenate(
+    __in PYORILIB_REGEX Regex,
+    __inout PYORILIB_REGEX_FRAGMENT First,
+    __in PYORILIB_REGEX_FRAGMENT Second
+    )
+{
+    Regex->States[First->End].Out = Second->Start;
+    First->End = Second->End;
+}
+
+/**
+ Combine two fragments so that either may match.
+
+ @param Regex The set of expressions being compiled.
+
+ @param First On input, the first alternative.  On successful completion,
+        updated to describe the combined fragment.
+
+ @param Second The second alternative.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexAlternate(
+    __in PYORILIB_REGEX Regex,
+    __inout PYORILIB_REGEX_FRAGMENT First,
+    __in PYORILIB_REGEX_FRAGMENT Second
+    )
+{
+    DWORD Split;
+    DWORD End;
+
+    End = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_EPSILON, YORILIB_REGEX_NONE, 0);
+    if (End == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    Split = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_SPLIT, First->Start, 0);
+    if (Split == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    Regex->States[Split].Out1 = Second->Start;
+    Regex->States[First->End].Out = End;
+    Regex->States[Second->End].Out = End;
+    First->Start = Split;
+    First->End = End;
+    return TRUE;
+}
+
+/**
+ Apply a quantifier to a fragment.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Quantifier The quantifier to apply, which is '*', '+' or '?'.
+
+ @param Fragment On input, the fragment to repeat.  On successful
+        completion, updated to describe the repeated fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexQuantify(
+    __in PYORILIB_REGEX Regex,
+    __in TCHAR Quantifier,
+    __inout PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    DWORD Split;
+    DWORD End;
+
+    End = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_EPSILON, YORILIB_REGEX_NONE, 0);
+    if (End == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    Split = YoriLibRegexAddState(Regex, YORILIB_REGEX_NFA_SPLIT, Fragment->Start, 0);
+    if (Split == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+    Regex->States[Split].Out1 = End;
+
+    if (Quantifier == '?') {
+        Regex->States[Fragment->End].Out = End;
+        Fragment->Start = Split;
+    } else {
+        Regex->States[Fragment->End].Out = Split;
+        if (Quantifier == '*') {
+            Fragment->Start = Split;
+        }
+    }
+    Fragment->End = End;
+    return TRUE;
+}
+
+/**
+ Combine a class fragment with a fragment matching any surrogate pair, so
+ that negated classes and wildcards consume a complete character rather than
+ half of one.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Fragment On input, a fragment matching a single code unit.  On
+        successful completion, updated to also match a surrogate pair.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexAddSurrogatePair(
+    __in PYORILIB_REGEX Regex,
+    __inout PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    YORILIB_REGEX_FRAGMENT HighSurrogate;
+    YORILIB_REGEX_FRAGMENT LowSurrogate;
+
+    if (!YoriLibRegexStateFragment(Regex,
+                                   YORILIB_REGEX_NFA_CLASS,
+                                   YoriLibRegexAddRangeClass(Regex, 0xD800, 0xDBFF),
+                                   &HighSurrogate)) {
+        return FALSE;
+    }
+
+    if (!YoriLibRegexStateFragment(Regex,
+                                   YORILIB_REGEX_NFA_CLASS,
+                                   YoriLibRegexAddRangeClass(Regex, 0xDC00, 0xDFFF),
+                                   &LowSurrogate)) {
+        return FALSE;
+    }
+
+    YoriLibRegexConcatenate(Regex, &HighSurrogate, &LowSurrogate);
+    return YoriLibRegexAlternate(Regex, Fragment, &HighSurrogate);
+}
+
+/**
+ Create a fragment from the class described by the parser's bitmap.
+
+ @param Parser The parser context, whose Bitmap describes the class.
+
+ @param Negate If TRUE, the fragment should match any character not in the
+        bitmap.
+
+ @param Fragment On successful completion, populated with the new fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexBitmapFragment(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __in BOOL Negate,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    if (!YoriLibRegexStateFragment(Parser->Regex,
+                                   YORILIB_REGEX_NFA_CLASS,
+                                   YoriLibRegexAddBitmapClass(Parser, Negate),
+                                   Fragment)) {
+        return FALSE;
+    }
+
+    if (Negate) {
+        return YoriLibRegexAddSurrogatePair(Parser->Regex, Fragment);
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a fixed number of hex digits from a pattern.
+
+ @param Parser The parser context.  On success, the offset is advanced past
+        the digits.
+
+ @param DigitCount The number of digits to parse.
+
+ @param Char On successful completion, updated with the value of the digits.
+
+ @return TRUE to indicate success, FALSE if the digits are not present.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseHex(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __in DWORD DigitCount,
+    __out PWCHAR Char
+    )
+{
+    DWORD Index;
+    DWORD Value;
+    TCHAR Digit;
+
+    if (Parser->Offset + DigitCount > Parser->Pattern->LengthInChars) {
+        return FALSE;
+    }
+
+    Value = 0;
+    for (Index = 0; Index < DigitCount; Index++) {
+        Digit = Parser->Pattern->StartOfString[Parser->Offset + Index];
+        Value = Value * 16;
+        if (Digit >= '0' && Digit <= '9') {
+            Value += Digit - '0';
+        } else if (Digit >= 'a' && Digit <= 'f') {
+            Value += Digit - 'a' + 10;
+        } else if (Digit >= 'A' && Digit <= 'F') {
+            Value += Digit - 'A' + 10;
+        } else {
+            return FALSE;
+        }
+    }
+
+    Parser->Offset += DigitCount;
+    *Char = (WCHAR)Value;
+    return TRUE;
+}
+
+/**
+ Parse an escape sequence.  The parser offset should refer to the character
+ following the backslash.  An escape can describe either a single code unit
+ or a predefined set of code units.
+
+ @param Parser The parser context.  On success, the offset is advanced past
+        the escape.
+
+ @param Char On successful completion, if the escape describes a single code
+        unit, updated with the code unit.
+
+ @param Ranges On successful completion, if the escape describes a set of
+        code units, updated to point to the ranges describing the set.  If
+        the escape describes a single code unit, set to NULL.
+
+ @param RangeCount On successful completion, if the escape describes a set of
+        code units, updated with the number of ranges.
+
+ @param Negate On successful completion, if the escape describes a set of
+        code units, set to TRUE if the escape matches everything except the
+        ranges.
+
+ @return TRUE to indicate success, FALSE if the escape is not valid.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseEscape(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PWCHAR Char,
+    __out PCYORILIB_REGEX_RANGE *Ranges,
+    __out PDWORD RangeCount,
+    __out PBOOL Negate
+    )
+{
+    TCHAR Escape;
+
+    *Ranges = NULL;
+    *RangeCount = 0;
+    *Negate = FALSE;
+
+    if (Parser->Offset >= Parser->Pattern->LengthInChars) {
+        return FALSE;
+    }
+
+    Escape = Parser->Pattern->StartOfString[Parser->Offset];
+    Parser->Offset++;
+
+    switch(Escape) {
+        case 'D':
+            *Negate = TRUE;
+            // Fall through
+        case 'd':
+            *Ranges = YoriLibRegexDigitRanges;
+            *RangeCount = sizeof(YoriLibRegexDigitRanges)/sizeof(YoriLibRegexDigitRanges[0]);
+            return TRUE;
+        case 'W':
+            *Negate = TRUE;
+            // Fall through
+        case 'w':
+            *Ranges = YoriLibRegexWordRanges;
+            *RangeCount = sizeof(YoriLibRegexWordRanges)/sizeof(YoriLibRegexWordRanges[0]);
+            return TRUE;
+        case 'S':
+            *Negate = TRUE;
+            // Fall through
+        case 's':
+            *Ranges = YoriLibRegexSpaceRanges;
+            *RangeCount = sizeof(YoriLibRegexSpaceRanges)/sizeof(YoriLibRegexSpaceRanges[0]);
+            return TRUE;
+        case 'f':
+            *Char = '\f';
+            return TRUE;
+        case 'n':
+            *Char = '\n';
+            return TRUE;
+        case 'r':
+            *Char = '\r';
+            return TRUE;
+        case 't':
+            *Char = '\t';
+            return TRUE;
+        case 'v':
+            *Char = '\v';
+            return TRUE;
+        case 'x':
+            return YoriLibRegexParseHex(Parser, 2, Char);
+        case 'u':
+            return YoriLibRegexParseHex(Parser, 4, Char);
+    }
+
+    //
+    //  Reserve other letters and digits for future use, and treat any
+    //  other escaped character as itself.
+    //
+
+    if ((Escape >= 'a' && Escape <= 'z') ||
+        (Escape >= 'A' && Escape <= 'Z') ||
+        (Escape >= '0' && Escape <= '9')) {
+
+        Parser->Offset--;
+        return FALSE;
+    }
+
+    *Char = Escape;
+    return TRUE;
+}
+
+/**
+ Parse a bracketed character class.  The parser offset should refer to the
+ character following the opening bracket.
+
+ @param Parser The parser context.  On success, the offset is advanced past
+        the closing bracket.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches the class.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseClass(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PYORI_STRING Pattern;
+    PCYORILIB_REGEX_RANGE Ranges;
+    DWORD RangeCount;
+    BOOL NegateClass;
+    BOOL NegateRanges;
+    BOOL FirstChar;
+    WCHAR Low;
+    WCHAR High;
+    DWORD Char;
+
+    Pattern = Parser->Pattern;
+    ZeroMemory(Parser->Bitmap, YORILIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+
+    NegateClass = FALSE;
+    if (Parser->Offset < Pattern->LengthInChars &&
+        Pattern->StartOfString[Parser->Offset] == '^') {
+
+        NegateClass = TRUE;
+        Parser->Offset++;
+    }
+
+    FirstChar = TRUE;
+    while (TRUE) {
+        if (Parser->Offset >= Pattern->LengthInChars) {
+            return FALSE;
+        }
+
+        Low = Pattern->StartOfString[Parser->Offset];
+        if (Low == ']' && !FirstChar) {
+            Parser->Offset++;
+            break;
+        }
+        FirstChar = FALSE;
+        Parser->Offset++;
+
+        if (Low == '\\') {
+            if (!YoriLibRegexParseEscape(Parser, &Low, &Ranges, &RangeCount, &NegateRanges)) {
+                return FALSE;
+            }
+            if (Ranges != NULL) {
+                YoriLibRegexAddRangesToBitmap(Parser->Bitmap, Ranges, RangeCount, NegateRanges);
+                continue;
+            }
+        }
+
+        High = Low;
+        if (Parser->Offset + 1 < Pattern->LengthInChars &&
+            Pattern->StartOfString[Parser->Offset] == '-' &&
+            Pattern->StartOfString[Parser->Offset + 1] != ']') {
+
+            Parser->Offset++;
+            High = Pattern->StartOfString[Parser->Offset];
+            Parser->Offset++;
+            if (High == '\\') {
+                if (!YoriLibRegexParseEscape(Parser, &High, &Ranges, &RangeCount, &NegateRanges)) {
+                    return FALSE;
+                }
+                if (Ranges != NULL) {
+                    return FALSE;
+                }
+            }
+            if (High < Low) {
+                return FALSE;
+            }
+        }
+
+        for (Char = Low; Char <= High; Char++) {
+            YORILIB_REGEX_BITMAP_SET(Parser->Bitmap, Char);
+        }
+    }
+
+    return YoriLibRegexBitmapFragment(Parser, NegateClass, Fragment);
+}
+
+__success(return)
+BOOL
+YoriLibRegexParseAlternation(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    );
+
+/**
+ Parse a single atom, being a literal, escape, class, wildcard, assertion,
+ or parenthesized group.
+
+ @param Parser The parser context.  On success, the offset is advanced past
+        the atom.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches the atom.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseAtom(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PYORI_STRING Pattern;
+    PCYORILIB_REGEX_RANGE Ranges;
+    DWORD RangeCount;
+    BOOL Negate;
+    WCHAR Char;
+
+    Pattern = Parser->Pattern;
+    Char = Pattern->StartOfString[Parser->Offset];
+
+    switch(Char) {
+        case '(':
+            Parser->Offset++;
+            if (Parser->Depth >= YORILIB_REGEX_MAX_DEPTH) {
+                return FALSE;
+            }
+            if (Parser->Offset + 1 < Pattern->LengthInChars &&
+                Pattern->StartOfString[Parser->Offset] == '?' &&
+                Pattern->StartOfString[Parser->Offset + 1] == ':') {
+
+                Parser->Offset += 2;
+            }
+            Parser->Depth++;
+            if (!YoriLibRegexParseAlternation(Parser, Fragment)) {
+                return FALSE;
+            }
+            Parser->Depth--;
+            if (Parser->Offset >= Pattern->LengthInChars ||
+                Pattern->StartOfString[Parser->Offset] != ')') {
+                return FALSE;
+            }
+            Parser->Offset++;
+            return TRUE;
+        case '*':
+        case '+':
+        case '?':
+            return FALSE;
+        case '[':
+            Parser->Offset++;
+            return YoriLibRegexParseClass(Parser, Fragment);
+        case '.':
+            Parser->Offset++;
+            ZeroMemory(Parser->Bitmap, YORILIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+            return YoriLibRegexBitmapFragment(Parser, TRUE, Fragment);
+        case '^':
+            Parser->Offset++;
+            return YoriLibRegexStateFragment(Parser->Regex, YORILIB_REGEX_NFA_LINE_START, 0, Fragment);
+        case '$':
+            Parser->Offset++;
+            return YoriLibRegexStateFragment(Parser->Regex, YORILIB_REGEX_NFA_LINE_END, 0, Fragment);
+        case '\\':
+            Parser->Offset++;
+            if (!YoriLibRegexParseEscape(Parser, &Char, &Ranges, &RangeCount, &Negate)) {
+                return FALSE;
+            }
+            if (Ranges != NULL) {
+                ZeroMemory(Parser->Bitmap, YORILIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+                YoriLibRegexAddRangesToBitmap(Parser->Bitmap, Ranges, RangeCount, FALSE);
+                return YoriLibRegexBitmapFragment(Parser, Negate, Fragment);
+            }
+            return YoriLibRegexCharFragment(Parser->Regex, Char, Fragment);
+    }
+
+    Parser->Offset++;
+    return YoriLibRegexCharFragment(Parser->Regex, Char, Fragment);
+}
+
+/**
+ Parse a decimal number within a repeat count.  Values larger than
+ YORILIB_REGEX_MAX_REPEAT are reported as YORILIB_REGEX_MAX_REPEAT + 1 so
+ the caller can reject them.
+
+ @param Pattern The pattern being parsed.
+
+ @param Offset On input, the offset of the first digit.  On successful
+        completion, updated to the offset following the last digit.
+
+ @param Value On successful completion, updated with the number.
+
+ @return TRUE if a number was found, FALSE if no digits were present.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseRepeatNumber(
+    __in PYORI_STRING Pattern,
+    __inout PDWORD Offset,
+    __out PDWORD Value
+    )
+{
+    DWORD Index;
+    TCHAR Digit;
+
+    *Value = 0;
+    for (Index = *Offset; Index < Pattern->LengthInChars; Index++) {
+        Digit = Pattern->StartOfString[Index];
+        if (Digit < '0' || Digit > '9') {
+            break;
+        }
+        if (*Value <= YORILIB_REGEX_MAX_REPEAT) {
+            *Value = *Value * 10 + Digit - '0';
+        }
+    }
+
+    if (Index == *Offset) {
+        return FALSE;
+    }
+
+    if (*Value > YORILIB_REGEX_MAX_REPEAT) {
+        *Value = YORILIB_REGEX_MAX_REPEAT + 1;
+    }
+
+    *Offset = Index;
+    return TRUE;
+}
+
+/**
+ Parse a {m}, {m,} or {m,n} repeat count.  The parser offset should refer to
+ the opening brace.
+
+ @param Parser The parser context.  If a repeat count is found, the offset is
+        advanced past the closing brace.
+
+ @param Min On successful completion, updated with the minimum number of
+        repetitions.
+
+ @param Max On successful completion, updated with the maximum number of
+        repetitions, or YORILIB_REGEX_NONE if there is no maximum.
+
+ @return TRUE if a repeat count was found, FALSE if the brace should be
+         treated as a literal.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseRepeatCount(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PDWORD Min,
+    __out PDWORD Max
+    )
+{
+    PYORI_STRING Pattern;
+    DWORD Offset;
+
+    Pattern = Parser->Pattern;
+    Offset = Parser->Offset + 1;
+
+    if (!YoriLibRegexParseRepeatNumber(Pattern, &Offset, Min)) {
+        return FALSE;
+    }
+    *Max = *Min;
+
+    if (Offset < Pattern->LengthInChars &&
+        Pattern->StartOfString[Offset] == ',') {
+
+        Offset++;
+        if (!YoriLibRegexParseRepeatNumber(Pattern, &Offset, Max)) {
+            *Max = YORILIB_REGEX_NONE;
+        }
+    }
+
+    if (Offset >= Pattern->LengthInChars ||
+        Pattern->StartOfString[Offset] != '}') {
+        return FALSE;
+    }
+
+    Parser->Offset = Offset + 1;
+    return TRUE;
+}
+
+/**
+ Parse an atom followed by any number of quantifiers.  Repeat counts are
+ implemented by parsing the atom again for each copy that is needed.
+
+ @param Parser The parser context.  On success, the offset is advanced past
+        the atom and its quantifiers.
+
+ @param StopOffset The offset at which to stop looking for quantifiers.  This
+        is used when parsing additional copies for a repeat count, and is
+        YORILIB_REGEX_NONE otherwise.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches the repeated atom.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseRepeat(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __in DWORD StopOffset,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PYORI_STRING Pattern;
+    YORILIB_REGEX_FRAGMENT Result;
+    YORILIB_REGEX_FRAGMENT Copy;
+    DWORD AtomOffset;
+    DWORD BraceOffset;
+    DWORD ResumeOffset;
+    DWORD Min;
+    DWORD Max;
+    DWORD Count;
+    BOOL FragmentUsed;
+    TCHAR Char;
+
+    Pattern = Parser->Pattern;
+    AtomOffset = Parser->Offset;
+    if (!YoriLibRegexParseAtom(Parser, Fragment)) {
+        return FALSE;
+    }
+
+    while (Parser->Offset < Pattern->LengthInChars && Parser->Offset < StopOffset) {
+        Char = Pattern->StartOfString[Parser->Offset];
+        if (Char == '*' || Char == '+' || Char == '?') {
+            if (!YoriLibRegexQuantify(Parser->Regex, Char, Fragment)) {
+                return FALSE;
+            }
+            Parser->Offset++;
+            continue;
+        }
+
+        if (Char != '{') {
+            break;
+        }
+
+        BraceOffset = Parser->Offset;
+        if (!YoriLibRegexParseRepeatCount(Parser, &Min, &Max)) {
+            break;
+        }
+
+        if (Min > YORILIB_REGEX_MAX_REPEAT ||
+            (Max != YORILIB_REGEX_NONE && (Max > YORILIB_REGEX_MAX_REPEAT || Max < Min))) {
+
+            Parser->Offset = BraceOffset;
+            return FALSE;
+        }
+
+        ResumeOffset = Parser->Offset;
+
+        //
+        //  The fragment that has already been parsed is the first copy.
+        //  Each additional copy is generated by parsing the same text
+        //  again, up to but not including this repeat count.
+        //
+
+        FragmentUsed = FALSE;
+        if (Min == 0) {
+            if (!YoriLibRegexEmptyFragment(Parser->Regex, &Result)) {
+                return FALSE;
+            }
+        } else {
+            Result = *Fragment;
+            FragmentUsed = TRUE;
+        }
+
+        for (Count = 1; Count < Min; Count++) {
+            Parser->Offset = AtomOffset;
+            if (!YoriLibRegexParseRepeat(Parser, BraceOffset, &Copy)) {
+                return FALSE;
+            }
+            YoriLibRegexConcatenate(Parser->Regex, &Result, &Copy);
+        }
+
+        for (Count = Min; Count < Max; Count++) {
+            if (FragmentUsed) {
+                Parser->Offset = AtomOffset;
+                if (!YoriLibRegexParseRepeat(Parser, BraceOffset, &Copy)) {
+                    return FALSE;
+                }
+            } else {
+                Copy = *Fragment;
+                FragmentUsed = TRUE;
+            }
+            if (!YoriLibRegexQuantify(Parser->Regex, (TCHAR)(Max == YORILIB_REGEX_NONE?'*':'?'), &Copy)) {
+                return FALSE;
+            }
+            YoriLibRegexConcatenate(Parser->Regex, &Result, &Copy);
+            if (Max == YORILIB_REGEX_NONE) {
+                break;
+            }
+        }
+
+        *Fragment = Result;
+        Parser->Offset = ResumeOffset;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a sequence of atoms which must match one after another.
+
+ @param Parser The parser context.  On success, the offset is advanced to
+        the end of the pattern, or to the next alternation or closing
+        parenthesis.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches the sequence.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseConcatenation(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    YORILIB_REGEX_FRAGMENT Next;
+    BOOL HaveFragment;
+    TCHAR Char;
+
+    HaveFragment = FALSE;
+    while (Parser->Offset < Parser->Pattern->LengthInChars) {
+        Char = Parser->Pattern->StartOfString[Parser->Offset];
+        if (Char == '|' || Char == ')') {
+            break;
+        }
+
+        if (!YoriLibRegexParseRepeat(Parser, YORILIB_REGEX_NONE, &Next)) {
+            return FALSE;
+        }
+
+        if (HaveFragment) {
+            YoriLibRegexConcatenate(Parser->Regex, Fragment, &Next);
+        } else {
+            *Fragment = Next;
+            HaveFragment = TRUE;
+        }
+    }
+
+    if (!HaveFragment) {
+        return YoriLibRegexEmptyFragment(Parser->Regex, Fragment);
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a set of sequences separated by '|', any of which may match.
+
+ @param Parser The parser context.  On success, the offset is advanced to
+        the end of the pattern or to the next closing parenthesis.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches any of the sequences.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexParseAlternation(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    YORILIB_REGEX_FRAGMENT Next;
+
+    if (!YoriLibRegexParseConcatenation(Parser, Fragment)) {
+        return FALSE;
+    }
+
+    while (Parser->Offset < Parser->Pattern->LengthInChars &&
+           Parser->Pattern->StartOfString[Parser->Offset] == '|') {
+
+        Parser->Offset++;
+        if (!YoriLibRegexParseConcatenation(Parser, &Next)) {
+            return FALSE;
+        }
+        if (!YoriLibRegexAlternate(Parser->Regex, Fragment, &Next)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Compile a single pattern into a fragment, applying the pattern's flags.
+
+ @param Parser The parser context, which refers to the pattern to compile.
+
+ @param PatternFlags The flags for the pattern, being a combination of
+        YORILIB_REGEX_PATTERN_ values.
+
+ @param Fragment On successful completion, populated with a fragment that
+        matches the pattern.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexCompilePattern(
+    __in PYORILIB_REGEX_PARSER Parser,
+    __in DWORD PatternFlags,
+    __out PYORILIB_REGEX_FRAGMENT Fragment
+    )
+{
+    YORILIB_REGEX_FRAGMENT Next;
+    PYORILIB_REGEX Regex;
+
+    Regex = Parser->Regex;
+
+    if (PatternFlags & YORILIB_REGEX_PATTERN_ANCHOR_START) {
+        if (!YoriLibRegexStateFragment(Regex, YORILIB_REGEX_NFA_LINE_START, 0, Fragment)) {
+            return FALSE;
+        }
+    } else {
+        if (!YoriLibRegexEmptyFragment(Regex, Fragment)) {
+            return FALSE;
+        }
+    }
+
+    if (PatternFlags & YORILIB_REGEX_PATTERN_LITERAL) {
+        for (Parser->Offset = 0; Parser->Offset < Parser->Pattern->LengthInChars; Parser->Offset++) {
+            if (!YoriLibRegexCharFragment(Regex, Parser->Pattern->StartOfString[Parser->Offset], &Next)) {
+                return FALSE;
+            }
+            YoriLibRegexConcatenate(Regex, Fragment, &Next);
+        }
+    } else {
+        if (!YoriLibRegexParseAlternation(Parser, &Next)) {
+            return FALSE;
+        }
+
+        //
+        //  If parsing stopped before the end, there's an unbalanced
+        //  closing parenthesis.
+        //
+
+        if (Parser->Offset < Parser->Pattern->LengthInChars) {
+            return FALSE;
+        }
+        YoriLibRegexConcatenate(Regex, Fragment, &Next);
+    }
+
+    if (PatternFlags & YORILIB_REGEX_PATTERN_ANCHOR_END) {
+        if (!YoriLibRegexStateFragment(Regex, YORILIB_REGEX_NFA_LINE_END, 0, &Next)) {
+            return FALSE;
+        }
+        YoriLibRegexConcatenate(Regex, Fragment, &Next);
+    }
+
+    return TRUE;
+}
+
+/**
+ Divide the UTF-16 code unit space into symbols, where every code unit in a
+ symbol is contained in exactly the same classes.  This allows each DFA
+ state to have one transition per symbol, which for typical patterns is a
+ small number.
+
+ @param Regex The set of expressions being compiled.
+
+ @param Bitmap Scratch space with one bit per code unit.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexBuildSymbols(
+    __in PYORILIB_REGEX Regex,
+    __in PDWORD Bitmap
+    )
+{
+    DWORD Index;
+    DWORD Char;
+    DWORD Symbol;
+
+    //
+    //  Mark each code unit where some class begins or ends.
+    //
+
+    ZeroMemory(Bitmap, YORILIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+    YORILIB_REGEX_BITMAP_SET(Bitmap, 0);
+    for (Index = 0; Index < Regex->RangeCount; Index++) {
+        YORILIB_REGEX_BITMAP_SET(Bitmap, Regex->Ranges[Index].Low);
+        if (Regex->Ranges[Index].High < 0xFFFF) {
+            Char = Regex->Ranges[Index].High + 1;
+            YORILIB_REGEX_BITMAP_SET(Bitmap, Char);
+        }
+    }
+
+    Regex->SymbolCount = 0;
+    for (Char = 0; Char < 0x10000; Char++) {
+        if (YORILIB_REGEX_BITMAP_TEST(Bitmap, Char)) {
+            Regex->SymbolCount++;
+        }
+    }
+
+    Regex->SymbolStart = YoriLibMalloc(Regex->SymbolCount * sizeof(WCHAR));
+    if (Regex->SymbolStart == NULL) {
+        return FALSE;
+    }
+
+    Symbol = 0;
+    for (Char = 0; Char < 0x10000; Char++) {
+        if (YORILIB_REGEX_BITMAP_TEST(Bitmap, Char)) {
+            Regex->SymbolStart[Symbol] = (WCHAR)Char;
+            Symbol++;
+        }
+    }
+
+    Symbol = 0;
+    for (Char = 0; Char < sizeof(Regex->LowSymbol)/sizeof(Regex->LowSymbol[0]); Char++) {
+        while (Symbol + 1 < Regex->SymbolCount && Regex->SymbolStart[Symbol + 1] <= Char) {
+            Symbol++;
+        }
+        Regex->LowSymbol[Char] = (WORD)Symbol;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the symbol containing a code unit.
+
+ @param Regex The compiled set of expressions.
+
+ @param Char The code unit.
+
+ @return The symbol containing the code unit.
+ */
+DWORD
+YoriLibRegexSymbolFromChar(
+    __in PYORILIB_REGEX Regex,
+    __in WCHAR Char
+    )
+{
+    DWORD Low;
+    DWORD High;
+    DWORD Mid;
+
+    if (Char < sizeof(Regex->LowSymbol)/sizeof(Regex->LowSymbol[0])) {
+        return Regex->LowSymbol[Char];
+    }
+
+    Low = 0;
+    High = Regex->SymbolCount - 1;
+    while (Low < High) {
+        Mid = (Low + High + 1) / 2;
+        if (Regex->SymbolStart[Mid] <= Char) {
+            Low = Mid;
+        } else {
+            High = Mid - 1;
+        }
+    }
+
+    return Low;
+}
+
+/**
+ Check whether a class contains a code unit.
+
+ @param Regex The compiled set of expressions.
+
+ @param ClassIndex The index of the class.
+
+ @param Char The code unit.
+
+ @return TRUE if the class contains the code unit, FALSE if it does not.
+ */
+BOOL
+YoriLibRegexClassContains(
+    __in PYORILIB_REGEX Regex,
+    __in DWORD ClassIndex,
+    __in WCHAR Char
+    )
+{
+    PYORILIB_REGEX_RANGE Ranges;
+    DWORD Low;
+    DWORD High;
+    DWORD Mid;
+
+    Ranges = &Regex->Ranges[Regex->Classes[ClassIndex].FirstRange];
+    Low = 0;
+    High = Regex->Classes[ClassIndex].RangeCount;
+    while (Low < High) {
+        Mid = (Low + High) / 2;
+        if (Char < Ranges[Mid].Low) {
+            High = Mid;
+        } else if (Char > Ranges[Mid].High) {
+            Low = Mid + 1;
+        } else {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Add a state, and every state reachable from it without consuming input, to
+ a state set.
+
+ @param Regex The compiled set of expressions.
+
+ @param Set The state set to add to.
+
+ @param StateIndex The state to add.
+
+ @param ClosureFlags Indicates which assertions are satisfied at this point
+        in the input, being a combination of YORILIB_REGEX_CLOSURE_ values.
+ */
+VOID
+YoriLibRegexAddClosure(
+    __in PYORILIB_REGEX Regex,
+    __inout PYORILIB_REGEX_STATE_SET Set,
+    __in DWORD StateIndex,
+    __in DWORD ClosureFlags
+    )
+{
+    PYORILIB_REGEX_NFA_STATE State;
+    PDWORD Stack;
+    DWORD Depth;
+    DWORD Next[2];
+    DWORD NextCount;
+    DWORD Index;
+    DWORD Candidate;
+
+    Stack = Regex->Stack;
+    Depth = 0;
+    Next[0] = StateIndex;
+    NextCount = 1;
+
+    while (TRUE) {
+
+        //
+        //  Each state is marked as present when it is pushed, so each state
+        //  is pushed at most once and the stack cannot overflow.
+        //
+
+        for (Index = 0; Index < NextCount; Index++) {
+            Candidate = Next[Index];
+            if (Candidate == YORILIB_REGEX_NONE) {
+                continue;
+            }
+            if (Set->Sparse[Candidate] < Set->Count &&
+                Set->Dense[Set->Sparse[Candidate]] == Candidate) {
+                continue;
+            }
+            Set->Sparse[Candidate] = Set->Count;
+            Set->Dense[Set->Count] = Candidate;
+            Set->Count++;
+            Stack[Depth] = Candidate;
+            Depth++;
+        }
+
+        if (Depth == 0) {
+            break;
+        }
+
+        Depth--;
+        State = &Regex->States[Stack[Depth]];
+        NextCount = 0;
+        switch(State->Type) {
+            case YORILIB_REGEX_NFA_SPLIT:
+                Next[NextCount++] = State->Out1;
+                // Fall through
+            case YORILIB_REGEX_NFA_EPSILON:
+                Next[NextCount++] = State->Out;
+                break;
+            case YORILIB_REGEX_NFA_LINE_START:
+                if (ClosureFlags & YORILIB_REGEX_CLOSURE_LINE_START) {
+                    Next[NextCount++] = State->Out;
+                }
+                break;
+            case YORILIB_REGEX_NFA_LINE_END:
+                if (ClosureFlags & YORILIB_REGEX_CLOSURE_LINE_END) {
+                    Next[NextCount++] = State->Out;
+                }
+                break;
+        }
+    }
+}
+
+/**
+ Compute the set of states that follow a set of states after consuming one
+ symbol.  Since matches can begin anywhere in the input, the states in the
+ closure of the start state are always active, so transitions from them are
+ always followed, but they are not added to the resulting set.
+
+ @param Regex The compiled set of expressions.
+
+ @param From Pointer to an array of states before the symbol is consumed.
+
+ @param FromCount The number of elements in the From array.
+
+ @param Symbol The symbol being consumed.
+
+ @param To The state set to populate with the states after the symbol is
+        consumed.
+ */
+VOID
+YoriLibRegexStep(
+    __in PYORILIB_REGEX Regex,
+    __in PDWORD From,
+    __in DWORD FromCount,
+    __in DWORD Symbol,
+    __out PYORILIB_REGEX_STATE_SET To
+    )
+{
+    PYORILIB_REGEX_NFA_STATE State;
+    WCHAR Char;
+    DWORD Index;
+
+    Char = Regex->SymbolStart[Symbol];
+    To->Count = 0;
+    for (Index = 0; Index < FromCount; Index++) {
+        State = &Regex->States[From[Index]];
+        if (State->Type == YORILIB_REGEX_NFA_CLASS &&
+            YoriLibRegexClassContains(Regex, State->Value, Char)) {
+
+            YoriLibRegexAddClosure(Regex, To, State->Out, 0);
+        }
+    }
+
+    for (Index = 0; Index < Regex->StartStateCount; Index++) {
+        State = &Regex->States[Regex->StartStates[Index]];
+        if (State->Type == YORILIB_REGEX_NFA_CLASS &&
+            YoriLibRegexClassContains(Regex, State->Value, Char)) {
+
+            YoriLibRegexAddClosure(Regex, To, State->Out, 0);
+        }
+    }
+}
+
+/**
+ Find the lowest index of any pattern that has matched within a set of
+ states.  This does not include states in the closure of the start state.
+
+ @param Regex The compiled set of expressions.
+
+ @param States Pointer to an array of states.
+
+ @param StateCount The number of elements in the States array.
+
+ @return The lowest index of any matching pattern, or YORILIB_REGEX_NONE if
+         no pattern has matched.
+ */
+DWORD
+YoriLibRegexFindMatch(
+    __in PYORILIB_REGEX Regex,
+    __in PDWORD States,
+    __in DWORD StateCount
+    )
+{
+    PYORILIB_REGEX_NFA_STATE State;
+    DWORD Match;
+    DWORD Index;
+
+    Match = YORILIB_REGEX_NONE;
+    for (Index = 0; Index < StateCount; Index++) {
+        State = &Regex->States[States[Index]];
+        if (State->Type == YORILIB_REGEX_NFA_MATCH && State->Value < Match) {
+            Match = State->Value;
+        }
+    }
+
+    return Match;
+}
+
+/**
+ Find the lowest index of any pattern that would match if the input ended
+ with a set of states active.  This is any pattern that has already matched
+ plus any pattern which can match by satisfying end of input assertions.
+ This does not include states in the closure of the start state.
+
+ @param Regex The compiled set of expressions.
+
+ @param States Pointer to an array of states.
+
+ @param StateCount The number of elements in the States array.
+
+ @return The lowest index of any matching pattern, or YORILIB_REGEX_NONE if
+         no pattern would match.
+ */
+DWORD
+YoriLibRegexFindEndMatch(
+    __in PYORILIB_REGEX Regex,
+    __in PDWORD States,
+    __in DWORD StateCount
+    )
+{
+    DWORD Match;
+    DWORD EndMatch;
+    DWORD Index;
+
+    Match = YoriLibRegexFindMatch(Regex, States, StateCount);
+
+    Regex->EndSet.Count = 0;
+    for (Index = 0; Index < StateCount; Index++) {
+        if (Regex->States[States[Index]].Type == YORILIB_REGEX_NFA_LINE_END) {
+            YoriLibRegexAddClosure(Regex, &Regex->EndSet, States[Index], YORILIB_REGEX_CLOSURE_LINE_END);
+        }
+    }
+
+    EndMatch = YoriLibRegexFindMatch(Regex, Regex->EndSet.Dense, Regex->EndSet.Count);
+    if (EndMatch < Match) {
+        Match = EndMatch;
+    }
+
+    return Match;
+}
+
+/**
+ Discard every cached DFA state.  This is done when the cache reaches its
+ size limit, after which states are constructed again as they are needed.
+
+ @param Regex The compiled set of expressions.
+ */
+VOID
+YoriLibRegexFlushDfa(
+    __in PYORILIB_REGEX Regex
+    )
+{
+    PYORILIB_REGEX_DFA_STATE DfaState;
+    PYORILIB_REGEX_DFA_STATE NextDfaState;
+
+    DfaState = Regex->AllStates;
+    while (DfaState != NULL) {
+        NextDfaState = DfaState->AllNext;
+        YoriLibDereference(DfaState->Region);
+        DfaState = NextDfaState;
+    }
+
+    YoriLibArenaCleanup(&Regex->Arena);
+    ZeroMemory(Regex->Buckets, sizeof(Regex->Buckets));
+    Regex->AllStates = NULL;
+    Regex->InitialState = NULL;
+    Regex->DfaBytes = 0;
+    Regex->DfaStateCount = 0;
+    Regex->CharsSinceFlush = 0;
+}
+
+/**
+ Return TRUE if an NFA state consumes input, matches, or tests for the end
+ of input.  States which only move to other states without consuming input
+ are fully described by the states they lead to.
+ */
+#define YORILIB_REGEX_STATE_SIGNIFICANT(Regex, StateIndex) \
+    ((Regex)->States[StateIndex].Type == YORILIB_REGEX_NFA_CLASS || \
+     (Regex)->States[StateIndex].Type == YORILIB_REGEX_NFA_LINE_END || \
+     (Regex)->States[StateIndex].Type == YORILIB_REGEX_NFA_MATCH)
+
+/**
+ Return TRUE if an NFA state needs to be recorded as part of a DFA state.
+ This excludes states in the closure of the start state, which are part of
+ every DFA state.
+ */
+#define YORILIB_REGEX_STATE_RECORDED(Regex, StateIndex) \
+    (YORILIB_REGEX_STATE_SIGNIFICANT(Regex, StateIndex) && \
+     !(Regex)->States[StateIndex].InStartClosure)
+
+/**
+ Find the DFA state corresponding to a set of NFA states, constructing it if
+ it has not been seen before.
+
+ @param Regex The compiled set of expressions.
+
+ @param Set The set of NFA states.
+
+ @return Pointer to the DFA state, or NULL if the cache is full or memory
+         could not be allocated.
+ */
+PYORILIB_REGEX_DFA_STATE
+YoriLibRegexFindDfaState(
+    __in PYORILIB_REGEX Regex,
+    __in PYORILIB_REGEX_STATE_SET Set
+    )
+{
+    PYORILIB_REGEX_DFA_STATE DfaState;
+    PVOID Region;
+    DWORD Hash;
+    DWORD Count;
+    DWORD Index;
+    DWORD StateIndex;
+    DWORD Bytes;
+
+    Hash = 0;
+    Count = 0;
+    for (Index = 0; Index < Set->Count; Index++) {
+        StateIndex = Set->Dense[Index];
+        if (YORILIB_REGEX_STATE_RECORDED(Regex, StateIndex)) {
+
+            //
+            //  The set is in no particular order, so combine the states
+            //  with an operation that doesn't depend on order.
+            //
+
+            Hash += (StateIndex + 1) * 0x9E3779B1;
+            Count++;
+        }
+    }
+
+    DfaState = Regex->Buckets[Hash & (YORILIB_REGEX_DFA_BUCKETS - 1)];
+    while (DfaState != NULL) {
+        if (DfaState->Hash == Hash && DfaState->NfaCount == Count) {
+            for (Index = 0; Index < Count; Index++) {
+                StateIndex = DfaState->NfaStates[Index];
+                if (Set->Sparse[StateIndex] >= Set->Count ||
+                    Set->Dense[Set->Sparse[StateIndex]] != StateIndex) {
+                    break;
+                }
+            }
+            if (Index == Count) {
+                return DfaState;
+            }
+        }
+        DfaState = DfaState->HashNext;
+    }
+
+    Bytes = sizeof(YORILIB_REGEX_DFA_STATE) +
+            Regex->SymbolCount * sizeof(PYORILIB_REGEX_DFA_STATE) +
+            Count * sizeof(DWORD);
+
+    if (Regex->DfaBytes + Bytes > YORILIB_REGEX_DFA_CACHE_SIZE) {
+        return NULL;
+    }
+
+    DfaState = YoriLibArenaReferencedMalloc(&Regex->Arena, Bytes, &Region);
+    if (DfaState == NULL) {
+        return NULL;
+    }
+    Regex->DfaBytes += Bytes;
+    Regex->DfaStateCount++;
+
+    DfaState->Region = Region;
+    DfaState->Next = (PYORILIB_REGEX_DFA_STATE *)(DfaState + 1);
+    DfaState->NfaStates = (PDWORD)(DfaState->Next + Regex->SymbolCount);
+    ZeroMemory(DfaState->Next, Regex->SymbolCount * sizeof(PYORILIB_REGEX_DFA_STATE));
+
+    Count = 0;
+    for (Index = 0; Index < Set->Count; Index++) {
+        StateIndex = Set->Dense[Index];
+        if (YORILIB_REGEX_STATE_RECORDED(Regex, StateIndex)) {
+            DfaState->NfaStates[Count] = StateIndex;
+            Count++;
+        }
+    }
+
+    DfaState->NfaCount = Count;
+    DfaState->Hash = Hash;
+    DfaState->Match = YoriLibRegexFindMatch(Regex, DfaState->NfaStates, Count);
+    if (Regex->StartMatch < DfaState->Match) {
+        DfaState->Match = Regex->StartMatch;
+    }
+    DfaState->EndMatch = YoriLibRegexFindEndMatch(Regex, DfaState->NfaStates, Count);
+    if (Regex->StartEndMatch < DfaState->EndMatch) {
+        DfaState->EndMatch = Regex->StartEndMatch;
+    }
+
+    DfaState->HashNext = Regex->Buckets[Hash & (YORILIB_REGEX_DFA_BUCKETS - 1)];
+    Regex->Buckets[Hash & (YORILIB_REGEX_DFA_BUCKETS - 1)] = DfaState;
+    DfaState->AllNext = Regex->AllStates;
+    Regex->AllStates = DfaState;
+
+    return DfaState;
+}
+
+/**
+ Find the DFA state corresponding to a set of NFA states, discarding the
+ cache if it is full.  The cache is only discarded if it has been used
+ enough to justify rebuilding it; input which generates states faster than
+ that is better served by simulating the NFA directly.
+
+ @param Regex The compiled set of expressions.
+
+ @param Set The set of NFA states.
+
+ @param CharsProcessed The number of code units processed in the current
+        string which are not yet included in the count of code units
+        processed since the cache was discarded.
+
+ @param Flushed On completion, set to TRUE if the cache was discarded.
+
+ @return Pointer to the DFA state, or NULL if the caller should continue by
+         simulating the NFA from Set.
+ */
+PYORILIB_REGEX_DFA_STATE
+YoriLibRegexFindDfaStateOrFlush(
+    __in PYORILIB_REGEX Regex,
+    __in PYORILIB_REGEX_STATE_SET Set,
+    __in DWORD CharsProcessed,
+    __out PBOOL Flushed
+    )
+{
+    PYORILIB_REGEX_DFA_STATE DfaState;
+
+    *Flushed = FALSE;
+    DfaState = YoriLibRegexFindDfaState(Regex, Set);
+    if (DfaState != NULL) {
+        return DfaState;
+    }
+
+    if (Regex->CharsSinceFlush + CharsProcessed < Regex->DfaStateCount * YORILIB_REGEX_MIN_CHARS_PER_STATE) {
+        return NULL;
+    }
+
+    YoriLibRegexFlushDfa(Regex);
+    *Flushed = TRUE;
+    return YoriLibRegexFindDfaState(Regex, Set);
+}
+
+/**
+ Continue matching a string by simulating the NFA directly.  This is used
+ when the DFA cannot be constructed, and is slower since each code unit
+ requires computing a new set of states.
+
+ @param Regex The compiled set of expressions.
+
+ @param String The string being matched.
+
+ @param Offset The offset within the string to resume matching from.  The
+        states active at this offset are in the first state set.
+
+ @param Match The lowest index of any pattern which has already matched, or
+        YORILIB_REGEX_NONE if no pattern has matched.
+
+ @return The lowest index of any pattern which matches the string, or
+         YORILIB_REGEX_NONE if no pattern matches.
+ */
+DWORD
+YoriLibRegexSimulateNfa(
+    __in PYORILIB_REGEX Regex,
+    __in PYORI_STRING String,
+    __in DWORD Offset,
+    __in DWORD Match
+    )
+{
+    PYORILIB_REGEX_STATE_SET Current;
+    PYORILIB_REGEX_STATE_SET Next;
+    PYORILIB_REGEX_STATE_SET Swap;
+    DWORD ThisMatch;
+    WCHAR Char;
+
+    Current = &Regex->Sets[0];
+    Next = &Regex->Sets[1];
+
+    if (Regex->StartMatch < Match) {
+        Match = Regex->StartMatch;
+    }
+
+    ThisMatch = YoriLibRegexFindMatch(Regex, Current->Dense, Current->Count);
+    if (ThisMatch < Match) {
+        Match = ThisMatch;
+    }
+
+    for (; Offset < String->LengthInChars && Match != 0; Offset++) {
+        Char = String->StartOfString[Offset];
+        if (Regex->Flags & YORILIB_REGEX_INSENSITIVE) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        YoriLibRegexStep(Regex, Current->Dense, Current->Count, YoriLibRegexSymbolFromChar(Regex, Char), Next);
+        Swap = Current;
+        Current = Next;
+        Next = Swap;
+
+        ThisMatch = YoriLibRegexFindMatch(Regex, Current->Dense, Current->Count);
+        if (ThisMatch < Match) {
+            Match = ThisMatch;
+        }
+    }
+
+    if (Offset == String->LengthInChars) {
+        if (Regex->StartEndMatch < Match) {
+            Match = Regex->StartEndMatch;
+        }
+        ThisMatch = YoriLibRegexFindEndMatch(Regex, Current->Dense, Current->Count);
+        if (ThisMatch < Match) {
+            Match = ThisMatch;
+        }
+    }
+
+    return Match;
+}
+
+/**
+ Compile a set of regular expressions so that a string can be tested
+ against all of them in a single pass.
+
+ The syntax supports literals, '.', bracketed classes including ranges and
+ negation, the escapes \d \w \s \D \W \S \t \n \r \f \v \xHH and \uHHHH,
+ grouping with () or (?:), alternation with '|', the quantifiers '*', '+'
+ and '?', repeat counts of the form {m}, {m,} and {m,n}, and the '^' and
+ '$' assertions, which match the beginning and end of the string.  '.' and
+ negated classes match a surrogate pair as a single character.
+
+ @param Patterns Pointer to an array of patterns to compile.
+
+ @param PatternCount The number of elements in the Patterns array.  This
+        must be at least one.
+
+ @param Flags Flags applying to every pattern, which can include
+        YORILIB_REGEX_INSENSITIVE.
+
+ @param Regex On successful completion, updated to point to the compiled set
+        of expressions.  This should be freed with @ref YoriLibRegexFree .
+
+ @param ErrorPattern On failure, optionally updated with the index of the
+        pattern that could not be compiled, or YORILIB_REGEX_NO_PATTERN if
+        the failure was not caused by a pattern.
+
+ @param ErrorOffset On failure, optionally updated with the offset within
+        the pattern where the error was detected.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRegexCompile(
+    __in PYORILIB_REGEX_PATTERN Patterns,
+    __in DWORD PatternCount,
+    __in DWORD Flags,
+    __out PYORILIB_REGEX *Regex,
+    __out_opt PDWORD ErrorPattern,
+    __out_opt PDWORD ErrorOffset
+    )
+{
+    PYORILIB_REGEX NewRegex;
+    YORILIB_REGEX_PARSER Parser;
+    YORILIB_REGEX_FRAGMENT Fragment;
+    DWORD Start;
+    DWORD Match;
+    DWORD Index;
+    DWORD SetIndex;
+
+    if (ErrorPattern != NULL) {
+        *ErrorPattern = YORILIB_REGEX_NO_PATTERN;
+    }
+    if (ErrorOffset != NULL) {
+        *ErrorOffset = 0;
+    }
+
+    if (PatternCount == 0) {
+        return FALSE;
+    }
+
+    NewRegex = YoriLibMalloc(sizeof(YORILIB_REGEX));
+    if (NewRegex == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewRegex, sizeof(YORILIB_REGEX));
+    NewRegex->Flags = Flags;
+    NewRegex->PatternCount = PatternCount;
+    YoriLibArenaInitialize(&NewRegex->Arena, YORILIB_REGEX_DFA_REGION_SIZE);
+
+    ZeroMemory(&Parser, sizeof(Parser));
+    Parser.Regex = NewRegex;
+    Parser.Bitmap = YoriLibMalloc(YORILIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+    if (Parser.Bitmap == NULL) {
+        YoriLibRegexFree(NewRegex);
+        return FALSE;
+    }
+
+    //
+    //  Compile each pattern so that it ends in a match state identifying
+    //  the pattern, and join all of the patterns into a single NFA.
+    //
+
+    Start = YORILIB_REGEX_NONE;
+    for (Index = PatternCount; Index > 0; Index--) {
+        Parser.Pattern = &Patterns[Index - 1].Pattern;
+        Parser.Offset = 0;
+        Parser.Depth = 0;
+
+        if (!YoriLibRegexCompilePattern(&Parser, Patterns[Index - 1].Flags, &Fragment)) {
+            if (NewRegex->StateCount < YORILIB_REGEX_MAX_STATES) {
+                if (ErrorPattern != NULL) {
+                    *ErrorPattern = Index - 1;
+                }
+                if (ErrorOffset != NULL) {
+                    *ErrorOffset = Parser.Offset;
+                }
+            }
+            YoriLibFree(Parser.Bitmap);
+            YoriLibRegexFree(NewRegex);
+            return FALSE;
+        }
+
+        Match = YoriLibRegexAddState(NewRegex, YORILIB_REGEX_NFA_MATCH, YORILIB_REGEX_NONE, Index - 1);
+        if (Match == YORILIB_REGEX_NONE) {
+            YoriLibFree(Parser.Bitmap);
+            YoriLibRegexFree(NewRegex);
+            return FALSE;
+        }
+        NewRegex->States[Fragment.End].Out = Match;
+
+        if (Start == YORILIB_REGEX_NONE) {
+            Start = Fragment.Start;
+        } else {
+            Match = YoriLibRegexAddState(NewRegex, YORILIB_REGEX_NFA_SPLIT, Fragment.Start, 0);
+            if (Match == YORILIB_REGEX_NONE) {
+                YoriLibFree(Parser.Bitmap);
+                YoriLibRegexFree(NewRegex);
+                return FALSE;
+            }
+            NewRegex->States[Match].Out1 = Start;
+            Start = Match;
+        }
+    }
+
+    NewRegex->StartState = Start;
+
+    if (!YoriLibRegexBuildSymbols(NewRegex, Parser.Bitmap)) {
+        YoriLibFree(Parser.Bitmap);
+        YoriLibRegexFree(NewRegex);
+        return FALSE;
+    }
+
+    YoriLibFree(Parser.Bitmap);
+
+    //
+    //  Allocate the state sets and closure stack in a single allocation.
+    //  The sparse arrays are zeroed so membership tests never read
+    //  uninitialized memory.
+    //
+
+    NewRegex->Stack = YoriLibMalloc(NewRegex->StateCount * 7 * sizeof(DWORD));
+    if (NewRegex->Stack == NULL) {
+        YoriLibRegexFree(NewRegex);
+        return FALSE;
+    }
+    ZeroMemory(NewRegex->Stack, NewRegex->StateCount * 7 * sizeof(DWORD));
+
+    for (SetIndex = 0; SetIndex < 3; SetIndex++) {
+        PYORILIB_REGEX_STATE_SET Set;
+        if (SetIndex < 2) {
+            Set = &NewRegex->Sets[SetIndex];
+        } else {
+            Set = &NewRegex->EndSet;
+        }
+        Set->Dense = NewRegex->Stack + NewRegex->StateCount * (1 + SetIndex * 2);
+        Set->Sparse = Set->Dense + NewRegex->StateCount;
+        Set->Count = 0;
+    }
+
+    //
+    //  Find the states that are active at every point in the input, since
+    //  a match can begin anywhere.
+    //
+
+    YoriLibRegexAddClosure(NewRegex, &NewRegex->Sets[0], NewRegex->StartState, 0);
+    NewRegex->StartStates = YoriLibMalloc((NewRegex->Sets[0].Count + 1) * sizeof(DWORD));
+    if (NewRegex->StartStates == NULL) {
+        YoriLibRegexFree(NewRegex);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < NewRegex->Sets[0].Count; Index++) {
+        Start = NewRegex->Sets[0].Dense[Index];
+        if (YORILIB_REGEX_STATE_SIGNIFICANT(NewRegex, Start)) {
+            NewRegex->StartStates[NewRegex->StartStateCount] = Start;
+            NewRegex->StartStateCount++;
+            NewRegex->States[Start].InStartClosure = TRUE;
+        }
+    }
+
+    NewRegex->StartMatch = YoriLibRegexFindMatch(NewRegex, NewRegex->StartStates, NewRegex->StartStateCount);
+    NewRegex->StartEndMatch = YoriLibRegexFindEndMatch(NewRegex, NewRegex->StartStates, NewRegex->StartStateCount);
+
+    *Regex = NewRegex;
+    return TRUE;
+}
+
+/**
+ Test a string against a compiled set of regular expressions.  A pattern
+ matches if it matches any part of the string; patterns can use '^' and '$'
+ to require a match at the beginning or end.  The string is processed once
+ regardless of how many patterns are in the set.
+
+ Matching is performed by a DFA which is constructed lazily and cached in
+ the compiled set, so the compiled set must not be used by more than one
+ thread at a time.
+
+ @param Regex The compiled set of expressions.
+
+ @param String The string to test.
+
+ @param PatternIndex On successful completion, optionally updated with the
+        index of the first pattern in the set which matches the string.
+
+ @return TRUE if any pattern matches the string, FALSE if none do.
+ */
+__success(return)
+BOOL
+YoriLibRegexMatch(
+    __in PYORILIB_REGEX Regex,
+    __in PYORI_STRING String,
+    __out_opt PDWORD PatternIndex
+    )
+{
+    PYORILIB_REGEX_DFA_STATE DfaState;
+    PYORILIB_REGEX_DFA_STATE NextDfaState;
+    DWORD Match;
+    DWORD Offset;
+    DWORD FlushOffset;
+    DWORD Symbol;
+    BOOL Flushed;
+    WCHAR Char;
+
+    Match = YORILIB_REGEX_NONE;
+    FlushOffset = 0;
+
+    DfaState = Regex->InitialState;
+    if (DfaState == NULL) {
+        Regex->Sets[0].Count = 0;
+        YoriLibRegexAddClosure(Regex, &Regex->Sets[0], Regex->StartState, YORILIB_REGEX_CLOSURE_LINE_START);
+        DfaState = YoriLibRegexFindDfaStateOrFlush(Regex, &Regex->Sets[0], 0, &Flushed);
+        if (DfaState == NULL) {
+            Match = YoriLibRegexSimulateNfa(Regex, String, 0, Match);
+            goto Done;
+        }
+        Regex->InitialState = DfaState;
+    }
+
+    Match = DfaState->Match;
+    for (Offset = 0; Offset < String->LengthInChars && Match != 0; Offset++) {
+        Char = String->StartOfString[Offset];
+        if (Regex->Flags & YORILIB_REGEX_INSENSITIVE) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        if (Char < sizeof(Regex->LowSymbol)/sizeof(Regex->LowSymbol[0])) {
+            Symbol = Regex->LowSymbol[Char];
+        } else {
+            Symbol = YoriLibRegexSymbolFromChar(Regex, Char);
+        }
+
+        NextDfaState = DfaState->Next[Symbol];
+        if (NextDfaState == NULL) {
+            YoriLibRegexStep(Regex, DfaState->NfaStates, DfaState->NfaCount, Symbol, &Regex->Sets[0]);
+            NextDfaState = YoriLibRegexFindDfaStateOrFlush(Regex, &Regex->Sets[0], Offset - FlushOffset, &Flushed);
+            if (NextDfaState == NULL) {
+                Match = YoriLibRegexSimulateNfa(Regex, String, Offset + 1, Match);
+                goto Done;
+            }
+
+            //
+            //  Discarding the cache frees the current state, so it can only
+            //  record this transition if the cache was not discarded.
+            //
+
+            if (Flushed) {
+                FlushOffset = Offset;
+            } else {
+                DfaState->Next[Symbol] = NextDfaState;
+            }
+        }
+
+        DfaState = NextDfaState;
+        if (DfaState->Match < Match) {
+            Match = DfaState->Match;
+        }
+    }
+
+    if (DfaState->EndMatch < Match) {
+        Match = DfaState->EndMatch;
+    }
+
+Done:
+
+    if (Regex->CharsSinceFlush + (String->LengthInChars - FlushOffset) >= Regex->CharsSinceFlush) {
+        Regex->CharsSinceFlush += String->LengthInChars - FlushOffset;
+    }
+
+    if (Match == YORILIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    if (PatternIndex != NULL) {
+        *PatternIndex = Match;
+    }
+    return TRUE;
+}
+
+/**
+ Free a compiled set of regular expressions.
+
+ @param Regex The compiled set of expressions.
+ */
+VOID
+YoriLibRegexFree(
+    __in PYORILIB_REGEX Regex
+    )
+{
+    YoriLibRegexFlushDfa(Regex);
+    if (Regex->States != NULL) {
+        YoriLibFree(Regex->States);
+    }
+    if (Regex->Classes != NULL) {
+        YoriLibFree(Regex->Classes);
+    }
+    if (Regex->Ranges != NULL) {
+        YoriLibFree(Regex->Ranges);
+    }
+    if (Regex->SymbolStart != NULL) {
+        YoriLibFree(Regex->SymbolStart);
+    }
+    if (Regex->Stack != NULL) {
+        YoriLibFree(Regex->Stack);
+    }
+    if (Regex->StartStates != NULL) {
+        YoriLibFree(Regex->StartStates);
+    }
+    YoriLibFree(Regex);
+}
+
+// vim:sw=4:ts=4:et:
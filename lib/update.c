@@ -39,7 +39,8 @@ YoriLibUpdErrorStrings[] = {
     _T("Could not read data from server"),
     _T("Data read from server is incorrect"),
     _T("Could not write data to local file"),
-    _T("Could not replace existing file with new file")
+    _T("Could not replace existing file with new file"),
+    _T("Server returned an error for the request")
 };
 
 /**
@@ -202,6 +203,206 @@ LPCSTR YoriLibMonthNames[] = {
  */
 #define UPDATE_READ_SIZE (1024 * 1024)
 
+/**
+ The maximum number of characters in a validator, being the ETag or
+ Last-Modified value recorded alongside a partially downloaded file.
+ */
+#define UPDATE_MAX_VALIDATOR (256)
+
+/**
+ The HttpQueryInfo level to return the Last-Modified header.
+ */
+#define UPDATE_HTTP_QUERY_LAST_MODIFIED (11)
+
+/**
+ The HttpQueryInfo level to return the ETag header.
+ */
+#define UPDATE_HTTP_QUERY_ETAG (54)
+
+/**
+ Returns TRUE if an HTTP status indicates a condition that may succeed if the
+ request is repeated, such as a timeout or an overloaded server.  Other
+ failures, such as an object that does not exist, will fail again.
+
+ @param Status The HTTP status code.
+
+ @return TRUE if the failure is transient, FALSE if it is not.
+ */
+BOOL
+YoriLibUpdIsHttpStatusTransient(
+    __in DWORD Status
+    )
+{
+    if (Status == 408 || Status == 429 || Status >= 500) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Read the validator recorded for partially downloaded data.
+
+ @param ValidatorPath Pointer to the file containing the validator.
+
+ @param Validator On successful completion, populated with the validator.
+        This buffer must be UPDATE_MAX_VALIDATOR characters in length.
+
+ @return TRUE if a validator was read, FALSE if none is available.
+ */
+__success(return)
+BOOL
+YoriLibUpdReadValidator(
+    __in LPTSTR ValidatorPath,
+    __out_ecount(UPDATE_MAX_VALIDATOR) LPSTR Validator
+    )
+{
+    HANDLE hFile;
+    DWORD BytesRead;
+
+    Validator[0] = '\0';
+    hFile = CreateFile(ValidatorPath,
+                       FILE_READ_DATA,
+                       FILE_SHARE_READ|FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       0,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!ReadFile(hFile, Validator, UPDATE_MAX_VALIDATOR - 1, &BytesRead, NULL)) {
+        BytesRead = 0;
+    }
+    CloseHandle(hFile);
+
+    Validator[BytesRead] = '\0';
+    if (BytesRead == 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Record the validator for partially downloaded data, or remove any existing
+ validator if the server did not supply one.
+
+ @param ValidatorPath Pointer to the file to contain the validator.
+
+ @param Validator The validator to record, which may be an empty string.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUpdWriteValidator(
+    __in LPTSTR ValidatorPath,
+    __in LPCSTR Validator
+    )
+{
+    HANDLE hFile;
+    DWORD Length;
+    DWORD BytesWritten;
+
+    Length = strlen(Validator);
+    if (Length == 0) {
+        if (!DeleteFile(ValidatorPath) && GetLastError() != ERROR_FILE_NOT_FOUND) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    hFile = CreateFile(ValidatorPath,
+                       FILE_WRITE_DATA,
+                       FILE_SHARE_READ|FILE_SHARE_DELETE,
+                       NULL,
+                       CREATE_ALWAYS,
+                       0,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!WriteFile(hFile, Validator, Length, &BytesWritten, NULL) ||
+        BytesWritten != Length) {
+
+        CloseHandle(hFile);
+        DeleteFile(ValidatorPath);
+        return FALSE;
+    }
+
+    CloseHandle(hFile);
+    return TRUE;
+}
+
+/**
+ Query the validator for an object being sent by a server.  A strong ETag is
+ preferred; if the server does not supply one, the Last-Modified time is
+ used.  Weak ETags cannot be used to resume a download and are ignored.
+
+ @param Request The WinInet handle to the request.
+
+ @param WinInetOnlySupportsAnsi TRUE if only ANSI WinInet functions can be
+        used.
+
+ @param Validator On successful completion, populated with the validator.
+        On failure, populated with an empty string.  This buffer must be
+        UPDATE_MAX_VALIDATOR characters in length.
+
+ @return TRUE if a validator was returned, FALSE if none is available.
+ */
+__success(return)
+BOOL
+YoriLibUpdQueryValidator(
+    __in PVOID Request,
+    __in BOOL WinInetOnlySupportsAnsi,
+    __out_ecount(UPDATE_MAX_VALIDATOR) LPSTR Validator
+    )
+{
+    WCHAR WideValidator[UPDATE_MAX_VALIDATOR];
+    DWORD InfoLevels[2];
+    DWORD Index;
+    DWORD BufferSize;
+    DWORD Length;
+
+    InfoLevels[0] = UPDATE_HTTP_QUERY_ETAG;
+    InfoLevels[1] = UPDATE_HTTP_QUERY_LAST_MODIFIED;
+
+    for (Index = 0; Index < sizeof(InfoLevels)/sizeof(InfoLevels[0]); Index++) {
+        if (WinInetOnlySupportsAnsi) {
+            BufferSize = UPDATE_MAX_VALIDATOR - 1;
+            if (!DllWinInet.pHttpQueryInfoA(Request, InfoLevels[Index], Validator, &BufferSize, NULL)) {
+                continue;
+            }
+            Length = BufferSize;
+        } else {
+            BufferSize = (UPDATE_MAX_VALIDATOR - 1) * sizeof(WCHAR);
+            if (!DllWinInet.pHttpQueryInfoW(Request, InfoLevels[Index], WideValidator, &BufferSize, NULL)) {
+                continue;
+            }
+            Length = WideCharToMultiByte(CP_ACP, 0, WideValidator, BufferSize / sizeof(WCHAR), Validator, UPDATE_MAX_VALIDATOR - 1, NULL, NULL);
+        }
+
+        if (Length >= UPDATE_MAX_VALIDATOR) {
+            continue;
+        }
+        Validator[Length] = '\0';
+
+        if (Length == 0 ||
+            (InfoLevels[Index] == UPDATE_HTTP_QUERY_ETAG && Validator[0] == 'W' && Validator[1] == '/')) {
+
+            continue;
+        }
+
+        return TRUE;
+    }
+
+    Validator[0] = '\0';
+    return FALSE;
+}
+
 /**
  Download a file from the internet and store it in a local location.
 
@@ -215,6 +416,15 @@ LPCSTR YoriLibMonthNames[] = {
  @param IfModifiedSince If specified, indicates a timestamp where a new
         object should only be downloaded if it is newer.
 
+ @param PartialPath If specified, the local file used to hold data as it is
+        received.  The object's ETag or Last-Modified time is recorded in a
+        file with the same name and a .validator suffix.  If this file
+        contains data from an earlier attempt, the server is asked to send
+        only the remainder provided the object is unchanged, and if this
+        attempt fails, the data received so far is retained so a later
+        attempt can resume.  If not specified, a temporary file is used and
+        deleted on failure.
+
  @return An update error code indicating success or appropriate error.
  */
 YoriLibUpdError
@@ -222,7 +432,8 @@ YoriLibUpdateBinaryFromUrl(
     __in LPTSTR Url,
     __in_opt LPTSTR TargetName,
     __in LPTSTR Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+    __in_opt PSYSTEMTIME IfModifiedSince,
+    __in_opt LPTSTR PartialPath
     )
 {
     PVOID hInternet = NULL;
@@ -232,8 +443,10 @@ YoriLibUpdateBinaryFromUrl(
     DWORD ActualBinarySize;
     TCHAR TempName[MAX_PATH];
     TCHAR TempPath[MAX_PATH];
+    LPTSTR DownloadName;
     HANDLE hTempFile = INVALID_HANDLE_VALUE;
     BOOL SuccessfullyComplete = FALSE;
+    BOOL DiscardPartial = FALSE;
     BOOL WinInetOnlySupportsAnsi = FALSE;
     DWORD dwError;
     YoriLibUpdError Return = YoriLibUpdErrorSuccess;
@@ -241,7 +454,14 @@ YoriLibUpdateBinaryFromUrl(
     LPTSTR EndOfHost;
     YORI_STRING HostHeader;
     YORI_STRING IfModifiedSinceHeader;
+    YORI_STRING RangeHeader;
     YORI_STRING CombinedHeader;
+    YORI_STRING ValidatorPath;
+    CHAR Validator[UPDATE_MAX_VALIDATOR];
+    LARGE_INTEGER ResumeOffset;
+
+    YoriLibInitEmptyString(&ValidatorPath);
+    Validator[0] = '\0';
 
     //
     //  Dynamically load WinInet.  This means we don't have to resolve
@@ -324,6 +544,51 @@ YoriLibUpdateBinaryFromUrl(
         goto Exit;
     }
 
+    //
+    //  If the caller supplied a file for partial data, open it now.  Any
+    //  data it already contains is the beginning of the object from an
+    //  earlier attempt, so only the remainder needs to be requested.
+    //
+
+    ResumeOffset.QuadPart = 0;
+    if (PartialPath != NULL) {
+        hTempFile = CreateFile(PartialPath,
+                               FILE_WRITE_DATA|FILE_READ_DATA,
+                               FILE_SHARE_READ|FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_ALWAYS,
+                               0,
+                               NULL);
+
+        if (hTempFile == INVALID_HANDLE_VALUE) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
+
+        ResumeOffset.LowPart = GetFileSize(hTempFile, (LPDWORD)&ResumeOffset.HighPart);
+        if (ResumeOffset.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+            ResumeOffset.QuadPart = 0;
+        }
+
+        //
+        //  Data can only be resumed if the server can confirm the object
+        //  hasn't changed since it was received.  Without a validator,
+        //  start again.
+        //
+
+        YoriLibYPrintf(&ValidatorPath, _T("%s.validator"), PartialPath);
+        if (ValidatorPath.StartOfString == NULL) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
+
+        if (ResumeOffset.QuadPart > 0 &&
+            !YoriLibUpdReadValidator(ValidatorPath.StartOfString, Validator)) {
+
+            ResumeOffset.QuadPart = 0;
+        }
+    }
+
     //
     //  Newer versions of Windows will add a Host: header.  Old versions send
     //  an HTTP 1.1 request without one, which Apache doesn't like.
@@ -361,15 +626,26 @@ YoriLibUpdateBinaryFromUrl(
                        IfModifiedSince->wSecond);
     }
 
+    //
+    //  If part of the object has been received already, ask for the rest.
+    //  If-Range tells the server to send the entire object instead if it
+    //  has changed since the partial data was received.
+    //
+
+    YoriLibInitEmptyString(&RangeHeader);
+    if (ResumeOffset.QuadPart > 0) {
+        YoriLibYPrintf(&RangeHeader, _T("Range: bytes=%lli-\r\nIf-Range: %hs\r\n"), ResumeOffset.QuadPart, Validator);
+    }
 
     //
-    //  Merge headers.  If we have only one or the other, this is just a
-    //  reference with no allocation.
+    //  Merge headers.  If we have only one, this is just a reference with no
+    //  allocation.
     //
 
     YoriLibInitEmptyString(&CombinedHeader);
-    if (IfModifiedSinceHeader.LengthInChars > 0 && HostHeader.LengthInChars > 0) {
-        YoriLibYPrintf(&CombinedHeader, _T("%y%y"), &HostHeader, &IfModifiedSinceHeader);
+    if (RangeHeader.LengthInChars > 0 ||
+        (IfModifiedSinceHeader.LengthInChars > 0 && HostHeader.LengthInChars > 0)) {
+        YoriLibYPrintf(&CombinedHeader, _T("%y%y%y"), &HostHeader, &IfModifiedSinceHeader, &RangeHeader);
     } else if (IfModifiedSinceHeader.LengthInChars > 0) {
         YoriLibCloneString(&CombinedHeader, &IfModifiedSinceHeader);
     } else if (HostHeader.LengthInChars > 0) {
@@ -382,6 +658,7 @@ YoriLibUpdateBinaryFromUrl(
 
     YoriLibFreeStringContents(&HostHeader);
     YoriLibFreeStringContents(&IfModifiedSinceHeader);
+    YoriLibFreeStringContents(&RangeHeader);
 
 
     //
@@ -453,38 +730,91 @@ YoriLibUpdateBinaryFromUrl(
         }
     }
 
-    if (dwError != 200) {
-        if (dwError != 304 || IfModifiedSince == NULL) {
+    if (dwError == 206 && ResumeOffset.QuadPart > 0) {
+
+        //
+        //  The server is sending the remainder of the object, so append it
+        //  to the data that was received previously.
+        //
+
+        if (SetFilePointer(hTempFile, ResumeOffset.LowPart, &ResumeOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
+
+    } else if (dwError != 200) {
+
+        //
+        //  If the server can't satisfy the range, the partial data doesn't
+        //  correspond to the object it has now.  Throw it away so the next
+        //  attempt starts from the beginning.  Other errors are only worth
+        //  retrying if they indicate a temporary condition on the server.
+        //
+
+        if (dwError == 416 && ResumeOffset.QuadPart > 0) {
+            DiscardPartial = TRUE;
+        }
+        if (dwError == 304 && IfModifiedSince != NULL) {
+            Return = YoriLibUpdErrorSuccess;
+        } else if (DiscardPartial || YoriLibUpdIsHttpStatusTransient(dwError)) {
             Return = YoriLibUpdErrorInetConnect;
+        } else {
+            Return = YoriLibUpdErrorInetStatus;
         }
         goto Exit;
-    }
 
-    //
-    //  Create a temporary file to hold the contents.
-    //
+    } else if (PartialPath != NULL) {
 
-    if (GetTempPath(sizeof(TempPath)/sizeof(TempPath[0]), TempPath) == 0) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+        //
+        //  The server is sending the entire object, either because no range
+        //  was requested or because the object has changed since the
+        //  partial data was received.  Restart from zero, and record the
+        //  validator for this version of the object so that a later attempt
+        //  can resume it.
+        //
 
-    if (GetTempFileName(TempPath, _T("UPD"), 0, TempName) == 0) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+        SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN);
+        if (!SetEndOfFile(hTempFile)) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
 
-    hTempFile = CreateFile(TempName,
-                           FILE_WRITE_DATA|FILE_READ_DATA,
-                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                           NULL,
-                           CREATE_ALWAYS,
-                           0,
-                           NULL);
+        YoriLibUpdQueryValidator(NewBinary, WinInetOnlySupportsAnsi, Validator);
+        if (!YoriLibUpdWriteValidator(ValidatorPath.StartOfString, Validator)) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
 
-    if (hTempFile == INVALID_HANDLE_VALUE) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
+    } else {
+
+        //
+        //  Create a temporary file to hold the contents.
+        //
+
+        if (GetTempPath(sizeof(TempPath)/sizeof(TempPath[0]), TempPath) == 0) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
+
+        if (GetTempFileName(TempPath, _T("UPD"), 0, TempName) == 0) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
+
+        hTempFile = CreateFile(TempName,
+                               FILE_WRITE_DATA|FILE_READ_DATA,
+                               FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                               NULL,
+                               CREATE_ALWAYS,
+                               0,
+                               NULL);
+
+        if (hTempFile == INVALID_HANDLE_VALUE) {
+            Return = YoriLibUpdErrorFileWrite;
+            goto Exit;
+        }
     }
 
     NewBinaryData = YoriLibMalloc(UPDATE_READ_SIZE);
@@ -536,6 +866,7 @@ YoriLibUpdateBinaryFromUrl(
             NewBinaryData[0] != 'M' ||
             NewBinaryData[1] != 'Z' ) {
 
+            DiscardPartial = TRUE;
             Return = YoriLibUpdErrorInetContents;
             goto Exit;
         }
@@ -548,12 +879,24 @@ YoriLibUpdateBinaryFromUrl(
     CloseHandle(hTempFile);
     YoriLibFree(NewBinaryData);
 
-    if (YoriLibUpdateBinaryFromFile(TargetName, TempName)) {
-        return YoriLibUpdErrorSuccess;
+    if (PartialPath != NULL) {
+        DownloadName = PartialPath;
+    } else {
+        DownloadName = TempName;
+    }
+
+    if (YoriLibUpdateBinaryFromFile(TargetName, DownloadName)) {
+        Return = YoriLibUpdErrorSuccess;
+        if (PartialPath != NULL) {
+            DeleteFile(ValidatorPath.StartOfString);
+        }
     } else {
-        return YoriLibUpdErrorFileReplace;
+        Return = YoriLibUpdErrorFileReplace;
     }
 
+    YoriLibFreeStringContents(&ValidatorPath);
+    return Return;
+
 Exit:
 
     if (NewBinaryData != NULL) {
@@ -562,9 +905,18 @@ Exit:
 
     if (hTempFile != INVALID_HANDLE_VALUE) {
         CloseHandle(hTempFile);
-        DeleteFile(TempName);
+        if (PartialPath == NULL) {
+            DeleteFile(TempName);
+        } else if (DiscardPartial) {
+            DeleteFile(PartialPath);
+            if (ValidatorPath.StartOfString != NULL) {
+                DeleteFile(ValidatorPath.StartOfString);
+            }
+        }
     }
 
+    YoriLibFreeStringContents(&ValidatorPath);
+
     if (NewBinary != NULL) {
         DllWinInet.pInternetCloseHandle(NewBinary);
     }
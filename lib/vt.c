@@ -258,8 +258,190 @@ YoriLibOutputTextToMultibyteNormalizeLineEnding(
 //
 
 /**
- Initialize the output stream with any header information.  For console
- output, this is pointless.
+ The number of characters of text that can be buffered before it is written
+ to the console.
+ */
+#define YORILIB_VT_CONSOLE_BUFFER_LENGTH (1024)
+
+/**
+ State for a console stream.  Rather than asking the console for its color
+ on each escape and writing each piece of text as it arrives, text is
+ buffered until the color changes, and the color is changed only before
+ text is written in a color that differs from what the console has.  This
+ means that adjacent escapes, or escapes that don't change the color, don't
+ cause any calls to the console.
+
+ Because other threads or processes may change the console color, the
+ console's color is only assumed to be known for the duration of a single
+ call to @ref YoriLibProcessVtEscapesOnOpenStream , at the end of which all
+ buffered text is written.  Only one thread can use this state at a time;
+ other threads, or streams to a different handle, write to the console
+ directly.
+ */
+typedef struct _YORILIB_VT_CONSOLE_STATE {
+
+    /**
+     The thread which is currently using this state, or zero if the state is
+     not in use.
+     */
+    LONG OwningThreadId;
+
+    /**
+     The number of streams currently open on the owning thread.
+     */
+    DWORD Depth;
+
+    /**
+     The console that the stream is writing to.
+     */
+    HANDLE hOutput;
+
+    /**
+     TRUE if ConsoleAttribute and CurrentAttribute have been populated.
+     */
+    BOOLEAN AttributeKnown;
+
+    /**
+     The color that the console is currently using.
+     */
+    WORD ConsoleAttribute;
+
+    /**
+     The color that text should be displayed in, as a result of escapes
+     received so far.
+     */
+    WORD CurrentAttribute;
+
+    /**
+     The color to display buffered text in.
+     */
+    WORD BufferAttribute;
+
+    /**
+     The number of characters in Buffer.
+     */
+    DWORD CharsInBuffer;
+
+    /**
+     Text which has not yet been written to the console.
+     */
+    TCHAR Buffer[YORILIB_VT_CONSOLE_BUFFER_LENGTH];
+} YORILIB_VT_CONSOLE_STATE, *PYORILIB_VT_CONSOLE_STATE;
+
+/**
+ The state for a console stream.
+ */
+YORILIB_VT_CONSOLE_STATE YoriLibVtConsoleState;
+
+/**
+ Return the console state if it is in use by the current thread for the
+ specified console.
+
+ @param hOutput Handle to the output console.
+
+ @return Pointer to the console state, or NULL if output to this console
+         should not be buffered.
+ */
+PYORILIB_VT_CONSOLE_STATE
+YoriLibConsoleGetState(
+    __in HANDLE hOutput
+    )
+{
+    if (YoriLibVtConsoleState.OwningThreadId == (LONG)GetCurrentThreadId() &&
+        YoriLibVtConsoleState.hOutput == hOutput) {
+
+        return &YoriLibVtConsoleState;
+    }
+    return NULL;
+}
+
+/**
+ Query the console for its current color, if it has not been queried since
+ the state was last synchronized.
+
+ @param State Pointer to the console state.
+ */
+VOID
+YoriLibConsoleLoadAttribute(
+    __inout PYORILIB_VT_CONSOLE_STATE State
+    )
+{
+    CONSOLE_SCREEN_BUFFER_INFO ConsoleInfo;
+
+    if (State->AttributeKnown) {
+        return;
+    }
+
+    ConsoleInfo.wAttributes = DEFAULT_COLOR;
+    GetConsoleScreenBufferInfo(State->hOutput, &ConsoleInfo);
+
+    if (!YoriLibVtResetColorSet) {
+        YoriLibVtResetColor = ConsoleInfo.wAttributes;
+        YoriLibVtResetColorSet = TRUE;
+    }
+
+    State->ConsoleAttribute = ConsoleInfo.wAttributes;
+    State->CurrentAttribute = ConsoleInfo.wAttributes;
+    State->AttributeKnown = TRUE;
+}
+
+/**
+ Write any buffered text to the console, changing the console color first
+ if required.
+
+ @param State Pointer to the console state.
+ */
+VOID
+YoriLibConsoleFlushBuffer(
+    __inout PYORILIB_VT_CONSOLE_STATE State
+    )
+{
+    DWORD CharsWritten;
+
+    if (State->CharsInBuffer == 0) {
+        return;
+    }
+
+    if (State->BufferAttribute != State->ConsoleAttribute) {
+        SetConsoleTextAttribute(State->hOutput, State->BufferAttribute);
+        State->ConsoleAttribute = State->BufferAttribute;
+    }
+
+    WriteConsole(State->hOutput, State->Buffer, State->CharsInBuffer, &CharsWritten, NULL);
+    State->CharsInBuffer = 0;
+}
+
+/**
+ Write any buffered text and apply any color change to the console, so that
+ the console reflects everything processed so far.  After this point the
+ console may be changed by others, so its color is queried again before it
+ is next needed.
+
+ @param State Pointer to the console state.
+ */
+VOID
+YoriLibConsoleSynchronize(
+    __inout PYORILIB_VT_CONSOLE_STATE State
+    )
+{
+    if (!State->AttributeKnown) {
+        ASSERT(State->CharsInBuffer == 0);
+        return;
+    }
+
+    YoriLibConsoleFlushBuffer(State);
+
+    if (State->CurrentAttribute != State->ConsoleAttribute) {
+        SetConsoleTextAttribute(State->hOutput, State->CurrentAttribute);
+        State->ConsoleAttribute = State->CurrentAttribute;
+    }
+
+    State->AttributeKnown = FALSE;
+}
+
+/**
+ Initialize the output stream.  For console output, if no other thread is
+ writing to the console via this module, this prepares to buffer output.
 
  @param hOutput The output stream to initialize.
 
@@ -270,14 +452,37 @@ YoriLibConsoleInitializeStream(
     HANDLE hOutput
     )
 {
-    UNREFERENCED_PARAMETER(hOutput);
-    
+    PYORILIB_VT_CONSOLE_STATE State = &YoriLibVtConsoleState;
+    LONG ThreadId;
+
+    ThreadId = (LONG)GetCurrentThreadId();
+
+    if (InterlockedCompareExchange(&State->OwningThreadId, ThreadId, 0) == 0) {
+        State->hOutput = hOutput;
+        State->AttributeKnown = FALSE;
+        State->CharsInBuffer = 0;
+        State->Depth = 1;
+    } else if (State->OwningThreadId == ThreadId) {
+
+        //
+        //  A nested stream to a different console is written directly, and
+        //  may change the console color.
+        //
+
+        State->Depth++;
+        if (State->hOutput != hOutput) {
+            YoriLibConsoleSynchronize(State);
+        }
+    }
+
     return TRUE;
 }
 
 /**
- End processing for the specified stream.  For console output, this is
- pointless.
+ End processing for the specified stream.  For console output, this writes
+ any buffered output.
+
+ @param hOutput The output stream to end.
 
  @return TRUE for success, FALSE on failure.
  */
@@ -286,13 +491,30 @@ YoriLibConsoleEndStream(
     HANDLE hOutput
     )
 {
+    PYORILIB_VT_CONSOLE_STATE State = &YoriLibVtConsoleState;
+
     UNREFERENCED_PARAMETER(hOutput);
 
+    if (State->OwningThreadId != (LONG)GetCurrentThreadId()) {
+        return TRUE;
+    }
+
+    YoriLibConsoleSynchronize(State);
+
+    ASSERT(State->Depth > 0);
+    State->Depth--;
+    if (State->Depth == 0) {
+        State->hOutput = NULL;
+        InterlockedExchange(&State->OwningThreadId, 0);
+    }
+
     return TRUE;
 }
 
 /**
- Output text between escapes to the output Console.
+ Output text between escapes to the output Console.  If the console state
+ is available, the text is buffered, and written when the color changes or
+ processing of the current string is complete.
 
  @param hOutput Handle to the output console.
 
@@ -309,11 +531,41 @@ YoriLibConsoleProcessAndOutputText(
     DWORD BufferLength
     )
 {
+    PYORILIB_VT_CONSOLE_STATE State;
     DWORD  BytesTransferred;
 
-    UNREFERENCED_PARAMETER(hOutput);
+    State = YoriLibConsoleGetState(hOutput);
+    if (State == NULL) {
+        WriteConsole(hOutput,StringBuffer,BufferLength,&BytesTransferred,NULL);
+        return TRUE;
+    }
+
+    YoriLibConsoleLoadAttribute(State);
 
-    WriteConsole(hOutput,StringBuffer,BufferLength,&BytesTransferred,NULL);
+    if (State->CharsInBuffer > 0 &&
+        (State->BufferAttribute != State->CurrentAttribute ||
+         State->CharsInBuffer + BufferLength > YORILIB_VT_CONSOLE_BUFFER_LENGTH)) {
+
+        YoriLibConsoleFlushBuffer(State);
+    }
+
+    State->BufferAttribute = State->CurrentAttribute;
+
+    //
+    //  If the text is too large to buffer, write it now.
+    //
+
+    if (BufferLength > YORILIB_VT_CONSOLE_BUFFER_LENGTH) {
+        if (State->BufferAttribute != State->ConsoleAttribute) {
+            SetConsoleTextAttribute(hOutput, State->BufferAttribute);
+            State->ConsoleAttribute = State->BufferAttribute;
+        }
+        WriteConsole(hOutput,StringBuffer,BufferLength,&BytesTransferred,NULL);
+        return TRUE;
+    }
+
+    memcpy(&State->Buffer[State->CharsInBuffer], StringBuffer, BufferLength * sizeof(TCHAR));
+    State->CharsInBuffer += BufferLength;
     return TRUE;
 }
 
@@ -485,10 +737,27 @@ YoriLibConsoleProcessAndOutputEscape(
     __in DWORD BufferLength
     )
 {
+    PYORILIB_VT_CONSOLE_STATE State;
     CONSOLE_SCREEN_BUFFER_INFO ConsoleInfo;
     YORI_STRING EscapeCode;
     WORD NewColor;
 
+    YoriLibInitEmptyString(&EscapeCode);
+    EscapeCode.StartOfString = StringBuffer;
+    EscapeCode.LengthInChars = BufferLength;
+
+    //
+    //  If the console state is available, record the new color, which is
+    //  applied before any text is written in it.
+    //
+
+    State = YoriLibConsoleGetState(hOutput);
+    if (State != NULL) {
+        YoriLibConsoleLoadAttribute(State);
+        YoriLibVtFinalColorFromSequence(State->CurrentAttribute, &EscapeCode, &State->CurrentAttribute);
+        return TRUE;
+    }
+
     ConsoleInfo.wAttributes = DEFAULT_COLOR;
     GetConsoleScreenBufferInfo(hOutput, &ConsoleInfo);
     NewColor = ConsoleInfo.wAttributes;
@@ -498,10 +767,6 @@ YoriLibConsoleProcessAndOutputEscape(
         YoriLibVtResetColorSet = TRUE;
     }
 
-    YoriLibInitEmptyString(&EscapeCode);
-    EscapeCode.StartOfString = StringBuffer;
-    EscapeCode.LengthInChars = BufferLength;
-
     if (YoriLibVtFinalColorFromSequence(NewColor, &EscapeCode, &NewColor)) {
 
         SetConsoleTextAttribute(hOutput, NewColor);
@@ -721,6 +986,7 @@ YoriLibProcessVtEscapesOnOpenStream(
     DWORD PreviouslyConsumed;
     TCHAR VtEscape[] = {27, '\0'};
     YORI_STRING SearchString;
+    PYORILIB_VT_CONSOLE_STATE State;
 
     CurrentPoint = String;
     YoriLibInitEmptyString(&SearchString);
@@ -804,6 +1070,16 @@ YoriLibProcessVtEscapesOnOpenStream(
         CurrentOffset = YoriLibCountStringNotContainingChars(&SearchString, VtEscape);
     }
 
+    //
+    //  If output to the console is being buffered, write it now, since the
+    //  caller may not end the stream for some time.
+    //
+
+    State = YoriLibConsoleGetState(hOutput);
+    if (State != NULL) {
+        YoriLibConsoleSynchronize(State);
+    }
+
     return TRUE;
 }
 
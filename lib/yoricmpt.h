@@ -93,6 +93,17 @@ typedef ULONG SIZE_T;
 #endif
 #endif
 
+#ifndef InterlockedExchangePointer
+#ifndef _WIN64
+/**
+ Atomically exchange a pointer value for compilers that don't contain it.
+ On 32 bit systems a pointer is the same size as a LONG.
+ */
+#define InterlockedExchangePointer(Target, Value) \
+    (PVOID)InterlockedExchange((PLONG)(Target), (LONG)(Value))
+#endif
+#endif
+
 #ifndef FIELD_OFFSET
 /**
  Macro to find the offset of a member of a structure if the compilation
@@ -761,8 +772,76 @@ typedef struct _YORI_SYSTEM_PROCESS_INFORMATION {
      */
     SIZE_T CommitSize;
 
+    /**
+     The largest number of bytes committed by the process at any point.
+     */
+    SIZE_T PeakCommitSize;
+
+    /**
+     Ignored in this application.
+     */
+    SIZE_T PrivatePageCount;
+
+    /**
+     The number of read operations performed by the process.  This field
+     and the I/O fields that follow it are only present on Windows 2000 and
+     above.
+     */
+    LARGE_INTEGER ReadOperationCount;
+
+    /**
+     The number of write operations performed by the process.
+     */
+    LARGE_INTEGER WriteOperationCount;
+
+    /**
+     The number of I/O operations performed by the process that are neither
+     reads nor writes.
+     */
+    LARGE_INTEGER OtherOperationCount;
+
+    /**
+     The number of bytes read by the process.
+     */
+    LARGE_INTEGER ReadTransferCount;
+
+    /**
+     The number of bytes written by the process.
+     */
+    LARGE_INTEGER WriteTransferCount;
+
+    /**
+     The number of bytes transferred by the process in operations that are
+     neither reads nor writes.
+     */
+    LARGE_INTEGER OtherTransferCount;
+
 } YORI_SYSTEM_PROCESS_INFORMATION, *PYORI_SYSTEM_PROCESS_INFORMATION;
 
+/**
+ Definition of the system interrupt information enumeration class for
+ NtQuerySystemInformation .
+ */
+#define SystemInterruptInformation (23)
+
+/**
+ Information returned about interrupt activity on each processor.  The
+ system returns one of these structures for each processor.
+ */
+typedef struct _YORI_SYSTEM_INTERRUPT_INFORMATION {
+
+    /**
+     The number of context switches performed by the processor.
+     */
+    ULONG ContextSwitches;
+
+    /**
+     Ignored in this application.
+     */
+    ULONG Reserved[5];
+
+} YORI_SYSTEM_INTERRUPT_INFORMATION, *PYORI_SYSTEM_INTERRUPT_INFORMATION;
+
 
 /**
  If not defined by the compilation environment, the product identifier for
@@ -2783,9 +2862,9 @@ typedef struct _YORI_JOB_BASIC_ACCOUNTING_INFORMATION {
     LARGE_INTEGER Unused2;
 
     /**
-     Field not needed/supported by YoriLib.
+     The total number of page faults encountered by processes in the job.
      */
-    DWORD Unused3;
+    DWORD TotalPageFaultCount;
 
     /**
      The total number of processes that have been initiated.
@@ -2804,6 +2883,24 @@ typedef struct _YORI_JOB_BASIC_ACCOUNTING_INFORMATION {
 
 } YORI_JOB_BASIC_ACCOUNTING_INFORMATION, *PYORI_JOB_BASIC_ACCOUNTING_INFORMATION;
 
+/**
+ Structure to query basic accounting information about a job along with the
+ IO performed by processes in the job.
+ */
+typedef struct _YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION {
+
+    /**
+     Basic accounting information about the job.
+     */
+    YORI_JOB_BASIC_ACCOUNTING_INFORMATION BasicInfo;
+
+    /**
+     The IO performed by all processes in the job.
+     */
+    YORI_IO_COUNTERS IoInfo;
+
+} YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION, *PYORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION;
+
 /**
  Structure to change basic information about a job.
  */
@@ -2874,6 +2971,23 @@ typedef struct _YORI_JOB_ASSOCIATE_COMPLETION_PORT {
     HANDLE Port;
 } YORI_JOB_ASSOCIATE_COMPLETION_PORT, *PYORI_JOB_ASSOCIATE_COMPLETION_PORT;
 
+#ifndef JOB_OBJECT_MSG_EXIT_PROCESS
+/**
+ A definition for the completion port message indicating a process in a job
+ has exited, if it is not defined by the current compilation environment.
+ */
+#define JOB_OBJECT_MSG_EXIT_PROCESS (7)
+#endif
+
+#ifndef JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS
+/**
+ A definition for the completion port message indicating a process in a job
+ has exited abnormally, if it is not defined by the current compilation
+ environment.
+ */
+#define JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS (8)
+#endif
+
 #ifndef HSHELL_RUDEAPPACTIVATED
 /**
  A definition for HSHELL_RUDEAPPACTIVATED if it is not defined by the current
@@ -3017,9 +3131,10 @@ typedef enum _CAB_CB_FDI_NOTIFYTYPE {
 typedef struct _CAB_CB_FDI_NOTIFICATION {
     /**
      The meaning of this field depends on the type of notification, and the
-     documentation is awful.
+     documentation is awful.  When copying a file, this is the uncompressed
+     size of the file in bytes.
      */
-    DWORD StructureSize;
+    DWORD Size;
 
     /**
      The meaning of this field depends on the type of notification, and the
@@ -3078,7 +3193,9 @@ typedef struct _CAB_CB_FDI_NOTIFICATION {
     USHORT CabinetsInSetCount;
 
     /**
-     Indicates the folder within the Cabinet.
+     Indicates the folder within the Cabinet.  Values at or above
+     @ref CAB_FDI_FOLDER_CONTINUED_FROM_PREV indicate a folder which spans
+     Cabinets.
      */
     USHORT CabinetFolderCount;
 
@@ -3088,6 +3205,58 @@ typedef struct _CAB_CB_FDI_NOTIFICATION {
     DWORD FdiError;
 } CAB_CB_FDI_NOTIFICATION, *PCAB_CB_FDI_NOTIFICATION;
 
+/**
+ A folder index indicating the file is in a folder that started in a
+ previous Cabinet.  Higher values also indicate folders spanning Cabinets.
+ */
+#define CAB_FDI_FOLDER_CONTINUED_FROM_PREV (0xFFFD)
+
+/**
+ A structure returned from FDIIsCabinet describing a Cabinet.
+ */
+typedef struct _CAB_FDI_CABINET_INFO {
+
+    /**
+     The total size of the Cabinet, in bytes.
+     */
+    LONG CabinetSize;
+
+    /**
+     The number of folders within the Cabinet.
+     */
+    USHORT FolderCount;
+
+    /**
+     The number of files within the Cabinet.
+     */
+    USHORT FileCount;
+
+    /**
+     An identifier for which set of Cabinets this Cabinet belongs to.
+     */
+    USHORT CabSetId;
+
+    /**
+     The index of this Cabinet within its set.
+     */
+    USHORT CabinetIndex;
+
+    /**
+     TRUE if the Cabinet contains reserved space.
+     */
+    BOOL HasReserve;
+
+    /**
+     TRUE if this Cabinet is continued from a previous Cabinet.
+     */
+    BOOL HasPrevious;
+
+    /**
+     TRUE if this Cabinet is continued in a subsequent Cabinet.
+     */
+    BOOL HasNext;
+} CAB_FDI_CABINET_INFO, *PCAB_FDI_CABINET_INFO;
+
 /**
  A prototype for FDICopy's notification callback.
  */
@@ -4783,6 +4952,18 @@ CREATE_HARD_LINKW(LPWSTR, LPWSTR, PVOID);
  */
 typedef CREATE_HARD_LINKW *PCREATE_HARD_LINKW;
 
+/**
+ A prototype for the CreateIoCompletionPort function.
+ */
+typedef
+HANDLE WINAPI
+CREATE_IO_COMPLETION_PORT(HANDLE, HANDLE, ULONG_PTR, DWORD);
+
+/**
+ A prototype for a pointer to the CreateIoCompletionPort function.
+ */
+typedef CREATE_IO_COMPLETION_PORT *PCREATE_IO_COMPLETION_PORT;
+
 /**
  A prototype for the CreateJobObjectW function.
  */
@@ -5083,6 +5264,30 @@ GET_PRODUCT_INFO(DWORD, DWORD, DWORD, DWORD, PDWORD);
  */
 typedef GET_PRODUCT_INFO *PGET_PRODUCT_INFO;
 
+/**
+ A prototype for the GetQueuedCompletionStatus function.
+ */
+typedef
+BOOL WINAPI
+GET_QUEUED_COMPLETION_STATUS(HANDLE, LPDWORD, PULONG_PTR, LPOVERLAPPED*, DWORD);
+
+/**
+ A prototype for a pointer to the GetQueuedCompletionStatus function.
+ */
+typedef GET_QUEUED_COMPLETION_STATUS *PGET_QUEUED_COMPLETION_STATUS;
+
+/**
+ A prototype for the GetSystemTimes function.
+ */
+typedef
+BOOL WINAPI
+GET_SYSTEM_TIMES(LPFILETIME, LPFILETIME, LPFILETIME);
+
+/**
+ A prototype for a pointer to the GetSystemTimes function.
+ */
+typedef GET_SYSTEM_TIMES *PGET_SYSTEM_TIMES;
+
 /**
  A prototype for the GetTickCount64 function.
  */
@@ -5179,6 +5384,30 @@ QUERY_INFORMATION_JOB_OBJECT(HANDLE, DWORD, PVOID, DWORD, LPDWORD);
  */
 typedef QUERY_INFORMATION_JOB_OBJECT *PQUERY_INFORMATION_JOB_OBJECT;
 
+/**
+ A prototype for the QueryProcessCycleTime function.
+ */
+typedef
+BOOL WINAPI
+QUERY_PROCESS_CYCLE_TIME(HANDLE, PDWORDLONG);
+
+/**
+ A prototype for a pointer to the QueryProcessCycleTime function.
+ */
+typedef QUERY_PROCESS_CYCLE_TIME *PQUERY_PROCESS_CYCLE_TIME;
+
+/**
+ A prototype for the ReadDirectoryChangesW function.
+ */
+typedef
+BOOL WINAPI
+READ_DIRECTORY_CHANGESW(HANDLE, LPVOID, DWORD, BOOL, DWORD, LPDWORD, LPOVERLAPPED, LPOVERLAPPED_COMPLETION_ROUTINE);
+
+/**
+ A prototype for a pointer to the ReadDirectoryChangesW function.
+ */
+typedef READ_DIRECTORY_CHANGESW *PREAD_DIRECTORY_CHANGESW;
+
 /**
  A prototype for the RegisterApplicationRestart function.
  */
@@ -5313,6 +5542,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PCREATE_HARD_LINKW pCreateHardLinkW;
 
+    /**
+     If it's available on the current system, a pointer to CreateIoCompletionPort.
+     */
+    PCREATE_IO_COMPLETION_PORT pCreateIoCompletionPort;
+
     /**
      If it's available on the current system, a pointer to CreateJobObjectW.
      */
@@ -5438,6 +5672,16 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PGET_PRODUCT_INFO pGetProductInfo;
 
+    /**
+     If it's available on the current system, a pointer to GetQueuedCompletionStatus.
+     */
+    PGET_QUEUED_COMPLETION_STATUS pGetQueuedCompletionStatus;
+
+    /**
+     If it's available on the current system, a pointer to GetSystemTimes.
+     */
+    PGET_SYSTEM_TIMES pGetSystemTimes;
+
     /**
      If it's available on the current system, a pointer to GetTickCount64.
      */
@@ -5478,6 +5722,16 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PQUERY_INFORMATION_JOB_OBJECT pQueryInformationJobObject;
 
+    /**
+     If it's available on the current system, a pointer to QueryProcessCycleTime.
+     */
+    PQUERY_PROCESS_CYCLE_TIME pQueryProcessCycleTime;
+
+    /**
+     If it's available on the current system, a pointer to ReadDirectoryChangesW.
+     */
+    PREAD_DIRECTORY_CHANGESW pReadDirectoryChangesW;
+
     /**
      If it's available on the current system, a pointer to RegisterApplicationRestart.
      */
@@ -6084,6 +6338,18 @@ CAB_FDI_DESTROY(LPVOID);
  */
 typedef CAB_FDI_DESTROY *PCAB_FDI_DESTROY;
 
+/**
+ A prototype for the FDIIsCabinet function.
+ */
+typedef
+BOOL DIAMONDAPI
+CAB_FDI_IS_CABINET(LPVOID, DWORD_PTR, PCAB_FDI_CABINET_INFO);
+
+/**
+ A prototype for a pointer to the FDIIsCabinet function.
+ */
+typedef CAB_FDI_IS_CABINET *PCAB_FDI_IS_CABINET;
+
 /**
  A prototype for the FCICreate function.
  */
@@ -6193,6 +6459,11 @@ typedef struct _YORI_CABINET_FUNCTIONS {
      If it's available on the current system, a pointer to FDIDestroy.
      */
     PCAB_FDI_DESTROY pFdiDestroy;
+
+    /**
+     If it's available on the current system, a pointer to FDIIsCabinet.
+     */
+    PCAB_FDI_IS_CABINET pFdiIsCabinet;
 } YORI_CABINET_FUNCTIONS, *PYORI_CABINET_FUNCTIONS;
 
 extern YORI_CABINET_FUNCTIONS DllCabinet;
@@ -70,6 +70,35 @@ typedef struct _YORI_STRING {
     DWORD LengthAllocated;
 } YORI_STRING, *PYORI_STRING;
 
+/**
+ A canonical, case insensitive form of a string.  Strings that differ only
+ in case are interned to the same structure, so they can be compared by
+ comparing pointers.
+ */
+typedef struct _YORI_INTERNED_STRING {
+
+    /**
+     The links of this entry within the intern table.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The upcased form of the string.  This is NULL terminated.
+     */
+    YORI_STRING String;
+
+    /**
+     A hash of the string, computed when the string was interned.
+     */
+    DWORD Hash;
+
+    /**
+     The number of references to this entry.  It is removed from the intern
+     table when this reaches zero.
+     */
+    DWORD ReferenceCount;
+} YORI_INTERNED_STRING, *PYORI_INTERNED_STRING;
+
 /**
  A structure describing an entry that is an element of a hash table.
  */
@@ -81,9 +110,10 @@ typedef struct _YORI_HASH_ENTRY {
     YORI_LIST_ENTRY ListEntry;
 
     /**
-     A string that represents the key for the object within the table.
+     The interned string that represents the key for the object within the
+     table.
      */
-    YORI_STRING Key;
+    PYORI_INTERNED_STRING Key;
 
     /**
      An opaque context block that can be used by the user of the hash
@@ -1174,6 +1204,12 @@ typedef struct _YORI_LIB_FILE_FILT_MATCH_CRITERIA {
      used to allow all compare functions to operate on two directory entries.
      */
     YORI_FILE_INFO CompareEntry;
+
+    /**
+     If the criteria is a regular expression, the compiled expression to
+     match against the file name.  In this case CompareFn is not used.
+     */
+    struct _YORILIB_REGEX *Regex;
 } YORI_LIB_FILE_FILT_MATCH_CRITERIA, *PYORI_LIB_FILE_FILT_MATCH_CRITERIA;
 
 /**
@@ -1906,6 +1942,211 @@ YoriLibGenerateWriteTime(
     __in PYORI_STRING String
     );
 
+// *** FILEPOOL.C ***
+
+/**
+ The maximum number of threads to use to process files.  Processing files is
+ generally limited by storage rather than CPU, so beyond this point more
+ threads just generate more seeks.
+ */
+#define YORI_LIB_FILE_POOL_MAX_THREADS (8)
+
+/**
+ The number of files that can be processed ahead of the file whose results
+ are being waited for, per thread.  This limits the memory used when
+ enumerating very large trees.
+ */
+#define YORI_LIB_FILE_POOL_FILES_PER_THREAD (4)
+
+/**
+ The worker index passed to the process callback when a file is processed
+ on the thread which queued it, because no worker threads are available.
+ */
+#define YORI_LIB_FILE_POOL_CALLING_THREAD ((DWORD)-1)
+
+/**
+ A single file queued to a file pool.  This is embedded within a caller's
+ structure describing the file.
+ */
+typedef struct _YORI_LIB_FILE_POOL_ITEM {
+
+    /**
+     The list of files in the order they were queued.  Files are completed
+     in this order.  This is paired with YORI_LIB_FILE_POOL::FileList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of files that have not yet been claimed by a worker thread.
+     This is paired with YORI_LIB_FILE_POOL::PendingList .
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     An event signalled once the file has been processed.
+     */
+    HANDLE CompleteEvent;
+} YORI_LIB_FILE_POOL_ITEM, *PYORI_LIB_FILE_POOL_ITEM;
+
+/**
+ A prototype for a callback function invoked before a worker thread is
+ created, allowing the caller to prepare state for that thread.  If this
+ returns FALSE, no further worker threads are created.
+ */
+typedef BOOL YORI_LIB_FILE_POOL_INITIALIZE_FN(PVOID Context, DWORD WorkerIndex);
+
+/**
+ A pointer to a callback function invoked before a worker thread is created.
+ */
+typedef YORI_LIB_FILE_POOL_INITIALIZE_FN *PYORI_LIB_FILE_POOL_INITIALIZE_FN;
+
+/**
+ A prototype for a callback function to process a single file.  This is
+ invoked on a worker thread, or on the queueing thread with a WorkerIndex of
+ YORI_LIB_FILE_POOL_CALLING_THREAD if no worker threads are available.
+ */
+typedef VOID YORI_LIB_FILE_POOL_PROCESS_FN(PVOID Context, DWORD WorkerIndex, PYORI_LIB_FILE_POOL_ITEM Item);
+
+/**
+ A pointer to a callback function to process a single file.
+ */
+typedef YORI_LIB_FILE_POOL_PROCESS_FN *PYORI_LIB_FILE_POOL_PROCESS_FN;
+
+/**
+ A prototype for a callback function invoked on the queueing thread once a
+ file has been processed, in the order files were queued.  This callback is
+ responsible for freeing the file.
+ */
+typedef VOID YORI_LIB_FILE_POOL_COMPLETE_FN(PVOID Context, PYORI_LIB_FILE_POOL_ITEM Item);
+
+/**
+ A pointer to a callback function invoked once a file has been processed.
+ */
+typedef YORI_LIB_FILE_POOL_COMPLETE_FN *PYORI_LIB_FILE_POOL_COMPLETE_FN;
+
+/**
+ State for a single worker thread within a file pool.
+ */
+typedef struct _YORI_LIB_FILE_POOL_WORKER {
+
+    /**
+     Pointer to the pool this worker belongs to.
+     */
+    struct _YORI_LIB_FILE_POOL *Pool;
+
+    /**
+     The index of this worker, which is passed to the process callback.
+     */
+    DWORD Index;
+
+    /**
+     Handle to the worker thread.
+     */
+    HANDLE Thread;
+} YORI_LIB_FILE_POOL_WORKER, *PYORI_LIB_FILE_POOL_WORKER;
+
+/**
+ A set of threads which process files concurrently while completing them
+ in the order they were queued.
+ */
+typedef struct _YORI_LIB_FILE_POOL {
+
+    /**
+     Optional callback invoked before each worker thread is created.
+     */
+    PYORI_LIB_FILE_POOL_INITIALIZE_FN InitializeFn;
+
+    /**
+     Callback invoked to process each file.
+     */
+    PYORI_LIB_FILE_POOL_PROCESS_FN ProcessFn;
+
+    /**
+     Callback invoked once each file has been processed.
+     */
+    PYORI_LIB_FILE_POOL_COMPLETE_FN CompleteFn;
+
+    /**
+     Context passed to each callback.
+     */
+    PVOID Context;
+
+    /**
+     A list of files that have been queued and not yet completed, in the
+     order they were queued.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     The number of files in FileList.
+     */
+    DWORD FilesOutstanding;
+
+    /**
+     A list of files that have not yet been claimed by a worker thread.  This
+     is protected by Mutex.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     A mutex protecting PendingList.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore which is released once for each file added to PendingList,
+     and once for each worker thread when no further files will be added.
+     */
+    HANDLE WorkAvailable;
+
+    /**
+     The number of worker threads.  If zero, files are processed on the
+     queueing thread.
+     */
+    DWORD ThreadCount;
+
+    /**
+     State for each worker thread.
+     */
+    YORI_LIB_FILE_POOL_WORKER Workers[YORI_LIB_FILE_POOL_MAX_THREADS];
+} YORI_LIB_FILE_POOL, *PYORI_LIB_FILE_POOL;
+
+VOID
+YoriLibFilePoolInitialize(
+    __out PYORI_LIB_FILE_POOL Pool,
+    __in_opt PYORI_LIB_FILE_POOL_INITIALIZE_FN InitializeFn,
+    __in PYORI_LIB_FILE_POOL_PROCESS_FN ProcessFn,
+    __in PYORI_LIB_FILE_POOL_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    );
+
+VOID
+YoriLibFilePoolStartWorkers(
+    __inout PYORI_LIB_FILE_POOL Pool
+    );
+
+__success(return)
+BOOL
+YoriLibFilePoolInitializeItem(
+    __out PYORI_LIB_FILE_POOL_ITEM Item
+    );
+
+VOID
+YoriLibFilePoolCleanupItem(
+    __inout PYORI_LIB_FILE_POOL_ITEM Item
+    );
+
+VOID
+YoriLibFilePoolQueueItem(
+    __inout PYORI_LIB_FILE_POOL Pool,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    );
+
+VOID
+YoriLibFilePoolStopWorkers(
+    __inout PYORI_LIB_FILE_POOL Pool
+    );
+
 // *** FULLPATH.C ***
 
 /**
@@ -2055,6 +2296,35 @@ YoriLibGetDiskFreeSpace(
     __out_opt PLARGE_INTEGER FreeBytes
     );
 
+// *** GLOBSET.C ***
+
+/**
+ A compiled set of wildcard patterns.  The contents are private to the
+ glob set implementation.
+ */
+typedef struct _YORILIB_GLOB_SET YORILIB_GLOB_SET, *PYORILIB_GLOB_SET;
+
+__success(return)
+BOOL
+YoriLibGlobSetCompile(
+    __in PYORI_STRING Patterns,
+    __in DWORD PatternCount,
+    __out PYORILIB_GLOB_SET *GlobSet
+    );
+
+__success(return)
+BOOL
+YoriLibGlobSetMatch(
+    __in PYORILIB_GLOB_SET GlobSet,
+    __in PYORI_STRING String,
+    __out_opt PDWORD PatternIndex
+    );
+
+VOID
+YoriLibGlobSetFree(
+    __in PYORILIB_GLOB_SET GlobSet
+    );
+
 // *** GROUP.C ***
 
 __success(return)
@@ -2076,7 +2346,8 @@ YoriLibFreeEmptyHashTable(
     __in PYORI_HASH_TABLE HashTable
     );
 
-VOID
+__success(return)
+BOOL
 YoriLibHashInsertByKey(
     __in PYORI_HASH_TABLE HashTable,
     __in PYORI_STRING KeyString,
@@ -2212,6 +2483,126 @@ YoriLibMultibyteInput(
     __in DWORD OutputBufferLength
     );
 
+// *** INSTREAM.C ***
+
+/**
+ A function invoked the first time data is read from an in process stream.
+ This should cause the producer to stop writing data into the pipe which is
+ the stream's handle, and close it once any write in progress has completed.
+ */
+typedef VOID YORI_LIB_INPROC_STREAM_CLAIM_FN(PVOID Context);
+
+/**
+ Pointer to a function invoked the first time data is read from an in
+ process stream.
+ */
+typedef YORI_LIB_INPROC_STREAM_CLAIM_FN *PYORI_LIB_INPROC_STREAM_CLAIM_FN;
+
+/**
+ A function invoked once all data written into the pipe by the producer has
+ been read.  This returns the buffer containing the entire stream, the
+ offset of the first byte that was not written into the pipe, and the total
+ number of bytes in the stream.
+ */
+typedef BOOL YORI_LIB_INPROC_STREAM_GET_BUFFER_FN(PVOID Context, PUCHAR * Buffer, PDWORD BytesConsumed, PDWORD BytesTotal);
+
+/**
+ Pointer to a function which returns the buffer containing an in process
+ stream.
+ */
+typedef YORI_LIB_INPROC_STREAM_GET_BUFFER_FN *PYORI_LIB_INPROC_STREAM_GET_BUFFER_FN;
+
+/**
+ A stream whose contents are already in the memory of this process.  The
+ stream is also readable as a pipe via Handle, so code that uses ReadFile
+ directly continues to work, but code that uses @ref YoriLibReadStream
+ copies the data from memory without further calls to the operating system.
+ */
+typedef struct _YORI_LIB_INPROC_STREAM {
+
+    /**
+     The handle that the stream is attached to.
+     */
+    HANDLE Handle;
+
+    /**
+     Context to pass to ClaimFn and GetBufferFn.
+     */
+    PVOID Context;
+
+    /**
+     The function to invoke on the first read from the stream.
+     */
+    PYORI_LIB_INPROC_STREAM_CLAIM_FN ClaimFn;
+
+    /**
+     The function to invoke once the pipe has been drained.
+     */
+    PYORI_LIB_INPROC_STREAM_GET_BUFFER_FN GetBufferFn;
+
+    /**
+     TRUE once ClaimFn has been invoked.
+     */
+    BOOL Claimed;
+
+    /**
+     Pointer to the stream contents, or NULL if the pipe has not yet been
+     drained.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset within Buffer of the next byte to return.
+     */
+    DWORD BytesConsumed;
+
+    /**
+     The number of bytes in Buffer.
+     */
+    DWORD BytesTotal;
+} YORI_LIB_INPROC_STREAM, *PYORI_LIB_INPROC_STREAM;
+
+PYORI_LIB_INPROC_STREAM
+YoriLibSetInProcStream(
+    __in_opt PYORI_LIB_INPROC_STREAM Stream
+    );
+
+PYORI_LIB_INPROC_STREAM
+YoriLibGetInProcStream(
+    __in HANDLE FileHandle
+    );
+
+__success(return)
+BOOL
+YoriLibReadStream(
+    __in HANDLE FileHandle,
+    __out_bcount(BytesToRead) PVOID Buffer,
+    __in DWORD BytesToRead,
+    __out PDWORD BytesRead
+    );
+
+// *** INTERN.C ***
+
+DWORD
+YoriLibInternHashString(
+    __in PYORI_STRING String
+    );
+
+PYORI_INTERNED_STRING
+YoriLibInternString(
+    __in PYORI_STRING String
+    );
+
+VOID
+YoriLibReferenceInternedString(
+    __in PYORI_INTERNED_STRING Interned
+    );
+
+VOID
+YoriLibDereferenceInternedString(
+    __in PYORI_INTERNED_STRING Interned
+    );
+
 // *** JOBOBJ.C ***
 
 HANDLE
@@ -2230,6 +2621,13 @@ YoriLibLimitJobObjectPriority(
     __in DWORD Priority
     );
 
+BOOL
+YoriLibAssociateJobObjectWithCompletionPort(
+    __in HANDLE hJob,
+    __in HANDLE hPort,
+    __in_opt PVOID Key
+    );
+
 // *** LICENSE.C ***
 
 BOOL
@@ -2268,6 +2666,46 @@ YoriLibLineReadClose(
     __in_opt PVOID Context
     );
 
+DWORD
+YoriLibBytesInBom(
+    __in PCHAR StringToCheck,
+    __in DWORD BytesInString
+    );
+
+/**
+ Counts describing the contents of a stream.
+ */
+typedef struct _YORILIB_STREAM_COUNTS {
+
+    /**
+     The number of lines in the stream.
+     */
+    LONGLONG Lines;
+
+    /**
+     The number of whitespace delimited words in the stream.
+     */
+    LONGLONG Words;
+
+    /**
+     The number of characters in the stream.
+     */
+    LONGLONG Chars;
+
+    /**
+     The number of bytes in the stream.
+     */
+    LONGLONG Bytes;
+} YORILIB_STREAM_COUNTS, *PYORILIB_STREAM_COUNTS;
+
+__success(return)
+BOOL
+YoriLibCountStreamContents(
+    __in HANDLE FileHandle,
+    __in BOOL CountWordsAndChars,
+    __out PYORILIB_STREAM_COUNTS Counts
+    );
+
 // *** LIST.C ***
 
 VOID
@@ -2364,6 +2802,11 @@ YoriLibFree(
 VOID
 YoriLibDisplayMemoryUsage();
 
+__success(return)
+BOOL
+YoriLibGetAllocationCount(
+    __out PDWORD AllocationCount
+    );
 
 VOID
 YoriLibReference(
@@ -2375,6 +2818,65 @@ YoriLibDereference(
     __in PVOID Allocation
     );
 
+/**
+ An arena which satisfies many small allocations from a small number of
+ reference counted regions.
+ */
+typedef struct _YORILIB_ARENA {
+
+    /**
+     The region that allocations are currently being carved from, or NULL
+     if no region has been allocated yet.  The arena holds a reference on
+     this region.
+     */
+    PVOID CurrentRegion;
+
+    /**
+     The number of bytes in each region.
+     */
+    DWORD RegionSize;
+
+    /**
+     The number of bytes of the current region which have been allocated.
+     */
+    DWORD BytesUsed;
+} YORILIB_ARENA, *PYORILIB_ARENA;
+
+VOID
+YoriLibArenaInitialize(
+    __out PYORILIB_ARENA Arena,
+    __in DWORD RegionSize
+    );
+
+VOID
+YoriLibArenaCleanup(
+    __inout PYORILIB_ARENA Arena
+    );
+
+#if YORI_SPECIAL_HEAP
+
+PVOID
+YoriLibArenaReferencedMallocSpecialHeap(
+    __inout PYORILIB_ARENA Arena,
+    __in DWORD Bytes,
+    __out PVOID *Region,
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    );
+
+#define YoriLibArenaReferencedMalloc(Arena, Bytes, Region) \
+    YoriLibArenaReferencedMallocSpecialHeap(Arena, Bytes, Region, __FUNCTION__, __FILE__, __LINE__)
+
+#else
+PVOID
+YoriLibArenaReferencedMalloc(
+    __inout PYORILIB_ARENA Arena,
+    __in DWORD Bytes,
+    __out PVOID *Region
+    );
+#endif
+
 // *** MOVEFILE.C ***
 
 BOOLEAN
@@ -2404,6 +2906,17 @@ YoriLibDoesProcessHave32BitPeb(
     __in HANDLE ProcessHandle
     );
 
+// *** PIPEPUMP.C ***
+
+__success(return)
+BOOL
+YoriLibPipePump(
+    __in HANDLE hSource,
+    __in DWORD TargetCount,
+    __in_ecount(TargetCount) PHANDLE Targets,
+    __out_opt PDWORDLONG BytesCopied
+    );
+
 // *** PRIV.C ***
 
 BOOL
@@ -2416,6 +2929,82 @@ YoriLibRecycleBinFile(
     __in PYORI_STRING FilePath
     );
 
+// *** REGEX.C ***
+
+/**
+ Match every pattern in the set without regard to case.
+ */
+#define YORILIB_REGEX_INSENSITIVE           0x00000001
+
+/**
+ Treat the pattern as a literal string rather than a regular expression.
+ */
+#define YORILIB_REGEX_PATTERN_LITERAL       0x00000001
+
+/**
+ Only match the pattern at the beginning of the string, as if it started
+ with '^'.
+ */
+#define YORILIB_REGEX_PATTERN_ANCHOR_START  0x00000002
+
+/**
+ Only match the pattern at the end of the string, as if it ended with '$'.
+ */
+#define YORILIB_REGEX_PATTERN_ANCHOR_END    0x00000004
+
+/**
+ A value returned as the failing pattern index when compilation fails for a
+ reason other than an invalid pattern, such as allocation failure.
+ */
+#define YORILIB_REGEX_NO_PATTERN            ((DWORD)-1)
+
+/**
+ A single pattern to compile as part of a set of regular expressions.
+ */
+typedef struct _YORILIB_REGEX_PATTERN {
+
+    /**
+     The text of the pattern.
+     */
+    YORI_STRING Pattern;
+
+    /**
+     Flags for this pattern, being a combination of YORILIB_REGEX_PATTERN_
+     values.
+     */
+    DWORD Flags;
+} YORILIB_REGEX_PATTERN, *PYORILIB_REGEX_PATTERN;
+
+/**
+ A compiled set of regular expressions.  The contents are private to the
+ regular expression engine.
+ */
+typedef struct _YORILIB_REGEX YORILIB_REGEX, *PYORILIB_REGEX;
+
+__success(return)
+BOOL
+YoriLibRegexCompile(
+    __in PYORILIB_REGEX_PATTERN Patterns,
+    __in DWORD PatternCount,
+    __in DWORD Flags,
+    __out PYORILIB_REGEX *Regex,
+    __out_opt PDWORD ErrorPattern,
+    __out_opt PDWORD ErrorOffset
+    );
+
+__success(return)
+BOOL
+YoriLibRegexMatch(
+    __in PYORILIB_REGEX Regex,
+    __in PYORI_STRING String,
+    __out_opt PDWORD PatternIndex
+    );
+
+VOID
+YoriLibRegexFree(
+    __in PYORILIB_REGEX Regex
+    );
+
 // *** STRMENUM.C ***
 
 BOOL
@@ -3385,6 +3974,7 @@ typedef enum {
     YoriLibUpdErrorInetContents,
     YoriLibUpdErrorFileWrite,
     YoriLibUpdErrorFileReplace,
+    YoriLibUpdErrorInetStatus,
     YoriLibUpdErrorMax
 } YoriLibUpdError;
 
@@ -3399,7 +3989,8 @@ YoriLibUpdateBinaryFromUrl(
     __in LPTSTR Url,
     __in_opt LPTSTR TargetName,
     __in LPTSTR Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+    __in_opt PSYSTEMTIME IfModifiedSince,
+    __in_opt LPTSTR PartialPath
     );
 
 LPCTSTR
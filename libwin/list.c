@@ -46,10 +46,39 @@ typedef struct _YORI_WIN_CTRL_LIST {
     PYORI_WIN_CTRL VScrollCtrl;
 
     /**
-     The set of options to display in the list
+     The set of options to display in the list.  This is unused for a
+     virtual list, which obtains items from GetItemFn.
      */
     YORI_WIN_ITEM_ARRAY ItemArray;
 
+    /**
+     For a virtual list, a function to invoke to obtain the string for an
+     item.  NULL if the list stores its items in ItemArray.
+     */
+    PYORI_WIN_NOTIFY_LIST_GET_ITEM GetItemFn;
+
+    /**
+     Context to pass to GetItemFn.
+     */
+    PVOID GetItemContext;
+
+    /**
+     The number of items in the list.  For a list which is not virtual, this
+     matches the number of items in ItemArray.
+     */
+    DWORD ItemCount;
+
+    /**
+     On a multiselect list, a bitmap containing one bit per item indicating
+     whether the item is selected.
+     */
+    PDWORD SelectedBitmap;
+
+    /**
+     The number of items that SelectedBitmap has space to describe.
+     */
+    DWORD SelectedBitmapCapacity;
+
     /**
      The index within ItemArray of the first array element to display in the
      list
@@ -75,6 +104,189 @@ typedef struct _YORI_WIN_CTRL_LIST {
 
 } YORI_WIN_CTRL_LIST, *PYORI_WIN_CTRL_LIST;
 
+/**
+ The number of items described by each element in a selection bitmap.
+ */
+#define YORI_WIN_LIST_BITS_PER_WORD (sizeof(DWORD) * 8)
+
+/**
+ Ensure the selection bitmap for a multiselect list can describe a specified
+ number of items.
+
+ @param List Pointer to the list control.
+
+ @param ItemCount The number of items the bitmap should be able to describe.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListReserveSelection(
+    __inout PYORI_WIN_CTRL_LIST List,
+    __in DWORD ItemCount
+    )
+{
+    PDWORD NewBitmap;
+    DWORD NewCapacity;
+    DWORD OldWords;
+    DWORD NewWords;
+
+    if (!List->MultiSelect || ItemCount <= List->SelectedBitmapCapacity) {
+        return TRUE;
+    }
+
+    //
+    //  Grow geometrically so that incrementally appending items doesn't
+    //  reallocate on each append.
+    //
+
+    NewCapacity = List->SelectedBitmapCapacity * 2;
+    if (NewCapacity < ItemCount) {
+        NewCapacity = ItemCount;
+    }
+    if (NewCapacity < 4 * YORI_WIN_LIST_BITS_PER_WORD) {
+        NewCapacity = 4 * YORI_WIN_LIST_BITS_PER_WORD;
+    }
+
+    NewWords = (NewCapacity + YORI_WIN_LIST_BITS_PER_WORD - 1) / YORI_WIN_LIST_BITS_PER_WORD;
+    NewBitmap = YoriLibMalloc(NewWords * sizeof(DWORD));
+    if (NewBitmap == NULL) {
+        return FALSE;
+    }
+
+    OldWords = (List->SelectedBitmapCapacity + YORI_WIN_LIST_BITS_PER_WORD - 1) / YORI_WIN_LIST_BITS_PER_WORD;
+    if (OldWords > 0) {
+        memcpy(NewBitmap, List->SelectedBitmap, OldWords * sizeof(DWORD));
+        YoriLibFree(List->SelectedBitmap);
+    }
+    ZeroMemory(&NewBitmap[OldWords], (NewWords - OldWords) * sizeof(DWORD));
+
+    List->SelectedBitmap = NewBitmap;
+    List->SelectedBitmapCapacity = NewWords * YORI_WIN_LIST_BITS_PER_WORD;
+    return TRUE;
+}
+
+/**
+ Indicates whether an item on a multiselect list is selected.
+
+ @param List Pointer to the list control.
+
+ @param Index The index of the item.
+
+ @return TRUE if the item is selected, FALSE if it is not.
+ */
+BOOLEAN
+YoriWinListIsItemSelected(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in DWORD Index
+    )
+{
+    if (Index >= List->SelectedBitmapCapacity) {
+        return FALSE;
+    }
+
+    if (List->SelectedBitmap[Index / YORI_WIN_LIST_BITS_PER_WORD] & ((DWORD)1 << (Index % YORI_WIN_LIST_BITS_PER_WORD))) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Toggle the selection state of an item on a multiselect list.
+
+ @param List Pointer to the list control.
+
+ @param Index The index of the item.
+ */
+VOID
+YoriWinListToggleItemSelection(
+    __inout PYORI_WIN_CTRL_LIST List,
+    __in DWORD Index
+    )
+{
+    ASSERT(Index < List->SelectedBitmapCapacity);
+    if (Index < List->SelectedBitmapCapacity) {
+        List->SelectedBitmap[Index / YORI_WIN_LIST_BITS_PER_WORD] ^= ((DWORD)1 << (Index % YORI_WIN_LIST_BITS_PER_WORD));
+    }
+}
+
+/**
+ Update the number of items in the list, discarding selection state and
+ adjusting the view for any items which no longer exist.  If the number of
+ items is increasing, the caller must have reserved space in the selection
+ bitmap via @ref YoriWinListReserveSelection .
+
+ @param List Pointer to the list control.
+
+ @param ItemCount The new number of items in the list.
+ */
+VOID
+YoriWinListSetItemCount(
+    __inout PYORI_WIN_CTRL_LIST List,
+    __in DWORD ItemCount
+    )
+{
+    DWORD Index;
+
+    if (ItemCount < List->ItemCount && List->SelectedBitmap != NULL) {
+        Index = ItemCount;
+        while (Index < List->ItemCount && (Index % YORI_WIN_LIST_BITS_PER_WORD) != 0) {
+            List->SelectedBitmap[Index / YORI_WIN_LIST_BITS_PER_WORD] &= ~((DWORD)1 << (Index % YORI_WIN_LIST_BITS_PER_WORD));
+            Index++;
+        }
+        if (Index < List->ItemCount) {
+            ZeroMemory(&List->SelectedBitmap[Index / YORI_WIN_LIST_BITS_PER_WORD],
+                       (List->SelectedBitmapCapacity - Index) / YORI_WIN_LIST_BITS_PER_WORD * sizeof(DWORD));
+        }
+    }
+
+    List->ItemCount = ItemCount;
+
+    if (ItemCount == 0) {
+        List->ItemActive = FALSE;
+        List->ActiveOption = 0;
+        List->FirstDisplayedOption = 0;
+    } else {
+        if (List->ActiveOption >= ItemCount) {
+            List->ActiveOption = ItemCount - 1;
+        }
+        if (List->FirstDisplayedOption >= ItemCount) {
+            List->FirstDisplayedOption = ItemCount - 1;
+        }
+    }
+}
+
+/**
+ Obtain the string to display for an item in the list.
+
+ @param List Pointer to the list control.
+
+ @param Index The index of the item.
+
+ @param String On successful completion, populated with the string to
+        display.  This should be freed with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListGetItemString(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in DWORD Index,
+    __out PYORI_STRING String
+    )
+{
+    YoriLibInitEmptyString(String);
+    if (List->GetItemFn != NULL) {
+        return List->GetItemFn(&List->Ctrl, Index, List->GetItemContext, String);
+    }
+
+    ASSERT(Index < List->ItemArray.Count);
+    YoriLibCloneString(String, &List->ItemArray.Items[Index].String);
+    return TRUE;
+}
+
 /**
  Move the first displayed option in the list to ensure that the currently
  selected item is within the display.
@@ -96,8 +308,8 @@ YoriWinListEnsureActiveItemVisible(
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = ClientSize.Y;
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (List->ItemCount < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)List->ItemCount;
     }
 
     if (List->ActiveOption < List->FirstDisplayedOption) {
@@ -130,19 +342,26 @@ YoriWinUpdateWindowContentsFromList(
     WORD ElementCountToDisplay;
     WORD Attributes;
     WORD WindowAttributes;
-    PYORI_WIN_ITEM_ENTRY Element;
+    YORI_STRING Element;
     COORD ClientSize;
 
     WindowAttributes = List->Ctrl.DefaultAttributes;
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = ClientSize.Y;
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (List->ItemCount < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)List->ItemCount;
     }
 
+    //
+    //  Only the items which are visible are requested, so that a virtual
+    //  list need not materialize any others.
+    //
+
     for (RowIndex = 0; RowIndex < ElementCountToDisplay; RowIndex++) {
-        Element = &List->ItemArray.Items[List->FirstDisplayedOption + RowIndex];
+        if (!YoriWinListGetItemString(List, List->FirstDisplayedOption + RowIndex, &Element)) {
+            YoriLibInitEmptyString(&Element);
+        }
         Attributes = WindowAttributes;
         if (List->ItemActive &&
             RowIndex + List->FirstDisplayedOption == List->ActiveOption) {
@@ -151,17 +370,17 @@ YoriWinUpdateWindowContentsFromList(
         }
         if (List->MultiSelect) {
             CharsToDisplay = (WORD)(ClientSize.X - 2);
-            if (CharsToDisplay > Element->String.LengthInChars) {
-                CharsToDisplay = (WORD)Element->String.LengthInChars;
+            if (CharsToDisplay > Element.LengthInChars) {
+                CharsToDisplay = (WORD)Element.LengthInChars;
             }
-            if (Element->Flags & YORI_WIN_ITEM_SELECTED) {
+            if (YoriWinListIsItemSelected(List, List->FirstDisplayedOption + RowIndex)) {
                 YoriWinSetControlClientCell(&List->Ctrl, 0, RowIndex, '*', Attributes);
             } else {
                 YoriWinSetControlClientCell(&List->Ctrl, 0, RowIndex, ' ', Attributes);
             }
             YoriWinSetControlClientCell(&List->Ctrl, 1, RowIndex, ' ', Attributes);
             for (CellIndex = 0; CellIndex < CharsToDisplay; CellIndex++) {
-                YoriWinSetControlClientCell(&List->Ctrl, (WORD)(CellIndex + 2), RowIndex, Element->String.StartOfString[CellIndex], Attributes);
+                YoriWinSetControlClientCell(&List->Ctrl, (WORD)(CellIndex + 2), RowIndex, Element.StartOfString[CellIndex], Attributes);
             }
             for (;CellIndex < ClientSize.X - 2; CellIndex++) {
                 YoriWinSetControlClientCell(&List->Ctrl, (WORD)(CellIndex + 2), RowIndex, ' ', Attributes);
@@ -169,16 +388,17 @@ YoriWinUpdateWindowContentsFromList(
 
         } else {
             CharsToDisplay = ClientSize.X;
-            if (CharsToDisplay > Element->String.LengthInChars) {
-                CharsToDisplay = (WORD)Element->String.LengthInChars;
+            if (CharsToDisplay > Element.LengthInChars) {
+                CharsToDisplay = (WORD)Element.LengthInChars;
             }
             for (CellIndex = 0; CellIndex < CharsToDisplay; CellIndex++) {
-                YoriWinSetControlClientCell(&List->Ctrl, CellIndex, RowIndex, Element->String.StartOfString[CellIndex], Attributes);
+                YoriWinSetControlClientCell(&List->Ctrl, CellIndex, RowIndex, Element.StartOfString[CellIndex], Attributes);
             }
             for (;CellIndex < ClientSize.X; CellIndex++) {
                 YoriWinSetControlClientCell(&List->Ctrl, CellIndex, RowIndex, ' ', Attributes);
             }
         }
+        YoriLibFreeStringContents(&Element);
     }
 
     //
@@ -193,8 +413,8 @@ YoriWinUpdateWindowContentsFromList(
 
     if (List->VScrollCtrl) {
         DWORD MaximumTopValue;
-        if (List->ItemArray.Count > (DWORD)ClientSize.Y) {
-            MaximumTopValue = List->ItemArray.Count - ClientSize.Y;
+        if (List->ItemCount > (DWORD)ClientSize.Y) {
+            MaximumTopValue = List->ItemCount - ClientSize.Y;
         } else {
             MaximumTopValue = 0;
         }
@@ -224,9 +444,7 @@ YoriWinListClearAllItems(
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
     YoriWinItemArrayCleanup(&List->ItemArray);
-    List->FirstDisplayedOption = 0;
-    List->ActiveOption = 0;
-    List->ItemActive = FALSE;
+    YoriWinListSetItemCount(List, 0);
     YoriWinUpdateWindowContentsFromList(List);
     return TRUE;
 }
@@ -263,16 +481,16 @@ YoriWinListNotifyScrollChange(
     ElementCountToDisplay = ClientSize.Y;
 
     ScrollValue = YoriWinGetScrollBarPosition(ScrollCtrl);
-    ASSERT(ScrollValue <= List->ItemArray.Count);
-    if (ScrollValue + ElementCountToDisplay > List->ItemArray.Count) {
-        if (List->ItemArray.Count >= ElementCountToDisplay) {
-            List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+    ASSERT(ScrollValue <= List->ItemCount);
+    if (ScrollValue + ElementCountToDisplay > List->ItemCount) {
+        if (List->ItemCount >= ElementCountToDisplay) {
+            List->FirstDisplayedOption = List->ItemCount - ElementCountToDisplay;
         } else {
             List->FirstDisplayedOption = 0;
         }
     } else {
 
-        if (ScrollValue < List->ItemArray.Count) {
+        if (ScrollValue < List->ItemCount) {
             List->FirstDisplayedOption = (DWORD)ScrollValue;
         }
     }
@@ -310,9 +528,9 @@ YoriWinListNotifyMouseWheel(
             List->FirstDisplayedOption = List->FirstDisplayedOption - LinesToMove;
         }
     } else {
-        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > List->ItemArray.Count) {
-            if (List->ItemArray.Count >= ElementCountToDisplay) {
-                List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > List->ItemCount) {
+            if (List->ItemCount >= ElementCountToDisplay) {
+                List->FirstDisplayedOption = List->ItemCount - ElementCountToDisplay;
             } else {
                 List->FirstDisplayedOption = 0;
             }
@@ -357,7 +575,7 @@ YoriWinListEventHandler(
                             YoriWinListEnsureActiveItemVisible(List);
                             YoriWinUpdateWindowContentsFromList(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -365,12 +583,12 @@ YoriWinListEventHandler(
                     }
                 } else if (Event->KeyDown.VirtualKeyCode == VK_DOWN) {
                     if (List->ItemActive) {
-                        if (List->ActiveOption + 1 < List->ItemArray.Count) {
+                        if (List->ActiveOption + 1 < List->ItemCount) {
                             List->ActiveOption++;
                             YoriWinListEnsureActiveItemVisible(List);
                             YoriWinUpdateWindowContentsFromList(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -389,7 +607,7 @@ YoriWinListEventHandler(
                         } else {
                             List->ActiveOption = 0;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -402,14 +620,14 @@ YoriWinListEventHandler(
                         YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
                         ElementCountToDisplay = ClientSize.Y;
                         if (List->ActiveOption < List->FirstDisplayedOption + ElementCountToDisplay - 1 &&
-                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < List->ItemArray.Count) {
+                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < List->ItemCount) {
                             List->ActiveOption = List->FirstDisplayedOption + ElementCountToDisplay - 1;
-                        } else if (List->ActiveOption + ElementCountToDisplay < List->ItemArray.Count) {
+                        } else if (List->ActiveOption + ElementCountToDisplay < List->ItemCount) {
                             List->ActiveOption = List->ActiveOption + ElementCountToDisplay;
                         } else {
-                            List->ActiveOption = List->ItemArray.Count - 1;
+                            List->ActiveOption = List->ItemCount - 1;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -420,27 +638,22 @@ YoriWinListEventHandler(
                 if (Event->KeyDown.Char == ' ' &&
                     List->ItemActive &&
                     List->MultiSelect) {
-                    PYORI_WIN_ITEM_ENTRY Element;
 
-                    ASSERT(List->ActiveOption < List->ItemArray.Count);
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    ASSERT(List->ActiveOption < List->ItemCount);
+                    YoriWinListToggleItemSelection(List, List->ActiveOption);
                     YoriWinUpdateWindowContentsFromList(List);
                 }
             }
             break;
         case YoriWinEventMouseDownInClient:
-            if (Event->MouseDown.Location.Y + List->FirstDisplayedOption < List->ItemArray.Count) {
+            if (Event->MouseDown.Location.Y + List->FirstDisplayedOption < List->ItemCount) {
                 DWORD NewOption;
-                PYORI_WIN_ITEM_ENTRY Element;
 
                 NewOption = List->FirstDisplayedOption + Event->MouseDown.Location.Y;
 
                 List->ItemActive = TRUE;
                 if (List->ActiveOption == NewOption && List->MultiSelect) {
-
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    YoriWinListToggleItemSelection(List, List->ActiveOption);
                 } 
                 List->ActiveOption = List->FirstDisplayedOption + Event->MouseDown.Location.Y;
                 YoriWinUpdateWindowContentsFromList(List);
@@ -448,17 +661,15 @@ YoriWinListEventHandler(
 
             break;
         case YoriWinEventMouseDoubleClickInClient:
-            if (Event->MouseDown.Location.Y + List->FirstDisplayedOption < List->ItemArray.Count) {
+            if (Event->MouseDown.Location.Y + List->FirstDisplayedOption < List->ItemCount) {
                 YORI_WIN_EVENT DefaultEvent;
                 DWORD NewOption;
-                PYORI_WIN_ITEM_ENTRY Element;
 
                 NewOption = List->FirstDisplayedOption + Event->MouseDown.Location.Y;
                 List->ItemActive = TRUE;
                 List->ActiveOption = NewOption;
                 if (List->MultiSelect) {
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    YoriWinListToggleItemSelection(List, List->ActiveOption);
                 }
 
                 YoriWinUpdateWindowContentsFromList(List);
@@ -502,6 +713,10 @@ YoriWinListEventHandler(
 
         case YoriWinEventParentDestroyed:
             YoriWinItemArrayCleanup(&List->ItemArray);
+            if (List->SelectedBitmap != NULL) {
+                YoriLibFree(List->SelectedBitmap);
+                List->SelectedBitmap = NULL;
+            }
             YoriWinDestroyControl(Ctrl);
             YoriLibDereference(List);
             break;
@@ -559,7 +774,7 @@ YoriWinListSetActiveOption(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (ActiveOption < List->ItemArray.Count) {
+    if (ActiveOption < List->ItemCount) {
         List->ItemActive = TRUE;
         List->ActiveOption = ActiveOption;
         YoriWinListEnsureActiveItemVisible(List);
@@ -592,11 +807,9 @@ YoriWinListIsOptionSelected(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (Index < List->ItemArray.Count) {
+    if (Index < List->ItemCount) {
         if (List->MultiSelect) {
-            if (List->ItemArray.Items[Index].Flags & YORI_WIN_ITEM_SELECTED) {
-                return TRUE;
-            }
+            return YoriWinListIsItemSelected(List, Index);
         } else {
             if (List->ItemActive && List->ActiveOption == Index) {
                 return TRUE;
@@ -606,6 +819,49 @@ YoriWinListIsOptionSelected(
     return FALSE;
 }
 
+/**
+ Set whether the specified list index item is selected.  This is only
+ meaningful on multiselect lists.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param Index Specifies the index of the item to update.
+
+ @param Selected TRUE if the item should be selected, FALSE if it should not
+        be selected.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListSetOptionSelected(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD Index,
+    __in BOOLEAN Selected
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+    BOOLEAN CurrentlySelected;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (!List->MultiSelect || Index >= List->ItemCount) {
+        return FALSE;
+    }
+
+    CurrentlySelected = YoriWinListIsItemSelected(List, Index);
+    if ((Selected && !CurrentlySelected) ||
+        (!Selected && CurrentlySelected)) {
+
+        YoriWinListToggleItemSelection(List, Index);
+        YoriWinUpdateWindowContentsFromList(List);
+    }
+
+    return TRUE;
+}
+
 
 /**
  Adds new items to the list control.
@@ -633,10 +889,20 @@ YoriWinListAddItems(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->GetItemFn != NULL) {
+        return FALSE;
+    }
+
+    if (!YoriWinListReserveSelection(List, List->ItemCount + NumberOptions)) {
+        return FALSE;
+    }
+
     if (!YoriWinItemArrayAddItems(&List->ItemArray, ListOptions, NumberOptions)) {
         return FALSE;
     }
 
+    YoriWinListSetItemCount(List, List->ItemArray.Count);
+
     YoriWinListEnsureActiveItemVisible(List);
     YoriWinUpdateWindowContentsFromList(List);
     return TRUE;
@@ -660,14 +926,40 @@ YoriWinListAddItemArray(
 {
     PYORI_WIN_CTRL Ctrl;
     PYORI_WIN_CTRL_LIST List;
+    DWORD Index;
+    DWORD FirstNewItem;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->GetItemFn != NULL) {
+        return FALSE;
+    }
+
+    if (!YoriWinListReserveSelection(List, List->ItemCount + NewItems->Count)) {
+        return FALSE;
+    }
+
+    FirstNewItem = List->ItemArray.Count;
     if (!YoriWinItemArrayAddItemArray(&List->ItemArray, NewItems)) {
         return FALSE;
     }
 
+    YoriWinListSetItemCount(List, List->ItemArray.Count);
+
+    //
+    //  Selection state is tracked by the list, so import any selection
+    //  described by the new items.
+    //
+
+    if (List->MultiSelect) {
+        for (Index = FirstNewItem; Index < List->ItemArray.Count; Index++) {
+            if (List->ItemArray.Items[Index].Flags & YORI_WIN_ITEM_SELECTED) {
+                YoriWinListToggleItemSelection(List, Index);
+            }
+        }
+    }
+
     YoriWinListEnsureActiveItemVisible(List);
     YoriWinUpdateWindowContentsFromList(List);
     return TRUE;
@@ -675,23 +967,275 @@ YoriWinListAddItemArray(
 
 
 /**
- Create a list control and add it to a window.  This is destroyed when the
- window is destroyed.
+ Set the number of items in a virtual list control.  Items beyond the
+ previous count are assumed to be newly appended, and any items removed from
+ the end of the list lose their selection state.  Callers can specify the
+ existing count to indicate that the contents of items have changed and the
+ display should be refreshed.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param ItemCount The number of items in the list.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListSetVirtualItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD ItemCount
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->GetItemFn == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriWinListReserveSelection(List, ItemCount)) {
+        return FALSE;
+    }
+
+    YoriWinListSetItemCount(List, ItemCount);
+    YoriWinListEnsureActiveItemVisible(List);
+    YoriWinUpdateWindowContentsFromList(List);
+    return TRUE;
+}
+
+/**
+ Insert items into a virtual list control at specified positions, moving the
+ selection state and active item of existing items so they continue to
+ describe the same items.  This is linear in the number of items which move,
+ so callers inserting into a long list need not save and restore selection.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param Indexes Pointer to an array of indexes, in ascending order, that the
+        new items occupy once they have been inserted.
+
+ @param Count The number of elements in the Indexes array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListInsertVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PDWORD Indexes,
+    __in DWORD Count
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+    DWORD NewCount;
+    DWORD SrcIndex;
+    DWORD DestIndex;
+    DWORD InsertIndex;
+    DWORD NewActiveOption;
+    BOOLEAN Selected;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->GetItemFn == NULL) {
+        return FALSE;
+    }
+
+    NewCount = List->ItemCount + Count;
+    for (InsertIndex = 0; InsertIndex < Count; InsertIndex++) {
+        if (Indexes[InsertIndex] >= NewCount ||
+            (InsertIndex > 0 && Indexes[InsertIndex] <= Indexes[InsertIndex - 1])) {
+
+            return FALSE;
+        }
+    }
+
+    if (!YoriWinListReserveSelection(List, NewCount)) {
+        return FALSE;
+    }
+
+    //
+    //  Walk backwards so each existing item is read before anything is
+    //  written over it.  Once the source and destination meet, everything
+    //  before that point stays where it is.
+    //
+
+    NewActiveOption = List->ActiveOption;
+    SrcIndex = List->ItemCount;
+    DestIndex = NewCount;
+    InsertIndex = Count;
+    while (SrcIndex != DestIndex) {
+        DestIndex--;
+        if (InsertIndex > 0 && Indexes[InsertIndex - 1] == DestIndex) {
+            InsertIndex--;
+            Selected = FALSE;
+        } else {
+            SrcIndex--;
+            Selected = YoriWinListIsItemSelected(List, SrcIndex);
+            if (SrcIndex == List->ActiveOption) {
+                NewActiveOption = DestIndex;
+            }
+        }
+
+        if (List->MultiSelect &&
+            YoriWinListIsItemSelected(List, DestIndex) != Selected) {
+
+            YoriWinListToggleItemSelection(List, DestIndex);
+        }
+    }
+
+    if (List->ItemActive) {
+        List->ActiveOption = NewActiveOption;
+    }
+
+    YoriWinListSetItemCount(List, NewCount);
+    YoriWinListEnsureActiveItemVisible(List);
+    YoriWinUpdateWindowContentsFromList(List);
+    return TRUE;
+}
+
+/**
+ Remove items from a virtual list control, moving the selection state and
+ active item of the remaining items so they continue to describe the same
+ items.  If the active item is removed, the item that follows it becomes
+ active.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param Indexes Pointer to an array of indexes, in ascending order, of the
+        items to remove.
+
+ @param Count The number of elements in the Indexes array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriWinListRemoveVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PDWORD Indexes,
+    __in DWORD Count
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+    DWORD SrcIndex;
+    DWORD DestIndex;
+    DWORD RemoveIndex;
+    DWORD NewActiveOption;
+    BOOLEAN Selected;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->GetItemFn == NULL) {
+        return FALSE;
+    }
+
+    if (Count == 0) {
+        return TRUE;
+    }
+
+    for (RemoveIndex = 0; RemoveIndex < Count; RemoveIndex++) {
+        if (Indexes[RemoveIndex] >= List->ItemCount ||
+            (RemoveIndex > 0 && Indexes[RemoveIndex] <= Indexes[RemoveIndex - 1])) {
+
+            return FALSE;
+        }
+    }
+
+    //
+    //  Items before the first removed item stay where they are.  Walk
+    //  forwards from there so each remaining item is read before anything
+    //  is written over it.
+    //
+
+    NewActiveOption = List->ActiveOption;
+    DestIndex = Indexes[0];
+    RemoveIndex = 0;
+    for (SrcIndex = Indexes[0]; SrcIndex < List->ItemCount; SrcIndex++) {
+        if (SrcIndex == List->ActiveOption) {
+            NewActiveOption = DestIndex;
+        }
+
+        if (RemoveIndex < Count && Indexes[RemoveIndex] == SrcIndex) {
+            RemoveIndex++;
+            continue;
+        }
+
+        if (List->MultiSelect) {
+            Selected = YoriWinListIsItemSelected(List, SrcIndex);
+            if (YoriWinListIsItemSelected(List, DestIndex) != Selected) {
+                YoriWinListToggleItemSelection(List, DestIndex);
+            }
+        }
+        DestIndex++;
+    }
+
+    if (List->ItemActive) {
+        List->ActiveOption = NewActiveOption;
+    }
+
+    YoriWinListSetItemCount(List, DestIndex);
+    YoriWinListEnsureActiveItemVisible(List);
+    YoriWinUpdateWindowContentsFromList(List);
+    return TRUE;
+}
+
+/**
+ Returns the number of items in the list control.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @return The number of items in the list control.
+ */
+DWORD
+YoriWinListGetItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    return List->ItemCount;
+}
+
+/**
+ Create a virtual list control and add it to a window.  A virtual list does
+ not store its items; rather, it invokes a callback to obtain the string for
+ each item as that item is displayed.  The number of items is specified with
+ @ref YoriWinListSetVirtualItemCount .  This is destroyed when the window is
+ destroyed.
 
  @param ParentHandle Pointer to the parent window.
 
- @param Size Specifies the location and size of the button.
+ @param Size Specifies the location and size of the list.
 
  @param Style Specifies style flags for the list including whether it should
         display a vertical scroll bar.
 
+ @param GetItemFn Optionally points to a function to invoke to obtain the
+        string for an item.  If NULL, the list is not virtual and items are
+        added with @ref YoriWinListAddItems .
+
+ @param GetItemContext Context to pass to GetItemFn.
+
  @return Pointer to the newly created control or NULL on failure.
  */
 PYORI_WIN_CTRL_HANDLE
-YoriWinCreateList(
+YoriWinCreateVirtualList(
     __in PYORI_WIN_WINDOW_HANDLE ParentHandle,
     __in PSMALL_RECT Size,
-    __in DWORD Style
+    __in DWORD Style,
+    __in_opt PYORI_WIN_NOTIFY_LIST_GET_ITEM GetItemFn,
+    __in_opt PVOID GetItemContext
     )
 {
     PYORI_WIN_CTRL_LIST List;
@@ -709,6 +1253,8 @@ YoriWinCreateList(
     ZeroMemory(List, sizeof(YORI_WIN_CTRL_LIST));
 
     YoriWinItemArrayInitialize(&List->ItemArray);
+    List->GetItemFn = GetItemFn;
+    List->GetItemContext = GetItemContext;
 
     List->Ctrl.NotifyEventFn = YoriWinListEventHandler;
     if (!YoriWinCreateControl(Parent, Size, TRUE, &List->Ctrl)) {
@@ -745,5 +1291,28 @@ YoriWinCreateList(
     return &List->Ctrl;
 }
 
+/**
+ Create a list control and add it to a window.  This is destroyed when the
+ window is destroyed.
+
+ @param ParentHandle Pointer to the parent window.
+
+ @param Size Specifies the location and size of the list.
+
+ @param Style Specifies style flags for the list including whether it should
+        display a vertical scroll bar.
+
+ @return Pointer to the newly created control or NULL on failure.
+ */
+PYORI_WIN_CTRL_HANDLE
+YoriWinCreateList(
+    __in PYORI_WIN_WINDOW_HANDLE ParentHandle,
+    __in PSMALL_RECT Size,
+    __in DWORD Style
+    )
+{
+    return YoriWinCreateVirtualList(ParentHandle, Size, Style, NULL, NULL);
+}
+
 
 // vim:sw=4:ts=4:et:
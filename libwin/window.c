@@ -105,6 +105,18 @@ typedef struct _YORI_WIN_WINDOW {
      */
     PYORI_WIN_NOTIFY_HANDLER CustomNotifications;
 
+    /**
+     Optionally points to a handle to wait on in addition to console input.
+     This allows work performed on other threads to be incorporated into the
+     window from the thread processing input.
+     */
+    HANDLE WaitHandle;
+
+    /**
+     A function to invoke when WaitHandle is signalled.
+     */
+    PYORI_WIN_NOTIFY_WAIT_SIGNALLED WaitHandleSignalled;
+
     /**
      The dimensions of the window.
      */
@@ -1447,6 +1459,40 @@ YoriWinSetCustomNotification(
     return TRUE;
 }
 
+/**
+ Set a handle that the window should wait on in addition to console input.
+ When the handle is signalled, the specified function is invoked from the
+ thread processing input for the window, so it can safely update controls.
+ This is intended for an auto reset event which a background thread signals
+ when it has results to display.
+
+ @param WindowHandle Pointer to the window.
+
+ @param WaitHandle Optionally specifies the handle to wait on.  If NULL, any
+        previously registered handle is removed.
+
+ @param Handler Pointer to a function to invoke when the handle is
+        signalled.  This is ignored if WaitHandle is NULL.
+ */
+VOID
+YoriWinSetWaitHandle(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in_opt HANDLE WaitHandle,
+    __in_opt PYORI_WIN_NOTIFY_WAIT_SIGNALLED Handler
+    )
+{
+    PYORI_WIN_WINDOW Window;
+    Window = (PYORI_WIN_WINDOW)WindowHandle;
+
+    if (WaitHandle == NULL || Handler == NULL) {
+        Window->WaitHandle = NULL;
+        Window->WaitHandleSignalled = NULL;
+    } else {
+        Window->WaitHandle = WaitHandle;
+        Window->WaitHandleSignalled = Handler;
+    }
+}
+
 
 /**
  A function to invoke when input events occur on the window.  Generally this
@@ -1712,6 +1758,9 @@ YoriWinProcessInputForWindow(
 {
     HANDLE hConIn;
     HANDLE hConOut;
+    HANDLE WaitHandles[2];
+    DWORD WaitResult;
+    BOOLEAN InputAvailable;
     INPUT_RECORD InputRecords[10];
     CONSOLE_CURSOR_INFO NewCursorInfo;
     PINPUT_RECORD InputRecord;
@@ -1756,7 +1805,28 @@ YoriWinProcessInputForWindow(
             break;
         }
 
-        if (!ReadConsoleInput(hConIn, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &ActuallyRead)) {
+        //
+        //  If the window has another handle to wait on, wait for it or for
+        //  input, and if it was signalled, let the window process it before
+        //  redisplaying.
+        //
+
+        InputAvailable = TRUE;
+        if (Window->WaitHandle != NULL) {
+            WaitHandles[0] = hConIn;
+            WaitHandles[1] = Window->WaitHandle;
+            WaitResult = WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE);
+            if (WaitResult == WAIT_OBJECT_0 + 1) {
+                InputAvailable = FALSE;
+                Window->WaitHandleSignalled(Window);
+            } else if (WaitResult != WAIT_OBJECT_0) {
+                break;
+            }
+        }
+
+        ActuallyRead = 0;
+        if (InputAvailable &&
+            !ReadConsoleInput(hConIn, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &ActuallyRead)) {
             break;
         }
 
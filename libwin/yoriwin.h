@@ -247,6 +247,22 @@ YoriWinLabelParseAccelerator(
  */
 #define YORI_WIN_LIST_STYLE_MULTISELECT (0x0002)
 
+/**
+ A function prototype that a virtual list invokes to obtain the string to
+ display for an item.  The first parameter is the list control, the second
+ is the index of the item, the third is the context supplied when the list
+ was created, and the fourth is a string to populate.  The list frees the
+ string once it has been displayed, so a provider would typically return a
+ referenced clone of a string it already holds.
+ */
+typedef BOOL YORI_WIN_NOTIFY_LIST_GET_ITEM(PYORI_WIN_CTRL_HANDLE, DWORD, PVOID, PYORI_STRING);
+
+/**
+ A pointer to a function that a virtual list invokes to obtain the string to
+ display for an item.
+ */
+typedef YORI_WIN_NOTIFY_LIST_GET_ITEM *PYORI_WIN_NOTIFY_LIST_GET_ITEM;
+
 PYORI_WIN_CTRL_HANDLE
 YoriWinCreateList(
     __in PYORI_WIN_WINDOW_HANDLE Parent,
@@ -254,6 +270,43 @@ YoriWinCreateList(
     __in DWORD Style
     );
 
+PYORI_WIN_CTRL_HANDLE
+YoriWinCreateVirtualList(
+    __in PYORI_WIN_WINDOW_HANDLE Parent,
+    __in PSMALL_RECT Size,
+    __in DWORD Style,
+    __in_opt PYORI_WIN_NOTIFY_LIST_GET_ITEM GetItemFn,
+    __in_opt PVOID GetItemContext
+    );
+
+__success(return)
+BOOL
+YoriWinListSetVirtualItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD ItemCount
+    );
+
+__success(return)
+BOOL
+YoriWinListInsertVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PDWORD Indexes,
+    __in DWORD Count
+    );
+
+__success(return)
+BOOL
+YoriWinListRemoveVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PDWORD Indexes,
+    __in DWORD Count
+    );
+
+DWORD
+YoriWinListGetItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle
+    );
+
 __success(return)
 BOOL
 YoriWinListGetActiveOption(
@@ -274,6 +327,14 @@ YoriWinListIsOptionSelected(
     __in DWORD Index
     );
 
+__success(return)
+BOOL
+YoriWinListSetOptionSelected(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD Index,
+    __in BOOLEAN Selected
+    );
+
 BOOL
 YoriWinListClearAllItems(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle
@@ -289,6 +350,18 @@ YoriWinListAddItems(
 
 // *** WINDOW.C ***
 
+/**
+ A function prototype that can be invoked when a handle that a window is
+ waiting on is signalled.
+ */
+typedef VOID YORI_WIN_NOTIFY_WAIT_SIGNALLED(PYORI_WIN_WINDOW_HANDLE);
+
+/**
+ A pointer to a function that can be invoked when a handle that a window is
+ waiting on is signalled.
+ */
+typedef YORI_WIN_NOTIFY_WAIT_SIGNALLED *PYORI_WIN_NOTIFY_WAIT_SIGNALLED;
+
 VOID
 YoriWinCloseWindow(
     __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
@@ -344,6 +417,13 @@ YoriWinGetClientSize(
     __out PCOORD Size
     );
 
+VOID
+YoriWinSetWaitHandle(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in_opt HANDLE WaitHandle,
+    __in_opt PYORI_WIN_NOTIFY_WAIT_SIGNALLED Handler
+    );
+
 __success(return)
 BOOL
 YoriWinProcessInputForWindow(
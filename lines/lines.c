@@ -35,11 +35,12 @@ CHAR strLinesHelpText[] =
         "\n"
         "Count the number of lines in one or more files.\n"
         "\n"
-        "LINES [-license] [-b] [-s] [-t] [<file>...]\n"
+        "LINES [-license] [-b] [-s] [-t] [-w] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -s             Process files from all subdirectories\n"
-        "   -t             Display total line count of all files\n";
+        "   -t             Display total line count of all files\n"
+        "   -w             Display word, character and byte counts\n";
 
 /**
  Display usage text to the user.
@@ -55,6 +56,38 @@ LinesHelp()
     return TRUE;
 }
 
+/**
+ A single file whose contents are being counted.
+ */
+typedef struct _LINES_FILE {
+
+    /**
+     The state used to queue the file to the pool of counting threads.
+     */
+    YORI_LIB_FILE_POOL_ITEM PoolItem;
+
+    /**
+     The path to the file, in a form suitable for display.
+     */
+    YORI_STRING DisplayPath;
+
+    /**
+     An opened handle to the file.  This is closed once counting is
+     complete.
+     */
+    HANDLE FileHandle;
+
+    /**
+     TRUE if the file was counted successfully.
+     */
+    BOOL Success;
+
+    /**
+     The counts of the file contents.
+     */
+    YORILIB_STREAM_COUNTS Counts;
+} LINES_FILE, *PLINES_FILE;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -71,6 +104,12 @@ typedef struct _LINES_CONTEXT {
      */
     BOOLEAN Recursive;
 
+    /**
+     TRUE to indicate that words, characters and bytes should be counted and
+     displayed in addition to lines.
+     */
+    BOOLEAN CountWords;
+
     /**
      The first error encountered when enumerating objects from a single arg.
      This is used to preserve file not found/path not found errors so that
@@ -91,54 +130,199 @@ typedef struct _LINES_CONTEXT {
     LONGLONG FilesFoundThisArg;
 
     /**
-     Records the number of lines found in a single file.
+     Records the total counts for all files.
      */
-    LONGLONG FileLinesFound;
+    YORILIB_STREAM_COUNTS TotalCounts;
 
     /**
-     Records the total number of lines processed for all files.
+     The pool of threads counting files.  Results are displayed in the
+     order files were found.
      */
-    LONGLONG TotalLinesFound;
+    YORI_LIB_FILE_POOL Pool;
 } LINES_CONTEXT, *PLINES_CONTEXT;
 
 /**
- Count the lines in an opened stream.
+ Add one set of counts to another.
+
+ @param Total Pointer to the counts to update.
+
+ @param Counts Pointer to the counts to add.
+ */
+VOID
+LinesAddCounts(
+    __inout PYORILIB_STREAM_COUNTS Total,
+    __in PYORILIB_STREAM_COUNTS Counts
+    )
+{
+    Total->Lines += Counts->Lines;
+    Total->Words += Counts->Words;
+    Total->Chars += Counts->Chars;
+    Total->Bytes += Counts->Bytes;
+}
+
+/**
+ Display a set of counts, optionally followed by the file they refer to.
 
- @param hSource Handle to the source.
+ @param LinesContext Pointer to the context indicating which counts to
+        display.
 
- @param LinesContext Specifies the context to record line count information.
+ @param Counts Pointer to the counts to display.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param FilePath Optionally points to the name of the file to display.
  */
-BOOL
-LinesProcessStream(
-    __in HANDLE hSource,
-    __in PLINES_CONTEXT LinesContext
+VOID
+LinesDisplayCounts(
+    __in PLINES_CONTEXT LinesContext,
+    __in PYORILIB_STREAM_COUNTS Counts,
+    __in_opt PYORI_STRING FilePath
     )
 {
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
+    YORI_STRING StringForm[4];
+    TCHAR StackBuffer[4][32];
+    DWORD Index;
+    DWORD Count;
+
+    Count = 1;
+    if (LinesContext->CountWords) {
+        Count = 4;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibInitEmptyString(&StringForm[Index]);
+        StringForm[Index].StartOfString = StackBuffer[Index];
+        StringForm[Index].LengthAllocated = sizeof(StackBuffer[Index])/sizeof(StackBuffer[Index][0]);
+    }
+
+    YoriLibNumberToString(&StringForm[0], Counts->Lines, 10, 3, ',');
+    if (LinesContext->CountWords) {
+        YoriLibNumberToString(&StringForm[1], Counts->Words, 10, 3, ',');
+        YoriLibNumberToString(&StringForm[2], Counts->Chars, 10, 3, ',');
+        YoriLibNumberToString(&StringForm[3], Counts->Bytes, 10, 3, ',');
+    }
 
-    YoriLibInitEmptyString(&LineString);
+    if (FilePath != NULL) {
+        if (LinesContext->CountWords) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %16y %16y %16y %y\n"), &StringForm[0], &StringForm[1], &StringForm[2], &StringForm[3], FilePath);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %y\n"), &StringForm[0], FilePath);
+        }
+    } else {
+        if (LinesContext->CountWords) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %16y %16y %16y\n"), &StringForm[0], &StringForm[1], &StringForm[2], &StringForm[3]);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &StringForm[0]);
+        }
+    }
 
-    LinesContext->FilesFound++;
-    LinesContext->FilesFoundThisArg++;
-    LinesContext->FileLinesFound = 0;
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibFreeStringContents(&StringForm[Index]);
+    }
+}
+
+/**
+ Count the contents of a single file and close its handle.  This may be
+ called on a worker thread.
 
-    while (TRUE) {
+ @param Context Pointer to the lines context.
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
-            break;
+ @param WorkerIndex The index of the thread counting the file.  Ignored in
+        this application.
+
+ @param Item Pointer to the pool state within the file to count.
+ */
+VOID
+LinesCountFile(
+    __in PVOID Context,
+    __in DWORD WorkerIndex,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    PLINES_CONTEXT LinesContext = (PLINES_CONTEXT)Context;
+    PLINES_FILE File;
+
+    UNREFERENCED_PARAMETER(WorkerIndex);
+
+    File = CONTAINING_RECORD(Item, LINES_FILE, PoolItem);
+    File->Success = YoriLibCountStreamContents(File->FileHandle, LinesContext->CountWords, &File->Counts);
+    CloseHandle(File->FileHandle);
+    File->FileHandle = NULL;
+}
+
+/**
+ Display the results of a file which has been counted and free it.  Files
+ are completed in the order they were found.
+
+ @param Context Pointer to the lines context.
+
+ @param Item Pointer to the pool state within the counted file.
+ */
+VOID
+LinesCompleteFile(
+    __in PVOID Context,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    PLINES_CONTEXT LinesContext = (PLINES_CONTEXT)Context;
+    PLINES_FILE File;
+
+    File = CONTAINING_RECORD(Item, LINES_FILE, PoolItem);
+    if (File->Success) {
+        LinesAddCounts(&LinesContext->TotalCounts, &File->Counts);
+        if (!LinesContext->SummaryOnly) {
+            LinesDisplayCounts(LinesContext, &File->Counts, &File->DisplayPath);
         }
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: read of %y failed\n"), &File->DisplayPath);
+    }
+
+    YoriLibFreeStringContents(&File->DisplayPath);
+    YoriLibFree(File);
+}
+
+/**
+ Queue an opened file to be counted.  If worker threads are available the
+ file is counted on a worker thread, otherwise it is counted immediately.
+ Results are displayed in the order files are queued.
+
+ @param LinesContext Pointer to the lines context.
 
-        LinesContext->FileLinesFound++;
+ @param FilePath Pointer to the path of the file.
+
+ @param FileHandle Handle to the opened file.  This routine takes ownership
+        of the handle.
+ */
+VOID
+LinesQueueFile(
+    __inout PLINES_CONTEXT LinesContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE FileHandle
+    )
+{
+    PLINES_FILE File;
+
+    File = YoriLibMalloc(sizeof(LINES_FILE));
+    if (File == NULL) {
+        CloseHandle(FileHandle);
+        return;
     }
 
-    YoriLibLineReadClose(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    ZeroMemory(File, sizeof(LINES_FILE));
+    File->FileHandle = FileHandle;
+    if (!YoriLibFilePoolInitializeItem(&File->PoolItem)) {
+        CloseHandle(FileHandle);
+        YoriLibFree(File);
+        return;
+    }
 
-    LinesContext->TotalLinesFound += LinesContext->FileLinesFound;
-    return TRUE;
+    YoriLibInitEmptyString(&File->DisplayPath);
+    if (!YoriLibUnescapePath(FilePath, &File->DisplayPath)) {
+        YoriLibFilePoolCleanupItem(&File->PoolItem);
+        CloseHandle(FileHandle);
+        YoriLibFree(File);
+        return;
+    }
+
+    YoriLibFilePoolQueueItem(&LinesContext->Pool, &File->PoolItem);
 }
 
 /**
@@ -180,7 +364,7 @@ LinesFileFoundCallback(
                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
                                 NULL,
                                 OPEN_EXISTING,
-                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
                                 NULL);
 
         if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
@@ -194,25 +378,9 @@ LinesFileFoundCallback(
         }
 
         LinesContext->SavedErrorThisArg = ERROR_SUCCESS;
-        LinesProcessStream(FileHandle, LinesContext);
-
-        if (!LinesContext->SummaryOnly) {
-            YORI_STRING StringFormOfLineCount;
-            YORI_STRING UnescapedFilePath;
-            TCHAR StackBuffer[16];
-
-            YoriLibInitEmptyString(&StringFormOfLineCount);
-            StringFormOfLineCount.StartOfString = StackBuffer;
-            StringFormOfLineCount.LengthAllocated = sizeof(StackBuffer)/sizeof(StackBuffer[0]);
-            YoriLibNumberToString(&StringFormOfLineCount, LinesContext->FileLinesFound, 10, 3, ',');
-            YoriLibInitEmptyString(&UnescapedFilePath);
-            YoriLibUnescapePath(FilePath, &UnescapedFilePath);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %y\n"), &StringFormOfLineCount, &UnescapedFilePath);
-            YoriLibFreeStringContents(&StringFormOfLineCount);
-            YoriLibFreeStringContents(&UnescapedFilePath);
-        }
-
-        CloseHandle(FileHandle);
+        LinesContext->FilesFound++;
+        LinesContext->FilesFoundThisArg++;
+        LinesQueueFile(LinesContext, FilePath, FileHandle);
     }
 
     return TRUE;
@@ -339,6 +507,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("t")) == 0) {
                 LinesContext.SummaryOnly = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("w")) == 0) {
+                LinesContext.CountWords = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -379,8 +550,15 @@ ENTRYPOINT(
 
         LinesContext.SummaryOnly = TRUE;
 
-        LinesProcessStream(GetStdHandle(STD_INPUT_HANDLE), &LinesContext);
+        if (!YoriLibCountStreamContents(GetStdHandle(STD_INPUT_HANDLE), LinesContext.CountWords, &LinesContext.TotalCounts)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: read of input failed\n"));
+            return EXIT_FAILURE;
+        }
+        LinesContext.FilesFound++;
     } else {
+        YoriLibFilePoolInitialize(&LinesContext.Pool, NULL, LinesCountFile, LinesCompleteFile, &LinesContext);
+        YoriLibFilePoolStartWorkers(&LinesContext.Pool);
+
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (LinesContext.Recursive) {
             MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
@@ -413,18 +591,15 @@ ENTRYPOINT(
                 }
             }
         }
+
+        YoriLibFilePoolStopWorkers(&LinesContext.Pool);
     }
 
     if (LinesContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: no matching files found\n"));
         return EXIT_FAILURE;
     } else if (LinesContext.FilesFound > 1 || LinesContext.SummaryOnly) {
-        YORI_STRING StringFormOfLineCount;
-
-        YoriLibInitEmptyString(&StringFormOfLineCount);
-        YoriLibNumberToString(&StringFormOfLineCount, LinesContext.TotalLinesFound, 10, 3, ',');
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &StringFormOfLineCount);
-        YoriLibFreeStringContents(&StringFormOfLineCount);
+        LinesDisplayCounts(&LinesContext, &LinesContext.TotalCounts, NULL);
     }
 
     return EXIT_SUCCESS;
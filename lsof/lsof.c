@@ -35,10 +35,12 @@ CHAR strLsofHelpText[] =
         "\n"
         "Determine which processes are keeping files open.\n"
         "\n"
-        "LSOF [-license] [-b] [-s] <file>...\n"
+        "LSOF [-license] [-b] [-p] [-s] [-w] <file>...\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
-        "   -s             Process files from all subdirectories\n";
+        "   -p             Display files grouped by the process using them\n"
+        "   -s             Process files from all subdirectories\n"
+        "   -w             Watch files and display processes as they open or close them\n";
 
 /**
  Display usage text to the user.
@@ -54,6 +56,82 @@ LsofHelp()
     return TRUE;
 }
 
+/**
+ Information about a process which is using one or more of the files being
+ examined.
+ */
+typedef struct _LSOF_PROCESS {
+
+    /**
+     The entry for this process in the table of processes, keyed by process
+     identifier.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The links of this process within the list of processes, in the order
+     they were found.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The process identifier.
+     */
+    DWORD ProcessId;
+
+    /**
+     The number of files that this process is known to be using.  When this
+     reaches zero the process is removed from the table, so if its process
+     identifier is reused, the name is resolved again.
+     */
+    DWORD ReferenceCount;
+
+    /**
+     The full path to the executable for the process, or an empty string if
+     it could not be determined.
+     */
+    YORI_STRING ProcessName;
+
+} LSOF_PROCESS, *PLSOF_PROCESS;
+
+/**
+ Information about a file being examined.
+ */
+typedef struct _LSOF_FILE {
+
+    /**
+     The entry for this file in the table of files, keyed by path.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The links of this file within the list of files, in the order they were
+     specified.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The number of processes using the file.
+     */
+    DWORD ProcessCount;
+
+    /**
+     The number of elements allocated in the Processes array.
+     */
+    DWORD ProcessesAllocated;
+
+    /**
+     An array of processes using the file, sorted by process identifier.
+     */
+    PLSOF_PROCESS *Processes;
+
+} LSOF_FILE, *PLSOF_FILE;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -76,8 +154,237 @@ typedef struct _LSOF_CONTEXT {
      */
     PFILE_PROCESS_IDS_USING_FILE_INFORMATION Buffer;
 
+    /**
+     A list of files being examined, in the order they were found.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     A table of files being examined, keyed by path.  This is used to ensure
+     each file is only examined once if it is matched by multiple arguments.
+     */
+    PYORI_HASH_TABLE FileTable;
+
+    /**
+     A list of processes using any of the files being examined.
+     */
+    YORI_LIST_ENTRY ProcessList;
+
+    /**
+     A table of processes using any of the files being examined, keyed by
+     process identifier.  This allows the name of each process to be
+     resolved once regardless of how many files it is using.
+     */
+    PYORI_HASH_TABLE ProcessTable;
+
+    /**
+     Scratch space used to sort process identifiers returned for a file.
+     */
+    PDWORD SortedProcessIds;
+
+    /**
+     The number of elements allocated in SortedProcessIds.
+     */
+    DWORD SortedProcessIdsAllocated;
+
 } LSOF_CONTEXT, *PLSOF_CONTEXT;
 
+/**
+ Generate the string used as the key for a process in the process table.
+
+ @param ProcessId The process identifier.
+
+ @param Key On successful completion, populated with the key.  The caller is
+        expected to initialize this to point to a buffer of sufficient size.
+ */
+VOID
+LsofProcessIdToKey(
+    __in DWORD ProcessId,
+    __inout PYORI_STRING Key
+    )
+{
+    int CharsPopulated;
+
+    CharsPopulated = YoriLibSPrintfS(Key->StartOfString, Key->LengthAllocated, _T("%x"), ProcessId);
+    Key->LengthInChars = 0;
+    if (CharsPopulated > 0) {
+        Key->LengthInChars = (DWORD)CharsPopulated;
+    }
+}
+
+/**
+ Find a process in the process table, or create a new entry for it if it is
+ not already known, and take a reference on it.
+
+ @param LsofContext Pointer to the lsof context.
+
+ @param ProcessId The process identifier.
+
+ @return Pointer to the process, or NULL on allocation failure.
+ */
+PLSOF_PROCESS
+LsofReferenceProcess(
+    __in PLSOF_CONTEXT LsofContext,
+    __in DWORD ProcessId
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PLSOF_PROCESS Process;
+    YORI_STRING Key;
+    TCHAR KeyBuffer[16];
+    HANDLE ProcessHandle;
+    TCHAR ProcessName[300];
+    DWORD ProcessNameSize;
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+    LsofProcessIdToKey(ProcessId, &Key);
+
+    HashEntry = YoriLibHashLookupByKey(LsofContext->ProcessTable, &Key);
+    if (HashEntry != NULL) {
+        Process = HashEntry->Context;
+        Process->ReferenceCount++;
+        return Process;
+    }
+
+    ProcessName[0] = '\0';
+    ProcessNameSize = sizeof(ProcessName)/sizeof(ProcessName[0]);
+    ProcessHandle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, ProcessId);
+    if (ProcessHandle != NULL) {
+        if (!DllKernel32.pQueryFullProcessImageNameW(ProcessHandle, 0, ProcessName, &ProcessNameSize)) {
+            ProcessNameSize = 0;
+        }
+        CloseHandle(ProcessHandle);
+    } else {
+        ProcessNameSize = 0;
+    }
+
+    Process = YoriLibReferencedMalloc(sizeof(LSOF_PROCESS) + (ProcessNameSize + 1) * sizeof(TCHAR));
+    if (Process == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Process, sizeof(LSOF_PROCESS));
+    Process->ProcessId = ProcessId;
+    Process->ReferenceCount = 1;
+
+    YoriLibInitEmptyString(&Process->ProcessName);
+    YoriLibReference(Process);
+    Process->ProcessName.MemoryToFree = Process;
+    Process->ProcessName.StartOfString = (LPTSTR)(Process + 1);
+    Process->ProcessName.LengthAllocated = ProcessNameSize + 1;
+    Process->ProcessName.LengthInChars = ProcessNameSize;
+    memcpy(Process->ProcessName.StartOfString, ProcessName, ProcessNameSize * sizeof(TCHAR));
+    Process->ProcessName.StartOfString[ProcessNameSize] = '\0';
+
+    if (!YoriLibHashInsertByKey(LsofContext->ProcessTable, &Key, Process, &Process->HashEntry)) {
+        YoriLibFreeStringContents(&Process->ProcessName);
+        YoriLibDereference(Process);
+        return NULL;
+    }
+
+    YoriLibAppendList(&LsofContext->ProcessList, &Process->ListEntry);
+    return Process;
+}
+
+/**
+ Release a reference on a process, removing it from the process table if
+ no files are known to be in use by it.
+
+ @param Process Pointer to the process.
+ */
+VOID
+LsofDereferenceProcess(
+    __in PLSOF_PROCESS Process
+    )
+{
+    ASSERT(Process->ReferenceCount > 0);
+    Process->ReferenceCount--;
+    if (Process->ReferenceCount > 0) {
+        return;
+    }
+
+    YoriLibHashRemoveByEntry(&Process->HashEntry);
+    YoriLibRemoveListItem(&Process->ListEntry);
+    YoriLibFreeStringContents(&Process->ProcessName);
+    YoriLibDereference(Process);
+}
+
+/**
+ Add a file to the set of files being examined.  If the file is already
+ being examined, this function has no effect.
+
+ @param LsofContext Pointer to the lsof context.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+LsofAddFile(
+    __in PLSOF_CONTEXT LsofContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PLSOF_FILE File;
+
+    if (YoriLibHashLookupByKey(LsofContext->FileTable, FilePath) != NULL) {
+        return TRUE;
+    }
+
+    File = YoriLibReferencedMalloc(sizeof(LSOF_FILE) + (FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(File, sizeof(LSOF_FILE));
+    YoriLibInitEmptyString(&File->FilePath);
+    YoriLibReference(File);
+    File->FilePath.MemoryToFree = File;
+    File->FilePath.StartOfString = (LPTSTR)(File + 1);
+    File->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    File->FilePath.LengthInChars = FilePath->LengthInChars;
+    memcpy(File->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    File->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+
+    if (!YoriLibHashInsertByKey(LsofContext->FileTable, &File->FilePath, File, &File->HashEntry)) {
+        YoriLibFreeStringContents(&File->FilePath);
+        YoriLibDereference(File);
+        return FALSE;
+    }
+
+    YoriLibAppendList(&LsofContext->FileList, &File->ListEntry);
+    return TRUE;
+}
+
+/**
+ Free a file being examined, releasing its references on processes.
+
+ @param File Pointer to the file.
+ */
+VOID
+LsofFreeFile(
+    __in PLSOF_FILE File
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < File->ProcessCount; Index++) {
+        LsofDereferenceProcess(File->Processes[Index]);
+    }
+
+    if (File->Processes != NULL) {
+        YoriLibFree(File->Processes);
+    }
+
+    YoriLibHashRemoveByEntry(&File->HashEntry);
+    YoriLibRemoveListItem(&File->ListEntry);
+    YoriLibFreeStringContents(&File->FilePath);
+    YoriLibDereference(File);
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -102,11 +409,7 @@ LsofFileFoundCallback(
     __in PVOID Context
     )
 {
-    HANDLE FileHandle;
     PLSOF_CONTEXT LsofContext = (PLSOF_CONTEXT)Context;
-    IO_STATUS_BLOCK IoStatus;
-    DWORD Index;
-    LONG Status;
 
     UNREFERENCED_PARAMETER(Depth);
     UNREFERENCED_PARAMETER(FileInfo);
@@ -115,6 +418,37 @@ LsofFileFoundCallback(
 
     LsofContext->FilesFoundThisArg++;
 
+    if (!LsofAddFile(LsofContext, FilePath)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Query the set of processes using a file.
+
+ @param LsofContext Pointer to the lsof context.  On successful completion,
+        the Buffer within the context contains the process identifiers.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param DisplayErrors TRUE if failures should be displayed to the user.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+LsofQueryFile(
+    __in PLSOF_CONTEXT LsofContext,
+    __in PYORI_STRING FilePath,
+    __in BOOL DisplayErrors
+    )
+{
+    HANDLE FileHandle;
+    IO_STATUS_BLOCK IoStatus;
+    LONG Status;
+
     FileHandle = CreateFile(FilePath->StartOfString,
                             FILE_READ_ATTRIBUTES,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -125,6 +459,9 @@ LsofFileFoundCallback(
 
     if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
         DWORD LastError = GetLastError();
+        if (!DisplayErrors) {
+            return FALSE;
+        }
         if (LastError == ERROR_ACCESS_DENIED &&
             DllNtDll.pRtlGetLastNtStatus != NULL &&
             DllNtDll.pRtlGetLastNtStatus() == (LONG)0xC0000056) {
@@ -134,32 +471,346 @@ LsofFileFoundCallback(
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: open of %y failed: %s"), FilePath, ErrText);
             YoriLibFreeWinErrorText(ErrText);
         }
-        return TRUE;
+        return FALSE;
     }
 
-    Status = DllNtDll.pNtQueryInformationFile(FileHandle, &IoStatus, LsofContext->Buffer, LsofContext->BufferLength, FileProcessIdsUsingFileInformation);
-    if (Status == 0) {
-        for (Index = 0; Index < LsofContext->Buffer->NumberOfProcesses; Index++) {
-            HANDLE ProcessHandle;
-            TCHAR ProcessName[300];
-            DWORD ProcessNameSize;
+    while (TRUE) {
+        Status = DllNtDll.pNtQueryInformationFile(FileHandle, &IoStatus, LsofContext->Buffer, LsofContext->BufferLength, FileProcessIdsUsingFileInformation);
+
+        //
+        //  If the buffer is too small, grow it and try again.  The buffer is
+        //  retained for the next file.
+        //
 
-            ProcessName[0] = '\0';
-            ProcessNameSize = sizeof(ProcessName)/sizeof(ProcessName[0]);
-            ProcessHandle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)LsofContext->Buffer->ProcessIds[Index]);
-            if (ProcessHandle != NULL) {
-                DllKernel32.pQueryFullProcessImageNameW(ProcessHandle, 0, ProcessName, &ProcessNameSize);
+        if (Status == (LONG)0xC0000004 && LsofContext->BufferLength < 16 * 1024 * 1024) {
+            PFILE_PROCESS_IDS_USING_FILE_INFORMATION NewBuffer;
+            NewBuffer = YoriLibMalloc(LsofContext->BufferLength * 4);
+            if (NewBuffer == NULL) {
+                break;
             }
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%10i %s\n"), LsofContext->Buffer->ProcessIds[Index], ProcessName);
+            YoriLibFree(LsofContext->Buffer);
+            LsofContext->Buffer = NewBuffer;
+            LsofContext->BufferLength = LsofContext->BufferLength * 4;
+            continue;
         }
-    } else {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: query of %y failed: %08x"), FilePath, Status);
+        break;
     }
 
     CloseHandle(FileHandle);
+
+    if (Status != 0) {
+        if (DisplayErrors) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: query of %y failed: %08x\n"), FilePath, Status);
+        }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Query the processes currently using a file and update the set of processes
+ recorded for it.  The previous and current sets are both sorted by process
+ identifier, so they can be compared in a single pass.
+
+ @param LsofContext Pointer to the lsof context.
+
+ @param File Pointer to the file to update.
+
+ @param DisplayChanges TRUE to display processes which have started or
+        stopped using the file since it was last queried.  If FALSE, this is
+        the first query for the file, and any errors are displayed.
+
+ @return TRUE to indicate success, FALSE to indicate failure, in which case
+         the processes recorded for the file are unchanged.
+ */
+__success(return)
+BOOL
+LsofRefreshFile(
+    __in PLSOF_CONTEXT LsofContext,
+    __in PLSOF_FILE File,
+    __in BOOL DisplayChanges
+    )
+{
+    PLSOF_PROCESS *NewProcesses;
+    PLSOF_PROCESS Process;
+    DWORD NewCount;
+    DWORD NewIndex;
+    DWORD OldIndex;
+    DWORD Count;
+    DWORD Index;
+    DWORD Insert;
+    DWORD ProcessId;
+
+    //
+    //  If the file cannot be opened or queried, which may be temporary,
+    //  keep the processes from the previous query rather than reporting
+    //  that every process has stopped using it.
+    //
+
+    if (!LsofQueryFile(LsofContext, &File->FilePath, !DisplayChanges)) {
+        return FALSE;
+    }
+    Count = LsofContext->Buffer->NumberOfProcesses;
+
+    if (Count > LsofContext->SortedProcessIdsAllocated) {
+        if (LsofContext->SortedProcessIds != NULL) {
+            YoriLibFree(LsofContext->SortedProcessIds);
+            LsofContext->SortedProcessIdsAllocated = 0;
+        }
+        LsofContext->SortedProcessIds = YoriLibMalloc((Count + 16) * sizeof(DWORD));
+        if (LsofContext->SortedProcessIds == NULL) {
+            return FALSE;
+        }
+        LsofContext->SortedProcessIdsAllocated = Count + 16;
+    }
+
+    //
+    //  The number of processes using a single file is typically small, so
+    //  an insertion sort is sufficient.
+    //
+
+    for (Index = 0; Index < Count; Index++) {
+        ProcessId = (DWORD)LsofContext->Buffer->ProcessIds[Index];
+        Insert = Index;
+        while (Insert > 0 && LsofContext->SortedProcessIds[Insert - 1] > ProcessId) {
+            LsofContext->SortedProcessIds[Insert] = LsofContext->SortedProcessIds[Insert - 1];
+            Insert--;
+        }
+        LsofContext->SortedProcessIds[Insert] = ProcessId;
+    }
+
+    NewProcesses = NULL;
+    if (Count > 0) {
+        NewProcesses = YoriLibMalloc(Count * sizeof(PLSOF_PROCESS));
+        if (NewProcesses == NULL) {
+            return FALSE;
+        }
+    }
+
+    NewCount = 0;
+    OldIndex = 0;
+    for (NewIndex = 0; NewIndex < Count; NewIndex++) {
+        ProcessId = LsofContext->SortedProcessIds[NewIndex];
+
+        while (OldIndex < File->ProcessCount &&
+               File->Processes[OldIndex]->ProcessId < ProcessId) {
+
+            Process = File->Processes[OldIndex];
+            if (DisplayChanges) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("-%9i %y: %y\n"), Process->ProcessId, &Process->ProcessName, &File->FilePath);
+            }
+            LsofDereferenceProcess(Process);
+            OldIndex++;
+        }
+
+        if (OldIndex < File->ProcessCount &&
+            File->Processes[OldIndex]->ProcessId == ProcessId) {
+
+            NewProcesses[NewCount] = File->Processes[OldIndex];
+            NewCount++;
+            OldIndex++;
+            continue;
+        }
+
+        if (NewCount > 0 && NewProcesses[NewCount - 1]->ProcessId == ProcessId) {
+            continue;
+        }
+
+        Process = LsofReferenceProcess(LsofContext, ProcessId);
+        if (Process == NULL) {
+            continue;
+        }
+
+        if (DisplayChanges) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("+%9i %y: %y\n"), Process->ProcessId, &Process->ProcessName, &File->FilePath);
+        }
+        NewProcesses[NewCount] = Process;
+        NewCount++;
+    }
+
+    for (; OldIndex < File->ProcessCount; OldIndex++) {
+        Process = File->Processes[OldIndex];
+        if (DisplayChanges) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("-%9i %y: %y\n"), Process->ProcessId, &Process->ProcessName, &File->FilePath);
+        }
+        LsofDereferenceProcess(Process);
+    }
+
+    if (File->Processes != NULL) {
+        YoriLibFree(File->Processes);
+    }
+
+    File->Processes = NewProcesses;
+    File->ProcessCount = NewCount;
+    File->ProcessesAllocated = Count;
+
     return TRUE;
 }
 
+/**
+ Find whether a file is being used by a specified process.
+
+ @param File Pointer to the file.
+
+ @param Process Pointer to the process.
+
+ @return TRUE if the file is in use by the process, FALSE if it is not.
+ */
+BOOL
+LsofIsFileInUseByProcess(
+    __in PLSOF_FILE File,
+    __in PLSOF_PROCESS Process
+    )
+{
+    DWORD Low;
+    DWORD High;
+    DWORD Middle;
+
+    Low = 0;
+    High = File->ProcessCount;
+
+    while (Low < High) {
+        Middle = Low + (High - Low) / 2;
+        if (File->Processes[Middle] == Process) {
+            return TRUE;
+        } else if (File->Processes[Middle]->ProcessId < Process->ProcessId) {
+            Low = Middle + 1;
+        } else {
+            High = Middle;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Display the processes using each file.
+
+ @param LsofContext Pointer to the lsof context.
+ */
+VOID
+LsofDisplayByFile(
+    __in PLSOF_CONTEXT LsofContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PLSOF_FILE File;
+    PLSOF_PROCESS Process;
+    DWORD Index;
+
+    ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, LSOF_FILE, ListEntry);
+        for (Index = 0; Index < File->ProcessCount; Index++) {
+            Process = File->Processes[Index];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%10i %y\n"), Process->ProcessId, &Process->ProcessName);
+        }
+        ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, ListEntry);
+    }
+}
+
+/**
+ Display the files used by each process.
+
+ @param LsofContext Pointer to the lsof context.
+ */
+VOID
+LsofDisplayByProcess(
+    __in PLSOF_CONTEXT LsofContext
+    )
+{
+    PYORI_LIST_ENTRY ProcessListEntry;
+    PYORI_LIST_ENTRY FileListEntry;
+    PLSOF_FILE File;
+    PLSOF_PROCESS Process;
+
+    ProcessListEntry = YoriLibGetNextListEntry(&LsofContext->ProcessList, NULL);
+    while (ProcessListEntry != NULL) {
+        Process = CONTAINING_RECORD(ProcessListEntry, LSOF_PROCESS, ListEntry);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%10i %y\n"), Process->ProcessId, &Process->ProcessName);
+
+        FileListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, NULL);
+        while (FileListEntry != NULL) {
+            File = CONTAINING_RECORD(FileListEntry, LSOF_FILE, ListEntry);
+            if (LsofIsFileInUseByProcess(File, Process)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("           %y\n"), &File->FilePath);
+            }
+            FileListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, FileListEntry);
+        }
+        ProcessListEntry = YoriLibGetNextListEntry(&LsofContext->ProcessList, ProcessListEntry);
+    }
+}
+
+/**
+ Query every file being examined.
+
+ @param LsofContext Pointer to the lsof context.
+
+ @param DisplayChanges TRUE to display processes which have started or
+        stopped using each file since the previous query.
+ */
+VOID
+LsofRefreshAllFiles(
+    __in PLSOF_CONTEXT LsofContext,
+    __in BOOL DisplayChanges
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PLSOF_FILE File;
+
+    ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, LSOF_FILE, ListEntry);
+        LsofRefreshFile(LsofContext, File, DisplayChanges);
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, ListEntry);
+    }
+}
+
+/**
+ Free all state associated with the lsof context.
+
+ @param LsofContext Pointer to the lsof context.
+ */
+VOID
+LsofCleanupContext(
+    __in PLSOF_CONTEXT LsofContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PLSOF_FILE File;
+
+    if (LsofContext->FileTable != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, NULL);
+        while (ListEntry != NULL) {
+            File = CONTAINING_RECORD(ListEntry, LSOF_FILE, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&LsofContext->FileList, ListEntry);
+            LsofFreeFile(File);
+        }
+        YoriLibFreeEmptyHashTable(LsofContext->FileTable);
+        LsofContext->FileTable = NULL;
+    }
+
+    if (LsofContext->ProcessTable != NULL) {
+        ASSERT(YoriLibIsListEmpty(&LsofContext->ProcessList));
+        YoriLibFreeEmptyHashTable(LsofContext->ProcessTable);
+        LsofContext->ProcessTable = NULL;
+    }
+
+    if (LsofContext->SortedProcessIds != NULL) {
+        YoriLibFree(LsofContext->SortedProcessIds);
+        LsofContext->SortedProcessIds = NULL;
+    }
+
+    if (LsofContext->Buffer != NULL) {
+        YoriLibFree(LsofContext->Buffer);
+        LsofContext->Buffer = NULL;
+    }
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the lsof builtin command.
@@ -194,6 +845,9 @@ ENTRYPOINT(
     DWORD MatchFlags;
     BOOL Recursive = FALSE;
     BOOL BasicEnumeration = FALSE;
+    BOOL DisplayByProcess = FALSE;
+    BOOL WatchMode = FALSE;
+    HANDLE CancelHandle;
     LSOF_CONTEXT LsofContext;
     YORI_STRING Arg;
 
@@ -215,9 +869,15 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("p")) == 0) {
+                DisplayByProcess = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("w")) == 0) {
+                WatchMode = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -241,6 +901,11 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (StartArg == 0 || StartArg == ArgC) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: missing argument\n"));
+        return EXIT_FAILURE;
+    }
+
     //
     //  Attempt to enable backup privilege so an administrator can access more
     //  objects successfully.
@@ -248,45 +913,82 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+#ifdef YORI_BUILTIN
+    YoriLibCancelEnable();
+#endif
+
+    YoriLibInitializeListHead(&LsofContext.FileList);
+    YoriLibInitializeListHead(&LsofContext.ProcessList);
+    LsofContext.FileTable = YoriLibAllocateHashTable(251);
+    LsofContext.ProcessTable = YoriLibAllocateHashTable(251);
     LsofContext.BufferLength = 16 * 1024;
     LsofContext.Buffer = YoriLibMalloc(LsofContext.BufferLength);
-    if (LsofContext.Buffer == NULL) {
+    if (LsofContext.Buffer == NULL ||
+        LsofContext.FileTable == NULL ||
+        LsofContext.ProcessTable == NULL) {
+
+        LsofCleanupContext(&LsofContext);
         return EXIT_FAILURE;
     }
 
     //
-    //  If no file name is specified, use stdin; otherwise open
-    //  the file and use that
+    //  Find every file to examine first, so that each is only queried once
+    //  and each process using them only has its name resolved once.
     //
 
-    if (StartArg == 0 || StartArg == ArgC) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: missing argument\n"));
-        return EXIT_FAILURE;
-    } else {
-        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
-        if (Recursive) {
-            MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
-        }
-        if (BasicEnumeration) {
-            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    if (Recursive) {
+        MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    }
+    if (BasicEnumeration) {
+        MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+
+    for (i = StartArg; i < ArgC; i++) {
+
+        LsofContext.FilesFoundThisArg = 0;
+        YoriLibForEachStream(&ArgV[i], MatchFlags, 0, LsofFileFoundCallback, NULL, &LsofContext);
+        if (LsofContext.FilesFoundThisArg == 0) {
+            YORI_STRING FullPath;
+            YoriLibInitEmptyString(&FullPath);
+            if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                LsofFileFoundCallback(&FullPath, NULL, 0, &LsofContext);
+                YoriLibFreeStringContents(&FullPath);
+            }
         }
+    }
+
+    LsofRefreshAllFiles(&LsofContext, FALSE);
 
-        for (i = StartArg; i < ArgC; i++) {
+    if (DisplayByProcess) {
+        LsofDisplayByProcess(&LsofContext);
+    } else {
+        LsofDisplayByFile(&LsofContext);
+    }
 
-            LsofContext.FilesFoundThisArg = 0;
-            YoriLibForEachStream(&ArgV[i], MatchFlags, 0, LsofFileFoundCallback, NULL, &LsofContext);
-            if (LsofContext.FilesFoundThisArg == 0) {
-                YORI_STRING FullPath;
-                YoriLibInitEmptyString(&FullPath);
-                if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
-                    LsofFileFoundCallback(&FullPath, NULL, 0, &LsofContext);
-                    YoriLibFreeStringContents(&FullPath);
+    //
+    //  In watch mode, query each file periodically and display the
+    //  processes which have started or stopped using it.  Process names are
+    //  retained while any file is in use by the process, so only newly
+    //  observed processes need to be opened.
+    //
+
+    if (WatchMode) {
+        CancelHandle = YoriLibCancelGetEvent();
+        while (TRUE) {
+            if (CancelHandle != NULL) {
+                if (WaitForSingleObject(CancelHandle, 1000) == WAIT_OBJECT_0) {
+                    break;
                 }
+            } else {
+                Sleep(1000);
             }
+
+            LsofRefreshAllFiles(&LsofContext, TRUE);
         }
     }
 
-    YoriLibFree(LsofContext.Buffer);
+    LsofCleanupContext(&LsofContext);
 
     return EXIT_SUCCESS;
 }
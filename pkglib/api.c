@@ -30,7 +30,9 @@
 #include "yoripkgp.h"
 
 /**
- Upgrade all installed packages in the system.
+ Upgrade all installed packages in the system.  The set of packages needing
+ upgrade is determined first, so that all of them can be downloaded
+ concurrently while each is prepared for installation in turn.
 
  @param NewArchitecture Optionally points to the new architecture to apply.
         If not specified, the current architecture is retained.
@@ -43,18 +45,20 @@ YoriPkgUpgradeInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING InstalledVersion;
     YORI_STRING UpgradePath;
     YORI_STRING RedirectedPath;
-    DWORD LineLength;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORIPKG_INSTALLED_PACKAGE *Packages;
+    DWORD PackageCount;
+    DWORD PackageIndex;
+    DWORD Index;
     DWORD Error;
     BOOL Result;
     BOOL UpgradeThisPackage;
+    BOOL Added;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
+    YORIPKG_DOWNLOAD_POOL Pool;
 
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
@@ -65,70 +69,107 @@ YoriPkgUpgradeInstalledPackages(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&UpgradePath);
+        return FALSE;
+    }
+
+    //
+    //  Take a snapshot of the installed packages, since upgrading a package
+    //  removes and reinserts its record.
+    //
+
+    if (!YoriPkgCaptureInstalledPackages(Db, &PackageCount, &Packages)) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
         YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&UpgradePath);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
+    if (!YoriPkgInitializeDownloadPool(&Pool, &PkgIniFile, PackageCount)) {
+        YoriPkgFreeCapturedPackages(PackageCount, Packages);
+        YoriPkgCloseInstalledDatabase(Db);
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&UpgradePath);
+        return FALSE;
+    }
 
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    //
+    //  Find the location of each package that needs to be upgraded.  The
+    //  upgrade path is copied into a writable buffer since it may be
+    //  rewritten to refer to a different architecture.
+    //
 
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = _tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-            *Equals = '\0';
-            YoriLibConstantString(&InstalledVersion, Equals + 1);
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-            YoriLibInitEmptyString(&InstalledVersion);
+    for (PackageIndex = 0; PackageIndex < PackageCount; PackageIndex++) {
+        Package = Packages[PackageIndex];
+        if (Package->UpgradePath.LengthInChars == 0 ||
+            Package->UpgradePath.LengthInChars >= UpgradePath.LengthAllocated) {
+
+            continue;
         }
 
-        UpgradePath.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("UpgradePath"), _T(""), UpgradePath.StartOfString, UpgradePath.LengthAllocated, PkgIniFile.StartOfString);
-        if (UpgradePath.LengthInChars > 0) {
-            UpgradeThisPackage = TRUE;
-            YoriLibInitEmptyString(&RedirectedPath);
-            if (NewArchitecture != NULL) {
-                YoriPkgBuildUpgradeLocationForNewArchitecture(&PkgNameOnly, NewArchitecture, &PkgIniFile, &UpgradePath);
+        memcpy(UpgradePath.StartOfString, Package->UpgradePath.StartOfString, Package->UpgradePath.LengthInChars * sizeof(TCHAR));
+        UpgradePath.LengthInChars = Package->UpgradePath.LengthInChars;
+        UpgradePath.StartOfString[UpgradePath.LengthInChars] = '\0';
+
+        UpgradeThisPackage = TRUE;
+        YoriLibInitEmptyString(&RedirectedPath);
+        if (NewArchitecture != NULL) {
+            YoriPkgBuildUpgradeLocationForNewArchitecture(&Package->PackageName, NewArchitecture, &PkgIniFile, &UpgradePath);
+        } else {
+            if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIniFile, &UpgradePath, &Package->InstalledVersion, &RedirectedPath)) {
+                YoriLibFreeStringContents(&RedirectedPath);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &Package->PackageName, &Package->InstalledVersion);
+                UpgradeThisPackage = FALSE;
+            }
+        }
+        if (UpgradeThisPackage) {
+            if (RedirectedPath.LengthInChars > 0) {
+                Added = YoriPkgAddToDownloadPool(&Pool, &RedirectedPath);
+                YoriLibFreeStringContents(&RedirectedPath);
             } else {
-                if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIniFile, &UpgradePath, &InstalledVersion, &RedirectedPath)) {
-                    YoriLibFreeStringContents(&RedirectedPath);
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &PkgNameOnly, &InstalledVersion);
-                    UpgradeThisPackage = FALSE;
-                }
+                Added = YoriPkgAddToDownloadPool(&Pool, &UpgradePath);
             }
-            if (UpgradeThisPackage) {
-                if (RedirectedPath.LengthInChars > 0) {
-                    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &RedirectedPath);
-                    YoriLibFreeStringContents(&RedirectedPath);
-                } else {
-                    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &UpgradePath);
-                }
-                if (Error != ERROR_SUCCESS) {
-                    YoriPkgDisplayErrorStringForInstallFailure(Error);
-                    goto Exit;
-                }
+
+            //
+            //  Only packages in the pool are prepared below, so a package
+            //  that can't be queued would silently not be upgraded.
+            //
+
+            if (!Added) {
+                YoriPkgDisplayErrorStringForInstallFailure(ERROR_NOT_ENOUGH_MEMORY);
+                goto Exit;
             }
         }
-        if (Equals) {
-            *Equals = '=';
-        }
+    }
+
+    //
+    //  Download all of the packages, and prepare each one for installation
+    //  as it arrives.
+    //
 
-        ThisLine += LineLength;
-        ThisLine++;
+    YoriPkgStartDownloadPool(&Pool);
+    PendingPackages.Downloads = &Pool;
+
+    for (Index = 0; Index < Pool.ItemCount; Index++) {
+        Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &Pool.Items[Index].PackagePath);
+        if (Error != ERROR_SUCCESS) {
+            YoriPkgDisplayErrorStringForInstallFailure(Error);
+            goto Exit;
+        }
     }
 
     //
@@ -148,9 +189,12 @@ Exit:
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
+    YoriPkgCleanupDownloadPool(&Pool);
+
+    YoriPkgFreeCapturedPackages(PackageCount, Packages);
+    YoriPkgCloseInstalledDatabase(Db);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&UpgradePath);
 
     return TRUE;
@@ -173,7 +217,9 @@ YoriPkgUpgradeSinglePackage(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING IniValue;
+    YORI_STRING UpgradePath;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
@@ -187,37 +233,57 @@ YoriPkgUpgradeSinglePackage(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(_T("Installed"), PackageName->StartOfString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-    if (IniValue.LengthInChars == 0) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
+        YoriLibFreeStringContents(&UpgradePath);
+        return FALSE;
+    }
+
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&UpgradePath);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("UpgradePath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
+    if (Package->UpgradePath.LengthInChars == 0 ||
+        Package->UpgradePath.LengthInChars >= UpgradePath.LengthAllocated) {
 
-    if (IniValue.LengthInChars == 0) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
+        YoriLibFreeStringContents(&UpgradePath);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify an upgrade path\n"), PackageName);
         return FALSE;
     }
 
+    //
+    //  Copy the upgrade path into a writable buffer, since it may be
+    //  rewritten to refer to a different architecture.
+    //
+
+    memcpy(UpgradePath.StartOfString, Package->UpgradePath.StartOfString, Package->UpgradePath.LengthInChars * sizeof(TCHAR));
+    UpgradePath.LengthInChars = Package->UpgradePath.LengthInChars;
+    UpgradePath.StartOfString[UpgradePath.LengthInChars] = '\0';
+
     if (NewArchitecture != NULL) {
-        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIniFile, &IniValue);
+        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIniFile, &UpgradePath);
     }
 
     Result = FALSE;
-    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &IniValue);
+    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &UpgradePath);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
@@ -231,9 +297,10 @@ Exit:
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
+    YoriPkgCloseInstalledDatabase(Db);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&IniValue);
+    YoriLibFreeStringContents(&UpgradePath);
 
     return Result;
 }
@@ -304,12 +371,11 @@ YoriPkgInstallSourceForInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING SourcePath;
-    DWORD LineLength;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORIPKG_INSTALLED_PACKAGE *Packages;
+    DWORD PackageCount;
+    DWORD PackageIndex;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
@@ -323,53 +389,34 @@ YoriPkgInstallSourceForInstalledPackages(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&SourcePath, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriPkgCaptureInstalledPackages(Db, &PackageCount, &Packages)) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = _tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-            *Equals = '\0';
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-
-        SourcePath.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("SourcePath"), _T(""), SourcePath.StartOfString, SourcePath.LengthAllocated, PkgIniFile.StartOfString);
-        if (SourcePath.LengthInChars > 0) {
-            if (YoriLibIsPathUrl(&SourcePath)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading source for %y from %y...\n"), &PkgNameOnly, &SourcePath);
+    for (PackageIndex = 0; PackageIndex < PackageCount; PackageIndex++) {
+        Package = Packages[PackageIndex];
+        if (Package->SourcePath.LengthInChars > 0) {
+            if (YoriLibIsPathUrl(&Package->SourcePath)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading source for %y from %y...\n"), &Package->PackageName, &Package->SourcePath);
             }
-            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SourcePath, NULL);
+            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &Package->SourcePath, NULL);
             if (Error != ERROR_SUCCESS) {
                 YoriPkgDisplayErrorStringForInstallFailure(Error);
                 goto Exit;
             }
         }
-        if (Equals) {
-            *Equals = '=';
-        }
-
-        ThisLine += LineLength;
-        ThisLine++;
     }
 
     //
@@ -390,9 +437,10 @@ Exit:
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
+    YoriPkgFreeCapturedPackages(PackageCount, Packages);
+    YoriPkgCloseInstalledDatabase(Db);
+
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
-    YoriLibFreeStringContents(&SourcePath);
 
     return TRUE;
 }
@@ -410,7 +458,9 @@ YoriPkgInstallSourceForSinglePackage(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING IniValue;
+    YORI_STRING SourcePath;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
@@ -424,36 +474,43 @@ YoriPkgInstallSourceForSinglePackage(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(_T("Installed"), PackageName->StartOfString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-    if (IniValue.LengthInChars == 0) {
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("SourcePath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-
-    if (IniValue.LengthInChars == 0) {
+    if (Package->SourcePath.LengthInChars == 0) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify a source path\n"), PackageName);
         return FALSE;
     }
 
+    //
+    //  Installing the source may replace the package record, so keep a
+    //  reference to the path.
+    //
+
+    YoriLibCloneString(&SourcePath, &Package->SourcePath);
+
     Result = FALSE;
-    if (YoriLibIsPathUrl(&IniValue)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &IniValue);
+    if (YoriLibIsPathUrl(&SourcePath)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &SourcePath);
     }
-    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &IniValue, NULL);
+    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SourcePath, NULL);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
@@ -467,9 +524,10 @@ Exit:
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
+    YoriPkgCloseInstalledDatabase(Db);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&IniValue);
+    YoriLibFreeStringContents(&SourcePath);
 
     return Result;
 }
@@ -484,13 +542,11 @@ YoriPkgInstallSymbolsForInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING SymbolPath;
-    DWORD LineLength;
-    DWORD TotalCount;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORIPKG_INSTALLED_PACKAGE *Packages;
+    DWORD PackageCount;
+    DWORD PackageIndex;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
@@ -504,55 +560,34 @@ YoriPkgInstallSymbolsForInstalledPackages(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&SymbolPath, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriPkgCaptureInstalledPackages(Db, &PackageCount, &Packages)) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
-    TotalCount = 0;
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = _tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-            *Equals = '\0';
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-
-        SymbolPath.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("SymbolPath"), _T(""), SymbolPath.StartOfString, SymbolPath.LengthAllocated, PkgIniFile.StartOfString);
-        if (SymbolPath.LengthInChars > 0) {
-            if (YoriLibIsPathUrl(&SymbolPath)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading symbols for %y from %y...\n"), &PkgNameOnly, &SymbolPath);
+    for (PackageIndex = 0; PackageIndex < PackageCount; PackageIndex++) {
+        Package = Packages[PackageIndex];
+        if (Package->SymbolPath.LengthInChars > 0) {
+            if (YoriLibIsPathUrl(&Package->SymbolPath)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading symbols for %y from %y...\n"), &Package->PackageName, &Package->SymbolPath);
             }
-            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SymbolPath, NULL);
+            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &Package->SymbolPath, NULL);
             if (Error != ERROR_SUCCESS) {
                 YoriPkgDisplayErrorStringForInstallFailure(Error);
                 goto Exit;
             }
-            TotalCount++;
-        }
-        if (Equals) {
-            *Equals = '=';
         }
-
-        ThisLine += LineLength;
-        ThisLine++;
     }
 
     //
@@ -573,9 +608,10 @@ Exit:
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
+    YoriPkgFreeCapturedPackages(PackageCount, Packages);
+    YoriPkgCloseInstalledDatabase(Db);
+
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
-    YoriLibFreeStringContents(&SymbolPath);
 
     return TRUE;
 }
@@ -593,7 +629,9 @@ YoriPkgInstallSymbolForSinglePackage(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING IniValue;
+    YORI_STRING SymbolPath;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
@@ -607,36 +645,38 @@ YoriPkgInstallSymbolForSinglePackage(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    Error = YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db);
+    if (Error != ERROR_SUCCESS) {
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(_T("Installed"), PackageName->StartOfString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-    if (IniValue.LengthInChars == 0) {
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("SymbolPath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-
-    if (IniValue.LengthInChars == 0) {
+    if (Package->SymbolPath.LengthInChars == 0) {
+        YoriPkgCloseInstalledDatabase(Db);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify a source path\n"), PackageName);
         return FALSE;
     }
 
+    YoriLibCloneString(&SymbolPath, &Package->SymbolPath);
+
     Result = FALSE;
-    if (YoriLibIsPathUrl(&IniValue)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &IniValue);
+    if (YoriLibIsPathUrl(&SymbolPath)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &SymbolPath);
     }
-    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &IniValue, NULL);
+    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SymbolPath, NULL);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
@@ -650,9 +690,10 @@ Exit:
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
+    YoriPkgCloseInstalledDatabase(Db);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&IniValue);
+    YoriLibFreeStringContents(&SymbolPath);
 
     return Result;
 }
@@ -671,64 +712,33 @@ YoriPkgListInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING PkgVersion;
-    YORI_STRING PkgArch;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORI_LIST_ENTRY ListEntry;
 
     if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        YoriLibFreeStringContents(&PkgIniFile);
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&PkgArch, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&InstalledSection);
+    if (YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db) != ERROR_SUCCESS) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    YoriLibInitEmptyString(&PkgVersion);
-    ThisLine = InstalledSection.StartOfString;
-
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-            PkgVersion.StartOfString = Equals + 1;
-            PkgVersion.LengthInChars = _tcslen(Equals + 1);
-        } else {
-            PkgNameOnly.LengthInChars = _tcslen(ThisLine);
-            PkgVersion.StartOfString = NULL;
-            PkgVersion.LengthInChars = 0;
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-
-        PkgArch.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("Architecture"), _T(""), PkgArch.StartOfString, PkgArch.LengthAllocated, PkgIniFile.StartOfString);
+    ListEntry = YoriLibGetNextListEntry(&Db->PackageList, NULL);
+    while (ListEntry != NULL) {
+        Package = CONTAINING_RECORD(ListEntry, YORIPKG_INSTALLED_PACKAGE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Db->PackageList, ListEntry);
 
         if (Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &PkgNameOnly, &PkgVersion, &PkgArch);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &Package->PackageName, &Package->InstalledVersion, &Package->Architecture);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &PkgNameOnly);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &Package->PackageName);
         }
     }
 
+    YoriPkgCloseInstalledDatabase(Db);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
-    YoriLibFreeStringContents(&PkgArch);
 
     return TRUE;
 }
@@ -755,40 +765,39 @@ YoriPkgDeletePackage(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING IniValue;
-    DWORD FileCount;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     BOOL Result;
 
     if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db) != ERROR_SUCCESS) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(_T("Installed"), PackageName->StartOfString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile.StartOfString);
-    if (IniValue.LengthInChars == 0) {
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL) {
         if (WarnIfNotInstalled) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not an installed package\n"), PackageName);
         }
+        YoriPkgCloseInstalledDatabase(Db);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
-    FileCount = GetPrivateProfileInt(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile.StartOfString);
-    if (FileCount == 0) {
+    if (Package->FileCount == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y contains nothing to remove\n"), PackageName);
+        YoriPkgCloseInstalledDatabase(Db);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
     Result = YoriPkgDeletePackageInternal(&PkgIniFile, TargetDirectory, PackageName, FALSE);
+    YoriPkgCloseInstalledDatabase(Db);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&IniValue);
     return Result;
 }
 
@@ -802,25 +811,31 @@ YoriPkgDeleteAllPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE *Packages;
+    DWORD PackageCount;
+    DWORD PackageIndex;
     BOOL Result;
 
     if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db) != ERROR_SUCCESS) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
+    //
+    //  Take a snapshot of the installed packages, since each is removed from
+    //  the database as it is deleted.
+    //
 
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    if (!YoriPkgCaptureInstalledPackages(Db, &PackageCount, &Packages)) {
+        YoriPkgCloseInstalledDatabase(Db);
+        YoriLibFreeStringContents(&PkgIniFile);
+        return FALSE;
+    }
 
     //
     //  First, check whether all packages can be deleted.  If any cannot
@@ -829,61 +844,27 @@ YoriPkgDeleteAllPackages(
     //
 
     Result = TRUE;
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = _tcslen(ThisLine);
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        if (!YoriPkgCheckIfPackageDeleteable(&PkgIniFile, NULL, &PkgNameOnly, TRUE)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
+    for (PackageIndex = 0; PackageIndex < PackageCount; PackageIndex++) {
+        if (!YoriPkgCheckIfPackageDeleteable(&PkgIniFile, NULL, &Packages[PackageIndex]->PackageName, TRUE)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &Packages[PackageIndex]->PackageName);
             Result = FALSE;
             break;
         }
     }
 
-    if (!Result) {
-        YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&InstalledSection);
-
-        return Result;
-    }
-
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
-    Result = TRUE;
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = _tcslen(ThisLine);
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        if (!YoriPkgDeletePackageInternal(&PkgIniFile, NULL, &PkgNameOnly, TRUE)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
-            Result = FALSE;
-            break;
+    if (Result) {
+        for (PackageIndex = 0; PackageIndex < PackageCount; PackageIndex++) {
+            if (!YoriPkgDeletePackageInternal(&PkgIniFile, NULL, &Packages[PackageIndex]->PackageName, TRUE)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &Packages[PackageIndex]->PackageName);
+                Result = FALSE;
+                break;
+            }
         }
     }
 
+    YoriPkgFreeCapturedPackages(PackageCount, Packages);
+    YoriPkgCloseInstalledDatabase(Db);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
 
     return Result;
 }
@@ -921,35 +902,59 @@ YoriPkgInstallPseudoPackage(
     )
 {
     YORI_STRING PkgIniFile;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     DWORD FileIndex;
-    TCHAR FileIndexString[16];
+    BOOL Result;
 
     if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
         return FALSE;
     }
 
-    WritePrivateProfileString(_T("Installed"), Name->StartOfString, Version->StartOfString, PkgIniFile.StartOfString);
-    WritePrivateProfileString(Name->StartOfString, _T("Version"), Version->StartOfString, PkgIniFile.StartOfString);
-    WritePrivateProfileString(Name->StartOfString, _T("Architecture"), Architecture->StartOfString, PkgIniFile.StartOfString);
+    if (YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db) != ERROR_SUCCESS) {
+        YoriLibFreeStringContents(&PkgIniFile);
+        return FALSE;
+    }
+
+    //
+    //  Replace any previous registration so files no longer part of the
+    //  package are not left behind in the record.
+    //
 
-    for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
-        YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
+    Package = YoriPkgFindInstalledPackage(Db, Name);
+    if (Package != NULL) {
+        YoriPkgRemoveInstalledPackage(Db, Package);
+    }
 
-        WritePrivateProfileString(Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString, PkgIniFile.StartOfString);
+    Result = FALSE;
+    Package = YoriPkgAddInstalledPackage(Db, Name);
+    if (Package != NULL &&
+        YoriPkgSetInstalledPackageString(Db, &Package->InstalledVersion, Version) &&
+        YoriPkgSetInstalledPackageString(Db, &Package->Version, Version) &&
+        YoriPkgSetInstalledPackageString(Db, &Package->Architecture, Architecture)) {
+
+        Result = TRUE;
+        for (FileIndex = 0; FileIndex < FileCount; FileIndex++) {
+            if (!YoriPkgAddInstalledPackageFile(Db, Package, &FileArray[FileIndex])) {
+                Result = FALSE;
+                break;
+            }
+        }
     }
-    YoriLibSPrintf(FileIndexString, _T("%i"), FileCount);
-    WritePrivateProfileString(Name->StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
 
+    if (!YoriPkgCloseInstalledDatabase(Db)) {
+        Result = FALSE;
+    }
 
     YoriLibFreeStringContents(&PkgIniFile);
 
-    return TRUE;
+    return Result;
 }
 
 /**
  Remove all installed packages, remove the application directory from the
- path, and attempt to remove the package manager, packages INI file, and
- directory on the next reboot.
+ path, and attempt to remove the package manager, packages INI file,
+ installed package database, and directory on the next reboot.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
@@ -960,6 +965,7 @@ YoriPkgUninstallAll(
     YORI_STRING TargetDirectory;
     YORI_STRING ExecutableFile;
     YORI_STRING PkgIniFile;
+    YORI_STRING DbFile;
     BOOLEAN DelayDeleteFailed;
 
     //
@@ -1004,10 +1010,27 @@ YoriPkgUninstallAll(
 
     YoriPkgRemoveUninstallEntry();
 
-    if (!DeleteFile(PkgIniFile.StartOfString)) {
+    //
+    //  A newly created installation may only have one of these files, so
+    //  the absence of either is not a failure.
+    //
+
+    if (!DeleteFile(PkgIniFile.StartOfString) &&
+        GetLastError() != ERROR_FILE_NOT_FOUND) {
+
         return FALSE;
     }
 
+    if (YoriPkgGetInstalledDatabaseFile(&PkgIniFile, &DbFile)) {
+        if (!DeleteFile(DbFile.StartOfString) &&
+            GetLastError() != ERROR_FILE_NOT_FOUND) {
+
+            YoriLibFreeStringContents(&DbFile);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&DbFile);
+    }
+
     //
     //  Deleting on reboot requires admin, but an unprivileged user can
     //  install yori and then be unable to delete it since it's in use.
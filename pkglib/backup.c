@@ -91,41 +91,38 @@ YoriPkgDeleteRenamedFiles(
 
 /**
  Rename all backed up files back into their original location.  Optionally
- this also restores each file entry back into the INI file.  Note this routine
- is best effort and continues on error.
+ this also records each file against a package in the installed package
+ database.  Note this routine is best effort and continues on error.
 
- @param IniPath Pointer to the system global INI file.
+ @param Db Optionally points to the installed package database.  This is
+        required if Package is specified.
 
- @param PackageBackup Pointer to the backed up package.
+ @param Package Optionally points to an installed package.  If specified,
+        each backed up file is recorded as belonging to this package.  If
+        NULL, the installed package database is not touched.
 
- @param RestoreIni If TRUE, File entries in the INI file are restored to
-        match the names of backed up files.  If FALSE, the INI file is not
-        touched.
+ @param PackageBackup Pointer to the backed up package.
  */
 VOID
 YoriPkgRollbackRenamedFiles(
-    __in PYORI_STRING IniPath,
-    __in PYORIPKG_BACKUP_PACKAGE PackageBackup,
-    __in BOOL RestoreIni
+    __in_opt PYORIPKG_INSTALLED_DB Db,
+    __in_opt PYORIPKG_INSTALLED_PACKAGE Package,
+    __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
     PYORI_LIST_ENTRY ListEntry = NULL;
     PYORIPKG_BACKUP_FILE BackupFile;
-    TCHAR FileIndexString[16];
-    DWORD Index;
     BOOL Result;
 
     ListEntry = YoriLibGetNextListEntry(&PackageBackup->FileList, ListEntry);
-    Index = 1;
     while (ListEntry != NULL) {
         BackupFile = CONTAINING_RECORD(ListEntry, YORIPKG_BACKUP_FILE, ListEntry);
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalName));
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalRelativeName));
 
-        if (RestoreIni) {
-            YoriLibSPrintf(FileIndexString, _T("File%i"), Index);
-            WritePrivateProfileString(PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString, IniPath->StartOfString);
-
+        if (Package != NULL) {
+            ASSERT(Db != NULL);
+            YoriPkgAddInstalledPackageFile(Db, Package, &BackupFile->OriginalRelativeName);
         }
 
         //
@@ -142,7 +139,6 @@ YoriPkgRollbackRenamedFiles(
         }
 
         ListEntry = YoriLibGetNextListEntry(&PackageBackup->FileList, ListEntry);
-        Index++;
         YoriLibRemoveListItem(&BackupFile->ListEntry);
 
         YoriLibFreeStringContents(&BackupFile->BackupName);
@@ -153,8 +149,8 @@ YoriPkgRollbackRenamedFiles(
 
 /**
  Rename all backed up files back into their original location, and restore
- package INI entries to indicate the backed up package is once again
- installed.  Note this routine is best effort and continues on error.
+ the installed package database to indicate the backed up package is once
+ again installed.  Note this routine is best effort and continues on error.
 
  @param IniPath Pointer to the system global INI file.
 
@@ -166,7 +162,8 @@ YoriPkgRollbackPackage(
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
-    TCHAR FileCountString[16];
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
 
     ASSERT(YoriLibIsStringNullTerminated(IniPath));
 
@@ -178,55 +175,43 @@ YoriPkgRollbackPackage(
     ASSERT(PackageBackup->Version.LengthInChars > 0);
     ASSERT(PackageBackup->Architecture.LengthInChars > 0);
 
+    if (YoriPkgOpenInstalledDatabase(IniPath, &Db) != ERROR_SUCCESS) {
+        YoriPkgRollbackRenamedFiles(NULL, NULL, PackageBackup);
+        return;
+    }
+
     //
-    //  Delete the entire existing section.  This will clear out any files
+    //  Delete the entire existing package.  This will clear out any files
     //  added there that aren't part of the backed up package.
     //
 
-    WritePrivateProfileString(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
-
-    //
-    //  Put back the files and recreate their INI entries.
-    //
+    Package = YoriPkgFindInstalledPackage(Db, &PackageBackup->PackageName);
+    if (Package != NULL) {
+        YoriPkgRemoveInstalledPackage(Db, Package);
+    }
 
-    YoriPkgRollbackRenamedFiles(IniPath, PackageBackup, TRUE);
-    YoriLibSPrintf(FileCountString, _T("%i"), PackageBackup->FileCount);
+    Package = YoriPkgAddInstalledPackage(Db, &PackageBackup->PackageName);
 
     //
-    //  Restore all of the fixed headers for the package.
+    //  Put back the files and recreate their database entries.
     //
 
-    WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString, IniPath->StartOfString);
-    WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString, IniPath->StartOfString);
-    WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString, IniPath->StartOfString);
+    YoriPkgRollbackRenamedFiles(Db, Package, PackageBackup);
 
     //
-    //  Restore any optional headers for the package.
+    //  Restore the fields for the package and indicate it is installed.
     //
 
-    if (PackageBackup->UpgradePath.LengthInChars > 0) {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString, IniPath->StartOfString);
-    } else {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), NULL, IniPath->StartOfString);
+    if (Package != NULL) {
+        YoriPkgSetInstalledPackageString(Db, &Package->Version, &PackageBackup->Version);
+        YoriPkgSetInstalledPackageString(Db, &Package->Architecture, &PackageBackup->Architecture);
+        YoriPkgSetInstalledPackageString(Db, &Package->UpgradePath, &PackageBackup->UpgradePath);
+        YoriPkgSetInstalledPackageString(Db, &Package->SourcePath, &PackageBackup->SourcePath);
+        YoriPkgSetInstalledPackageString(Db, &Package->SymbolPath, &PackageBackup->SymbolPath);
+        YoriPkgSetInstalledPackageString(Db, &Package->InstalledVersion, &PackageBackup->Version);
     }
 
-    if (PackageBackup->SourcePath.LengthInChars > 0) {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("SourcePath"), PackageBackup->SourcePath.StartOfString, IniPath->StartOfString);
-    } else {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("SourcePath"), NULL, IniPath->StartOfString);
-    }
-
-    if (PackageBackup->SymbolPath.LengthInChars > 0) {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString, IniPath->StartOfString);
-    } else {
-        WritePrivateProfileString(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), NULL, IniPath->StartOfString);
-    }
-
-    //
-    //  Indicate the package is installed.
-    //
-
-    WritePrivateProfileString(_T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString, IniPath->StartOfString);
+    YoriPkgCloseInstalledDatabase(Db);
 }
 
 /**
@@ -262,14 +247,27 @@ YoriPkgBackupPackage(
 {
     PYORIPKG_BACKUP_PACKAGE Context;
     PYORIPKG_BACKUP_FILE BackupFile;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORI_STRING RelativeFileName;
     YORI_STRING FullTargetDirectory;
-    YORI_STRING IniValue;
     DWORD FileIndex;
     DWORD Err;
-    TCHAR FileIndexString[16];
+
+    Err = YoriPkgOpenInstalledDatabase(IniPath, &Db);
+    if (Err != ERROR_SUCCESS) {
+        return Err;
+    }
+
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
+        return ERROR_FILE_NOT_FOUND;
+    }
 
     Context = YoriLibMalloc(sizeof(YORIPKG_BACKUP_PACKAGE));
     if (Context == NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
         return ERROR_NOT_ENOUGH_MEMORY;
     }
 
@@ -281,76 +279,59 @@ YoriPkgBackupPackage(
     if (TargetDirectory != NULL) {
         if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
             YoriLibFree(Context);
+            YoriPkgCloseInstalledDatabase(Db);
             return ERROR_NOT_ENOUGH_MEMORY;
         }
     } else {
         if (!YoriPkgGetApplicationDirectory(&FullTargetDirectory)) {
             YoriLibFree(Context);
+            YoriPkgCloseInstalledDatabase(Db);
             return ERROR_NOT_ENOUGH_MEMORY;
         }
     }
 
-    if (!YoriLibAllocateString(&Context->PackageName, PackageName->LengthInChars + 1)) {
-        YoriLibFreeStringContents(&FullTargetDirectory);
-        YoriLibFree(Context);
-        return ERROR_NOT_ENOUGH_MEMORY;
-    }
-
-    memcpy(Context->PackageName.StartOfString, PackageName->StartOfString, PackageName->LengthInChars * sizeof(TCHAR));
-    Context->PackageName.LengthInChars = PackageName->LengthInChars;
-    Context->PackageName.StartOfString[PackageName->LengthInChars] = '\0';
-
-    if (!YoriPkgGetInstalledPackageInfo(IniPath, &Context->PackageName, &Context->Version, &Context->Architecture, &Context->UpgradePath, &Context->SourcePath, &Context->SymbolPath)) {
-        YoriLibFreeStringContents(&FullTargetDirectory);
-        YoriPkgFreeBackupPackage(Context);
-        return ERROR_NOT_ENOUGH_MEMORY;
-    }
-
-    Context->FileCount = GetPrivateProfileInt(Context->PackageName.StartOfString, _T("FileCount"), 0, IniPath->StartOfString);
-    if (Context->FileCount == 0) {
-        Err = GetLastError();
-        YoriLibFreeStringContents(&FullTargetDirectory);
-        YoriPkgFreeBackupPackage(Context);
-        return Err;
-    }
-
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&FullTargetDirectory);
-        YoriPkgFreeBackupPackage(Context);
-        return ERROR_NOT_ENOUGH_MEMORY;
-    }
+    //
+    //  The installed package's strings are NULL terminated allocations, so
+    //  the backup can share them.
+    //
 
-    for (FileIndex = 1; FileIndex <= Context->FileCount; FileIndex++) {
-        YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
+    YoriLibCloneString(&Context->PackageName, &Package->PackageName);
+    YoriLibCloneString(&Context->Version, &Package->Version);
+    YoriLibCloneString(&Context->Architecture, &Package->Architecture);
+    YoriLibCloneString(&Context->UpgradePath, &Package->UpgradePath);
+    YoriLibCloneString(&Context->SourcePath, &Package->SourcePath);
+    YoriLibCloneString(&Context->SymbolPath, &Package->SymbolPath);
+    Context->FileCount = Package->FileCount;
 
-        IniValue.LengthInChars = GetPrivateProfileString(Context->PackageName.StartOfString, FileIndexString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniPath->StartOfString);
+    for (FileIndex = 0; FileIndex < Package->FileCount; FileIndex++) {
+        RelativeFileName = &Package->Files[FileIndex]->RelativeFileName;
 
         //
         //  Don't backup files with absolute paths
         //
 
-        if (YoriLibIsPathPrefixed(&IniValue)) {
+        if (YoriLibIsPathPrefixed(RelativeFileName)) {
             continue;
         }
 
         BackupFile = YoriLibReferencedMalloc(sizeof(YORIPKG_BACKUP_FILE));
         if (BackupFile == NULL) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, NULL, Context);
             YoriLibFreeStringContents(&FullTargetDirectory);
-            YoriLibFreeStringContents(&IniValue);
             YoriPkgFreeBackupPackage(Context);
+            YoriPkgCloseInstalledDatabase(Db);
             return ERROR_NOT_ENOUGH_MEMORY;
         }
 
         ZeroMemory(BackupFile, sizeof(YORIPKG_BACKUP_FILE));
 
-        YoriLibYPrintf(&BackupFile->OriginalName, _T("%y\\%y"), &FullTargetDirectory, &IniValue);
+        YoriLibYPrintf(&BackupFile->OriginalName, _T("%y\\%y"), &FullTargetDirectory, RelativeFileName);
         if (BackupFile->OriginalName.LengthInChars == 0) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, NULL, Context);
             YoriLibFreeStringContents(&FullTargetDirectory);
-            YoriLibFreeStringContents(&IniValue);
             YoriLibDereference(BackupFile);
             YoriPkgFreeBackupPackage(Context);
+            YoriPkgCloseInstalledDatabase(Db);
             return ERROR_NOT_ENOUGH_MEMORY;
         }
 
@@ -362,12 +343,12 @@ YoriPkgBackupPackage(
         if (!YoriLibRenameFileToBackupName(&BackupFile->OriginalName, &BackupFile->BackupName)) {
             Err = GetLastError();
             if (Err != ERROR_FILE_NOT_FOUND) {
-                YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+                YoriPkgRollbackRenamedFiles(NULL, NULL, Context);
                 YoriLibFreeStringContents(&BackupFile->OriginalName);
                 YoriLibFreeStringContents(&FullTargetDirectory);
-                YoriLibFreeStringContents(&IniValue);
                 YoriLibDereference(BackupFile);
                 YoriPkgFreeBackupPackage(Context);
+                YoriPkgCloseInstalledDatabase(Db);
                 return Err;
             }
         }
@@ -376,18 +357,20 @@ YoriPkgBackupPackage(
 
     }
     YoriLibFreeStringContents(&FullTargetDirectory);
-    YoriLibFreeStringContents(&IniValue);
+    YoriPkgCloseInstalledDatabase(Db);
 
     *PackageBackup = Context;
     return ERROR_SUCCESS;
 }
 
 /**
- Remove any references to a package from the INI file.  This is used once a
- backup has been generated, so all of these values can be restored.  It ensures
- the INI file is clean in preparation for a subsequent package installation.
+ Remove a package from the installed package database.  This is used once a
+ backup has been generated, so all of these values can be restored.  It
+ ensures the database is clean in preparation for a subsequent package
+ installation.
 
- @param IniPath Pointer to the INI file name to remove all entries from.
+ @param IniPath Pointer to the INI file name whose installed package database
+        should have the package removed.
 
  @param PackageBackup Pointer to a package backup structure.  All that's
         needed here is the package name, but the structure is used to 
@@ -399,8 +382,19 @@ YoriPkgRemoveSystemReferencesToPackage(
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
-    WritePrivateProfileString(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
-    WritePrivateProfileString(_T("Installed"), PackageBackup->PackageName.StartOfString, NULL, IniPath->StartOfString);
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+
+    if (YoriPkgOpenInstalledDatabase(IniPath, &Db) != ERROR_SUCCESS) {
+        return;
+    }
+
+    Package = YoriPkgFindInstalledPackage(Db, &PackageBackup->PackageName);
+    if (Package != NULL) {
+        YoriPkgRemoveInstalledPackage(Db, Package);
+    }
+
+    YoriPkgCloseInstalledDatabase(Db);
 }
 
 /**
@@ -468,172 +462,6 @@ YoriPkgCommitAndFreeBackupPackageList(
     }
 }
 
-/**
- Add a currently installed file into the installed files hash table.
-
- @param PendingPackages Pointer to the set of packages to install that is
-        being populated with information about currently installed files.
-
- @param RelativeFileName Pointer to the file to insert into the hash table.
-        Note this function will allocate space and copy the file name into it,
-        so the buffer is available for the caller to reuse after this function
-        returns.
-
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOL
-YoriPkgAddExistingFileToPendingPackages(
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
-    __in PYORI_STRING RelativeFileName
-    )
-{
-    PYORIPKG_EXISTING_FILE ExistingFile;
-
-    ExistingFile = YoriLibReferencedMalloc(sizeof(YORIPKG_EXISTING_FILE) + (RelativeFileName->LengthInChars + 1) * sizeof(TCHAR));
-    if (ExistingFile == NULL) {
-        return FALSE;
-    }
-
-    YoriLibInitEmptyString(&ExistingFile->RelativeFileName);
-    ExistingFile->RelativeFileName.MemoryToFree = ExistingFile;
-    ExistingFile->RelativeFileName.StartOfString = (LPTSTR)(ExistingFile + 1);
-    ExistingFile->RelativeFileName.LengthInChars = RelativeFileName->LengthInChars;
-    memcpy(ExistingFile->RelativeFileName.StartOfString, RelativeFileName->StartOfString, RelativeFileName->LengthInChars * sizeof(TCHAR));
-    ExistingFile->RelativeFileName.StartOfString[ExistingFile->RelativeFileName.LengthInChars] = '\0';
-    ExistingFile->RelativeFileName.LengthAllocated = RelativeFileName->LengthInChars + 1;
-
-    YoriLibHashInsertByKey(PendingPackages->ExistingFilesTable, &ExistingFile->RelativeFileName, ExistingFile, &ExistingFile->HashEntry);
-    return TRUE;
-}
-
-/**
- Free the contents of the currently installed files hash table.
-
- @param PendingPackages Pointer to the set of packages to install that has
-        been populated with currently installed file information.
- */
-VOID
-YoriPkgFreeExistingFiles(
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
-    )
-{
-    DWORD BucketIndex;
-    PYORI_HASH_BUCKET Bucket;
-    PYORIPKG_EXISTING_FILE ExistingFile;
-
-    for (BucketIndex = 0; BucketIndex < PendingPackages->ExistingFilesTable->NumberBuckets; BucketIndex++) {
-        Bucket = &PendingPackages->ExistingFilesTable->Buckets[BucketIndex];
-        while (!YoriLibIsListEmpty(&Bucket->ListHead)) {
-            ExistingFile = CONTAINING_RECORD(Bucket->ListHead.Next, YORIPKG_EXISTING_FILE, HashEntry.ListEntry);
-            YoriLibHashRemoveByEntry(&ExistingFile->HashEntry);
-            YoriLibDereference(ExistingFile);
-        }
-    }
-}
-
-/**
- Check if a file that is being installed already exists on the system.
-
- @param PendingPackages Pointer to a set of packages to install that has been
-        populated with currently installed file information.
-
- @param FileName Pointer to a relative file name to check for.
-
- @return TRUE if the file is already installed by some package, FALSE if it is
-         not.
- */
-BOOL
-YoriPkgCheckIfFileAlreadyExists(
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
-    __in PYORI_STRING FileName
-    )
-{
-    if (YoriLibHashLookupByKey(PendingPackages->ExistingFilesTable, FileName) != NULL) {
-        return TRUE;
-    }
-    return FALSE;
-}
-
-
-/**
- Scan through all installed packages, and within each, all installed files,
- and populate the hash table with files that are installed by any package.
- Note that in the normal installation flow, any package being upgraded or
- replaced has already been moved aside by this point, so the only files that
- appear to be installed are those from packages which will remain after this
- installation operation is complete.
-
- @param PkgIniFile Pointer to the system global INI file.
-
- @param PendingPackages Pointer to the packages to install which will be
-        populated with currently installed file information.
-
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOL
-YoriPkgAddExistingFilesToPendingPackages(
-    __in PYORI_STRING PkgIniFile,
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
-    )
-{
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING IniValue;
-    DWORD LineLength;
-    DWORD FileCount;
-    DWORD FileIndex;
-    TCHAR FileIndexString[16];
-
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&InstalledSection);
-        return FALSE;
-    }
-
-    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, PkgIniFile->StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        LineLength = _tcslen(ThisLine);
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-        ThisLine += LineLength;
-        ThisLine++;
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-
-        FileCount = GetPrivateProfileInt(PkgNameOnly.StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
-
-        for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
-            YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
-
-            IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, FileIndexString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile->StartOfString);
-            if (!YoriPkgAddExistingFileToPendingPackages(PendingPackages, &IniValue)) {
-                YoriLibFreeStringContents(&InstalledSection);
-                YoriLibFreeStringContents(&IniValue);
-                return FALSE;
-            }
-        }
-    }
-
-    YoriLibFreeStringContents(&InstalledSection);
-    YoriLibFreeStringContents(&IniValue);
-
-    return TRUE;
-}
-
-
 /**
  Initialize a list of pending packages, including the list of packages to
  install and the list of packages that have been packed up.
@@ -650,10 +478,7 @@ YoriPkgInitializePendingPackages(
     YoriLibInitializeListHead(&PendingPackages->PackageList);
     YoriLibInitializeListHead(&PendingPackages->BackupPackages);
     YoriLibInitializeListHead(&PendingPackages->KnownPackages);
-    PendingPackages->ExistingFilesTable = YoriLibAllocateHashTable(253);
-    if (PendingPackages->ExistingFilesTable == NULL) {
-        return FALSE;
-    }
+    PendingPackages->Downloads = NULL;
     return TRUE;
 }
 
@@ -720,12 +545,6 @@ YoriPkgDeletePendingPackages(
         YoriLibRemoveListItem(&PendingPackage->PackageList);
         YoriPkgDeletePendingPackage(PendingPackage);
     }
-
-    if (PendingPackages->ExistingFilesTable != NULL) {
-        YoriPkgFreeExistingFiles(PendingPackages);
-        YoriLibFreeEmptyHashTable(PendingPackages->ExistingFilesTable);
-        PendingPackages->ExistingFilesTable = NULL;
-    }
 }
 
 /**
@@ -775,7 +594,6 @@ YoriPkgPreparePackageForInstall(
     YORI_STRING TempPath;
     YORI_STRING ErrorString;
     YORI_STRING ReplacesList;
-    YORI_STRING PkgInstalled;
     YORI_STRING PkgToReplace;
     DWORD LineLength;
     LONGLONG RequiredBuildNumber;
@@ -783,8 +601,11 @@ YoriPkgPreparePackageForInstall(
     LPTSTR ThisLine;
     LPTSTR Equals;
     PYORIPKG_BACKUP_PACKAGE BackupPackage;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE InstalledPackage;
     DWORD Result = ERROR_SUCCESS;
 
+    Db = NULL;
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
     if (RedirectToPackageUrl != NULL) {
         YoriLibInitEmptyString(RedirectToPackageUrl);
@@ -795,7 +616,17 @@ YoriPkgPreparePackageForInstall(
         return ERROR_NOT_ENOUGH_MEMORY;
     }
     ZeroMemory(PendingPackage, sizeof(YORIPKG_PACKAGE_PENDING_INSTALL));
-    Result = YoriPkgPackagePathToLocalPath(PackageUrl, PkgIniFile, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+
+    //
+    //  If the package is being downloaded in the background, wait for that
+    //  download rather than starting another one.
+    //
+
+    if (PackageList->Downloads == NULL ||
+        !YoriPkgTakeDownloadedPackage(PackageList->Downloads, PackageUrl, &Result, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath)) {
+
+        Result = YoriPkgPackagePathToLocalPath(PackageUrl, PkgIniFile, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+    }
     if (Result != ERROR_SUCCESS) {
         YoriLibFree(PendingPackage);
         return Result;
@@ -850,20 +681,22 @@ YoriPkgPreparePackageForInstall(
     //  is already present.  If it is, we need to delete it.
     //
 
-    if (!YoriLibAllocateString(&PkgInstalled, YORIPKG_MAX_FIELD_LENGTH)) {
-        Result = ERROR_NOT_ENOUGH_MEMORY;
+    Result = YoriPkgOpenInstalledDatabase(PkgIniFile, &Db);
+    if (Result != ERROR_SUCCESS) {
+        Db = NULL;
         goto Exit;
     }
 
-    PkgInstalled.LengthInChars = GetPrivateProfileString(_T("Installed"), PendingPackage->PackageName.StartOfString, _T(""), PkgInstalled.StartOfString, PkgInstalled.LengthAllocated, PkgIniFile->StartOfString);
+    InstalledPackage = YoriPkgFindInstalledPackage(Db, &PendingPackage->PackageName);
 
     //
     //  If the version being installed is already there, we're done.
     //
 
-    if (YoriLibCompareString(&PkgInstalled, &PendingPackage->Version) == 0) {
+    if (InstalledPackage != NULL &&
+        YoriLibCompareString(&InstalledPackage->InstalledVersion, &PendingPackage->Version) == 0) {
+
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &PendingPackage->PackageName, &PendingPackage->Version);
-        YoriLibFreeStringContents(&PkgInstalled);
         Result = ERROR_SUCCESS;
         goto Exit;
     }
@@ -888,7 +721,6 @@ YoriPkgPreparePackageForInstall(
                 YoriLibCloneString(RedirectToPackageUrl, &PendingPackage->PackagePathForOlderBuilds);
             }
             Result = ERROR_OLD_WIN_VERSION;
-            YoriLibFreeStringContents(&PkgInstalled);
             goto Exit;
         }
     }
@@ -897,10 +729,9 @@ YoriPkgPreparePackageForInstall(
     //  Backup the current version
     //
 
-    if (PkgInstalled.LengthInChars > 0) {
+    if (InstalledPackage != NULL) {
         Result = YoriPkgBackupPackage(PkgIniFile, &PendingPackage->PackageName, TargetDirectory, &BackupPackage);
         if (Result != ERROR_SUCCESS) {
-            YoriLibFreeStringContents(&PkgInstalled);
             goto Exit;
         }
         YoriPkgRemoveSystemReferencesToPackage(PkgIniFile, BackupPackage);
@@ -913,7 +744,6 @@ YoriPkgPreparePackageForInstall(
     //
 
     if (!YoriLibAllocateString(&ReplacesList, YORIPKG_MAX_SECTION_LENGTH)) {
-        YoriLibFreeStringContents(&PkgInstalled);
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
     }
@@ -938,8 +768,7 @@ YoriPkgPreparePackageForInstall(
         //  is installed, and if so, back it up too
         //
 
-        PkgInstalled.LengthInChars = GetPrivateProfileString(_T("Installed"), PkgToReplace.StartOfString, _T(""), PkgInstalled.StartOfString, PkgInstalled.LengthAllocated, PkgIniFile->StartOfString);
-        if (PkgInstalled.LengthInChars > 0) {
+        if (YoriPkgFindInstalledPackage(Db, &PkgToReplace) != NULL) {
             Result = YoriPkgBackupPackage(PkgIniFile, &PkgToReplace, TargetDirectory, &BackupPackage);
             if (Result != ERROR_SUCCESS) {
                 YoriLibFreeStringContents(&ReplacesList);
@@ -951,7 +780,7 @@ YoriPkgPreparePackageForInstall(
         ThisLine += LineLength + 1;
     }
     YoriLibFreeStringContents(&ReplacesList);
-    YoriLibFreeStringContents(&PkgInstalled);
+    YoriPkgCloseInstalledDatabase(Db);
 
     DeleteFile(TempPath.StartOfString);
     YoriLibFreeStringContents(&TempPath);
@@ -961,6 +790,9 @@ YoriPkgPreparePackageForInstall(
 
 Exit:
 
+    if (Db != NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
+    }
     if (TempPath.LengthInChars > 0) {
         DeleteFile(TempPath.StartOfString);
     }
@@ -264,6 +264,18 @@ typedef struct _YORIPKG_CREATE_SOURCE_CONTEXT {
      ExcludeList.
      */
     YORI_LIST_ENTRY IncludeList;
+
+    /**
+     The criteria in ExcludeList compiled into a single set, or NULL if
+     there are no criteria to exclude.
+     */
+    PYORILIB_GLOB_SET ExcludeSet;
+
+    /**
+     The criteria in IncludeList compiled into a single set, or NULL if
+     there are no criteria to include.
+     */
+    PYORILIB_GLOB_SET IncludeSet;
 } YORIPKG_CREATE_SOURCE_CONTEXT, *PYORIPKG_CREATE_SOURCE_CONTEXT;
 
 /**
@@ -328,6 +340,72 @@ YoriPkgCreateSourceFreeMatchLists(
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, NULL);
     }
+
+    if (CreateSourceContext->ExcludeSet != NULL) {
+        YoriLibGlobSetFree(CreateSourceContext->ExcludeSet);
+        CreateSourceContext->ExcludeSet = NULL;
+    }
+
+    if (CreateSourceContext->IncludeSet != NULL) {
+        YoriLibGlobSetFree(CreateSourceContext->IncludeSet);
+        CreateSourceContext->IncludeSet = NULL;
+    }
+}
+
+/**
+ Compile a list of exclude or include criteria into a single set that can
+ be tested against each file with one query.
+
+ @param List Pointer to the list of criteria.
+
+ @param GlobSet On successful completion, updated to point to the compiled
+        set, or NULL if the list contains no criteria.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgCreateSourceCompileMatchList(
+    __in PYORI_LIST_ENTRY List,
+    __out PYORILIB_GLOB_SET *GlobSet
+    )
+{
+    PYORIPKG_MATCH_ITEM MatchItem;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_STRING Patterns;
+    DWORD PatternCount;
+    BOOL Result;
+
+    *GlobSet = NULL;
+
+    PatternCount = 0;
+    ListEntry = YoriLibGetNextListEntry(List, NULL);
+    while (ListEntry != NULL) {
+        PatternCount++;
+        ListEntry = YoriLibGetNextListEntry(List, ListEntry);
+    }
+
+    if (PatternCount == 0) {
+        return TRUE;
+    }
+
+    Patterns = YoriLibMalloc(PatternCount * sizeof(YORI_STRING));
+    if (Patterns == NULL) {
+        return FALSE;
+    }
+
+    PatternCount = 0;
+    ListEntry = YoriLibGetNextListEntry(List, NULL);
+    while (ListEntry != NULL) {
+        MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
+        memcpy(&Patterns[PatternCount], &MatchItem->MatchCriteria, sizeof(YORI_STRING));
+        PatternCount++;
+        ListEntry = YoriLibGetNextListEntry(List, ListEntry);
+    }
+
+    Result = YoriLibGlobSetCompile(Patterns, PatternCount, GlobSet);
+    YoriLibFree(Patterns);
+    return Result;
 }
 
 /**
@@ -348,27 +426,19 @@ YoriPkgCreateSourceShouldExclude(
     __in PYORI_STRING RelativeSourcePath
     )
 {
-    PYORIPKG_MATCH_ITEM MatchItem;
-    PYORI_LIST_ENTRY ListEntry;
+    if (CreateSourceContext->ExcludeSet == NULL ||
+        !YoriLibGlobSetMatch(CreateSourceContext->ExcludeSet, RelativeSourcePath, NULL)) {
 
-    ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->ExcludeList, NULL);
-    while (ListEntry != NULL) {
-        MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
+        return FALSE;
+    }
 
-            ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, NULL);
-            while (ListEntry != NULL) {
-                MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
-                    return FALSE;
-                }
-                ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, ListEntry);
-            }
-            return TRUE;
-        }
-        ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->ExcludeList, ListEntry);
+    if (CreateSourceContext->IncludeSet != NULL &&
+        YoriLibGlobSetMatch(CreateSourceContext->IncludeSet, RelativeSourcePath, NULL)) {
+
+        return FALSE;
     }
-    return FALSE;
+
+    return TRUE;
 }
 
 /**
@@ -643,6 +713,14 @@ YoriPkgCreateSourcePackage(
     CreateSourceContext.PackageName = PackageName;
     CreateSourceContext.PackageVersion = Version;
 
+    if (!YoriPkgCreateSourceCompileMatchList(&CreateSourceContext.ExcludeList, &CreateSourceContext.ExcludeSet) ||
+        !YoriPkgCreateSourceCompileMatchList(&CreateSourceContext.IncludeList, &CreateSourceContext.IncludeSet)) {
+
+        YoriLibCloseCab(CreateSourceContext.CabHandle);
+        YoriPkgCreateSourceFreeMatchLists(&CreateSourceContext);
+        return FALSE;
+    }
+
     YoriLibForEachFile(FileRoot,
                        YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS | YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_NO_LINK_TRAVERSE,
                        0,
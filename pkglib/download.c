@@ -0,0 +1,369 @@
+/**
+ * @file pkglib/download.c
+ *
+ * Yori package manager background download pool
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "yoripkgp.h"
+
+/**
+ Initialize a pool of packages to download in the background.
+
+ @param Pool Pointer to the pool to initialize.
+
+ @param IniFilePath Optionally points to the system INI file, allowing
+        mirrors to be applied to each download.  This must remain valid until
+        the pool is cleaned up.
+
+ @param MaximumItems The maximum number of items that can be added to the
+        pool.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgInitializeDownloadPool(
+    __out PYORIPKG_DOWNLOAD_POOL Pool,
+    __in_opt PYORI_STRING IniFilePath,
+    __in DWORD MaximumItems
+    )
+{
+#if DBG
+    YORI_STRING DelayString;
+    LONGLONG Delay;
+    DWORD CharsConsumed;
+#endif
+
+    ZeroMemory(Pool, sizeof(YORIPKG_DOWNLOAD_POOL));
+    Pool->IniFilePath = IniFilePath;
+
+    if (MaximumItems > 0) {
+        Pool->Items = YoriLibMalloc(MaximumItems * sizeof(YORIPKG_DOWNLOAD_ITEM));
+        if (Pool->Items == NULL) {
+            return FALSE;
+        }
+        ZeroMemory(Pool->Items, MaximumItems * sizeof(YORIPKG_DOWNLOAD_ITEM));
+    }
+    Pool->ItemsAllocated = MaximumItems;
+
+#if DBG
+    //
+    //  Allow a delay to be injected before each download so that the
+    //  overlap between downloading and installing can be observed against
+    //  local or otherwise fast sources.
+    //
+
+    if (YoriLibAllocateAndGetEnvironmentVariable(_T("YPM_DEBUG_DOWNLOAD_DELAY"), &DelayString)) {
+        if (YoriLibStringToNumber(&DelayString, FALSE, &Delay, &CharsConsumed) &&
+            CharsConsumed > 0 &&
+            Delay > 0) {
+
+            Pool->DebugDelay = (DWORD)Delay;
+        }
+        YoriLibFreeStringContents(&DelayString);
+    }
+#endif
+
+    return TRUE;
+}
+
+/**
+ Add a package or package list to a pool of items to download.  Items must
+ be added before the pool is started.
+
+ @param Pool Pointer to the pool.
+
+ @param PackagePath Pointer to the path or URL to download.
+
+ @return TRUE to indicate the item was added, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriPkgAddToDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in PYORI_STRING PackagePath
+    )
+{
+    PYORIPKG_DOWNLOAD_ITEM Item;
+
+    ASSERT(Pool->ThreadCount == 0);
+    if (Pool->ItemCount >= Pool->ItemsAllocated) {
+        return FALSE;
+    }
+
+    Item = &Pool->Items[Pool->ItemCount];
+    Item->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Item->CompleteEvent == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Item->PackagePath, PackagePath->LengthInChars + 1)) {
+        CloseHandle(Item->CompleteEvent);
+        Item->CompleteEvent = NULL;
+        return FALSE;
+    }
+
+    memcpy(Item->PackagePath.StartOfString, PackagePath->StartOfString, PackagePath->LengthInChars * sizeof(TCHAR));
+    Item->PackagePath.StartOfString[PackagePath->LengthInChars] = '\0';
+    Item->PackagePath.LengthInChars = PackagePath->LengthInChars;
+
+    Pool->ItemCount++;
+    return TRUE;
+}
+
+/**
+ Download a single item from the pool and indicate that it is complete.
+
+ @param Pool Pointer to the pool.
+
+ @param Item Pointer to the item to download.
+ */
+VOID
+YoriPkgDownloadPoolItem(
+    __in PYORIPKG_DOWNLOAD_POOL Pool,
+    __in PYORIPKG_DOWNLOAD_ITEM Item
+    )
+{
+#if DBG
+    if (Pool->DebugDelay > 0) {
+        Sleep(Pool->DebugDelay);
+    }
+#endif
+
+    YoriLibInitEmptyString(&Item->LocalPath);
+    Item->DeleteWhenFinished = FALSE;
+    Item->Result = YoriPkgPackagePathToLocalPath(&Item->PackagePath, Pool->IniFilePath, &Item->LocalPath, &Item->DeleteWhenFinished);
+    SetEvent(Item->CompleteEvent);
+}
+
+/**
+ A background thread which downloads items from the pool in order until all
+ items have been downloaded or the pool is cancelled.
+
+ @param Context Pointer to the pool.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriPkgDownloadWorker(
+    __in LPVOID Context
+    )
+{
+    PYORIPKG_DOWNLOAD_POOL Pool = (PYORIPKG_DOWNLOAD_POOL)Context;
+    DWORD Index;
+
+    while (!Pool->Cancelled) {
+        Index = InterlockedIncrement((LONG *)&Pool->NextItem) - 1;
+        if (Index >= Pool->ItemCount) {
+            break;
+        }
+
+        YoriPkgDownloadPoolItem(Pool, &Pool->Items[Index]);
+    }
+
+    return 0;
+}
+
+/**
+ Begin downloading the items in a pool on background threads.  If threads
+ cannot be created, items are downloaded on the calling thread as they are
+ waited for.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriPkgStartDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool
+    )
+{
+    DWORD ThreadId;
+    DWORD ThreadsNeeded;
+
+    //
+    //  Resolve WinInet on this thread so the workers don't race to
+    //  populate its function pointers.
+    //
+
+    YoriLibLoadWinInetFunctions();
+
+    ThreadsNeeded = Pool->ItemCount;
+    if (ThreadsNeeded > YORIPKG_DOWNLOAD_THREADS) {
+        ThreadsNeeded = YORIPKG_DOWNLOAD_THREADS;
+    }
+
+    while (Pool->ThreadCount < ThreadsNeeded) {
+        Pool->Threads[Pool->ThreadCount] = CreateThread(NULL, 0, YoriPkgDownloadWorker, Pool, 0, &ThreadId);
+        if (Pool->Threads[Pool->ThreadCount] == NULL) {
+            break;
+        }
+        Pool->ThreadCount++;
+    }
+}
+
+/**
+ Wait for an item in the pool to finish downloading and take ownership of
+ the downloaded file.
+
+ @param Pool Pointer to the pool.
+
+ @param Index The index of the item, in the order items were added.
+
+ @param LocalPath On successful completion, populated with a fully qualified
+        local path to the downloaded file.
+
+ @param DeleteWhenFinished On successful completion, set to TRUE to indicate
+        the caller should delete the file (it is temporary); set to FALSE to
+        indicate the file should be retained.
+
+ @return ERROR_SUCCESS to indicate success, or other Win32 error to indicate
+         the type of failure.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgWaitForDownload(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in DWORD Index,
+    __out PYORI_STRING LocalPath,
+    __out PBOOL DeleteWhenFinished
+    )
+{
+    PYORIPKG_DOWNLOAD_ITEM Item;
+
+    ASSERT(Index < Pool->ItemCount);
+    Item = &Pool->Items[Index];
+    ASSERT(!Item->Claimed);
+
+    //
+    //  If no workers could be created, perform the download here.
+    //
+
+    if (Pool->ThreadCount == 0) {
+        YoriPkgDownloadPoolItem(Pool, Item);
+    } else {
+        WaitForSingleObject(Item->CompleteEvent, INFINITE);
+    }
+
+    Item->Claimed = TRUE;
+    if (Item->Result != ERROR_SUCCESS) {
+        return Item->Result;
+    }
+
+    memcpy(LocalPath, &Item->LocalPath, sizeof(YORI_STRING));
+    YoriLibInitEmptyString(&Item->LocalPath);
+    *DeleteWhenFinished = Item->DeleteWhenFinished;
+    return ERROR_SUCCESS;
+}
+
+/**
+ If a package is in the pool, wait for it to finish downloading and take
+ ownership of the downloaded file.
+
+ @param Pool Pointer to the pool.
+
+ @param PackagePath Pointer to the path or URL of the package.
+
+ @param Result On successful completion, populated with the result of the
+        download.
+
+ @param LocalPath On successful completion, if Result is ERROR_SUCCESS,
+        populated with a fully qualified local path to the downloaded file.
+
+ @param DeleteWhenFinished On successful completion, if Result is
+        ERROR_SUCCESS, set to TRUE to indicate the caller should delete the
+        file (it is temporary); set to FALSE to indicate the file should be
+        retained.
+
+ @return TRUE to indicate the package was found in the pool, FALSE if it was
+         not, in which case the caller needs to download it.
+ */
+__success(return)
+BOOL
+YoriPkgTakeDownloadedPackage(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in PYORI_STRING PackagePath,
+    __out PDWORD Result,
+    __out PYORI_STRING LocalPath,
+    __out PBOOL DeleteWhenFinished
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Pool->ItemCount; Index++) {
+        if (!Pool->Items[Index].Claimed &&
+            YoriLibCompareString(&Pool->Items[Index].PackagePath, PackagePath) == 0) {
+
+            *Result = YoriPkgWaitForDownload(Pool, Index, LocalPath, DeleteWhenFinished);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Stop any downloads which have not yet started, wait for downloads in
+ progress to complete, delete any temporary files that were not claimed, and
+ free the contents of the pool.  The pool structure itself is not freed.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriPkgCleanupDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool
+    )
+{
+    DWORD Index;
+    PYORIPKG_DOWNLOAD_ITEM Item;
+
+    Pool->Cancelled = TRUE;
+    if (Pool->ThreadCount > 0) {
+        WaitForMultipleObjects(Pool->ThreadCount, Pool->Threads, TRUE, INFINITE);
+        for (Index = 0; Index < Pool->ThreadCount; Index++) {
+            CloseHandle(Pool->Threads[Index]);
+            Pool->Threads[Index] = NULL;
+        }
+        Pool->ThreadCount = 0;
+    }
+
+    for (Index = 0; Index < Pool->ItemCount; Index++) {
+        Item = &Pool->Items[Index];
+        if (Item->DeleteWhenFinished && Item->LocalPath.LengthInChars > 0) {
+            DeleteFile(Item->LocalPath.StartOfString);
+        }
+        YoriLibFreeStringContents(&Item->LocalPath);
+        YoriLibFreeStringContents(&Item->PackagePath);
+        CloseHandle(Item->CompleteEvent);
+    }
+
+    if (Pool->Items != NULL) {
+        YoriLibFree(Pool->Items);
+        Pool->Items = NULL;
+    }
+    Pool->ItemCount = 0;
+    Pool->ItemsAllocated = 0;
+}
+
+// vim:sw=4:ts=4:et:
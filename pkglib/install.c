@@ -128,25 +128,32 @@ YoriPkgCheckIfPackageDeleteable(
     )
 {
     YORI_STRING AppPath;
-    YORI_STRING IniValue;
     YORI_STRING FileToDelete;
     PYORI_STRING FileBeingDeleted;
-    DWORD FileCount;
+    PYORI_STRING RelativeFileName;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     DWORD FileIndex;
-    TCHAR FileIndexString[16];
     BOOL DeleteResult;
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (YoriPkgOpenInstalledDatabase(PkgIniFile, &Db) != ERROR_SUCCESS) {
+        return FALSE;
+    }
+
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL || Package->FileCount == 0) {
+        YoriPkgCloseInstalledDatabase(Db);
         return FALSE;
     }
 
     if (TargetDirectory == NULL) {
         if (!YoriPkgGetApplicationDirectory(&AppPath)) {
-            YoriLibFreeStringContents(&IniValue);
+            YoriPkgCloseInstalledDatabase(Db);
             return FALSE;
         }
     } else {
         if (!YoriLibAllocateString(&AppPath, TargetDirectory->LengthInChars + MAX_PATH)) {
+            YoriPkgCloseInstalledDatabase(Db);
             return FALSE;
         }
         memcpy(AppPath.StartOfString, TargetDirectory->StartOfString, TargetDirectory->LengthInChars * sizeof(TCHAR));
@@ -154,30 +161,21 @@ YoriPkgCheckIfPackageDeleteable(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    FileCount = GetPrivateProfileInt(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
-    if (FileCount == 0) {
-        YoriLibFreeStringContents(&AppPath);
-        YoriLibFreeStringContents(&IniValue);
-        return FALSE;
-    }
-
     YoriLibInitEmptyString(&FileToDelete);
     if (!YoriLibAllocateString(&FileToDelete, AppPath.LengthInChars + YORIPKG_MAX_FIELD_LENGTH)) {
         YoriLibFreeStringContents(&AppPath);
-        YoriLibFreeStringContents(&IniValue);
+        YoriPkgCloseInstalledDatabase(Db);
         return FALSE;
     }
 
-    for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
-        YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
-
-        IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, FileIndexString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile->StartOfString);
-        if (IniValue.LengthInChars > 0) {
-            if (!YoriLibIsPathPrefixed(&IniValue)) {
-                YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
+    for (FileIndex = 0; FileIndex < Package->FileCount; FileIndex++) {
+        RelativeFileName = &Package->Files[FileIndex]->RelativeFileName;
+        if (RelativeFileName->LengthInChars > 0) {
+            if (!YoriLibIsPathPrefixed(RelativeFileName)) {
+                YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, RelativeFileName);
                 FileBeingDeleted = &FileToDelete;
             } else {
-                FileBeingDeleted = &IniValue;
+                FileBeingDeleted = RelativeFileName;
             }
             DeleteResult = YoriPkgCheckIfFileDeleteable(FileBeingDeleted);
 
@@ -185,6 +183,9 @@ YoriPkgCheckIfPackageDeleteable(
                 YORI_STRING ModuleName;
 
                 if (!YoriPkgGetExecutableFile(&ModuleName)) {
+                    YoriLibFreeStringContents(&AppPath);
+                    YoriLibFreeStringContents(&FileToDelete);
+                    YoriPkgCloseInstalledDatabase(Db);
                     return FALSE;
                 }
 
@@ -205,17 +206,17 @@ YoriPkgCheckIfPackageDeleteable(
             //
 
             if (!DeleteResult) {
-                YoriLibFreeStringContents(&IniValue);
                 YoriLibFreeStringContents(&AppPath);
                 YoriLibFreeStringContents(&FileToDelete);
+                YoriPkgCloseInstalledDatabase(Db);
                 return FALSE;
             }
         }
     }
 
-    YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&AppPath);
     YoriLibFreeStringContents(&FileToDelete);
+    YoriPkgCloseInstalledDatabase(Db);
 
     return TRUE;
 }
@@ -323,25 +324,32 @@ YoriPkgDeletePackageInternal(
     )
 {
     YORI_STRING AppPath;
-    YORI_STRING IniValue;
     YORI_STRING FileToDelete;
     PYORI_STRING FileBeingDeleted;
-    DWORD FileCount;
+    PYORI_STRING RelativeFileName;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
     DWORD FileIndex;
-    TCHAR FileIndexString[16];
     BOOL DeleteResult;
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (YoriPkgOpenInstalledDatabase(PkgIniFile, &Db) != ERROR_SUCCESS) {
+        return FALSE;
+    }
+
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package == NULL || Package->FileCount == 0) {
+        YoriPkgCloseInstalledDatabase(Db);
         return FALSE;
     }
 
     if (TargetDirectory == NULL) {
         if (!YoriPkgGetApplicationDirectory(&AppPath)) {
-            YoriLibFreeStringContents(&IniValue);
+            YoriPkgCloseInstalledDatabase(Db);
             return FALSE;
         }
     } else {
         if (!YoriLibAllocateString(&AppPath, TargetDirectory->LengthInChars + MAX_PATH)) {
+            YoriPkgCloseInstalledDatabase(Db);
             return FALSE;
         }
         memcpy(AppPath.StartOfString, TargetDirectory->StartOfString, TargetDirectory->LengthInChars * sizeof(TCHAR));
@@ -349,30 +357,21 @@ YoriPkgDeletePackageInternal(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    FileCount = GetPrivateProfileInt(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
-    if (FileCount == 0) {
-        YoriLibFreeStringContents(&AppPath);
-        YoriLibFreeStringContents(&IniValue);
-        return FALSE;
-    }
-
     YoriLibInitEmptyString(&FileToDelete);
     if (!YoriLibAllocateString(&FileToDelete, AppPath.LengthInChars + YORIPKG_MAX_FIELD_LENGTH)) {
         YoriLibFreeStringContents(&AppPath);
-        YoriLibFreeStringContents(&IniValue);
+        YoriPkgCloseInstalledDatabase(Db);
         return FALSE;
     }
 
-    for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
-        YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
-
-        IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, FileIndexString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile->StartOfString);
-        if (IniValue.LengthInChars > 0) {
-            if (!YoriLibIsPathPrefixed(&IniValue)) {
-                YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
+    for (FileIndex = 0; FileIndex < Package->FileCount; FileIndex++) {
+        RelativeFileName = &Package->Files[FileIndex]->RelativeFileName;
+        if (RelativeFileName->LengthInChars > 0) {
+            if (!YoriLibIsPathPrefixed(RelativeFileName)) {
+                YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, RelativeFileName);
                 FileBeingDeleted = &FileToDelete;
             } else {
-                FileBeingDeleted = &IniValue;
+                FileBeingDeleted = RelativeFileName;
             }
             DeleteResult = YoriPkgDeleteInstalledPackageFile(FileBeingDeleted);
 
@@ -380,6 +379,9 @@ YoriPkgDeletePackageInternal(
                 YORI_STRING ModuleName;
 
                 if (!YoriPkgGetExecutableFile(&ModuleName)) {
+                    YoriLibFreeStringContents(&AppPath);
+                    YoriLibFreeStringContents(&FileToDelete);
+                    YoriPkgCloseInstalledDatabase(Db);
                     return FALSE;
                 }
 
@@ -401,30 +403,20 @@ YoriPkgDeletePackageInternal(
             //  inconsistent.
             //
 
-            if (!DeleteResult && FileIndex == 1) {
-                YoriLibFreeStringContents(&IniValue);
+            if (!DeleteResult && FileIndex == 0) {
                 YoriLibFreeStringContents(&AppPath);
                 YoriLibFreeStringContents(&FileToDelete);
+                YoriPkgCloseInstalledDatabase(Db);
                 return FALSE;
             }
         }
-
-        WritePrivateProfileString(PackageName->StartOfString, FileIndexString, NULL, PkgIniFile->StartOfString);
     }
 
-    WritePrivateProfileString(PackageName->StartOfString, _T("FileCount"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(PackageName->StartOfString, _T("Architecture"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(PackageName->StartOfString, _T("UpgradePath"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(PackageName->StartOfString, _T("SourcePath"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(PackageName->StartOfString, _T("SymbolPath"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(PackageName->StartOfString, _T("Version"), NULL, PkgIniFile->StartOfString);
-    WritePrivateProfileString(_T("Installed"), PackageName->StartOfString, NULL, PkgIniFile->StartOfString);
+    YoriPkgRemoveInstalledPackage(Db, Package);
 
-    WritePrivateProfileString(PackageName->StartOfString, NULL, NULL, PkgIniFile->StartOfString);
-
-    YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&AppPath);
     YoriLibFreeStringContents(&FileToDelete);
+    YoriPkgCloseInstalledDatabase(Db);
 
     return TRUE;
 }
@@ -443,20 +435,20 @@ typedef struct _YORIPKG_INSTALL_PKG_CONTEXT {
     PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
     /**
-     Path to the INI file recording package installation.
+     The database of installed packages.
      */
-    PYORI_STRING IniFileName;
+    PYORIPKG_INSTALLED_DB Db;
 
     /**
-     The name of the package being installed.
+     The entry in the installed package database for the package being
+     installed.  Each file is recorded against this entry as it is found.
      */
-    PYORI_STRING PackageName;
+    PYORIPKG_INSTALLED_PACKAGE InstalledPackage;
 
     /**
-     The number of files installed as part of this package.  THis value is
-     incremented each time a file is found.
+     The name of the package being installed.
      */
-    DWORD NumberFiles;
+    PYORI_STRING PackageName;
 
     /**
      If TRUE, files extracted from this package should be compressed.
@@ -468,6 +460,12 @@ typedef struct _YORIPKG_INSTALL_PKG_CONTEXT {
      */
     BOOL ConflictingFileFound;
 
+    /**
+     If TRUE, installation is aborted because a file could not be recorded
+     in the installed package database.
+     */
+    BOOL RecordFileFailed;
+
     /**
      Context for background compression threads.
      */
@@ -495,9 +493,10 @@ YoriPkgInstallPackageFileCallback(
     )
 {
     PYORIPKG_INSTALL_PKG_CONTEXT InstallContext = (PYORIPKG_INSTALL_PKG_CONTEXT)Context;
-    TCHAR FileIndexString[16];
 
-    if (InstallContext->ConflictingFileFound) {
+    if (InstallContext->ConflictingFileFound ||
+        InstallContext->RecordFileFailed) {
+
         return FALSE;
     }
 
@@ -507,16 +506,17 @@ YoriPkgInstallPackageFileCallback(
         return FALSE;
     }
 
-    if (YoriPkgCheckIfFileAlreadyExists(InstallContext->PendingPackages, RelativePath)) {
+    if (YoriPkgFindInstalledFile(InstallContext->Db, RelativePath) != NULL) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install of package %y conflicts with installed file %y\n"), InstallContext->PackageName, RelativePath);
         InstallContext->ConflictingFileFound = TRUE;
         return FALSE;
     }
 
-    InstallContext->NumberFiles++;
-    YoriLibSPrintf(FileIndexString, _T("File%i"), InstallContext->NumberFiles);
+    if (!YoriPkgAddInstalledPackageFile(InstallContext->Db, InstallContext->InstalledPackage, RelativePath)) {
+        InstallContext->RecordFileFailed = TRUE;
+        return FALSE;
+    }
 
-    WritePrivateProfileString(InstallContext->PackageName->StartOfString, FileIndexString, RelativePath->StartOfString, InstallContext->IniFileName->StartOfString);
     return TRUE;
 }
 
@@ -577,14 +577,17 @@ YoriPkgInstallPackage(
     YORI_STRING PkgInfoFile;
     YORI_STRING PkgIniFile;
     YORI_STRING FullTargetDirectory;
+    YORI_STRING InstallingVersion;
 
     YORI_STRING ErrorString;
     YORIPKG_INSTALL_PKG_CONTEXT InstallContext;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE InstalledPackage;
 
     BOOL Result = FALSE;
-    TCHAR FileIndexString[16];
 
     ZeroMemory(&InstallContext, sizeof(InstallContext));
+    Db = NULL;
 
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
 
@@ -609,40 +612,34 @@ YoriPkgInstallPackage(
         }
     }
 
-    {
-        YORI_STRING PkgToDelete;
-
-        //
-        //  Check if a different version of the package being installed
-        //  is already present.  If it is, installation at this point fails.
-        //  Typically a higher level process will backup anything that an
-        //  installation intends to supersede, so by this point it would
-        //  not appear installed.
-        //
+    if (YoriPkgOpenInstalledDatabase(&PkgIniFile, &Db) != ERROR_SUCCESS) {
+        Db = NULL;
+        goto Exit;
+    }
 
-        if (!YoriLibAllocateString(&PkgToDelete, YORIPKG_MAX_FIELD_LENGTH)) {
-            goto Exit;
-        }
+    //
+    //  Check if a different version of the package being installed
+    //  is already present.  If it is, installation at this point fails.
+    //  Typically a higher level process will backup anything that an
+    //  installation intends to supersede, so by this point it would
+    //  not appear installed.
+    //
 
-        PkgToDelete.LengthInChars = GetPrivateProfileString(_T("Installed"), Package->PackageName.StartOfString, _T(""), PkgToDelete.StartOfString, PkgToDelete.LengthAllocated, PkgIniFile.StartOfString);
+    InstalledPackage = YoriPkgFindInstalledPackage(Db, &Package->PackageName);
+    if (InstalledPackage != NULL) {
 
         //
         //  If the version being installed is already there, we're done.
         //
 
-        if (YoriLibCompareString(&PkgToDelete, &Package->Version) == 0) {
+        if (YoriLibCompareString(&InstalledPackage->InstalledVersion, &Package->Version) == 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &Package->PackageName, &Package->Version);
-            YoriLibFreeStringContents(&PkgToDelete);
             Result = TRUE;
-            goto Exit;
-        } else if (PkgToDelete.LengthInChars > 0) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is currently installed, blocking install of %y\n"), &Package->PackageName, &PkgToDelete, &Package->Version);
-            YoriLibFreeStringContents(&PkgToDelete);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is currently installed, blocking install of %y\n"), &Package->PackageName, &InstalledPackage->InstalledVersion, &Package->Version);
             Result = FALSE;
-            goto Exit;
         }
-
-        YoriLibFreeStringContents(&PkgToDelete);
+        goto Exit;
     }
 
     //
@@ -651,9 +648,18 @@ YoriPkgInstallPackage(
     //  upgrade will detect a new version and will retry.
     //
 
-    WritePrivateProfileString(_T("Installed"), Package->PackageName.StartOfString, _T("0"), PkgIniFile.StartOfString);
-    if (Package->UpgradePath.LengthInChars > 0) {
-        WritePrivateProfileString(Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString, PkgIniFile.StartOfString);
+    InstalledPackage = YoriPkgAddInstalledPackage(Db, &Package->PackageName);
+    if (InstalledPackage == NULL) {
+        goto Exit;
+    }
+
+    YoriLibConstantString(&InstallingVersion, _T("0"));
+    if (!YoriPkgSetInstalledPackageString(Db, &InstalledPackage->InstalledVersion, &InstallingVersion) ||
+        !YoriPkgSetInstalledPackageString(Db, &InstalledPackage->UpgradePath, &Package->UpgradePath) ||
+        !YoriPkgFlushInstalledDatabase(Db)) {
+
+        YoriPkgRemoveInstalledPackage(Db, InstalledPackage);
+        goto Exit;
     }
 
     if (YoriLibGetWofVersionAvailable(&FullTargetDirectory)) {
@@ -673,44 +679,48 @@ YoriPkgInstallPackage(
     //
 
     InstallContext.PendingPackages = PendingPackages;
-    InstallContext.IniFileName = &PkgIniFile;
+    InstallContext.Db = Db;
+    InstallContext.InstalledPackage = InstalledPackage;
     InstallContext.PackageName = &Package->PackageName;
-    InstallContext.NumberFiles = 0;
     InstallContext.ConflictingFileFound = FALSE;
+    InstallContext.RecordFileFailed = FALSE;
     YoriLibInitEmptyString(&ErrorString);
     if (!YoriLibExtractCab(&Package->LocalPackagePath, &FullTargetDirectory, TRUE, 1, &PkgInfoFile, 0, NULL, YoriPkgInstallPackageFileCallback, YoriPkgCompressPackageFileCallback, &InstallContext, &ErrorString)) {
-        WritePrivateProfileString(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriPkgRemoveInstalledPackage(Db, InstalledPackage);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not create or write to file %y: %y\n"), &Package->LocalPackagePath, &ErrorString);
         YoriLibFreeStringContents(&ErrorString);
         goto Exit;
     }
 
     if (InstallContext.ConflictingFileFound) {
-        WritePrivateProfileString(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriPkgRemoveInstalledPackage(Db, InstalledPackage);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
         goto Exit;
     }
 
-    WritePrivateProfileString(Package->PackageName.StartOfString, _T("Version"), Package->Version.StartOfString, PkgIniFile.StartOfString);
-    WritePrivateProfileString(Package->PackageName.StartOfString, _T("Architecture"), Package->Architecture.StartOfString, PkgIniFile.StartOfString);
-    if (Package->UpgradePath.LengthInChars > 0) {
-        WritePrivateProfileString(Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString, PkgIniFile.StartOfString);
-    }
-    if (Package->SourcePath.LengthInChars > 0) {
-        WritePrivateProfileString(Package->PackageName.StartOfString, _T("SourcePath"), Package->SourcePath.StartOfString, PkgIniFile.StartOfString);
-    }
-    if (Package->SymbolPath.LengthInChars > 0) {
-        WritePrivateProfileString(Package->PackageName.StartOfString, _T("SymbolPath"), Package->SymbolPath.StartOfString, PkgIniFile.StartOfString);
+    if (InstallContext.RecordFileFailed) {
+        YoriPkgRemoveInstalledPackage(Db, InstalledPackage);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted because installed files could not be recorded\n"));
+        goto Exit;
     }
 
-    YoriLibSPrintf(FileIndexString, _T("%i"), InstallContext.NumberFiles);
+    if (!YoriPkgSetInstalledPackageString(Db, &InstalledPackage->Version, &Package->Version) ||
+        !YoriPkgSetInstalledPackageString(Db, &InstalledPackage->Architecture, &Package->Architecture) ||
+        !YoriPkgSetInstalledPackageString(Db, &InstalledPackage->SourcePath, &Package->SourcePath) ||
+        !YoriPkgSetInstalledPackageString(Db, &InstalledPackage->SymbolPath, &Package->SymbolPath) ||
+        !YoriPkgSetInstalledPackageString(Db, &InstalledPackage->InstalledVersion, &Package->Version)) {
 
-    WritePrivateProfileString(Package->PackageName.StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
-    WritePrivateProfileString(_T("Installed"), Package->PackageName.StartOfString, Package->Version.StartOfString, PkgIniFile.StartOfString);
+        goto Exit;
+    }
 
     Result = TRUE;
 
 Exit:
+    if (Db != NULL) {
+        if (!YoriPkgCloseInstalledDatabase(Db)) {
+            Result = FALSE;
+        }
+    }
     YoriLibFreeStringContents(&PkgIniFile);
     YoriLibFreeStringContents(&FullTargetDirectory);
     if (InstallContext.CompressFiles) {
@@ -750,21 +760,29 @@ YoriPkgBuildUpgradeLocationForNewArchitecture(
     __inout PYORI_STRING UpgradePath
     )
 {
-    YORI_STRING IniValue;
+    YORI_STRING PkgArch;
     YORI_STRING ExistingArchAndExtension;
+    PYORIPKG_INSTALLED_DB Db;
+    PYORIPKG_INSTALLED_PACKAGE Package;
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (YoriPkgOpenInstalledDatabase(PkgIniFile, &Db) != ERROR_SUCCESS) {
         return FALSE;
     }
 
-    IniValue.LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("Architecture"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, PkgIniFile->StartOfString);
-    if (IniValue.LengthInChars == 0) {
-        YoriLibFreeStringContents(&IniValue);
+    YoriLibInitEmptyString(&PkgArch);
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package != NULL) {
+        YoriLibCloneString(&PkgArch, &Package->Architecture);
+    }
+    YoriPkgCloseInstalledDatabase(Db);
+
+    if (PkgArch.LengthInChars == 0) {
+        YoriLibFreeStringContents(&PkgArch);
         return FALSE;
     }
 
-    if (UpgradePath->LengthInChars < IniValue.LengthInChars + sizeof(".cab") - 1) {
-        YoriLibFreeStringContents(&IniValue);
+    if (UpgradePath->LengthInChars < PkgArch.LengthInChars + sizeof(".cab") - 1) {
+        YoriLibFreeStringContents(&PkgArch);
         return FALSE;
     }
 
@@ -773,32 +791,32 @@ YoriPkgBuildUpgradeLocationForNewArchitecture(
     ExistingArchAndExtension.StartOfString = &UpgradePath->StartOfString[UpgradePath->LengthInChars - ExistingArchAndExtension.LengthInChars];
 
     if (YoriLibCompareStringWithLiteralInsensitive(&ExistingArchAndExtension, _T(".cab")) != 0) {
-        YoriLibFreeStringContents(&IniValue);
+        YoriLibFreeStringContents(&PkgArch);
         return FALSE;
     }
 
-    ExistingArchAndExtension.StartOfString -= IniValue.LengthInChars;
-    ExistingArchAndExtension.LengthInChars = IniValue.LengthInChars;
+    ExistingArchAndExtension.StartOfString -= PkgArch.LengthInChars;
+    ExistingArchAndExtension.LengthInChars = PkgArch.LengthInChars;
 
-    if (YoriLibCompareStringInsensitive(&ExistingArchAndExtension, &IniValue) != 0) {
-        YoriLibFreeStringContents(&IniValue);
+    if (YoriLibCompareStringInsensitive(&ExistingArchAndExtension, &PkgArch) != 0) {
+        YoriLibFreeStringContents(&PkgArch);
         return FALSE;
     }
 
     if (YoriLibCompareStringWithLiteralInsensitive(&ExistingArchAndExtension, _T("noarch")) == 0) {
-        YoriLibFreeStringContents(&IniValue);
+        YoriLibFreeStringContents(&PkgArch);
         return FALSE;
     }
 
-    if (UpgradePath->LengthInChars - IniValue.LengthInChars + NewArchitecture->LengthInChars < UpgradePath->LengthAllocated) {
+    if (UpgradePath->LengthInChars - PkgArch.LengthInChars + NewArchitecture->LengthInChars < UpgradePath->LengthAllocated) {
         YoriLibSPrintf(ExistingArchAndExtension.StartOfString, _T("%y.cab"), NewArchitecture);
-        UpgradePath->LengthInChars = UpgradePath->LengthInChars - IniValue.LengthInChars + NewArchitecture->LengthInChars;
+        UpgradePath->LengthInChars = UpgradePath->LengthInChars - PkgArch.LengthInChars + NewArchitecture->LengthInChars;
 
-        YoriLibFreeStringContents(&IniValue);
+        YoriLibFreeStringContents(&PkgArch);
         return TRUE;
     }
 
-    YoriLibFreeStringContents(&IniValue);
+    YoriLibFreeStringContents(&PkgArch);
     return FALSE;
 }
 
@@ -830,16 +848,22 @@ YoriPkgInstallPendingPackages(
 {
     PYORIPKG_PACKAGE_PENDING_INSTALL PendingPackage;
     PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_INSTALLED_DB Db;
     DWORD TotalCount;
     DWORD CurrentIndex;
     BOOL Result;
 
     //
-    //  Load into memory all files owned by packages that are installed
-    //  prior to this installation and are not replaced by it
+    //  Keep the installed package database open for the duration of the
+    //  installation, so the installation and any rollback operate on the
+    //  same in memory copy.  Packages that are being replaced have already
+    //  been removed from it, so its file index describes files owned by
+    //  packages which will remain after this installation.
     //
 
-    YoriPkgAddExistingFilesToPendingPackages(PkgIniFile, PendingPackages);
+    if (YoriPkgOpenInstalledDatabase(PkgIniFile, &Db) != ERROR_SUCCESS) {
+        Db = NULL;
+    }
 
     //
     //  Count the number of packages to install
@@ -880,6 +904,10 @@ YoriPkgInstallPendingPackages(
         YoriPkgRollbackAndFreeBackupPackageList(PkgIniFile, TargetDirectory, &PendingPackages->BackupPackages);
     }
 
+    if (Db != NULL) {
+        YoriPkgCloseInstalledDatabase(Db);
+    }
+
     return Result;
 }
 
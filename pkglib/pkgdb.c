@@ -0,0 +1,1379 @@
+/**
+ * @file pkglib/pkgdb.c
+ *
+ * Yori package manager database of installed packages
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "yoripkgp.h"
+
+/**
+ The signature at the start of an installed package database file, 'YPDB'.
+ */
+#define YORIPKG_DB_SIGNATURE (0x42445059)
+
+/**
+ The version of the installed package database file format.
+ */
+#define YORIPKG_DB_VERSION (1)
+
+/**
+ The number of buckets in the hash table of installed packages.
+ */
+#define YORIPKG_DB_PACKAGE_BUCKETS (97)
+
+/**
+ The number of buckets in the hash table of installed files.
+ */
+#define YORIPKG_DB_FILE_BUCKETS (1021)
+
+/**
+ The header at the start of an installed package database file.  This is
+ followed by PackageCount package records.  Each record consists of the
+ package name, installed version, version, architecture, upgrade path,
+ source path and symbol path as counted strings, followed by a count of
+ files and that many counted strings.  A counted string is a DWORD length in
+ characters followed by that many characters, without a NULL terminator.
+ */
+typedef struct _YORIPKG_DB_HEADER {
+
+    /**
+     Set to YORIPKG_DB_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Set to YORIPKG_DB_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The size of each character in the file, in bytes.
+     */
+    DWORD CharSize;
+
+    /**
+     The number of package records following the header.
+     */
+    DWORD PackageCount;
+} YORIPKG_DB_HEADER, *PYORIPKG_DB_HEADER;
+
+/**
+ A singly linked list of installed package databases which are currently
+ open.  This allows nested operations, such as rolling back a package while
+ installing a set of packages, to operate on the same in memory state.
+ Package operations are performed on a single thread, so this is not
+ synchronized.
+ */
+PYORIPKG_INSTALLED_DB YoriPkgOpenInstalledDbs;
+
+/**
+ Given the path to the system packages.ini file, return the path to the
+ installed package database which is stored alongside it.
+
+ @param PkgIniFile Pointer to the path to the system packages.ini file.
+
+ @param DbFile On successful completion, populated with the path to the
+        installed package database.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgGetInstalledDatabaseFile(
+    __in PYORI_STRING PkgIniFile,
+    __out PYORI_STRING DbFile
+    )
+{
+    YORI_STRING BaseName;
+    YORI_STRING Extension;
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = PkgIniFile->StartOfString;
+    BaseName.LengthInChars = PkgIniFile->LengthInChars;
+
+    if (BaseName.LengthInChars > sizeof(".ini") - 1) {
+        YoriLibInitEmptyString(&Extension);
+        Extension.LengthInChars = sizeof(".ini") - 1;
+        Extension.StartOfString = &BaseName.StartOfString[BaseName.LengthInChars - Extension.LengthInChars];
+        if (YoriLibCompareStringWithLiteralInsensitive(&Extension, _T(".ini")) == 0) {
+            BaseName.LengthInChars -= Extension.LengthInChars;
+        }
+    }
+
+    YoriLibInitEmptyString(DbFile);
+    YoriLibYPrintf(DbFile, _T("%y.db"), &BaseName);
+    if (DbFile->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Replace the contents of a string describing a field of an installed package
+ with a copy of another string.  The resulting string is NULL terminated.
+
+ @param Field Pointer to the field to update.  Any existing contents are
+        freed.
+
+ @param Value Optionally points to the new value.  If NULL or empty, the
+        field is left empty.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgCopyInstalledPackageString(
+    __inout PYORI_STRING Field,
+    __in_opt PYORI_STRING Value
+    )
+{
+    YoriLibFreeStringContents(Field);
+    if (Value == NULL || Value->LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (!YoriLibAllocateString(Field, Value->LengthInChars + 1)) {
+        return FALSE;
+    }
+
+    memcpy(Field->StartOfString, Value->StartOfString, Value->LengthInChars * sizeof(TCHAR));
+    Field->StartOfString[Value->LengthInChars] = '\0';
+    Field->LengthInChars = Value->LengthInChars;
+    return TRUE;
+}
+
+/**
+ Add a reference to an installed package, preventing it from being
+ deallocated if it is removed from the database.
+
+ @param Package Pointer to the package to reference.
+ */
+VOID
+YoriPkgReferenceInstalledPackage(
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    )
+{
+    Package->ReferenceCount++;
+}
+
+/**
+ Release a reference on an installed package.  When the final reference is
+ released, the package is deallocated.  Note the package must have been
+ removed from the database by this point.
+
+ @param Package Pointer to the package to dereference.
+ */
+VOID
+YoriPkgDereferenceInstalledPackage(
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    )
+{
+    Package->ReferenceCount--;
+    if (Package->ReferenceCount > 0) {
+        return;
+    }
+
+    ASSERT(Package->FileCount == 0);
+    ASSERT(Package->HashEntry.Key == NULL);
+
+    YoriLibFreeStringContents(&Package->PackageName);
+    YoriLibFreeStringContents(&Package->InstalledVersion);
+    YoriLibFreeStringContents(&Package->Version);
+    YoriLibFreeStringContents(&Package->Architecture);
+    YoriLibFreeStringContents(&Package->UpgradePath);
+    YoriLibFreeStringContents(&Package->SourcePath);
+    YoriLibFreeStringContents(&Package->SymbolPath);
+    if (Package->Files != NULL) {
+        YoriLibFree(Package->Files);
+    }
+    YoriLibFree(Package);
+}
+
+/**
+ Find an installed package by name.
+
+ @param Db Pointer to the installed package database.
+
+ @param PackageName Pointer to the name of the package to find.
+
+ @return Pointer to the package if it is installed, or NULL if it is not.
+ */
+PYORIPKG_INSTALLED_PACKAGE
+YoriPkgFindInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING PackageName
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKey(Db->PackageTable, PackageName);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return (PYORIPKG_INSTALLED_PACKAGE)HashEntry->Context;
+}
+
+/**
+ Find the installed package which owns a file.
+
+ @param Db Pointer to the installed package database.
+
+ @param RelativeFileName Pointer to the file name, relative to the
+        installation directory, to find.
+
+ @return Pointer to the file if it is owned by an installed package, or NULL
+         if it is not.
+ */
+PYORIPKG_INSTALLED_FILE
+YoriPkgFindInstalledFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING RelativeFileName
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKey(Db->FileTable, RelativeFileName);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return (PYORIPKG_INSTALLED_FILE)HashEntry->Context;
+}
+
+/**
+ Add a package to the installed package database.  If the package is
+ already present, the existing package is returned.
+
+ @param Db Pointer to the installed package database.
+
+ @param PackageName Pointer to the name of the package to add.
+
+ @return Pointer to the package, or NULL on allocation failure.
+ */
+PYORIPKG_INSTALLED_PACKAGE
+YoriPkgAddInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING PackageName
+    )
+{
+    PYORIPKG_INSTALLED_PACKAGE Package;
+
+    Package = YoriPkgFindInstalledPackage(Db, PackageName);
+    if (Package != NULL) {
+        return Package;
+    }
+
+    Package = YoriLibMalloc(sizeof(YORIPKG_INSTALLED_PACKAGE));
+    if (Package == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Package, sizeof(YORIPKG_INSTALLED_PACKAGE));
+    Package->ReferenceCount = 1;
+
+    if (!YoriPkgCopyInstalledPackageString(&Package->PackageName, PackageName)) {
+        YoriLibFree(Package);
+        return NULL;
+    }
+
+    if (!YoriLibHashInsertByKey(Db->PackageTable, &Package->PackageName, Package, &Package->HashEntry)) {
+        YoriLibFreeStringContents(&Package->PackageName);
+        YoriLibFree(Package);
+        return NULL;
+    }
+
+    YoriLibAppendList(&Db->PackageList, &Package->ListEntry);
+    Db->PackageCount++;
+    Db->Dirty = TRUE;
+    return Package;
+}
+
+/**
+ Update a field describing an installed package.
+
+ @param Db Pointer to the installed package database.
+
+ @param Field Pointer to the field within an installed package to update.
+
+ @param Value Optionally points to the new value.  If NULL, the field is
+        cleared.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgSetInstalledPackageString(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __inout PYORI_STRING Field,
+    __in_opt PYORI_STRING Value
+    )
+{
+    Db->Dirty = TRUE;
+    return YoriPkgCopyInstalledPackageString(Field, Value);
+}
+
+/**
+ Record a file as being owned by an installed package.
+
+ @param Db Pointer to the installed package database.
+
+ @param Package Pointer to the package which owns the file.
+
+ @param RelativeFileName Pointer to the name of the file.  This is typically
+        relative to the installation directory, but may be a fully qualified
+        prefixed path for files which are installed elsewhere.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgAddInstalledPackageFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package,
+    __in PYORI_STRING RelativeFileName
+    )
+{
+    PYORIPKG_INSTALLED_FILE File;
+    PYORIPKG_INSTALLED_FILE *NewFiles;
+    DWORD NewFilesAllocated;
+
+    if (Package->FileCount == Package->FilesAllocated) {
+        NewFilesAllocated = Package->FilesAllocated * 2;
+        if (NewFilesAllocated < 16) {
+            NewFilesAllocated = 16;
+        }
+        NewFiles = YoriLibMalloc(NewFilesAllocated * sizeof(PYORIPKG_INSTALLED_FILE));
+        if (NewFiles == NULL) {
+            return FALSE;
+        }
+        if (Package->Files != NULL) {
+            memcpy(NewFiles, Package->Files, Package->FileCount * sizeof(PYORIPKG_INSTALLED_FILE));
+            YoriLibFree(Package->Files);
+        }
+        Package->Files = NewFiles;
+        Package->FilesAllocated = NewFilesAllocated;
+    }
+
+    File = YoriLibReferencedMalloc(sizeof(YORIPKG_INSTALLED_FILE) + (RelativeFileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    File->Package = Package;
+    YoriLibInitEmptyString(&File->RelativeFileName);
+    File->RelativeFileName.MemoryToFree = File;
+    File->RelativeFileName.StartOfString = (LPTSTR)(File + 1);
+    File->RelativeFileName.LengthInChars = RelativeFileName->LengthInChars;
+    memcpy(File->RelativeFileName.StartOfString, RelativeFileName->StartOfString, RelativeFileName->LengthInChars * sizeof(TCHAR));
+    File->RelativeFileName.StartOfString[File->RelativeFileName.LengthInChars] = '\0';
+    File->RelativeFileName.LengthAllocated = RelativeFileName->LengthInChars + 1;
+
+    if (!YoriLibHashInsertByKey(Db->FileTable, &File->RelativeFileName, File, &File->HashEntry)) {
+        YoriLibDereference(File);
+        return FALSE;
+    }
+
+    Package->Files[Package->FileCount] = File;
+    Package->FileCount++;
+    Db->Dirty = TRUE;
+    return TRUE;
+}
+
+/**
+ Remove all files recorded against an installed package.
+
+ @param Db Pointer to the installed package database.
+
+ @param Package Pointer to the package whose files should be removed.
+ */
+VOID
+YoriPkgRemoveInstalledPackageFiles(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    )
+{
+    DWORD FileIndex;
+    PYORIPKG_INSTALLED_FILE File;
+
+    for (FileIndex = 0; FileIndex < Package->FileCount; FileIndex++) {
+        File = Package->Files[FileIndex];
+        YoriLibHashRemoveByEntry(&File->HashEntry);
+        YoriLibDereference(File);
+    }
+
+    if (Package->FileCount > 0) {
+        Package->FileCount = 0;
+        Db->Dirty = TRUE;
+    }
+}
+
+/**
+ Remove a package, and all of the files it owns, from the installed package
+ database.  The package structure remains valid until any references
+ acquired with @ref YoriPkgCaptureInstalledPackages are released.
+
+ @param Db Pointer to the installed package database.
+
+ @param Package Pointer to the package to remove.
+ */
+VOID
+YoriPkgRemoveInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    )
+{
+    YoriPkgRemoveInstalledPackageFiles(Db, Package);
+    YoriLibHashRemoveByEntry(&Package->HashEntry);
+    YoriLibRemoveListItem(&Package->ListEntry);
+    Db->PackageCount--;
+    Db->Dirty = TRUE;
+    YoriPkgDereferenceInstalledPackage(Package);
+}
+
+/**
+ Capture a referenced array of all installed packages.  This allows the
+ caller to walk the set of installed packages while performing operations
+ that may add or remove packages from the database.
+
+ @param Db Pointer to the installed package database.
+
+ @param PackageCount On successful completion, populated with the number of
+        elements in the array.
+
+ @param Packages On successful completion, populated with an array of
+        referenced packages.  This should be freed with
+        @ref YoriPkgFreeCapturedPackages .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgCaptureInstalledPackages(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __out PDWORD PackageCount,
+    __out PYORIPKG_INSTALLED_PACKAGE **Packages
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    PYORIPKG_INSTALLED_PACKAGE *Array;
+    DWORD Index;
+
+    Array = NULL;
+    if (Db->PackageCount > 0) {
+        Array = YoriLibMalloc(Db->PackageCount * sizeof(PYORIPKG_INSTALLED_PACKAGE));
+        if (Array == NULL) {
+            return FALSE;
+        }
+    }
+
+    Index = 0;
+    ListEntry = YoriLibGetNextListEntry(&Db->PackageList, NULL);
+    while (ListEntry != NULL) {
+        Package = CONTAINING_RECORD(ListEntry, YORIPKG_INSTALLED_PACKAGE, ListEntry);
+        YoriPkgReferenceInstalledPackage(Package);
+        Array[Index] = Package;
+        Index++;
+        ListEntry = YoriLibGetNextListEntry(&Db->PackageList, ListEntry);
+    }
+
+    ASSERT(Index == Db->PackageCount);
+
+    *PackageCount = Index;
+    *Packages = Array;
+    return TRUE;
+}
+
+/**
+ Release an array of packages captured with
+ @ref YoriPkgCaptureInstalledPackages .
+
+ @param PackageCount The number of elements in the array.
+
+ @param Packages Pointer to the array of referenced packages.
+ */
+VOID
+YoriPkgFreeCapturedPackages(
+    __in DWORD PackageCount,
+    __in_opt PYORIPKG_INSTALLED_PACKAGE *Packages
+    )
+{
+    DWORD Index;
+
+    if (Packages == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < PackageCount; Index++) {
+        YoriPkgDereferenceInstalledPackage(Packages[Index]);
+    }
+
+    YoriLibFree(Packages);
+}
+
+/**
+ Read a counted string from a buffer containing an installed package
+ database.
+
+ @param Buffer Pointer to the database contents.
+
+ @param BufferLength The number of bytes in Buffer.
+
+ @param Offset On input, the offset within the buffer to read from.  On
+        successful completion, updated to point after the string.
+
+ @param Value On successful completion, populated with a newly allocated,
+        NULL terminated copy of the string.
+
+ @return TRUE to indicate success, FALSE if the buffer is malformed or
+         allocation failed.
+ */
+__success(return)
+BOOL
+YoriPkgReadInstalledDatabaseString(
+    __in PUCHAR Buffer,
+    __in DWORD BufferLength,
+    __inout PDWORD Offset,
+    __out PYORI_STRING Value
+    )
+{
+    DWORD Length;
+
+    YoriLibInitEmptyString(Value);
+    if (BufferLength - *Offset < sizeof(DWORD)) {
+        return FALSE;
+    }
+
+    memcpy(&Length, &Buffer[*Offset], sizeof(DWORD));
+    *Offset += sizeof(DWORD);
+
+    if (Length > (BufferLength - *Offset) / sizeof(TCHAR)) {
+        return FALSE;
+    }
+
+    if (Length > 0) {
+        if (!YoriLibAllocateString(Value, Length + 1)) {
+            return FALSE;
+        }
+        memcpy(Value->StartOfString, &Buffer[*Offset], Length * sizeof(TCHAR));
+        Value->StartOfString[Length] = '\0';
+        Value->LengthInChars = Length;
+    }
+
+    *Offset += Length * sizeof(TCHAR);
+    return TRUE;
+}
+
+/**
+ Write a DWORD into a buffer describing an installed package database.
+
+ @param Buffer Optionally points to the buffer to write to.  If NULL, the
+        offset is updated without writing, which allows the caller to
+        determine the size of the buffer to allocate.
+
+ @param Offset On input, the offset within the buffer to write to.  On
+        completion, updated to point after the value.
+
+ @param Value The value to write.
+ */
+VOID
+YoriPkgWriteInstalledDatabaseDword(
+    __out_opt PUCHAR Buffer,
+    __inout PDWORD Offset,
+    __in DWORD Value
+    )
+{
+    if (Buffer != NULL) {
+        memcpy(&Buffer[*Offset], &Value, sizeof(DWORD));
+    }
+    *Offset += sizeof(DWORD);
+}
+
+/**
+ Write a counted string into a buffer describing an installed package
+ database.
+
+ @param Buffer Optionally points to the buffer to write to.  If NULL, the
+        offset is updated without writing, which allows the caller to
+        determine the size of the buffer to allocate.
+
+ @param Offset On input, the offset within the buffer to write to.  On
+        completion, updated to point after the string.
+
+ @param Value Pointer to the string to write.
+ */
+VOID
+YoriPkgWriteInstalledDatabaseString(
+    __out_opt PUCHAR Buffer,
+    __inout PDWORD Offset,
+    __in PYORI_STRING Value
+    )
+{
+    YoriPkgWriteInstalledDatabaseDword(Buffer, Offset, Value->LengthInChars);
+    if (Buffer != NULL && Value->LengthInChars > 0) {
+        memcpy(&Buffer[*Offset], Value->StartOfString, Value->LengthInChars * sizeof(TCHAR));
+    }
+    *Offset += Value->LengthInChars * sizeof(TCHAR);
+}
+
+/**
+ Serialize the installed package database into a buffer.
+
+ @param Db Pointer to the installed package database.
+
+ @param Buffer Optionally points to the buffer to write to.  If NULL, no
+        data is written but the size of the buffer required is returned.
+
+ @return The number of bytes in the serialized database.
+ */
+DWORD
+YoriPkgSerializeInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __out_opt PUCHAR Buffer
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    YORIPKG_DB_HEADER Header;
+    DWORD FileIndex;
+    DWORD Offset;
+
+    if (Buffer != NULL) {
+        Header.Signature = YORIPKG_DB_SIGNATURE;
+        Header.Version = YORIPKG_DB_VERSION;
+        Header.CharSize = sizeof(TCHAR);
+        Header.PackageCount = Db->PackageCount;
+        memcpy(Buffer, &Header, sizeof(Header));
+    }
+    Offset = sizeof(Header);
+
+    ListEntry = YoriLibGetNextListEntry(&Db->PackageList, NULL);
+    while (ListEntry != NULL) {
+        Package = CONTAINING_RECORD(ListEntry, YORIPKG_INSTALLED_PACKAGE, ListEntry);
+
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->PackageName);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->InstalledVersion);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->Version);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->Architecture);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->UpgradePath);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->SourcePath);
+        YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->SymbolPath);
+        YoriPkgWriteInstalledDatabaseDword(Buffer, &Offset, Package->FileCount);
+        for (FileIndex = 0; FileIndex < Package->FileCount; FileIndex++) {
+            YoriPkgWriteInstalledDatabaseString(Buffer, &Offset, &Package->Files[FileIndex]->RelativeFileName);
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&Db->PackageList, ListEntry);
+    }
+
+    return Offset;
+}
+
+/**
+ Parse the contents of an installed package database file into memory.
+
+ @param Db Pointer to an empty installed package database to populate.
+
+ @param Buffer Pointer to the contents of the file.
+
+ @param BufferLength The number of bytes in Buffer.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code indicating
+         the reason for failure.
+ */
+DWORD
+YoriPkgParseInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PUCHAR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    YORIPKG_DB_HEADER Header;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    YORI_STRING PackageName;
+    YORI_STRING FileName;
+    DWORD PackageIndex;
+    DWORD FileIndex;
+    DWORD FileCount;
+    DWORD Offset;
+
+    if (BufferLength < sizeof(Header)) {
+        return ERROR_FILE_CORRUPT;
+    }
+
+    memcpy(&Header, Buffer, sizeof(Header));
+    if (Header.Signature != YORIPKG_DB_SIGNATURE ||
+        Header.Version != YORIPKG_DB_VERSION ||
+        Header.CharSize != sizeof(TCHAR)) {
+
+        return ERROR_FILE_CORRUPT;
+    }
+
+    Offset = sizeof(Header);
+    for (PackageIndex = 0; PackageIndex < Header.PackageCount; PackageIndex++) {
+        if (!YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &PackageName)) {
+            return ERROR_FILE_CORRUPT;
+        }
+
+        if (PackageName.LengthInChars == 0 ||
+            YoriPkgFindInstalledPackage(Db, &PackageName) != NULL) {
+
+            YoriLibFreeStringContents(&PackageName);
+            return ERROR_FILE_CORRUPT;
+        }
+
+        Package = YoriPkgAddInstalledPackage(Db, &PackageName);
+        YoriLibFreeStringContents(&PackageName);
+        if (Package == NULL) {
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        if (!YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->InstalledVersion) ||
+            !YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->Version) ||
+            !YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->Architecture) ||
+            !YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->UpgradePath) ||
+            !YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->SourcePath) ||
+            !YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &Package->SymbolPath)) {
+
+            return ERROR_FILE_CORRUPT;
+        }
+
+        if (BufferLength - Offset < sizeof(DWORD)) {
+            return ERROR_FILE_CORRUPT;
+        }
+        memcpy(&FileCount, &Buffer[Offset], sizeof(DWORD));
+        Offset += sizeof(DWORD);
+
+        for (FileIndex = 0; FileIndex < FileCount; FileIndex++) {
+            if (!YoriPkgReadInstalledDatabaseString(Buffer, BufferLength, &Offset, &FileName)) {
+                return ERROR_FILE_CORRUPT;
+            }
+            if (!YoriPkgAddInstalledPackageFile(Db, Package, &FileName)) {
+                YoriLibFreeStringContents(&FileName);
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+            YoriLibFreeStringContents(&FileName);
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Populate the installed package database from the legacy packages.ini file,
+ which recorded installed packages in its Installed section with a section
+ per package describing its fields and files.  This is used the first time
+ the database is opened on a system which has not yet been migrated.  The
+ legacy sections are removed after the database is first flushed.
+
+ @param Db Pointer to an empty installed package database to populate.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code indicating
+         the reason for failure.
+ */
+DWORD
+YoriPkgImportInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    YORI_STRING InstalledSection;
+    YORI_STRING PkgNameOnly;
+    YORI_STRING InstalledVersion;
+    YORI_STRING IniValue;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    LPTSTR IniFile;
+    DWORD LineLength;
+    DWORD FileCount;
+    DWORD FileIndex;
+    TCHAR FileIndexString[16];
+    DWORD Err;
+
+    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriLibFreeStringContents(&InstalledSection);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    IniFile = Db->IniFile.StartOfString;
+    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, IniFile);
+    if (InstalledSection.LengthInChars > 0) {
+        Db->LegacyImported = TRUE;
+    }
+
+    YoriLibInitEmptyString(&PkgNameOnly);
+    ThisLine = InstalledSection.StartOfString;
+
+    Err = ERROR_SUCCESS;
+    while (*ThisLine != '\0') {
+        LineLength = _tcslen(ThisLine);
+        PkgNameOnly.StartOfString = ThisLine;
+        Equals = _tcschr(ThisLine, '=');
+        if (Equals != NULL) {
+            PkgNameOnly.LengthInChars = (DWORD)(Equals - ThisLine);
+            YoriLibConstantString(&InstalledVersion, Equals + 1);
+        } else {
+            PkgNameOnly.LengthInChars = LineLength;
+            YoriLibInitEmptyString(&InstalledVersion);
+        }
+        ThisLine += LineLength;
+        ThisLine++;
+        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
+
+        Package = YoriPkgAddInstalledPackage(Db, &PkgNameOnly);
+        if (Package == NULL ||
+            !YoriPkgCopyInstalledPackageString(&Package->InstalledVersion, &InstalledVersion)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("Version"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+        if (!YoriPkgCopyInstalledPackageString(&Package->Version, &IniValue)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("Architecture"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+        if (!YoriPkgCopyInstalledPackageString(&Package->Architecture, &IniValue)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("UpgradePath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+        if (!YoriPkgCopyInstalledPackageString(&Package->UpgradePath, &IniValue)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("SourcePath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+        if (!YoriPkgCopyInstalledPackageString(&Package->SourcePath, &IniValue)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, _T("SymbolPath"), _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+        if (!YoriPkgCopyInstalledPackageString(&Package->SymbolPath, &IniValue)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        FileCount = GetPrivateProfileInt(PkgNameOnly.StartOfString, _T("FileCount"), 0, IniFile);
+        for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
+            YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
+            IniValue.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, FileIndexString, _T(""), IniValue.StartOfString, IniValue.LengthAllocated, IniFile);
+            if (IniValue.LengthInChars == 0) {
+                continue;
+            }
+            if (!YoriPkgAddInstalledPackageFile(Db, Package, &IniValue)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+        }
+
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&InstalledSection);
+    YoriLibFreeStringContents(&IniValue);
+
+    return Err;
+}
+
+/**
+ Remove the legacy Installed section, and the section describing each
+ package it refers to, from the packages.ini file.  This is done once the
+ imported contents have been written to the installed package database, so
+ the two cannot disagree later.
+
+ @param Db Pointer to the installed package database.
+ */
+VOID
+YoriPkgRemoveLegacyInstalledSections(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    YORI_STRING InstalledSection;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    LPTSTR IniFile;
+    DWORD LineLength;
+
+    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+        return;
+    }
+
+    IniFile = Db->IniFile.StartOfString;
+    InstalledSection.LengthInChars = GetPrivateProfileSection(_T("Installed"), InstalledSection.StartOfString, InstalledSection.LengthAllocated, IniFile);
+
+    ThisLine = InstalledSection.StartOfString;
+    while (*ThisLine != '\0') {
+        LineLength = _tcslen(ThisLine);
+        Equals = _tcschr(ThisLine, '=');
+        if (Equals != NULL) {
+            *Equals = '\0';
+        }
+        WritePrivateProfileString(ThisLine, NULL, NULL, IniFile);
+        ThisLine += LineLength;
+        ThisLine++;
+    }
+
+    WritePrivateProfileString(_T("Installed"), NULL, NULL, IniFile);
+    YoriLibFreeStringContents(&InstalledSection);
+}
+
+/**
+ Remove every package from an installed package database, leaving it empty
+ so that it can be populated from another source.
+
+ @param Db Pointer to the installed package database.
+ */
+VOID
+YoriPkgEmptyInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_INSTALLED_PACKAGE Package;
+
+    ListEntry = YoriLibGetNextListEntry(&Db->PackageList, NULL);
+    while (ListEntry != NULL) {
+        Package = CONTAINING_RECORD(ListEntry, YORIPKG_INSTALLED_PACKAGE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Db->PackageList, ListEntry);
+        YoriPkgRemoveInstalledPackage(Db, Package);
+    }
+
+    Db->LegacyImported = FALSE;
+    Db->Dirty = FALSE;
+}
+
+/**
+ Return the path to the backup copy of the installed package database, which
+ is refreshed after each successful flush and used if the database itself
+ cannot be read.
+
+ @param Db Pointer to the installed package database.
+
+ @param BackupFile On successful completion, populated with the path to the
+        backup copy of the database.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgGetInstalledDatabaseBackupFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __out PYORI_STRING BackupFile
+    )
+{
+    YoriLibInitEmptyString(BackupFile);
+    YoriLibYPrintf(BackupFile, _T("%y.bak"), &Db->DbFile);
+    if (BackupFile->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Read an installed package database file into memory.
+
+ @param Db Pointer to an empty installed package database to populate.
+
+ @param FileName Pointer to the path of the file to read.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code indicating
+         the reason for failure.  ERROR_FILE_CORRUPT indicates the file
+         exists but its contents are not a valid database.
+ */
+DWORD
+YoriPkgReadInstalledDatabaseFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING FileName
+    )
+{
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD FileSize;
+    DWORD FileSizeHigh;
+    DWORD BytesRead;
+    DWORD Err;
+
+    FileHandle = CreateFile(FileName->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    FileSize = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSizeHigh != 0 || FileSize < sizeof(YORIPKG_DB_HEADER)) {
+        CloseHandle(FileHandle);
+        return ERROR_FILE_CORRUPT;
+    }
+
+    Buffer = YoriLibMalloc(FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, FileSize, &BytesRead, NULL) ||
+        BytesRead != FileSize) {
+
+        Err = GetLastError();
+        if (Err == ERROR_SUCCESS) {
+            Err = ERROR_FILE_CORRUPT;
+        }
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return Err;
+    }
+
+    CloseHandle(FileHandle);
+
+    Err = YoriPkgParseInstalledDatabase(Db, Buffer, FileSize);
+    YoriLibFree(Buffer);
+    Db->Dirty = FALSE;
+    return Err;
+}
+
+/**
+ Load the installed package database from disk.  If the database cannot be
+ read because it is missing or corrupt, the backup copy written by the last
+ successful flush is used.  If that is not available either, the database is
+ imported from the legacy packages.ini file.  Any recovered database is
+ written out the next time the database is flushed.
+
+ @param Db Pointer to an empty installed package database to populate.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code indicating
+         the reason for failure.
+ */
+DWORD
+YoriPkgLoadInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    YORI_STRING BackupFile;
+    BOOL Corrupt;
+    DWORD Err;
+
+    Err = YoriPkgReadInstalledDatabaseFile(Db, &Db->DbFile);
+    if (Err == ERROR_SUCCESS) {
+        return ERROR_SUCCESS;
+    }
+
+    if (Err == ERROR_FILE_CORRUPT) {
+        Corrupt = TRUE;
+    } else if (Err == ERROR_FILE_NOT_FOUND || Err == ERROR_PATH_NOT_FOUND) {
+        Corrupt = FALSE;
+    } else {
+        return Err;
+    }
+
+    YoriPkgEmptyInstalledDatabase(Db);
+
+    if (!YoriPkgGetInstalledDatabaseBackupFile(Db, &BackupFile)) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Err = YoriPkgReadInstalledDatabaseFile(Db, &BackupFile);
+    if (Err == ERROR_SUCCESS) {
+        if (Corrupt) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Installed package database %y is corrupt, restored from %y\n"), &Db->DbFile, &BackupFile);
+        }
+        YoriLibFreeStringContents(&BackupFile);
+        Db->Dirty = TRUE;
+        return ERROR_SUCCESS;
+    }
+
+    YoriLibFreeStringContents(&BackupFile);
+    if (Err == ERROR_NOT_ENOUGH_MEMORY) {
+        return Err;
+    }
+
+    YoriPkgEmptyInstalledDatabase(Db);
+
+    Err = YoriPkgImportInstalledDatabase(Db);
+    if (Err != ERROR_SUCCESS) {
+        return Err;
+    }
+
+    if (Corrupt) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Installed package database %y is corrupt, rebuilt from %y\n"), &Db->DbFile, &Db->IniFile);
+        Db->Dirty = TRUE;
+    } else if (Db->PackageCount == 0) {
+        Db->Dirty = FALSE;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Write any changes to the installed package database to disk.  The database
+ is written to a temporary file which then replaces the existing database,
+ so the database on disk always reflects a complete set of changes.
+
+ @param Db Pointer to the installed package database.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriPkgFlushInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    YORI_STRING TempFile;
+    YORI_STRING BackupFile;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    if (!Db->Dirty) {
+        return TRUE;
+    }
+
+    BufferLength = YoriPkgSerializeInstalledDatabase(Db, NULL);
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriPkgSerializeInstalledDatabase(Db, Buffer);
+
+    YoriLibInitEmptyString(&TempFile);
+    YoriLibYPrintf(&TempFile, _T("%y.tmp"), &Db->DbFile);
+    if (TempFile.LengthInChars == 0) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(TempFile.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempFile);
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (WriteFile(FileHandle, Buffer, BufferLength, &BytesWritten, NULL) &&
+        BytesWritten == BufferLength &&
+        FlushFileBuffers(FileHandle)) {
+
+        Result = TRUE;
+    }
+
+    CloseHandle(FileHandle);
+    YoriLibFree(Buffer);
+
+    if (Result) {
+        Result = MoveFileEx(TempFile.StartOfString, Db->DbFile.StartOfString, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    }
+
+    if (Result) {
+        Db->Dirty = FALSE;
+    } else {
+        DeleteFile(TempFile.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempFile);
+
+    if (Result) {
+
+        //
+        //  Refresh the backup copy used if the database is later found to
+        //  be corrupt.  The database itself is already safely on disk, so
+        //  failing to update the backup does not fail the flush.
+        //
+
+        if (YoriPkgGetInstalledDatabaseBackupFile(Db, &BackupFile)) {
+            CopyFile(Db->DbFile.StartOfString, BackupFile.StartOfString, FALSE);
+            YoriLibFreeStringContents(&BackupFile);
+        }
+
+        if (Db->LegacyImported) {
+            YoriPkgRemoveLegacyInstalledSections(Db);
+            Db->LegacyImported = FALSE;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ Deallocate an installed package database and everything it contains.  Any
+ changes which have not been flushed are discarded.
+
+ @param Db Pointer to the installed package database.
+ */
+VOID
+YoriPkgFreeInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    YoriPkgEmptyInstalledDatabase(Db);
+
+    if (Db->PackageTable != NULL) {
+        YoriLibFreeEmptyHashTable(Db->PackageTable);
+    }
+    if (Db->FileTable != NULL) {
+        YoriLibFreeEmptyHashTable(Db->FileTable);
+    }
+    YoriLibFreeStringContents(&Db->IniFile);
+    YoriLibFreeStringContents(&Db->DbFile);
+    YoriLibFree(Db);
+}
+
+/**
+ Open the database of installed packages corresponding to a packages.ini
+ file.  If the database is already open, the existing in memory copy is
+ returned, so nested callers observe each other's changes.  Each successful
+ call must be paired with @ref YoriPkgCloseInstalledDatabase .
+
+ @param PkgIniFile Pointer to the path to the system packages.ini file.
+
+ @param Db On successful completion, populated with a pointer to the
+        installed package database.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code indicating
+         the reason for failure.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgOpenInstalledDatabase(
+    __in PYORI_STRING PkgIniFile,
+    __out PYORIPKG_INSTALLED_DB *Db
+    )
+{
+    PYORIPKG_INSTALLED_DB NewDb;
+    DWORD Err;
+
+    NewDb = YoriPkgOpenInstalledDbs;
+    while (NewDb != NULL) {
+        if (YoriLibCompareStringInsensitive(&NewDb->IniFile, PkgIniFile) == 0) {
+            NewDb->ReferenceCount++;
+            *Db = NewDb;
+            return ERROR_SUCCESS;
+        }
+        NewDb = NewDb->Next;
+    }
+
+    NewDb = YoriLibMalloc(sizeof(YORIPKG_INSTALLED_DB));
+    if (NewDb == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    ZeroMemory(NewDb, sizeof(YORIPKG_INSTALLED_DB));
+    NewDb->ReferenceCount = 1;
+    YoriLibInitializeListHead(&NewDb->PackageList);
+
+    if (!YoriPkgCopyInstalledPackageString(&NewDb->IniFile, PkgIniFile) ||
+        !YoriPkgGetInstalledDatabaseFile(PkgIniFile, &NewDb->DbFile)) {
+
+        YoriPkgFreeInstalledDatabase(NewDb);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    NewDb->PackageTable = YoriLibAllocateHashTable(YORIPKG_DB_PACKAGE_BUCKETS);
+    NewDb->FileTable = YoriLibAllocateHashTable(YORIPKG_DB_FILE_BUCKETS);
+    if (NewDb->PackageTable == NULL || NewDb->FileTable == NULL) {
+        YoriPkgFreeInstalledDatabase(NewDb);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Err = YoriPkgLoadInstalledDatabase(NewDb);
+    if (Err != ERROR_SUCCESS) {
+        YoriPkgFreeInstalledDatabase(NewDb);
+        return Err;
+    }
+
+    NewDb->Next = YoriPkgOpenInstalledDbs;
+    YoriPkgOpenInstalledDbs = NewDb;
+
+    *Db = NewDb;
+    return ERROR_SUCCESS;
+}
+
+/**
+ Close an installed package database opened with
+ @ref YoriPkgOpenInstalledDatabase .  Any changes are written to disk, and
+ when the final reference is released, the in memory copy is deallocated.
+
+ @param Db Pointer to the installed package database.
+
+ @return TRUE to indicate any changes were written successfully, FALSE if
+         they could not be written.
+ */
+BOOL
+YoriPkgCloseInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    )
+{
+    PYORIPKG_INSTALLED_DB *Link;
+    BOOL Result;
+
+    Result = YoriPkgFlushInstalledDatabase(Db);
+
+    Db->ReferenceCount--;
+    if (Db->ReferenceCount > 0) {
+        return Result;
+    }
+
+    Link = &YoriPkgOpenInstalledDbs;
+    while (*Link != NULL) {
+        if (*Link == Db) {
+            *Link = Db->Next;
+            break;
+        }
+        Link = &(*Link)->Next;
+    }
+
+    YoriPkgFreeInstalledDatabase(Db);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
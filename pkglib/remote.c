@@ -453,13 +453,14 @@ YoriPkgCollectSourcesFromIniWithDefaults(
 
 
 /**
- Scan a repository of packages and collect all packages it contains into a
- caller provided list.
+ Parse the pkglist.ini from a repository of packages which has been copied
+ to a local file and collect all packages it contains into a caller provided
+ list.
 
  @param Source Pointer to the source of the repository.
 
- @param PackagesIni Pointer to a string containing a path to the package INI
-        file.
+ @param LocalPath Pointer to a fully qualified local path to the repository's
+        pkglist.ini file.
 
  @param PackageList Pointer to a list to update with any new packages found.
 
@@ -470,14 +471,13 @@ YoriPkgCollectSourcesFromIniWithDefaults(
          or a Win32 error code indicating the reason for any failure.
  */
 DWORD
-YoriPkgCollectPackagesFromSource(
+YoriPkgCollectPackagesFromLocalPkgList(
     __in PYORIPKG_REMOTE_SOURCE Source,
-    __in PYORI_STRING PackagesIni,
+    __in PYORI_STRING LocalPath,
     __inout PYORI_LIST_ENTRY PackageList,
     __inout_opt PYORI_LIST_ENTRY SourcesList
     )
 {
-    YORI_STRING LocalPath;
     YORI_STRING ProvidesSection;
     YORI_STRING PkgNameOnly;
     YORI_STRING PkgVersion;
@@ -485,7 +485,6 @@ YoriPkgCollectPackagesFromSource(
     YORI_STRING Architecture;
     YORI_STRING MinimumOSBuild;
     YORI_STRING PackagePathForOlderBuilds;
-    BOOL DeleteWhenFinished = FALSE;
     LPTSTR ThisLine;
     LPTSTR Equals;
     LPTSTR KnownArchitectures[] = {_T("noarch"), _T("win32"), _T("amd64")};
@@ -495,17 +494,12 @@ YoriPkgCollectPackagesFromSource(
     DWORD ArchIndex;
     DWORD Result;
 
-    YoriLibInitEmptyString(&LocalPath);
     YoriLibInitEmptyString(&ProvidesSection);
     YoriLibInitEmptyString(&IniValue);
     YoriLibInitEmptyString(&PkgVersion);
     YoriLibInitEmptyString(&MinimumOSBuild);
     YoriLibInitEmptyString(&PackagePathForOlderBuilds);
-
-    Result = YoriPkgPackagePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
-    if (Result != ERROR_SUCCESS) {
-        goto Exit;
-    }
+    Result = ERROR_SUCCESS;
 
     if (!YoriLibAllocateString(&ProvidesSection, YORIPKG_MAX_SECTION_LENGTH * 5)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
@@ -529,7 +523,7 @@ YoriPkgCollectPackagesFromSource(
     ProvidesSection.LengthInChars = GetPrivateProfileSection(_T("Provides"),
                                                              ProvidesSection.StartOfString,
                                                              ProvidesSection.LengthAllocated,
-                                                             LocalPath.StartOfString);
+                                                             LocalPath->StartOfString);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = ProvidesSection.StartOfString;
@@ -553,7 +547,7 @@ YoriPkgCollectPackagesFromSource(
                                                            _T(""),
                                                            PkgVersion.StartOfString,
                                                            PkgVersion.LengthAllocated,
-                                                           LocalPath.StartOfString);
+                                                           LocalPath->StartOfString);
 
         if (PkgVersion.LengthInChars > 0) {
             for (ArchIndex = 0; ArchIndex < sizeof(KnownArchitectures)/sizeof(KnownArchitectures[0]); ArchIndex++) {
@@ -563,7 +557,7 @@ YoriPkgCollectPackagesFromSource(
                                                                  _T(""),
                                                                  IniValue.StartOfString,
                                                                  IniValue.LengthAllocated,
-                                                                 LocalPath.StartOfString);
+                                                                 LocalPath->StartOfString);
                 if (IniValue.LengthInChars > 0) {
                     PYORIPKG_REMOTE_PACKAGE Package;
 
@@ -571,10 +565,10 @@ YoriPkgCollectPackagesFromSource(
 
                     YoriLibSPrintf(IniKey, _T("%y.minimumosbuild"), &Architecture);
 
-                    MinimumOSBuild.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, IniKey, _T(""), MinimumOSBuild.StartOfString, MinimumOSBuild.LengthAllocated, LocalPath.StartOfString);
+                    MinimumOSBuild.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, IniKey, _T(""), MinimumOSBuild.StartOfString, MinimumOSBuild.LengthAllocated, LocalPath->StartOfString);
                     if (MinimumOSBuild.LengthInChars > 0) {
                         YoriLibSPrintf(IniKey, _T("%y.packagepathforolderbuilds"), &Architecture);
-                        PackagePathForOlderBuilds.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, IniKey, _T(""), PackagePathForOlderBuilds.StartOfString, PackagePathForOlderBuilds.LengthAllocated, LocalPath.StartOfString);
+                        PackagePathForOlderBuilds.LengthInChars = GetPrivateProfileString(PkgNameOnly.StartOfString, IniKey, _T(""), PackagePathForOlderBuilds.StartOfString, PackagePathForOlderBuilds.LengthAllocated, LocalPath->StartOfString);
                     }
 
 
@@ -594,16 +588,12 @@ YoriPkgCollectPackagesFromSource(
         }
     }
 
-    if (!YoriPkgCollectSourcesFromIni(&LocalPath, SourcesList)) {
+    if (!YoriPkgCollectSourcesFromIni(LocalPath, SourcesList)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
     }
 
 Exit:
-    if (DeleteWhenFinished) {
-        DeleteFile(LocalPath.StartOfString);
-    }
-    YoriLibFreeStringContents(&LocalPath);
     YoriLibFreeStringContents(&ProvidesSection);
     YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&PkgVersion);
@@ -612,6 +602,50 @@ Exit:
     return Result;
 }
 
+/**
+ Scan a repository of packages and collect all packages it contains into a
+ caller provided list.
+
+ @param Source Pointer to the source of the repository.
+
+ @param PackagesIni Pointer to a string containing a path to the package INI
+        file.
+
+ @param PackageList Pointer to a list to update with any new packages found.
+
+ @param SourcesList Pointer to a list of sources to update with any new
+        sources to check.
+
+ @return ERROR_SUCCESS to indicate packages were collected from source,
+         or a Win32 error code indicating the reason for any failure.
+ */
+DWORD
+YoriPkgCollectPackagesFromSource(
+    __in PYORIPKG_REMOTE_SOURCE Source,
+    __in PYORI_STRING PackagesIni,
+    __inout PYORI_LIST_ENTRY PackageList,
+    __inout_opt PYORI_LIST_ENTRY SourcesList
+    )
+{
+    YORI_STRING LocalPath;
+    BOOL DeleteWhenFinished = FALSE;
+    DWORD Result;
+
+    YoriLibInitEmptyString(&LocalPath);
+    Result = YoriPkgPackagePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
+    if (Result != ERROR_SUCCESS) {
+        return Result;
+    }
+
+    Result = YoriPkgCollectPackagesFromLocalPkgList(Source, &LocalPath, PackageList, SourcesList);
+
+    if (DeleteWhenFinished) {
+        DeleteFile(LocalPath.StartOfString);
+    }
+    YoriLibFreeStringContents(&LocalPath);
+    return Result;
+}
+
 /**
  Examine the currently configured set of sources, query each of those
  including any sources they refer to, and build a complete list of packages
@@ -643,9 +677,15 @@ YoriPkgCollectAllSourcesAndPackages(
     )
 {
     PYORI_LIST_ENTRY SourceEntry;
+    PYORI_LIST_ENTRY WaveEntry;
     PYORIPKG_REMOTE_SOURCE Source;
     DWORD Result;
+    DWORD Index;
+    DWORD WaveCount;
     YORI_STRING PackagesIni;
+    YORI_STRING LocalPath;
+    BOOL DeleteWhenFinished;
+    YORIPKG_DOWNLOAD_POOL Pool;
 
     if (!YoriPkgGetPackageIniFile(NewDirectory, &PackagesIni)) {
         return FALSE;
@@ -670,19 +710,61 @@ YoriPkgCollectAllSourcesAndPackages(
 
     //
     //  Go through all known sources collecting packages and additional
-    //  sources.
+    //  sources.  Sources are processed in waves: the package lists for all
+    //  sources known at the start of a wave are downloaded concurrently,
+    //  and are parsed in order as they arrive.  Any sources they refer to
+    //  are appended to the list and form the next wave.
     //
 
     SourceEntry = NULL;
     SourceEntry = YoriLibGetNextListEntry(SourcesList, SourceEntry);
     while (SourceEntry != NULL) {
-        Source = CONTAINING_RECORD(SourceEntry, YORIPKG_REMOTE_SOURCE, SourceList);
-        Result = YoriPkgCollectPackagesFromSource(Source, &PackagesIni, PackageList, SourcesList);
-        if (Result != ERROR_SUCCESS) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error obtaining package list from %y: "), &Source->SourceRootUrl);
-            YoriPkgDisplayErrorStringForInstallFailure(Result);
+
+        WaveCount = 0;
+        WaveEntry = SourceEntry;
+        while (WaveEntry != NULL) {
+            WaveCount++;
+            WaveEntry = YoriLibGetNextListEntry(SourcesList, WaveEntry);
         }
-        SourceEntry = YoriLibGetNextListEntry(SourcesList, SourceEntry);
+
+        if (!YoriPkgInitializeDownloadPool(&Pool, &PackagesIni, WaveCount)) {
+            YoriLibFreeStringContents(&PackagesIni);
+            return FALSE;
+        }
+
+        WaveEntry = SourceEntry;
+        for (Index = 0; Index < WaveCount; Index++) {
+            Source = CONTAINING_RECORD(WaveEntry, YORIPKG_REMOTE_SOURCE, SourceList);
+            if (!YoriPkgAddToDownloadPool(&Pool, &Source->SourcePkgList)) {
+                YoriPkgCleanupDownloadPool(&Pool);
+                YoriLibFreeStringContents(&PackagesIni);
+                return FALSE;
+            }
+            WaveEntry = YoriLibGetNextListEntry(SourcesList, WaveEntry);
+        }
+
+        YoriPkgStartDownloadPool(&Pool);
+
+        for (Index = 0; Index < WaveCount; Index++) {
+            Source = CONTAINING_RECORD(SourceEntry, YORIPKG_REMOTE_SOURCE, SourceList);
+            YoriLibInitEmptyString(&LocalPath);
+            DeleteWhenFinished = FALSE;
+            Result = YoriPkgWaitForDownload(&Pool, Index, &LocalPath, &DeleteWhenFinished);
+            if (Result == ERROR_SUCCESS) {
+                Result = YoriPkgCollectPackagesFromLocalPkgList(Source, &LocalPath, PackageList, SourcesList);
+                if (DeleteWhenFinished) {
+                    DeleteFile(LocalPath.StartOfString);
+                }
+                YoriLibFreeStringContents(&LocalPath);
+            }
+            if (Result != ERROR_SUCCESS) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error obtaining package list from %y: "), &Source->SourceRootUrl);
+                YoriPkgDisplayErrorStringForInstallFailure(Result);
+            }
+            SourceEntry = YoriLibGetNextListEntry(SourcesList, SourceEntry);
+        }
+
+        YoriPkgCleanupDownloadPool(&Pool);
     }
     YoriLibFreeStringContents(&PackagesIni);
 
@@ -767,10 +849,38 @@ YoriPkgDisplayAvailableRemotePackages()
     return TRUE;
 }
 
+/**
+ Find the final file component in a package URL.
+
+ @param InstallUrl Pointer to the URL of the package.
+
+ @param FinalFileName On completion, updated to point to the final component
+        within InstallUrl.  This is an empty string if the URL has no final
+        component.
+ */
+VOID
+YoriPkgGetFinalFileNameFromUrl(
+    __in PYORI_STRING InstallUrl,
+    __out PYORI_STRING FinalFileName
+    )
+{
+    DWORD Index;
+
+    YoriLibInitEmptyString(FinalFileName);
+    for (Index = InstallUrl->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(InstallUrl->StartOfString[Index - 1])) {
+            FinalFileName->StartOfString = &InstallUrl->StartOfString[Index];
+            FinalFileName->LengthInChars = InstallUrl->LengthInChars - Index;
+            break;
+        }
+    }
+}
+
 /**
  Enumerate all packages on a server from its pkglist.ini, download all of the
  packages to a local directory, and generate a pkglist.ini in that directory
- from the contents.
+ from the contents.  Packages are downloaded concurrently, and each is saved
+ as soon as it arrives.
 
  @param Source Pointer to a remote path from which to download packages.
 
@@ -792,6 +902,8 @@ YoriPkgDownloadRemotePackages(
     YORI_STRING FullFinalName;
     YORI_STRING TempLocalPath;
     YORI_STRING PackagesIni;
+    YORIPKG_DOWNLOAD_POOL Pool;
+    DWORD PackageCount;
     DWORD Index;
     DWORD Err;
     BOOL DeleteWhenFinished;
@@ -806,9 +918,46 @@ YoriPkgDownloadRemotePackages(
     }
 
     //
-    //  Download the packages we found.
+    //  Queue all of the packages we found for download.
     //
 
+    PackageCount = 0;
+    PackageEntry = NULL;
+    PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    while (PackageEntry != NULL) {
+        PackageCount++;
+        PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    }
+
+    if (!YoriPkgInitializeDownloadPool(&Pool, NULL, PackageCount)) {
+        YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
+        YoriLibFreeStringContents(&PackagesIni);
+        return FALSE;
+    }
+
+    PackageEntry = NULL;
+    PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    while (PackageEntry != NULL) {
+        Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        YoriPkgGetFinalFileNameFromUrl(&Package->InstallUrl, &FinalFileName);
+        if (FinalFileName.LengthInChars > 0) {
+            if (!YoriPkgAddToDownloadPool(&Pool, &Package->InstallUrl)) {
+                YoriPkgCleanupDownloadPool(&Pool);
+                YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
+                YoriLibFreeStringContents(&PackagesIni);
+                return FALSE;
+            }
+        }
+        PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    }
+
+    YoriPkgStartDownloadPool(&Pool);
+
+    //
+    //  Save each package as its download completes.
+    //
+
+    Index = 0;
     PackageEntry = NULL;
     PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     while (PackageEntry != NULL) {
@@ -818,26 +967,20 @@ YoriPkgDownloadRemotePackages(
         //  Find the final file component in the URL
         //
 
-        YoriLibInitEmptyString(&FinalFileName);
-        for (Index = Package->InstallUrl.LengthInChars; Index > 0; Index--) {
-            if (YoriLibIsSep(Package->InstallUrl.StartOfString[Index - 1])) {
-                FinalFileName.StartOfString = &Package->InstallUrl.StartOfString[Index];
-                FinalFileName.LengthInChars = Package->InstallUrl.LengthInChars - Index;
-                break;
-            }
-        }
+        YoriPkgGetFinalFileNameFromUrl(&Package->InstallUrl, &FinalFileName);
 
         YoriLibInitEmptyString(&FullFinalName);
         if (FinalFileName.LengthInChars > 0) {
 
             //
-            //  Download the package, build a local path with the final file
-            //  component from the URL, and copy or move the package into
-            //  place.
+            //  Wait for the package to download, build a local path with the
+            //  final file component from the URL, and copy or move the
+            //  package into place.
             //
 
             YoriLibInitEmptyString(&TempLocalPath);
-            Err = YoriPkgPackagePathToLocalPath(&Package->InstallUrl, NULL, &TempLocalPath, &DeleteWhenFinished);
+            Err = YoriPkgWaitForDownload(&Pool, Index, &TempLocalPath, &DeleteWhenFinished);
+            Index++;
             if (Err == ERROR_SUCCESS) {
                 YoriLibYPrintf(&FullFinalName, _T("%y\\%y"), DownloadPath, &FinalFileName);
                 if (FullFinalName.LengthInChars == 0) {
@@ -905,6 +1048,7 @@ YoriPkgDownloadRemotePackages(
         PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     }
 
+    YoriPkgCleanupDownloadPool(&Pool);
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
     YoriLibFreeStringContents(&PackagesIni);
 
@@ -1162,6 +1306,7 @@ YoriPkgInstallRemotePackages(
     YORI_STRING IniFile;
     YORI_STRING IniValue;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
+    YORIPKG_DOWNLOAD_POOL Pool;
     DWORD Error;
 
     Result = FALSE;
@@ -1175,7 +1320,14 @@ YoriPkgInstallRemotePackages(
         return Result;
     }
 
+    if (!YoriPkgInitializeDownloadPool(&Pool, &IniFile, PackageNameCount)) {
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&IniFile);
+        return Result;
+    }
+
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriPkgCleanupDownloadPool(&Pool);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&IniFile);
         return Result;
@@ -1196,6 +1348,24 @@ YoriPkgInstallRemotePackages(
                                                      MatchArch,
                                                      &PackagesMatchingCriteria);
 
+    //
+    //  Start downloading all of the packages.  Each package is prepared for
+    //  installation as soon as it arrives, while later packages continue to
+    //  download.  If a package can't be queued, it is downloaded when it is
+    //  prepared.
+    //
+
+    PackageEntry = NULL;
+    PackageEntry = YoriLibGetNextListEntry(&PackagesMatchingCriteria, PackageEntry);
+    while (PackageEntry != NULL) {
+        Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        PackageEntry = YoriLibGetNextListEntry(&PackagesMatchingCriteria, PackageEntry);
+        YoriPkgAddToDownloadPool(&Pool, &Package->InstallUrl);
+    }
+
+    YoriPkgStartDownloadPool(&Pool);
+    PendingPackages.Downloads = &Pool;
+
     //
     //  Find if any of these are installed and back them up.
     //
@@ -1235,6 +1405,7 @@ Exit:
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
+    YoriPkgCleanupDownloadPool(&Pool);
 
     YoriPkgFreeAllSourcesAndPackages(NULL, &PackagesMatchingCriteria);
     YoriLibFreeStringContents(&IniFile);
@@ -247,86 +247,6 @@ YoriPkgGetPackageInfo(
     return TRUE;
 }
 
-/**
- Given a fully qualified path to the system package INI file and a package
- name, extract fixed sized information.
-
- @param IniPath Pointer to a path to the system's INI file.
-
- @param PackageName Pointer to the package's canonical name.
-
- @param PackageVersion On successful completion, populated with the package
-        version.
-
- @param PackageArch On successful completion, populated with the package
-        architecture.
-
- @param UpgradePath On successful completion, populated with a URL that will
-        return the latest version of the package.
-
- @param SourcePath On successful completion, populated with a URL that will
-        return the source code matching the package.
-
- @param SymbolPath On successful completion, populated with a URL that will
-        return the symbols for the package.
-
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-__success(return)
-BOOL
-YoriPkgGetInstalledPackageInfo(
-    __in PYORI_STRING IniPath,
-    __in PYORI_STRING PackageName,
-    __out PYORI_STRING PackageVersion,
-    __out PYORI_STRING PackageArch,
-    __out PYORI_STRING UpgradePath,
-    __out PYORI_STRING SourcePath,
-    __out PYORI_STRING SymbolPath
-    )
-{
-    YORI_STRING TempBuffer;
-    DWORD MaxFieldSize = YORIPKG_MAX_FIELD_LENGTH;
-
-    ASSERT(YoriLibIsStringNullTerminated(IniPath));
-    ASSERT(YoriLibIsStringNullTerminated(PackageName));
-
-    if (!YoriLibAllocateString(&TempBuffer, 5 * MaxFieldSize)) {
-        return FALSE;
-    }
-
-    YoriLibCloneString(PackageVersion, &TempBuffer);
-    PackageVersion->LengthAllocated = MaxFieldSize;
-
-    PackageVersion->LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("Version"), _T(""), PackageVersion->StartOfString, PackageVersion->LengthAllocated, IniPath->StartOfString);
-
-    YoriLibCloneString(PackageArch, &TempBuffer);
-    PackageArch->StartOfString += 1 * MaxFieldSize;
-    PackageArch->LengthAllocated = MaxFieldSize;
-
-    PackageArch->LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("Architecture"), _T(""), PackageArch->StartOfString, PackageArch->LengthAllocated, IniPath->StartOfString);
-
-    YoriLibCloneString(UpgradePath, &TempBuffer);
-    UpgradePath->StartOfString += 2 * MaxFieldSize;
-    UpgradePath->LengthAllocated = MaxFieldSize;
-
-    UpgradePath->LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("UpgradePath"), _T(""), UpgradePath->StartOfString, UpgradePath->LengthAllocated, IniPath->StartOfString);
-
-    YoriLibCloneString(SourcePath, &TempBuffer);
-    SourcePath->StartOfString += 3 * MaxFieldSize;
-    SourcePath->LengthAllocated = MaxFieldSize;
-
-    SourcePath->LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("SourcePath"), _T(""), SourcePath->StartOfString, SourcePath->LengthAllocated, IniPath->StartOfString);
-
-    YoriLibCloneString(SymbolPath, &TempBuffer);
-    SymbolPath->StartOfString += 4 * MaxFieldSize;
-    SymbolPath->LengthAllocated = MaxFieldSize;
-
-    SymbolPath->LengthInChars = GetPrivateProfileString(PackageName->StartOfString, _T("SymbolPath"), _T(""), SymbolPath->StartOfString, SymbolPath->LengthAllocated, IniPath->StartOfString);
-
-    YoriLibFreeStringContents(&TempBuffer);
-    return TRUE;
-}
-
 /**
  A structure identifying the mapping from one source location to a mirrored
  location.
@@ -886,9 +806,68 @@ Exit:
     return Result;
 }
 
+/**
+ The number of times to attempt to download a package before failing.  Each
+ attempt after the first resumes from the data received by earlier attempts.
+ Only failures that may succeed on a later attempt are retried.
+ */
+#define YORIPKG_DOWNLOAD_ATTEMPTS (3)
+
+/**
+ Build the name of the file used to hold partially received data for a URL.
+ The name is derived from the URL so that an interrupted download can be
+ resumed by a later attempt to download the same URL, including from a
+ later process.  The object's validator is recorded next to this file, and
+ a resumed download only appends to it if the object has not changed.
+
+ @param TempPath Pointer to the temporary directory, including a trailing
+        separator.
+
+ @param Url Pointer to the URL being downloaded.
+
+ @param PartialPath On successful completion, populated with the name of the
+        file to hold partial data.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgGetPartialDownloadPath(
+    __in PYORI_STRING TempPath,
+    __in PYORI_STRING Url,
+    __out PYORI_STRING PartialPath
+    )
+{
+    DWORD Index;
+    DWORD Hash1;
+    DWORD Hash2;
+
+    //
+    //  Combine two simple hashes so that distinct URLs are very unlikely to
+    //  share a partial file.
+    //
+
+    Hash1 = 5381;
+    Hash2 = 0;
+    for (Index = 0; Index < Url->LengthInChars; Index++) {
+        Hash1 = Hash1 * 33 + Url->StartOfString[Index];
+        Hash2 = Url->StartOfString[Index] + (Hash2 << 6) + (Hash2 << 16) - Hash2;
+    }
+
+    YoriLibInitEmptyString(PartialPath);
+    YoriLibYPrintf(PartialPath, _T("%yypm%08x%08x.part"), TempPath, Hash1, Hash2);
+    if (PartialPath->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Download a remote package into a temporary location and return the
- temporary location to allow for subsequent processing.
+ temporary location to allow for subsequent processing.  Data is received
+ into a file named for the URL, so if the download is interrupted it is
+ resumed, either by a later attempt in this call or by a later process.
 
  @param PackagePath Pointer to a string referring to the package which can
         be local or remote.
@@ -943,8 +922,10 @@ YoriPkgPackagePathToLocalPath(
 
         YORI_STRING TempPath;
         YORI_STRING TempFileName;
+        YORI_STRING PartialPath;
         YORI_STRING UserAgent;
         YoriLibUpdError Error;
+        DWORD Attempt;
         YoriLibInitEmptyString(&TempPath);
 
         //
@@ -988,7 +969,33 @@ YoriPkgPackagePathToLocalPath(
             goto Exit;
         }
 
-        Error = YoriLibUpdateBinaryFromUrl(MirroredPath.StartOfString, TempFileName.StartOfString, UserAgent.StartOfString, NULL);
+        if (!YoriPkgGetPartialDownloadPath(&TempPath, &MirroredPath, &PartialPath)) {
+            YoriLibFreeStringContents(&TempPath);
+            YoriLibFreeStringContents(&TempFileName);
+            YoriLibFreeStringContents(&UserAgent);
+            Result = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+
+        //
+        //  If the connection fails or is dropped, or the server reports a
+        //  temporary condition, try again.  Any data that has been received
+        //  is retained in the partial file, so the next attempt only needs
+        //  to request the remainder.  An error from the server that isn't
+        //  temporary, such as the package not existing, fails immediately.
+        //
+
+        Error = YoriLibUpdErrorInetConnect;
+        for (Attempt = 0; Attempt < YORIPKG_DOWNLOAD_ATTEMPTS; Attempt++) {
+            Error = YoriLibUpdateBinaryFromUrl(MirroredPath.StartOfString, TempFileName.StartOfString, UserAgent.StartOfString, NULL, PartialPath.StartOfString);
+            if (Error != YoriLibUpdErrorInetConnect &&
+                Error != YoriLibUpdErrorInetRead) {
+
+                break;
+            }
+        }
+
+        YoriLibFreeStringContents(&PartialPath);
 
         if (Error != YoriLibUpdErrorSuccess) {
             switch(Error) {
@@ -996,6 +1003,7 @@ YoriPkgPackagePathToLocalPath(
                 case YoriLibUpdErrorInetConnect:
                 case YoriLibUpdErrorInetRead:
                 case YoriLibUpdErrorInetContents:
+                case YoriLibUpdErrorInetStatus:
                     Result = ERROR_NO_NETWORK;
                     break;
                 case YoriLibUpdErrorFileWrite:
@@ -119,22 +119,271 @@ typedef struct _YORIPKG_BACKUP_PACKAGE {
 } YORIPKG_BACKUP_PACKAGE, *PYORIPKG_BACKUP_PACKAGE;
 
 /**
- A structure describing a currently installed file.  This allocation is
- followed by a variable length buffer containing the relative file name.
+ A file recorded as installed by a package.  This allocation is followed by
+ a variable length buffer containing the relative file name.
  */
-typedef struct _YORIPKG_EXISTING_FILE {
+typedef struct _YORIPKG_INSTALLED_FILE {
 
     /**
      The linkage for this file within the hash table of installed files.
      */
     YORI_HASH_ENTRY HashEntry;
 
+    /**
+     The package which installed this file.
+     */
+    struct _YORIPKG_INSTALLED_PACKAGE *Package;
+
     /**
      The relative name for the file.  This string contains a reference on
      the parent structure.
      */
     YORI_STRING RelativeFileName;
-} YORIPKG_EXISTING_FILE, *PYORIPKG_EXISTING_FILE;
+} YORIPKG_INSTALLED_FILE, *PYORIPKG_INSTALLED_FILE;
+
+/**
+ A package recorded as installed in the installed package database.
+ */
+typedef struct _YORIPKG_INSTALLED_PACKAGE {
+
+    /**
+     The linkage for this package within the list of installed packages.
+     Packages are kept in the order they were installed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The linkage for this package within the hash table of installed
+     packages, keyed by package name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The number of references on this structure.  The database holds one
+     reference while the package is installed.
+     */
+    DWORD ReferenceCount;
+
+    /**
+     The canonical name of the package.
+     */
+    YORI_STRING PackageName;
+
+    /**
+     The version recorded as installed.  This is "0" while the package is
+     being installed, so that an interrupted install will be retried by a
+     later upgrade, and matches Version once installation is complete.
+     */
+    YORI_STRING InstalledVersion;
+
+    /**
+     The version of the package.
+     */
+    YORI_STRING Version;
+
+    /**
+     The architecture of the package.
+     */
+    YORI_STRING Architecture;
+
+    /**
+     The path to upgrade the package from.  This can be an empty string if
+     the package does not support upgrade.
+     */
+    YORI_STRING UpgradePath;
+
+    /**
+     The path to the source code for the package.  This can be an empty
+     string.
+     */
+    YORI_STRING SourcePath;
+
+    /**
+     The path to the symbols for the package.  This can be an empty string.
+     */
+    YORI_STRING SymbolPath;
+
+    /**
+     The number of files installed by this package.
+     */
+    DWORD FileCount;
+
+    /**
+     The number of elements allocated in the Files array.
+     */
+    DWORD FilesAllocated;
+
+    /**
+     An array of files installed by this package, in the order they were
+     installed.
+     */
+    PYORIPKG_INSTALLED_FILE *Files;
+} YORIPKG_INSTALLED_PACKAGE, *PYORIPKG_INSTALLED_PACKAGE;
+
+/**
+ The set of installed packages, loaded into memory from packages.db and
+ indexed by package name and by installed file name.
+ */
+typedef struct _YORIPKG_INSTALLED_DB {
+
+    /**
+     The next database in the list of databases which are currently open.
+     */
+    struct _YORIPKG_INSTALLED_DB *Next;
+
+    /**
+     The path to the packages.ini file that the database corresponds to.
+     */
+    YORI_STRING IniFile;
+
+    /**
+     The path to the database file on disk.
+     */
+    YORI_STRING DbFile;
+
+    /**
+     The number of callers which have opened this database.
+     */
+    DWORD ReferenceCount;
+
+    /**
+     TRUE if the in memory database has changed since it was last written
+     to disk.
+     */
+    BOOL Dirty;
+
+    /**
+     TRUE if the database was imported from the legacy packages.ini
+     sections, which should be removed once the database has been written
+     to disk.
+     */
+    BOOL LegacyImported;
+
+    /**
+     A list of installed packages.  Paired with
+     @ref YORIPKG_INSTALLED_PACKAGE::ListEntry .
+     */
+    YORI_LIST_ENTRY PackageList;
+
+    /**
+     The number of packages in PackageList.
+     */
+    DWORD PackageCount;
+
+    /**
+     A hash table of installed packages, keyed by package name.
+     */
+    PYORI_HASH_TABLE PackageTable;
+
+    /**
+     A hash table of installed files, keyed by the file name relative to
+     the installation directory.
+     */
+    PYORI_HASH_TABLE FileTable;
+} YORIPKG_INSTALLED_DB, *PYORIPKG_INSTALLED_DB;
+
+/**
+ The maximum number of threads used to download packages concurrently.
+ */
+#define YORIPKG_DOWNLOAD_THREADS (4)
+
+/**
+ A single package or package list being downloaded by a download pool.
+ */
+typedef struct _YORIPKG_DOWNLOAD_ITEM {
+
+    /**
+     The path or URL to download.
+     */
+    YORI_STRING PackagePath;
+
+    /**
+     On completion, a fully qualified local path to the downloaded file.
+     */
+    YORI_STRING LocalPath;
+
+    /**
+     On completion, TRUE if LocalPath refers to a temporary file which should
+     be deleted when processing is complete.
+     */
+    BOOL DeleteWhenFinished;
+
+    /**
+     TRUE once the caller has taken ownership of LocalPath.
+     */
+    BOOL Claimed;
+
+    /**
+     On completion, a Win32 error code indicating the result of the
+     download.
+     */
+    DWORD Result;
+
+    /**
+     An event signalled when the download is complete.
+     */
+    HANDLE CompleteEvent;
+} YORIPKG_DOWNLOAD_ITEM, *PYORIPKG_DOWNLOAD_ITEM;
+
+/**
+ A set of packages to download on background threads.  Items are downloaded
+ in the order they are added, so the caller can process each item while
+ later items are still being downloaded.
+ */
+typedef struct _YORIPKG_DOWNLOAD_POOL {
+
+    /**
+     Optionally points to the system INI file, which allows mirrors to be
+     applied to each download.  This is referenced, not owned.
+     */
+    PYORI_STRING IniFilePath;
+
+    /**
+     An array of items to download.
+     */
+    PYORIPKG_DOWNLOAD_ITEM Items;
+
+    /**
+     The number of elements allocated in the Items array.
+     */
+    DWORD ItemsAllocated;
+
+    /**
+     The number of elements in the Items array which have been populated.
+     */
+    DWORD ItemCount;
+
+    /**
+     The index of the next item to be downloaded by a worker thread.  This
+     is incremented atomically by each worker.
+     */
+    DWORD NextItem;
+
+    /**
+     Set to TRUE to indicate worker threads should not begin any more
+     downloads.
+     */
+    BOOL Cancelled;
+
+    /**
+     The number of worker threads which have been created.
+     */
+    DWORD ThreadCount;
+
+    /**
+     Handles to each of the worker threads.
+     */
+    HANDLE Threads[YORIPKG_DOWNLOAD_THREADS];
+
+#if DBG
+    /**
+     The number of milliseconds to wait before each download, used to
+     simulate a slow source when testing.
+     */
+    DWORD DebugDelay;
+#endif
+
+} YORIPKG_DOWNLOAD_POOL, *PYORIPKG_DOWNLOAD_POOL;
 
 /**
  A list of packages awaiting installation.  These have been downloaded and
@@ -167,11 +416,11 @@ typedef struct _YORIPKG_PACKAGES_PENDING_INSTALL {
     YORI_LIST_ENTRY KnownPackages;
 
     /**
-     A hash table containing files that are currently installed by other
-     packages that are not being upgraded or replaced by this installation
-     operation.
+     Optionally points to a pool of packages being downloaded in the
+     background.  If a package being prepared for installation is in this
+     pool, the downloaded copy is used rather than downloading it again.
      */
-    PYORI_HASH_TABLE ExistingFilesTable;
+    PYORIPKG_DOWNLOAD_POOL Downloads;
 
 } YORIPKG_PACKAGES_PENDING_INSTALL, *PYORIPKG_PACKAGES_PENDING_INSTALL;
 
@@ -292,18 +541,6 @@ YoriPkgGetPackageInfo(
     __out PYORI_STRING SymbolPath
     );
 
-__success(return)
-BOOL
-YoriPkgGetInstalledPackageInfo(
-    __in PYORI_STRING IniPath,
-    __in PYORI_STRING PackageName,
-    __out PYORI_STRING PackageVersion,
-    __out PYORI_STRING PackageArch,
-    __out PYORI_STRING UpgradePath,
-    __out PYORI_STRING SourcePath,
-    __out PYORI_STRING SymbolPath
-    );
-
 BOOL
 YoriPkgBuildUpgradeLocationForNewArchitecture(
     __in PYORI_STRING PackageName,
@@ -350,6 +587,134 @@ YoriPkgDisplayErrorStringForInstallFailure(
     __in DWORD ErrorCode
     );
 
+__success(return)
+BOOL
+YoriPkgInitializeDownloadPool(
+    __out PYORIPKG_DOWNLOAD_POOL Pool,
+    __in_opt PYORI_STRING IniFilePath,
+    __in DWORD MaximumItems
+    );
+
+__success(return)
+BOOL
+YoriPkgAddToDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in PYORI_STRING PackagePath
+    );
+
+VOID
+YoriPkgStartDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool
+    );
+
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgWaitForDownload(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in DWORD Index,
+    __out PYORI_STRING LocalPath,
+    __out PBOOL DeleteWhenFinished
+    );
+
+__success(return)
+BOOL
+YoriPkgTakeDownloadedPackage(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool,
+    __in PYORI_STRING PackagePath,
+    __out PDWORD Result,
+    __out PYORI_STRING LocalPath,
+    __out PBOOL DeleteWhenFinished
+    );
+
+VOID
+YoriPkgCleanupDownloadPool(
+    __inout PYORIPKG_DOWNLOAD_POOL Pool
+    );
+
+__success(return)
+BOOL
+YoriPkgGetInstalledDatabaseFile(
+    __in PYORI_STRING PkgIniFile,
+    __out PYORI_STRING DbFile
+    );
+
+PYORIPKG_INSTALLED_PACKAGE
+YoriPkgFindInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING PackageName
+    );
+
+PYORIPKG_INSTALLED_FILE
+YoriPkgFindInstalledFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING RelativeFileName
+    );
+
+PYORIPKG_INSTALLED_PACKAGE
+YoriPkgAddInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORI_STRING PackageName
+    );
+
+__success(return)
+BOOL
+YoriPkgSetInstalledPackageString(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __inout PYORI_STRING Field,
+    __in_opt PYORI_STRING Value
+    );
+
+__success(return)
+BOOL
+YoriPkgAddInstalledPackageFile(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package,
+    __in PYORI_STRING RelativeFileName
+    );
+
+VOID
+YoriPkgRemoveInstalledPackageFiles(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    );
+
+VOID
+YoriPkgRemoveInstalledPackage(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __in PYORIPKG_INSTALLED_PACKAGE Package
+    );
+
+__success(return)
+BOOL
+YoriPkgCaptureInstalledPackages(
+    __in PYORIPKG_INSTALLED_DB Db,
+    __out PDWORD PackageCount,
+    __out PYORIPKG_INSTALLED_PACKAGE **Packages
+    );
+
+VOID
+YoriPkgFreeCapturedPackages(
+    __in DWORD PackageCount,
+    __in_opt PYORIPKG_INSTALLED_PACKAGE *Packages
+    );
+
+BOOL
+YoriPkgFlushInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    );
+
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgOpenInstalledDatabase(
+    __in PYORI_STRING PkgIniFile,
+    __out PYORIPKG_INSTALLED_DB *Db
+    );
+
+BOOL
+YoriPkgCloseInstalledDatabase(
+    __in PYORIPKG_INSTALLED_DB Db
+    );
+
 VOID
 YoriPkgFreeBackupPackage(
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
@@ -421,18 +786,6 @@ YoriPkgPreparePackageForInstallRedirectBuild(
     __in PYORI_STRING PackageUrl
     );
 
-BOOL
-YoriPkgAddExistingFilesToPendingPackages(
-    __in PYORI_STRING PkgIniFile,
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
-    );
-
-BOOL
-YoriPkgCheckIfFileAlreadyExists(
-    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
-    __in PYORI_STRING FileName
-    );
-
 BOOL
 YoriPkgInstallPendingPackages(
     __in PYORI_STRING PkgIniFile,
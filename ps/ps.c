@@ -36,10 +36,14 @@ CHAR strPsHelpText[] =
         "Display process list.\n"
         "\n"
         "PS [-license] [-a] [-f] [-l]\n"
+        "PS [-license] -t [-i <seconds>] [-s cpu|io|mem|pid]\n"
         "\n"
         "   -a             Display all processes\n"
         "   -f             Display full format including command line\n"
-        "   -l             Display long format including memory usage\n";
+        "   -i             Specify the interval between samples in top mode\n"
+        "   -l             Display long format including memory usage\n"
+        "   -s             Specify the column to sort by in top mode\n"
+        "   -t             Continuously display the processes using the most resources\n";
 
 /**
  Display usage text to the user.
@@ -376,22 +380,31 @@ PsDisplayProcessByPid(
 }
 
 /**
- Load information about all processes currently executing in the system.
+ Load information about all processes currently executing in the system into
+ a buffer which may have been allocated by a previous call.  The buffer is
+ only reallocated if it is too small to contain the current process list, so
+ repeated sampling does not need to allocate memory each time.
 
- @param ProcessInfo On successful completion, updated to point to a list of
-        processes executing within the system.
+ @param ProcessInfo On input, points to a buffer from a previous call, or
+        NULL if no buffer has been allocated yet.  On output, updated to
+        point to the buffer containing the process list.  The buffer is owned
+        by the caller regardless of whether this function succeeds.
+
+ @param BytesAllocated On input, the size of any buffer from a previous call.
+        On output, updated to contain the size of the current buffer.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-PsGetSystemProcessList(
-    __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
+PsQuerySystemProcessList(
+    __inout PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo,
+    __inout PDWORD BytesAllocated
     )
 {
-    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo = NULL;
+    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo;
+    DWORD LocalBytesAllocated;
     DWORD BytesReturned;
-    DWORD BytesAllocated;
     LONG Status;
 
     if (DllNtDll.pNtQuerySystemInformation == NULL) {
@@ -400,38 +413,75 @@ PsGetSystemProcessList(
         return FALSE;
     }
 
-    BytesAllocated = 0;
+    LocalProcessInfo = *ProcessInfo;
+    LocalBytesAllocated = *BytesAllocated;
+    if (LocalProcessInfo == NULL) {
+        LocalBytesAllocated = 0;
+    }
 
-    do {
+    while (TRUE) {
 
         if (LocalProcessInfo != NULL) {
+            Status = DllNtDll.pNtQuerySystemInformation(SystemProcessInformation, LocalProcessInfo, LocalBytesAllocated, &BytesReturned);
+            if (Status != (LONG)0xc0000004) {
+                break;
+            }
+
             YoriLibFree(LocalProcessInfo);
+            LocalProcessInfo = NULL;
+            *ProcessInfo = NULL;
+            *BytesAllocated = 0;
         }
 
-        if (BytesAllocated == 0) {
-            BytesAllocated = 64 * 1024;
-        } else if (BytesAllocated <= 1024 * 1024) {
-            BytesAllocated = BytesAllocated * 4;
+        if (LocalBytesAllocated == 0) {
+            LocalBytesAllocated = 64 * 1024;
+        } else if (LocalBytesAllocated <= 1024 * 1024) {
+            LocalBytesAllocated = LocalBytesAllocated * 4;
         } else {
             return FALSE;
         }
 
-        LocalProcessInfo = YoriLibMalloc(BytesAllocated);
+        LocalProcessInfo = YoriLibMalloc(LocalBytesAllocated);
         if (LocalProcessInfo == NULL) {
             return FALSE;
         }
 
-        Status = DllNtDll.pNtQuerySystemInformation(SystemProcessInformation, LocalProcessInfo, BytesAllocated, &BytesReturned);
-    } while (Status == (LONG)0xc0000004);
-
+        *ProcessInfo = LocalProcessInfo;
+        *BytesAllocated = LocalBytesAllocated;
+    }
 
     if (Status != 0) {
-        YoriLibFree(LocalProcessInfo);
         return FALSE;
     }
 
     if (BytesReturned == 0) {
-        YoriLibFree(LocalProcessInfo);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load information about all processes currently executing in the system.
+
+ @param ProcessInfo On successful completion, updated to point to a list of
+        processes executing within the system.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsGetSystemProcessList(
+    __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo = NULL;
+    DWORD BytesAllocated = 0;
+
+    if (!PsQuerySystemProcessList(&LocalProcessInfo, &BytesAllocated)) {
+        if (LocalProcessInfo != NULL) {
+            YoriLibFree(LocalProcessInfo);
+        }
         return FALSE;
     }
 
@@ -539,6 +589,1003 @@ PsDisplayConsoleProcesses(
     return TRUE;
 }
 
+/**
+ Sort processes in top mode by process identifier.
+ */
+#define PS_TOP_SORT_PID      (0)
+
+/**
+ Sort processes in top mode by processor usage since the previous sample.
+ */
+#define PS_TOP_SORT_CPU      (1)
+
+/**
+ Sort processes in top mode by I/O rate since the previous sample.
+ */
+#define PS_TOP_SORT_IO       (2)
+
+/**
+ Sort processes in top mode by working set size.
+ */
+#define PS_TOP_SORT_MEMORY   (3)
+
+/**
+ The minimum number of characters in the buffer used to construct a line of
+ the top mode display.  This is large enough for the header lines and the
+ fixed columns of a process line, so that these can be formatted in full
+ and clipped to the display width when written.
+ */
+#define PS_TOP_MIN_LINE_BUFFER (128)
+
+/**
+ Information about a single process captured in a top mode sample, along
+ with the changes observed since the previous sample.
+ */
+typedef struct _PS_TOP_ENTRY {
+
+    /**
+     The process identifier.
+     */
+    DWORD_PTR ProcessId;
+
+    /**
+     The time the process was created.  Process identifiers are reused, so
+     a process is only considered to be the same as one in the previous
+     sample if both its identifier and creation time match.
+     */
+    LARGE_INTEGER CreateTime;
+
+    /**
+     The total amount of kernel and user time consumed by the process.
+     */
+    LONGLONG ExecuteTime;
+
+    /**
+     The total number of bytes transferred by I/O issued by the process.
+     */
+    LONGLONG IoTransferBytes;
+
+    /**
+     The number of bytes in the working set of the process.
+     */
+    LONGLONG WorkingSetSize;
+
+    /**
+     The amount of kernel and user time consumed since the previous sample.
+     */
+    LONGLONG ExecuteTimeDelta;
+
+    /**
+     The number of bytes per second transferred since the previous sample.
+     */
+    LONGLONG IoBytesPerSecond;
+
+    /**
+     The change in working set size since the previous sample.
+     */
+    LONGLONG WorkingSetDelta;
+
+    /**
+     Pointer to the information returned by the system for this process.
+     This is only valid while this entry is part of the current sample, since
+     the buffer is reused for the next sample.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+} PS_TOP_ENTRY, *PPS_TOP_ENTRY;
+
+/**
+ The set of processes captured at a single point in time.
+ */
+typedef struct _PS_TOP_SAMPLE {
+
+    /**
+     Array of entries, one per process.
+     */
+    PPS_TOP_ENTRY Entries;
+
+    /**
+     Array of pointers to entries sorted by process identifier, used to
+     locate a process when the next sample is taken.
+     */
+    PPS_TOP_ENTRY *EntriesByPid;
+
+    /**
+     Array of pointers to entries sorted into display order.
+     */
+    PPS_TOP_ENTRY *EntriesByDisplay;
+
+    /**
+     The number of valid entries in the arrays.
+     */
+    DWORD EntryCount;
+
+    /**
+     The number of entries that the arrays have space for.
+     */
+    DWORD EntriesAllocated;
+
+    /**
+     The system time when the sample was taken.
+     */
+    LARGE_INTEGER SampleTime;
+
+    /**
+     The amount of time that elapsed between the previous sample and this
+     one, or zero if there is no previous sample.
+     */
+    LONGLONG Elapsed;
+
+} PS_TOP_SAMPLE, *PPS_TOP_SAMPLE;
+
+/**
+ Context about a continuously updating display of process activity.
+ */
+typedef struct _PS_TOP_CONTEXT {
+
+    /**
+     Buffer containing the most recent process list returned from the
+     system.  This is reused for each sample and only grows if the system
+     has more processes than it can describe.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+    /**
+     The size of the ProcessInfo buffer, in bytes.
+     */
+    DWORD ProcessInfoSize;
+
+    /**
+     The current sample and the previous sample.  These alternate as new
+     samples are taken so that their allocations can be reused.
+     */
+    PS_TOP_SAMPLE Samples[2];
+
+    /**
+     The index of the current sample within the Samples array.
+     */
+    DWORD CurrentSample;
+
+    /**
+     The number of samples that have been taken.
+     */
+    DWORD SampleCount;
+
+    /**
+     The column to sort by, one of the PS_TOP_SORT values.
+     */
+    DWORD SortColumn;
+
+    /**
+     The number of processors in the system.
+     */
+    DWORD NumberOfProcessors;
+
+    /**
+     TRUE if the system returns I/O counters for each process.
+     */
+    BOOL IoCountersPresent;
+
+    /**
+     Handle to the console that the display is written to.
+     */
+    HANDLE hConsole;
+
+    /**
+     The console cell where the display begins.
+     */
+    COORD DisplayOrigin;
+
+    /**
+     The number of characters in each line of the display.
+     */
+    WORD DisplayWidth;
+
+    /**
+     The number of lines in the display.
+     */
+    WORD DisplayHeight;
+
+    /**
+     The text currently displayed on each line, with DisplayWidth characters
+     per line.  This is used to only update lines whose contents changed.
+     */
+    LPTSTR DisplayedLines;
+
+    /**
+     A buffer used to construct a single line of the display.  Lines longer
+     than DisplayWidth are clipped when they are displayed.
+     */
+    LPTSTR LineBuffer;
+
+    /**
+     The number of characters in LineBuffer, including space for a NULL
+     terminator.  This is at least DisplayWidth plus one.
+     */
+    DWORD LineBufferLength;
+
+} PS_TOP_CONTEXT, *PPS_TOP_CONTEXT;
+
+/**
+ Compare two top mode entries to determine their display order.
+
+ @param Left Pointer to the first entry to compare.
+
+ @param Right Pointer to the second entry to compare.
+
+ @param SortColumn The column to sort by, one of the PS_TOP_SORT values.
+
+ @return Less than zero if Left should be displayed before Right, greater
+         than zero if Right should be displayed before Left, or zero if the
+         entries are equal.
+ */
+int
+PsTopCompareEntries(
+    __in PPS_TOP_ENTRY Left,
+    __in PPS_TOP_ENTRY Right,
+    __in DWORD SortColumn
+    )
+{
+    LONGLONG LeftValue;
+    LONGLONG RightValue;
+
+    switch(SortColumn) {
+        case PS_TOP_SORT_CPU:
+            LeftValue = Left->ExecuteTimeDelta;
+            RightValue = Right->ExecuteTimeDelta;
+            break;
+        case PS_TOP_SORT_IO:
+            LeftValue = Left->IoBytesPerSecond;
+            RightValue = Right->IoBytesPerSecond;
+            break;
+        case PS_TOP_SORT_MEMORY:
+            LeftValue = Left->WorkingSetSize;
+            RightValue = Right->WorkingSetSize;
+            break;
+        default:
+            LeftValue = 0;
+            RightValue = 0;
+            break;
+    }
+
+    //
+    //  Resource columns display the largest consumers first.  Processes
+    //  which are equal are displayed in process identifier order so the
+    //  display is stable between samples.
+    //
+
+    if (LeftValue > RightValue) {
+        return -1;
+    } else if (LeftValue < RightValue) {
+        return 1;
+    }
+
+    if (Left->ProcessId < Right->ProcessId) {
+        return -1;
+    } else if (Left->ProcessId > Right->ProcessId) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ Sort an array of pointers to top mode entries using heapsort, which needs
+ no extra memory and no recursion.
+
+ @param Entries Pointer to the array of entries to sort.
+
+ @param Count The number of entries in the array.
+
+ @param SortColumn The column to sort by, one of the PS_TOP_SORT values.
+ */
+VOID
+PsTopSortEntries(
+    __inout_ecount(Count) PPS_TOP_ENTRY *Entries,
+    __in DWORD Count,
+    __in DWORD SortColumn
+    )
+{
+    PPS_TOP_ENTRY Swap;
+    DWORD Start;
+    DWORD End;
+    DWORD Root;
+    DWORD Child;
+
+    if (Count < 2) {
+        return;
+    }
+
+    Start = Count / 2;
+    End = Count;
+
+    while (End > 1) {
+
+        //
+        //  First build a heap by sifting down every parent node.  Once the
+        //  heap is built, repeatedly move the entry that sorts last to the
+        //  end of the array and restore the heap over the remaining entries.
+        //
+
+        if (Start > 0) {
+            Start--;
+        } else {
+            End--;
+            Swap = Entries[End];
+            Entries[End] = Entries[0];
+            Entries[0] = Swap;
+        }
+
+        Root = Start;
+        while (Root * 2 + 1 < End) {
+            Child = Root * 2 + 1;
+            if (Child + 1 < End &&
+                PsTopCompareEntries(Entries[Child], Entries[Child + 1], SortColumn) < 0) {
+
+                Child++;
+            }
+
+            if (PsTopCompareEntries(Entries[Root], Entries[Child], SortColumn) >= 0) {
+                break;
+            }
+
+            Swap = Entries[Root];
+            Entries[Root] = Entries[Child];
+            Entries[Child] = Swap;
+            Root = Child;
+        }
+    }
+}
+
+/**
+ Find a process within a sample given its process identifier.
+
+ @param Sample Pointer to the sample to search.
+
+ @param ProcessId The process identifier to find.
+
+ @return Pointer to the entry for the process, or NULL if the process was
+         not present in the sample.
+ */
+PPS_TOP_ENTRY
+PsTopFindEntryByPid(
+    __in PPS_TOP_SAMPLE Sample,
+    __in DWORD_PTR ProcessId
+    )
+{
+    PPS_TOP_ENTRY Entry;
+    DWORD Low;
+    DWORD High;
+    DWORD Middle;
+
+    Low = 0;
+    High = Sample->EntryCount;
+
+    while (Low < High) {
+        Middle = Low + (High - Low) / 2;
+        Entry = Sample->EntriesByPid[Middle];
+        if (Entry->ProcessId == ProcessId) {
+            return Entry;
+        } else if (Entry->ProcessId < ProcessId) {
+            Low = Middle + 1;
+        } else {
+            High = Middle;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Ensure a sample has space to describe a specified number of processes.
+
+ @param Sample Pointer to the sample to reallocate if needed.
+
+ @param Count The number of processes that the sample must be able to
+        describe.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsTopAllocateSample(
+    __inout PPS_TOP_SAMPLE Sample,
+    __in DWORD Count
+    )
+{
+    PPS_TOP_ENTRY NewEntries;
+
+    if (Count <= Sample->EntriesAllocated) {
+        return TRUE;
+    }
+
+    //
+    //  Leave some room for new processes so the allocation is not repeated
+    //  each time a process is launched.
+    //
+
+    Count = Count + 64;
+
+    NewEntries = YoriLibMalloc(Count * (sizeof(PS_TOP_ENTRY) + 2 * sizeof(PPS_TOP_ENTRY)));
+    if (NewEntries == NULL) {
+        return FALSE;
+    }
+
+    if (Sample->Entries != NULL) {
+        YoriLibFree(Sample->Entries);
+    }
+
+    Sample->Entries = NewEntries;
+    Sample->EntriesByPid = (PPS_TOP_ENTRY *)(NewEntries + Count);
+    Sample->EntriesByDisplay = Sample->EntriesByPid + Count;
+    Sample->EntriesAllocated = Count;
+    Sample->EntryCount = 0;
+    return TRUE;
+}
+
+/**
+ Capture the current state of processes in the system, and calculate the
+ changes in each process since the previous sample.
+
+ @param TopContext Pointer to the top mode context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsTopCollectSample(
+    __inout PPS_TOP_CONTEXT TopContext
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION CurrentEntry;
+    PPS_TOP_SAMPLE Sample;
+    PPS_TOP_SAMPLE PreviousSample;
+    PPS_TOP_ENTRY Entry;
+    PPS_TOP_ENTRY PreviousEntry;
+    FILETIME SystemTime;
+    LONGLONG IoDelta;
+    DWORD ProcessCount;
+    DWORD Index;
+
+    if (!PsQuerySystemProcessList(&TopContext->ProcessInfo, &TopContext->ProcessInfoSize)) {
+        return FALSE;
+    }
+
+    GetSystemTimeAsFileTime(&SystemTime);
+
+    PreviousSample = NULL;
+    if (TopContext->SampleCount > 0) {
+        PreviousSample = &TopContext->Samples[TopContext->CurrentSample];
+        TopContext->CurrentSample = (TopContext->CurrentSample + 1) % 2;
+    }
+    Sample = &TopContext->Samples[TopContext->CurrentSample];
+
+    ProcessCount = 0;
+    CurrentEntry = TopContext->ProcessInfo;
+    while (TRUE) {
+        ProcessCount++;
+        if (CurrentEntry->NextEntryOffset == 0) {
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    }
+
+    if (!PsTopAllocateSample(Sample, ProcessCount)) {
+        return FALSE;
+    }
+
+    Sample->SampleTime.LowPart = SystemTime.dwLowDateTime;
+    Sample->SampleTime.HighPart = SystemTime.dwHighDateTime;
+    Sample->Elapsed = 0;
+    if (PreviousSample != NULL) {
+        Sample->Elapsed = Sample->SampleTime.QuadPart - PreviousSample->SampleTime.QuadPart;
+    }
+
+    CurrentEntry = TopContext->ProcessInfo;
+    for (Index = 0; Index < ProcessCount; Index++) {
+        Entry = &Sample->Entries[Index];
+        Entry->ProcessInfo = CurrentEntry;
+        Entry->ProcessId = CurrentEntry->ProcessId;
+        Entry->CreateTime.QuadPart = CurrentEntry->CreateTime.QuadPart;
+        Entry->ExecuteTime = CurrentEntry->KernelTime.QuadPart + CurrentEntry->UserTime.QuadPart;
+        Entry->WorkingSetSize = CurrentEntry->WorkingSetSize;
+        Entry->IoTransferBytes = 0;
+        if (TopContext->IoCountersPresent) {
+            Entry->IoTransferBytes = CurrentEntry->ReadTransferCount.QuadPart +
+                                     CurrentEntry->WriteTransferCount.QuadPart +
+                                     CurrentEntry->OtherTransferCount.QuadPart;
+        }
+        Sample->EntriesByPid[Index] = Entry;
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    }
+
+    Sample->EntryCount = ProcessCount;
+    PsTopSortEntries(Sample->EntriesByPid, ProcessCount, PS_TOP_SORT_PID);
+
+    for (Index = 0; Index < ProcessCount; Index++) {
+        Entry = Sample->EntriesByPid[Index];
+        Sample->EntriesByDisplay[Index] = Entry;
+
+        PreviousEntry = NULL;
+        if (PreviousSample != NULL) {
+            PreviousEntry = PsTopFindEntryByPid(PreviousSample, Entry->ProcessId);
+        }
+
+        //
+        //  If the process existed in the previous sample, report the
+        //  difference.  If it was launched since the previous sample,
+        //  everything it has done happened within this interval.  On the
+        //  first sample there is nothing to compare against.
+        //
+
+        if (PreviousEntry != NULL &&
+            PreviousEntry->CreateTime.QuadPart == Entry->CreateTime.QuadPart) {
+
+            Entry->ExecuteTimeDelta = Entry->ExecuteTime - PreviousEntry->ExecuteTime;
+            IoDelta = Entry->IoTransferBytes - PreviousEntry->IoTransferBytes;
+            Entry->WorkingSetDelta = Entry->WorkingSetSize - PreviousEntry->WorkingSetSize;
+        } else if (PreviousSample != NULL &&
+                   Entry->CreateTime.QuadPart > PreviousSample->SampleTime.QuadPart) {
+
+            Entry->ExecuteTimeDelta = Entry->ExecuteTime;
+            IoDelta = Entry->IoTransferBytes;
+            Entry->WorkingSetDelta = Entry->WorkingSetSize;
+        } else {
+            Entry->ExecuteTimeDelta = 0;
+            IoDelta = 0;
+            Entry->WorkingSetDelta = 0;
+        }
+
+        Entry->IoBytesPerSecond = 0;
+        if (Sample->Elapsed > 0) {
+            Entry->IoBytesPerSecond = IoDelta * (10 * 1000 * 1000) / Sample->Elapsed;
+        }
+    }
+
+    PsTopSortEntries(Sample->EntriesByDisplay, ProcessCount, TopContext->SortColumn);
+    TopContext->SampleCount++;
+    return TRUE;
+}
+
+/**
+ Convert an amount of processor time consumed within a sample into tenths
+ of a percent of the total processor time available in the interval.
+
+ @param TopContext Pointer to the top mode context.
+
+ @param Sample Pointer to the sample.
+
+ @param ExecuteTime The amount of processor time consumed.
+
+ @return The processor usage, in tenths of a percent.
+ */
+DWORD
+PsTopProcessorUsage(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in PPS_TOP_SAMPLE Sample,
+    __in LONGLONG ExecuteTime
+    )
+{
+    LONGLONG Available;
+    LONGLONG Usage;
+
+    Available = Sample->Elapsed * TopContext->NumberOfProcessors;
+    if (Available <= 0 || ExecuteTime <= 0) {
+        return 0;
+    }
+
+    Usage = ExecuteTime * 1000 / Available;
+    if (Usage > 1000) {
+        Usage = 1000;
+    }
+
+    return (DWORD)Usage;
+}
+
+/**
+ Display the line which has been constructed in the line buffer at the
+ specified line of the display, if it differs from the text already there.
+
+ @param TopContext Pointer to the top mode context.
+
+ @param LineIndex The line within the display to update.
+
+ @param CharsPopulated The number of characters in the line buffer.  The
+        remainder of the line is filled with spaces, and any characters
+        beyond the display width are not displayed.
+ */
+VOID
+PsTopUpdateLine(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in WORD LineIndex,
+    __in int CharsPopulated
+    )
+{
+    LPTSTR DisplayedLine;
+    COORD WritePosition;
+    DWORD CharsWritten;
+    DWORD Index;
+
+    Index = 0;
+    if (CharsPopulated > 0) {
+        Index = (DWORD)CharsPopulated;
+    }
+
+    for (; Index < TopContext->DisplayWidth; Index++) {
+        TopContext->LineBuffer[Index] = ' ';
+    }
+
+    DisplayedLine = TopContext->DisplayedLines + LineIndex * TopContext->DisplayWidth;
+    if (memcmp(DisplayedLine, TopContext->LineBuffer, TopContext->DisplayWidth * sizeof(TCHAR)) == 0) {
+        return;
+    }
+
+    WritePosition.X = TopContext->DisplayOrigin.X;
+    WritePosition.Y = (SHORT)(TopContext->DisplayOrigin.Y + LineIndex);
+    WriteConsoleOutputCharacter(TopContext->hConsole, TopContext->LineBuffer, TopContext->DisplayWidth, WritePosition, &CharsWritten);
+    memcpy(DisplayedLine, TopContext->LineBuffer, TopContext->DisplayWidth * sizeof(TCHAR));
+}
+
+/**
+ Construct the line of the display describing a single process.  The image
+ name is the final column, and is truncated to the space remaining in the
+ display.
+
+ @param TopContext Pointer to the top mode context.
+
+ @param Sample Pointer to the current sample.
+
+ @param Entry Pointer to the process to describe.
+
+ @return The number of characters populated into the line buffer.
+ */
+int
+PsTopFormatEntry(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in PPS_TOP_SAMPLE Sample,
+    __in PPS_TOP_ENTRY Entry
+    )
+{
+    YORI_STRING BaseName;
+    YORI_STRING IoString;
+    YORI_STRING WorkingSetString;
+    YORI_STRING DeltaString;
+    TCHAR IoStringBuffer[6];
+    TCHAR WorkingSetStringBuffer[6];
+    TCHAR DeltaStringBuffer[6];
+    LARGE_INTEGER Value;
+    DWORD Usage;
+    TCHAR DeltaSign;
+    int CharsPopulated;
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = Entry->ProcessInfo->ImageName;
+    BaseName.LengthInChars = Entry->ProcessInfo->ImageNameLengthInBytes / sizeof(WCHAR);
+
+    if (BaseName.LengthInChars == 0 && Entry->ProcessId == 0) {
+        YoriLibConstantString(&BaseName, _T("Idle"));
+    }
+
+    YoriLibInitEmptyString(&IoString);
+    IoString.StartOfString = IoStringBuffer;
+    IoString.LengthAllocated = sizeof(IoStringBuffer)/sizeof(IoStringBuffer[0]);
+
+    YoriLibInitEmptyString(&WorkingSetString);
+    WorkingSetString.StartOfString = WorkingSetStringBuffer;
+    WorkingSetString.LengthAllocated = sizeof(WorkingSetStringBuffer)/sizeof(WorkingSetStringBuffer[0]);
+
+    YoriLibInitEmptyString(&DeltaString);
+    DeltaString.StartOfString = DeltaStringBuffer;
+    DeltaString.LengthAllocated = sizeof(DeltaStringBuffer)/sizeof(DeltaStringBuffer[0]);
+
+    if (TopContext->IoCountersPresent) {
+        Value.QuadPart = Entry->IoBytesPerSecond;
+        YoriLibFileSizeToString(&IoString, &Value);
+    } else {
+        YoriLibConstantString(&IoString, _T("-"));
+    }
+
+    Value.QuadPart = Entry->WorkingSetSize;
+    YoriLibFileSizeToString(&WorkingSetString, &Value);
+
+    if (Entry->WorkingSetDelta > 0) {
+        DeltaSign = '+';
+        Value.QuadPart = Entry->WorkingSetDelta;
+    } else if (Entry->WorkingSetDelta < 0) {
+        DeltaSign = '-';
+        Value.QuadPart = -Entry->WorkingSetDelta;
+    } else {
+        DeltaSign = ' ';
+        Value.QuadPart = 0;
+    }
+    YoriLibFileSizeToString(&DeltaString, &Value);
+
+    Usage = PsTopProcessorUsage(TopContext, Sample, Entry->ExecuteTimeDelta);
+
+    CharsPopulated = YoriLibSPrintfS(TopContext->LineBuffer,
+                                     TopContext->LineBufferLength,
+                                     _T("%-6i | %4i.%i | %-10y | %-10y | %c%-9y | "),
+                                     (DWORD)Entry->ProcessId,
+                                     Usage / 10,
+                                     Usage % 10,
+                                     &IoString,
+                                     &WorkingSetString,
+                                     DeltaSign,
+                                     &DeltaString);
+
+    if (CharsPopulated < 0) {
+        return 0;
+    }
+
+    if ((DWORD)CharsPopulated < TopContext->DisplayWidth) {
+        if (BaseName.LengthInChars > TopContext->DisplayWidth - (DWORD)CharsPopulated) {
+            BaseName.LengthInChars = TopContext->DisplayWidth - (DWORD)CharsPopulated;
+        }
+        memcpy(&TopContext->LineBuffer[CharsPopulated], BaseName.StartOfString, BaseName.LengthInChars * sizeof(TCHAR));
+        CharsPopulated = CharsPopulated + (int)BaseName.LengthInChars;
+    }
+
+    return CharsPopulated;
+}
+
+/**
+ Update the display to reflect the current sample.  Only lines whose text
+ has changed since the previous update are written to the console.
+
+ @param TopContext Pointer to the top mode context.
+ */
+VOID
+PsTopDisplaySample(
+    __in PPS_TOP_CONTEXT TopContext
+    )
+{
+    PPS_TOP_SAMPLE Sample;
+    LONGLONG BusyTime;
+    LPCTSTR SortName;
+    DWORD Usage;
+    DWORD Index;
+    WORD LineIndex;
+    int CharsPopulated;
+
+    Sample = &TopContext->Samples[TopContext->CurrentSample];
+
+    BusyTime = 0;
+    for (Index = 0; Index < Sample->EntryCount; Index++) {
+        if (Sample->Entries[Index].ProcessId != 0) {
+            BusyTime = BusyTime + Sample->Entries[Index].ExecuteTimeDelta;
+        }
+    }
+    Usage = PsTopProcessorUsage(TopContext, Sample, BusyTime);
+
+    switch(TopContext->SortColumn) {
+        case PS_TOP_SORT_CPU:
+            SortName = _T("processor usage");
+            break;
+        case PS_TOP_SORT_IO:
+            SortName = _T("I/O rate");
+            break;
+        case PS_TOP_SORT_MEMORY:
+            SortName = _T("working set");
+            break;
+        default:
+            SortName = _T("process id");
+            break;
+    }
+
+    CharsPopulated = YoriLibSPrintfS(TopContext->LineBuffer,
+                                     TopContext->LineBufferLength,
+                                     _T("%i processes, %i.%i%% processor busy, sorted by %s"),
+                                     Sample->EntryCount,
+                                     Usage / 10,
+                                     Usage % 10,
+                                     SortName);
+    PsTopUpdateLine(TopContext, 0, CharsPopulated);
+
+    CharsPopulated = YoriLibSPrintfS(TopContext->LineBuffer,
+                                     TopContext->LineBufferLength,
+                                     _T("  Pid  |  Cpu%%  | I/O/sec    | WorkingSet | WS Change  | Process"));
+    PsTopUpdateLine(TopContext, 1, CharsPopulated);
+
+    for (LineIndex = 2; LineIndex < TopContext->DisplayHeight; LineIndex++) {
+        Index = LineIndex - 2;
+        CharsPopulated = 0;
+        if (Index < Sample->EntryCount) {
+            CharsPopulated = PsTopFormatEntry(TopContext, Sample, Sample->EntriesByDisplay[Index]);
+        }
+        PsTopUpdateLine(TopContext, LineIndex, CharsPopulated);
+    }
+}
+
+/**
+ Reserve an area of the console for the top mode display, and allocate the
+ buffers used to track its contents.
+
+ @param TopContext Pointer to the top mode context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsTopInitializeDisplay(
+    __inout PPS_TOP_CONTEXT TopContext
+    )
+{
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    DWORD LineCount;
+    DWORD Index;
+
+    TopContext->hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (!GetConsoleScreenBufferInfo(TopContext->hConsole, &ScreenInfo)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ps: top mode requires output to a console\n"));
+        return FALSE;
+    }
+
+    //
+    //  Use the visible window, leaving the final line for the cursor.
+    //
+
+    LineCount = ScreenInfo.srWindow.Bottom - ScreenInfo.srWindow.Top + 1;
+    if (LineCount < 4) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ps: console window is too small\n"));
+        return FALSE;
+    }
+
+    TopContext->DisplayWidth = (WORD)(ScreenInfo.srWindow.Right - ScreenInfo.srWindow.Left + 1);
+    TopContext->DisplayHeight = (WORD)(LineCount - 1);
+
+    TopContext->LineBufferLength = TopContext->DisplayWidth + 1;
+    if (TopContext->LineBufferLength < PS_TOP_MIN_LINE_BUFFER) {
+        TopContext->LineBufferLength = PS_TOP_MIN_LINE_BUFFER;
+    }
+
+    TopContext->DisplayedLines = YoriLibMalloc((TopContext->DisplayHeight * TopContext->DisplayWidth + TopContext->LineBufferLength) * sizeof(TCHAR));
+    if (TopContext->DisplayedLines == NULL) {
+        return FALSE;
+    }
+    TopContext->LineBuffer = TopContext->DisplayedLines + TopContext->DisplayHeight * TopContext->DisplayWidth;
+
+    //
+    //  Nothing has been displayed yet, so fill the displayed text with a
+    //  character that will never be generated, forcing every line to be
+    //  written on the first update.
+    //
+
+    for (Index = 0; Index < (DWORD)TopContext->DisplayHeight * TopContext->DisplayWidth; Index++) {
+        TopContext->DisplayedLines[Index] = '\0';
+    }
+
+    //
+    //  Move the cursor down to reserve the lines for the display, scrolling
+    //  the buffer if necessary, and position the display in the lines that
+    //  were skipped.
+    //
+
+    for (Index = 0; Index < TopContext->DisplayHeight; Index++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+
+    if (!GetConsoleScreenBufferInfo(TopContext->hConsole, &ScreenInfo)) {
+        return FALSE;
+    }
+
+    TopContext->DisplayOrigin.X = ScreenInfo.srWindow.Left;
+    TopContext->DisplayOrigin.Y = (SHORT)(ScreenInfo.dwCursorPosition.Y - TopContext->DisplayHeight);
+    if (TopContext->DisplayOrigin.Y < 0) {
+        TopContext->DisplayOrigin.Y = 0;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free all resources associated with top mode and leave the cursor below the
+ display.
+
+ @param TopContext Pointer to the top mode context.
+ */
+VOID
+PsTopCleanup(
+    __in PPS_TOP_CONTEXT TopContext
+    )
+{
+    COORD CursorPosition;
+    DWORD Index;
+
+    if (TopContext->DisplayedLines != NULL) {
+        CursorPosition.X = 0;
+        CursorPosition.Y = (SHORT)(TopContext->DisplayOrigin.Y + TopContext->DisplayHeight);
+        SetConsoleCursorPosition(TopContext->hConsole, CursorPosition);
+        YoriLibFree(TopContext->DisplayedLines);
+        TopContext->DisplayedLines = NULL;
+        TopContext->LineBuffer = NULL;
+    }
+
+    for (Index = 0; Index < sizeof(TopContext->Samples)/sizeof(TopContext->Samples[0]); Index++) {
+        if (TopContext->Samples[Index].Entries != NULL) {
+            YoriLibFree(TopContext->Samples[Index].Entries);
+            TopContext->Samples[Index].Entries = NULL;
+        }
+    }
+
+    if (TopContext->ProcessInfo != NULL) {
+        YoriLibFree(TopContext->ProcessInfo);
+        TopContext->ProcessInfo = NULL;
+    }
+}
+
+/**
+ Continuously display the processes in the system, updating the display at
+ a fixed interval until the user cancels the operation.
+
+ @param SortColumn The column to sort by, one of the PS_TOP_SORT values.
+
+ @param Interval The time to wait between samples, in milliseconds.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsDisplayTop(
+    __in DWORD SortColumn,
+    __in DWORD Interval
+    )
+{
+    PS_TOP_CONTEXT TopContext;
+    SYSTEM_INFO SystemInfo;
+    HANDLE CancelHandle;
+    DWORD MajorVersion;
+    DWORD MinorVersion;
+    DWORD BuildNumber;
+    BOOL Result;
+
+    ZeroMemory(&TopContext, sizeof(TopContext));
+    TopContext.SortColumn = SortColumn;
+
+    GetSystemInfo(&SystemInfo);
+    TopContext.NumberOfProcessors = SystemInfo.dwNumberOfProcessors;
+    if (TopContext.NumberOfProcessors == 0) {
+        TopContext.NumberOfProcessors = 1;
+    }
+
+    //
+    //  Per process I/O counters were added in Windows 2000.  Older systems
+    //  return a shorter structure, so these fields cannot be used.
+    //
+
+    YoriLibGetOsVersion(&MajorVersion, &MinorVersion, &BuildNumber);
+    if (MajorVersion >= 5) {
+        TopContext.IoCountersPresent = TRUE;
+    }
+
+    if (!PsTopInitializeDisplay(&TopContext)) {
+        PsTopCleanup(&TopContext);
+        return FALSE;
+    }
+
+    CancelHandle = YoriLibCancelGetEvent();
+    Result = FALSE;
+
+    while (TRUE) {
+        if (!PsTopCollectSample(&TopContext)) {
+            break;
+        }
+
+        PsTopDisplaySample(&TopContext);
+
+        if (CancelHandle != NULL) {
+            if (WaitForSingleObject(CancelHandle, Interval) == WAIT_OBJECT_0) {
+                Result = TRUE;
+                break;
+            }
+        } else {
+            Sleep(Interval);
+        }
+    }
+
+    PsTopCleanup(&TopContext);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the ps builtin command.
@@ -572,10 +1619,18 @@ ENTRYPOINT(
     DWORD StartArg = 0;
     YORI_STRING Arg;
     BOOL DisplayAll;
+    BOOL TopMode;
+    DWORD SortColumn;
+    DWORD Interval;
+    LONGLONG llTemp;
+    DWORD CharsConsumed;
     PS_CONTEXT PsContext;
 
     ZeroMemory(&PsContext, sizeof(PsContext));
     DisplayAll = FALSE;
+    TopMode = FALSE;
+    SortColumn = PS_TOP_SORT_CPU;
+    Interval = 1000;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -596,9 +1651,43 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("f")) == 0) {
                 PsContext.DisplayCommandLine = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("i")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0 &&
+                        llTemp <= 24 * 60 * 60) {
+
+                        Interval = (DWORD)llTemp * 1000;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("l")) == 0) {
                 PsContext.DisplayMemory = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("cpu")) == 0) {
+                        SortColumn = PS_TOP_SORT_CPU;
+                        ArgumentUnderstood = TRUE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("io")) == 0) {
+                        SortColumn = PS_TOP_SORT_IO;
+                        ArgumentUnderstood = TRUE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("mem")) == 0) {
+                        SortColumn = PS_TOP_SORT_MEMORY;
+                        ArgumentUnderstood = TRUE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("pid")) == 0) {
+                        SortColumn = PS_TOP_SORT_PID;
+                        ArgumentUnderstood = TRUE;
+                    }
+                    if (ArgumentUnderstood) {
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("t")) == 0) {
+                TopMode = TRUE;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -611,7 +1700,14 @@ ENTRYPOINT(
         }
     }
 
-    if (DisplayAll) {
+    if (TopMode) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable();
+#endif
+        if (!PsDisplayTop(SortColumn, Interval)) {
+            return EXIT_FAILURE;
+        }
+    } else if (DisplayAll) {
         PsDisplayAllProcesses(&PsContext);
     } else {
         PsDisplayConsoleProcesses(&PsContext);
@@ -0,0 +1,1272 @@
+/**
+ * @file search/search.c
+ *
+ * Yori shell search for strings within files
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strSearchHelpText[] =
+        "\n"
+        "Search for strings within one or more files.\n"
+        "\n"
+        "SEARCH [-license] [-b] [-f <criteria>] [-i] [-l] [-r] [-s]\n"
+        "       [-e <string>]... [<string>] [<file>...]\n"
+        "\n"
+        "   -b             Use basic search criteria for files only\n"
+        "   -e <string>    Search for <string>, can be specified multiple times\n"
+        "   -f <criteria>  Only search files if they meet criteria, see below\n"
+        "   -i             Match strings without regard to case\n"
+        "   -l             Display the names of matching files only\n"
+        "   -r             Treat search strings as regular expressions\n"
+        "   -s             Process files from all subdirectories\n"
+        "\n"
+        " Matching lines are displayed as file:line:text, in the order files are\n"
+        " found.  If no -e option is specified, the first argument is the string\n"
+        " to search for.\n"
+        "\n"
+        " The -f option will search files only if they meet criteria.  This is a\n"
+        " semicolon delimited list of entries matching the following form:\n"
+        "\n"
+        "   [file attribute][operator][criteria]\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+SearchHelp()
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Search %i.%02i\n"), SEARCH_VER_MAJOR, SEARCH_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strSearchHelpText);
+    YoriLibFileFiltHelp();
+    return TRUE;
+}
+
+/**
+ The number of characters to allocate for a file's results when the first
+ match is found.
+ */
+#define SEARCH_INITIAL_RESULT_SIZE (4096)
+
+/**
+ A single file whose contents are being searched.
+ */
+typedef struct _SEARCH_FILE {
+
+    /**
+     The state used to queue the file to the pool of searching threads.
+     */
+    YORI_LIB_FILE_POOL_ITEM PoolItem;
+
+    /**
+     The path to the file, in a form suitable for display.  This is empty
+     when searching standard input.
+     */
+    YORI_STRING DisplayPath;
+
+    /**
+     An opened handle to the file.  This is closed once searching is
+     complete.
+     */
+    HANDLE FileHandle;
+
+    /**
+     TRUE if the file was searched successfully.
+     */
+    BOOL Success;
+
+    /**
+     TRUE if the file can be searched by mapping it into memory.  A failure
+     to read a mapped view raises an exception rather than returning an
+     error, which is most likely on network or removable media, so only
+     files on fixed drives are mapped; others are read with ReadFile.
+     */
+    BOOLEAN CanMap;
+
+    /**
+     The number of matching lines found in the file.
+     */
+    DWORD MatchCount;
+
+    /**
+     The text to display for each matching line, in file:line:text form.
+     */
+    YORI_STRING Results;
+} SEARCH_FILE, *PSEARCH_FILE;
+
+/**
+ State which is private to a single thread searching files.  Since matching
+ updates the compiled expression's cache, each thread has its own compiled
+ copy of the search strings.
+ */
+typedef struct _SEARCH_WORKER {
+
+    /**
+     Pointer to the search context.
+     */
+    struct _SEARCH_CONTEXT *SearchContext;
+
+    /**
+     The search strings compiled for use by this thread.
+     */
+    PYORILIB_REGEX Regex;
+
+    /**
+     A buffer used to hold a line converted from the file's encoding.
+     */
+    YORI_STRING LineBuffer;
+} SEARCH_WORKER, *PSEARCH_WORKER;
+
+/**
+ Context passed to the callback which is invoked for each file found.
+ */
+typedef struct _SEARCH_CONTEXT {
+
+    /**
+     TRUE to indicate that files are being enumerated recursively.
+     */
+    BOOLEAN Recursive;
+
+    /**
+     TRUE to indicate that only the names of matching files should be
+     displayed.
+     */
+    BOOLEAN FileNamesOnly;
+
+    /**
+     The first error encountered when enumerating objects from a single arg.
+     This is used to preserve file not found/path not found errors so that
+     when the program falls back to interpreting the argument as a literal,
+     if that still doesn't work, this is the error code that is displayed.
+     */
+    DWORD SavedErrorThisArg;
+
+    /**
+     Records the total number of files processed.
+     */
+    LONGLONG FilesFound;
+
+    /**
+     Records the total number of files processed within a single command line
+     argument.
+     */
+    LONGLONG FilesFoundThisArg;
+
+    /**
+     Records the number of files containing a match.
+     */
+    LONGLONG FilesMatched;
+
+    /**
+     The strings to search for.
+     */
+    PYORILIB_REGEX_PATTERN Patterns;
+
+    /**
+     The number of elements in Patterns.
+     */
+    DWORD PatternCount;
+
+    /**
+     Flags to compile the search strings with.
+     */
+    DWORD RegexFlags;
+
+    /**
+     Criteria that files must match before they are opened.  If no criteria
+     were specified, this contains no criteria and every file matches.
+     */
+    YORI_LIB_FILE_FILTER Filter;
+
+    /**
+     The pool of threads searching files.  Results are displayed in the
+     order files were found.
+     */
+    YORI_LIB_FILE_POOL Pool;
+
+    /**
+     State for the enumerating thread, used when files are searched without
+     worker threads.
+     */
+    SEARCH_WORKER Local;
+
+    /**
+     State for each worker thread.
+     */
+    SEARCH_WORKER Workers[YORI_LIB_FILE_POOL_MAX_THREADS];
+
+    /**
+     The type of each drive letter, as returned from GetDriveType, or
+     DRIVE_UNKNOWN if the drive has not been queried.
+     */
+    DWORD DriveTypes[26];
+} SEARCH_CONTEXT, *PSEARCH_CONTEXT;
+
+/**
+ Add a matching line to the results for a file.
+
+ @param File Pointer to the file containing the line.
+
+ @param LineNumber The line number within the file, starting from one.
+
+ @param Line Pointer to the text of the line.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+SearchAppendResult(
+    __inout PSEARCH_FILE File,
+    __in LONGLONG LineNumber,
+    __in PYORI_STRING Line
+    )
+{
+    YORI_STRING Number;
+    TCHAR NumberBuffer[32];
+    DWORD LengthNeeded;
+    DWORD LengthToAllocate;
+    PYORI_STRING Results;
+
+    YoriLibInitEmptyString(&Number);
+    Number.StartOfString = NumberBuffer;
+    Number.LengthAllocated = sizeof(NumberBuffer)/sizeof(NumberBuffer[0]);
+    YoriLibNumberToString(&Number, LineNumber, 10, 0, '\0');
+
+    Results = &File->Results;
+    LengthNeeded = Results->LengthInChars + File->DisplayPath.LengthInChars + Number.LengthInChars + Line->LengthInChars + 3;
+    if (LengthNeeded < Results->LengthInChars) {
+        return FALSE;
+    }
+
+    if (LengthNeeded > Results->LengthAllocated) {
+        LengthToAllocate = SEARCH_INITIAL_RESULT_SIZE;
+        while (LengthToAllocate < LengthNeeded && LengthToAllocate < 0x40000000) {
+            LengthToAllocate = LengthToAllocate * 2;
+        }
+        if (LengthToAllocate < LengthNeeded) {
+            LengthToAllocate = LengthNeeded;
+        }
+        if (!YoriLibReallocateString(Results, LengthToAllocate)) {
+            return FALSE;
+        }
+    }
+
+    if (File->DisplayPath.LengthInChars > 0) {
+        memcpy(&Results->StartOfString[Results->LengthInChars], File->DisplayPath.StartOfString, File->DisplayPath.LengthInChars * sizeof(TCHAR));
+        Results->LengthInChars += File->DisplayPath.LengthInChars;
+        Results->StartOfString[Results->LengthInChars] = ':';
+        Results->LengthInChars++;
+    }
+    memcpy(&Results->StartOfString[Results->LengthInChars], Number.StartOfString, Number.LengthInChars * sizeof(TCHAR));
+    Results->LengthInChars += Number.LengthInChars;
+    Results->StartOfString[Results->LengthInChars] = ':';
+    Results->LengthInChars++;
+    memcpy(&Results->StartOfString[Results->LengthInChars], Line->StartOfString, Line->LengthInChars * sizeof(TCHAR));
+    Results->LengthInChars += Line->LengthInChars;
+    Results->StartOfString[Results->LengthInChars] = '\n';
+    Results->LengthInChars++;
+
+    YoriLibFreeStringContents(&Number);
+    return TRUE;
+}
+
+/**
+ Check a single line against the search strings and record it if it
+ matches.
+
+ @param Worker Pointer to the state of the thread searching the file.
+
+ @param File Pointer to the file containing the line.
+
+ @param LineNumber The line number within the file, starting from one.
+
+ @param Line Pointer to the text of the line.
+
+ @return TRUE to continue searching the file, FALSE if no further lines
+         need to be searched.
+ */
+BOOL
+SearchProcessLine(
+    __in PSEARCH_WORKER Worker,
+    __inout PSEARCH_FILE File,
+    __in LONGLONG LineNumber,
+    __in PYORI_STRING Line
+    )
+{
+    if (!YoriLibRegexMatch(Worker->Regex, Line, NULL)) {
+        return TRUE;
+    }
+
+    File->MatchCount++;
+    if (Worker->SearchContext->FileNamesOnly) {
+        return FALSE;
+    }
+
+    if (!SearchAppendResult(File, LineNumber, Line)) {
+        File->Success = FALSE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Convert a line of narrow characters into the worker's line buffer.  Lines
+ consisting entirely of 7 bit characters are the same in every supported
+ encoding, so these are widened directly without a call to the system.
+
+ @param Worker Pointer to the state of the thread searching the file.  On
+        success, the worker's line buffer contains the converted line.
+
+ @param Bytes Pointer to the narrow line.
+
+ @param ByteCount The number of bytes in the narrow line.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+SearchConvertNarrowLine(
+    __inout PSEARCH_WORKER Worker,
+    __in PUCHAR Bytes,
+    __in DWORD ByteCount
+    )
+{
+    PYORI_STRING Line;
+    DWORD Index;
+    DWORD CharsNeeded;
+    UCHAR HighBits;
+
+    Line = &Worker->LineBuffer;
+    Line->LengthInChars = 0;
+    if (ByteCount == 0) {
+        return TRUE;
+    }
+
+    HighBits = 0;
+    for (Index = 0; Index < ByteCount; Index++) {
+        HighBits = (UCHAR)(HighBits | Bytes[Index]);
+    }
+
+    if ((HighBits & 0x80) == 0) {
+        CharsNeeded = ByteCount;
+    } else {
+        CharsNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Bytes, ByteCount);
+    }
+
+    if (CharsNeeded > Line->LengthAllocated) {
+        if (!YoriLibReallocateString(Line, CharsNeeded + 256)) {
+            return FALSE;
+        }
+    }
+
+    if ((HighBits & 0x80) == 0) {
+        for (Index = 0; Index < ByteCount; Index++) {
+            Line->StartOfString[Index] = Bytes[Index];
+        }
+    } else {
+        YoriLibMultibyteInput((LPCSTR)Bytes, ByteCount, Line->StartOfString, CharsNeeded);
+    }
+    Line->LengthInChars = CharsNeeded;
+    return TRUE;
+}
+
+/**
+ Search the contents of a file which has been mapped into memory.  Lines
+ are terminated by CR, LF or CRLF as with the line reader, and any leading
+ byte order mark is skipped.  UTF-16 lines are searched in place; other
+ encodings are converted one line at a time.
+
+ @param Worker Pointer to the state of the thread searching the file.
+
+ @param File Pointer to the file being searched.
+
+ @param Buffer Pointer to the mapped file contents.
+
+ @param BufferLength The number of bytes in the mapped file.
+ */
+VOID
+SearchMappedBuffer(
+    __in PSEARCH_WORKER Worker,
+    __inout PSEARCH_FILE File,
+    __in PUCHAR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    YORI_STRING Line;
+    PWCHAR WideBuffer;
+    LONGLONG LineNumber;
+    DWORD Index;
+    DWORD LineStart;
+    DWORD Length;
+    BOOL MoreLines;
+
+    File->Success = TRUE;
+    LineNumber = 0;
+    MoreLines = TRUE;
+
+    LineStart = YoriLibBytesInBom((PCHAR)Buffer, BufferLength);
+
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        WideBuffer = (PWCHAR)Buffer;
+        Length = BufferLength / sizeof(WCHAR);
+        LineStart = LineStart / sizeof(WCHAR);
+        YoriLibInitEmptyString(&Line);
+        for (Index = LineStart; MoreLines && Index < Length; Index++) {
+            if (WideBuffer[Index] == '\r' || WideBuffer[Index] == '\n') {
+                LineNumber++;
+                Line.StartOfString = &WideBuffer[LineStart];
+                Line.LengthInChars = Index - LineStart;
+                MoreLines = SearchProcessLine(Worker, File, LineNumber, &Line);
+                if (WideBuffer[Index] == '\r' && Index + 1 < Length && WideBuffer[Index + 1] == '\n') {
+                    Index++;
+                }
+                LineStart = Index + 1;
+            }
+        }
+
+        if (MoreLines && LineStart < Length) {
+            LineNumber++;
+            Line.StartOfString = &WideBuffer[LineStart];
+            Line.LengthInChars = Length - LineStart;
+            SearchProcessLine(Worker, File, LineNumber, &Line);
+        }
+        return;
+    }
+
+    Length = BufferLength;
+    for (Index = LineStart; MoreLines && Index < Length; Index++) {
+        if (Buffer[Index] == '\r' || Buffer[Index] == '\n') {
+            LineNumber++;
+            if (!SearchConvertNarrowLine(Worker, &Buffer[LineStart], Index - LineStart)) {
+                File->Success = FALSE;
+                return;
+            }
+            MoreLines = SearchProcessLine(Worker, File, LineNumber, &Worker->LineBuffer);
+            if (Buffer[Index] == '\r' && Index + 1 < Length && Buffer[Index + 1] == '\n') {
+                Index++;
+            }
+            LineStart = Index + 1;
+        }
+    }
+
+    if (MoreLines && LineStart < Length) {
+        LineNumber++;
+        if (!SearchConvertNarrowLine(Worker, &Buffer[LineStart], Length - LineStart)) {
+            File->Success = FALSE;
+            return;
+        }
+        SearchProcessLine(Worker, File, LineNumber, &Worker->LineBuffer);
+    }
+}
+
+/**
+ Search the contents of a stream using the line reader.  This is used for
+ pipes and for files which cannot be mapped into memory.
+
+ @param Worker Pointer to the state of the thread searching the file.
+
+ @param File Pointer to the file being searched.
+ */
+VOID
+SearchStream(
+    __in PSEARCH_WORKER Worker,
+    __inout PSEARCH_FILE File
+    )
+{
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    LONGLONG LineNumber;
+
+    YoriLibInitEmptyString(&LineString);
+    LineNumber = 0;
+    File->Success = TRUE;
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, File->FileHandle)) {
+            break;
+        }
+
+        LineNumber++;
+        if (!SearchProcessLine(Worker, File, LineNumber, &LineString)) {
+            break;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+    }
+
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+}
+
+/**
+ Search the contents of a single file and close its handle.  Files on fixed
+ drives are mapped into memory where possible.  This may be called on a
+ worker thread.
+
+ @param Context Pointer to the search context.
+
+ @param WorkerIndex The index of the thread searching the file, or
+        YORI_LIB_FILE_POOL_CALLING_THREAD if the file is being searched by
+        the enumerating thread.
+
+ @param Item Pointer to the pool state within the file to search.
+ */
+VOID
+SearchFile(
+    __in PVOID Context,
+    __in DWORD WorkerIndex,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    PSEARCH_CONTEXT SearchContext = (PSEARCH_CONTEXT)Context;
+    PSEARCH_WORKER Worker;
+    PSEARCH_FILE File;
+    HANDLE MappingHandle;
+    PUCHAR Buffer;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+
+    File = CONTAINING_RECORD(Item, SEARCH_FILE, PoolItem);
+    if (WorkerIndex == YORI_LIB_FILE_POOL_CALLING_THREAD) {
+        Worker = &SearchContext->Local;
+    } else {
+        Worker = &SearchContext->Workers[WorkerIndex];
+    }
+
+    MappingHandle = NULL;
+    Buffer = NULL;
+    FileSizeHigh = 0;
+    FileSizeLow = 0;
+
+    if (YoriLibIsOperationCancelled()) {
+        goto Complete;
+    }
+
+    if (File->CanMap && GetFileType(File->FileHandle) == FILE_TYPE_DISK) {
+        FileSizeLow = GetFileSize(File->FileHandle, &FileSizeHigh);
+        if (FileSizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+            FileSizeHigh = (DWORD)-1;
+        }
+
+        if (FileSizeHigh == 0 && FileSizeLow == 0) {
+            File->Success = TRUE;
+            goto Complete;
+        }
+
+        if (FileSizeHigh == 0) {
+            MappingHandle = CreateFileMapping(File->FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (MappingHandle != NULL) {
+                Buffer = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+    }
+
+    if (Buffer != NULL) {
+        SearchMappedBuffer(Worker, File, Buffer, FileSizeLow);
+        UnmapViewOfFile(Buffer);
+    } else {
+        SearchStream(Worker, File);
+    }
+
+    if (MappingHandle != NULL) {
+        CloseHandle(MappingHandle);
+    }
+
+Complete:
+    CloseHandle(File->FileHandle);
+    File->FileHandle = NULL;
+}
+
+/**
+ Prepare the state for a thread to search files, including compiling the
+ search strings for its exclusive use.
+
+ @param SearchContext Pointer to the search context.
+
+ @param Worker Pointer to the worker state to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+SearchInitializeWorker(
+    __in PSEARCH_CONTEXT SearchContext,
+    __out PSEARCH_WORKER Worker
+    )
+{
+    Worker->SearchContext = SearchContext;
+    YoriLibInitEmptyString(&Worker->LineBuffer);
+    return YoriLibRegexCompile(SearchContext->Patterns,
+                               SearchContext->PatternCount,
+                               SearchContext->RegexFlags,
+                               &Worker->Regex,
+                               NULL,
+                               NULL);
+}
+
+/**
+ Free the state for a thread which has finished searching files.
+
+ @param Worker Pointer to the worker state to free.
+ */
+VOID
+SearchCleanupWorker(
+    __inout PSEARCH_WORKER Worker
+    )
+{
+    if (Worker->Regex != NULL) {
+        YoriLibRegexFree(Worker->Regex);
+        Worker->Regex = NULL;
+    }
+    YoriLibFreeStringContents(&Worker->LineBuffer);
+}
+
+/**
+ Prepare the state for a worker thread before it is created.
+
+ @param Context Pointer to the search context.
+
+ @param WorkerIndex The index of the worker thread.
+
+ @return TRUE to indicate success, FALSE to indicate failure, in which case
+         no further worker threads are created.
+ */
+BOOL
+SearchInitializePoolWorker(
+    __in PVOID Context,
+    __in DWORD WorkerIndex
+    )
+{
+    PSEARCH_CONTEXT SearchContext = (PSEARCH_CONTEXT)Context;
+    return SearchInitializeWorker(SearchContext, &SearchContext->Workers[WorkerIndex]);
+}
+
+/**
+ Display the results of a file which has been searched and free it.  Files
+ are completed in the order they were found.
+
+ @param Context Pointer to the search context.
+
+ @param Item Pointer to the pool state within the searched file.
+ */
+VOID
+SearchCompleteFile(
+    __in PVOID Context,
+    __in PYORI_LIB_FILE_POOL_ITEM Item
+    )
+{
+    PSEARCH_CONTEXT SearchContext = (PSEARCH_CONTEXT)Context;
+    PSEARCH_FILE File;
+
+    File = CONTAINING_RECORD(Item, SEARCH_FILE, PoolItem);
+    if (File->MatchCount > 0) {
+        SearchContext->FilesMatched++;
+        if (SearchContext->FileNamesOnly) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &File->DisplayPath);
+        } else if (File->Results.LengthInChars > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &File->Results);
+        }
+    }
+
+    if (!File->Success && !YoriLibIsOperationCancelled()) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: read of %y failed\n"), &File->DisplayPath);
+    }
+
+    YoriLibFreeStringContents(&File->Results);
+    YoriLibFreeStringContents(&File->DisplayPath);
+    YoriLibFree(File);
+}
+
+/**
+ Determine whether a file is on a fixed local drive, so that it can be
+ searched by mapping it into memory.  The type of each drive letter is
+ only queried once.
+
+ @param SearchContext Pointer to the search context.
+
+ @param FilePath Pointer to the full path of the file.
+
+ @return TRUE if the file is on a fixed drive, FALSE if it is not or if
+         this cannot be determined.
+ */
+BOOL
+SearchIsFileOnFixedDrive(
+    __inout PSEARCH_CONTEXT SearchContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    TCHAR DriveRoot[sizeof("A:\\")];
+    TCHAR DriveLetter;
+    DWORD DriveIndex;
+
+    if (YoriLibIsFullPathUnc(FilePath)) {
+        return FALSE;
+    }
+
+    if (YoriLibIsPrefixedDriveLetterWithColon(FilePath)) {
+        DriveLetter = FilePath->StartOfString[4];
+    } else if (YoriLibIsDriveLetterWithColon(FilePath)) {
+        DriveLetter = FilePath->StartOfString[0];
+    } else {
+        return FALSE;
+    }
+
+    DriveIndex = (DWORD)(YoriLibUpcaseChar(DriveLetter) - 'A');
+    if (DriveIndex >= sizeof(SearchContext->DriveTypes)/sizeof(SearchContext->DriveTypes[0])) {
+        return FALSE;
+    }
+
+    if (SearchContext->DriveTypes[DriveIndex] == DRIVE_UNKNOWN) {
+        DriveRoot[0] = (TCHAR)('A' + DriveIndex);
+        DriveRoot[1] = ':';
+        DriveRoot[2] = '\\';
+        DriveRoot[3] = '\0';
+        SearchContext->DriveTypes[DriveIndex] = GetDriveType(DriveRoot);
+    }
+
+    if (SearchContext->DriveTypes[DriveIndex] == DRIVE_FIXED) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Queue an opened file to be searched.  If worker threads are available the
+ file is searched on a worker thread, otherwise it is searched immediately.
+ Results are displayed in the order files are queued.
+
+ @param SearchContext Pointer to the search context.
+
+ @param FilePath Pointer to the path of the file.
+
+ @param FileHandle Handle to the opened file.  This routine takes ownership
+        of the handle.
+ */
+VOID
+SearchQueueFile(
+    __inout PSEARCH_CONTEXT SearchContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE FileHandle
+    )
+{
+    PSEARCH_FILE File;
+
+    File = YoriLibMalloc(sizeof(SEARCH_FILE));
+    if (File == NULL) {
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    ZeroMemory(File, sizeof(SEARCH_FILE));
+    File->FileHandle = FileHandle;
+    if (!YoriLibFilePoolInitializeItem(&File->PoolItem)) {
+        CloseHandle(FileHandle);
+        YoriLibFree(File);
+        return;
+    }
+
+    File->CanMap = (BOOLEAN)SearchIsFileOnFixedDrive(SearchContext, FilePath);
+    YoriLibInitEmptyString(&File->Results);
+    YoriLibInitEmptyString(&File->DisplayPath);
+    if (!YoriLibUnescapePath(FilePath, &File->DisplayPath)) {
+        YoriLibFilePoolCleanupItem(&File->PoolItem);
+        CloseHandle(FileHandle);
+        YoriLibFree(File);
+        return;
+    }
+
+    YoriLibFilePoolQueueItem(&SearchContext->Pool, &File->PoolItem);
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the search context structure indicating the
+        action to perform.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+SearchFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    HANDLE FileHandle;
+    WIN32_FIND_DATA FindData;
+    PSEARCH_CONTEXT SearchContext = (PSEARCH_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (FileInfo != NULL &&
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        return TRUE;
+    }
+
+    //
+    //  Apply any file criteria before opening the file, since the criteria
+    //  can usually be evaluated from the enumeration data alone.
+    //
+
+    if (SearchContext->Filter.NumberCriteria > 0) {
+        if (FileInfo == NULL) {
+            if (!YoriLibUpdateFindDataFromFileInformation(&FindData, FilePath->StartOfString, TRUE)) {
+                return TRUE;
+            }
+            FileInfo = &FindData;
+        }
+
+        if (!YoriLibFileFiltCheckFilterMatch(&SearchContext->Filter, FilePath, FileInfo)) {
+            SearchContext->SavedErrorThisArg = ERROR_SUCCESS;
+            SearchContext->FilesFoundThisArg++;
+            return TRUE;
+        }
+    }
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        if (SearchContext->SavedErrorThisArg == ERROR_SUCCESS) {
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: open of %y failed: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+        return TRUE;
+    }
+
+    SearchContext->SavedErrorThisArg = ERROR_SUCCESS;
+    SearchContext->FilesFound++;
+    SearchContext->FilesFoundThisArg++;
+    SearchQueueFile(SearchContext, FilePath, FileHandle);
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the context block indicating whether the
+        enumeration was recursive.  Recursive enumerates do not complain
+        if a matching file is not in every single directory, because
+        common usage expects files to be in a subset of directories only.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+SearchFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+    PSEARCH_CONTEXT SearchContext = (PSEARCH_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
+    }
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        if (!SearchContext->Recursive) {
+            SearchContext->SavedErrorThisArg = ErrorCode;
+        }
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (DWORD)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
+
+/**
+ Add a string to the set of strings to search for.
+
+ @param SearchContext Pointer to the search context.
+
+ @param String Pointer to the string to search for.  The string is not
+        copied, so it must remain valid until the search is complete.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+SearchAddPattern(
+    __inout PSEARCH_CONTEXT SearchContext,
+    __in PYORI_STRING String
+    )
+{
+    PYORILIB_REGEX_PATTERN NewPatterns;
+
+    NewPatterns = YoriLibMalloc((SearchContext->PatternCount + 1) * sizeof(YORILIB_REGEX_PATTERN));
+    if (NewPatterns == NULL) {
+        return FALSE;
+    }
+
+    if (SearchContext->PatternCount > 0) {
+        memcpy(NewPatterns, SearchContext->Patterns, SearchContext->PatternCount * sizeof(YORILIB_REGEX_PATTERN));
+        YoriLibFree(SearchContext->Patterns);
+    }
+
+    YoriLibInitEmptyString(&NewPatterns[SearchContext->PatternCount].Pattern);
+    NewPatterns[SearchContext->PatternCount].Pattern.StartOfString = String->StartOfString;
+    NewPatterns[SearchContext->PatternCount].Pattern.LengthInChars = String->LengthInChars;
+    NewPatterns[SearchContext->PatternCount].Flags = YORILIB_REGEX_PATTERN_LITERAL;
+    SearchContext->Patterns = NewPatterns;
+    SearchContext->PatternCount++;
+    return TRUE;
+}
+
+/**
+ Free any state allocated within the search context.
+
+ @param SearchContext Pointer to the search context.
+ */
+VOID
+SearchCleanupContext(
+    __inout PSEARCH_CONTEXT SearchContext
+    )
+{
+    DWORD Index;
+
+    SearchCleanupWorker(&SearchContext->Local);
+    for (Index = 0; Index < YORI_LIB_FILE_POOL_MAX_THREADS; Index++) {
+        SearchCleanupWorker(&SearchContext->Workers[Index]);
+    }
+    if (SearchContext->Patterns != NULL) {
+        YoriLibFree(SearchContext->Patterns);
+        SearchContext->Patterns = NULL;
+    }
+    YoriLibFileFiltFreeFilter(&SearchContext->Filter);
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the search builtin command.
+ */
+#define ENTRYPOINT YoriCmd_SEARCH
+#else
+/**
+ The main entrypoint for the search standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the search cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, zero if any match was found, nonzero if
+         no match was found or an error occurred.
+ */
+DWORD
+ENTRYPOINT(
+    __in DWORD ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOL ArgumentUnderstood;
+    DWORD i;
+    DWORD StartArg = 0;
+    DWORD MatchFlags;
+    DWORD ErrorPattern;
+    DWORD ErrorOffset;
+    BOOL BasicEnumeration = FALSE;
+    BOOL Insensitive = FALSE;
+    BOOL RegularExpression = FALSE;
+    SEARCH_CONTEXT SearchContext;
+    YORI_STRING Arg;
+    PYORILIB_REGEX Regex;
+
+    ZeroMemory(&SearchContext, sizeof(SearchContext));
+    YoriLibFilePoolInitialize(&SearchContext.Pool, SearchInitializePoolWorker, SearchFile, SearchCompleteFile, &SearchContext);
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("?")) == 0) {
+                SearchHelp();
+                SearchCleanupContext(&SearchContext);
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                SearchCleanupContext(&SearchContext);
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("b")) == 0) {
+                BasicEnumeration = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("e")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (!SearchAddPattern(&SearchContext, &ArgV[i + 1])) {
+                        SearchCleanupContext(&SearchContext);
+                        return EXIT_FAILURE;
+                    }
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("f")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_STRING ErrorSubstring;
+                    YoriLibInitEmptyString(&ErrorSubstring);
+
+                    YoriLibFileFiltFreeFilter(&SearchContext.Filter);
+                    if (!YoriLibFileFiltParseFilterString(&SearchContext.Filter, &ArgV[i + 1], &ErrorSubstring)) {
+                        if (ErrorSubstring.LengthInChars > 0) {
+                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: error parsing filter string '%y' at '%y'\n"), &ArgV[i + 1], &ErrorSubstring);
+                        } else {
+                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: error parsing filter string '%y'\n"), &ArgV[i + 1]);
+                        }
+                        SearchCleanupContext(&SearchContext);
+                        return EXIT_FAILURE;
+                    }
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("i")) == 0) {
+                Insensitive = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("l")) == 0) {
+                SearchContext.FileNamesOnly = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                RegularExpression = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
+                SearchContext.Recursive = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
+                StartArg = i + 1;
+                ArgumentUnderstood = TRUE;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    //
+    //  If no search string was given with -e, the first argument is the
+    //  search string.
+    //
+
+    if (SearchContext.PatternCount == 0) {
+        if (StartArg == 0 || StartArg == ArgC) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: missing argument\n"));
+            SearchCleanupContext(&SearchContext);
+            return EXIT_FAILURE;
+        }
+
+        if (!SearchAddPattern(&SearchContext, &ArgV[StartArg])) {
+            SearchCleanupContext(&SearchContext);
+            return EXIT_FAILURE;
+        }
+        StartArg++;
+    }
+
+    if (RegularExpression) {
+        for (i = 0; i < SearchContext.PatternCount; i++) {
+            SearchContext.Patterns[i].Flags = 0;
+        }
+    }
+
+    if (Insensitive) {
+        SearchContext.RegexFlags = YORILIB_REGEX_INSENSITIVE;
+    }
+
+    //
+    //  Compile the search strings once here to report any errors.  This
+    //  copy is used if files are searched on this thread.
+    //
+
+    if (!YoriLibRegexCompile(SearchContext.Patterns,
+                             SearchContext.PatternCount,
+                             SearchContext.RegexFlags,
+                             &Regex,
+                             &ErrorPattern,
+                             &ErrorOffset)) {
+
+        if (ErrorPattern != YORILIB_REGEX_NO_PATTERN) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("search: invalid regular expression at offset %i: %y\n"), ErrorOffset, &SearchContext.Patterns[ErrorPattern].Pattern);
+        }
+        SearchCleanupContext(&SearchContext);
+        return EXIT_FAILURE;
+    }
+
+    SearchContext.Local.SearchContext = &SearchContext;
+    SearchContext.Local.Regex = Regex;
+
+#if YORI_BUILTIN
+    YoriLibCancelEnable();
+#endif
+
+    //
+    //  Attempt to enable backup privilege so an administrator can access more
+    //  objects successfully.
+    //
+
+    YoriLibEnableBackupPrivilege();
+
+    //
+    //  If no file name is specified, use stdin; otherwise open
+    //  the file and use that
+    //
+
+    if (StartArg == 0 || StartArg == ArgC) {
+        SEARCH_FILE File;
+
+        if (YoriLibIsStdInConsole()) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
+            SearchCleanupContext(&SearchContext);
+            return EXIT_FAILURE;
+        }
+
+        ZeroMemory(&File, sizeof(File));
+        YoriLibInitEmptyString(&File.DisplayPath);
+        YoriLibInitEmptyString(&File.Results);
+        File.FileHandle = GetStdHandle(STD_INPUT_HANDLE);
+        SearchStream(&SearchContext.Local, &File);
+        SearchContext.FilesFound++;
+        if (File.MatchCount > 0) {
+            SearchContext.FilesMatched++;
+            if (File.Results.LengthInChars > 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &File.Results);
+            }
+        }
+        YoriLibFreeStringContents(&File.Results);
+    } else {
+        YoriLibFilePoolStartWorkers(&SearchContext.Pool);
+
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+        if (SearchContext.Recursive) {
+            MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+        }
+        if (BasicEnumeration) {
+            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+        }
+
+        for (i = StartArg; i < ArgC; i++) {
+
+            SearchContext.FilesFoundThisArg = 0;
+            SearchContext.SavedErrorThisArg = ERROR_SUCCESS;
+
+            YoriLibForEachFile(&ArgV[i],
+                               MatchFlags,
+                               0,
+                               SearchFileFoundCallback,
+                               SearchFileEnumerateErrorCallback,
+                               &SearchContext);
+
+            if (SearchContext.FilesFoundThisArg == 0) {
+                YORI_STRING FullPath;
+                YoriLibInitEmptyString(&FullPath);
+                if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                    SearchFileFoundCallback(&FullPath, NULL, 0, &SearchContext);
+                    YoriLibFreeStringContents(&FullPath);
+                }
+                if (SearchContext.SavedErrorThisArg != ERROR_SUCCESS) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &ArgV[i]);
+                }
+            }
+        }
+
+        YoriLibFilePoolStopWorkers(&SearchContext.Pool);
+    }
+
+    SearchCleanupContext(&SearchContext);
+
+    if (SearchContext.FilesMatched == 0) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
@@ -192,12 +192,18 @@ YoriShAddAlias(
     NewAlias->Alias.StartOfString[AliasNameLengthInChars] = '\0';
     NewAlias->Value.StartOfString[ValueNameLengthInChars] = '\0';
 
+    if (!YoriLibHashInsertByKey(YoriShAliasesHash, &NewAlias->Alias, NewAlias, &NewAlias->HashEntry)) {
+        YoriLibFreeStringContents(&NewAlias->Alias);
+        YoriLibFreeStringContents(&NewAlias->Value);
+        YoriLibDereference(NewAlias);
+        return FALSE;
+    }
+
     if (!Internal && DllKernel32.pAddConsoleAliasW) {
         DllKernel32.pAddConsoleAliasW(NewAlias->Alias.StartOfString, NewAlias->Value.StartOfString, ALIAS_APP_NAME);
     }
 
     YoriLibAppendList(&YoriShAliasesList, &NewAlias->ListEntry);
-    YoriLibHashInsertByKey(YoriShAliasesHash, &NewAlias->Alias, NewAlias, &NewAlias->HashEntry);
     
     return TRUE;
 }
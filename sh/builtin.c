@@ -377,6 +377,9 @@ YoriShExecuteInProc(
     )
 {
     YORI_SH_PREVIOUS_REDIRECT_CONTEXT PreviousRedirectContext;
+    YORI_LIB_INPROC_STREAM InProcStream;
+    PYORI_LIB_INPROC_STREAM PreviousInProcStream;
+    PVOID PriorProcessBuffers = NULL;
     BOOLEAN WasPipe = FALSE;
     PYORI_SH_CMD_CONTEXT OriginalCmdContext = &ExecContext->CmdToExec;
     PYORI_SH_CMD_CONTEXT SavedEscapedCmdContext;
@@ -400,12 +403,21 @@ YoriShExecuteInProc(
     //  requested, convert it into a buffer, and let the process
     //  finish.
     //
+    //  If the previous program was a builtin, its buffer is forwarded to
+    //  this one.  Take ownership of the buffer so the input can be read
+    //  from memory rather than through the pipe.
+    //
 
     if (ExecContext->StdOutType == StdOutTypePipe) {
         WasPipe = TRUE;
         ExecContext->StdOutType = StdOutTypeBuffer;
     }
 
+    if (ExecContext->StdInType == StdInTypePipe) {
+        PriorProcessBuffers = ExecContext->StdIn.Pipe.ProcessBuffersFromPriorProcess;
+        ExecContext->StdIn.Pipe.ProcessBuffersFromPriorProcess = NULL;
+    }
+
     //
     //  Check if an argument isn't quoted but requires quotes.  This implies
     //  something happened outside the user's immediate control, such as
@@ -425,6 +437,9 @@ YoriShExecuteInProc(
 
             YoriLibInitEmptyString(&CmdLine);
             if (!YoriShBuildCmdlineFromCmdContext(&NoEscapesCmdContext, &CmdLine, TRUE, NULL, NULL)) {
+                if (PriorProcessBuffers != NULL) {
+                    YoriShDereferenceProcessBuffer(PriorProcessBuffers);
+                }
                 YoriShFreeCmdContext(&NoEscapesCmdContext);
                 return ERROR_OUTOFMEMORY;
             }
@@ -434,6 +449,9 @@ YoriShExecuteInProc(
             YoriLibFreeStringContents(&CmdLine);
 
             if (ArgV == NULL) {
+                if (PriorProcessBuffers != NULL) {
+                    YoriShDereferenceProcessBuffer(PriorProcessBuffers);
+                }
                 YoriShFreeCmdContext(&NoEscapesCmdContext);
                 return ERROR_OUTOFMEMORY;
             }
@@ -448,11 +466,20 @@ YoriShExecuteInProc(
             }
             YoriLibDereference(ArgV);
         }
+        if (PriorProcessBuffers != NULL) {
+            YoriShDereferenceProcessBuffer(PriorProcessBuffers);
+        }
         YoriShFreeCmdContext(&NoEscapesCmdContext);
 
         return ExitCode;
     }
 
+    PreviousInProcStream = NULL;
+    if (PriorProcessBuffers != NULL) {
+        YoriShInitializeInProcStream(PriorProcessBuffers, GetStdHandle(STD_INPUT_HANDLE), &InProcStream);
+        PreviousInProcStream = YoriLibSetInProcStream(&InProcStream);
+    }
+
     //
     //  Unlike external processes, builtins need to start buffering
     //  before they start to ensure that output during execution has
@@ -479,6 +506,9 @@ YoriShExecuteInProc(
     ExitCode = Fn(ArgC, ArgV);
     YoriShGlobal.RecursionDepth--;
     YoriShGlobal.EscapedCmdContext = SavedEscapedCmdContext;
+    if (PriorProcessBuffers != NULL) {
+        YoriLibSetInProcStream(PreviousInProcStream);
+    }
     YoriShRevertRedirection(&PreviousRedirectContext);
 
     if (WasPipe) {
@@ -509,6 +539,9 @@ YoriShExecuteInProc(
         }
         YoriLibDereference(ArgV);
     }
+    if (PriorProcessBuffers != NULL) {
+        YoriShDereferenceProcessBuffer(PriorProcessBuffers);
+    }
     YoriShFreeCmdContext(&NoEscapesCmdContext);
 
     return ExitCode;
@@ -729,6 +762,12 @@ YoriShBuiltinRegister(
     YoriLibReference(NewCallback);
     NewCallback->BuiltinName.MemoryToFree = NewCallback;
 
+    if (!YoriLibHashInsertByKey(YoriShBuiltinHash, &NewCallback->BuiltinName, NewCallback, &NewCallback->HashEntry)) {
+        YoriLibFreeStringContents(&NewCallback->BuiltinName);
+        YoriLibDereference(NewCallback);
+        return FALSE;
+    }
+
     NewCallback->BuiltInFn = CallbackFn;
     if (YoriShActiveModule != NULL) {
         YoriShActiveModule->ReferenceCount++;
@@ -742,7 +781,6 @@ YoriShBuiltinRegister(
     //
 
     YoriLibInsertList(&YoriShGlobal.BuiltinCallbacks, &NewCallback->ListEntry);
-    YoriLibHashInsertByKey(YoriShBuiltinHash, &NewCallback->BuiltinName, NewCallback, &NewCallback->HashEntry);
     return TRUE;
 }
 
@@ -69,6 +69,19 @@ typedef struct _YORI_SH_PROCESS_BUFFER {
      */
     DWORD BytesSent;
 
+    /**
+     The number of bytes which have been written to the next process after
+     the buffer has been forwarded to it.
+     */
+    DWORD BytesForwarded;
+
+    /**
+     Set to TRUE to indicate that the next process is a builtin command which
+     will read the remainder of the buffer directly from memory, so no more
+     data should be written to it.
+     */
+    BOOL StopForwarding;
+
     /**
      The data buffer.
      */
@@ -184,29 +197,44 @@ YoriShCmdBufferPumpToNextProcess(
     )
 {
     PYORI_SH_PROCESS_BUFFER ThisBuffer = (PYORI_SH_PROCESS_BUFFER)Param;
-    DWORD BytesSent = 0;
+    DWORD BytesSent;
     DWORD BytesWritten;
     DWORD BytesToWrite;
+    HANDLE hTemp;
+
+    //
+    //  The buffer is complete before it is forwarded, so its contents don't
+    //  change.  The lock is not held while writing, because the next
+    //  process may be a builtin on the thread that needs the lock to stop
+    //  this thread, and it can only drain the pipe after that.
+    //
 
     while (TRUE) {
 
         BytesToWrite = 4096;
         AcquireMutex(ThisBuffer->Mutex);
+        if (ThisBuffer->StopForwarding) {
+            ReleaseMutex(ThisBuffer->Mutex);
+            break;
+        }
+        BytesSent = ThisBuffer->BytesForwarded;
         if (BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
             BytesToWrite = ThisBuffer->BytesPopulated - BytesSent;
         }
+        ReleaseMutex(ThisBuffer->Mutex);
 
-        if (WriteFile(ThisBuffer->hSource,
-                      YoriLibAddToPointer(ThisBuffer->Buffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
+        if (!WriteFile(ThisBuffer->hSource,
+                       YoriLibAddToPointer(ThisBuffer->Buffer, BytesSent),
+                       BytesToWrite,
+                       &BytesWritten,
+                       NULL)) {
 
-            BytesSent += BytesWritten;
-        } else {
-            ReleaseMutex(ThisBuffer->Mutex);
             break;
         }
+
+        AcquireMutex(ThisBuffer->Mutex);
+        ThisBuffer->BytesForwarded += BytesWritten;
+        BytesSent = ThisBuffer->BytesForwarded;
         ReleaseMutex(ThisBuffer->Mutex);
 
         ASSERT(BytesSent <= ThisBuffer->BytesPopulated);
@@ -215,8 +243,14 @@ YoriShCmdBufferPumpToNextProcess(
         }
     }
 
-    CloseHandle(ThisBuffer->hSource);
+    //
+    //  Closing the pipe tells an in process reader that BytesForwarded is
+    //  final.
+    //
+
+    hTemp = ThisBuffer->hSource;
     ThisBuffer->hSource = NULL;
+    CloseHandle(hTemp);
 
     return 0;
 }
@@ -548,10 +582,16 @@ YoriShForwardProcessBufferToNextProcess(
         }
 
         //
-        //  Reverse the flow and create a thread to pump data out
+        //  Reverse the flow and create a thread to pump data out.  If the
+        //  next program is a builtin, it can stop this thread and read the
+        //  buffer directly, so give it a reference to the buffer.
         //
 
+        ThisBuffer->OutputBuffer.BytesForwarded = 0;
+        ThisBuffer->OutputBuffer.StopForwarding = FALSE;
         ThisBuffer->OutputBuffer.hSource = WriteHandle;
+        YoriShReferenceProcessBuffer(ThisBuffer);
+        ExecContext->NextProgram->StdIn.Pipe.ProcessBuffersFromPriorProcess = ThisBuffer;
         ThisBuffer->OutputBuffer.hPumpThread = CreateThread(NULL, 0, YoriShCmdBufferPumpToNextProcess, &ThisBuffer->OutputBuffer, 0, &ThreadId);
         if (ThisBuffer->OutputBuffer.hPumpThread == NULL) {
             return FALSE;
@@ -564,6 +604,93 @@ YoriShForwardProcessBufferToNextProcess(
     }
 }
 
+/**
+ Invoked when a builtin command first reads from its input which was
+ forwarded from a buffer.  This stops the thread which is writing the buffer
+ into the pipe, because the builtin will read the remainder from memory.
+
+ @param Context Pointer to the buffer being forwarded.
+ */
+VOID
+YoriShInProcStreamClaim(
+    __in PVOID Context
+    )
+{
+    PYORI_SH_PROCESS_BUFFER ThisBuffer = (PYORI_SH_PROCESS_BUFFER)Context;
+
+    AcquireMutex(ThisBuffer->Mutex);
+    ThisBuffer->StopForwarding = TRUE;
+    ReleaseMutex(ThisBuffer->Mutex);
+}
+
+/**
+ Invoked when a builtin command has drained its input pipe, so the thread
+ which was writing to it has stopped.  This returns the buffer and the
+ portion of it which was not written into the pipe.
+
+ @param Context Pointer to the buffer being forwarded.
+
+ @param Buffer On successful completion, updated to point to the buffer
+        data.
+
+ @param BytesConsumed On successful completion, updated to contain the
+        number of bytes which were written into the pipe.
+
+ @param BytesTotal On successful completion, updated to contain the number
+        of bytes in the buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShInProcStreamGetBuffer(
+    __in PVOID Context,
+    __out PUCHAR * Buffer,
+    __out PDWORD BytesConsumed,
+    __out PDWORD BytesTotal
+    )
+{
+    PYORI_SH_PROCESS_BUFFER ThisBuffer = (PYORI_SH_PROCESS_BUFFER)Context;
+
+    AcquireMutex(ThisBuffer->Mutex);
+    *Buffer = (PUCHAR)ThisBuffer->Buffer;
+    *BytesConsumed = ThisBuffer->BytesForwarded;
+    *BytesTotal = ThisBuffer->BytesPopulated;
+    ReleaseMutex(ThisBuffer->Mutex);
+    return TRUE;
+}
+
+/**
+ Prepare an in process stream so that a builtin command can read the output
+ of a previous builtin command directly from the buffer containing it.  If
+ the builtin reads its input via the line reader, the data is copied from
+ memory; any other reader still sees a pipe.
+
+ @param ThisBuffer The buffered output of the previous program, as forwarded
+        by @ref YoriShForwardProcessBufferToNextProcess .  The caller must
+        hold a reference on this until the stream is no longer in use.
+
+ @param Handle The handle that the builtin will read its input from.
+
+ @param Stream On completion, populated with the stream which can be
+        attached with YoriLibSetInProcStream.
+ */
+VOID
+YoriShInitializeInProcStream(
+    __in PVOID ThisBuffer,
+    __in HANDLE Handle,
+    __out PYORI_LIB_INPROC_STREAM Stream
+    )
+{
+    PYORI_SH_BUFFERED_PROCESS ThisBufferNonOpaque = (PYORI_SH_BUFFERED_PROCESS)ThisBuffer;
+
+    ZeroMemory(Stream, sizeof(YORI_LIB_INPROC_STREAM));
+    Stream->Handle = Handle;
+    Stream->Context = &ThisBufferNonOpaque->OutputBuffer;
+    Stream->ClaimFn = YoriShInProcStreamClaim;
+    Stream->GetBufferFn = YoriShInProcStreamGetBuffer;
+}
+
 /**
  Dereference an existing outstanding process buffer set.
 
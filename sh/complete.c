@@ -36,7 +36,8 @@
         after this entry in the list.  If NULL, the new match is inserted
         at the beginning of the list.
 
- @param Match Pointer to the match to insert.
+ @param Match Pointer to the match to insert.  If the match cannot be
+        inserted into the hash table due to allocation failure, it is freed.
  */
 VOID
 YoriShAddMatchToTabContext(
@@ -48,7 +49,11 @@ YoriShAddMatchToTabContext(
     ASSERT(TabContext->MatchHashTable != NULL);
     ASSERT(Match->Value.MemoryToFree != NULL);
     ASSERT(Match->CursorOffset <= Match->Value.LengthInChars);
-    YoriLibHashInsertByKey(TabContext->MatchHashTable, &Match->Value, Match, &Match->HashEntry);
+    if (!YoriLibHashInsertByKey(TabContext->MatchHashTable, &Match->Value, Match, &Match->HashEntry)) {
+        YoriLibFreeStringContents(&Match->Value);
+        YoriLibDereference(Match);
+        return;
+    }
     if (EntryToInsertAfter == NULL) {
         YoriLibInsertList(&TabContext->MatchList, &Match->ListEntry);
     } else {
@@ -2312,6 +2317,7 @@ YoriShTabCompletion(
     YORI_STRING SuffixAfterBackquoteSubstring;
     BOOLEAN ListAll;
 
+    YoriShCloseInputGap(Buffer);
     if (Buffer->String.LengthInChars == 0) {
         return FALSE;
     }
@@ -2519,6 +2525,7 @@ YoriShPrependParentDirectory(
     YORI_STRING PrefixBeforeBackquoteSubstring;
     YORI_STRING SuffixAfterBackquoteSubstring;
 
+    YoriShCloseInputGap(Buffer);
     YoriShFindStringSubsetForCompletion(&Buffer->String,
                                         Buffer->CurrentOffset,
                                         Buffer->TabContext.SearchType,
@@ -2723,6 +2730,7 @@ YoriShCompleteSuggestion(
     YORI_STRING PrefixBeforeBackquoteSubstring;
     YORI_STRING SuffixAfterBackquoteSubstring;
 
+    YoriShCloseInputGap(Buffer);
     if (Buffer->String.LengthInChars == 0) {
         return;
     }
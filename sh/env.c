@@ -26,6 +26,11 @@
 
 #include "yori.h"
 
+/**
+ Mutable state that is global across the shell process.
+ */
+YORI_SH_GLOBALS YoriShGlobal;
+
 /**
  Returns TRUE if the specified character is an environment variable marker.
 
@@ -37,11 +37,64 @@ DWORD YoriShCommandHistoryCount;
 DWORD YoriShCommandHistoryMax;
 
 /**
- A lock around history updates.  History should really only be accessed
- by a single thread, but when the app is being closed it can be
- accessed by a background thread to write to disk.
+ An immutable view of the command history, published for threads other than
+ the input thread.  The view refers to a range within a buffer of NULL
+ terminated strings which can be shared by several snapshots.  The buffer
+ is only ever appended to beyond the end of the most recently published
+ range, so characters within any published range never change.
  */
-HANDLE YoriShHistoryLock;
+typedef struct _YORI_SH_HISTORY_SNAPSHOT {
+
+    /**
+     Pointer to the next snapshot that has been replaced but which may still
+     be in the process of being acquired by a reader.  This is only used by
+     the input thread.
+     */
+    struct _YORI_SH_HISTORY_SNAPSHOT *NextRetired;
+
+    /**
+     The number of references to the snapshot.  The snapshot is freed with
+     @ref YoriShDereferenceHistorySnapshot .
+     */
+    LONG volatile ReferenceCount;
+
+    /**
+     The number of entries in the snapshot.
+     */
+    DWORD Count;
+
+    /**
+     The history entries, oldest first, as a set of NULL terminated strings.
+     LengthInChars covers the entries including their terminators, and
+     LengthAllocated indicates the space in the shared buffer which can be
+     used to append further entries.  MemoryToFree holds a reference on the
+     shared buffer.
+     */
+    YORI_STRING Strings;
+} YORI_SH_HISTORY_SNAPSHOT, *PYORI_SH_HISTORY_SNAPSHOT;
+
+/**
+ The history list itself is only accessed by the input thread.  Other
+ threads, such as the restart save thread or a console close handler, read
+ the most recently published snapshot instead, so history updates never
+ wait for them and they never observe a partially updated list.  This
+ pointer holds one reference on the snapshot.
+ */
+PYORI_SH_HISTORY_SNAPSHOT volatile YoriShHistorySnapshot;
+
+/**
+ The number of threads currently acquiring a reference to the published
+ snapshot.  A replaced snapshot is not dereferenced by the input thread until
+ this is zero, since a reader may have loaded the pointer without yet
+ referencing it.
+ */
+LONG volatile YoriShHistorySnapshotReaders;
+
+/**
+ A list of snapshots that have been replaced but not yet dereferenced.  This
+ is only accessed by the input thread.
+ */
+PYORI_SH_HISTORY_SNAPSHOT YoriShHistoryRetiredSnapshots;
 
 /**
  Set to TRUE once the history module has been initialized.
@@ -49,76 +102,330 @@ HANDLE YoriShHistoryLock;
 BOOL YoriShHistoryInitialized;
 
 /**
- Add an entered command into the command history buffer.
+ Release a reference on a history snapshot, freeing it and releasing its
+ reference on the shared string buffer when the last reference is released.
+
+ @param Snapshot Pointer to the snapshot to dereference.
+ */
+VOID
+YoriShDereferenceHistorySnapshot(
+    __in PYORI_SH_HISTORY_SNAPSHOT Snapshot
+    )
+{
+    if (InterlockedDecrement((PLONG)&Snapshot->ReferenceCount) == 0) {
+        YoriLibFreeStringContents(&Snapshot->Strings);
+        YoriLibFree(Snapshot);
+    }
+}
+
+/**
+ Release any replaced snapshots that can no longer be acquired by a reader.
+
+ @param Force If TRUE, release replaced snapshots regardless of readers.
+        This is used when the shell is terminating.
+ */
+VOID
+YoriShReleaseRetiredHistorySnapshots(
+    __in BOOLEAN Force
+    )
+{
+    PYORI_SH_HISTORY_SNAPSHOT Snapshot;
+
+    if (!Force && YoriShHistorySnapshotReaders != 0) {
+        return;
+    }
+
+    while (YoriShHistoryRetiredSnapshots != NULL) {
+        Snapshot = YoriShHistoryRetiredSnapshots;
+        YoriShHistoryRetiredSnapshots = Snapshot->NextRetired;
+        YoriShDereferenceHistorySnapshot(Snapshot);
+    }
+}
+
+/**
+ Make a snapshot the published view of history, retiring the previously
+ published snapshot.  This is called from the input thread.
+
+ @param NewSnapshot Pointer to the snapshot to publish, or NULL if there is
+        no history.  The published pointer takes over the caller's reference.
+ */
+VOID
+YoriShReplaceHistorySnapshot(
+    __in_opt PYORI_SH_HISTORY_SNAPSHOT NewSnapshot
+    )
+{
+    PYORI_SH_HISTORY_SNAPSHOT OldSnapshot;
+
+    OldSnapshot = InterlockedExchangePointer((PVOID *)&YoriShHistorySnapshot, NewSnapshot);
+    if (OldSnapshot != NULL) {
+        OldSnapshot->NextRetired = YoriShHistoryRetiredSnapshots;
+        YoriShHistoryRetiredSnapshots = OldSnapshot;
+    }
+
+    YoriShReleaseRetiredHistorySnapshots(FALSE);
+}
+
+/**
+ Replace the published snapshot of history with one reflecting the current
+ history list, copying every entry into a new buffer.  This is called from
+ the input thread after the list changes in a way other than appending.  If
+ memory cannot be allocated, the previous snapshot remains published.
+ */
+VOID
+YoriShPublishHistorySnapshot()
+{
+    PYORI_SH_HISTORY_SNAPSHOT NewSnapshot;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    DWORD CharsNeeded;
+    DWORD StringOffset;
+
+    NewSnapshot = NULL;
+    if (YoriShGlobal.CommandHistory.Next != NULL && YoriShCommandHistoryCount > 0) {
+        CharsNeeded = 0;
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            CharsNeeded += HistoryEntry->CmdLine.LengthInChars + 1;
+            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+
+        NewSnapshot = YoriLibMalloc(sizeof(YORI_SH_HISTORY_SNAPSHOT));
+        if (NewSnapshot == NULL) {
+            return;
+        }
+
+        //
+        //  Leave room to append as many characters again before the buffer
+        //  needs to be copied.
+        //
+
+        if (!YoriLibAllocateString(&NewSnapshot->Strings, CharsNeeded * 2)) {
+            YoriLibFree(NewSnapshot);
+            return;
+        }
+
+        NewSnapshot->NextRetired = NULL;
+        NewSnapshot->ReferenceCount = 1;
+        NewSnapshot->Count = 0;
+
+        StringOffset = 0;
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            memcpy(&NewSnapshot->Strings.StartOfString[StringOffset], HistoryEntry->CmdLine.StartOfString, HistoryEntry->CmdLine.LengthInChars * sizeof(TCHAR));
+            StringOffset += HistoryEntry->CmdLine.LengthInChars;
+            NewSnapshot->Strings.StartOfString[StringOffset] = '\0';
+            StringOffset++;
+            NewSnapshot->Count++;
+            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+        NewSnapshot->Strings.LengthInChars = StringOffset;
+    }
+
+    YoriShReplaceHistorySnapshot(NewSnapshot);
+}
+
+/**
+ Publish a snapshot of history after a single entry has been appended to the
+ history list, and zero or more of the oldest entries have been removed.
+ The new snapshot shares the buffer of the currently published snapshot and
+ the new entry is written beyond its end, so the cost of publishing does not
+ depend on the number of history entries.  When the buffer is exhausted, the
+ live entries are copied into a buffer twice their size.  If the published
+ snapshot does not correspond to the history list, a full copy is published
+ instead.  This is called from the input thread.
+
+ @param NewCmd Pointer to the entry that was appended.
+
+ @param EntriesRemoved The number of entries that were removed from the
+        start of the history list.
+ */
+VOID
+YoriShPublishAppendedHistorySnapshot(
+    __in PYORI_STRING NewCmd,
+    __in DWORD EntriesRemoved
+    )
+{
+    PYORI_SH_HISTORY_SNAPSHOT CurrentSnapshot;
+    PYORI_SH_HISTORY_SNAPSHOT NewSnapshot;
+    YORI_STRING NewBuffer;
+    LPTSTR StartOfString;
+    DWORD LengthInChars;
+    DWORD LengthAvailable;
+    DWORD EntryLength;
+    DWORD Count;
+
+    CurrentSnapshot = YoriShHistorySnapshot;
+    if (CurrentSnapshot == NULL ||
+        EntriesRemoved > CurrentSnapshot->Count ||
+        CurrentSnapshot->Count - EntriesRemoved + 1 != YoriShCommandHistoryCount) {
+
+        YoriShPublishHistorySnapshot();
+        return;
+    }
+
+    //
+    //  Skip over the entries that have been removed.
+    //
+
+    StartOfString = CurrentSnapshot->Strings.StartOfString;
+    LengthInChars = CurrentSnapshot->Strings.LengthInChars;
+    LengthAvailable = CurrentSnapshot->Strings.LengthAllocated;
+    for (Count = 0; Count < EntriesRemoved; Count++) {
+        EntryLength = (DWORD)_tcslen(StartOfString) + 1;
+        StartOfString += EntryLength;
+        LengthInChars -= EntryLength;
+        LengthAvailable -= EntryLength;
+    }
+
+    NewSnapshot = YoriLibMalloc(sizeof(YORI_SH_HISTORY_SNAPSHOT));
+    if (NewSnapshot == NULL) {
+        return;
+    }
+
+    NewSnapshot->NextRetired = NULL;
+    NewSnapshot->ReferenceCount = 1;
+    NewSnapshot->Count = CurrentSnapshot->Count - EntriesRemoved + 1;
+
+    if (LengthInChars + NewCmd->LengthInChars + 1 <= LengthAvailable) {
+        YoriLibInitEmptyString(&NewSnapshot->Strings);
+        YoriLibReference(CurrentSnapshot->Strings.MemoryToFree);
+        NewSnapshot->Strings.MemoryToFree = CurrentSnapshot->Strings.MemoryToFree;
+        NewSnapshot->Strings.StartOfString = StartOfString;
+        NewSnapshot->Strings.LengthAllocated = LengthAvailable;
+    } else {
+        if (!YoriLibAllocateString(&NewBuffer, (LengthInChars + NewCmd->LengthInChars + 1) * 2)) {
+            YoriLibFree(NewSnapshot);
+            return;
+        }
+        memcpy(NewBuffer.StartOfString, StartOfString, LengthInChars * sizeof(TCHAR));
+        memcpy(&NewSnapshot->Strings, &NewBuffer, sizeof(YORI_STRING));
+    }
+
+    memcpy(&NewSnapshot->Strings.StartOfString[LengthInChars], NewCmd->StartOfString, NewCmd->LengthInChars * sizeof(TCHAR));
+    NewSnapshot->Strings.StartOfString[LengthInChars + NewCmd->LengthInChars] = '\0';
+    NewSnapshot->Strings.LengthInChars = LengthInChars + NewCmd->LengthInChars + 1;
+
+    YoriShReplaceHistorySnapshot(NewSnapshot);
+}
+
+/**
+ Obtain a referenced pointer to the most recently published snapshot of
+ history.  This can be called from any thread and never waits.
+
+ @return Pointer to the snapshot, or NULL if there is no history.  The
+         caller should call @ref YoriShDereferenceHistorySnapshot when it is
+         no longer needed.
+ */
+PYORI_SH_HISTORY_SNAPSHOT
+YoriShAcquireHistorySnapshot()
+{
+    PYORI_SH_HISTORY_SNAPSHOT Snapshot;
+
+    InterlockedIncrement((PLONG)&YoriShHistorySnapshotReaders);
+    Snapshot = YoriShHistorySnapshot;
+    if (Snapshot != NULL) {
+        InterlockedIncrement((PLONG)&Snapshot->ReferenceCount);
+    }
+    InterlockedDecrement((PLONG)&YoriShHistorySnapshotReaders);
+
+    return Snapshot;
+}
+
+/**
+ Add an entered command into the command history list without publishing
+ the result to other threads.
 
  @param NewCmd Pointer to a Yori string corresponding to the new
         entry to add to history.
 
  @param IgnoreIfRepeat If TRUE, don't add a new line if the immediate
-        previous line is identical.  Note it must be exactly identical,
-        including case.  If FALSE, add the new entry regardless.
- 
+        previous line is identical.
+
  @return TRUE to indicate an entry was successfully added, FALSE if it was
          not.
  */
 __success(return)
 BOOL
-YoriShAddToHistory(
+YoriShAddToHistoryList(
     __in PYORI_STRING NewCmd,
     __in BOOLEAN IgnoreIfRepeat
     )
 {
-    DWORD LengthToAllocate;
     PYORI_SH_HISTORY_ENTRY NewHistoryEntry;
 
-    if (NewCmd->LengthInChars == 0) {
-        return TRUE;
+    if (YoriShGlobal.CommandHistory.Next == NULL) {
+        YoriLibInitializeListHead(&YoriShGlobal.CommandHistory);
+    }
+
+    if (IgnoreIfRepeat) {
+        PYORI_LIST_ENTRY ExistingEntry;
+        ExistingEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+        if (ExistingEntry != NULL) {
+            NewHistoryEntry = CONTAINING_RECORD(ExistingEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            if (YoriLibCompareString(&NewHistoryEntry->CmdLine, NewCmd) == 0) {
+                return FALSE;
+            }
+        }
     }
 
-    LengthToAllocate = sizeof(YORI_SH_HISTORY_ENTRY);
+    NewHistoryEntry = YoriLibMalloc(sizeof(YORI_SH_HISTORY_ENTRY));
+    if (NewHistoryEntry == NULL) {
+        return FALSE;
+    }
 
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
+    YoriLibCloneString(&NewHistoryEntry->CmdLine, NewCmd);
 
-        if (YoriShGlobal.CommandHistory.Next == NULL) {
-            YoriLibInitializeListHead(&YoriShGlobal.CommandHistory);
-        }
+    YoriLibAppendList(&YoriShGlobal.CommandHistory, &NewHistoryEntry->ListEntry);
+    YoriShCommandHistoryCount++;
+    while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
+        PYORI_LIST_ENTRY ListEntry;
+        PYORI_SH_HISTORY_ENTRY OldHistoryEntry;
 
-        if (IgnoreIfRepeat) {
-            PYORI_LIST_ENTRY ExistingEntry;
-            ExistingEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
-            if (ExistingEntry != NULL) {
-                NewHistoryEntry = CONTAINING_RECORD(ExistingEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-                if (YoriLibCompareString(&NewHistoryEntry->CmdLine, NewCmd) == 0) {
-                    ReleaseMutex(YoriShHistoryLock);
-                    return FALSE;
-                }
-            }
-        }
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
+        YoriLibFree(OldHistoryEntry);
+        YoriShCommandHistoryCount--;
+    }
 
-        NewHistoryEntry = YoriLibMalloc(LengthToAllocate);
-        if (NewHistoryEntry == NULL) {
-            ReleaseMutex(YoriShHistoryLock);
-            return FALSE;
-        }
+    return TRUE;
+}
 
-        YoriLibCloneString(&NewHistoryEntry->CmdLine, NewCmd);
+/**
+ Add an entered command into the command history buffer.
 
-        YoriLibAppendList(&YoriShGlobal.CommandHistory, &NewHistoryEntry->ListEntry);
-        YoriShCommandHistoryCount++;
-        while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
-            PYORI_LIST_ENTRY ListEntry;
-            PYORI_SH_HISTORY_ENTRY OldHistoryEntry;
+ @param NewCmd Pointer to a Yori string corresponding to the new
+        entry to add to history.
 
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
-            OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            YoriLibRemoveListItem(ListEntry);
-            YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
-            YoriLibFree(OldHistoryEntry);
-            YoriShCommandHistoryCount--;
-        }
-        ReleaseMutex(YoriShHistoryLock);
+ @param IgnoreIfRepeat If TRUE, don't add a new line if the immediate
+        previous line is identical.  Note it must be exactly identical,
+        including case.  If FALSE, add the new entry regardless.
+ 
+ @return TRUE to indicate an entry was successfully added, FALSE if it was
+         not.
+ */
+__success(return)
+BOOL
+YoriShAddToHistory(
+    __in PYORI_STRING NewCmd,
+    __in BOOLEAN IgnoreIfRepeat
+    )
+{
+    DWORD PreviousCount;
+
+    if (NewCmd->LengthInChars == 0) {
+        return TRUE;
     }
 
+    PreviousCount = YoriShCommandHistoryCount;
+    if (!YoriShAddToHistoryList(NewCmd, IgnoreIfRepeat)) {
+        return FALSE;
+    }
+
+    YoriShPublishAppendedHistorySnapshot(NewCmd, PreviousCount + 1 - YoriShCommandHistoryCount);
     return TRUE;
 }
 
@@ -132,13 +439,11 @@ YoriShRemoveOneHistoryEntry(
     __in PYORI_SH_HISTORY_ENTRY HistoryEntry
     )
 {
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        YoriLibRemoveListItem(&HistoryEntry->ListEntry);
-        YoriLibFreeStringContents(&HistoryEntry->CmdLine);
-        YoriLibFree(HistoryEntry);
-        YoriShCommandHistoryCount--;
-        ReleaseMutex(YoriShHistoryLock);
-    }
+    YoriLibRemoveListItem(&HistoryEntry->ListEntry);
+    YoriLibFreeStringContents(&HistoryEntry->CmdLine);
+    YoriLibFree(HistoryEntry);
+    YoriShCommandHistoryCount--;
+    YoriShPublishHistorySnapshot();
 }
 
 /**
@@ -150,7 +455,7 @@ YoriShClearAllHistory()
     PYORI_LIST_ENTRY ListEntry = NULL;
     PYORI_SH_HISTORY_ENTRY HistoryEntry;
 
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
+    if (YoriShGlobal.CommandHistory.Next != NULL) {
         ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
         while (ListEntry != NULL) {
             HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
@@ -160,8 +465,21 @@ YoriShClearAllHistory()
             YoriLibFree(HistoryEntry);
             YoriShCommandHistoryCount--;
         }
-        ReleaseMutex(YoriShHistoryLock);
     }
+
+    YoriShPublishHistorySnapshot();
+}
+
+/**
+ Free all command history and any snapshots of it when the shell is
+ terminating.  Any snapshot still referenced by another thread remains
+ valid until that thread releases it.
+ */
+VOID
+YoriShCleanupHistory()
+{
+    YoriShClearAllHistory();
+    YoriShReleaseRetiredHistorySnapshots(TRUE);
 }
 
 /**
@@ -180,14 +498,6 @@ YoriShInitHistory()
         return FALSE;
     }
 
-    if (YoriShHistoryLock == NULL) {
-        YoriShHistoryLock = CreateMutex(NULL, FALSE, NULL);
-    }
-
-    if (YoriShHistoryLock == NULL) {
-        return FALSE;
-    }
-
     //
     //  Default the history buffer size to something sane.
     //
@@ -312,9 +622,11 @@ YoriShLoadHistoryFromFile()
         //  If we fail to add to history, stop.  If it is added to history,
         //  that string is now owned by the history buffer, so reinitialize
         //  between lines.  The free below is really just a dereference.
+        //  The result is published once after all lines are loaded.
         //
 
-        if (!YoriShAddToHistory(&LineString, FALSE)) {
+        if (LineString.LengthInChars > 0 &&
+            !YoriShAddToHistoryList(&LineString, FALSE)) {
             break;
         }
 
@@ -325,6 +637,7 @@ YoriShLoadHistoryFromFile()
     YoriLibLineReadClose(LineContext);
     YoriLibFreeStringContents(&LineString);
     CloseHandle(FileHandle);
+    YoriShPublishHistorySnapshot();
     return TRUE;
 }
 
@@ -342,8 +655,9 @@ YoriShSaveHistoryToFile()
     YORI_STRING UserHistFileName;
     YORI_STRING FilePath;
     HANDLE FileHandle;
-    PYORI_LIST_ENTRY ListEntry;
-    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    PYORI_SH_HISTORY_SNAPSHOT Snapshot;
+    LPTSTR ThisEntry;
+    DWORD Index;
 
     FileNameLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
     if (FileNameLength == 0) {
@@ -368,6 +682,14 @@ YoriShSaveHistoryToFile()
 
     YoriLibFreeStringContents(&UserHistFileName);
 
+    //
+    //  This can be called from a console control handler thread while the
+    //  input thread is active, so use the published snapshot rather than
+    //  the history list.
+    //
+
+    Snapshot = YoriShAcquireHistorySnapshot();
+
     FileHandle = CreateFile(FilePath.StartOfString,
                             GENERIC_WRITE,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -382,25 +704,25 @@ YoriShSaveHistoryToFile()
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: open of %y failed: %s"), &FilePath, ErrText);
         YoriLibFreeWinErrorText(ErrText);
         YoriLibFreeStringContents(&FilePath);
+        if (Snapshot != NULL) {
+            YoriShDereferenceHistorySnapshot(Snapshot);
+        }
         return FALSE;
     }
 
     YoriLibFreeStringContents(&FilePath);
 
     //
-    //  Search the list of history.
+    //  Write each entry in the snapshot.
     //
 
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
-        while (ListEntry != NULL) {
-            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-
-            YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &HistoryEntry->CmdLine);
-
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+    if (Snapshot != NULL) {
+        ThisEntry = Snapshot->Strings.StartOfString;
+        for (Index = 0; Index < Snapshot->Count; Index++) {
+            YoriLibOutputToDevice(FileHandle, 0, _T("%s\n"), ThisEntry);
+            ThisEntry += _tcslen(ThisEntry) + 1;
         }
-        ReleaseMutex(YoriShHistoryLock);
+        YoriShDereferenceHistorySnapshot(Snapshot);
     }
 
     CloseHandle(FileHandle);
@@ -428,30 +750,32 @@ YoriShGetHistoryStrings(
     __inout PYORI_STRING HistoryStrings
     )
 {
-    DWORD CharsNeeded = 0;
+    DWORD CharsNeeded;
     DWORD StringOffset;
-    PYORI_LIST_ENTRY ListEntry = NULL;
-    PYORI_SH_HISTORY_ENTRY HistoryEntry;
-    PYORI_LIST_ENTRY StartReturningFrom = NULL;
+    DWORD EntriesToSkip;
+    LPTSTR StartReturningFrom;
+    PYORI_SH_HISTORY_SNAPSHOT Snapshot;
 
-    if (YoriShGlobal.CommandHistory.Next != NULL) {
-        DWORD EntriesToSkip = 0;
-        if (YoriShCommandHistoryCount > MaximumNumber && MaximumNumber > 0) {
-            EntriesToSkip = YoriShCommandHistoryCount - MaximumNumber;
+    //
+    //  This is called from the restart save thread, so it operates on the
+    //  published snapshot rather than the history list.
+    //
+
+    Snapshot = YoriShAcquireHistorySnapshot();
+
+    CharsNeeded = 0;
+    StartReturningFrom = NULL;
+    if (Snapshot != NULL) {
+        StartReturningFrom = Snapshot->Strings.StartOfString;
+        if (Snapshot->Count > MaximumNumber && MaximumNumber > 0) {
+            EntriesToSkip = Snapshot->Count - MaximumNumber;
             while (EntriesToSkip > 0) {
-                ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+                StartReturningFrom += _tcslen(StartReturningFrom) + 1;
                 EntriesToSkip--;
             }
-
-            StartReturningFrom = ListEntry;
         }
 
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, StartReturningFrom);
-        while (ListEntry != NULL) {
-            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            CharsNeeded += HistoryEntry->CmdLine.LengthInChars + 1;
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
-        }
+        CharsNeeded = Snapshot->Strings.LengthInChars - (DWORD)(StartReturningFrom - Snapshot->Strings.StartOfString);
     }
 
     CharsNeeded += 1;
@@ -459,22 +783,19 @@ YoriShGetHistoryStrings(
     if (HistoryStrings->LengthAllocated < CharsNeeded) {
         YoriLibFreeStringContents(HistoryStrings);
         if (!YoriLibAllocateString(HistoryStrings, CharsNeeded)) {
+            if (Snapshot != NULL) {
+                YoriShDereferenceHistorySnapshot(Snapshot);
+            }
             return FALSE;
         }
     }
 
     StringOffset = 0;
 
-    if (YoriShGlobal.CommandHistory.Next != NULL) {
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, StartReturningFrom);
-        while (ListEntry != NULL) {
-            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            memcpy(&HistoryStrings->StartOfString[StringOffset], HistoryEntry->CmdLine.StartOfString, HistoryEntry->CmdLine.LengthInChars * sizeof(TCHAR));
-            StringOffset += HistoryEntry->CmdLine.LengthInChars;
-            HistoryStrings->StartOfString[StringOffset] = '\0';
-            StringOffset++;
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
-        }
+    if (Snapshot != NULL) {
+        StringOffset = CharsNeeded - 1;
+        memcpy(HistoryStrings->StartOfString, StartReturningFrom, StringOffset * sizeof(TCHAR));
+        YoriShDereferenceHistorySnapshot(Snapshot);
     }
     HistoryStrings->StartOfString[StringOffset] = '\0';
     HistoryStrings->LengthInChars = StringOffset;
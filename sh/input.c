@@ -338,7 +338,10 @@ YoriShDisplayAfterKeyPress(
     DWORD NumberWritten;
     DWORD NumberToWrite = 0;
     DWORD NumberToFill = 0;
+    DWORD HeadToWrite = 0;
+    DWORD TailOffset = 0;
     COORD WritePosition;
+    COORD TailWritePosition;
     COORD FillPosition;
     COORD SuggestionPosition;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
@@ -384,6 +387,8 @@ YoriShDisplayAfterKeyPress(
     SuggestionPosition.Y = 0;
     FillPosition.X = 0;
     FillPosition.Y = 0;
+    TailWritePosition.X = 0;
+    TailWritePosition.Y = 0;
 
     //
     //  Re-render the text if part of the input string has changed,
@@ -441,6 +446,29 @@ YoriShDisplayAfterKeyPress(
             if (!YoriShDetermineCellLocationIfMovedCacheResult(Buffer, &ScreenInfo, (-1 * Buffer->PreviousCurrentOffset) + Buffer->DirtyBeginOffset, &WritePosition)) {
                 return FALSE;
             }
+
+            //
+            //  If the buffer has unused space within the range to write,
+            //  the text is written as the part before the unused space
+            //  followed by the part after it.
+            //
+
+            if (Buffer->GapLength == 0 ||
+                Buffer->DirtyBeginOffset + NumberToWrite <= Buffer->GapOffset) {
+
+                HeadToWrite = NumberToWrite;
+            } else if (Buffer->DirtyBeginOffset >= Buffer->GapOffset) {
+                HeadToWrite = 0;
+                TailOffset = Buffer->DirtyBeginOffset + Buffer->GapLength;
+                TailWritePosition.X = WritePosition.X;
+                TailWritePosition.Y = WritePosition.Y;
+            } else {
+                HeadToWrite = Buffer->GapOffset - Buffer->DirtyBeginOffset;
+                TailOffset = Buffer->GapOffset + Buffer->GapLength;
+                if (!YoriShDetermineCellLocationIfMovedCacheResult(Buffer, &ScreenInfo, (-1 * Buffer->PreviousCurrentOffset) + Buffer->GapOffset, &TailWritePosition)) {
+                    return FALSE;
+                }
+            }
         }
 
 
@@ -467,7 +495,12 @@ YoriShDisplayAfterKeyPress(
             }
 
             if (NumberToWrite) {
-                WriteConsoleOutputCharacter(hConsole, &Buffer->String.StartOfString[Buffer->DirtyBeginOffset], NumberToWrite, WritePosition, &NumberWritten);
+                if (HeadToWrite > 0) {
+                    WriteConsoleOutputCharacter(hConsole, &Buffer->String.StartOfString[Buffer->DirtyBeginOffset], HeadToWrite, WritePosition, &NumberWritten);
+                }
+                if (NumberToWrite > HeadToWrite) {
+                    WriteConsoleOutputCharacter(hConsole, &Buffer->String.StartOfString[TailOffset], NumberToWrite - HeadToWrite, TailWritePosition, &NumberWritten);
+                }
                 FillConsoleOutputAttribute(hConsole, ScreenInfo.wAttributes, NumberToWrite, WritePosition, &NumberWritten);
             }
 
@@ -526,6 +559,104 @@ YoriShEnsureStringHasEnoughCharacters(
     return TRUE;
 }
 
+/**
+ Remove any unused space from the middle of the input buffer so that the
+ text is contiguous and can be used as a regular string.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShCloseInputGap(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    if (Buffer->GapLength == 0) {
+        return;
+    }
+
+    if (Buffer->String.LengthInChars > Buffer->GapOffset) {
+        memmove(&Buffer->String.StartOfString[Buffer->GapOffset],
+                &Buffer->String.StartOfString[Buffer->GapOffset + Buffer->GapLength],
+                (Buffer->String.LengthInChars - Buffer->GapOffset) * sizeof(TCHAR));
+    }
+
+    Buffer->GapLength = 0;
+}
+
+/**
+ Move the unused space within the input buffer to a specified offset,
+ ensuring that it is large enough to insert a specified number of
+ characters.  Moving the space only moves the text between its old and new
+ locations, so repeated edits around the cursor do not move the rest of
+ the string.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param Offset The offset within the text to place the unused space.
+
+ @param CharactersNeeded The number of characters which the caller will
+        insert at Offset.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriShMoveInputGap(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in DWORD Offset,
+    __in DWORD CharactersNeeded
+    )
+{
+    DWORD NewLength;
+
+    ASSERT(Offset <= Buffer->String.LengthInChars);
+
+    //
+    //  If the text is contiguous, all of the space after it is available.
+    //
+
+    if (Buffer->GapLength == 0) {
+        Buffer->GapOffset = Buffer->String.LengthInChars;
+        if (Buffer->String.LengthAllocated > Buffer->String.LengthInChars) {
+            Buffer->GapLength = Buffer->String.LengthAllocated - Buffer->String.LengthInChars - 1;
+        }
+    }
+
+    //
+    //  If there isn't enough space, make the text contiguous and double the
+    //  allocation until there is.
+    //
+
+    if (Buffer->GapLength < CharactersNeeded) {
+        YoriShCloseInputGap(Buffer);
+        NewLength = Buffer->String.LengthAllocated;
+        if (NewLength < 256) {
+            NewLength = 256;
+        }
+        while (NewLength <= Buffer->String.LengthInChars + CharactersNeeded + 1) {
+            NewLength = NewLength * 2;
+        }
+        if (!YoriLibReallocateString(&Buffer->String, NewLength)) {
+            return FALSE;
+        }
+        Buffer->GapOffset = Buffer->String.LengthInChars;
+        Buffer->GapLength = Buffer->String.LengthAllocated - Buffer->String.LengthInChars - 1;
+    }
+
+    if (Offset < Buffer->GapOffset) {
+        memmove(&Buffer->String.StartOfString[Offset + Buffer->GapLength],
+                &Buffer->String.StartOfString[Offset],
+                (Buffer->GapOffset - Offset) * sizeof(TCHAR));
+    } else if (Offset > Buffer->GapOffset) {
+        memmove(&Buffer->String.StartOfString[Buffer->GapOffset],
+                &Buffer->String.StartOfString[Buffer->GapOffset + Buffer->GapLength],
+                (Offset - Buffer->GapOffset) * sizeof(TCHAR));
+    }
+
+    Buffer->GapOffset = Offset;
+    return TRUE;
+}
+
 /**
  When YORIQUICKEDIT is set, disable the console's QuickEdit capabilities and
  allow Yori to process mouse input so it can use its internal QuickEdit
@@ -644,6 +775,7 @@ YoriShTerminateInput(
     YoriShDisplayAfterKeyPress(Buffer);
     YoriShPostKeyPress(Buffer);
     YoriShClearTabCompletionMatches(Buffer);
+    YoriShCloseInputGap(Buffer);
     YoriLibCleanupSelection(&Buffer->Selection);
     YoriLibCleanupSelection(&Buffer->Mouseover);
     if (Buffer->String.StartOfString != NULL) {
@@ -709,6 +841,7 @@ YoriShClearInput(
     YoriLibFreeStringContents(&Buffer->SearchString);
     YoriShClearTabCompletionMatches(Buffer);
     Buffer->String.LengthInChars = 0;
+    Buffer->GapLength = 0;
     Buffer->CurrentOffset = 0;
     Buffer->SearchMode = FALSE;
     YoriShClearInputSelections(Buffer);
@@ -733,6 +866,7 @@ YoriShUpdateSelectionWithSearchResult(
     //  than a rectangle
     //
 
+    YoriShCloseInputGap(Buffer);
     if (YoriLibFindFirstMatchingSubstringInsensitive(&Buffer->String, 1, &Buffer->SearchString, &StringOffsetOfMatch)) {
         Buffer->CurrentOffset = StringOffsetOfMatch + Buffer->SearchString.LengthInChars;
     } else {
@@ -777,6 +911,7 @@ YoriShCompletionListAllMatches(
     }
     YoriLibFreeStringContents(&Buffer->SuggestionString);
     YoriShDisplayAfterKeyPress(Buffer);
+    YoriShCloseInputGap(Buffer);
     Buffer->String.StartOfString[Buffer->String.LengthInChars] = '\0';
     YoriShMoveCursor(Buffer, Buffer->String.LengthInChars - Buffer->CurrentOffset);
     YoriShConfigureMouseForPrograms(Buffer->ConsoleInputHandle);
@@ -893,11 +1028,16 @@ YoriShBackspace(
         CountToUse = Buffer->CurrentOffset;
     }
 
-    if (Buffer->CurrentOffset != Buffer->String.LengthInChars) {
-        memmove(&Buffer->String.StartOfString[Buffer->CurrentOffset - CountToUse],
-                &Buffer->String.StartOfString[Buffer->CurrentOffset],
-                (Buffer->String.LengthInChars - Buffer->CurrentOffset) * sizeof(TCHAR));
+    //
+    //  Characters before the cursor are removed by extending the unused
+    //  space in the buffer, so the text after the cursor does not move.
+    //
+
+    if (!YoriShMoveInputGap(Buffer, Buffer->CurrentOffset, 0)) {
+        return;
     }
+    Buffer->GapOffset -= CountToUse;
+    Buffer->GapLength += CountToUse;
 
     if (Buffer->DirtyLength == 0) {
         Buffer->DirtyBeginOffset = Buffer->CurrentOffset - CountToUse;
@@ -1049,29 +1189,33 @@ YoriShAddYoriStringToInput(
         YoriShUpdateSelectionWithSearchResult(Buffer);
 
     } else if (Buffer->InsertMode) {
-        if (!YoriShEnsureStringHasEnoughCharacters(&Buffer->String, Buffer->String.LengthInChars + String->LengthInChars)) {
+
+        //
+        //  Move the unused space to the cursor so the new text can be
+        //  copied into it without moving the text that follows.
+        //
+
+        if (!YoriShMoveInputGap(Buffer, Buffer->CurrentOffset, String->LengthInChars)) {
             return;
         }
 
         //
-        //  Trim any trailing spaces if we're "inserting" before them.
+        //  Trim any trailing spaces if we're "inserting" before them.  These
+        //  follow the cursor, so they are after the unused space.
         //
 
         while (Buffer->String.LengthInChars > 0 &&
                Buffer->String.LengthInChars != Buffer->CurrentOffset) {
-            if (Buffer->String.StartOfString[Buffer->String.LengthInChars - 1] == ' ') {
+            if (Buffer->String.StartOfString[Buffer->String.LengthInChars + Buffer->GapLength - 1] == ' ') {
                 Buffer->String.LengthInChars--;
             } else {
                 break;
             }
         }
-        if (Buffer->String.LengthInChars != Buffer->CurrentOffset) {
-            memmove(&Buffer->String.StartOfString[Buffer->CurrentOffset + String->LengthInChars],
-                    &Buffer->String.StartOfString[Buffer->CurrentOffset],
-                    (Buffer->String.LengthInChars - Buffer->CurrentOffset) * sizeof(TCHAR));
-        }
+        memcpy(&Buffer->String.StartOfString[Buffer->GapOffset], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+        Buffer->GapOffset += String->LengthInChars;
+        Buffer->GapLength -= String->LengthInChars;
         Buffer->String.LengthInChars += String->LengthInChars;
-        memcpy(&Buffer->String.StartOfString[Buffer->CurrentOffset], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
 
         if (Buffer->DirtyLength == 0) {
             Buffer->DirtyBeginOffset = Buffer->CurrentOffset;
@@ -1087,6 +1231,7 @@ YoriShAddYoriStringToInput(
         }
         Buffer->CurrentOffset += String->LengthInChars;
     } else {
+        YoriShCloseInputGap(Buffer);
         if (!YoriShEnsureStringHasEnoughCharacters(&Buffer->String, Buffer->CurrentOffset + String->LengthInChars)) {
             return;
         }
@@ -1152,6 +1297,7 @@ YoriShMoveCursorToPriorArgument(
     DWORD BeginCurrentArg = 0;
     DWORD EndCurrentArg = 0;
 
+    YoriShCloseInputGap(Buffer);
     if (!YoriShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
@@ -1228,6 +1374,7 @@ YoriShMoveCursorToNextArgument(
     DWORD EndCurrentArg;
     BOOL MoveToEnd = FALSE;
 
+    YoriShCloseInputGap(Buffer);
     if (!YoriShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
@@ -1282,6 +1429,7 @@ YoriShDeleteArgument(
     DWORD BeginCurrentArg;
     DWORD EndCurrentArg;
 
+    YoriShCloseInputGap(Buffer);
     if (!YoriShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
@@ -2703,6 +2851,96 @@ YoriShProcessMouseScroll(
     return FALSE;
 }
 
+/**
+ Determine whether a console input event is a key press which inserts a
+ character into the input buffer without any other processing.  Pasting
+ text into the console generates long runs of these, which can be added to
+ the input buffer together.
+
+ @param InputRecord Pointer to the console input event.
+
+ @return TRUE if the event only inserts a character, FALSE if it requires
+         processing by @ref YoriShProcessKeyDown or another handler.
+ */
+BOOL
+YoriShIsSimpleCharacterKeyDown(
+    __in PINPUT_RECORD InputRecord
+    )
+{
+    DWORD CtrlMask;
+    TCHAR Char;
+    WORD KeyCode;
+
+    if (InputRecord->EventType != KEY_EVENT ||
+        !InputRecord->Event.KeyEvent.bKeyDown) {
+
+        return FALSE;
+    }
+
+    Char = InputRecord->Event.KeyEvent.uChar.UnicodeChar;
+    CtrlMask = InputRecord->Event.KeyEvent.dwControlKeyState & (RIGHT_ALT_PRESSED | LEFT_ALT_PRESSED | RIGHT_CTRL_PRESSED | LEFT_CTRL_PRESSED | ENHANCED_KEY | SHIFT_PRESSED);
+    KeyCode = InputRecord->Event.KeyEvent.wVirtualKeyCode;
+
+    if (KeyCode >= VK_F1 && KeyCode <= VK_F12) {
+        return FALSE;
+    }
+
+    if (Char == '\r' || Char == 27 || Char == '\t' || Char == '\b' || Char == '\0') {
+        return FALSE;
+    }
+
+    //
+    //  This must match the set of modifiers that YoriShProcessKeyDown
+    //  treats as entering characters.
+    //
+
+    if (CtrlMask == 0 ||
+        CtrlMask == SHIFT_PRESSED ||
+        CtrlMask == (LEFT_CTRL_PRESSED | LEFT_ALT_PRESSED) ||
+        CtrlMask == (LEFT_CTRL_PRESSED | LEFT_ALT_PRESSED | SHIFT_PRESSED) ||
+        CtrlMask == (LEFT_CTRL_PRESSED | RIGHT_ALT_PRESSED) ||
+        CtrlMask == (LEFT_CTRL_PRESSED | RIGHT_ALT_PRESSED | SHIFT_PRESSED) ||
+        CtrlMask == RIGHT_ALT_PRESSED ||
+        CtrlMask == (RIGHT_ALT_PRESSED | SHIFT_PRESSED)) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Insert characters collected from a run of simple key presses into the
+ input buffer as a single operation.  This performs the same processing as
+ a single key press, so moving later text, trimming suggestions and
+ clearing selections happens once for the run rather than once per
+ character.
+
+ @param Buffer Pointer to the input buffer to update.
+
+ @param PendingChars Pointer to the characters to insert.  On return this
+        is emptied so that more characters can be collected.
+
+ @return TRUE to indicate the input buffer has changed and needs to be
+         redisplayed.
+ */
+BOOL
+YoriShAddPendingCharsToInput(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __inout PYORI_STRING PendingChars
+    )
+{
+    if (PendingChars->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriShPrepareForNextKey(Buffer);
+    YoriShAddYoriStringToInput(Buffer, PendingChars);
+    YoriShClearInputSelections(Buffer);
+    YoriShPostKeyPress(Buffer);
+    PendingChars->LengthInChars = 0;
+    return TRUE;
+}
 
 /**
  Get a new expression from the user through the console.
@@ -2729,8 +2967,12 @@ YoriShGetExpressionFromConsole(
 
     DWORD ActuallyRead = 0;
     DWORD CurrentRecordIndex = 0;
+    DWORD EventsPending;
+    DWORD Count;
     DWORD err;
-    INPUT_RECORD InputRecords[20];
+    INPUT_RECORD InputRecords[64];
+    TCHAR PendingCharBuffer[256];
+    YORI_STRING PendingChars;
     PINPUT_RECORD InputRecord;
     BOOL ReDisplayRequired;
     BOOL TerminateInput;
@@ -2745,6 +2987,11 @@ YoriShGetExpressionFromConsole(
     Buffer.ConsoleInputHandle = InputHandle;
     Buffer.ConsoleOutputHandle = OutputHandle;
 
+    YoriLibInitEmptyString(&PendingChars);
+    PendingChars.StartOfString = PendingCharBuffer;
+    PendingChars.LengthAllocated = sizeof(PendingCharBuffer)/sizeof(PendingCharBuffer[0]);
+    ReDisplayRequired = FALSE;
+
     if (!GetConsoleScreenBufferInfo(Buffer.ConsoleOutputHandle, &ScreenInfo)) {
         return FALSE;
     }
@@ -2771,13 +3018,30 @@ YoriShGetExpressionFromConsole(
             break;
         }
 
-        ReDisplayRequired = FALSE;
-
         for (CurrentRecordIndex = 0; CurrentRecordIndex < ActuallyRead; CurrentRecordIndex++) {
 
             InputRecord = &InputRecords[CurrentRecordIndex];
             TerminateInput = FALSE;
 
+            //
+            //  Collect runs of characters so they can be inserted together.
+            //  Anything else flushes the collected characters first so that
+            //  events are still applied in order.
+            //
+
+            if (YoriShIsSimpleCharacterKeyDown(InputRecord)) {
+                for (Count = 0; Count < InputRecord->Event.KeyEvent.wRepeatCount; Count++) {
+                    if (PendingChars.LengthInChars == PendingChars.LengthAllocated) {
+                        ReDisplayRequired |= YoriShAddPendingCharsToInput(&Buffer, &PendingChars);
+                    }
+                    PendingChars.StartOfString[PendingChars.LengthInChars] = InputRecord->Event.KeyEvent.uChar.UnicodeChar;
+                    PendingChars.LengthInChars++;
+                }
+                continue;
+            }
+
+            ReDisplayRequired |= YoriShAddPendingCharsToInput(&Buffer, &PendingChars);
+
             if (InputRecord->EventType == KEY_EVENT) {
 
                 if (InputRecord->Event.KeyEvent.bKeyDown) {
@@ -2843,9 +3107,7 @@ YoriShGetExpressionFromConsole(
             }
         }
 
-        if (ReDisplayRequired) {
-            YoriShDisplayAfterKeyPress(&Buffer);
-        }
+        ReDisplayRequired |= YoriShAddPendingCharsToInput(&Buffer, &PendingChars);
 
         //
         //  If we processed any events, remove them from the queue.
@@ -2857,6 +3119,24 @@ YoriShGetExpressionFromConsole(
             }
         }
 
+        //
+        //  If more events are already waiting, such as the remainder of a
+        //  paste, process them before redisplaying.  The buffer tracks the
+        //  range that has changed, so the display is updated once when the
+        //  queue is drained rather than once per batch of events, and the
+        //  cost of redrawing no longer grows with the length of the paste
+        //  multiplied by the length of the line.
+        //
+
+        if (GetNumberOfConsoleInputEvents(InputHandle, &EventsPending) && EventsPending > 0) {
+            continue;
+        }
+
+        if (ReDisplayRequired) {
+            YoriShDisplayAfterKeyPress(&Buffer);
+            ReDisplayRequired = FALSE;
+        }
+
         //
         //  Wait to see if any further events arrive.  If we haven't saved
         //  state and the user hasn't done anything for 30 seconds, save
@@ -2991,5 +3271,42 @@ YoriShCleanupInputContext()
     }
 }
 
+/**
+ Prepare the console for entry of the next command.
+
+ @param EnableVt If TRUE, VT processing should be enabled if the console
+        supports it.  In general Yori leaves this enabled for the benefit of
+        child processes, but it is disabled when displaying the prompt.  The
+        prompt is written by the shell process, and depends on moving the
+        cursor to the next line after the final cell in a line is written,
+        which is not the behavior that Windows VT support provides.  Note
+        this behavior isn't a problem for programs that continue to output -
+        it's a problem for programs that output and then wait for input.
+ */
+VOID
+YoriShPreCommand(
+    __in BOOLEAN EnableVt
+    )
+{
+    HANDLE ConsoleHandle;
+
+    YoriShCleanupRestartSaveThreadIfCompleted();
+    YoriLibCancelEnable();
+    YoriLibCancelIgnore();
+    YoriLibCancelReset();
+
+    //
+    //  Old versions will fail and ignore any call that contains a flag
+    //  they don't understand, so attempt a lowest common denominator
+    //  setting and try to upgrade it, which might fail.
+    //
+
+    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    SetConsoleMode(ConsoleHandle, ENABLE_PROCESSED_OUTPUT | ENABLE_WRAP_AT_EOL_OUTPUT);
+    if (EnableVt) {
+        SetConsoleMode(ConsoleHandle, ENABLE_PROCESSED_OUTPUT | ENABLE_WRAP_AT_EOL_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+}
+
 
 // vim:sw=4:ts=4:et:
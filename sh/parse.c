@@ -178,11 +178,10 @@ YoriShTrimSpacesAndAtsFromBeginning(
 
 
 /**
- Parse a single command string into a series of arguments.  This routine takes
- care of splitting things based on the presence or absence of quotes, as well
- as performing environment variable expansion.  The resulting string has no
- knowledge of redirects, pipes, or multi program execution - it is just a
- series of arguments.
+ Split a single command string into a series of arguments based on the
+ presence or absence of quotes.  This routine does not perform environment
+ variable expansion, so its result depends only on the command string and
+ can be reused each time the same string is encountered.
 
  @param CmdLine The string to parse into arguments.
 
@@ -197,7 +196,7 @@ YoriShTrimSpacesAndAtsFromBeginning(
  */
 __success(return)
 BOOL
-YoriShParseCmdlineToCmdContext(
+YoriShTokenizeCmdlineToCmdContext(
     __in PYORI_STRING CmdLine,
     __in DWORD CurrentOffset,
     __out PYORI_SH_CMD_CONTEXT CmdContext
@@ -667,9 +666,24 @@ YoriShParseCmdlineToCmdContext(
         CmdContext->ArgV[ArgCount].LengthAllocated = CmdContext->ArgV[ArgCount].LengthInChars + 1;
     }
 
-    //
-    //  Expand any environment variables in any of the arguments.
-    //
+    return TRUE;
+}
+
+/**
+ Expand any environment variables in any of the arguments of a command
+ context which has been tokenized by
+ @ref YoriShTokenizeCmdlineToCmdContext .  Arguments which change are
+ replaced with newly allocated strings.
+
+ @param CmdContext Pointer to the command context to expand variables in.
+ */
+VOID
+YoriShExpandCmdContextVariables(
+    __inout PYORI_SH_CMD_CONTEXT CmdContext
+    )
+{
+    DWORD ArgCount;
+    DWORD ArgOffset;
 
     for (ArgCount = 0; ArgCount < CmdContext->ArgC; ArgCount++) {
         YORI_STRING EnvExpandedString;
@@ -691,6 +705,404 @@ YoriShParseCmdlineToCmdContext(
             }
         }
     }
+}
+
+/**
+ The maximum number of tokenized command strings to retain for reuse.
+ */
+#define YORI_SH_PARSE_CACHE_MAX_ENTRIES (16)
+
+/**
+ The maximum number of resolved executables to retain for reuse.
+ */
+#define YORI_SH_RESOLVE_CACHE_MAX_ENTRIES (16)
+
+/**
+ A single command string which has previously been tokenized.
+ */
+typedef struct _YORI_SH_PARSE_CACHE_ENTRY {
+
+    /**
+     The links of this entry within the cache.  The most recently used
+     entry is at the head of the list.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The command string which was tokenized.  This is the key used to
+     find the entry.
+     */
+    YORI_STRING CmdLine;
+
+    /**
+     The tokenized form of the command string, before any environment
+     variable expansion.
+     */
+    YORI_SH_CMD_CONTEXT CmdContext;
+} YORI_SH_PARSE_CACHE_ENTRY, *PYORI_SH_PARSE_CACHE_ENTRY;
+
+/**
+ A directory which was searched when resolving a command, along with its
+ last write time at the time of the search.
+ */
+typedef struct _YORI_SH_RESOLVE_CACHE_DIRECTORY {
+
+    /**
+     The fully qualified path to the directory.
+     */
+    YORI_STRING Path;
+
+    /**
+     The last write time of the directory when the command was resolved.
+     */
+    LARGE_INTEGER WriteTime;
+} YORI_SH_RESOLVE_CACHE_DIRECTORY, *PYORI_SH_RESOLVE_CACHE_DIRECTORY;
+
+/**
+ A single command name which has previously been resolved to an executable
+ by searching the path.
+ */
+typedef struct _YORI_SH_RESOLVE_CACHE_ENTRY {
+
+    /**
+     The links of this entry within the cache.  The most recently used
+     entry is at the head of the list.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The generation of the environment when the command was resolved.  Any
+     change to the environment, including PATH or PATHEXT, invalidates the
+     entry.
+     */
+    DWORD EnvironmentGeneration;
+
+    /**
+     The command name as specified by the user, after alias expansion.
+     */
+    YORI_STRING Command;
+
+    /**
+     The current directory when the command was resolved.
+     */
+    YORI_STRING CurrentDirectory;
+
+    /**
+     The fully qualified executable that the command resolved to.
+     */
+    YORI_STRING FoundExecutable;
+
+    /**
+     The number of elements in the Directories array.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     An array of directories that were searched in order to find the
+     executable, starting with the current directory and ending with the
+     directory containing the executable.  A file created in any of these
+     may change the result of the search, which is detected by a change to
+     the directory's last write time.
+     */
+    PYORI_SH_RESOLVE_CACHE_DIRECTORY Directories;
+} YORI_SH_RESOLVE_CACHE_ENTRY, *PYORI_SH_RESOLVE_CACHE_ENTRY;
+
+/**
+ A list of recently tokenized command strings.
+ */
+YORI_LIST_ENTRY YoriShParseCacheList;
+
+/**
+ The number of entries in YoriShParseCacheList.
+ */
+DWORD YoriShParseCacheCount;
+
+/**
+ A list of recently resolved executables.
+ */
+YORI_LIST_ENTRY YoriShResolveCacheList;
+
+/**
+ The number of entries in YoriShResolveCacheList.
+ */
+DWORD YoriShResolveCacheCount;
+
+/**
+ Copy a tokenized command context into a single new allocation, so that the
+ copy shares nothing with the source and can be modified or freed
+ independently.
+
+ @param DestCmdContext Pointer to the command context to populate.
+
+ @param SrcCmdContext Pointer to the command context to copy.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriShCloneTokenizedCmdContext(
+    __out PYORI_SH_CMD_CONTEXT DestCmdContext,
+    __in PYORI_SH_CMD_CONTEXT SrcCmdContext
+    )
+{
+    DWORD Count;
+    DWORD CharsNeeded;
+    LPTSTR OutputString;
+
+    DestCmdContext->ArgC = SrcCmdContext->ArgC;
+    DestCmdContext->CurrentArg = SrcCmdContext->CurrentArg;
+    DestCmdContext->CurrentArgOffset = SrcCmdContext->CurrentArgOffset;
+    DestCmdContext->TrailingChars = SrcCmdContext->TrailingChars;
+
+    if (SrcCmdContext->ArgC == 0) {
+        DestCmdContext->MemoryToFree = NULL;
+        DestCmdContext->ArgV = NULL;
+        DestCmdContext->ArgContexts = NULL;
+        return TRUE;
+    }
+
+    CharsNeeded = 0;
+    for (Count = 0; Count < SrcCmdContext->ArgC; Count++) {
+        CharsNeeded += SrcCmdContext->ArgV[Count].LengthInChars + 1;
+    }
+
+    DestCmdContext->MemoryToFree = YoriLibReferencedMalloc(SrcCmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT)) +
+                                                           CharsNeeded * sizeof(TCHAR));
+    if (DestCmdContext->MemoryToFree == NULL) {
+        return FALSE;
+    }
+
+    DestCmdContext->ArgV = DestCmdContext->MemoryToFree;
+    DestCmdContext->ArgContexts = (PYORI_SH_ARG_CONTEXT)YoriLibAddToPointer(DestCmdContext->ArgV, SrcCmdContext->ArgC * sizeof(YORI_STRING));
+    OutputString = (LPTSTR)(DestCmdContext->ArgContexts + SrcCmdContext->ArgC);
+
+    for (Count = 0; Count < SrcCmdContext->ArgC; Count++) {
+        DestCmdContext->ArgContexts[Count].Quoted = SrcCmdContext->ArgContexts[Count].Quoted;
+        YoriLibInitEmptyString(&DestCmdContext->ArgV[Count]);
+        YoriLibReference(DestCmdContext->MemoryToFree);
+        DestCmdContext->ArgV[Count].MemoryToFree = DestCmdContext->MemoryToFree;
+        DestCmdContext->ArgV[Count].StartOfString = OutputString;
+        DestCmdContext->ArgV[Count].LengthInChars = SrcCmdContext->ArgV[Count].LengthInChars;
+        DestCmdContext->ArgV[Count].LengthAllocated = SrcCmdContext->ArgV[Count].LengthInChars + 1;
+        memcpy(OutputString, SrcCmdContext->ArgV[Count].StartOfString, SrcCmdContext->ArgV[Count].LengthInChars * sizeof(TCHAR));
+        OutputString[SrcCmdContext->ArgV[Count].LengthInChars] = '\0';
+        OutputString += SrcCmdContext->ArgV[Count].LengthInChars + 1;
+    }
+
+    return TRUE;
+}
+
+/**
+ Look for a command string in the cache of previously tokenized strings.  If
+ found, the entry is moved to the head of the cache and a copy of its
+ tokenized form is returned.
+
+ @param CmdLine Pointer to the command string to look for.
+
+ @param CmdContext On successful completion, populated with a copy of the
+        tokenized command string.
+
+ @return TRUE if the string was found and copied, FALSE if it was not found.
+ */
+__success(return)
+BOOL
+YoriShParseCacheLookup(
+    __in PYORI_STRING CmdLine,
+    __out PYORI_SH_CMD_CONTEXT CmdContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_PARSE_CACHE_ENTRY CacheEntry;
+
+    if (YoriShParseCacheList.Next == NULL) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, NULL);
+    while (ListEntry != NULL) {
+        CacheEntry = CONTAINING_RECORD(ListEntry, YORI_SH_PARSE_CACHE_ENTRY, ListEntry);
+        if (CacheEntry->CmdLine.LengthInChars == CmdLine->LengthInChars &&
+            YoriLibCompareString(&CacheEntry->CmdLine, CmdLine) == 0) {
+
+            if (!YoriShCloneTokenizedCmdContext(CmdContext, &CacheEntry->CmdContext)) {
+                return FALSE;
+            }
+
+            YoriLibRemoveListItem(&CacheEntry->ListEntry);
+            YoriLibInsertList(&YoriShParseCacheList, &CacheEntry->ListEntry);
+            return TRUE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, ListEntry);
+    }
+
+    return FALSE;
+}
+
+/**
+ Free a single entry in the cache of tokenized command strings.  The entry
+ must already have been removed from the cache list.
+
+ @param CacheEntry Pointer to the entry to free.
+ */
+VOID
+YoriShFreeParseCacheEntry(
+    __in PYORI_SH_PARSE_CACHE_ENTRY CacheEntry
+    )
+{
+    YoriShFreeCmdContext(&CacheEntry->CmdContext);
+    YoriLibDereference(CacheEntry);
+}
+
+/**
+ Add a newly tokenized command string to the cache.  If the cache is full,
+ the least recently used entry is discarded.  Failure to add to the cache is
+ not fatal, so this routine does not return a result.
+
+ @param CmdLine Pointer to the command string that was tokenized.
+
+ @param CmdContext Pointer to the tokenized form of the command string,
+        before any environment variable expansion.
+ */
+VOID
+YoriShParseCacheInsert(
+    __in PYORI_STRING CmdLine,
+    __in PYORI_SH_CMD_CONTEXT CmdContext
+    )
+{
+    PYORI_SH_PARSE_CACHE_ENTRY CacheEntry;
+
+    if (YoriShParseCacheList.Next == NULL) {
+        YoriLibInitializeListHead(&YoriShParseCacheList);
+    }
+
+    CacheEntry = YoriLibReferencedMalloc(sizeof(YORI_SH_PARSE_CACHE_ENTRY) + (CmdLine->LengthInChars + 1) * sizeof(TCHAR));
+    if (CacheEntry == NULL) {
+        return;
+    }
+
+    if (!YoriShCloneTokenizedCmdContext(&CacheEntry->CmdContext, CmdContext)) {
+        YoriLibDereference(CacheEntry);
+        return;
+    }
+
+    YoriLibInitEmptyString(&CacheEntry->CmdLine);
+    CacheEntry->CmdLine.StartOfString = (LPTSTR)(CacheEntry + 1);
+    CacheEntry->CmdLine.LengthInChars = CmdLine->LengthInChars;
+    CacheEntry->CmdLine.LengthAllocated = CmdLine->LengthInChars + 1;
+    memcpy(CacheEntry->CmdLine.StartOfString, CmdLine->StartOfString, CmdLine->LengthInChars * sizeof(TCHAR));
+    CacheEntry->CmdLine.StartOfString[CmdLine->LengthInChars] = '\0';
+
+    if (YoriShParseCacheCount >= YORI_SH_PARSE_CACHE_MAX_ENTRIES) {
+        PYORI_SH_PARSE_CACHE_ENTRY OldestEntry;
+        OldestEntry = CONTAINING_RECORD(YoriShParseCacheList.Prev, YORI_SH_PARSE_CACHE_ENTRY, ListEntry);
+        YoriLibRemoveListItem(&OldestEntry->ListEntry);
+        YoriShFreeParseCacheEntry(OldestEntry);
+        YoriShParseCacheCount--;
+    }
+
+    YoriLibInsertList(&YoriShParseCacheList, &CacheEntry->ListEntry);
+    YoriShParseCacheCount++;
+}
+
+/**
+ Free a single entry in the cache of resolved executables.  The entry must
+ already have been removed from the cache list.
+
+ @param CacheEntry Pointer to the entry to free.
+ */
+VOID
+YoriShFreeResolveCacheEntry(
+    __in PYORI_SH_RESOLVE_CACHE_ENTRY CacheEntry
+    )
+{
+    DWORD Index;
+
+    if (CacheEntry->Directories != NULL) {
+        for (Index = 0; Index < CacheEntry->DirectoryCount; Index++) {
+            YoriLibFreeStringContents(&CacheEntry->Directories[Index].Path);
+        }
+        YoriLibFree(CacheEntry->Directories);
+    }
+    YoriLibFreeStringContents(&CacheEntry->FoundExecutable);
+    YoriLibDereference(CacheEntry);
+}
+
+/**
+ Free all entries in the caches of tokenized command strings and resolved
+ executables.
+ */
+VOID
+YoriShFreeParseCache()
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_PARSE_CACHE_ENTRY ParseEntry;
+    PYORI_SH_RESOLVE_CACHE_ENTRY ResolveEntry;
+
+    if (YoriShParseCacheList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, NULL);
+        while (ListEntry != NULL) {
+            ParseEntry = CONTAINING_RECORD(ListEntry, YORI_SH_PARSE_CACHE_ENTRY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, ListEntry);
+            YoriLibRemoveListItem(&ParseEntry->ListEntry);
+            YoriShFreeParseCacheEntry(ParseEntry);
+        }
+        YoriShParseCacheCount = 0;
+    }
+
+    if (YoriShResolveCacheList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShResolveCacheList, NULL);
+        while (ListEntry != NULL) {
+            ResolveEntry = CONTAINING_RECORD(ListEntry, YORI_SH_RESOLVE_CACHE_ENTRY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&YoriShResolveCacheList, ListEntry);
+            YoriLibRemoveListItem(&ResolveEntry->ListEntry);
+            YoriShFreeResolveCacheEntry(ResolveEntry);
+        }
+        YoriShResolveCacheCount = 0;
+    }
+}
+
+/**
+ Parse a single command string into a series of arguments.  This routine takes
+ care of splitting things based on the presence or absence of quotes, as well
+ as performing environment variable expansion.  The resulting string has no
+ knowledge of redirects, pipes, or multi program execution - it is just a
+ series of arguments.
+
+ When no current offset is specified, the tokenized form of the string is
+ retained in a small cache, so that when the same string is executed
+ repeatedly, such as within a loop, only environment variable expansion
+ needs to be performed again.
+
+ @param CmdLine The string to parse into arguments.
+
+ @param CurrentOffset The current offset within the string.  This can be set
+        to zero if not needed.  The argument that corresponds to this offset
+        will be marked in the CmdContext as being the active argument.
+
+ @param CmdContext A caller allocated CmdContext to populate with arguments.
+        This routine will allocate space for the argument array and contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShParseCmdlineToCmdContext(
+    __in PYORI_STRING CmdLine,
+    __in DWORD CurrentOffset,
+    __out PYORI_SH_CMD_CONTEXT CmdContext
+    )
+{
+    if (CurrentOffset != 0 || !YoriShParseCacheLookup(CmdLine, CmdContext)) {
+        if (!YoriShTokenizeCmdlineToCmdContext(CmdLine, CurrentOffset, CmdContext)) {
+            return FALSE;
+        }
+
+        if (CurrentOffset == 0) {
+            YoriShParseCacheInsert(CmdLine, CmdContext);
+        }
+    }
+
+    YoriShExpandCmdContextVariables(CmdContext);
 
     return TRUE;
 }
@@ -837,7 +1249,7 @@ YoriShRemoveEscapesFromCmdContext(
     //  optimized away if no escapes are found
     //
 
-    if (!YoriShCopyCmdContext(NoEscapedCmdContext, EscapedCmdContext)) {
+    if (!YoriShCopyCmdContext(NoEscapedCmdContext, EscapedCmdContext, NULL)) {
         return FALSE;
     }
 
@@ -928,23 +1340,33 @@ YoriShCopyArg(
 
  @param SrcCmdContext Pointer to the source command context.
 
+ @param Arena Optionally points to an arena to allocate the argument array
+        from.  If not specified, the array is allocated from the heap.
+
  @return TRUE to indicate success, or FALSE to indicate failure.
  */
 __success(return)
 BOOL
 YoriShCopyCmdContext(
     __out PYORI_SH_CMD_CONTEXT DestCmdContext,
-    __in PYORI_SH_CMD_CONTEXT SrcCmdContext
+    __in PYORI_SH_CMD_CONTEXT SrcCmdContext,
+    __in_opt PYORILIB_ARENA Arena
     )
 {
     DWORD Count;
+    DWORD BytesNeeded;
 
-    DestCmdContext->MemoryToFree = YoriLibReferencedMalloc(SrcCmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT)));
-    if (DestCmdContext->MemoryToFree == NULL) {
+    BytesNeeded = SrcCmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT));
+    if (Arena != NULL) {
+        DestCmdContext->ArgV = YoriLibArenaReferencedMalloc(Arena, BytesNeeded, &DestCmdContext->MemoryToFree);
+    } else {
+        DestCmdContext->MemoryToFree = YoriLibReferencedMalloc(BytesNeeded);
+        DestCmdContext->ArgV = DestCmdContext->MemoryToFree;
+    }
+    if (DestCmdContext->ArgV == NULL) {
         return FALSE;
     }
 
-    DestCmdContext->ArgV = DestCmdContext->MemoryToFree;
     DestCmdContext->ArgContexts = (PYORI_SH_ARG_CONTEXT)YoriLibAddToPointer(DestCmdContext->ArgV, SrcCmdContext->ArgC * sizeof(YORI_STRING));
 
     DestCmdContext->ArgC = SrcCmdContext->ArgC;
@@ -1023,6 +1445,10 @@ YoriShExecContextCleanupStdIn(
                 CloseHandle(ExecContext->StdIn.Pipe.PipeFromPriorProcess);
                 ExecContext->StdIn.Pipe.PipeFromPriorProcess = NULL;
             }
+            if (ExecContext->StdIn.Pipe.ProcessBuffersFromPriorProcess != NULL) {
+                YoriShDereferenceProcessBuffer(ExecContext->StdIn.Pipe.ProcessBuffersFromPriorProcess);
+                ExecContext->StdIn.Pipe.ProcessBuffersFromPriorProcess = NULL;
+            }
             break;
         case StdInTypeFile:
             YoriLibFreeStringContents(&ExecContext->StdIn.File.FileName);
@@ -1189,6 +1615,9 @@ YoriShCheckForDeviceNameAndDuplicate(
  @param InitialArgument Specifies the first argument to be used to
         generate information for this program.
 
+ @param Arena Pointer to an arena to allocate the argument array of the
+        program from.
+
  @param ExecContext Is populated with information about how to execute a
         single program.
 
@@ -1214,6 +1643,7 @@ DWORD
 YoriShParseCmdContextToExecContext(
     __in PYORI_SH_CMD_CONTEXT CmdContext,
     __in DWORD InitialArgument,
+    __in PYORILIB_ARENA Arena,
     __out PYORI_SH_SINGLE_EXEC_CONTEXT ExecContext,
     __out_opt PBOOL CurrentArgIsForProgram,
     __out_opt PDWORD CurrentArgIndex,
@@ -1269,12 +1699,11 @@ YoriShParseCmdContextToExecContext(
 
     ArgumentsConsumed = Count - InitialArgument;
 
-    ExecContext->CmdToExec.MemoryToFree = YoriLibReferencedMalloc(ArgumentsConsumed * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT)));
-    if (ExecContext->CmdToExec.MemoryToFree == NULL) {
+    ExecContext->CmdToExec.ArgV = YoriLibArenaReferencedMalloc(Arena, ArgumentsConsumed * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT)), &ExecContext->CmdToExec.MemoryToFree);
+    if (ExecContext->CmdToExec.ArgV == NULL) {
         return 0;
     }
 
-    ExecContext->CmdToExec.ArgV = ExecContext->CmdToExec.MemoryToFree;
     ExecContext->CmdToExec.ArgContexts = (PYORI_SH_ARG_CONTEXT)YoriLibAddToPointer(ExecContext->CmdToExec.ArgV, ArgumentsConsumed * sizeof(YORI_STRING));
 
     for (Count = InitialArgument; Count < (InitialArgument + ArgumentsConsumed); Count++) {
@@ -1515,7 +1944,11 @@ YoriShDereferenceExecContext(
     if (InterlockedDecrement((LONG *)&ExecContext->ReferenceCount) == 0) {
         YoriShFreeExecContext(ExecContext);
         if (Deallocate) {
-            YoriLibFree(ExecContext);
+            if (ExecContext->MemoryToFree != NULL) {
+                YoriLibDereference(ExecContext->MemoryToFree);
+            } else {
+                YoriLibFree(ExecContext);
+            }
         }
     }
 }
@@ -1577,6 +2010,10 @@ YoriShFreeExecPlan(
         the character offset within the current argument for the cursor
         location.
 
+ The plan and each program within it are allocated from a single arena, so
+ constructing the plan requires very few heap operations, and the memory is
+ returned once every program in the plan has been dereferenced.
+
  @return TRUE to indicate parsing success, FALSE to indicate failure.
  */
 __success(return)
@@ -1599,6 +2036,8 @@ YoriShParseCmdContextToExecPlan(
     BOOL FoundProgramMatch;
     DWORD LocalCurrentArgIndex;
     DWORD LocalCurrentArgOffset;
+    PVOID ThisProgramRegion;
+    YORILIB_ARENA Arena;
 
     if (CmdContext->ArgC == 0) {
         return FALSE;
@@ -1623,11 +2062,19 @@ YoriShParseCmdContextToExecPlan(
     ZeroMemory(ExecPlan, sizeof(YORI_SH_EXEC_PLAN));
     FoundProgramMatch = FALSE;
 
+    //
+    //  Size the arena so a typical command line fits in one region.  Each
+    //  program needs its exec context plus a small argument array.
+    //
+
+    YoriLibArenaInitialize(&Arena, 2 * sizeof(YORI_SH_SINGLE_EXEC_CONTEXT) + 4 * CmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_SH_ARG_CONTEXT)));
+
     //
     //  First, turn the entire CmdContext into an ExecContext.
     //
 
-    if (!YoriShCopyCmdContext(&ExecPlan->EntireCmd.CmdToExec, CmdContext)) {
+    if (!YoriShCopyCmdContext(&ExecPlan->EntireCmd.CmdToExec, CmdContext, &Arena)) {
+        YoriLibArenaCleanup(&Arena);
         YoriShFreeExecPlan(ExecPlan);
         return FALSE;
     }
@@ -1637,15 +2084,24 @@ YoriShParseCmdContextToExecPlan(
 
     while (CurrentArg < CmdContext->ArgC) {
 
-        ThisProgram = YoriLibMalloc(sizeof(YORI_SH_SINGLE_EXEC_CONTEXT));
+        ThisProgram = YoriLibArenaReferencedMalloc(&Arena, sizeof(YORI_SH_SINGLE_EXEC_CONTEXT), &ThisProgramRegion);
         if (ThisProgram == NULL) {
+            YoriLibArenaCleanup(&Arena);
             YoriShFreeExecPlan(ExecPlan);
             return FALSE;
         }
 
-        ArgsConsumed = YoriShParseCmdContextToExecContext(CmdContext, CurrentArg, ThisProgram, &LocalCurrentArgIsForProgram, &LocalCurrentArgIndex, &LocalCurrentArgOffset);
+        ArgsConsumed = YoriShParseCmdContextToExecContext(CmdContext, CurrentArg, &Arena, ThisProgram, &LocalCurrentArgIsForProgram, &LocalCurrentArgIndex, &LocalCurrentArgOffset);
+
+        //
+        //  The exec context is initialized by the call above, so indicate
+        //  how to free it afterwards.
+        //
+
+        ThisProgram->MemoryToFree = ThisProgramRegion;
         if (ArgsConsumed == 0) {
             YoriShDereferenceExecContext(ThisProgram, TRUE);
+            YoriLibArenaCleanup(&Arena);
             YoriShFreeExecPlan(ExecPlan);
             return FALSE;
         }
@@ -1796,6 +2252,7 @@ YoriShParseCmdContextToExecPlan(
         }
     }
 
+    YoriLibArenaCleanup(&Arena);
     return TRUE;
 }
 
@@ -1833,6 +2290,279 @@ YoriShDoesExpressionSpecifyPath(
     return FALSE;
 }
 
+/**
+ Query the last write time of a directory.
+
+ @param Directory Pointer to a NULL terminated fully qualified path to the
+        directory.
+
+ @param WriteTime On successful completion, updated to contain the last
+        write time of the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShGetDirectoryWriteTime(
+    __in PYORI_STRING Directory,
+    __out PLARGE_INTEGER WriteTime
+    )
+{
+    HANDLE hDir;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    ASSERT(YoriLibIsStringNullTerminated(Directory));
+
+    hDir = CreateFile(Directory->StartOfString,
+                      FILE_READ_ATTRIBUTES,
+                      FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS,
+                      NULL);
+
+    if (hDir == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(hDir, &FileInfo)) {
+        CloseHandle(hDir);
+        return FALSE;
+    }
+
+    CloseHandle(hDir);
+    WriteTime->LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+    WriteTime->HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+    return TRUE;
+}
+
+/**
+ Return TRUE if a searched directory refers to the directory that an
+ executable was found in.  Trailing seperators are ignored.
+
+ @param Directory Pointer to the searched directory.
+
+ @param FoundDirectory Pointer to the directory containing the executable,
+        without any trailing seperator.
+
+ @return TRUE if the directories match, FALSE if they do not.
+ */
+BOOL
+YoriShIsFoundDirectory(
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING FoundDirectory
+    )
+{
+    YORI_STRING Trimmed;
+
+    YoriLibInitEmptyString(&Trimmed);
+    Trimmed.StartOfString = Directory->StartOfString;
+    Trimmed.LengthInChars = Directory->LengthInChars;
+    while (Trimmed.LengthInChars > 0 &&
+           YoriLibIsSep(Trimmed.StartOfString[Trimmed.LengthInChars - 1])) {
+
+        Trimmed.LengthInChars--;
+    }
+
+    if (YoriLibCompareStringInsensitive(&Trimmed, FoundDirectory) == 0) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Record the directories that a path search would examine before arriving at
+ a found executable, along with their last write times, so that a later
+ lookup can determine whether any file has been created that would change
+ the result.  The current directory is searched first, followed by each
+ component of PATH.
+
+ @param CurrentDirectory Pointer to the current directory.
+
+ @param FoundExecutable Pointer to the fully qualified executable that the
+        search found.
+
+ @param DirectoryCount On successful completion, updated to contain the
+        number of elements in the Directories array.
+
+ @param Directories On successful completion, updated to point to an
+        allocated array of directories.  The caller should free each Path
+        with @ref YoriLibFreeStringContents and the array with
+        @ref YoriLibFree .
+
+ @return TRUE to indicate success, FALSE if the directories could not be
+         captured and the result should not be cached.
+ */
+__success(return)
+BOOL
+YoriShCaptureResolveDirectories(
+    __in PYORI_STRING CurrentDirectory,
+    __in PYORI_STRING FoundExecutable,
+    __out PDWORD DirectoryCount,
+    __out PYORI_SH_RESOLVE_CACHE_DIRECTORY * Directories
+    )
+{
+    YORI_STRING FoundDirectory;
+    YORI_STRING PathVariable;
+    YORI_STRING Component;
+    PYORI_SH_RESOLVE_CACHE_DIRECTORY Array;
+    DWORD MaxCount;
+    DWORD Count;
+    DWORD Index;
+    BOOL Found;
+
+    YoriLibInitEmptyString(&FoundDirectory);
+    FoundDirectory.StartOfString = FoundExecutable->StartOfString;
+    FoundDirectory.LengthInChars = FoundExecutable->LengthInChars;
+    while (FoundDirectory.LengthInChars > 0 &&
+           !YoriLibIsSep(FoundDirectory.StartOfString[FoundDirectory.LengthInChars - 1])) {
+
+        FoundDirectory.LengthInChars--;
+    }
+    while (FoundDirectory.LengthInChars > 0 &&
+           YoriLibIsSep(FoundDirectory.StartOfString[FoundDirectory.LengthInChars - 1])) {
+
+        FoundDirectory.LengthInChars--;
+    }
+
+    if (FoundDirectory.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&PathVariable);
+    if (!YoriLibAllocateAndGetEnvironmentVariable(_T("PATH"), &PathVariable)) {
+        return FALSE;
+    }
+
+    MaxCount = 2;
+    for (Index = 0; Index < PathVariable.LengthInChars; Index++) {
+        if (PathVariable.StartOfString[Index] == ';') {
+            MaxCount++;
+        }
+    }
+
+    Array = YoriLibMalloc(MaxCount * sizeof(YORI_SH_RESOLVE_CACHE_DIRECTORY));
+    if (Array == NULL) {
+        YoriLibFreeStringContents(&PathVariable);
+        return FALSE;
+    }
+
+    Count = 0;
+    Found = FALSE;
+
+    //
+    //  The current directory is always searched first.
+    //
+
+    if (!YoriLibAllocateString(&Array[Count].Path, CurrentDirectory->LengthInChars + 1)) {
+        goto Fail;
+    }
+    memcpy(Array[Count].Path.StartOfString, CurrentDirectory->StartOfString, CurrentDirectory->LengthInChars * sizeof(TCHAR));
+    Array[Count].Path.LengthInChars = CurrentDirectory->LengthInChars;
+    Array[Count].Path.StartOfString[Array[Count].Path.LengthInChars] = '\0';
+    Count++;
+    if (!YoriShGetDirectoryWriteTime(&Array[Count - 1].Path, &Array[Count - 1].WriteTime)) {
+        goto Fail;
+    }
+    if (YoriShIsFoundDirectory(&Array[Count - 1].Path, &FoundDirectory)) {
+        Found = TRUE;
+    }
+
+    //
+    //  Followed by each component of PATH, until the one containing the
+    //  executable.  Each component is converted to a full path so it can
+    //  be compared against the executable's location.
+    //
+
+    YoriLibInitEmptyString(&Component);
+    Component.StartOfString = PathVariable.StartOfString;
+    Index = 0;
+    while (!Found && Index <= PathVariable.LengthInChars) {
+        if (Index == PathVariable.LengthInChars ||
+            PathVariable.StartOfString[Index] == ';') {
+
+            Component.LengthInChars = (DWORD)(&PathVariable.StartOfString[Index] - Component.StartOfString);
+            if (Component.LengthInChars > 0) {
+                ASSERT(Count < MaxCount);
+                YoriLibInitEmptyString(&Array[Count].Path);
+                if (!YoriLibGetFullPathNameReturnAllocation(&Component, FALSE, &Array[Count].Path, NULL)) {
+                    goto Fail;
+                }
+                Count++;
+
+                //
+                //  A PATH component that doesn't exist is recorded with a
+                //  zero write time, so that creating it later is detected.
+                //
+
+                if (!YoriShGetDirectoryWriteTime(&Array[Count - 1].Path, &Array[Count - 1].WriteTime)) {
+                    Array[Count - 1].WriteTime.QuadPart = 0;
+                }
+                if (YoriShIsFoundDirectory(&Array[Count - 1].Path, &FoundDirectory)) {
+                    Found = TRUE;
+                }
+            }
+            Component.StartOfString = &PathVariable.StartOfString[Index + 1];
+        }
+        Index++;
+    }
+
+    if (!Found) {
+        goto Fail;
+    }
+
+    YoriLibFreeStringContents(&PathVariable);
+    *DirectoryCount = Count;
+    *Directories = Array;
+    return TRUE;
+
+Fail:
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibFreeStringContents(&Array[Index].Path);
+    }
+    YoriLibFree(Array);
+    YoriLibFreeStringContents(&PathVariable);
+    return FALSE;
+}
+
+/**
+ Check whether any directory searched when resolving a cached command has
+ changed since the command was resolved.
+
+ @param CacheEntry Pointer to the cache entry to check.
+
+ @return TRUE if the directories are unchanged and the entry can be used,
+         FALSE if the entry should be discarded.
+ */
+BOOL
+YoriShIsResolveCacheEntryCurrent(
+    __in PYORI_SH_RESOLVE_CACHE_ENTRY CacheEntry
+    )
+{
+    LARGE_INTEGER WriteTime;
+    DWORD Attributes;
+    DWORD Index;
+
+    for (Index = 0; Index < CacheEntry->DirectoryCount; Index++) {
+        if (!YoriShGetDirectoryWriteTime(&CacheEntry->Directories[Index].Path, &WriteTime)) {
+            WriteTime.QuadPart = 0;
+        }
+        if (WriteTime.QuadPart != CacheEntry->Directories[Index].WriteTime.QuadPart) {
+
+            return FALSE;
+        }
+    }
+
+    Attributes = GetFileAttributes(CacheEntry->FoundExecutable.StartOfString);
+    if (Attributes == (DWORD)-1 ||
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Expand any aliases in a command context, resolve any executable via path
  lookups, and return with an exec context indicating which program to run.
@@ -1856,12 +2586,136 @@ YoriShResolveCommandToExecutable(
     )
 {
     YORI_STRING FoundExecutable;
+    YORI_STRING CurrentDirectory;
+    TCHAR CurrentDirectoryBuffer[MAX_PATH];
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_RESOLVE_CACHE_ENTRY CacheEntry;
+    DWORD Index;
+    BOOL Cacheable;
 
     YoriLibInitEmptyString(&FoundExecutable);
 
     YoriShExpandAlias(CmdContext);
 
+    //
+    //  Searching the path involves probing the file system for every
+    //  combination of PATH and PATHEXT.  If the command has no path
+    //  component, check whether it was resolved recently in the same
+    //  directory with the same environment.  The result can only be
+    //  reused if the file that it resolved to still exists and no
+    //  directory searched before it, including the directory containing
+    //  it, has been modified, since a newly created file there could
+    //  take precedence.  Only successful resolutions are retained, since
+    //  a command that is not found may be created at any time.
+    //
+
+    Cacheable = TRUE;
+    for (Index = 0; Index < CmdContext->ArgV[0].LengthInChars; Index++) {
+        if (YoriLibIsSep(CmdContext->ArgV[0].StartOfString[Index]) ||
+            CmdContext->ArgV[0].StartOfString[Index] == ':') {
+
+            Cacheable = FALSE;
+            break;
+        }
+    }
+
+    YoriLibInitEmptyString(&CurrentDirectory);
+    if (Cacheable) {
+        CurrentDirectory.StartOfString = CurrentDirectoryBuffer;
+        CurrentDirectory.LengthAllocated = sizeof(CurrentDirectoryBuffer)/sizeof(CurrentDirectoryBuffer[0]);
+        CurrentDirectory.LengthInChars = GetCurrentDirectory(CurrentDirectory.LengthAllocated, CurrentDirectory.StartOfString);
+        if (CurrentDirectory.LengthInChars == 0 ||
+            CurrentDirectory.LengthInChars >= CurrentDirectory.LengthAllocated) {
+
+            Cacheable = FALSE;
+        }
+    }
+
+    if (Cacheable && YoriShResolveCacheList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShResolveCacheList, NULL);
+        while (ListEntry != NULL) {
+            CacheEntry = CONTAINING_RECORD(ListEntry, YORI_SH_RESOLVE_CACHE_ENTRY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&YoriShResolveCacheList, ListEntry);
+            if (CacheEntry->EnvironmentGeneration != YoriShGlobal.EnvironmentGeneration) {
+                YoriLibRemoveListItem(&CacheEntry->ListEntry);
+                YoriShFreeResolveCacheEntry(CacheEntry);
+                YoriShResolveCacheCount--;
+                continue;
+            }
+
+            if (YoriLibCompareStringInsensitive(&CacheEntry->Command, &CmdContext->ArgV[0]) == 0 &&
+                YoriLibCompareStringInsensitive(&CacheEntry->CurrentDirectory, &CurrentDirectory) == 0) {
+
+                YoriLibRemoveListItem(&CacheEntry->ListEntry);
+                if (!YoriShIsResolveCacheEntryCurrent(CacheEntry) ||
+                    !YoriLibAllocateString(&FoundExecutable, CacheEntry->FoundExecutable.LengthInChars + 1)) {
+
+                    YoriShFreeResolveCacheEntry(CacheEntry);
+                    YoriShResolveCacheCount--;
+                    break;
+                }
+
+                YoriLibInsertList(&YoriShResolveCacheList, &CacheEntry->ListEntry);
+                memcpy(FoundExecutable.StartOfString, CacheEntry->FoundExecutable.StartOfString, (CacheEntry->FoundExecutable.LengthInChars + 1) * sizeof(TCHAR));
+                FoundExecutable.LengthInChars = CacheEntry->FoundExecutable.LengthInChars;
+                YoriLibFreeStringContents(&CmdContext->ArgV[0]);
+                memcpy(&CmdContext->ArgV[0], &FoundExecutable, sizeof(YORI_STRING));
+                *ExecutableFound = TRUE;
+                return TRUE;
+            }
+        }
+    }
+
     if (YoriLibLocateExecutableInPath(&CmdContext->ArgV[0], NULL, NULL, &FoundExecutable) && FoundExecutable.LengthInChars > 0) {
+
+        if (Cacheable) {
+            CacheEntry = YoriLibReferencedMalloc(sizeof(YORI_SH_RESOLVE_CACHE_ENTRY) + (CmdContext->ArgV[0].LengthInChars + CurrentDirectory.LengthInChars + 2) * sizeof(TCHAR));
+            if (CacheEntry != NULL) {
+                if (YoriShResolveCacheList.Next == NULL) {
+                    YoriLibInitializeListHead(&YoriShResolveCacheList);
+                }
+
+                CacheEntry->EnvironmentGeneration = YoriShGlobal.EnvironmentGeneration;
+                CacheEntry->DirectoryCount = 0;
+                CacheEntry->Directories = NULL;
+
+                YoriLibInitEmptyString(&CacheEntry->Command);
+                CacheEntry->Command.StartOfString = (LPTSTR)(CacheEntry + 1);
+                CacheEntry->Command.LengthInChars = CmdContext->ArgV[0].LengthInChars;
+                CacheEntry->Command.LengthAllocated = CmdContext->ArgV[0].LengthInChars + 1;
+                memcpy(CacheEntry->Command.StartOfString, CmdContext->ArgV[0].StartOfString, CmdContext->ArgV[0].LengthInChars * sizeof(TCHAR));
+                CacheEntry->Command.StartOfString[CacheEntry->Command.LengthInChars] = '\0';
+
+                YoriLibInitEmptyString(&CacheEntry->CurrentDirectory);
+                CacheEntry->CurrentDirectory.StartOfString = CacheEntry->Command.StartOfString + CacheEntry->Command.LengthAllocated;
+                CacheEntry->CurrentDirectory.LengthInChars = CurrentDirectory.LengthInChars;
+                CacheEntry->CurrentDirectory.LengthAllocated = CurrentDirectory.LengthInChars + 1;
+                memcpy(CacheEntry->CurrentDirectory.StartOfString, CurrentDirectory.StartOfString, CurrentDirectory.LengthInChars * sizeof(TCHAR));
+                CacheEntry->CurrentDirectory.StartOfString[CacheEntry->CurrentDirectory.LengthInChars] = '\0';
+
+                YoriLibInitEmptyString(&CacheEntry->FoundExecutable);
+                if (YoriShCaptureResolveDirectories(&CurrentDirectory, &FoundExecutable, &CacheEntry->DirectoryCount, &CacheEntry->Directories) &&
+                    YoriLibAllocateString(&CacheEntry->FoundExecutable, FoundExecutable.LengthInChars + 1)) {
+                    memcpy(CacheEntry->FoundExecutable.StartOfString, FoundExecutable.StartOfString, FoundExecutable.LengthInChars * sizeof(TCHAR));
+                    CacheEntry->FoundExecutable.LengthInChars = FoundExecutable.LengthInChars;
+                    CacheEntry->FoundExecutable.StartOfString[FoundExecutable.LengthInChars] = '\0';
+
+                    if (YoriShResolveCacheCount >= YORI_SH_RESOLVE_CACHE_MAX_ENTRIES) {
+                        PYORI_SH_RESOLVE_CACHE_ENTRY OldestEntry;
+                        OldestEntry = CONTAINING_RECORD(YoriShResolveCacheList.Prev, YORI_SH_RESOLVE_CACHE_ENTRY, ListEntry);
+                        YoriLibRemoveListItem(&OldestEntry->ListEntry);
+                        YoriShFreeResolveCacheEntry(OldestEntry);
+                        YoriShResolveCacheCount--;
+                    }
+
+                    YoriLibInsertList(&YoriShResolveCacheList, &CacheEntry->ListEntry);
+                    YoriShResolveCacheCount++;
+                } else {
+                    YoriShFreeResolveCacheEntry(CacheEntry);
+                }
+            }
+        }
+
         YoriLibFreeStringContents(&CmdContext->ArgV[0]);
         memcpy(&CmdContext->ArgV[0], &FoundExecutable, sizeof(YORI_STRING));
         *ExecutableFound = TRUE;
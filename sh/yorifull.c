@@ -356,6 +356,11 @@ YORI_CMD_BUILTIN YoriCmd_YRMDIR;
  */
 YORI_CMD_BUILTIN YoriCmd_SCUT;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_SEARCH;
+
 /**
  Declaration for the builtin command.
  */
@@ -545,6 +550,7 @@ YoriShBuiltins[] = {
                     {_T("READLINE"),  YoriCmd_READLINE},
                     {_T("REPL"),      YoriCmd_REPL},
                     {_T("SCUT"),      YoriCmd_SCUT},
+                    {_T("SEARCH"),    YoriCmd_SEARCH},
                     {_T("SDIR"),      YoriCmd_SDIR},
                     {_T("SET"),       YoriCmd_SET},
                     {_T("SETLOCAL"),  YoriCmd_SETLOCAL},
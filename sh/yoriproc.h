@@ -183,6 +183,13 @@ YoriShForwardProcessBufferToNextProcess(
     __in PYORI_SH_SINGLE_EXEC_CONTEXT ExecContext
     );
 
+VOID
+YoriShInitializeInProcStream(
+    __in PVOID ThisBuffer,
+    __in HANDLE Handle,
+    __out PYORI_LIB_INPROC_STREAM Stream
+    );
+
 VOID
 YoriShDereferenceProcessBuffer(
     __in PVOID ThisBuffer
@@ -404,6 +411,9 @@ YoriShRemoveOneHistoryEntry(
 VOID
 YoriShClearAllHistory();
 
+VOID
+YoriShCleanupHistory();
+
 __success(return)
 BOOL
 YoriShInitHistory();
@@ -425,6 +435,11 @@ YoriShGetHistoryStrings(
 
 // *** INPUT.C ***
 
+VOID
+YoriShCloseInputGap(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    );
+
 __success(return)
 BOOL
 YoriShEnsureStringHasEnoughCharacters(
@@ -441,6 +456,11 @@ YoriShGetExpression(
 VOID
 YoriShCleanupInputContext();
 
+VOID
+YoriShPreCommand(
+    __in BOOLEAN EnableVt
+    );
+
 // *** JOB.C ***
 
 __success(return)
@@ -506,13 +526,6 @@ YoriShGetJobInformation(
     __inout PYORI_STRING Command
     );
 
-// *** MAIN.C ***
-
-VOID
-YoriShPreCommand(
-    __in BOOLEAN EnableVt
-    );
-
 // *** PARSE.C ***
 
 __success(return)
@@ -552,7 +565,8 @@ __success(return)
 BOOL
 YoriShCopyCmdContext(
     __out PYORI_SH_CMD_CONTEXT DestCmdContext,
-    __in PYORI_SH_CMD_CONTEXT SrcCmdContext
+    __in PYORI_SH_CMD_CONTEXT SrcCmdContext,
+    __in_opt PYORILIB_ARENA Arena
     );
 
 VOID
@@ -566,6 +580,9 @@ YoriShFreeCmdContext(
     __in PYORI_SH_CMD_CONTEXT CmdContext
     );
 
+VOID
+YoriShFreeParseCache();
+
 VOID
 YoriShFreeExecPlan(
     __in PYORI_SH_EXEC_PLAN ExecPlan
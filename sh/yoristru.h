@@ -183,6 +183,7 @@ typedef struct _YORI_SH_SINGLE_EXEC_CONTEXT {
         } File;
         struct {
             HANDLE PipeFromPriorProcess;
+            PVOID ProcessBuffersFromPriorProcess;
         } Pipe;
     } StdIn;
 
@@ -323,6 +324,13 @@ typedef struct _YORI_SH_SINGLE_EXEC_CONTEXT {
      */
     BOOLEAN DebugPumpThreadFinished;
 
+    /**
+     If this structure was allocated from an arena, points to the referenced
+     region containing it, which is dereferenced when the structure is
+     deallocated.  If NULL, the structure was allocated with YoriLibMalloc.
+     */
+    PVOID MemoryToFree;
+
 } YORI_SH_SINGLE_EXEC_CONTEXT, *PYORI_SH_SINGLE_EXEC_CONTEXT;
 
 /**
@@ -568,9 +576,26 @@ typedef struct _YORI_SH_INPUT_BUFFER {
 
     /**
      Pointer to a string containing the text as being entered by the user.
+     While GapLength is nonzero, the allocation contains unused space at
+     GapOffset and the string cannot be used directly; call
+     YoriShCloseInputGap first.  LengthInChars is always the number of
+     characters of text, excluding the gap.
      */
     YORI_STRING String;
 
+    /**
+     The offset of the unused space within @ref String.  Insertions and
+     deletions at this offset do not need to move any other text.
+     */
+    DWORD GapOffset;
+
+    /**
+     The number of unused characters at GapOffset.  Text after GapOffset
+     is stored this many characters later in the allocation.  Zero if the
+     string is contiguous.
+     */
+    DWORD GapLength;
+
     /**
      The current offset within @ref String that the user is modifying.
      */
@@ -33,11 +33,12 @@
 const
 CHAR strTeeHelpText[] =
         "\n"
-        "Output the contents of standard input to standard output and a file.\n"
+        "Output the contents of standard input to standard output and files.\n"
         "\n"
-        "TEE [-license] [-a] <file>\n"
+        "TEE [-license] [-a] [-r] <file> [<file>...]\n"
         "\n"
-        "   -a             Append to the file\n";
+        "   -a             Append to the files\n"
+        "   -r             Copy raw bytes without encoding or line translation\n";
 
 /**
  Display usage text to the user.
@@ -60,13 +61,59 @@ TeeHelp()
 typedef struct _TEE_CONTEXT {
 
     /**
-     Handle to a file which will receive all output in addition to standard
-     output.
+     The number of handles in the hFiles array.
      */
-    HANDLE hFile;
+    DWORD FileCount;
+
+    /**
+     An array of handles to files which will receive all output in addition
+     to standard output.
+     */
+    PHANDLE hFiles;
 
 } TEE_CONTEXT, *PTEE_CONTEXT;
 
+/**
+ Copy a single stream to standard output and all files without any
+ translation.  Each output is written on its own thread, so a slow output
+ does not delay reading input or writing to the other outputs.
+
+ @param hSource Handle to the source.
+
+ @param TeeContext Pointer to the context for the operation, including
+        handles to the files to write data to.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+TeePumpStream(
+    __in HANDLE hSource,
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    PHANDLE Targets;
+    BOOL Result;
+
+    Targets = YoriLibMalloc((TeeContext->FileCount + 1) * sizeof(HANDLE));
+    if (Targets == NULL) {
+        return FALSE;
+    }
+
+    Targets[0] = GetStdHandle(STD_OUTPUT_HANDLE);
+    memcpy(&Targets[1], TeeContext->hFiles, TeeContext->FileCount * sizeof(HANDLE));
+
+    Result = YoriLibPipePump(hSource, TeeContext->FileCount + 1, Targets, NULL);
+    if (!Result) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: copy failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+
+    YoriLibFree(Targets);
+    return Result;
+}
+
 /**
  Process a single stream.
 
@@ -86,6 +133,7 @@ TeeProcessStream(
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
+    DWORD Index;
 
     YoriLibInitEmptyString(&LineString);
 
@@ -100,7 +148,9 @@ TeeProcessStream(
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
         }
 
-        YoriLibOutputToDevice(TeeContext->hFile, 0, _T("%y\n"), &LineString);
+        for (Index = 0; Index < TeeContext->FileCount; Index++) {
+            YoriLibOutputToDevice(TeeContext->hFiles[Index], 0, _T("%y\n"), &LineString);
+        }
     }
 
     YoriLibLineReadClose(LineContext);
@@ -141,6 +191,8 @@ ENTRYPOINT(
     DWORD i;
     DWORD StartArg = 0;
     BOOL Append = FALSE;
+    BOOL RawOutput = FALSE;
+    DWORD Result = EXIT_SUCCESS;
     TEE_CONTEXT TeeContext;
     YORI_STRING FileName;
     YORI_STRING Arg;
@@ -163,6 +215,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("a")) == 0) {
                 Append = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                RawOutput = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -194,37 +249,66 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FileName)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), &ArgV[StartArg], ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    TeeContext.hFiles = YoriLibMalloc((ArgC - StartArg) * sizeof(HANDLE));
+    if (TeeContext.hFiles == NULL) {
         return EXIT_FAILURE;
     }
 
-    TeeContext.hFile = CreateFile(FileName.StartOfString,
-                                  (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE,
-                                  FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                                  NULL,
-                                  OPEN_ALWAYS,
-                                  FILE_ATTRIBUTE_NORMAL,
-                                  NULL);
+    for (i = StartArg; i < ArgC; i++) {
+        if (!YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FileName)) {
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), &ArgV[i], ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            Result = EXIT_FAILURE;
+            goto Exit;
+        }
 
-    if (TeeContext.hFile == INVALID_HANDLE_VALUE || TeeContext.hFile == NULL) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &FileName, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+        TeeContext.hFiles[TeeContext.FileCount] = CreateFile(FileName.StartOfString,
+                                                             (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE,
+                                                             FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                                             NULL,
+                                                             OPEN_ALWAYS,
+                                                             FILE_ATTRIBUTE_NORMAL,
+                                                             NULL);
+
+        if (TeeContext.hFiles[TeeContext.FileCount] == INVALID_HANDLE_VALUE ||
+            TeeContext.hFiles[TeeContext.FileCount] == NULL) {
+
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &FileName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&FileName);
+            Result = EXIT_FAILURE;
+            goto Exit;
+        }
+
+        TeeContext.FileCount++;
         YoriLibFreeStringContents(&FileName);
-        return EXIT_FAILURE;
     }
 
-    TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
+    //
+    //  If raw output was requested, copy bytes as is to all outputs.
+    //  Otherwise, translate lines so the files receive the same contents
+    //  regardless of where standard output is going.
+    //
 
-    CloseHandle(TeeContext.hFile);
-    YoriLibFreeStringContents(&FileName);
+    if (RawOutput) {
+        if (!TeePumpStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext)) {
+            Result = EXIT_FAILURE;
+        }
+    } else {
+        TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
+    }
+
+Exit:
+    for (i = 0; i < TeeContext.FileCount; i++) {
+        CloseHandle(TeeContext.hFiles[i]);
+    }
+    YoriLibFree(TeeContext.hFiles);
 
-    return EXIT_SUCCESS;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -38,23 +38,36 @@ CHAR strTimeThisHelpText[] =
         "\n"
         "Runs a child program and times its execution.\n"
         "\n"
-        "TIMETHIS [-license] [-f <fmt>] <command>\n"
+        "TIMETHIS [-license] [-f <fmt>] [-o csv|json] [-r <count>] [-w <count>] <command>\n"
+        "\n"
+        "   -f             Specify the format to display, not valid with -o or -r\n"
+        "   -o             Display statistics in CSV or JSON format\n"
+        "   -r             Run the command multiple times and display statistics\n"
+        "   -w             Specify the number of warmup runs, default 1 with -r\n"
         "\n"
         "Format specifiers are:\n"
         "   $CHILDCPU$         Amount of CPU time used by the child process\n"
         "   $CHILDCPUMS$       Amount of CPU time used by the child process in ms\n"
+        "   $CHILDCYCLES$      Number of processor cycles used by the child process\n"
         "   $CHILDKERNEL$      Amount of kernel time used by the child process\n"
         "   $CHILDKERNELMS$    Amount of kernel time used by the child process in ms\n"
+        "   $CHILDPEAKWS$      Peak working set of the child process in bytes\n"
         "   $CHILDUSER$        Amount of user time used by the child process\n"
         "   $CHILDUSERMS$      Amount of user time used by the child process in ms\n"
+        "   $CONTEXTSWITCHES$  Number of context switches in the system during execution\n"
         "   $ELAPSEDTIME$      Amount of time taken to execute the child process\n"
         "   $ELAPSEDTIMEMS$    Amount of time taken to execute the child process in ms\n"
+        "   $PAGEFAULTS$       Number of page faults taken by all child processes\n"
+        "   $READBYTES$        Number of bytes read by all child processes\n"
+        "   $READOPS$          Number of read operations by all child processes\n"
         "   $TREECPU$          Amount of CPU time used by all child processes\n"
         "   $TREECPUMS$        Amount of CPU time used by all child processes in ms\n"
         "   $TREEKERNEL$       Amount of kernel time used by all child processes\n"
         "   $TREEKERNELMS$     Amount of kernel time used by all child processes in ms\n"
         "   $TREEUSER$         Amount of user time used by all child processes\n"
-        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n";
+        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n"
+        "   $WRITEBYTES$       Number of bytes written by all child processes\n"
+        "   $WRITEOPS$         Number of write operations by all child processes\n";
 
 /**
  Display usage text to the user.
@@ -174,6 +187,12 @@ typedef struct _TIMETHIS_CONTEXT {
      */
     LARGE_INTEGER UserTimeInMs;
 
+    /**
+     Amount of time in milliseconds that the immediate child process spent
+     executing in either kernel or user mode.
+     */
+    LARGE_INTEGER CpuTimeInMs;
+
     /**
      Amount of time in milliseconds that the child process tree spent in
      kernel execution.
@@ -186,10 +205,61 @@ typedef struct _TIMETHIS_CONTEXT {
      */
     LARGE_INTEGER UserTimeTreeInMs;
 
+    /**
+     Amount of time in milliseconds that the child process tree spent
+     executing in either kernel or user mode.
+     */
+    LARGE_INTEGER CpuTimeTreeInMs;
+
     /**
      Amount of time taken to execute the child process.
      */
     LARGE_INTEGER WallTimeInMs;
+
+    /**
+     The number of processor cycles consumed by the immediate child process,
+     or zero if the system cannot report it.
+     */
+    LARGE_INTEGER ChildCycles;
+
+    /**
+     The largest working set of the immediate child process, in bytes.
+     */
+    LARGE_INTEGER ChildPeakWorkingSet;
+
+    /**
+     The number of context switches performed by all processors in the
+     system while the child process was executing.  Windows does not retain
+     this for a process once it has terminated, so this includes activity
+     from other processes.
+     */
+    LARGE_INTEGER ContextSwitches;
+
+    /**
+     The number of page faults taken by the child process tree.
+     */
+    LARGE_INTEGER PageFaults;
+
+    /**
+     The number of read operations issued by the child process tree.
+     */
+    LARGE_INTEGER ReadOperations;
+
+    /**
+     The number of write operations issued by the child process tree.
+     */
+    LARGE_INTEGER WriteOperations;
+
+    /**
+     The number of bytes read by the child process tree.
+     */
+    LARGE_INTEGER ReadBytes;
+
+    /**
+     The number of bytes written by the child process tree.
+     */
+    LARGE_INTEGER WriteBytes;
+
 } TIMETHIS_CONTEXT, *PTIMETHIS_CONTEXT;
 
 /**
@@ -215,33 +285,40 @@ TimeThisExpandVariables(
     __in PVOID Context
     )
 {
-    LARGE_INTEGER CpuTime;
     PTIMETHIS_CONTEXT TimeThisContext = (PTIMETHIS_CONTEXT)Context;
 
     if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDCPU")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart + TimeThisContext->UserTimeInMs.QuadPart;
-        return TimeThisOutputTimestamp(CpuTime, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisContext->CpuTimeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDCPUMS")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart + TimeThisContext->UserTimeInMs.QuadPart;
-        return TimeThisOutputLargeInteger(CpuTime, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisContext->CpuTimeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDCYCLES")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->ChildCycles, 10, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDKERNEL")) == 0) {
         return TimeThisOutputTimestamp(TimeThisContext->KernelTimeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDKERNELMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->KernelTimeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDPEAKWS")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->ChildPeakWorkingSet, 10, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDUSER")) == 0) {
         return TimeThisOutputTimestamp(TimeThisContext->UserTimeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CHILDUSERMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->UserTimeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("CONTEXTSWITCHES")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->ContextSwitches, 10, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("ELAPSEDTIME")) == 0) {
         return TimeThisOutputTimestamp(TimeThisContext->WallTimeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("ELAPSEDTIMEMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->WallTimeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("PAGEFAULTS")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->PageFaults, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("READBYTES")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->ReadBytes, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("READOPS")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->ReadOperations, 10, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("TREECPU")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeTreeInMs.QuadPart + TimeThisContext->UserTimeTreeInMs.QuadPart;
-        return TimeThisOutputTimestamp(CpuTime, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisContext->CpuTimeTreeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("TREECPUMS")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeTreeInMs.QuadPart + TimeThisContext->UserTimeTreeInMs.QuadPart;
-        return TimeThisOutputLargeInteger(CpuTime, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisContext->CpuTimeTreeInMs, 10, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("TREEKERNEL")) == 0) {
         return TimeThisOutputTimestamp(TimeThisContext->KernelTimeTreeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("TREEKERNELMS")) == 0) {
@@ -250,10 +327,566 @@ TimeThisExpandVariables(
         return TimeThisOutputTimestamp(TimeThisContext->UserTimeTreeInMs, OutputBuffer);
     } else if (YoriLibCompareStringWithLiteral(VariableName, _T("TREEUSERMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->UserTimeTreeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("WRITEBYTES")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->WriteBytes, 10, OutputBuffer);
+    } else if (YoriLibCompareStringWithLiteral(VariableName, _T("WRITEOPS")) == 0) {
+        return TimeThisOutputLargeInteger(TimeThisContext->WriteOperations, 10, OutputBuffer);
     }
     return 0;
 }
 
+/**
+ A description of a value measured for each run that can be summarized
+ across multiple runs.
+ */
+typedef struct _TIMETHIS_METRIC {
+
+    /**
+     The name of the metric in machine readable output.
+     */
+    LPCTSTR Name;
+
+    /**
+     The name of the metric in human readable output.
+     */
+    LPCTSTR Description;
+
+    /**
+     The offset of the value within the TIMETHIS_CONTEXT structure.
+     */
+    DWORD Offset;
+} TIMETHIS_METRIC, *PTIMETHIS_METRIC;
+
+/**
+ The set of metrics that are summarized across multiple runs.
+ */
+const TIMETHIS_METRIC TimeThisMetrics[] = {
+    {_T("elapsedms"),       _T("Elapsed time (ms)"),       FIELD_OFFSET(TIMETHIS_CONTEXT, WallTimeInMs)},
+    {_T("childcpums"),      _T("Child CPU time (ms)"),     FIELD_OFFSET(TIMETHIS_CONTEXT, CpuTimeInMs)},
+    {_T("childkernelms"),   _T("Child kernel time (ms)"),  FIELD_OFFSET(TIMETHIS_CONTEXT, KernelTimeInMs)},
+    {_T("childuserms"),     _T("Child user time (ms)"),    FIELD_OFFSET(TIMETHIS_CONTEXT, UserTimeInMs)},
+    {_T("treecpums"),       _T("Tree CPU time (ms)"),      FIELD_OFFSET(TIMETHIS_CONTEXT, CpuTimeTreeInMs)},
+    {_T("treekernelms"),    _T("Tree kernel time (ms)"),   FIELD_OFFSET(TIMETHIS_CONTEXT, KernelTimeTreeInMs)},
+    {_T("treeuserms"),      _T("Tree user time (ms)"),     FIELD_OFFSET(TIMETHIS_CONTEXT, UserTimeTreeInMs)},
+    {_T("childcycles"),     _T("Child cycles"),            FIELD_OFFSET(TIMETHIS_CONTEXT, ChildCycles)},
+    {_T("childpeakws"),     _T("Child peak working set"),  FIELD_OFFSET(TIMETHIS_CONTEXT, ChildPeakWorkingSet)},
+    {_T("pagefaults"),      _T("Page faults"),             FIELD_OFFSET(TIMETHIS_CONTEXT, PageFaults)},
+    {_T("readops"),         _T("Read operations"),         FIELD_OFFSET(TIMETHIS_CONTEXT, ReadOperations)},
+    {_T("readbytes"),       _T("Bytes read"),              FIELD_OFFSET(TIMETHIS_CONTEXT, ReadBytes)},
+    {_T("writeops"),        _T("Write operations"),        FIELD_OFFSET(TIMETHIS_CONTEXT, WriteOperations)},
+    {_T("writebytes"),      _T("Bytes written"),           FIELD_OFFSET(TIMETHIS_CONTEXT, WriteBytes)},
+    {_T("contextswitches"), _T("System context switches"), FIELD_OFFSET(TIMETHIS_CONTEXT, ContextSwitches)}
+};
+
+/**
+ Statistics describing the distribution of a metric across multiple runs.
+ */
+typedef struct _TIMETHIS_STATISTICS {
+
+    /**
+     The smallest value observed.
+     */
+    LONGLONG Minimum;
+
+    /**
+     The median value observed.
+     */
+    LONGLONG Median;
+
+    /**
+     The 95th percentile of values observed, using the nearest rank.
+     */
+    LONGLONG Percentile95;
+
+    /**
+     The mean of values observed.
+     */
+    LONGLONG Mean;
+
+    /**
+     The population standard deviation of values observed.
+     */
+    LONGLONG StandardDeviation;
+} TIMETHIS_STATISTICS, *PTIMETHIS_STATISTICS;
+
+/**
+ The maximum number of runs that can be summarized.  This bounds the cost of
+ sorting values and ensures the sum of squared deviations cannot overflow.
+ */
+#define TIMETHIS_MAX_RUNS (1000)
+
+/**
+ Display statistics as a human readable table.
+ */
+#define TIMETHIS_OUTPUT_TEXT (0)
+
+/**
+ Display statistics as comma separated values.
+ */
+#define TIMETHIS_OUTPUT_CSV  (1)
+
+/**
+ Display statistics as JSON.
+ */
+#define TIMETHIS_OUTPUT_JSON (2)
+
+/**
+ Calculate the integer square root of a value.
+
+ @param Value The value to calculate the square root of.
+
+ @return The largest integer whose square is less than or equal to Value.
+ */
+DWORDLONG
+TimeThisSquareRoot(
+    __in DWORDLONG Value
+    )
+{
+    DWORDLONG Result;
+    DWORDLONG Bit;
+
+    Result = 0;
+    Bit = ((DWORDLONG)1) << 62;
+    while (Bit > Value) {
+        Bit = Bit >> 2;
+    }
+
+    while (Bit != 0) {
+        if (Value >= Result + Bit) {
+            Value = Value - (Result + Bit);
+            Result = (Result >> 1) + Bit;
+        } else {
+            Result = Result >> 1;
+        }
+        Bit = Bit >> 2;
+    }
+
+    return Result;
+}
+
+/**
+ Calculate statistics for a single metric across a set of runs.
+
+ @param Runs Pointer to an array of results, one per run.
+
+ @param RunCount The number of runs.
+
+ @param Offset The offset of the metric within each TIMETHIS_CONTEXT.
+
+ @param Values Pointer to scratch space with room for RunCount values.
+
+ @param Statistics On completion, populated with statistics about the metric.
+ */
+VOID
+TimeThisCalculateStatistics(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount,
+    __in DWORD Offset,
+    __inout PLONGLONG Values,
+    __out PTIMETHIS_STATISTICS Statistics
+    )
+{
+    PLARGE_INTEGER Value;
+    LONGLONG Sum;
+    LONGLONG Deviation;
+    LONGLONG MaximumDeviation;
+    DWORDLONG SumOfSquares;
+    DWORD Shift;
+    DWORD Index;
+    DWORD Insert;
+    DWORD Rank;
+
+    ASSERT(RunCount > 0 && RunCount <= TIMETHIS_MAX_RUNS);
+
+    //
+    //  Collect the values in sorted order.  The number of runs is bounded,
+    //  so an insertion sort is sufficient.
+    //
+
+    Sum = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Value = YoriLibAddToPointer(&Runs[Index], Offset);
+        Sum = Sum + Value->QuadPart;
+        Insert = Index;
+        while (Insert > 0 && Values[Insert - 1] > Value->QuadPart) {
+            Values[Insert] = Values[Insert - 1];
+            Insert--;
+        }
+        Values[Insert] = Value->QuadPart;
+    }
+
+    Statistics->Minimum = Values[0];
+    if (RunCount % 2 == 1) {
+        Statistics->Median = Values[RunCount / 2];
+    } else {
+        Statistics->Median = (Values[RunCount / 2 - 1] + Values[RunCount / 2]) / 2;
+    }
+
+    Rank = (95 * RunCount + 99) / 100;
+    Statistics->Percentile95 = Values[Rank - 1];
+    Statistics->Mean = Sum / RunCount;
+
+    //
+    //  Large values such as byte counts could overflow when squared, so
+    //  scale deviations down until each square fits comfortably, and scale
+    //  the result back up.
+    //
+
+    MaximumDeviation = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Deviation = Values[Index] - Statistics->Mean;
+        if (Deviation < 0) {
+            Deviation = -Deviation;
+        }
+        if (Deviation > MaximumDeviation) {
+            MaximumDeviation = Deviation;
+        }
+    }
+
+    Shift = 0;
+    while ((MaximumDeviation >> Shift) >= (1 << 26)) {
+        Shift++;
+    }
+
+    SumOfSquares = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Deviation = Values[Index] - Statistics->Mean;
+        if (Deviation < 0) {
+            Deviation = -Deviation;
+        }
+        Deviation = Deviation >> Shift;
+        SumOfSquares = SumOfSquares + (DWORDLONG)(Deviation * Deviation);
+    }
+
+    Statistics->StandardDeviation = (LONGLONG)(TimeThisSquareRoot(SumOfSquares / RunCount) << Shift);
+}
+
+/**
+ Display statistics for every metric across a set of runs.
+
+ @param Runs Pointer to an array of results, one per run.
+
+ @param RunCount The number of runs.
+
+ @param WarmupCount The number of runs that were performed before measuring.
+
+ @param OutputFormat The format to display, one of the TIMETHIS_OUTPUT values.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TimeThisDisplayStatistics(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount,
+    __in DWORD WarmupCount,
+    __in DWORD OutputFormat
+    )
+{
+    TIMETHIS_STATISTICS Statistics;
+    PLONGLONG Values;
+    DWORD Index;
+    DWORD MetricCount;
+
+    Values = YoriLibMalloc(RunCount * sizeof(LONGLONG));
+    if (Values == NULL) {
+        return FALSE;
+    }
+
+    MetricCount = sizeof(TimeThisMetrics)/sizeof(TimeThisMetrics[0]);
+
+    if (OutputFormat == TIMETHIS_OUTPUT_CSV) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("metric,runs,min,median,p95,mean,stddev\n"));
+    } else if (OutputFormat == TIMETHIS_OUTPUT_JSON) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("{\n  \"runs\": %i,\n  \"warmup\": %i,\n  \"metrics\": {\n"), RunCount, WarmupCount);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Runs: %i, warmup runs: %i\n\n"), RunCount, WarmupCount);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-24s %14s %14s %14s %14s %14s\n"), _T("Metric"), _T("Min"), _T("Median"), _T("P95"), _T("Mean"), _T("StdDev"));
+    }
+
+    for (Index = 0; Index < MetricCount; Index++) {
+        TimeThisCalculateStatistics(Runs, RunCount, TimeThisMetrics[Index].Offset, Values, &Statistics);
+
+        if (OutputFormat == TIMETHIS_OUTPUT_CSV) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%s,%i,%lli,%lli,%lli,%lli,%lli\n"),
+                          TimeThisMetrics[Index].Name,
+                          RunCount,
+                          Statistics.Minimum,
+                          Statistics.Median,
+                          Statistics.Percentile95,
+                          Statistics.Mean,
+                          Statistics.StandardDeviation);
+        } else if (OutputFormat == TIMETHIS_OUTPUT_JSON) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("    \"%s\": {\"min\": %lli, \"median\": %lli, \"p95\": %lli, \"mean\": %lli, \"stddev\": %lli}%s\n"),
+                          TimeThisMetrics[Index].Name,
+                          Statistics.Minimum,
+                          Statistics.Median,
+                          Statistics.Percentile95,
+                          Statistics.Mean,
+                          Statistics.StandardDeviation,
+                          (Index + 1 < MetricCount)?_T(","):_T(""));
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%-24s %14lli %14lli %14lli %14lli %14lli\n"),
+                          TimeThisMetrics[Index].Description,
+                          Statistics.Minimum,
+                          Statistics.Median,
+                          Statistics.Percentile95,
+                          Statistics.Mean,
+                          Statistics.StandardDeviation);
+        }
+    }
+
+    if (OutputFormat == TIMETHIS_OUTPUT_JSON) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  }\n}\n"));
+    }
+
+    YoriLibFree(Values);
+    return TRUE;
+}
+
+/**
+ Return the total number of context switches performed by all processors in
+ the system.
+
+ @param ContextSwitches On successful completion, populated with the number
+        of context switches.  This value wraps, so only the difference
+        between two values is meaningful.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TimeThisGetContextSwitches(
+    __out PDWORD ContextSwitches
+    )
+{
+    PYORI_SYSTEM_INTERRUPT_INFORMATION InterruptInfo;
+    SYSTEM_INFO SystemInfo;
+    DWORD BytesReturned;
+    DWORD Index;
+    DWORD Total;
+    LONG Status;
+
+    if (DllNtDll.pNtQuerySystemInformation == NULL) {
+        return FALSE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    if (SystemInfo.dwNumberOfProcessors == 0) {
+        return FALSE;
+    }
+
+    InterruptInfo = YoriLibMalloc(SystemInfo.dwNumberOfProcessors * sizeof(YORI_SYSTEM_INTERRUPT_INFORMATION));
+    if (InterruptInfo == NULL) {
+        return FALSE;
+    }
+
+    Status = DllNtDll.pNtQuerySystemInformation(SystemInterruptInformation, InterruptInfo, SystemInfo.dwNumberOfProcessors * sizeof(YORI_SYSTEM_INTERRUPT_INFORMATION), &BytesReturned);
+    if (Status != 0) {
+        YoriLibFree(InterruptInfo);
+        return FALSE;
+    }
+
+    Total = 0;
+    for (Index = 0; Index < BytesReturned / sizeof(YORI_SYSTEM_INTERRUPT_INFORMATION); Index++) {
+        Total = Total + InterruptInfo[Index].ContextSwitches;
+    }
+
+    YoriLibFree(InterruptInfo);
+    *ContextSwitches = Total;
+    return TRUE;
+}
+
+/**
+ Execute a child process, wait for it to complete, and collect information
+ about the resources it consumed.
+
+ @param CmdLine Pointer to the command line to execute.
+
+ @param TimeThisContext On successful completion, populated with information
+        about the resources used by the child process.
+
+ @param ExitCode On successful completion, populated with the exit code of
+        the child process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TimeThisExecute(
+    __in PYORI_STRING CmdLine,
+    __out PTIMETHIS_CONTEXT TimeThisContext,
+    __out PDWORD ExitCode
+    )
+{
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    PROCESS_VM_COUNTERS VmCounters;
+    YORI_IO_COUNTERS IoCounters;
+    HANDLE hJob;
+    FILETIME ftCreationTime;
+    FILETIME ftExitTime;
+    FILETIME ftKernelTime;
+    FILETIME ftUserTime;
+    LARGE_INTEGER liCreationTime;
+    LARGE_INTEGER liExitTime;
+    DWORD ContextSwitchesBefore;
+    DWORD ContextSwitchesAfter;
+    BOOL ContextSwitchesValid;
+    DWORD BytesReturned;
+    DWORDLONG Cycles;
+
+    ZeroMemory(TimeThisContext, sizeof(TIMETHIS_CONTEXT));
+
+    hJob = YoriLibCreateJobObject();
+
+    memset(&StartupInfo, 0, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    ContextSwitchesValid = TimeThisGetContextSwitches(&ContextSwitchesBefore);
+
+    if (!CreateProcess(NULL, CmdLine->StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        if (hJob != NULL) {
+            CloseHandle(hJob);
+        }
+        return FALSE;
+    }
+
+    if (hJob != NULL) {
+        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
+    }
+
+    ResumeThread(ProcessInfo.hThread);
+
+    //
+    //  Wait for the immediate child process to terminate.
+    //
+
+#if YORI_BUILTIN
+    {
+        HANDLE HandleArray[2];
+        DWORD WaitResult;
+
+        HandleArray[1] = YoriLibCancelGetEvent();
+        HandleArray[0] = ProcessInfo.hProcess;
+
+        WaitResult = WaitForMultipleObjects(2, HandleArray, FALSE, INFINITE);
+
+        //
+        //  If cancelled, abort
+        //
+
+        if (WaitResult == WAIT_OBJECT_0 + 1) {
+            CloseHandle(ProcessInfo.hProcess);
+            CloseHandle(ProcessInfo.hThread);
+            if (hJob != NULL) {
+                CloseHandle(hJob);
+            }
+
+            return FALSE;
+        }
+    }
+#else
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+#endif
+
+    if (ContextSwitchesValid &&
+        TimeThisGetContextSwitches(&ContextSwitchesAfter)) {
+
+        TimeThisContext->ContextSwitches.QuadPart = (DWORD)(ContextSwitchesAfter - ContextSwitchesBefore);
+    }
+
+    GetExitCodeProcess(ProcessInfo.hProcess, ExitCode);
+
+    //
+    //  Save off times from the child process.
+    //
+
+    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
+
+    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
+    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
+    liExitTime.HighPart = ftExitTime.dwHighDateTime;
+    liExitTime.LowPart = ftExitTime.dwLowDateTime;
+    TimeThisContext->KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
+    TimeThisContext->KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
+    TimeThisContext->KernelTimeInMs.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart / (10 * 1000);
+    TimeThisContext->UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
+    TimeThisContext->UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
+    TimeThisContext->UserTimeInMs.QuadPart = TimeThisContext->UserTimeInMs.QuadPart / (10 * 1000);
+    TimeThisContext->CpuTimeInMs.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart + TimeThisContext->UserTimeInMs.QuadPart;
+
+    TimeThisContext->WallTimeInMs.QuadPart = (liExitTime.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
+
+    //
+    //  Save off memory and processor cycle usage from the child process.
+    //  Page faults and IO are reported for the immediate child unless the
+    //  job can report them for the whole tree below.
+    //
+
+    if (DllNtDll.pNtQueryInformationProcess != NULL &&
+        DllNtDll.pNtQueryInformationProcess(ProcessInfo.hProcess, ProcessVmCounters, &VmCounters, sizeof(VmCounters), &BytesReturned) == 0) {
+
+        TimeThisContext->ChildPeakWorkingSet.QuadPart = VmCounters.PeakWorkingSetSize;
+        TimeThisContext->PageFaults.QuadPart = VmCounters.PageFaultCount;
+    }
+
+    if (DllKernel32.pQueryProcessCycleTime != NULL &&
+        DllKernel32.pQueryProcessCycleTime(ProcessInfo.hProcess, &Cycles)) {
+
+        TimeThisContext->ChildCycles.QuadPart = Cycles;
+    }
+
+    if (DllKernel32.pGetProcessIoCounters != NULL &&
+        DllKernel32.pGetProcessIoCounters(ProcessInfo.hProcess, &IoCounters)) {
+
+        TimeThisContext->ReadOperations.QuadPart = IoCounters.ReadOperations;
+        TimeThisContext->WriteOperations.QuadPart = IoCounters.WriteOperations;
+        TimeThisContext->ReadBytes.QuadPart = IoCounters.ReadBytes;
+        TimeThisContext->WriteBytes.QuadPart = IoCounters.WriteBytes;
+    }
+
+    //
+    //  Save off times from all processes within the job, if it exists.
+    //  Note that currently we're not waiting for all processes within the
+    //  job to terminate.
+    //
+
+    TimeThisContext->KernelTimeTreeInMs.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart;
+    TimeThisContext->UserTimeTreeInMs.QuadPart = TimeThisContext->UserTimeInMs.QuadPart;
+
+    if (hJob != NULL) {
+        YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION JobInfo;
+
+        if (DllKernel32.pQueryInformationJobObject != NULL &&
+            DllKernel32.pQueryInformationJobObject(hJob, 8, &JobInfo, sizeof(JobInfo), &BytesReturned)) {
+
+            TimeThisContext->KernelTimeTreeInMs.QuadPart = JobInfo.BasicInfo.TotalKernelTime.QuadPart / (10 * 1000);
+            TimeThisContext->UserTimeTreeInMs.QuadPart = JobInfo.BasicInfo.TotalUserTime.QuadPart / (10 * 1000);
+            TimeThisContext->PageFaults.QuadPart = JobInfo.BasicInfo.TotalPageFaultCount;
+            TimeThisContext->ReadOperations.QuadPart = JobInfo.IoInfo.ReadOperations;
+            TimeThisContext->WriteOperations.QuadPart = JobInfo.IoInfo.WriteOperations;
+            TimeThisContext->ReadBytes.QuadPart = JobInfo.IoInfo.ReadBytes;
+            TimeThisContext->WriteBytes.QuadPart = JobInfo.IoInfo.WriteBytes;
+        }
+        CloseHandle(hJob);
+    }
+
+    TimeThisContext->CpuTimeTreeInMs.QuadPart = TimeThisContext->KernelTimeTreeInMs.QuadPart + TimeThisContext->UserTimeTreeInMs.QuadPart;
+
+    CloseHandle(ProcessInfo.hProcess);
+    CloseHandle(ProcessInfo.hThread);
+
+    return TRUE;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the timethis builtin command.
@@ -285,35 +918,48 @@ ENTRYPOINT(
     YORI_STRING CmdLine;
     DWORD ExitCode;
     BOOL ArgumentUnderstood;
-    DWORD StartArg = 1;
+    DWORD StartArg = 0;
     DWORD i;
     YORI_STRING Arg;
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
-    TIMETHIS_CONTEXT TimeThisContext;
+    PTIMETHIS_CONTEXT Runs;
     YORI_STRING Executable;
     PYORI_STRING ChildArgs;
-    PROCESS_INFORMATION ProcessInfo;
-    STARTUPINFO StartupInfo;
-    HANDLE hJob;
-    FILETIME ftCreationTime;
-    FILETIME ftExitTime;
-    FILETIME ftKernelTime;
-    FILETIME ftUserTime;
-
-    LARGE_INTEGER liCreationTime;
-    LARGE_INTEGER liExitTime;
+    DWORD RunCount;
+    DWORD WarmupCount;
+    DWORD OutputFormat;
+    DWORD RunIndex;
+    BOOL FormatSpecified;
+    BOOL RepeatSpecified;
+    BOOL WarmupSpecified;
+    BOOL OutputFormatSpecified;
+    BOOL Success;
+    LONGLONG llTemp;
+    DWORD CharsConsumed;
     LPTSTR DefaultFormatString = _T("Elapsed time:      $ELAPSEDTIME$\n")
                                  _T("Child CPU time:    $CHILDCPU$\n")
                                  _T("Child kernel time: $CHILDKERNEL$\n")
                                  _T("Child user time:   $CHILDUSER$\n")
                                  _T("Tree CPU time:     $TREECPU$\n")
                                  _T("Tree kernel time:  $TREEKERNEL$\n")
-                                 _T("Tree user time:    $TREEUSER$\n");
+                                 _T("Tree user time:    $TREEUSER$\n")
+                                 _T("Child peak WS:     $CHILDPEAKWS$ bytes\n")
+                                 _T("Page faults:       $PAGEFAULTS$\n")
+                                 _T("Reads:             $READOPS$ ($READBYTES$ bytes)\n")
+                                 _T("Writes:            $WRITEOPS$ ($WRITEBYTES$ bytes)\n");
 
     YoriLibInitEmptyString(&AllocatedFormatString);
     YoriLibConstantString(&AllocatedFormatString, DefaultFormatString);
 
+    RunCount = 1;
+    WarmupCount = 0;
+    OutputFormat = TIMETHIS_OUTPUT_TEXT;
+    FormatSpecified = FALSE;
+    RepeatSpecified = FALSE;
+    WarmupSpecified = FALSE;
+    OutputFormatSpecified = FALSE;
+
     for (i = 1; i < ArgC; i++) {
 
         ArgumentUnderstood = FALSE;
@@ -331,9 +977,50 @@ ENTRYPOINT(
                 if (ArgC > i + 1) {
                     YoriLibFreeStringContents(&AllocatedFormatString);
                     YoriLibCloneString(&AllocatedFormatString, &ArgV[i + 1]);
+                    FormatSpecified = TRUE;
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("o")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("csv")) == 0) {
+                        OutputFormat = TIMETHIS_OUTPUT_CSV;
+                        OutputFormatSpecified = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("json")) == 0) {
+                        OutputFormat = TIMETHIS_OUTPUT_JSON;
+                        OutputFormatSpecified = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0 &&
+                        llTemp <= TIMETHIS_MAX_RUNS) {
+
+                        RunCount = (DWORD)llTemp;
+                        RepeatSpecified = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("w")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp >= 0 &&
+                        llTemp <= TIMETHIS_MAX_RUNS) {
+
+                        WarmupCount = (DWORD)llTemp;
+                        WarmupSpecified = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -346,11 +1033,32 @@ ENTRYPOINT(
         }
     }
 
-    if (StartArg == 0) {
+    if (StartArg == 0 || StartArg == ArgC) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: missing argument\n"));
+        YoriLibFreeStringContents(&AllocatedFormatString);
         return EXIT_FAILURE;
     }
 
+    //
+    //  A format describes a single run, and statistics have their own
+    //  layout, so a format cannot be combined with statistics.
+    //
+
+    if (FormatSpecified && (RepeatSpecified || OutputFormatSpecified)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: -f cannot be combined with -o or -r\n"));
+        YoriLibFreeStringContents(&AllocatedFormatString);
+        return EXIT_FAILURE;
+    }
+
+    //
+    //  When repeating, perform a warmup run by default so the measured runs
+    //  are not skewed by a cold file cache.
+    //
+
+    if (RepeatSpecified && !WarmupSpecified) {
+        WarmupCount = 1;
+    }
+
     ChildArgs = YoriLibMalloc((ArgC - StartArg) * sizeof(YORI_STRING));
     if (ChildArgs == NULL) {
         YoriLibFreeStringContents(&AllocatedFormatString);
@@ -381,123 +1089,61 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    ASSERT(YoriLibIsStringNullTerminated(&CmdLine));
-
-    hJob = YoriLibCreateJobObject();
+    YoriLibFreeStringContents(&Executable);
+    YoriLibFree(ChildArgs);
 
-    memset(&StartupInfo, 0, sizeof(StartupInfo));
-    StartupInfo.cb = sizeof(StartupInfo);
+    ASSERT(YoriLibIsStringNullTerminated(&CmdLine));
 
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED, NULL, NULL, &StartupInfo, &ProcessInfo)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(ChildArgs);
+    Runs = YoriLibMalloc(RunCount * sizeof(TIMETHIS_CONTEXT));
+    if (Runs == NULL) {
         YoriLibFreeStringContents(&CmdLine);
-        YoriLibFreeStringContents(&Executable);
         YoriLibFreeStringContents(&AllocatedFormatString);
-        if (hJob != NULL) {
-            CloseHandle(hJob);
-        }
         return EXIT_FAILURE;
     }
 
-    if (hJob != NULL) {
-        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
-    }
-
-    ResumeThread(ProcessInfo.hThread);
-
-    YoriLibFreeStringContents(&Executable);
-    YoriLibFreeStringContents(&CmdLine);
-    YoriLibFree(ChildArgs);
-
-    //
-    //  Wait for the immediate child process to terminate.
-    //
-
 #if YORI_BUILTIN
-    {
-        HANDLE HandleArray[2];
-        DWORD WaitResult;
-
-        YoriLibCancelEnable();
-        HandleArray[1] = YoriLibCancelGetEvent();
-        HandleArray[0] = ProcessInfo.hProcess;
-
-        WaitResult = WaitForMultipleObjects(2, HandleArray, FALSE, INFINITE);
-
-        //
-        //  If cancelled, abort
-        //
-
-        if (WaitResult == WAIT_OBJECT_0 + 1) {
-            CloseHandle(ProcessInfo.hProcess);
-            CloseHandle(ProcessInfo.hThread);
-            if (hJob != NULL) {
-                CloseHandle(hJob);
-            }
-            YoriLibFreeStringContents(&AllocatedFormatString);
-
-            return EXIT_FAILURE;
-        }
-    }
-#else
-    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+    YoriLibCancelEnable();
 #endif
-    GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode);
 
     //
-    //  Save off times from the child process.
+    //  Warmup runs are recorded into the first entry, which is overwritten
+    //  by the first measured run.
     //
 
-    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
-
-    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
-    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
-    liExitTime.HighPart = ftExitTime.dwHighDateTime;
-    liExitTime.LowPart = ftExitTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
-    TimeThisContext.KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart / (10 * 1000);
-    TimeThisContext.UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
-    TimeThisContext.UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
-    TimeThisContext.UserTimeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart / (10 * 1000);
-
-    TimeThisContext.WallTimeInMs.QuadPart = (liExitTime.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
-
-    //
-    //  Save off times from all processes within the job, if it exists.
-    //  Note that currently we're not waiting for all processes within the
-    //  job to terminate.
-    //
+    Success = TRUE;
+    ExitCode = EXIT_FAILURE;
+    for (RunIndex = 0; RunIndex < WarmupCount + RunCount; RunIndex++) {
+        if (RunIndex > 0 && YoriLibIsOperationCancelled()) {
+            Success = FALSE;
+            break;
+        }
 
-    TimeThisContext.KernelTimeTreeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart;
-    TimeThisContext.UserTimeTreeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart;
+        if (!TimeThisExecute(&CmdLine, &Runs[(RunIndex < WarmupCount)?0:(RunIndex - WarmupCount)], &ExitCode)) {
+            Success = FALSE;
+            break;
+        }
+    }
 
-    if (hJob != NULL) {
-        YORI_JOB_BASIC_ACCOUNTING_INFORMATION JobInfo;
-        DWORD BytesReturned;
+    YoriLibFreeStringContents(&CmdLine);
 
-        if (DllKernel32.pQueryInformationJobObject != NULL &&
-            DllKernel32.pQueryInformationJobObject(hJob, 1, &JobInfo, sizeof(JobInfo), &BytesReturned)) {
+    if (!Success) {
+        YoriLibFree(Runs);
+        YoriLibFreeStringContents(&AllocatedFormatString);
+        return EXIT_FAILURE;
+    }
 
-            TimeThisContext.KernelTimeTreeInMs.QuadPart = JobInfo.TotalKernelTime.QuadPart / (10 * 1000);
-            TimeThisContext.UserTimeTreeInMs.QuadPart = JobInfo.TotalUserTime.QuadPart / (10 * 1000);
+    if (RepeatSpecified || OutputFormatSpecified) {
+        TimeThisDisplayStatistics(Runs, RunCount, WarmupCount, OutputFormat);
+    } else {
+        YoriLibInitEmptyString(&DisplayString);
+        YoriLibExpandCommandVariables(&AllocatedFormatString, '$', FALSE, TimeThisExpandVariables, &Runs[0], &DisplayString);
+        if (DisplayString.StartOfString != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            YoriLibFreeStringContents(&DisplayString);
         }
-        CloseHandle(hJob);
     }
 
-    CloseHandle(ProcessInfo.hProcess);
-    CloseHandle(ProcessInfo.hThread);
-
-    YoriLibInitEmptyString(&DisplayString);
-    YoriLibExpandCommandVariables(&AllocatedFormatString, '$', FALSE, TimeThisExpandVariables, &TimeThisContext, &DisplayString);
-    if (DisplayString.StartOfString != NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
-        YoriLibFreeStringContents(&DisplayString);
-    }
+    YoriLibFree(Runs);
     YoriLibFreeStringContents(&AllocatedFormatString);
 
     return ExitCode;
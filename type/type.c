@@ -35,11 +35,12 @@ CHAR strTypeHelpText[] =
         "\n"
         "Output the contents of one or more files.\n"
         "\n"
-        "TYPE [-license] [-b] [-s] [-h <num>] [-n] [<file>...]\n"
+        "TYPE [-license] [-b] [-s] [-h <num>] [-n] [-r] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -h <num>       Display <num> lines from the beginning of each file\n"
         "   -n             Display line numbers\n"
+        "   -r             Copy raw bytes without encoding or line translation\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -71,6 +72,12 @@ typedef struct _TYPE_CONTEXT {
      */
     BOOLEAN DisplayLineNumbers;
 
+    /**
+     TRUE to indicate that file contents should be copied to the output
+     without any encoding or line ending translation.
+     */
+    BOOLEAN RawOutput;
+
     /**
      The first error encountered when enumerating objects from a single arg.
      This is used to preserve file not found/path not found errors so that
@@ -140,6 +147,18 @@ TypeProcessStream(
         OutputIsConsole = TRUE;
     }
 
+    //
+    //  If no line processing is needed, copy the stream so that the next
+    //  read can proceed while the previous write is outstanding.
+    //
+
+    if (TypeContext->RawOutput &&
+        !TypeContext->DisplayLineNumbers &&
+        TypeContext->HeadLines == 0) {
+
+        return YoriLibPipePump(hSource, 1, &OutputHandle, NULL);
+    }
+
     while (TRUE) {
 
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
@@ -382,6 +401,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("n")) == 0) {
                 TypeContext.DisplayLineNumbers = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                TypeContext.RawOutput = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
                 TypeContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -0,0 +1,1676 @@
+/**
+ * @file ybench/ybench.c
+ *
+ * Yori micro-benchmarks for commonly used library routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "yoristru.h"
+#include "yoriproc.h"
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strYBenchHelpText[] =
+        "\n"
+        "Measures the performance of commonly used library routines.\n"
+        "\n"
+        "YBENCH [-license] [-c <file>] [-i <count>] [-l] [-r <percent>] [-s <file>]\n"
+        "       [-size <chars>] [-t <ms>] [<test>...]\n"
+        "\n"
+        "   -c <file>      Compare results against a previously saved baseline file\n"
+        "   -i <count>     Run each test for exactly count operations\n"
+        "   -l             List available tests\n"
+        "   -r <percent>   Slowdown to report as a regression, default 10\n"
+        "   -s <file>      Save results to a baseline file\n"
+        "   -size <chars>  The size of the synthetic input to each test, default 4096\n"
+        "   -t <ms>        The minimum time to run each test, default 500\n"
+        "\n"
+        "Each operation processes the synthetic input once.  If a baseline is\n"
+        "specified and any test is slower or allocates more than the baseline,\n"
+        "the process exits with failure.  Allocations are only counted by debug\n"
+        "builds.\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+YBenchHelp()
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("YBench %i.%02i\n"), YBENCH_VER_MAJOR, YBENCH_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strYBenchHelpText);
+    return TRUE;
+}
+
+/**
+ The default number of characters in the synthetic input to each test.
+ */
+#define YBENCH_DEFAULT_INPUT_SIZE (4096)
+
+/**
+ The default minimum number of milliseconds to run each test for.
+ */
+#define YBENCH_DEFAULT_MINIMUM_TIME (500)
+
+/**
+ The default percentage slowdown that is reported as a regression.
+ */
+#define YBENCH_DEFAULT_REGRESSION_PERCENT (10)
+
+/**
+ The number of characters in each key inserted into the hash table.
+ */
+#define YBENCH_HASH_KEY_LENGTH (12)
+
+/**
+ The number of characters of input that correspond to each file created for
+ the enumeration test.
+ */
+#define YBENCH_CHARS_PER_FILE (64)
+
+/**
+ The number of characters of input that correspond to each substring that
+ is searched for in the substring test.
+ */
+#define YBENCH_CHARS_PER_MATCH (512)
+
+/**
+ State used by the tests.  Each test populates the parts it needs when it is
+ prepared and releases them when it is cleaned up.
+ */
+typedef struct _YBENCH_CONTEXT {
+
+    /**
+     The number of characters in the synthetic input.
+     */
+    DWORD InputSize;
+
+    /**
+     The number of bytes processed by each operation.  This is set by the
+     test when it is prepared.
+     */
+    LONGLONG BytesPerOp;
+
+    /**
+     A synthetic input string.
+     */
+    YORI_STRING Input;
+
+    /**
+     A string for tests to write output to.  This is retained across
+     operations.
+     */
+    YORI_STRING Output;
+
+    /**
+     A path to a temporary file or directory created by the test.
+     */
+    YORI_STRING TempPath;
+
+    /**
+     A handle to a temporary file created by the test.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The number of entries in the Strings array.
+     */
+    DWORD StringCount;
+
+    /**
+     An array of strings used as hash keys, substrings to search for, or
+     file names.
+     */
+    PYORI_STRING Strings;
+
+    /**
+     An array of hash entries, one per string.
+     */
+    PYORI_HASH_ENTRY HashEntries;
+
+    /**
+     The hash table used by the hash lookup test.
+     */
+    PYORI_HASH_TABLE HashTable;
+
+    /**
+     The number of lines or files that each operation is expected to find.
+     */
+    DWORD ItemsExpected;
+
+    /**
+     The number of lines or files found by the most recent operation.
+     */
+    DWORD ItemsFound;
+
+    /**
+     The offset to pass when parsing a command line.  Zero allows the parse
+     cache to be used.
+     */
+    DWORD ParseOffset;
+
+} YBENCH_CONTEXT, *PYBENCH_CONTEXT;
+
+/**
+ A prototype for a function to prepare a test.
+ */
+typedef BOOL YBENCH_PREPARE_FN(PYBENCH_CONTEXT Context);
+
+/**
+ A pointer to a function to prepare a test.
+ */
+typedef YBENCH_PREPARE_FN *PYBENCH_PREPARE_FN;
+
+/**
+ A prototype for a function to perform one operation of a test.
+ */
+typedef BOOL YBENCH_RUN_FN(PYBENCH_CONTEXT Context);
+
+/**
+ A pointer to a function to perform one operation of a test.
+ */
+typedef YBENCH_RUN_FN *PYBENCH_RUN_FN;
+
+/**
+ A prototype for a function to clean up after a test.
+ */
+typedef VOID YBENCH_CLEANUP_FN(PYBENCH_CONTEXT Context);
+
+/**
+ A pointer to a function to clean up after a test.
+ */
+typedef YBENCH_CLEANUP_FN *PYBENCH_CLEANUP_FN;
+
+/**
+ A description of a single test.
+ */
+typedef struct _YBENCH_TEST {
+
+    /**
+     The name of the test, as specified on the command line and recorded in
+     baseline files.
+     */
+    LPCTSTR Name;
+
+    /**
+     The routine that is being measured.
+     */
+    LPCTSTR Description;
+
+    /**
+     A function to prepare the test.
+     */
+    PYBENCH_PREPARE_FN Prepare;
+
+    /**
+     A function to perform one operation.
+     */
+    PYBENCH_RUN_FN Run;
+
+    /**
+     A function to clean up after the test.
+     */
+    PYBENCH_CLEANUP_FN Cleanup;
+} YBENCH_TEST, *PYBENCH_TEST;
+
+/**
+ The measurements collected from running a single test.
+ */
+typedef struct _YBENCH_RESULT {
+
+    /**
+     The number of operations performed.
+     */
+    LONGLONG Operations;
+
+    /**
+     The number of nanoseconds taken to perform all operations.
+     */
+    LONGLONG Nanoseconds;
+
+    /**
+     The number of bytes processed by all operations.
+     */
+    LONGLONG Bytes;
+
+    /**
+     The number of allocations performed by all operations.
+     */
+    LONGLONG Allocations;
+
+    /**
+     TRUE if allocations were counted.  Allocations are only counted by
+     debug builds of the library.
+     */
+    BOOL AllocationsCounted;
+} YBENCH_RESULT, *PYBENCH_RESULT;
+
+/**
+ Populate the synthetic input string by repeating a pattern until the input
+ is the requested size.
+
+ @param Context Pointer to the benchmark context.
+
+ @param Pattern The pattern to repeat.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchFillInput(
+    __in PYBENCH_CONTEXT Context,
+    __in LPCTSTR Pattern
+    )
+{
+    DWORD Index;
+    DWORD PatternLength;
+
+    if (!YoriLibAllocateString(&Context->Input, Context->InputSize + 1)) {
+        return FALSE;
+    }
+
+    PatternLength = (DWORD)_tcslen(Pattern);
+    for (Index = 0; Index < Context->InputSize; Index++) {
+        Context->Input.StartOfString[Index] = Pattern[Index % PatternLength];
+    }
+    Context->Input.StartOfString[Index] = '\0';
+    Context->Input.LengthInChars = Index;
+    Context->BytesPerOp = Context->InputSize * sizeof(TCHAR);
+    return TRUE;
+}
+
+/**
+ Allocate an array of strings, each of which has a fixed sized buffer.
+
+ @param Context Pointer to the benchmark context.
+
+ @param Count The number of strings to allocate.
+
+ @param CharsPerString The number of characters in each string.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchAllocateStrings(
+    __in PYBENCH_CONTEXT Context,
+    __in DWORD Count,
+    __in DWORD CharsPerString
+    )
+{
+    LPTSTR Buffer;
+    DWORD Index;
+
+    Context->Strings = YoriLibMalloc(Count * (sizeof(YORI_STRING) + CharsPerString * sizeof(TCHAR)));
+    if (Context->Strings == NULL) {
+        return FALSE;
+    }
+
+    Buffer = (LPTSTR)(Context->Strings + Count);
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibInitEmptyString(&Context->Strings[Index]);
+        Context->Strings[Index].StartOfString = &Buffer[Index * CharsPerString];
+        Context->Strings[Index].LengthAllocated = CharsPerString;
+    }
+    Context->StringCount = Count;
+    return TRUE;
+}
+
+/**
+ Create a temporary file name in the temporary directory.  The file is
+ created by the system as part of generating a unique name.
+
+ @param Context Pointer to the benchmark context.  On success, TempPath is
+        updated to contain the name of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchCreateTempName(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    YORI_STRING TempDir;
+
+    YoriLibInitEmptyString(&TempDir);
+    TempDir.LengthAllocated = GetTempPath(0, NULL);
+    if (!YoriLibAllocateString(&TempDir, TempDir.LengthAllocated)) {
+        return FALSE;
+    }
+    TempDir.LengthInChars = GetTempPath(TempDir.LengthAllocated, TempDir.StartOfString);
+    if (TempDir.LengthInChars == 0 || TempDir.LengthInChars >= TempDir.LengthAllocated) {
+        YoriLibFreeStringContents(&TempDir);
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Context->TempPath, MAX_PATH)) {
+        YoriLibFreeStringContents(&TempDir);
+        return FALSE;
+    }
+
+    if (GetTempFileName(TempDir.StartOfString, _T("ybn"), 0, Context->TempPath.StartOfString) == 0) {
+        YoriLibFreeStringContents(&TempDir);
+        YoriLibFreeStringContents(&Context->TempPath);
+        return FALSE;
+    }
+
+    Context->TempPath.LengthInChars = _tcslen(Context->TempPath.StartOfString);
+    YoriLibFreeStringContents(&TempDir);
+    return TRUE;
+}
+
+/**
+ Prepare the line reading test by writing lines of text to a temporary file.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareReadLine(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    LPCSTR Pattern = "The quick brown fox jumps over the lazy dog 0123456789\r\n";
+    DWORD PatternLength;
+    PUCHAR Buffer;
+    DWORD Index;
+    DWORD BytesWritten;
+
+    if (!YBenchCreateTempName(Context)) {
+        return FALSE;
+    }
+
+    Context->FileHandle = CreateFile(Context->TempPath.StartOfString,
+                                     GENERIC_READ | GENERIC_WRITE,
+                                     0,
+                                     NULL,
+                                     CREATE_ALWAYS,
+                                     FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                                     NULL);
+
+    if (Context->FileHandle == INVALID_HANDLE_VALUE) {
+        Context->FileHandle = NULL;
+        DeleteFile(Context->TempPath.StartOfString);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(Context->InputSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    PatternLength = (DWORD)strlen(Pattern);
+    for (Index = 0; Index < Context->InputSize; Index++) {
+        Buffer[Index] = Pattern[Index % PatternLength];
+    }
+
+    if (!WriteFile(Context->FileHandle, Buffer, Context->InputSize, &BytesWritten, NULL) ||
+        BytesWritten != Context->InputSize) {
+
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    YoriLibFree(Buffer);
+    Context->BytesPerOp = Context->InputSize;
+    Context->ItemsExpected = (Context->InputSize + PatternLength - 1) / PatternLength;
+    return TRUE;
+}
+
+/**
+ Read every line from the temporary file.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunReadLine(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    PVOID LineContext;
+    BOOL LineTerminated;
+    BOOL TimeoutReached;
+
+    if (SetFilePointer(Context->FileHandle, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
+        return FALSE;
+    }
+
+    LineContext = NULL;
+    Context->ItemsFound = 0;
+    while (YoriLibReadLineToStringEx(&Context->Output, &LineContext, TRUE, INFINITE, Context->FileHandle, &LineTerminated, &TimeoutReached)) {
+        Context->ItemsFound++;
+    }
+
+    YoriLibLineReadClose(LineContext);
+    if (Context->ItemsFound != Context->ItemsExpected) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Prepare the hash lookup test by inserting keys into a hash table.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareHash(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Count;
+    DWORD Index;
+
+    Count = Context->InputSize / YBENCH_HASH_KEY_LENGTH;
+    if (Count == 0) {
+        Count = 1;
+    }
+
+    if (!YBenchAllocateStrings(Context, Count, YBENCH_HASH_KEY_LENGTH + 1)) {
+        return FALSE;
+    }
+
+    Context->HashEntries = YoriLibMalloc(Count * sizeof(YORI_HASH_ENTRY));
+    if (Context->HashEntries == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(Context->HashEntries, Count * sizeof(YORI_HASH_ENTRY));
+
+    Context->HashTable = YoriLibAllocateHashTable(1000);
+    if (Context->HashTable == NULL) {
+        return FALSE;
+    }
+
+    Context->BytesPerOp = 0;
+    for (Index = 0; Index < Count; Index++) {
+        Context->Strings[Index].LengthInChars = YoriLibSPrintfS(Context->Strings[Index].StartOfString, Context->Strings[Index].LengthAllocated, _T("Key%09x"), Index * 2654435761);
+        if (!YoriLibHashInsertByKey(Context->HashTable, &Context->Strings[Index], NULL, &Context->HashEntries[Index])) {
+            return FALSE;
+        }
+        Context->BytesPerOp += Context->Strings[Index].LengthInChars * sizeof(TCHAR);
+    }
+
+    return TRUE;
+}
+
+/**
+ Look up every key in the hash table.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunHash(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Context->StringCount; Index++) {
+        if (YoriLibHashLookupByKey(Context->HashTable, &Context->Strings[Index]) != &Context->HashEntries[Index]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ Prepare the substring test by creating an input string and a set of
+ substrings to find, of which only the last is present, at the end of the
+ input.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareSubstring(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Count;
+    DWORD Index;
+    YORI_STRING Last;
+
+    if (!YBenchFillInput(Context, _T("Lorem ipsum dolor sit amet, consectetur adipiscing elit. "))) {
+        return FALSE;
+    }
+
+    Count = Context->InputSize / YBENCH_CHARS_PER_MATCH;
+    if (Count == 0) {
+        Count = 1;
+    }
+
+    if (!YBenchAllocateStrings(Context, Count, 16)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Count - 1; Index++) {
+        Context->Strings[Index].LengthInChars = YoriLibSPrintfS(Context->Strings[Index].StartOfString, Context->Strings[Index].LengthAllocated, _T("amet %i"), Index);
+    }
+
+    //
+    //  The final substring is the end of the input, so every search
+    //  succeeds after scanning the whole input.
+    //
+
+    YoriLibInitEmptyString(&Last);
+    Last.LengthInChars = 8;
+    if (Last.LengthInChars > Context->Input.LengthInChars) {
+        Last.LengthInChars = Context->Input.LengthInChars;
+    }
+    Last.StartOfString = &Context->Input.StartOfString[Context->Input.LengthInChars - Last.LengthInChars];
+    memcpy(Context->Strings[Count - 1].StartOfString, Last.StartOfString, Last.LengthInChars * sizeof(TCHAR));
+    Context->Strings[Count - 1].LengthInChars = Last.LengthInChars;
+
+    return TRUE;
+}
+
+/**
+ Search the input for the first matching substring.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunSubstring(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Offset;
+
+    if (YoriLibFindFirstMatchingSubstring(&Context->Input, Context->StringCount, Context->Strings, &Offset) == NULL) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Prepare the formatting test by allocating an output buffer.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareSPrintf(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    if (!YoriLibAllocateString(&Context->Output, Context->InputSize + 64)) {
+        return FALSE;
+    }
+    Context->BytesPerOp = Context->InputSize * sizeof(TCHAR);
+    return TRUE;
+}
+
+/**
+ Format a string into a buffer via YoriLibVSPrintf.
+
+ @param Dest Pointer to the buffer to format into.
+
+ @param Length The number of characters in the buffer.
+
+ @param Format The format string.
+
+ @return The number of characters written, or -1 on failure.
+ */
+int
+YBenchSPrintf(
+    __out_ecount(Length) LPTSTR Dest,
+    __in DWORD Length,
+    __in LPCTSTR Format,
+    ...
+    )
+{
+    va_list Marker;
+    int Result;
+
+    va_start(Marker, Format);
+    Result = YoriLibVSPrintf(Dest, Length, Format, Marker);
+    va_end(Marker);
+    return Result;
+}
+
+/**
+ Fill the output buffer with formatted text.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunSPrintf(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Index;
+    int Written;
+
+    Index = 0;
+    while (Context->Output.LengthInChars < Context->InputSize) {
+        Written = YBenchSPrintf(&Context->Output.StartOfString[Context->Output.LengthInChars],
+                                Context->Output.LengthAllocated - Context->Output.LengthInChars,
+                                _T("%s=%i:%08x;"),
+                                _T("Item"),
+                                Index,
+                                Index);
+        if (Written <= 0) {
+            return FALSE;
+        }
+        Context->Output.LengthInChars += (DWORD)Written;
+        Index++;
+    }
+    Context->Output.LengthInChars = 0;
+    return TRUE;
+}
+
+/**
+ Prepare the variable expansion test by creating an input string containing
+ variables.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareExpand(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    return YBenchFillInput(Context, _T("Text with a $VARIABLE$ and an ^$escape in it, "));
+}
+
+/**
+ Expand a single variable found by YoriLibExpandCommandVariables.
+
+ @param OutputBuffer The buffer to populate with the expanded value.
+
+ @param VariableName The name of the variable to expand.
+
+ @param Context Unused.
+
+ @return The number of characters populated, or the number of characters
+         required if the buffer is too small.
+ */
+DWORD
+YBenchExpandVariable(
+    __inout PYORI_STRING OutputBuffer,
+    __in PYORI_STRING VariableName,
+    __in PVOID Context
+    )
+{
+    LPCTSTR Value = _T("expanded value");
+    DWORD ValueLength;
+
+    UNREFERENCED_PARAMETER(VariableName);
+    UNREFERENCED_PARAMETER(Context);
+
+    ValueLength = _tcslen(Value);
+    if (OutputBuffer->LengthAllocated < ValueLength) {
+        return ValueLength;
+    }
+
+    memcpy(OutputBuffer->StartOfString, Value, ValueLength * sizeof(TCHAR));
+    OutputBuffer->LengthInChars = ValueLength;
+    return ValueLength;
+}
+
+/**
+ Expand the variables in the input string.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunExpand(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    YORI_STRING Expanded;
+
+    YoriLibInitEmptyString(&Expanded);
+    if (!YoriLibExpandCommandVariables(&Context->Input, '$', FALSE, YBenchExpandVariable, NULL, &Expanded)) {
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&Expanded);
+    return TRUE;
+}
+
+/**
+ Remove the files and directory created for the enumeration test.
+
+ @param Context Pointer to the benchmark context.
+ */
+VOID
+YBenchCleanupForEachFile(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Context->StringCount; Index++) {
+        if (Context->Strings[Index].LengthInChars > 0) {
+            DeleteFile(Context->Strings[Index].StartOfString);
+        }
+    }
+
+    if (Context->TempPath.LengthInChars > 0) {
+        RemoveDirectory(Context->TempPath.StartOfString);
+    }
+}
+
+/**
+ Prepare the enumeration test by creating a temporary directory containing
+ files.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareForEachFile(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    DWORD Count;
+    DWORD Index;
+    DWORD CharsPerString;
+    HANDLE FileHandle;
+
+    Count = Context->InputSize / YBENCH_CHARS_PER_FILE;
+    if (Count == 0) {
+        Count = 1;
+    }
+
+    if (!YBenchCreateTempName(Context)) {
+        return FALSE;
+    }
+
+    DeleteFile(Context->TempPath.StartOfString);
+    if (!CreateDirectory(Context->TempPath.StartOfString, NULL)) {
+        Context->TempPath.LengthInChars = 0;
+        return FALSE;
+    }
+
+    CharsPerString = Context->TempPath.LengthInChars + sizeof("\\file00000000.txt");
+    if (!YBenchAllocateStrings(Context, Count, CharsPerString)) {
+        return FALSE;
+    }
+
+    Context->BytesPerOp = 0;
+    for (Index = 0; Index < Count; Index++) {
+        FileHandle = INVALID_HANDLE_VALUE;
+        if (YoriLibSPrintfS(Context->Strings[Index].StartOfString, CharsPerString, _T("%y\\file%08x.txt"), &Context->TempPath, Index) > 0) {
+            FileHandle = CreateFile(Context->Strings[Index].StartOfString,
+                                    GENERIC_WRITE,
+                                    0,
+                                    NULL,
+                                    CREATE_NEW,
+                                    FILE_ATTRIBUTE_NORMAL,
+                                    NULL);
+        }
+
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            return FALSE;
+        }
+        CloseHandle(FileHandle);
+        Context->Strings[Index].LengthInChars = _tcslen(Context->Strings[Index].StartOfString);
+        Context->BytesPerOp += Context->Strings[Index].LengthInChars * sizeof(TCHAR);
+    }
+
+    if (!YoriLibAllocateString(&Context->Input, Context->TempPath.LengthInChars + sizeof("\\*"))) {
+        return FALSE;
+    }
+    Context->Input.LengthInChars = YoriLibSPrintfS(Context->Input.StartOfString, Context->Input.LengthAllocated, _T("%y\\*"), &Context->TempPath);
+    Context->ItemsExpected = Count;
+
+    return TRUE;
+}
+
+/**
+ Count a file found by YoriLibForEachFile.
+
+ @param FilePath Pointer to the full path of the file that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth The recursion depth.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to continue enumerating.
+ */
+BOOL
+YBenchFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PYBENCH_CONTEXT BenchContext = (PYBENCH_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+
+    BenchContext->ItemsFound++;
+    return TRUE;
+}
+
+/**
+ Enumerate the files in the temporary directory.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunForEachFile(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    Context->ItemsFound = 0;
+    if (!YoriLibForEachFile(&Context->Input, YORILIB_FILEENUM_RETURN_FILES, 0, YBenchFileFoundCallback, NULL, Context)) {
+        return FALSE;
+    }
+
+    if (Context->ItemsFound != Context->ItemsExpected) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Prepare the command parsing test by creating a long command line.  Repeated
+ parses of the same command line are satisfied from the shell's parse cache.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareParse(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    Context->ParseOffset = 0;
+    return YBenchFillInput(Context, _T("cmd.exe /c \"a quoted argument\" %YBENCH_UNDEFINED% plain^ escaped "));
+}
+
+/**
+ Prepare the command parsing test so that each parse tokenizes the command
+ line without using the shell's parse cache.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchPrepareParseNoCache(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    if (!YBenchPrepareParse(Context)) {
+        return FALSE;
+    }
+    Context->ParseOffset = 1;
+    return TRUE;
+}
+
+/**
+ Parse the command line into arguments.
+
+ @param Context Pointer to the benchmark context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunParse(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    YORI_SH_CMD_CONTEXT CmdContext;
+
+    if (!YoriShParseCmdlineToCmdContext(&Context->Input, Context->ParseOffset, &CmdContext)) {
+        return FALSE;
+    }
+    YoriShFreeCmdContext(&CmdContext);
+    return TRUE;
+}
+
+/**
+ Discard cached parse results.
+
+ @param Context Pointer to the benchmark context.
+ */
+VOID
+YBenchCleanupParse(
+    __in PYBENCH_CONTEXT Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+    YoriShFreeParseCache();
+}
+
+/**
+ The set of tests that can be run.
+ */
+const YBENCH_TEST YBenchTests[] = {
+    {_T("readline"),     _T("YoriLibReadLineToStringEx"),         YBenchPrepareReadLine,     YBenchRunReadLine,     NULL},
+    {_T("hash"),         _T("YoriLibHashLookupByKey"),            YBenchPrepareHash,         YBenchRunHash,         NULL},
+    {_T("substring"),    _T("YoriLibFindFirstMatchingSubstring"), YBenchPrepareSubstring,    YBenchRunSubstring,    NULL},
+    {_T("sprintf"),      _T("YoriLibVSPrintf"),                   YBenchPrepareSPrintf,      YBenchRunSPrintf,      NULL},
+    {_T("expand"),       _T("YoriLibExpandCommandVariables"),     YBenchPrepareExpand,       YBenchRunExpand,       NULL},
+    {_T("foreachfile"),  _T("YoriLibForEachFile"),                YBenchPrepareForEachFile,  YBenchRunForEachFile,  YBenchCleanupForEachFile},
+    {_T("parse"),        _T("YoriShParseCmdlineToCmdContext"),    YBenchPrepareParse,        YBenchRunParse,        YBenchCleanupParse},
+    {_T("parsenocache"), _T("YoriShParseCmdlineToCmdContext"),    YBenchPrepareParseNoCache, YBenchRunParse,        YBenchCleanupParse},
+};
+
+/**
+ Release all state used by a test, including any state allocated before the
+ test failed to prepare.
+
+ @param Context Pointer to the benchmark context.
+
+ @param Test Pointer to the test that was run.
+ */
+VOID
+YBenchCleanupContext(
+    __in PYBENCH_CONTEXT Context,
+    __in const YBENCH_TEST * Test
+    )
+{
+    DWORD Index;
+
+    if (Test->Cleanup != NULL) {
+        Test->Cleanup(Context);
+    }
+
+    if (Context->HashTable != NULL) {
+        for (Index = 0; Index < Context->StringCount; Index++) {
+            if (Context->HashEntries[Index].Key != NULL) {
+                YoriLibHashRemoveByEntry(&Context->HashEntries[Index]);
+            }
+        }
+        YoriLibFreeEmptyHashTable(Context->HashTable);
+    }
+
+    if (Context->HashEntries != NULL) {
+        YoriLibFree(Context->HashEntries);
+    }
+
+    if (Context->Strings != NULL) {
+        YoriLibFree(Context->Strings);
+    }
+
+    if (Context->FileHandle != NULL) {
+        CloseHandle(Context->FileHandle);
+    }
+
+    YoriLibFreeStringContents(&Context->Input);
+    YoriLibFreeStringContents(&Context->Output);
+    YoriLibFreeStringContents(&Context->TempPath);
+}
+
+/**
+ Return the current value of the high resolution timer, converted to
+ nanoseconds.
+
+ @param Frequency The frequency of the high resolution timer.
+
+ @return The current time in nanoseconds.
+ */
+LONGLONG
+YBenchGetTime(
+    __in PLARGE_INTEGER Frequency
+    )
+{
+    LARGE_INTEGER Now;
+
+    QueryPerformanceCounter(&Now);
+    return (Now.QuadPart / Frequency->QuadPart) * 1000000000 +
+           (Now.QuadPart % Frequency->QuadPart) * 1000000000 / Frequency->QuadPart;
+}
+
+/**
+ Run a single test, performing operations until either a fixed number of
+ operations have completed or a minimum amount of time has elapsed.
+
+ @param Test Pointer to the test to run.
+
+ @param InputSize The number of characters in the synthetic input.
+
+ @param FixedOperations If nonzero, the exact number of operations to
+        perform.
+
+ @param MinimumTime If FixedOperations is zero, the minimum number of
+        milliseconds to perform operations for.
+
+ @param Result On successful completion, populated with the measurements
+        from the test.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchRunTest(
+    __in const YBENCH_TEST * Test,
+    __in DWORD InputSize,
+    __in DWORD FixedOperations,
+    __in DWORD MinimumTime,
+    __out PYBENCH_RESULT Result
+    )
+{
+    YBENCH_CONTEXT Context;
+    LARGE_INTEGER Frequency;
+    LONGLONG StartTime;
+    LONGLONG EndTime;
+    DWORD StartAllocations;
+    DWORD EndAllocations;
+    DWORD BatchSize;
+    DWORD Index;
+    BOOL Success;
+
+    if (!QueryPerformanceFrequency(&Frequency)) {
+        return FALSE;
+    }
+
+    ZeroMemory(&Context, sizeof(Context));
+    Context.InputSize = InputSize;
+
+    Success = FALSE;
+    ZeroMemory(Result, sizeof(YBENCH_RESULT));
+
+    if (!Test->Prepare(&Context)) {
+        goto Exit;
+    }
+
+    //
+    //  Perform one operation before measuring so that any state which is
+    //  allocated once and reused, such as caches, is excluded.
+    //
+
+    if (!Test->Run(&Context)) {
+        goto Exit;
+    }
+
+    BatchSize = 1;
+    if (FixedOperations != 0) {
+        BatchSize = FixedOperations;
+    }
+
+    StartAllocations = 0;
+    EndAllocations = 0;
+    Result->AllocationsCounted = YoriLibGetAllocationCount(&StartAllocations);
+
+    while (TRUE) {
+        if (Result->AllocationsCounted) {
+            YoriLibGetAllocationCount(&StartAllocations);
+        }
+        StartTime = YBenchGetTime(&Frequency);
+        for (Index = 0; Index < BatchSize; Index++) {
+            if (!Test->Run(&Context)) {
+                goto Exit;
+            }
+        }
+        EndTime = YBenchGetTime(&Frequency);
+        if (Result->AllocationsCounted) {
+            YoriLibGetAllocationCount(&EndAllocations);
+        }
+
+        Result->Operations += BatchSize;
+        Result->Nanoseconds += EndTime - StartTime;
+        Result->Allocations += EndAllocations - StartAllocations;
+
+        if (FixedOperations != 0 ||
+            Result->Nanoseconds >= (LONGLONG)MinimumTime * 1000000) {
+
+            break;
+        }
+
+        if (BatchSize < 0x40000000) {
+            BatchSize = BatchSize * 2;
+        }
+    }
+
+    Result->Bytes = Result->Operations * Context.BytesPerOp;
+    Success = TRUE;
+
+Exit:
+    YBenchCleanupContext(&Context, Test);
+    return Success;
+}
+
+/**
+ Return a measurement per operation, in hundredths.
+
+ @param Value The total measurement.
+
+ @param Operations The number of operations.
+
+ @return The measurement per operation, multiplied by 100.
+ */
+LONGLONG
+YBenchPerOpHundredths(
+    __in LONGLONG Value,
+    __in LONGLONG Operations
+    )
+{
+    if (Operations == 0) {
+        return 0;
+    }
+    return Value * 100 / Operations;
+}
+
+/**
+ Return the throughput of a test in megabytes per second, in hundredths.
+
+ @param Result The measurements of the test.
+
+ @return The throughput in megabytes per second, multiplied by 100.
+ */
+LONGLONG
+YBenchMegabytesPerSecondHundredths(
+    __in PYBENCH_RESULT Result
+    )
+{
+    LONGLONG Microseconds;
+
+    Microseconds = Result->Nanoseconds / 1000;
+    if (Microseconds == 0) {
+        Microseconds = 1;
+    }
+
+    return (Result->Bytes / 1024) * 100 * 1000000 / Microseconds / 1024;
+}
+
+/**
+ Read a single numeric value for a test from a baseline file.
+
+ @param BaselineFile The full path to the baseline file.
+
+ @param Test The name of the test.
+
+ @param Name The name of the value.
+
+ @return The value, or zero if it is not present.
+ */
+LONGLONG
+YBenchReadBaselineValue(
+    __in PYORI_STRING BaselineFile,
+    __in LPCTSTR Test,
+    __in LPCTSTR Name
+    )
+{
+    TCHAR Buffer[32];
+    YORI_STRING Value;
+    LONGLONG Number;
+    DWORD CharsConsumed;
+
+    YoriLibInitEmptyString(&Value);
+    Value.StartOfString = Buffer;
+    Value.LengthAllocated = sizeof(Buffer)/sizeof(Buffer[0]);
+    Value.LengthInChars = GetPrivateProfileString(Test, Name, _T(""), Buffer, Value.LengthAllocated, BaselineFile->StartOfString);
+
+    if (!YoriLibStringToNumber(&Value, FALSE, &Number, &CharsConsumed) || CharsConsumed == 0) {
+        return 0;
+    }
+    return Number;
+}
+
+/**
+ Read the measurements for a test from a baseline file.
+
+ @param BaselineFile The full path to the baseline file.
+
+ @param Test The name of the test.
+
+ @param Result On successful completion, populated with the measurements
+        from the baseline.
+
+ @return TRUE if the baseline contains measurements for the test, FALSE if
+         it does not.
+ */
+__success(return)
+BOOL
+YBenchReadBaseline(
+    __in PYORI_STRING BaselineFile,
+    __in LPCTSTR Test,
+    __out PYBENCH_RESULT Result
+    )
+{
+    Result->Operations = YBenchReadBaselineValue(BaselineFile, Test, _T("Operations"));
+    Result->Nanoseconds = YBenchReadBaselineValue(BaselineFile, Test, _T("Nanoseconds"));
+    Result->Bytes = YBenchReadBaselineValue(BaselineFile, Test, _T("Bytes"));
+    Result->Allocations = YBenchReadBaselineValue(BaselineFile, Test, _T("Allocations"));
+    Result->AllocationsCounted = FALSE;
+    if (GetPrivateProfileInt(Test, _T("AllocationsCounted"), 0, BaselineFile->StartOfString) != 0) {
+        Result->AllocationsCounted = TRUE;
+    }
+
+    if (Result->Operations <= 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Write the measurements for a test to a baseline file.
+
+ @param BaselineFile The full path to the baseline file.
+
+ @param Test The name of the test.
+
+ @param Result The measurements to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchWriteBaseline(
+    __in PYORI_STRING BaselineFile,
+    __in LPCTSTR Test,
+    __in PYBENCH_RESULT Result
+    )
+{
+    TCHAR Buffer[32];
+    LPCTSTR Names[5];
+    LONGLONG Values[5];
+    DWORD Index;
+
+    Names[0] = _T("Operations");
+    Values[0] = Result->Operations;
+    Names[1] = _T("Nanoseconds");
+    Values[1] = Result->Nanoseconds;
+    Names[2] = _T("Bytes");
+    Values[2] = Result->Bytes;
+    Names[3] = _T("Allocations");
+    Values[3] = Result->Allocations;
+    Names[4] = _T("AllocationsCounted");
+    Values[4] = Result->AllocationsCounted;
+
+    for (Index = 0; Index < sizeof(Names)/sizeof(Names[0]); Index++) {
+        YoriLibSPrintfS(Buffer, sizeof(Buffer)/sizeof(Buffer[0]), _T("%lli"), Values[Index]);
+        if (!WritePrivateProfileString(Test, Names[Index], Buffer, BaselineFile->StartOfString)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ Display the measurements from a test, and if a baseline is available,
+ compare the measurements against it.
+
+ @param Test The test that was run.
+
+ @param Result The measurements from the test.
+
+ @param Baseline Optionally points to the measurements from the baseline.
+
+ @param RegressionPercent The percentage slowdown to report as a
+        regression.
+
+ @return TRUE if the test is not a regression, FALSE if it is.
+ */
+BOOL
+YBenchReportResult(
+    __in const YBENCH_TEST * Test,
+    __in PYBENCH_RESULT Result,
+    __in_opt PYBENCH_RESULT Baseline,
+    __in DWORD RegressionPercent
+    )
+{
+    LONGLONG NsPerOp;
+    LONGLONG MbPerSec;
+    LONGLONG AllocsPerOp;
+    LONGLONG BaseNsPerOp;
+    LONGLONG BaseAllocsPerOp;
+    LONGLONG ChangePercent;
+    BOOL Regressed;
+
+    NsPerOp = YBenchPerOpHundredths(Result->Nanoseconds, Result->Operations);
+    MbPerSec = YBenchMegabytesPerSecondHundredths(Result);
+    AllocsPerOp = YBenchPerOpHundredths(Result->Allocations, Result->Operations);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%-13s %10lli %12lli.%02lli %8lli.%02lli"),
+                  Test->Name,
+                  Result->Operations,
+                  NsPerOp / 100,
+                  NsPerOp % 100,
+                  MbPerSec / 100,
+                  MbPerSec % 100);
+
+    if (Result->AllocationsCounted) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" %6lli.%02lli"), AllocsPerOp / 100, AllocsPerOp % 100);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" %9s"), _T("n/a"));
+    }
+
+    Regressed = FALSE;
+    if (Baseline != NULL) {
+        BaseNsPerOp = YBenchPerOpHundredths(Baseline->Nanoseconds, Baseline->Operations);
+        BaseAllocsPerOp = YBenchPerOpHundredths(Baseline->Allocations, Baseline->Operations);
+        ChangePercent = 0;
+        if (BaseNsPerOp > 0) {
+            ChangePercent = (NsPerOp - BaseNsPerOp) * 100 / BaseNsPerOp;
+        }
+
+        if (ChangePercent >= 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  +%lli%%"), ChangePercent);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  -%lli%%"), -ChangePercent);
+        }
+
+        if (ChangePercent > (LONGLONG)RegressionPercent) {
+            Regressed = TRUE;
+        }
+
+        if (Result->AllocationsCounted &&
+            Baseline->AllocationsCounted &&
+            AllocsPerOp > BaseAllocsPerOp) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" (was %lli.%02lli allocs/op)"), BaseAllocsPerOp / 100, BaseAllocsPerOp % 100);
+            Regressed = TRUE;
+        }
+
+        if (Regressed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" REGRESSION"));
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    return !Regressed;
+}
+
+/**
+ Find a test by name.
+
+ @param Name The name of the test.
+
+ @return Pointer to the test, or NULL if no test has the specified name.
+ */
+const YBENCH_TEST *
+YBenchFindTest(
+    __in PYORI_STRING Name
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YBenchTests)/sizeof(YBenchTests[0]); Index++) {
+        if (YoriLibCompareStringWithLiteralInsensitive(Name, YBenchTests[Index].Name) == 0) {
+            return &YBenchTests[Index];
+        }
+    }
+    return NULL;
+}
+
+/**
+ Parse a numeric command line argument.
+
+ @param Arg The argument to parse.
+
+ @param Value On successful completion, populated with the value.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YBenchParseNumber(
+    __in PYORI_STRING Arg,
+    __out PDWORD Value
+    )
+{
+    LONGLONG llTemp;
+    DWORD CharsConsumed;
+
+    if (!YoriLibStringToNumber(Arg, TRUE, &llTemp, &CharsConsumed) ||
+        CharsConsumed == 0 ||
+        llTemp < 0 ||
+        llTemp > 0x7FFFFFFF) {
+
+        return FALSE;
+    }
+
+    *Value = (DWORD)llTemp;
+    return TRUE;
+}
+
+/**
+ The main entrypoint for the ybench cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process indicating success or failure.
+ */
+DWORD
+ymain(
+    __in DWORD ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOL ArgumentUnderstood;
+    BOOL ListTests = FALSE;
+    BOOL AllPassed;
+    DWORD StartArg;
+    DWORD i;
+    DWORD InputSize;
+    DWORD FixedOperations;
+    DWORD MinimumTime;
+    DWORD RegressionPercent;
+    YORI_STRING Arg;
+    YORI_STRING CompareFile;
+    YORI_STRING SaveFile;
+    YBENCH_RESULT Result;
+    YBENCH_RESULT Baseline;
+    PYBENCH_RESULT BaselineToCompare;
+    const YBENCH_TEST * Test;
+
+    StartArg = 0;
+    InputSize = YBENCH_DEFAULT_INPUT_SIZE;
+    FixedOperations = 0;
+    MinimumTime = YBENCH_DEFAULT_MINIMUM_TIME;
+    RegressionPercent = YBENCH_DEFAULT_REGRESSION_PERCENT;
+    YoriLibInitEmptyString(&CompareFile);
+    YoriLibInitEmptyString(&SaveFile);
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("?")) == 0) {
+                YBenchHelp();
+                goto ExitSuccess;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                goto ExitSuccess;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("c")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&CompareFile);
+                    if (YoriLibUserStringToSingleFilePath(&ArgV[i + 1], FALSE, &CompareFile)) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("i")) == 0) {
+                if (i + 1 < ArgC && YBenchParseNumber(&ArgV[i + 1], &FixedOperations)) {
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("l")) == 0) {
+                ListTests = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
+                if (i + 1 < ArgC && YBenchParseNumber(&ArgV[i + 1], &RegressionPercent)) {
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&SaveFile);
+                    if (YoriLibUserStringToSingleFilePath(&ArgV[i + 1], FALSE, &SaveFile)) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("size")) == 0) {
+                if (i + 1 < ArgC &&
+                    YBenchParseNumber(&ArgV[i + 1], &InputSize) &&
+                    InputSize > 0) {
+
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("t")) == 0) {
+                if (i + 1 < ArgC && YBenchParseNumber(&ArgV[i + 1], &MinimumTime)) {
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
+                StartArg = i + 1;
+                ArgumentUnderstood = TRUE;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (ListTests) {
+        for (i = 0; i < sizeof(YBenchTests)/sizeof(YBenchTests[0]); i++) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-13s %s\n"), YBenchTests[i].Name, YBenchTests[i].Description);
+        }
+        goto ExitSuccess;
+    }
+
+    if (StartArg > 0) {
+        for (i = StartArg; i < ArgC; i++) {
+            if (YBenchFindTest(&ArgV[i]) == NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: unknown test %y\n"), &ArgV[i]);
+                goto ExitFailure;
+            }
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-13s %10s %15s %11s %9s\n"), _T("Test"), _T("Ops"), _T("ns/op"), _T("MB/s"), _T("allocs/op"));
+
+    AllPassed = TRUE;
+    for (i = 0; i < sizeof(YBenchTests)/sizeof(YBenchTests[0]); i++) {
+        Test = &YBenchTests[i];
+
+        if (StartArg > 0) {
+            DWORD Index;
+            for (Index = StartArg; Index < ArgC; Index++) {
+                if (YBenchFindTest(&ArgV[Index]) == Test) {
+                    break;
+                }
+            }
+            if (Index == ArgC) {
+                continue;
+            }
+        }
+
+        if (!YBenchRunTest(Test, InputSize, FixedOperations, MinimumTime, &Result)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: test %s failed\n"), Test->Name);
+            AllPassed = FALSE;
+            continue;
+        }
+
+        BaselineToCompare = NULL;
+        if (CompareFile.StartOfString != NULL &&
+            YBenchReadBaseline(&CompareFile, Test->Name, &Baseline)) {
+
+            BaselineToCompare = &Baseline;
+        }
+
+        if (!YBenchReportResult(Test, &Result, BaselineToCompare, RegressionPercent)) {
+            AllPassed = FALSE;
+        }
+
+        if (SaveFile.StartOfString != NULL &&
+            !YBenchWriteBaseline(&SaveFile, Test->Name, &Result)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: could not write baseline %y\n"), &SaveFile);
+            AllPassed = FALSE;
+        }
+    }
+
+    if (!AllPassed) {
+        goto ExitFailure;
+    }
+
+ExitSuccess:
+    YoriLibFreeStringContents(&CompareFile);
+    YoriLibFreeStringContents(&SaveFile);
+    return EXIT_SUCCESS;
+
+ExitFailure:
+    YoriLibFreeStringContents(&CompareFile);
+    YoriLibFreeStringContents(&SaveFile);
+    return EXIT_FAILURE;
+}
+
+// vim:sw=4:ts=4:et:
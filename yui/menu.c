@@ -359,24 +359,20 @@ YuiInsertFileInOrder(
 
 /**
  Navigate down the menu structure comparing path components to find the
- directory which should contain a given path.  This is done because the
- start menu is a composite view merged from multiple physical directories,
- so another directory may have created objects that belong as the start menu
- node for contents returned from a different directory.
+ directory which should contain a given path, returning NULL if any
+ directory along the way is not present.
 
  @param Root Pointer to the root directory to start enumerating from.
 
- @param NewNode Pointer to a fully qualified name for the node being inserted.
+ @param NewNode Pointer to a fully qualified name for the node.
 
  @param Depth The number of path components that this node is from the root.
 
  @return Pointer to the parent for this object, or NULL if a parent is not
-         found.  Note the expectation is that a parent will always be found,
-         because file system enumeration will return parents before children,
-         so a parent must have been created by one directory or another.
+         found.
  */
 PYUI_MENU_DIRECTORY
-YuiFindStartingNode(
+YuiLookupStartingNode(
     __in PYUI_MENU_DIRECTORY Root,
     __in PYORI_STRING NewNode,
     __in DWORD Depth
@@ -390,7 +386,6 @@ YuiFindStartingNode(
 
     for (Count = 0; Count < Depth; Count++) {
         if (!YuiFindDepthComponent(NewNode, &Component, Depth - Count, FALSE)) {
-            ASSERT(FALSE);
             return NULL;
         }
 
@@ -407,7 +402,6 @@ YuiFindStartingNode(
         }
 
         if (Child == NULL) {
-            ASSERT(Child != NULL);
             return NULL;
         }
 
@@ -417,6 +411,38 @@ YuiFindStartingNode(
     return Current;
 }
 
+/**
+ Navigate down the menu structure comparing path components to find the
+ directory which should contain a given path.  This is done because the
+ start menu is a composite view merged from multiple physical directories,
+ so another directory may have created objects that belong as the start menu
+ node for contents returned from a different directory.
+
+ @param Root Pointer to the root directory to start enumerating from.
+
+ @param NewNode Pointer to a fully qualified name for the node being inserted.
+
+ @param Depth The number of path components that this node is from the root.
+
+ @return Pointer to the parent for this object, or NULL if a parent is not
+         found.  Note the expectation is that a parent will always be found,
+         because file system enumeration will return parents before children,
+         so a parent must have been created by one directory or another.
+ */
+PYUI_MENU_DIRECTORY
+YuiFindStartingNode(
+    __in PYUI_MENU_DIRECTORY Root,
+    __in PYORI_STRING NewNode,
+    __in DWORD Depth
+    )
+{
+    PYUI_MENU_DIRECTORY Parent;
+
+    Parent = YuiLookupStartingNode(Root, NewNode, Depth);
+    ASSERT(Parent != NULL);
+    return Parent;
+}
+
 /**
  A callback function invoked for each directory in the start menu to populate
  its associated Win32 menu with items.  Note this function assumes a depth
@@ -898,162 +924,192 @@ YuiFileEnumerateErrorCallback(
 
 
 /**
- Enumerate all shortcuts in known folders and populate the start menu with
- shortcut files that have been found.
+ The size of the buffer used to receive change records for each monitored
+ directory.  If more changes occur than fit in this buffer before they are
+ processed, the system discards them and the menu is fully reloaded.
+ */
+#define YUI_MENU_WATCH_BUFFER_SIZE (64 * 1024)
 
- @param YuiContext Pointer to the application context.
+/**
+ Issue a read for the next set of change records on a monitored directory.
+
+ @param Watch Pointer to the monitored directory.
+
+ @return TRUE to indicate the read was issued, FALSE if it was not.
  */
 BOOL
-YuiMenuPopulate(
-    __in PYUI_ENUM_CONTEXT YuiContext
+YuiMenuQueueChangeRead(
+    __in PYUI_MENU_WATCH Watch
     )
 {
-    YORI_STRING EnumDir;
-    DWORD MatchFlags;
-
-    //
-    //  If no change notifications exist because this is the first pass,
-    //  create them now.  This is done before enumerating so if anything
-    //  changes after this point we may enumerate again.
-    //
+    if (!DllKernel32.pReadDirectoryChangesW(Watch->DirectoryHandle,
+                                            Watch->Buffer,
+                                            YUI_MENU_WATCH_BUFFER_SIZE,
+                                            TRUE,
+                                            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME,
+                                            NULL,
+                                            &Watch->Overlapped,
+                                            NULL)) {
+        return FALSE;
+    }
 
-    if (YuiContext->StartChangeNotifications[0] == NULL) {
-        YORI_STRING FullPath;
-        YoriLibInitEmptyString(&FullPath);
+    Watch->ReadPending = TRUE;
+    return TRUE;
+}
 
-        YoriLibConstantString(&EnumDir, _T("~PROGRAMS"));
-        if (!YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &FullPath)) {
-            return FALSE;
-        }
+/**
+ Close the directory handle, event and buffer used to read change records
+ for a monitored directory.
 
-        if (YuiContext->StartChangeNotifications[0] != NULL) {
-            FindCloseChangeNotification(YuiContext->StartChangeNotifications[0]);
-            YuiContext->StartChangeNotifications[0] = NULL;
-        }
-        YuiContext->StartChangeNotifications[0] = FindFirstChangeNotification(FullPath.StartOfString, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
-        if (YuiContext->StartChangeNotifications[0] == NULL) {
-            YoriLibFreeStringContents(&FullPath);
-            return FALSE;
-        }
-        YoriLibFreeStringContents(&FullPath);
+ @param Watch Pointer to the monitored directory.
+ */
+VOID
+YuiMenuCloseChangeRead(
+    __in PYUI_MENU_WATCH Watch
+    )
+{
+    if (Watch->DirectoryHandle != NULL) {
 
-        YoriLibConstantString(&EnumDir, _T("~START"));
-        if (!YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &FullPath)) {
-            return FALSE;
-        }
+        //
+        //  Closing the handle completes any outstanding read.  Wait for that
+        //  to occur so the buffer is no longer in use.
+        //
 
-        if (YuiContext->StartChangeNotifications[1] != NULL) {
-            FindCloseChangeNotification(YuiContext->StartChangeNotifications[1]);
-            YuiContext->StartChangeNotifications[1] = NULL;
-        }
-        YuiContext->StartChangeNotifications[1] = FindFirstChangeNotification(FullPath.StartOfString, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
-        if (YuiContext->StartChangeNotifications[1] == NULL) {
-            YoriLibFreeStringContents(&FullPath);
-            return FALSE;
+        CloseHandle(Watch->DirectoryHandle);
+        Watch->DirectoryHandle = NULL;
+        if (Watch->ReadPending) {
+            WaitForSingleObject(Watch->Overlapped.hEvent, INFINITE);
+            Watch->ReadPending = FALSE;
         }
-        YoriLibFreeStringContents(&FullPath);
+    }
 
-        YoriLibConstantString(&EnumDir, _T("~COMMONPROGRAMS"));
-        if (!YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &FullPath)) {
-            return FALSE;
-        }
+    if (Watch->Overlapped.hEvent != NULL) {
+        CloseHandle(Watch->Overlapped.hEvent);
+        Watch->Overlapped.hEvent = NULL;
+    }
 
-        if (YuiContext->StartChangeNotifications[2] != NULL) {
-            FindCloseChangeNotification(YuiContext->StartChangeNotifications[2]);
-            YuiContext->StartChangeNotifications[2] = NULL;
-        }
-        YuiContext->StartChangeNotifications[2] = FindFirstChangeNotification(FullPath.StartOfString, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
-        if (YuiContext->StartChangeNotifications[2] == NULL) {
-            YoriLibFreeStringContents(&FullPath);
-            return FALSE;
-        }
-        YoriLibFreeStringContents(&FullPath);
+    if (Watch->Buffer != NULL) {
+        YoriLibFree(Watch->Buffer);
+        Watch->Buffer = NULL;
+    }
+}
 
-        YoriLibConstantString(&EnumDir, _T("~COMMONSTART"));
-        if (!YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &FullPath)) {
-            return FALSE;
-        }
+/**
+ Begin monitoring a start menu directory for changes.  Where the system
+ supports it, records describing each change are read so they can be applied
+ to the existing menu.  Otherwise, a change notification is used which only
+ indicates that something has changed.
 
-        if (YuiContext->StartChangeNotifications[3] != NULL) {
-            FindCloseChangeNotification(YuiContext->StartChangeNotifications[3]);
-            YuiContext->StartChangeNotifications[3] = NULL;
-        }
-        YuiContext->StartChangeNotifications[3] = FindFirstChangeNotification(FullPath.StartOfString, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
-        if (YuiContext->StartChangeNotifications[3] == NULL) {
-            YoriLibFreeStringContents(&FullPath);
-            return FALSE;
-        }
-        YoriLibFreeStringContents(&FullPath);
-    }
+ @param YuiContext Pointer to the application context.
 
-    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
-    MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+ @param Index The index of the directory within the array of monitored
+        directories.
 
-    //
-    //  Load everything from the user's start menu directory, ignoring
-    //  anything that's also under the programs directory.
-    //
+ @param Location Pointer to the name of the directory to monitor, such as
+        "~PROGRAMS".
 
-    YoriLibInitEmptyString(&YuiContext->FilterDirectory);
-    YoriLibConstantString(&EnumDir, _T("~PROGRAMS"));
-    YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &YuiContext->FilterDirectory);
+ @param StartRoot TRUE if the directory is a start menu directory, FALSE if
+        it is a programs directory.
 
-    YoriLibConstantString(&EnumDir, _T("~START\\*"));
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YuiMenuMonitorDirectory(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in DWORD Index,
+    __in LPTSTR Location,
+    __in BOOL StartRoot
+    )
+{
+    PYUI_MENU_WATCH Watch;
+    YORI_STRING EnumDir;
 
-    YoriLibForEachFile(&EnumDir,
-                       MatchFlags,
-                       0,
-                       YuiFileFoundCallback,
-                       YuiFileEnumerateErrorCallback,
-                       YuiContext);
+    Watch = &YuiContext->StartWatches[Index];
+    Watch->StartRoot = StartRoot;
+    Watch->ProgramsWatchIndex = Index - 1;
 
-    YoriLibFreeStringContents(&YuiContext->FilterDirectory);
+    YoriLibConstantString(&EnumDir, Location);
+    if (!YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &Watch->RootPath)) {
+        return FALSE;
+    }
 
-    //
-    //  Load everything from the user's programs directory.
-    //
+    if (DllKernel32.pReadDirectoryChangesW != NULL) {
+        Watch->DirectoryHandle = CreateFile(Watch->RootPath.StartOfString,
+                                            FILE_LIST_DIRECTORY,
+                                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                            NULL,
+                                            OPEN_EXISTING,
+                                            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                            NULL);
+
+        if (Watch->DirectoryHandle == INVALID_HANDLE_VALUE) {
+            Watch->DirectoryHandle = NULL;
+        }
 
-    YoriLibConstantString(&EnumDir, _T("~PROGRAMS\\*"));
+        if (Watch->DirectoryHandle != NULL) {
+            Watch->Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Watch->Buffer = YoriLibMalloc(YUI_MENU_WATCH_BUFFER_SIZE);
+            if (Watch->Overlapped.hEvent != NULL &&
+                Watch->Buffer != NULL &&
+                YuiMenuQueueChangeRead(Watch)) {
 
-    YoriLibForEachFile(&EnumDir,
-                       MatchFlags,
-                       0,
-                       YuiFileFoundCallback,
-                       YuiFileEnumerateErrorCallback,
-                       YuiContext);
+                YuiContext->StartChangeNotifications[Index] = Watch->Overlapped.hEvent;
+                return TRUE;
+            }
 
-    //
-    //  Load everything from the systems's start menu directory, ignoring
-    //  anything that's also under the programs directory.
-    //
+            YuiMenuCloseChangeRead(Watch);
+        }
+    }
 
-    YoriLibConstantString(&EnumDir, _T("~COMMONPROGRAMS"));
-    YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &YuiContext->FilterDirectory);
+    YuiContext->StartChangeNotifications[Index] = FindFirstChangeNotification(Watch->RootPath.StartOfString, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (YuiContext->StartChangeNotifications[Index] == NULL ||
+        YuiContext->StartChangeNotifications[Index] == INVALID_HANDLE_VALUE) {
 
-    YoriLibConstantString(&EnumDir, _T("~COMMONSTART\\*"));
+        YuiContext->StartChangeNotifications[Index] = NULL;
+        return FALSE;
+    }
 
-    YoriLibForEachFile(&EnumDir,
-                       MatchFlags,
-                       0,
-                       YuiFileFoundCallback,
-                       YuiFileEnumerateErrorCallback,
-                       YuiContext);
+    return TRUE;
+}
 
-    YoriLibFreeStringContents(&YuiContext->FilterDirectory);
+/**
+ Stop monitoring all start menu directories for changes.
 
-    //
-    //  Load everything from the system's programs directory.
-    //
+ @param YuiContext Pointer to the application context.
+ */
+VOID
+YuiMenuStopMonitoring(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    )
+{
+    PYUI_MENU_WATCH Watch;
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YuiContext->StartWatches)/sizeof(YuiContext->StartWatches[0]); Index++) {
+        Watch = &YuiContext->StartWatches[Index];
+        if (Watch->DirectoryHandle != NULL) {
+            YuiMenuCloseChangeRead(Watch);
+        } else if (YuiContext->StartChangeNotifications[Index] != NULL) {
+            FindCloseChangeNotification(YuiContext->StartChangeNotifications[Index]);
+        }
+        YuiContext->StartChangeNotifications[Index] = NULL;
+        YoriLibFreeStringContents(&Watch->RootPath);
+    }
+}
 
-    YoriLibConstantString(&EnumDir, _T("~COMMONPROGRAMS\\*"));
+/**
+ Populate the Win32 menus from the tree of start menu directories and
+ programs, and add the predefined menu entries.
 
-    YoriLibForEachFile(&EnumDir,
-                       MatchFlags,
-                       0,
-                       YuiFileFoundCallback,
-                       YuiFileEnumerateErrorCallback,
-                       YuiContext);
+ @param YuiContext Pointer to the application context.
 
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YuiMenuBuildMenus(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    )
+{
     //
     //  Populate the menus with human readable strings from the entries we
     //  just loaded, and assign each menu an identifier that corresponds
@@ -1110,82 +1166,704 @@ YuiMenuPopulate(
 }
 
 /**
- Deallocate all contexts associated with found start menu shortcuts or
- directories.
+ Enumerate all shortcuts in known folders and populate the start menu with
+ shortcut files that have been found.
 
  @param YuiContext Pointer to the application context.
  */
-VOID
-YuiMenuFreeAll(
+BOOL
+YuiMenuPopulate(
     __in PYUI_ENUM_CONTEXT YuiContext
     )
 {
-    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->ProgramsDirectory,
-                                        &YuiContext->ProgramsDirectory,
-                                        YuiDeleteMenuFile,
-                                        YuiDeleteMenuDirectory);
+    YORI_STRING EnumDir;
+    DWORD MatchFlags;
 
-    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->StartDirectory,
-                                        &YuiContext->StartDirectory,
-                                        YuiDeleteMenuFile,
-                                        YuiDeleteMenuDirectory);
+    //
+    //  If no change notifications exist because this is the first pass,
+    //  create them now.  This is done before enumerating so if anything
+    //  changes after this point we may enumerate again.
+    //
 
-    if (YuiContext->ShutdownMenu != NULL) {
-        DestroyMenu(YuiContext->ShutdownMenu);
-        YuiContext->ShutdownMenu = NULL;
+    if (YuiContext->StartChangeNotifications[0] == NULL) {
+        if (!YuiMenuMonitorDirectory(YuiContext, 0, _T("~PROGRAMS"), FALSE) ||
+            !YuiMenuMonitorDirectory(YuiContext, 1, _T("~START"), TRUE) ||
+            !YuiMenuMonitorDirectory(YuiContext, 2, _T("~COMMONPROGRAMS"), FALSE) ||
+            !YuiMenuMonitorDirectory(YuiContext, 3, _T("~COMMONSTART"), TRUE)) {
+
+            YuiMenuStopMonitoring(YuiContext);
+            return FALSE;
+        }
     }
 
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+
     //
-    //  Because this is associated with StartDirectory, it's already destroyed
+    //  Load everything from the user's start menu directory, ignoring
+    //  anything that's also under the programs directory.
     //
 
-    YuiContext->StartMenu = NULL;
-}
+    YoriLibInitEmptyString(&YuiContext->FilterDirectory);
+    YoriLibConstantString(&EnumDir, _T("~PROGRAMS"));
+    YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &YuiContext->FilterDirectory);
 
-/**
- Check if any change notification that is monitoring start menu changes has
- detected a change.  If no changes are detected, return immediately and
- allow the previously generated start menu to be displayed.  If changes are
- detected, purge the old start menu and reload the new one, then allow this
- to be displayed.  The change notifications are re-queued to detect a 
- subsequent change.
+    YoriLibConstantString(&EnumDir, _T("~START\\*"));
 
- @param YuiContext Pointer to the context containing the start menu and the
-        change notifications that are monitoring it.
+    YoriLibForEachFile(&EnumDir,
+                       MatchFlags,
+                       0,
+                       YuiFileFoundCallback,
+                       YuiFileEnumerateErrorCallback,
+                       YuiContext);
 
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOL
-YuiMenuReloadIfChanged(
-    __in PYUI_ENUM_CONTEXT YuiContext
-    )
-{
-    DWORD WaitStatus;
-    DWORD HandleCount;
-    BOOLEAN FoundChange;
+    YoriLibFreeStringContents(&YuiContext->FilterDirectory);
 
-    FoundChange = FALSE;
-    HandleCount = sizeof(YuiContext->StartChangeNotifications)/sizeof(YuiContext->StartChangeNotifications[0]);
-    while(TRUE) {
-        WaitStatus = WaitForMultipleObjects(HandleCount,
-                                            YuiContext->StartChangeNotifications,
-                                            FALSE,
-                                            0);
-        if (WaitStatus == WAIT_TIMEOUT) {
-            if (!FoundChange) {
-                return TRUE;
-            }
-            break;
-        }
+    //
+    //  Load everything from the user's programs directory.
+    //
+
+    YoriLibConstantString(&EnumDir, _T("~PROGRAMS\\*"));
+
+    YoriLibForEachFile(&EnumDir,
+                       MatchFlags,
+                       0,
+                       YuiFileFoundCallback,
+                       YuiFileEnumerateErrorCallback,
+                       YuiContext);
+
+    //
+    //  Load everything from the systems's start menu directory, ignoring
+    //  anything that's also under the programs directory.
+    //
+
+    YoriLibConstantString(&EnumDir, _T("~COMMONPROGRAMS"));
+    YoriLibUserStringToSingleFilePath(&EnumDir, TRUE, &YuiContext->FilterDirectory);
+
+    YoriLibConstantString(&EnumDir, _T("~COMMONSTART\\*"));
+
+    YoriLibForEachFile(&EnumDir,
+                       MatchFlags,
+                       0,
+                       YuiFileFoundCallback,
+                       YuiFileEnumerateErrorCallback,
+                       YuiContext);
+
+    YoriLibFreeStringContents(&YuiContext->FilterDirectory);
+
+    //
+    //  Load everything from the system's programs directory.
+    //
+
+    YoriLibConstantString(&EnumDir, _T("~COMMONPROGRAMS\\*"));
+
+    YoriLibForEachFile(&EnumDir,
+                       MatchFlags,
+                       0,
+                       YuiFileFoundCallback,
+                       YuiFileEnumerateErrorCallback,
+                       YuiContext);
+
+    return YuiMenuBuildMenus(YuiContext);
+}
+
+/**
+ Deallocate all contexts associated with found start menu shortcuts or
+ directories.
+
+ @param YuiContext Pointer to the application context.
+ */
+VOID
+YuiMenuFreeAll(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    )
+{
+    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->ProgramsDirectory,
+                                        &YuiContext->ProgramsDirectory,
+                                        YuiDeleteMenuFile,
+                                        YuiDeleteMenuDirectory);
+
+    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->StartDirectory,
+                                        &YuiContext->StartDirectory,
+                                        YuiDeleteMenuFile,
+                                        YuiDeleteMenuDirectory);
+
+    if (YuiContext->ShutdownMenu != NULL) {
+        DestroyMenu(YuiContext->ShutdownMenu);
+        YuiContext->ShutdownMenu = NULL;
+    }
+
+    //
+    //  Because this is associated with StartDirectory, it's already destroyed
+    //
+
+    YuiContext->StartMenu = NULL;
+}
+
+/**
+ A callback invoked for each directory in the start menu to destroy its
+ associated Win32 menu, leaving the directory in place so that a new menu
+ can be built from it.
+
+ @param Directory Pointer to the start menu directory.
+
+ @param Context Ignored in this function.
+
+ @return TRUE to continue enumerating.
+ */
+BOOL
+YuiDestroyMenuOnDirectory(
+    __in PYUI_MENU_DIRECTORY Directory,
+    __in PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    if (Directory->MenuHandle != NULL) {
+        DestroyMenu(Directory->MenuHandle);
+        Directory->MenuHandle = NULL;
+    }
+    return TRUE;
+}
+
+/**
+ Destroy all Win32 menus associated with the start menu, while retaining the
+ tree of directories and programs they were built from.
+
+ @param YuiContext Pointer to the application context.
+ */
+VOID
+YuiMenuDestroyMenus(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    )
+{
+    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->ProgramsDirectory,
+                                        NULL,
+                                        NULL,
+                                        YuiDestroyMenuOnDirectory);
+
+    YuiForEachFileOrDirectoryDepthFirst(&YuiContext->StartDirectory,
+                                        NULL,
+                                        NULL,
+                                        YuiDestroyMenuOnDirectory);
+
+    if (YuiContext->ShutdownMenu != NULL) {
+        DestroyMenu(YuiContext->ShutdownMenu);
+        YuiContext->ShutdownMenu = NULL;
+    }
+
+    //
+    //  Because this is associated with StartDirectory, it's already destroyed
+    //
+
+    YuiContext->StartMenu = NULL;
+}
+
+/**
+ Context passed when enumerating the contents of a directory that has been
+ added to the start menu.
+ */
+typedef struct _YUI_MENU_SUBTREE_CONTEXT {
+
+    /**
+     Pointer to the application context.
+     */
+    PYUI_ENUM_CONTEXT YuiContext;
+
+    /**
+     The depth of the directory being enumerated relative to the monitored
+     directory, plus one.  This is added to the depth of each object found
+     so that it matches the depth found by a full enumerate.
+     */
+    DWORD BaseDepth;
+} YUI_MENU_SUBTREE_CONTEXT, *PYUI_MENU_SUBTREE_CONTEXT;
+
+/**
+ A callback that is invoked for each object found within a directory that
+ has been added to the start menu.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies recursion depth relative to the added directory.
+
+ @param Context Pointer to a YUI_MENU_SUBTREE_CONTEXT.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+YuiMenuSubtreeFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PYUI_MENU_SUBTREE_CONTEXT SubtreeContext;
+
+    SubtreeContext = (PYUI_MENU_SUBTREE_CONTEXT)Context;
+    return YuiFileFoundCallback(FilePath, FileInfo, Depth + SubtreeContext->BaseDepth, SubtreeContext->YuiContext);
+}
+
+/**
+ Set the directory to filter from enumerate to match the rules used when
+ enumerating a monitored directory.  The filter refers to the path of the
+ programs watch and is not referenced, so the caller must reinitialize it
+ before that is freed.
+
+ @param YuiContext Pointer to the application context.
+
+ @param Index The index of the monitored directory.
+ */
+VOID
+YuiMenuSetFilterForWatch(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in DWORD Index
+    )
+{
+    PYUI_MENU_WATCH Watch;
+
+    Watch = &YuiContext->StartWatches[Index];
+    YoriLibInitEmptyString(&YuiContext->FilterDirectory);
+    if (Watch->StartRoot) {
+        YuiContext->FilterDirectory.StartOfString = YuiContext->StartWatches[Watch->ProgramsWatchIndex].RootPath.StartOfString;
+        YuiContext->FilterDirectory.LengthInChars = YuiContext->StartWatches[Watch->ProgramsWatchIndex].RootPath.LengthInChars;
+    }
+}
+
+/**
+ Return TRUE if a path refers to a directory or an object within it.
+
+ @param Path Pointer to the path to check.
+
+ @param Directory Pointer to the directory.
+
+ @return TRUE if the path is the directory or is within it, FALSE if not.
+ */
+BOOL
+YuiMenuIsPathWithinDirectory(
+    __in PYORI_STRING Path,
+    __in PYORI_STRING Directory
+    )
+{
+    if (Directory->LengthInChars == 0 ||
+        Path->LengthInChars < Directory->LengthInChars ||
+        YoriLibCompareStringInsensitiveCount(Path, Directory, Directory->LengthInChars) != 0) {
+
+        return FALSE;
+    }
+
+    if (Path->LengthInChars == Directory->LengthInChars ||
+        Path->StartOfString[Directory->LengthInChars] == '\\') {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Find the program within the start menu that was created from a specified
+ file.
+
+ @param YuiContext Pointer to the application context.
+
+ @param FilePath Pointer to the fully qualified path to the file.
+
+ @param Depth The number of path components between the monitored directory
+        and the file.
+
+ @return Pointer to the program, or NULL if no program was created from the
+         file.
+ */
+PYUI_MENU_FILE
+YuiMenuFindFile(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD Depth
+    )
+{
+    PYUI_MENU_DIRECTORY Parent;
+    PYORI_LIST_ENTRY ListEntry;
+    PYUI_MENU_FILE File;
+
+    if (YuiContext->FilterDirectory.LengthInChars > 0 && Depth == 0) {
+        Parent = &YuiContext->StartDirectory;
+    } else {
+        Parent = YuiLookupStartingNode(&YuiContext->ProgramsDirectory, FilePath, Depth);
+        if (Parent == NULL) {
+            return NULL;
+        }
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Parent->ChildFiles, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, YUI_MENU_FILE, ListEntry);
+        if (YoriLibCompareStringInsensitive(&File->FilePath, FilePath) == 0) {
+            return File;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Parent->ChildFiles, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Add an object that has appeared within a monitored directory to the start
+ menu.  If the object is a directory, its contents are added also, since
+ a directory that is moved or renamed generates a single change record.
+ The caller is expected to have set the filter directory for the monitored
+ directory containing the object.
+
+ @param YuiContext Pointer to the application context.
+
+ @param FilePath Pointer to the fully qualified path to the object.
+
+ @param Depth The number of path components between the monitored directory
+        and the object.
+ */
+VOID
+YuiMenuAddPath(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD Depth
+    )
+{
+    YUI_MENU_SUBTREE_CONTEXT SubtreeContext;
+    WIN32_FIND_DATA FileInfo;
+    PYUI_MENU_FILE ExistingFile;
+    DWORD Attributes;
+    DWORD MatchFlags;
+
+    //
+    //  If the object no longer exists, a later record will describe its
+    //  removal.
+    //
+
+    Attributes = GetFileAttributes(FilePath->StartOfString);
+    if (Attributes == (DWORD)-1) {
+        return;
+    }
+
+    //
+    //  Objects are added to an existing parent.  If the parent isn't present
+    //  it will add this object when it is added.
+    //
+
+    if ((YuiContext->FilterDirectory.LengthInChars == 0 || Depth > 0 || (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) &&
+        YuiLookupStartingNode(&YuiContext->ProgramsDirectory, FilePath, Depth) == NULL) {
+
+        return;
+    }
+
+    ZeroMemory(&FileInfo, sizeof(FileInfo));
+    FileInfo.dwFileAttributes = Attributes;
+
+    if ((Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        ExistingFile = YuiMenuFindFile(YuiContext, FilePath, Depth);
+        if (ExistingFile != NULL) {
+            YuiDeleteMenuFile(ExistingFile, NULL);
+        }
+        YuiFileFoundCallback(FilePath, &FileInfo, Depth, YuiContext);
+        return;
+    }
+
+    YuiFileFoundCallback(FilePath, &FileInfo, Depth, YuiContext);
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    MatchFlags |= YORILIB_FILEENUM_DIRECTORY_CONTENTS | YORILIB_FILEENUM_BASIC_EXPANSION;
+
+    SubtreeContext.YuiContext = YuiContext;
+    SubtreeContext.BaseDepth = Depth + 1;
+
+    YoriLibForEachFile(FilePath,
+                       MatchFlags,
+                       0,
+                       YuiMenuSubtreeFoundCallback,
+                       YuiFileEnumerateErrorCallback,
+                       &SubtreeContext);
+}
+
+/**
+ Remove an object that has been removed from a monitored directory from the
+ start menu.  Because the start menu merges several directories, a removed
+ directory may still exist in another monitored directory, so after the menu
+ directory is removed, any remaining contents from other monitored
+ directories are added back.
+
+ @param YuiContext Pointer to the application context.
+
+ @param Index The index of the monitored directory containing the object.
+
+ @param FilePath Pointer to the fully qualified path to the object.
+
+ @param RelativePath Pointer to the path to the object relative to the
+        monitored directory.
+
+ @param Depth The number of path components between the monitored directory
+        and the object.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YuiMenuRemovePath(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in DWORD Index,
+    __in PYORI_STRING FilePath,
+    __in PYORI_STRING RelativePath,
+    __in DWORD Depth
+    )
+{
+    PYUI_MENU_DIRECTORY Parent;
+    PYUI_MENU_DIRECTORY Directory;
+    PYUI_MENU_FILE File;
+    PYUI_MENU_WATCH OtherWatch;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING DirName;
+    YORI_STRING OtherPath;
+    DWORD OtherIndex;
+
+    File = YuiMenuFindFile(YuiContext, FilePath, Depth);
+    if (File != NULL) {
+        YuiDeleteMenuFile(File, NULL);
+        return TRUE;
+    }
+
+    Parent = YuiLookupStartingNode(&YuiContext->ProgramsDirectory, FilePath, Depth);
+    if (Parent == NULL ||
+        !YuiFindDepthComponent(FilePath, &DirName, 0, FALSE)) {
+
+        return TRUE;
+    }
+
+    Directory = NULL;
+    ListEntry = YoriLibGetNextListEntry(&Parent->ChildDirectories, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, YUI_MENU_DIRECTORY, ListEntry);
+        if (YoriLibCompareStringInsensitive(&Directory->DirName, &DirName) == 0) {
+            break;
+        }
+        Directory = NULL;
+        ListEntry = YoriLibGetNextListEntry(&Parent->ChildDirectories, ListEntry);
+    }
+
+    if (Directory == NULL) {
+        return TRUE;
+    }
+
+    YuiForEachFileOrDirectoryDepthFirst(Directory,
+                                        NULL,
+                                        YuiDeleteMenuFile,
+                                        YuiDeleteMenuDirectory);
+
+    for (OtherIndex = 0; OtherIndex < sizeof(YuiContext->StartWatches)/sizeof(YuiContext->StartWatches[0]); OtherIndex++) {
+        if (OtherIndex == Index) {
+            continue;
+        }
+
+        OtherWatch = &YuiContext->StartWatches[OtherIndex];
+        YoriLibInitEmptyString(&OtherPath);
+        YoriLibYPrintf(&OtherPath, _T("%y\\%y"), &OtherWatch->RootPath, RelativePath);
+        if (OtherPath.StartOfString == NULL) {
+            YuiMenuSetFilterForWatch(YuiContext, Index);
+            return FALSE;
+        }
+
+        YuiMenuSetFilterForWatch(YuiContext, OtherIndex);
+        if (!YuiMenuIsPathWithinDirectory(&OtherPath, &YuiContext->FilterDirectory)) {
+            YuiMenuAddPath(YuiContext, &OtherPath, Depth);
+        }
+        YoriLibFreeStringContents(&OtherPath);
+    }
+
+    YuiMenuSetFilterForWatch(YuiContext, Index);
+    return TRUE;
+}
+
+/**
+ Apply the change records that have been read from a monitored directory to
+ the tree of start menu directories and programs.
+
+ @param YuiContext Pointer to the application context.
+
+ @param Index The index of the monitored directory.
+
+ @return TRUE to indicate the changes were applied, FALSE if they could not
+         be and the start menu should be fully reloaded.
+ */
+BOOL
+YuiMenuApplyChanges(
+    __in PYUI_ENUM_CONTEXT YuiContext,
+    __in DWORD Index
+    )
+{
+    PYUI_MENU_WATCH Watch;
+    PFILE_NOTIFY_INFORMATION Record;
+    YORI_STRING RelativePath;
+    YORI_STRING FilePath;
+    DWORD Offset;
+    DWORD Depth;
+    DWORD CharIndex;
+    BOOL Result;
+
+    Watch = &YuiContext->StartWatches[Index];
+    Offset = 0;
+    Result = TRUE;
+
+    while (Result) {
+        Record = (PFILE_NOTIFY_INFORMATION)(Watch->Buffer + Offset);
+
+        YoriLibInitEmptyString(&RelativePath);
+        RelativePath.StartOfString = Record->FileName;
+        RelativePath.LengthInChars = Record->FileNameLength / sizeof(WCHAR);
+
+        Depth = 0;
+        for (CharIndex = 0; CharIndex < RelativePath.LengthInChars; CharIndex++) {
+            if (RelativePath.StartOfString[CharIndex] == '\\') {
+                Depth++;
+            }
+        }
+
+        YoriLibInitEmptyString(&FilePath);
+        YoriLibYPrintf(&FilePath, _T("%y\\%y"), &Watch->RootPath, &RelativePath);
+        if (FilePath.StartOfString == NULL) {
+            return FALSE;
+        }
+
+        //
+        //  Changes to the programs directory within the start menu directory
+        //  are reported by the programs directory.
+        //
+
+        YuiMenuSetFilterForWatch(YuiContext, Index);
+        if (!YuiMenuIsPathWithinDirectory(&FilePath, &YuiContext->FilterDirectory)) {
+            switch(Record->Action) {
+                case FILE_ACTION_ADDED:
+                case FILE_ACTION_RENAMED_NEW_NAME:
+                    YuiMenuAddPath(YuiContext, &FilePath, Depth);
+                    break;
+                case FILE_ACTION_REMOVED:
+                case FILE_ACTION_RENAMED_OLD_NAME:
+                    Result = YuiMenuRemovePath(YuiContext, Index, &FilePath, &RelativePath, Depth);
+                    break;
+            }
+        }
+        YoriLibInitEmptyString(&YuiContext->FilterDirectory);
+        YoriLibFreeStringContents(&FilePath);
+
+        if (Record->NextEntryOffset == 0) {
+            break;
+        }
+        Offset += Record->NextEntryOffset;
+    }
+
+    return Result;
+}
+
+/**
+ Check if any directory that is monitored for start menu changes has
+ changed.  If no changes are detected, return immediately and allow the
+ previously generated start menu to be displayed.  If change records are
+ available, apply them to the existing start menu and rebuild the menus from
+ it.  If only a change notification is available, or the system could not
+ record every change, purge the old start menu and reload the new one.
+ Monitoring is re-queued to detect a subsequent change.
+
+ @param YuiContext Pointer to the context containing the start menu and the
+        state used to monitor it.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YuiMenuReloadIfChanged(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    )
+{
+    PYUI_MENU_WATCH Watch;
+    DWORD WaitStatus;
+    DWORD HandleCount;
+    DWORD Index;
+    DWORD BytesReturned;
+    BOOLEAN FoundChange;
+    BOOLEAN FullReload;
+    BOOLEAN RestartMonitoring;
+
+    FoundChange = FALSE;
+    FullReload = FALSE;
+    RestartMonitoring = FALSE;
+    HandleCount = sizeof(YuiContext->StartChangeNotifications)/sizeof(YuiContext->StartChangeNotifications[0]);
+    while(TRUE) {
+        WaitStatus = WaitForMultipleObjects(HandleCount,
+                                            YuiContext->StartChangeNotifications,
+                                            FALSE,
+                                            0);
+        if (WaitStatus == WAIT_TIMEOUT) {
+            break;
+        }
+
+        //
+        //  The existing menus are destroyed when the first change is found,
+        //  since the tree they refer to is about to change.
+        //
+
+        if (!FoundChange) {
+            YuiMenuDestroyMenus(YuiContext);
+            FoundChange = TRUE;
+        }
+
+        if (WaitStatus < WAIT_OBJECT_0 || WaitStatus >= WAIT_OBJECT_0 + HandleCount) {
+            FullReload = TRUE;
+            RestartMonitoring = TRUE;
+            break;
+        }
+
+        Index = WaitStatus - WAIT_OBJECT_0;
+        Watch = &YuiContext->StartWatches[Index];
+
+        if (Watch->DirectoryHandle == NULL) {
+            FindNextChangeNotification(YuiContext->StartChangeNotifications[Index]);
+            FullReload = TRUE;
+            continue;
+        }
+
+        //
+        //  If no records were returned, the system could not record every
+        //  change, so the only option is to reload everything.
+        //
+
+        Watch->ReadPending = FALSE;
+        if (!GetOverlappedResult(Watch->DirectoryHandle, &Watch->Overlapped, &BytesReturned, FALSE) ||
+            BytesReturned == 0) {
+
+            FullReload = TRUE;
+        } else if (!FullReload) {
+            if (!YuiMenuApplyChanges(YuiContext, Index)) {
+                FullReload = TRUE;
+            }
+        }
+
+        if (!YuiMenuQueueChangeRead(Watch)) {
+            FullReload = TRUE;
+            RestartMonitoring = TRUE;
+            break;
+        }
+    }
+
+    if (!FoundChange) {
+        return TRUE;
+    }
 
-        FoundChange = TRUE;
-        if (WaitStatus >= WAIT_OBJECT_0 && WaitStatus < WAIT_OBJECT_0 + HandleCount) {
-            FindNextChangeNotification(YuiContext->StartChangeNotifications[WaitStatus - WAIT_OBJECT_0]);
+    if (FullReload) {
+        if (RestartMonitoring) {
+            YuiMenuStopMonitoring(YuiContext);
         }
+        YuiMenuFreeAll(YuiContext);
+        return YuiMenuPopulate(YuiContext);
     }
 
-    YuiMenuFreeAll(YuiContext);
-    return YuiMenuPopulate(YuiContext);
+    return YuiMenuBuildMenus(YuiContext);
 }
 
 /**
@@ -503,16 +503,9 @@ YuiCreateWindow(
 VOID
 YuiCleanupGlobalState()
 {
-    DWORD Count;
     YuiMenuFreeAll(&YuiContext);
     YuiTaskbarFreeButtons(&YuiContext);
-
-    for (Count = 0; Count < sizeof(YuiContext.StartChangeNotifications)/sizeof(YuiContext.StartChangeNotifications[0]); Count++) {
-        if (YuiContext.StartChangeNotifications[Count] != NULL) {
-            FindCloseChangeNotification(YuiContext.StartChangeNotifications[Count]);
-            YuiContext.StartChangeNotifications[Count] = NULL;
-        }
-    }
+    YuiMenuStopMonitoring(&YuiContext);
 
     if (YuiContext.ClockTimerId != 0) {
         KillTimer(YuiContext.hWnd, YUI_CLOCK_TIMER);
@@ -597,6 +590,7 @@ ymain(
     YoriLibInitializeListHead(&YuiContext.TaskbarButtons);
     YuiContext.TaskbarButtonCount = 0;
 
+    YoriLibLoadKernel32Functions();
     YoriLibLoadUser32Functions();
     YoriLibLoadShell32Functions();
     YoriLibLoadWtsApi32Functions();
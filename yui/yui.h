@@ -187,6 +187,55 @@ typedef struct _YUI_MENU_FILE {
     DWORD MenuId;
 } YUI_MENU_FILE, *PYUI_MENU_FILE;
 
+/**
+ State for monitoring a single start menu directory for changes.
+ */
+typedef struct _YUI_MENU_WATCH {
+
+    /**
+     The fully qualified path to the directory being monitored.
+     */
+    YORI_STRING RootPath;
+
+    /**
+     A handle to the directory, used to read records describing each change.
+     This is NULL if change records are not available, in which case a
+     change notification is used and any change causes a full reload.
+     */
+    HANDLE DirectoryHandle;
+
+    /**
+     The overlapped structure for the outstanding read of change records.
+     Its event is signalled when change records are available.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     A buffer to receive change records.
+     */
+    PUCHAR Buffer;
+
+    /**
+     TRUE if a read of change records has been issued and its completion has
+     not yet been processed.
+     */
+    BOOL ReadPending;
+
+    /**
+     TRUE if this is a start menu directory rather than a programs
+     directory.  Files directly in this directory are displayed at the top
+     of the start menu, and anything under the programs directory is
+     ignored since it is monitored separately.
+     */
+    BOOL StartRoot;
+
+    /**
+     For a start menu directory, the index of the watch for the corresponding
+     programs directory.
+     */
+    DWORD ProgramsWatchIndex;
+} YUI_MENU_WATCH, *PYUI_MENU_WATCH;
+
 /**
  In memory state corresponding to a taskbar button.
  */
@@ -264,6 +313,12 @@ typedef struct _YUI_ENUM_CONTEXT {
      */
     HANDLE StartChangeNotifications[4];
 
+    /**
+     The state used to monitor each directory in the start menu.  Each entry
+     corresponds to the handle at the same index in StartChangeNotifications.
+     */
+    YUI_MENU_WATCH StartWatches[4];
+
     /**
      The next identifier to allocate for subsequent menu entries.
      */
@@ -425,6 +480,11 @@ YuiMenuFreeAll(
     __in PYUI_ENUM_CONTEXT YuiContext
     );
 
+VOID
+YuiMenuStopMonitoring(
+    __in PYUI_ENUM_CONTEXT YuiContext
+    );
+
 BOOL
 YuiTaskbarPopulateWindows(
     __in PYUI_ENUM_CONTEXT YuiContext,